@@ -1,106 +1,304 @@
 #include "execute_cmd.h"
-#include <boost/thread.hpp>
-#include <syslog.h>
 
-unsigned long ExecuteCmd::execute(const std::string &cmd, const std::string &cwd)
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "logger.h"
+
+extern char **environ;
+
+unsigned long ExecuteCmd::execute(const std::string &cmd, const std::string &cwd, bool isStreamed)
 {
-    mutex_.lock();
-    curCmdId_++;
-    CmdDescr *cmdDescr = new CmdDescr();
-    cmdDescr->bFinished = false;
-    cmdDescr->bSuccess = false;
-    cmdDescr->cmdId = curCmdId_;
-    executingCmds_.push_back(cmdDescr);
-    mutex_.unlock();
+    std::vector<std::string> args;
+    if (!splitArguments(cmd, args) || args.empty()) {
+        Logger::instance().out("Could not parse the command: %s", cmd.c_str());
+        return 0;
+    }
+    std::vector<char *> argv;
+    for (auto &arg : args) {
+        argv.push_back(&arg[0]);
+    }
+    argv.push_back(nullptr);
+
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        Logger::instance().out("Could not create a pipe for the command: %d", errno);
+        return 0;
+    }
 
+    // stdout and stderr share the pipe, so the lines come in the order they were written
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDERR_FILENO);
     if (!cwd.empty()) {
-        boost::thread(runCmd, curCmdId_, "cd \"" + cwd + "\" && " + cmd);
-    } else {
-        boost::thread(runCmd, curCmdId_, cmd);
+        posix_spawn_file_actions_addchdir_np(&actions, cwd.c_str());
     }
-    
-    return curCmdId_;
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t mask;
+    sigemptyset(&mask);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    sigset_t defaultSignals;
+    sigemptyset(&defaultSignals);
+    sigaddset(&defaultSignals, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &defaultSignals);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    pid_t pid;
+    const int err = posix_spawnp(&pid, argv[0], &actions, &attr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    close(fds[1]);
+    if (err != 0) {
+        Logger::instance().out("Could not start %s: %d", argv[0], err);
+        close(fds[0]);
+        return 0;
+    }
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+
+    std::lock_guard<std::mutex> guard(mutex_);
+    const unsigned long cmdId = ++curCmdId_;
+    processes_[cmdId] = Process{ pid, fds[0], std::string(), false, isStreamed, false };
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = cmdId;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, fds[0], &ev);
+    return cmdId;
 }
 
 void ExecuteCmd::getStatus(unsigned long cmdId, bool &bFinished, std::string &log)
 {
-    mutex_.lock();
-    for (auto it = executingCmds_.begin(); it != executingCmds_.end(); ++it) {
-        if ((*it)->cmdId == cmdId) {
-            bFinished = (*it)->bFinished;
-            log = (*it)->log;
-            
-            if ((*it)->bFinished) {
-                delete (*it);
-                executingCmds_.erase(it);
-            }
-            break;
-        }
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto it = processes_.find(cmdId);
+    if (it == processes_.end() || it->second.isCleared) {
+        return;
+    }
+    bFinished = it->second.bFinished;
+    log = it->second.log;
+    if (bFinished) {
+        processes_.erase(it);
     }
-    mutex_.unlock();
 }
 
 void ExecuteCmd::clearCmds()
 {
-    mutex_.lock();
-    for (auto it = executingCmds_.begin(); it != executingCmds_.end(); ++it) {
-        delete (*it);
+    std::lock_guard<std::mutex> guard(mutex_);
+    for (auto it = processes_.begin(); it != processes_.end(); ) {
+        if (it->second.bFinished) {
+            it = processes_.erase(it);
+        } else {
+            // the pipe stays open, otherwise the process would get SIGPIPE on the next write
+            it->second.isCleared = true;
+            it->second.log.clear();
+            ++it;
+        }
     }
-    executingCmds_.clear();
-    mutex_.unlock();
 }
 
+void ExecuteCmd::setOutputHandler(const OutputHandler &handler)
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    outputHandler_ = handler;
+}
+
+bool ExecuteCmd::splitArguments(const std::string &cmd, std::vector<std::string> &outArgs)
+{
+    outArgs.clear();
+    std::string arg;
+    bool isInArg = false;
+    char quote = 0;
+    for (size_t i = 0; i < cmd.size(); ++i) {
+        const char c = cmd[i];
+        if (quote == '\'') {
+            if (c == '\'') {
+                quote = 0;
+            } else {
+                arg += c;
+            }
+        } else if (c == '\\' && i + 1 < cmd.size() && (quote == 0 || cmd[i + 1] == '"' || cmd[i + 1] == '\\')) {
+            arg += cmd[++i];
+            isInArg = true;
+        } else if (quote == '"') {
+            if (c == '"') {
+                quote = 0;
+            } else {
+                arg += c;
+            }
+        } else if (c == '"' || c == '\'') {
+            quote = c;
+            isInArg = true;
+        } else if (c == ' ' || c == '\t' || c == '\n') {
+            if (isInArg) {
+                outArgs.push_back(arg);
+                arg.clear();
+                isInArg = false;
+            }
+        } else {
+            arg += c;
+            isInArg = true;
+        }
+    }
+    if (quote != 0) {
+        return false;
+    }
+    if (isInArg) {
+        outArgs.push_back(arg);
+    }
+    return true;
+}
 
 ExecuteCmd::ExecuteCmd() : curCmdId_(0)
 {
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    wakeupFd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = 0;    // the command ids start from 1
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeupFd_, &ev);
+    thread_ = std::thread(&ExecuteCmd::run, this);
 }
 
-void ExecuteCmd::runCmd(unsigned long cmdId, std::string cmd)
+ExecuteCmd::~ExecuteCmd()
 {
-    std::string strReply;
-     
-    // run openvpn command
-    FILE *file = popen(cmd.c_str(), "r");
-    if (file) {
-        char szLine[4096];
-        while(fgets(szLine, sizeof(szLine), file) != 0) {
-            if (instance().isCmdExist(cmdId)) {
-                strReply += szLine;
+    const uint64_t value = 1;
+    if (write(wakeupFd_, &value, sizeof(value)) == sizeof(value)) {
+        thread_.join();
+    } else {
+        thread_.detach();
+    }
+    for (auto &it : processes_) {
+        if (it.second.fd >= 0) {
+            close(it.second.fd);
+        }
+    }
+    close(wakeupFd_);
+    close(epollFd_);
+}
+
+void ExecuteCmd::run()
+{
+    const int kMaxEvents = 16;
+    struct epoll_event events[kMaxEvents];
+    bool isAllReaped = true;
+    while (true) {
+        // a process may close its output a little before it exits, such processes are reaped with a short delay
+        const int n = epoll_wait(epollFd_, events, kMaxEvents, isAllReaped ? -1 : 100);
+        if (n < 0 && errno != EINTR) {
+            Logger::instance().out("ExecuteCmd epoll_wait failed: %d", errno);
+            return;
+        }
+        for (int i = 0; i < n; ++i) {
+            if (events[i].data.u64 == 0) {
+                return;
             }
+            readOutput(events[i].data.u64);
         }
-        pclose(file);
-        instance().cmdFinished(cmdId, true, strReply);
-    } else {
-        instance().cmdFinished(cmdId, false, std::string());
+        isAllReaped = unreaped_.empty() || reapProcesses();
     }
 }
 
-void ExecuteCmd::cmdFinished(unsigned long cmdId, bool bSuccess, std::string log)
+void ExecuteCmd::readOutput(unsigned long cmdId)
 {
-    mutex_.lock();
-    for (auto it = executingCmds_.begin(); it != executingCmds_.end(); ++it) {
-        if ((*it)->cmdId == cmdId) {
-            (*it)->bFinished = true;
-            (*it)->bSuccess = bSuccess;
-            (*it)->log = log;
+    char buf[16384];
+    std::string data;
+    OutputHandler handler;
+    bool isFinished = false;
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        auto it = processes_.find(cmdId);
+        if (it == processes_.end() || it->second.fd < 0) {
+            return;
+        }
+        Process &process = it->second;
+        while (true) {
+            const ssize_t len = read(process.fd, buf, sizeof(buf));
+            if (len > 0) {
+                if (!process.isCleared) {
+                    (process.isStreamed ? data : process.log).append(buf, len);
+                }
+                continue;
+            }
+            if (len < 0 && errno == EINTR) {
+                continue;
+            }
+            if (len == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+                epoll_ctl(epollFd_, EPOLL_CTL_DEL, process.fd, nullptr);
+                close(process.fd);
+                process.fd = -1;
+            }
             break;
         }
+        if (process.isStreamed && !process.isCleared) {
+            handler = outputHandler_;
+        }
+        if (process.fd < 0) {
+            int status;
+            const pid_t ret = waitpid(process.pid, &status, WNOHANG);
+            if (ret != 0) {
+                isFinished = true;
+                finishProcess(it);
+            } else {
+                unreaped_.push_back(cmdId);
+            }
+        }
+    }
+
+    if (handler && (!data.empty() || isFinished)) {
+        handler(cmdId, data, isFinished);
     }
-    mutex_.unlock();
 }
 
-bool ExecuteCmd::isCmdExist(unsigned long cmdId)
+bool ExecuteCmd::reapProcesses()
 {
-    mutex_.lock();
-    bool bFound = false;
-    for (auto it = executingCmds_.begin(); it != executingCmds_.end(); ++it)
+    std::vector<unsigned long> finished;
+    OutputHandler handler;
     {
-        if ((*it)->cmdId == cmdId)
-        {
-            bFound = true;
-            break;
+        std::lock_guard<std::mutex> guard(mutex_);
+        for (auto cmdIt = unreaped_.begin(); cmdIt != unreaped_.end(); ) {
+            auto it = processes_.find(*cmdIt);
+            int status;
+            if (it != processes_.end() && waitpid(it->second.pid, &status, WNOHANG) == 0) {
+                ++cmdIt;
+                continue;
+            }
+            if (it != processes_.end()) {
+                if (it->second.isStreamed && !it->second.isCleared) {
+                    finished.push_back(it->first);
+                }
+                finishProcess(it);
+            }
+            cmdIt = unreaped_.erase(cmdIt);
         }
+        handler = outputHandler_;
+    }
+
+    if (handler) {
+        for (unsigned long cmdId : finished) {
+            handler(cmdId, std::string(), true);
+        }
+    }
+    return unreaped_.empty();
+}
+
+void ExecuteCmd::finishProcess(std::unordered_map<unsigned long, Process>::iterator it)
+{
+    // nobody asks for the status of a cleared command
+    if (it->second.isCleared) {
+        processes_.erase(it);
+    } else {
+        it->second.bFinished = true;
     }
-    mutex_.unlock();
-    return bFound;
 }
@@ -1,43 +1,69 @@
 #ifndef ____ExecuteCmd__
 #define ____ExecuteCmd__
 
-#include <stdio.h>
-#include <string>
-#include <list>
+#include <sys/types.h>
+#include <functional>
 #include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
+// Process supervisor for the long-running commands (OpenVPN, ctrld, wireguard-go).
+// The processes are started with posix_spawn without a shell, their stdout and stderr are read by one epoll thread.
+// The output of a streamed command is passed to the output handler as it arrives, the output of the other commands
+// is accumulated for getStatus().
 class ExecuteCmd
 {
 public:
+    typedef std::function<void(unsigned long cmdId, const std::string &data, bool isFinished)> OutputHandler;
+
     static ExecuteCmd &instance()
     {
         static ExecuteCmd i;
         return i;
     }
-    
-    unsigned long execute(const std::string &cmd, const std::string &cwd = "");
+
+    // cmd is split into the arguments like the shell does (quotes and backslashes), no other shell syntax is supported.
+    // Returns 0 if the process could not be started.
+    unsigned long execute(const std::string &cmd, const std::string &cwd = "", bool isStreamed = false);
     void getStatus(unsigned long cmdId, bool &bFinished, std::string &log);
+    // forgets the commands, the processes keep running and their output is discarded
     void clearCmds();
+    // the handler is called from the supervisor thread
+    void setOutputHandler(const OutputHandler &handler);
+
+    static bool splitArguments(const std::string &cmd, std::vector<std::string> &outArgs);
 
 private:
     ExecuteCmd();
-    
-    unsigned long curCmdId_;
-    
-    static void runCmd(unsigned long cmdId, std::string cmd);
-    void cmdFinished(unsigned long cmdId, bool bSuccess, std::string log);
-    bool isCmdExist(unsigned long cmdId);
-    
-    struct CmdDescr
+    ~ExecuteCmd();
+
+    struct Process
     {
-        unsigned long cmdId;
+        pid_t pid;
+        int fd;             // the read end of the pipe of stdout and stderr, -1 after EOF
         std::string log;
         bool bFinished;
-        bool bSuccess;
+        bool isStreamed;
+        bool isCleared;
     };
-    
-    std::list<CmdDescr *> executingCmds_;
+
+    unsigned long curCmdId_;
+    std::unordered_map<unsigned long, Process> processes_;
+    std::vector<unsigned long> unreaped_;  // closed the output but have not exited yet, accessed in the supervisor thread
+    OutputHandler outputHandler_;
     std::mutex mutex_;
+
+    int epollFd_;
+    int wakeupFd_;
+    std::thread thread_;
+
+    void run();
+    void readOutput(unsigned long cmdId);
+    // reaps the processes of unreaped_, returns false if some of them are still running
+    bool reapProcesses();
+    void finishProcess(std::unordered_map<unsigned long, Process>::iterator it);
 };
 
 #endif /* defined(____ExecuteCmd__) */
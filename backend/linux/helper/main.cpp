@@ -29,6 +29,11 @@ int main(int argc, const char *argv[])
 
     // restore firewall setting on OS reboot, if there are saved rules on /etc/windscribe dir
 
+    // the rules may reference the whitelist ipset, so it is restored first
+    if (Utils::isFileExists("/etc/windscribe/ipset.v4"))
+    {
+        Utils::executeCommand("ipset -exist restore < /etc/windscribe/ipset.v4");
+    }
     if (Utils::isFileExists("/etc/windscribe/rules.v4"))
     {
         Utils::executeCommand("iptables-restore -n < /etc/windscribe/rules.v4");
@@ -0,0 +1,457 @@
+#include "netlink_routes.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/fib_rules.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <tuple>
+
+#include "../logger.h"
+
+namespace
+{
+
+void appendAttr(std::vector<char> &buffer, size_t msgOffset, unsigned short type, const void *data, size_t len)
+{
+    const size_t offset = buffer.size();
+    buffer.resize(offset + RTA_SPACE(len));
+    struct rtattr *rta = (struct rtattr *)(buffer.data() + offset);
+    rta->rta_type = type;
+    rta->rta_len = RTA_LENGTH(len);
+    memcpy(RTA_DATA(rta), data, len);
+    ((struct nlmsghdr *)(buffer.data() + msgOffset))->nlmsg_len = buffer.size() - msgOffset;
+}
+
+void appendU32(std::vector<char> &buffer, size_t msgOffset, unsigned short type, uint32_t value)
+{
+    appendAttr(buffer, msgOffset, type, &value, sizeof(value));
+}
+
+uint32_t prefixMask(uint8_t prefixLen)
+{
+    return prefixLen == 0 ? 0 : htonl(0xFFFFFFFFu << (32 - prefixLen));
+}
+
+} // namespace
+
+bool NetlinkRoutes::Route::operator==(const Route &other) const
+{
+    return dst == other.dst && dstLen == other.dstLen && gateway == other.gateway && ifindex == other.ifindex && table == other.table;
+}
+
+bool NetlinkRoutes::Route::operator<(const Route &other) const
+{
+    return std::tie(table, dst, dstLen, gateway, ifindex) < std::tie(other.table, other.dst, other.dstLen, other.gateway, other.ifindex);
+}
+
+std::string NetlinkRoutes::Route::toString() const
+{
+    char str[INET_ADDRSTRLEN];
+    std::string result = std::string(inet_ntop(AF_INET, &dst, str, sizeof(str))) + "/" + std::to_string(dstLen);
+    if (gateway != 0) {
+        result += std::string(" via ") + inet_ntop(AF_INET, &gateway, str, sizeof(str));
+    }
+    if (ifindex != 0) {
+        char name[IF_NAMESIZE] = {};
+        result += std::string(" dev ") + (if_indextoname(ifindex, name) ? name : std::to_string(ifindex).c_str());
+    }
+    if (table != RT_TABLE_MAIN) {
+        result += " table " + std::to_string(table);
+    }
+    return result;
+}
+
+bool NetlinkRoutes::Route::contains(uint32_t prefix, uint8_t prefixLen) const
+{
+    return dstLen <= prefixLen && (prefix & prefixMask(dstLen)) == dst;
+}
+
+bool NetlinkRoutes::Rule::isSame(const Rule &other) const
+{
+    return table == other.table && hasFwmark == other.hasFwmark && (!hasFwmark || fwmark == other.fwmark) &&
+           isInvert == other.isInvert && suppressPrefixLength == other.suppressPrefixLength;
+}
+
+NetlinkRoutes::NetlinkRoutes() : seq_(0)
+{
+    fd_ = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd_ < 0) {
+        Logger::instance().out("Could not open the rtnetlink socket: %d", errno);
+        return;
+    }
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    if (bind(fd_, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        Logger::instance().out("Could not bind the rtnetlink socket: %d", errno);
+        close(fd_);
+        fd_ = -1;
+        return;
+    }
+    // the errors don't include the requests, so the ACKs of a batch are small
+    int one = 1;
+    setsockopt(fd_, SOL_NETLINK, NETLINK_CAP_ACK, &one, sizeof(one));
+    int bufSize = 1024 * 1024;
+    setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &bufSize, sizeof(bufSize));
+}
+
+NetlinkRoutes::~NetlinkRoutes()
+{
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+bool NetlinkRoutes::apply(const std::vector<Route> &addRoutes, const std::vector<Route> &deleteRoutes,
+                          const std::vector<Rule> &addRules, const std::vector<Rule> &deleteRules)
+{
+    if (fd_ < 0) {
+        return false;
+    }
+
+    // the rules are deleted before and added after the routes of their tables
+    struct Request
+    {
+        int type;
+        const Route *route;
+        const Rule *rule;
+        int ignoredError;
+    };
+    std::vector<Request> requests;
+    requests.reserve(addRoutes.size() + deleteRoutes.size() + addRules.size() + deleteRules.size());
+    for (const auto &rule : deleteRules) {
+        requests.push_back({ RTM_DELRULE, nullptr, &rule, ENOENT });
+    }
+    for (const auto &route : deleteRoutes) {
+        requests.push_back({ RTM_DELROUTE, &route, nullptr, ESRCH });
+    }
+    for (const auto &route : addRoutes) {
+        requests.push_back({ RTM_NEWROUTE, &route, nullptr, EEXIST });
+    }
+    for (const auto &rule : addRules) {
+        requests.push_back({ RTM_NEWRULE, nullptr, &rule, EEXIST });
+    }
+
+    bool isOk = true;
+    std::vector<char> buffer;
+    std::vector<int> ignoredErrors;
+    for (size_t i = 0; i < requests.size(); i += kBatchSize) {
+        buffer.clear();
+        ignoredErrors.clear();
+        const uint32_t firstSeq = seq_ + 1;
+        for (size_t j = i; j < requests.size() && j < i + kBatchSize; ++j) {
+            if (requests[j].route) {
+                appendRouteMessage(buffer, requests[j].type, *requests[j].route);
+            } else {
+                appendRuleMessage(buffer, requests[j].type, *requests[j].rule);
+            }
+            ignoredErrors.push_back(requests[j].ignoredError);
+        }
+        isOk &= sendBatch(buffer, firstSeq, ignoredErrors);
+    }
+    return isOk;
+}
+
+bool NetlinkRoutes::dumpRoutes(uint32_t table, std::vector<Route> &outRoutes)
+{
+    outRoutes.clear();
+    std::vector<char> data;
+    if (!dump(RTM_GETROUTE, data)) {
+        return false;
+    }
+
+    int remaining = (int)data.size();
+    for (const struct nlmsghdr *nlh = (const struct nlmsghdr *)data.data(); NLMSG_OK(nlh, remaining); nlh = NLMSG_NEXT(nlh, remaining)) {
+        if (nlh->nlmsg_type != RTM_NEWROUTE || nlh->nlmsg_len < NLMSG_LENGTH(sizeof(struct rtmsg))) {
+            continue;
+        }
+        const struct rtmsg *rtm = (const struct rtmsg *)NLMSG_DATA(nlh);
+        if (rtm->rtm_family != AF_INET || rtm->rtm_type != RTN_UNICAST) {
+            continue;
+        }
+        Route route;
+        route.dstLen = rtm->rtm_dst_len;
+        route.table = rtm->rtm_table;
+        int attrLen = RTM_PAYLOAD(nlh);
+        for (const struct rtattr *rta = RTM_RTA(rtm); RTA_OK(rta, attrLen); rta = RTA_NEXT(rta, attrLen)) {
+            switch (rta->rta_type) {
+            case RTA_TABLE:
+                route.table = *(const uint32_t *)RTA_DATA(rta);
+                break;
+            case RTA_DST:
+                route.dst = *(const uint32_t *)RTA_DATA(rta);
+                break;
+            case RTA_GATEWAY:
+                route.gateway = *(const uint32_t *)RTA_DATA(rta);
+                break;
+            case RTA_OIF:
+                route.ifindex = *(const int *)RTA_DATA(rta);
+                break;
+            default:
+                break;
+            }
+        }
+        if (table == RT_TABLE_UNSPEC || route.table == table) {
+            outRoutes.push_back(route);
+        }
+    }
+    return true;
+}
+
+bool NetlinkRoutes::dumpRules(std::vector<Rule> &outRules)
+{
+    outRules.clear();
+    std::vector<char> data;
+    if (!dump(RTM_GETRULE, data)) {
+        return false;
+    }
+
+    int remaining = (int)data.size();
+    for (const struct nlmsghdr *nlh = (const struct nlmsghdr *)data.data(); NLMSG_OK(nlh, remaining); nlh = NLMSG_NEXT(nlh, remaining)) {
+        if (nlh->nlmsg_type != RTM_NEWRULE || nlh->nlmsg_len < NLMSG_LENGTH(sizeof(struct fib_rule_hdr))) {
+            continue;
+        }
+        const struct fib_rule_hdr *frh = (const struct fib_rule_hdr *)NLMSG_DATA(nlh);
+        if (frh->family != AF_INET) {
+            continue;
+        }
+        Rule rule;
+        rule.table = frh->table;
+        rule.isInvert = (frh->flags & FIB_RULE_INVERT) != 0;
+        int attrLen = nlh->nlmsg_len - NLMSG_LENGTH(sizeof(struct fib_rule_hdr));
+        for (const struct rtattr *rta = (const struct rtattr *)((const char *)frh + NLMSG_ALIGN(sizeof(struct fib_rule_hdr)));
+             RTA_OK(rta, attrLen); rta = RTA_NEXT(rta, attrLen)) {
+            switch (rta->rta_type) {
+            case FRA_TABLE:
+                rule.table = *(const uint32_t *)RTA_DATA(rta);
+                break;
+            case FRA_FWMARK:
+                rule.hasFwmark = true;
+                rule.fwmark = *(const uint32_t *)RTA_DATA(rta);
+                break;
+            case FRA_SUPPRESS_PREFIXLEN:
+                rule.suppressPrefixLength = *(const int32_t *)RTA_DATA(rta);
+                break;
+            case FRA_PRIORITY:
+                rule.priority = *(const uint32_t *)RTA_DATA(rta);
+                break;
+            default:
+                break;
+            }
+        }
+        outRules.push_back(rule);
+    }
+    return true;
+}
+
+bool NetlinkRoutes::parsePrefix(const std::string &ip, const std::string &mask, uint32_t &outDst, uint8_t &outDstLen)
+{
+    uint32_t address;
+    if (!parseAddress(ip, address)) {
+        return false;
+    }
+    uint32_t maskAddress;
+    if (mask.find('.') != std::string::npos) {
+        if (!parseAddress(mask, maskAddress)) {
+            return false;
+        }
+        outDstLen = (uint8_t)__builtin_popcount(maskAddress);
+        if (prefixMask(outDstLen) != maskAddress) {
+            return false;
+        }
+    } else {
+        char *end = nullptr;
+        const long len = strtol(mask.c_str(), &end, 10);
+        if (mask.empty() || *end != '\0' || len < 0 || len > 32) {
+            return false;
+        }
+        outDstLen = (uint8_t)len;
+    }
+    outDst = address & prefixMask(outDstLen);
+    return true;
+}
+
+bool NetlinkRoutes::parsePrefix(const std::string &cidr, uint32_t &outDst, uint8_t &outDstLen)
+{
+    const size_t pos = cidr.find('/');
+    if (pos == std::string::npos) {
+        return parsePrefix(cidr, "32", outDst, outDstLen);
+    }
+    return parsePrefix(cidr.substr(0, pos), cidr.substr(pos + 1), outDst, outDstLen);
+}
+
+bool NetlinkRoutes::parseAddress(const std::string &ip, uint32_t &outAddress)
+{
+    struct in_addr addr;
+    if (inet_pton(AF_INET, ip.c_str(), &addr) != 1) {
+        return false;
+    }
+    outAddress = addr.s_addr;
+    return true;
+}
+
+bool NetlinkRoutes::sendBatch(const std::vector<char> &buffer, uint32_t firstSeq, const std::vector<int> &ignoredErrors)
+{
+    struct sockaddr_nl kernel;
+    memset(&kernel, 0, sizeof(kernel));
+    kernel.nl_family = AF_NETLINK;
+    if (sendto(fd_, buffer.data(), buffer.size(), 0, (struct sockaddr *)&kernel, sizeof(kernel)) < 0) {
+        Logger::instance().out("Could not send the rtnetlink requests: %d", errno);
+        return false;
+    }
+
+    bool isOk = true;
+    size_t acked = 0;
+    std::vector<char> reply(64 * 1024);
+    while (acked < ignoredErrors.size()) {
+        struct pollfd pfd = { fd_, POLLIN, 0 };
+        if (poll(&pfd, 1, 5000) <= 0) {
+            Logger::instance().out("No rtnetlink ACKs for %zu requests", ignoredErrors.size() - acked);
+            return false;
+        }
+        const ssize_t len = recv(fd_, reply.data(), reply.size(), 0);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            Logger::instance().out("Could not read the rtnetlink ACKs: %d", errno);
+            return false;
+        }
+
+        int remaining = (int)len;
+        for (const struct nlmsghdr *nlh = (const struct nlmsghdr *)reply.data(); NLMSG_OK(nlh, remaining); nlh = NLMSG_NEXT(nlh, remaining)) {
+            if (nlh->nlmsg_type != NLMSG_ERROR || nlh->nlmsg_seq < firstSeq || nlh->nlmsg_seq - firstSeq >= ignoredErrors.size()) {
+                continue;
+            }
+            acked++;
+            const struct nlmsgerr *err = (const struct nlmsgerr *)NLMSG_DATA(nlh);
+            const int error = -err->error;
+            if (error != 0 && error != ignoredErrors[nlh->nlmsg_seq - firstSeq]) {
+                Logger::instance().out("rtnetlink request %u failed: %s", nlh->nlmsg_seq - firstSeq, strerror(error));
+                isOk = false;
+            }
+        }
+    }
+    return isOk;
+}
+
+bool NetlinkRoutes::dump(int type, std::vector<char> &outData)
+{
+    if (fd_ < 0) {
+        return false;
+    }
+
+    struct {
+        struct nlmsghdr nlh;
+        struct rtgenmsg gen;
+    } request;
+    memset(&request, 0, sizeof(request));
+    request.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtgenmsg));
+    request.nlh.nlmsg_type = type;
+    request.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.nlh.nlmsg_seq = ++seq_;
+    request.gen.rtgen_family = AF_INET;
+    if (send(fd_, &request, request.nlh.nlmsg_len, 0) < 0) {
+        return false;
+    }
+
+    std::vector<char> reply(64 * 1024);
+    while (true) {
+        struct pollfd pfd = { fd_, POLLIN, 0 };
+        if (poll(&pfd, 1, 5000) <= 0) {
+            return false;
+        }
+        const ssize_t len = recv(fd_, reply.data(), reply.size(), 0);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        int remaining = (int)len;
+        for (const struct nlmsghdr *nlh = (const struct nlmsghdr *)reply.data(); NLMSG_OK(nlh, remaining); nlh = NLMSG_NEXT(nlh, remaining)) {
+            if (nlh->nlmsg_seq != request.nlh.nlmsg_seq) {
+                continue;
+            }
+            if (nlh->nlmsg_type == NLMSG_DONE) {
+                return true;
+            }
+            if (nlh->nlmsg_type == NLMSG_ERROR) {
+                return false;
+            }
+            outData.insert(outData.end(), (const char *)nlh, (const char *)nlh + NLMSG_ALIGN(nlh->nlmsg_len));
+        }
+    }
+}
+
+void NetlinkRoutes::appendRouteMessage(std::vector<char> &buffer, int type, const Route &route)
+{
+    const size_t offset = buffer.size();
+    buffer.resize(offset + NLMSG_SPACE(sizeof(struct rtmsg)));
+    struct nlmsghdr *nlh = (struct nlmsghdr *)(buffer.data() + offset);
+    nlh->nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
+    nlh->nlmsg_type = type;
+    nlh->nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | (type == RTM_NEWROUTE ? NLM_F_CREATE | NLM_F_EXCL : 0);
+    nlh->nlmsg_seq = ++seq_;
+
+    // the same as "ip route add/delete"
+    struct rtmsg *rtm = (struct rtmsg *)NLMSG_DATA(nlh);
+    rtm->rtm_family = AF_INET;
+    rtm->rtm_dst_len = route.dstLen;
+    rtm->rtm_table = route.table < 256 ? route.table : RT_TABLE_UNSPEC;
+    rtm->rtm_type = RTN_UNICAST;
+    if (type == RTM_NEWROUTE) {
+        rtm->rtm_protocol = RTPROT_BOOT;
+        rtm->rtm_scope = route.gateway != 0 ? RT_SCOPE_UNIVERSE : RT_SCOPE_LINK;
+    } else {
+        rtm->rtm_scope = RT_SCOPE_NOWHERE;
+    }
+
+    if (route.dstLen > 0) {
+        appendU32(buffer, offset, RTA_DST, route.dst);
+    }
+    if (route.gateway != 0) {
+        appendU32(buffer, offset, RTA_GATEWAY, route.gateway);
+    }
+    if (route.ifindex != 0) {
+        appendU32(buffer, offset, RTA_OIF, route.ifindex);
+    }
+    if (route.table >= 256) {
+        appendU32(buffer, offset, RTA_TABLE, route.table);
+    }
+}
+
+void NetlinkRoutes::appendRuleMessage(std::vector<char> &buffer, int type, const Rule &rule)
+{
+    const size_t offset = buffer.size();
+    buffer.resize(offset + NLMSG_SPACE(sizeof(struct fib_rule_hdr)));
+    struct nlmsghdr *nlh = (struct nlmsghdr *)(buffer.data() + offset);
+    nlh->nlmsg_len = NLMSG_LENGTH(sizeof(struct fib_rule_hdr));
+    nlh->nlmsg_type = type;
+    nlh->nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | (type == RTM_NEWRULE ? NLM_F_CREATE | NLM_F_EXCL : 0);
+    nlh->nlmsg_seq = ++seq_;
+
+    struct fib_rule_hdr *frh = (struct fib_rule_hdr *)NLMSG_DATA(nlh);
+    frh->family = AF_INET;
+    frh->action = FR_ACT_TO_TBL;
+    frh->table = rule.table < 256 ? rule.table : RT_TABLE_UNSPEC;
+    if (rule.isInvert) {
+        frh->flags |= FIB_RULE_INVERT;
+    }
+
+    appendU32(buffer, offset, FRA_TABLE, rule.table);
+    if (rule.hasFwmark) {
+        appendU32(buffer, offset, FRA_FWMARK, rule.fwmark);
+    }
+    if (rule.suppressPrefixLength >= 0) {
+        appendU32(buffer, offset, FRA_SUPPRESS_PREFIXLEN, (uint32_t)rule.suppressPrefixLength);
+    }
+    if (rule.priority != 0) {
+        appendU32(buffer, offset, FRA_PRIORITY, rule.priority);
+    }
+}
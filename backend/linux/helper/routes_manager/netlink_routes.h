@@ -0,0 +1,79 @@
+#ifndef NetlinkRoutes_h
+#define NetlinkRoutes_h
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <linux/rtnetlink.h>
+
+// IPv4 routes and policy routing rules programmed with rtnetlink, without spawning "ip".
+// apply() sends the requests in batches (many messages per sendmsg) and then reads their ACKs, so adding or deleting
+// thousands of routes takes a few round trips to the kernel.
+class NetlinkRoutes
+{
+public:
+    struct Route
+    {
+        uint32_t dst = 0;           // network byte order
+        uint8_t dstLen = 0;
+        uint32_t gateway = 0;       // network byte order, 0 for the routes via the interface only
+        int ifindex = 0;
+        uint32_t table = RT_TABLE_MAIN;
+
+        bool operator==(const Route &other) const;
+        bool operator<(const Route &other) const;
+        // e.g. "10.255.255.0/24 dev tun0 table 51820", for the logs
+        std::string toString() const;
+        // true if the route covers the whole prefix (like "ip route show match")
+        bool contains(uint32_t prefix, uint8_t prefixLen) const;
+    };
+
+    struct Rule
+    {
+        uint32_t table = RT_TABLE_MAIN;
+        bool hasFwmark = false;
+        uint32_t fwmark = 0;
+        bool isInvert = false;              // "not fwmark ..."
+        int32_t suppressPrefixLength = -1;
+        uint32_t priority = 0;              // 0 - the kernel chooses it when the rule is added
+
+        // the priority is ignored, it is not known until the rule is added
+        bool isSame(const Rule &other) const;
+    };
+
+    NetlinkRoutes();
+    ~NetlinkRoutes();
+    NetlinkRoutes(const NetlinkRoutes &) = delete;
+    NetlinkRoutes &operator=(const NetlinkRoutes &) = delete;
+
+    bool isValid() const { return fd_ >= 0; }
+
+    // Adding a route or rule which already exists and deleting one which does not are not errors.
+    // Returns false if any of the requests failed, the others are applied anyway.
+    bool apply(const std::vector<Route> &addRoutes, const std::vector<Route> &deleteRoutes,
+               const std::vector<Rule> &addRules = std::vector<Rule>(), const std::vector<Rule> &deleteRules = std::vector<Rule>());
+
+    // the unicast routes of the table, RT_TABLE_UNSPEC for all the tables
+    bool dumpRoutes(uint32_t table, std::vector<Route> &outRoutes);
+    bool dumpRules(std::vector<Rule> &outRules);
+
+    // "10.0.0.0" and "8" (or "255.0.0.0"), or "10.0.0.0/8"; the host bits of the address are cleared
+    static bool parsePrefix(const std::string &ip, const std::string &mask, uint32_t &outDst, uint8_t &outDstLen);
+    static bool parsePrefix(const std::string &cidr, uint32_t &outDst, uint8_t &outDstLen);
+    static bool parseAddress(const std::string &ip, uint32_t &outAddress);
+
+private:
+    static constexpr size_t kBatchSize = 256;   // messages per sendmsg, their ACKs fit the receive buffer
+
+    int fd_;
+    uint32_t seq_;
+
+    // sends the messages of the buffer and waits for their ACKs, the sequence numbers start from firstSeq;
+    // ignoredErrors has an errno which is not an error (e.g. EEXIST for an add) for each message
+    bool sendBatch(const std::vector<char> &buffer, uint32_t firstSeq, const std::vector<int> &ignoredErrors);
+    bool dump(int type, std::vector<char> &outData);
+    void appendRouteMessage(std::vector<char> &buffer, int type, const Route &route);
+    void appendRuleMessage(std::vector<char> &buffer, int type, const Rule &rule);
+};
+
+#endif /* NetlinkRoutes_h */
@@ -1,50 +1,93 @@
 #include "routes.h"
+#include <net/if.h>
 #include "../logger.h"
-#include "../utils.h"
 
 void Routes::add(const std::string &ip, const std::string &gateway, const std::string &mask)
 {
-    RouteDescr rd;
-    rd.ip = ip;
-    rd.gateway = gateway;
-    rd.mask = mask;
-    routes_.push_back(rd);
-
-    std::string cmd = "ip route add " + ip + "/" + mask + " via " + gateway;
-    Logger::instance().out("execute: %s", cmd.c_str());
-    Utils::executeCommand(cmd);
+    NetlinkRoutes::Route route;
+    if (!NetlinkRoutes::parsePrefix(ip, mask, route.dst, route.dstLen) || !NetlinkRoutes::parseAddress(gateway, route.gateway)) {
+        Logger::instance().out("Routes::add(), invalid route %s/%s via %s", ip.c_str(), mask.c_str(), gateway.c_str());
+        return;
+    }
+    newRoutes_.insert(route);
 }
 
 void Routes::addWithInterface(const std::string &ip, const std::string &interface, const std::string &mask)
 {
-    RouteDescr rd;
-    rd.ip = ip;
-    rd.interface = interface;
-    rd.mask = mask;
-    routes_.push_back(rd);
-
-    std::string cmd = "ip route add " + ip + "/" + mask + " dev " + interface;
-    Logger::instance().out("execute: %s", cmd.c_str());
-    Utils::executeCommand(cmd);
+    NetlinkRoutes::Route route;
+    route.ifindex = if_nametoindex(interface.c_str());
+    if (!NetlinkRoutes::parsePrefix(ip, mask, route.dst, route.dstLen) || route.ifindex == 0) {
+        Logger::instance().out("Routes::addWithInterface(), invalid route %s/%s dev %s", ip.c_str(), mask.c_str(), interface.c_str());
+        return;
+    }
+    newRoutes_.insert(route);
 }
 
+bool Routes::commit()
+{
+    std::set<NetlinkRoutes::Route> installed;
+    if (!dumpInstalledRoutes(installed)) {
+        Logger::instance().out("Routes::commit(), could not dump the routing table");
+        installed = routes_;
+    }
+
+    std::vector<NetlinkRoutes::Route> addRoutes;
+    std::vector<NetlinkRoutes::Route> deleteRoutes;
+    for (const auto &route : newRoutes_) {
+        if (installed.find(route) == installed.end()) {
+            Logger::instance().out("add route: %s", route.toString().c_str());
+            addRoutes.push_back(route);
+        }
+    }
+    for (const auto &route : routes_) {
+        if (newRoutes_.find(route) == newRoutes_.end() && installed.find(route) != installed.end()) {
+            Logger::instance().out("delete route: %s", route.toString().c_str());
+            deleteRoutes.push_back(route);
+        }
+    }
+
+    routes_.swap(newRoutes_);
+    newRoutes_.clear();
+    if (addRoutes.empty() && deleteRoutes.empty()) {
+        return true;
+    }
+    return netlink_.apply(addRoutes, deleteRoutes);
+}
 
 void Routes::clear()
 {
-    for(auto const& rd: routes_)
-    {
-        if (rd.interface.empty())
-        {
-            std::string cmd = "ip route delete " + rd.ip + "/" + rd.mask + " via " + rd.gateway;
-            Logger::instance().out("execute: %s", cmd.c_str());
-            Utils::executeCommand(cmd);
+    newRoutes_.clear();
+    commit();
+}
+
+bool Routes::dumpInstalledRoutes(std::set<NetlinkRoutes::Route> &outInstalled)
+{
+    outInstalled.clear();
+    if (routes_.empty() && newRoutes_.empty()) {
+        return true;
+    }
+
+    // usually all the routes are in one table
+    uint32_t table = !routes_.empty() ? routes_.begin()->table : newRoutes_.begin()->table;
+    for (const auto *routes : { &routes_, &newRoutes_ }) {
+        for (const auto &route : *routes) {
+            if (route.table != table) {
+                table = RT_TABLE_UNSPEC;
+            }
         }
-        else
-        {
-            std::string cmd = "ip route delete " + rd.ip + "/" + rd.mask + " dev " + rd.interface;
-            Logger::instance().out("execute: %s", cmd.c_str());
-            Utils::executeCommand(cmd);
+    }
+
+    std::vector<NetlinkRoutes::Route> dumped;
+    if (!netlink_.dumpRoutes(table, dumped)) {
+        return false;
+    }
+    for (const auto &route : dumped) {
+        outInstalled.insert(route);
+        if (route.gateway != 0) {
+            NetlinkRoutes::Route viaGateway = route;
+            viaGateway.ifindex = 0;
+            outInstalled.insert(viaGateway);
         }
     }
-    routes_.clear();
+    return true;
 }
@@ -1,28 +1,32 @@
 #ifndef Routes_h
 #define Routes_h
 
+#include <set>
 #include <string>
-#include <vector>
+#include "netlink_routes.h"
 
 
-// helper for add and clear routes via system "route" command
+// helper for add and clear routes via rtnetlink
+// add() and addWithInterface() collect the wanted routes, commit() adds the new ones and deletes the ones which are
+// not wanted anymore in one netlink batch, so the routes which stay the same are not touched.
+// The diff is made against a dump of the routing table: the kernel removes the routes of an interface which goes down
+// or is recreated, and such routes are added again by the next commit().
 class Routes
 {
 public:
     void add(const std::string &ip, const std::string &gateway, const std::string &mask);
     void addWithInterface(const std::string &ip, const std::string &interface, const std::string &mask);
+    bool commit();
     void clear();
 
 private:
-    struct RouteDescr
-    {
-        std::string ip;
-        std::string gateway;
-        std::string mask;
-        std::string interface;
-    };
+    NetlinkRoutes netlink_;
+    std::set<NetlinkRoutes::Route> routes_;         // added by the previous commit(), only these ones are deleted
+    std::set<NetlinkRoutes::Route> newRoutes_;      // collected for the next commit()
 
-    std::vector<RouteDescr> routes_;
+    // the routes of the tables used by routes_ and newRoutes_; each route is also added without the interface,
+    // which the kernel resolves for the routes added via a gateway
+    bool dumpInstalledRoutes(std::set<NetlinkRoutes::Route> &outInstalled);
 };
 
 #endif /* Routes_h */
@@ -9,12 +9,12 @@ RoutesManager::RoutesManager()
 
 void RoutesManager::updateState(const CMD_SEND_CONNECT_STATUS &connectStatus)
 {
-    bool prevIsConnected = connectStatus_.isConnected;
-
-    if (prevIsConnected)
-        clearAllRoutes();
+    // the routes are diffed against the installed ones, so a reconnect with the same adapter and DNS servers
+    // does not remove and re-add them
     if (connectStatus.isConnected)
         addDnsRoutes(connectStatus);
+    else
+        clearAllRoutes();
 
     connectStatus_ = connectStatus;
 }
@@ -29,6 +29,8 @@ void RoutesManager::addDnsRoutes(const CMD_SEND_CONNECT_STATUS &connectStatus)
     // Set a /32 for each DNS server to make sure they are routed correctly.
     for (auto it = connectStatus.vpnAdapter.dnsServers.begin(); it != connectStatus.vpnAdapter.dnsServers.end(); ++it)
         dnsServersRoutes_.addWithInterface(*it, connectStatus.vpnAdapter.adapterName, "32");
+
+    dnsServersRoutes_.commit();
 }
 
 void RoutesManager::clearAllRoutes()
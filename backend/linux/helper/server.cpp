@@ -1,4 +1,5 @@
 #include "server.h"
+#include <arpa/inet.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <unistd.h>
@@ -6,6 +7,7 @@
 #include <sys/stat.h>
 #include <stdlib.h>
 #include <string>
+#include <array>
 #include <codecvt>
 #include <fstream>
 
@@ -16,7 +18,7 @@
 #include "logger.h"
 #include "ovpn.h"
 #include "execute_cmd.h"
-#include "../../posix_common/helper_commands_serialize.h"
+#include "../../posix_common/helper_commands_binary.h"
 #include "../../../client/common/utils/executable_signature/executable_signature.h"
 
 #include "utils.h"
@@ -27,14 +29,65 @@
 
 #define SOCK_PATH "/var/run/windscribe_helper_socket2"
 
-Server::Server()
+namespace {
+
+// boost throws on a malformed v1 text archive, the unused rest of a v1 payload is ignored as before
+bool isDecoded(const boost::archive::text_iarchive &)
+{
+    return true;
+}
+
+// the v2 payload must be exactly the encoded parameters of the command
+bool isDecoded(const HelperBinaryIArchive &ia)
+{
+    return ia.isOk() && ia.isAtEnd();
+}
+
+// Decodes the parameters before anything is executed. A truncated or malformed v2 payload, or one with extra bytes
+// (e.g. a batch item encoded for another command), is rejected with executed = 0.
+template<class Archive, class T>
+bool decodeCommand(int cmdId, Archive &ia, T &cmd, CMD_ANSWER &outCmdAnswer)
+{
+    ia >> cmd;
+    if (!isDecoded(ia)) {
+        Logger::instance().out("Malformed parameters of the command %d", cmdId);
+        outCmdAnswer.executed = 0;
+        return false;
+    }
+    return true;
+}
+
+// the command without parameters
+template<class Archive>
+bool decodeCommand(int cmdId, Archive &ia, CMD_ANSWER &outCmdAnswer)
+{
+    if (!isDecoded(ia)) {
+        Logger::instance().out("Unexpected parameters of the command %d", cmdId);
+        outCmdAnswer.executed = 0;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+Server::Server() : outputStrand_(boost::asio::make_strand(service_))
 {
     acceptor_ = NULL;
     //files_ = NULL;
+
+    ExecuteCmd::instance().setOutputHandler([this](unsigned long cmdId, const std::string &data, bool isFinished) {
+        CMD_OUTPUT_CHUNK chunk;
+        chunk.cmdId = cmdId;
+        chunk.data = data;
+        chunk.isFinished = isFinished;
+        boost::asio::post(outputStrand_, [this, chunk]() { sendCmdOutput(chunk); });
+    });
 }
 
 Server::~Server()
 {
+    ExecuteCmd::instance().setOutputHandler(nullptr);
     service_.stop();
 
     if (acceptor_) {
@@ -44,7 +97,7 @@ Server::~Server()
     unlink(SOCK_PATH);
 }
 
-bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf, CMD_ANSWER &outCmdAnswer)
+bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf, CMD_ANSWER &outCmdAnswer, std::optional<uint32_t> &outRequestId)
 {
     // not enough data for read command
     if (buf->size() < sizeof(int)*3) {
@@ -52,16 +105,39 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
     }
 
     const char *bufPtr = boost::asio::buffer_cast<const char*>(buf->data());
+    uint32_t magic;
+    memcpy(&magic, bufPtr, sizeof(magic));
+    const bool isV2 = (magic == HELPER_V2_MAGIC);
+
     size_t headerSize = 0;
     int cmdId;
-    memcpy(&cmdId, bufPtr + headerSize, sizeof(cmdId));
-    headerSize += sizeof(cmdId);
-    pid_t pid;
-    memcpy(&pid, bufPtr + headerSize, sizeof(pid));
-    headerSize += sizeof(pid);
-    int length;
-    memcpy(&length, bufPtr + headerSize, sizeof(length));
-    headerSize += sizeof(length);
+    size_t length;
+    if (isV2) {
+        if (buf->size() < sizeof(HELPER_V2_REQUEST_HEADER)) {
+            return false;
+        }
+        HELPER_V2_REQUEST_HEADER header;
+        memcpy(&header, bufPtr, sizeof(header));
+        if (header.length > HELPER_V2_MAX_LENGTH) {
+            Logger::instance().out("Invalid length of the command: %u", header.length);
+            sock->close();
+            return false;
+        }
+        headerSize = sizeof(header);
+        cmdId = header.cmdId;
+        length = header.length;
+        outRequestId = header.requestId;
+    } else {
+        memcpy(&cmdId, bufPtr + headerSize, sizeof(cmdId));
+        headerSize += sizeof(cmdId);
+        pid_t pid;
+        memcpy(&pid, bufPtr + headerSize, sizeof(pid));
+        headerSize += sizeof(pid);
+        int v1Length;
+        memcpy(&v1Length, bufPtr + headerSize, sizeof(v1Length));
+        headerSize += sizeof(v1Length);
+        length = v1Length;
+    }
 
     // not enough data for read command
     if (buf->size() < (headerSize + length)) {
@@ -82,15 +158,59 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
         return false;
     }
 
-    std::vector<char> vector(length);
-    memcpy(&vector[0], bufPtr + headerSize, length);
-    std::string str(vector.begin(), vector.end());
-    std::istringstream stream(str);
-    boost::archive::text_iarchive ia(stream, boost::archive::no_header);
+    if (isV2 && cmdId == HELPER_CMD_SUBSCRIBE_CMD_OUTPUT) {
+        // the command has no parameters
+        if (length == 0) {
+            std::lock_guard<std::mutex> guard(mutexOutput_);
+            outputSocket_ = sock;
+            outCmdAnswer.executed = 1;
+        }
+    } else if (isV2) {
+        // decoded in place, without copying the payload
+        HelperBinaryIArchive ia(bufPtr + headerSize, length);
+        handleCommand(cmdId, ia, outCmdAnswer);
+    } else {
+        std::istringstream stream(std::string(bufPtr + headerSize, length));
+        boost::archive::text_iarchive ia(stream, boost::archive::no_header);
+        handleCommand(cmdId, ia, outCmdAnswer);
+    }
+
+    buf->consume(headerSize + length);
 
+    return true;
+}
+
+void Server::handleBatch(const CMD_BATCH &cmd, CMD_ANSWER &outCmdAnswer)
+{
+    std::vector<CMD_ANSWER> answers;
+    outCmdAnswer.executed = 1;
+    for (const auto &item : cmd.items) {
+        CMD_ANSWER answer;
+        if (item.cmdId == HELPER_CMD_BATCH) {
+            Logger::instance().out("Nested batch commands are not supported");
+        } else {
+            HelperBinaryIArchive ia(item.data.data(), item.data.size());
+            handleCommand(item.cmdId, ia, answer);
+        }
+        answers.push_back(answer);
+        if (answer.executed == 0) {
+            outCmdAnswer.executed = 0;
+            if (cmd.isStopOnError) {
+                break;
+            }
+        }
+    }
+    outCmdAnswer.body = helperBinaryEncode(answers);
+}
+
+template<class Archive>
+void Server::handleCommand(int cmdId, Archive &ia, CMD_ANSWER &outCmdAnswer)
+{
     if (cmdId == HELPER_CMD_START_OPENVPN) {
         CMD_START_OPENVPN cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
 
         std::string script = Utils::getDnsScript(cmd.dnsManager);
         if (script.empty()) {
@@ -112,15 +232,19 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
                         Logger::instance().out("OpenVPN executable signature incorrect: %s", sigCheck.lastError().c_str());
                         outCmdAnswer.executed = 0;
                     } else {
-                        outCmdAnswer.cmdId = ExecuteCmd::instance().execute(fullCmd, "/etc/windscribe");
-                        outCmdAnswer.executed = 1;
+                        const bool isStreamed = isOutputStreamed();
+                        outCmdAnswer.cmdId = ExecuteCmd::instance().execute(fullCmd, "/etc/windscribe", isStreamed);
+                        outCmdAnswer.customInfoValue[0] = isStreamed ? 1 : 0;
+                        outCmdAnswer.executed = (outCmdAnswer.cmdId != 0) ? 1 : 0;
                     }
                 }
             }
         }
     } else if (cmdId == HELPER_CMD_GET_CMD_STATUS) {
         CMD_GET_CMD_STATUS cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
 
         bool bFinished;
         std::string log;
@@ -134,30 +258,41 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
         }
     } else if (cmdId == HELPER_CMD_CLEAR_CMDS) {
         CMD_CLEAR_CMDS cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
 
         ExecuteCmd::instance().clearCmds();
         outCmdAnswer.executed = 2;
     } else if (cmdId == HELPER_CMD_SEND_CONNECT_STATUS) {
         CMD_SEND_CONNECT_STATUS cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
 
         routesManager_.updateState(cmd);
         outCmdAnswer.executed = 1;
     } else if (cmdId == HELPER_CMD_START_WIREGUARD) {
         CMD_START_WIREGUARD cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
 
         if (wireGuardController_.start(cmd.exePath, cmd.executable, cmd.deviceName)) {
             outCmdAnswer.executed = 1;
         }
     } else if (cmdId == HELPER_CMD_STOP_WIREGUARD) {
+        if (!decodeCommand(cmdId, ia, outCmdAnswer)) {
+            return;
+        }
         if (wireGuardController_.stop()) {
             outCmdAnswer.executed = 1;
         }
     } else if (cmdId == HELPER_CMD_START_CTRLD) {
         CMD_START_CTRLD cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
 
         std::string fullCmd = Utils::getFullCommand(cmd.exePath, cmd.executable, cmd.parameters);
         if (fullCmd.empty()) {
@@ -170,13 +305,17 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
                 Logger::instance().out("ctrld executable signature incorrect: %s", sigCheck.lastError().c_str());
                 outCmdAnswer.executed = 0;
             } else {
-                outCmdAnswer.cmdId = ExecuteCmd::instance().execute(fullCmd, std::string());
-                outCmdAnswer.executed = 1;
+                const bool isStreamed = isOutputStreamed();
+                outCmdAnswer.cmdId = ExecuteCmd::instance().execute(fullCmd, std::string(), isStreamed);
+                outCmdAnswer.customInfoValue[0] = isStreamed ? 1 : 0;
+                outCmdAnswer.executed = (outCmdAnswer.cmdId != 0) ? 1 : 0;
             }
         }
     } else if (cmdId == HELPER_CMD_CONFIGURE_WIREGUARD) {
         CMD_CONFIGURE_WIREGUARD cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
 
         outCmdAnswer.executed = 0;
         if (wireGuardController_.isInitialized()) {
@@ -219,6 +358,9 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
             } while (0);
         }
     } else if (cmdId == HELPER_CMD_GET_WIREGUARD_STATUS) {
+        if (!decodeCommand(cmdId, ia, outCmdAnswer)) {
+            return;
+        }
         unsigned int errorCode = 0;
         unsigned long long bytesReceived = 0, bytesTransmitted = 0;
 
@@ -236,14 +378,18 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
         }
     } else if (cmdId == HELPER_CMD_CHANGE_MTU) {
         CMD_CHANGE_MTU cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
         Logger::instance().out("Change MTU: %d", cmd.mtu);
 
         outCmdAnswer.executed = 1;
         Utils::executeCommand("ip", {"link", "set", "dev", cmd.adapterName.c_str(), "mtu", std::to_string(cmd.mtu)});
     } else if (cmdId == HELPER_CMD_SET_DNS_LEAK_PROTECT_ENABLED) {
         CMD_SET_DNS_LEAK_PROTECT_ENABLED cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
         Logger::instance().out("Set DNS leak protect: %s", cmd.enabled ? "enabled" : "disabled");
 
         // We only handle the down case; the 'up' trigger for this script happens in the DNS manager script
@@ -253,7 +399,9 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
         }
     } else if (cmdId == HELPER_CMD_TASK_KILL) {
         CMD_TASK_KILL cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
 
         if (cmd.target == kTargetWindscribe) {
             Logger::instance().out("Killing Windscribe processes");
@@ -288,18 +436,28 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
             outCmdAnswer.executed = 0;
         }
     } else if (cmdId == HELPER_CMD_CHECK_FOR_WIREGUARD_KERNEL_MODULE) {
+        if (!decodeCommand(cmdId, ia, outCmdAnswer)) {
+            return;
+        }
         outCmdAnswer.executed = Utils::executeCommand("modprobe", {"wireguard"}) ? 0 : 1;
         Logger::instance().out("WireGuard kernel module: %s", outCmdAnswer.executed ? "available" : "not available");
     } else if (cmdId == HELPER_CMD_CLEAR_FIREWALL_RULES) {
         CMD_CLEAR_FIREWALL_RULES cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
         Logger::instance().out("Clear firewall rules");
         Utils::executeCommand("rm", {"-f", "/etc/windscribe/rules.v4"});
         Utils::executeCommand("rm", {"-f", "/etc/windscribe/rules.v6"});
+        Utils::executeCommand("rm", {"-f", "/etc/windscribe/ipset.v4"});
+        // fails if the set does not exist or the rules referencing it are not removed
+        Utils::executeCommand("ipset", {"destroy", FIREWALL_IPSET_NAME});
         outCmdAnswer.executed = 1;
     } else if (cmdId == HELPER_CMD_CHECK_FIREWALL_STATE) {
         CMD_CHECK_FIREWALL_STATE cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
 
         outCmdAnswer.executed = 1;
         if (Utils::executeCommand("iptables", {"--check", "INPUT", "-j", "windscribe_input", "-m", "comment", "--comment", cmd.tag.c_str()}, &outCmdAnswer.body)) {
@@ -309,7 +467,9 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
         }
     } else if (cmdId == HELPER_CMD_SET_FIREWALL_RULES) {
         CMD_SET_FIREWALL_RULES cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
         Logger::instance().out("Set firewall rules");
 
         int fd;
@@ -338,7 +498,9 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
             }
         }
     } else if (cmdId == HELPER_CMD_GET_FIREWALL_RULES) { CMD_GET_FIREWALL_RULES cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
         std::string filename;
 
         if (cmd.ipVersion == kIpv4) {
@@ -354,6 +516,59 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
         buffer << ifs.rdbuf();
         outCmdAnswer.body = buffer.str();
         outCmdAnswer.executed = 1;
+    } else if (cmdId == HELPER_CMD_UPDATE_FIREWALL_IPSET) {
+        CMD_UPDATE_FIREWALL_IPSET cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
+        Logger::instance().out("Update firewall ipset, replace: %d, add: %zu, delete: %zu", cmd.isReplace, cmd.addIps.size(), cmd.deleteIps.size());
+
+        // the set members are applied by one ipset call in a single transaction
+        std::string script = std::string("create ") + FIREWALL_IPSET_NAME + " hash:ip family inet hashsize 1024 maxelem 1048576\n";
+        if (cmd.isReplace) {
+            script += std::string("flush ") + FIREWALL_IPSET_NAME + "\n";
+        }
+        bool isValid = true;
+        auto appendIps = [&script, &isValid](const char *command, const std::vector<std::string> &ips) {
+            struct in_addr addr;
+            for (const auto &ip : ips) {
+                if (inet_pton(AF_INET, ip.c_str(), &addr) != 1) {
+                    isValid = false;
+                    return;
+                }
+                script += std::string(command) + " " + FIREWALL_IPSET_NAME + " " + ip + "\n";
+            }
+        };
+        appendIps("del", cmd.deleteIps);
+        appendIps("add", cmd.addIps);
+
+        outCmdAnswer.executed = 0;
+        if (!isValid) {
+            Logger::instance().out("Invalid IP address in the firewall ipset update");
+        } else {
+            std::ofstream ofs("/etc/windscribe/ipset.update", std::ios::out | std::ios::trunc);
+            ofs << script;
+            ofs.close();
+            if (!ofs) {
+                Logger::instance().out("Could not write the firewall ipset update");
+            } else {
+                outCmdAnswer.exitCode = Utils::executeCommand("ipset -exist restore < /etc/windscribe/ipset.update");
+                if (outCmdAnswer.exitCode == 0) {
+                    // saved to restore the set before the rules on boot
+                    Utils::executeCommand(std::string("ipset save ") + FIREWALL_IPSET_NAME + " > /etc/windscribe/ipset.v4");
+                    outCmdAnswer.executed = 1;
+                } else {
+                    Logger::instance().out("ipset restore failed: %d", outCmdAnswer.exitCode);
+                }
+            }
+            Utils::executeCommand("rm", {"-f", "/etc/windscribe/ipset.update"});
+        }
+    } else if (cmdId == HELPER_CMD_BATCH) {
+        CMD_BATCH cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
+        handleBatch(cmd, outCmdAnswer);
     } else {
         // these commands are not used in Linux:
         //
@@ -370,10 +585,6 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
         // HELPER_CMD_INSTALLER_EXECUTE_COPY_FILE
         // HELPER_CMD_APPLY_CUSTOM_DNS
     }
-
-    buf->consume(headerSize + length);
-
-    return true;
 }
 
 void Server::receiveCmdHandle(socket_ptr sock, boost::shared_ptr<boost::asio::streambuf> buf, const boost::system::error_code& ec, std::size_t bytes_transferred)
@@ -386,7 +597,8 @@ void Server::receiveCmdHandle(socket_ptr sock, boost::shared_ptr<boost::asio::st
         while (true)
         {
             CMD_ANSWER cmdAnswer;
-            if (!readAndHandleCommand(sock, buf.get(), cmdAnswer))
+            std::optional<uint32_t> requestId;
+            if (!readAndHandleCommand(sock, buf.get(), cmdAnswer, requestId))
             {
                 // goto receive next commands
                 boost::asio::async_read(*sock, *buf, boost::asio::transfer_at_least(1),
@@ -395,10 +607,9 @@ void Server::receiveCmdHandle(socket_ptr sock, boost::shared_ptr<boost::asio::st
             }
             else
             {
-                if (!sendAnswerCmd(sock, cmdAnswer))
+                if (!sendAnswerCmd(sock, cmdAnswer, requestId))
                 {
-                    Logger::instance().out("client app disconnected");
-                    HelperSecurity::instance().reset();
+                    onClientDisconnected(sock);
                     return;
                 }
             }
@@ -406,8 +617,18 @@ void Server::receiveCmdHandle(socket_ptr sock, boost::shared_ptr<boost::asio::st
     }
     else
     {
-        Logger::instance().out("client app disconnected");
-        HelperSecurity::instance().reset();
+        onClientDisconnected(sock);
+    }
+}
+
+void Server::onClientDisconnected(socket_ptr sock)
+{
+    Logger::instance().out("client app disconnected");
+    HelperSecurity::instance().reset();
+
+    std::lock_guard<std::mutex> guard(mutexOutput_);
+    if (outputSocket_ == sock) {
+        outputSocket_.reset();
     }
 }
 
@@ -437,15 +658,27 @@ void Server::runService()
     service_.run();
 }
 
-bool Server::sendAnswerCmd(socket_ptr sock, const CMD_ANSWER &cmdAnswer)
+bool Server::sendAnswerCmd(socket_ptr sock, const CMD_ANSWER &cmdAnswer, const std::optional<uint32_t> &requestId)
 {
+    boost::system::error_code er;
+    if (requestId) {
+        HELPER_V2_ANSWER_HEADER header;
+        const std::string str = helperBinaryEncode(cmdAnswer);
+        header.magic = HELPER_V2_MAGIC;
+        header.requestId = *requestId;
+        header.length = (uint32_t)str.length();
+        const std::array<boost::asio::const_buffer, 2> buffers = { boost::asio::buffer(&header, sizeof(header)), boost::asio::buffer(str) };
+        std::lock_guard<std::mutex> guard(mutexOutput_);
+        boost::asio::write(*sock, buffers, er);
+        return !er.value();
+    }
+
     std::stringstream stream;
     boost::archive::text_oarchive oa(stream, boost::archive::no_header);
     oa << cmdAnswer;
     std::string str = stream.str();
     int length = (int)str.length();
     // send answer to client
-    boost::system::error_code er;
     boost::asio::write(*sock, boost::asio::buffer(&length, sizeof(length)), boost::asio::transfer_exactly(sizeof(length)), er);
     if (er.value()) {
         return false;
@@ -458,6 +691,32 @@ bool Server::sendAnswerCmd(socket_ptr sock, const CMD_ANSWER &cmdAnswer)
     return true;
 }
 
+bool Server::isOutputStreamed()
+{
+    std::lock_guard<std::mutex> guard(mutexOutput_);
+    return outputSocket_ != nullptr;
+}
+
+void Server::sendCmdOutput(const CMD_OUTPUT_CHUNK &chunk)
+{
+    HELPER_V2_ANSWER_HEADER header;
+    const std::string str = helperBinaryEncode(chunk);
+    header.magic = HELPER_V2_MAGIC;
+    header.requestId = HELPER_V2_PUSH_REQUEST_ID;
+    header.length = (uint32_t)str.length();
+    const std::array<boost::asio::const_buffer, 2> buffers = { boost::asio::buffer(&header, sizeof(header)), boost::asio::buffer(str) };
+
+    std::lock_guard<std::mutex> guard(mutexOutput_);
+    if (!outputSocket_) {
+        return;
+    }
+    boost::system::error_code er;
+    boost::asio::write(*outputSocket_, buffers, er);
+    if (er.value()) {
+        outputSocket_.reset();
+    }
+}
+
 void Server::run()
 {
     auto res = system("mkdir -p /var/run"); // res is necessary to avoid no-discard warning.
@@ -8,6 +8,8 @@
 #include <boost/asio.hpp>
 #include <boost/thread.hpp>
 #include <list>
+#include <mutex>
+#include <optional>
 
 #include "../../posix_common/helper_commands.h"
 #include "routes_manager/routes_manager.h"
@@ -32,15 +34,29 @@ private:
     WireGuardController wireGuardController_;
     boost::asio::io_service service_;
     boost::asio::local::stream_protocol::acceptor *acceptor_;
+
+    // the connection subscribed with HELPER_CMD_SUBSCRIBE_CMD_OUTPUT; mutexOutput_ also serializes the v2 writes,
+    // the output chunks are sent from the service threads in between the answers
+    socket_ptr outputSocket_;
+    std::mutex mutexOutput_;
+    // keeps the order of the chunks, the service runs in several threads
+    boost::asio::strand<boost::asio::io_service::executor_type> outputStrand_;
     
-    bool readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf, CMD_ANSWER &outCmdAnswer);
+    // requestId is set for the v2 requests, the answer is sent in the same protocol
+    bool readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf, CMD_ANSWER &outCmdAnswer, std::optional<uint32_t> &outRequestId);
+    template<class Archive>
+    void handleCommand(int cmdId, Archive &ia, CMD_ANSWER &outCmdAnswer);
+    void handleBatch(const CMD_BATCH &cmd, CMD_ANSWER &outCmdAnswer);
     
     void receiveCmdHandle(socket_ptr sock, boost::shared_ptr<boost::asio::streambuf> buf, const boost::system::error_code& ec, std::size_t bytes_transferred);
     void acceptHandler(const boost::system::error_code & ec, socket_ptr sock);
     void startAccept();
     void runService();
     
-    bool sendAnswerCmd(socket_ptr sock, const CMD_ANSWER &cmdAnswer);
+    bool sendAnswerCmd(socket_ptr sock, const CMD_ANSWER &cmdAnswer, const std::optional<uint32_t> &requestId);
+    bool isOutputStreamed();
+    void sendCmdOutput(const CMD_OUTPUT_CHUNK &chunk);
+    void onClientDisconnected(socket_ptr sock);
 };
 
 #endif /* defined(____Server__) */
@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "execute_cmd.h"
+
+// The argument tokenizer and the process supervisor of ExecuteCmd.
+
+namespace
+{
+
+int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+void checkSplit(const std::string &cmd, const std::vector<std::string> &expected)
+{
+    std::vector<std::string> args;
+    if (!ExecuteCmd::splitArguments(cmd, args) || args != expected) {
+        fprintf(stderr, "FAIL splitArguments(%s):", cmd.c_str());
+        for (const auto &arg : args) {
+            fprintf(stderr, " [%s]", arg.c_str());
+        }
+        fprintf(stderr, "\n");
+        failures++;
+    }
+}
+
+// waits until the command is finished, returns its output
+bool waitFinished(unsigned long cmdId, std::string &log)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (std::chrono::steady_clock::now() < deadline) {
+        bool bFinished = false;
+        ExecuteCmd::instance().getStatus(cmdId, bFinished, log);
+        if (bFinished) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+void testSplitArguments()
+{
+    checkSplit("", {});
+    checkSplit(" \t\n ", {});
+    checkSplit("openvpn  --config\tconfig.ovpn\n", { "openvpn", "--config", "config.ovpn" });
+
+    // nested quotes
+    checkSplit("sh -c \"echo 'a b'\"", { "sh", "-c", "echo 'a b'" });
+    checkSplit("sh -c 'echo \"a b\"'", { "sh", "-c", "echo \"a b\"" });
+    checkSplit("\"a \\\"b\\\" c\"", { "a \"b\" c" });
+    checkSplit("'it'\"'\"'s'", { "it's" });
+    checkSplit("a\"b c\"d 'e'f", { "ab cd", "ef" });
+
+    // backslashes: escape anything outside of the quotes, only \" and \\ in the double quotes, nothing in the single ones
+    checkSplit("a\\ b c\\\\d", { "a b", "c\\d" });
+    checkSplit("\"a\\b\\\\c\"", { "a\\b\\c" });
+    checkSplit("'a\\b\\'", { "a\\b\\" });
+    // a trailing backslash has nothing to escape and is kept
+    checkSplit("abc\\", { "abc\\" });
+    checkSplit("abc \\", { "abc", "\\" });
+
+    // empty arguments
+    checkSplit("a \"\" b", { "a", "", "b" });
+    checkSplit("''", { "" });
+    checkSplit("a '' \"\"", { "a", "", "" });
+
+    // paths with spaces
+    checkSplit("\"/opt/windscribe dir/windscribeopenvpn\" --config \"/etc/windscribe/my config.ovpn\"",
+               { "/opt/windscribe dir/windscribeopenvpn", "--config", "/etc/windscribe/my config.ovpn" });
+    checkSplit("/opt/windscribe\\ dir/windscribectrld run --config='/tmp/a b.toml'",
+               { "/opt/windscribe dir/windscribectrld", "run", "--config=/tmp/a b.toml" });
+
+    // unterminated quotes
+    std::vector<std::string> args;
+    CHECK(!ExecuteCmd::splitArguments("a \"b c", args));
+    CHECK(!ExecuteCmd::splitArguments("a 'b", args));
+    CHECK(!ExecuteCmd::splitArguments("\"a\\\"", args));
+}
+
+void testOutputMerge()
+{
+    // stdout and stderr share the pipe, so the lines keep the order they were written in
+    const unsigned long cmdId = ExecuteCmd::instance().execute("sh -c 'echo out1; echo err1 >&2; echo out2; echo err2 >&2'");
+    CHECK(cmdId != 0);
+    std::string log;
+    CHECK(waitFinished(cmdId, log));
+    CHECK(log == "out1\nerr1\nout2\nerr2\n");
+
+    // the finished command is forgotten after its status is read
+    bool bFinished = false;
+    log = "unchanged";
+    ExecuteCmd::instance().getStatus(cmdId, bFinished, log);
+    CHECK(!bFinished && log == "unchanged");
+}
+
+void testExitCode()
+{
+    // a failed process is finished like a successful one, with its output
+    const unsigned long cmdId = ExecuteCmd::instance().execute("sh -c 'echo failing >&2; exit 3'");
+    CHECK(cmdId != 0);
+    std::string log;
+    CHECK(waitFinished(cmdId, log));
+    CHECK(log == "failing\n");
+
+    // killed by a signal
+    const unsigned long killedId = ExecuteCmd::instance().execute("sh -c 'kill -9 $$'");
+    CHECK(killedId != 0);
+    CHECK(waitFinished(killedId, log));
+    CHECK(log.empty());
+
+    // a process which closes its output before it exits is reaped later
+    const unsigned long closedId = ExecuteCmd::instance().execute("sh -c 'exec >&- 2>&-; sleep 0.2; exit 1'");
+    CHECK(closedId != 0);
+    CHECK(waitFinished(closedId, log));
+
+    // the executable is not found or the command can't be parsed, nothing is started
+    CHECK(ExecuteCmd::instance().execute("/nonexistent/windscribe-test-binary --arg") == 0);
+    CHECK(ExecuteCmd::instance().execute("sh -c 'unterminated") == 0);
+    CHECK(ExecuteCmd::instance().execute("  ") == 0);
+}
+
+void testWorkingDirectory()
+{
+    const unsigned long cmdId = ExecuteCmd::instance().execute("pwd", "/tmp");
+    CHECK(cmdId != 0);
+    std::string log;
+    CHECK(waitFinished(cmdId, log));
+    CHECK(log == "/tmp\n");
+}
+
+void testStreamed()
+{
+    std::mutex mutex;
+    std::string output;
+    std::atomic<bool> isFinished(false);
+    unsigned long handledId = 0;
+    ExecuteCmd::instance().setOutputHandler([&](unsigned long cmdId, const std::string &data, bool bFinished) {
+        std::lock_guard<std::mutex> guard(mutex);
+        handledId = cmdId;
+        output += data;
+        if (bFinished) {
+            isFinished = true;
+        }
+    });
+
+    const unsigned long cmdId = ExecuteCmd::instance().execute("sh -c 'echo one; sleep 0.1; echo two >&2'", "", true);
+    CHECK(cmdId != 0);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!isFinished && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK(isFinished);
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        CHECK(handledId == cmdId);
+        CHECK(output == "one\ntwo\n");
+    }
+
+    // the output of a streamed command is not accumulated
+    bool bFinished = false;
+    std::string log;
+    ExecuteCmd::instance().getStatus(cmdId, bFinished, log);
+    CHECK(bFinished && log.empty());
+
+    ExecuteCmd::instance().setOutputHandler(nullptr);
+}
+
+void testClearWhileRunning()
+{
+    std::atomic<int> handlerCalls(0);
+    ExecuteCmd::instance().setOutputHandler([&](unsigned long, const std::string &, bool) { handlerCalls++; });
+
+    // the processes keep running after clearCmds(), their pipes stay open, so a write does not kill them with SIGPIPE
+    const std::string marker = "/tmp/windscribe_executecmd_test_" + std::to_string(getpid());
+    unlink(marker.c_str());
+    const unsigned long cmdId = ExecuteCmd::instance().execute("sh -c 'echo before; sleep 0.3; echo after; touch " + marker + "'");
+    const unsigned long streamedId = ExecuteCmd::instance().execute("sh -c 'sleep 0.3; echo streamed'", "", true);
+    CHECK(cmdId != 0 && streamedId != 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    const int callsBeforeClear = handlerCalls;
+    ExecuteCmd::instance().clearCmds();
+
+    bool bFinished = false;
+    std::string log = "unchanged";
+    ExecuteCmd::instance().getStatus(cmdId, bFinished, log);
+    CHECK(!bFinished && log == "unchanged");
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (access(marker.c_str(), F_OK) != 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK(access(marker.c_str(), F_OK) == 0);
+    unlink(marker.c_str());
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    // the output and the end of the cleared commands are discarded
+    ExecuteCmd::instance().getStatus(cmdId, bFinished, log);
+    CHECK(!bFinished && log == "unchanged");
+    ExecuteCmd::instance().getStatus(streamedId, bFinished, log);
+    CHECK(!bFinished && log == "unchanged");
+    CHECK(handlerCalls == callsBeforeClear);
+    ExecuteCmd::instance().setOutputHandler(nullptr);
+
+    // the new commands get new ids and work as usual
+    const unsigned long nextId = ExecuteCmd::instance().execute("echo next");
+    CHECK(nextId > streamedId);
+    CHECK(waitFinished(nextId, log));
+    CHECK(log == "next\n");
+}
+
+} // namespace
+
+int main()
+{
+    testSplitArguments();
+    testOutputMerge();
+    testExitCode();
+    testWorkingDirectory();
+    testStreamed();
+    testClearWhileRunning();
+
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
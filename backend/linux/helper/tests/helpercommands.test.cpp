@@ -0,0 +1,179 @@
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "../../posix_common/helper_commands_binary.h"
+
+// Round trips of the v2 codec and the rejection of truncated, malformed and oversized payloads,
+// which the helper must not execute.
+
+namespace
+{
+
+int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+CMD_START_OPENVPN makeStartOpenVpn()
+{
+    CMD_START_OPENVPN cmd;
+    cmd.exePath = "/opt/windscribe";
+    cmd.executable = "windscribeopenvpn";
+    cmd.config = std::string(1000, 'c') + std::string("\0\x80\xff", 3);
+    cmd.arguments = "";
+    cmd.dnsManager = kNetworkManager;
+    cmd.isCustomConfig = true;
+    return cmd;
+}
+
+CMD_BATCH makeBatch()
+{
+    CMD_CHANGE_MTU mtu;
+    mtu.mtu = -1;
+    mtu.adapterName = "wg0";
+    CMD_UPDATE_FIREWALL_IPSET ipset;
+    ipset.isReplace = false;
+    ipset.addIps = { "10.0.0.1", "", "192.168.255.255" };
+
+    CMD_BATCH batch;
+    batch.isStopOnError = true;
+    batch.items.push_back({ HELPER_CMD_CHANGE_MTU, helperBinaryEncode(mtu) });
+    batch.items.push_back({ HELPER_CMD_UPDATE_FIREWALL_IPSET, helperBinaryEncode(ipset) });
+    batch.items.push_back({ HELPER_CMD_CLEAR_CMDS, helperBinaryEncode(CMD_CLEAR_CMDS()) });
+    return batch;
+}
+
+void testRoundTrip()
+{
+    const CMD_START_OPENVPN openVpn = makeStartOpenVpn();
+    const std::string openVpnData = helperBinaryEncode(openVpn);
+    CMD_START_OPENVPN openVpnDecoded;
+    CHECK(helperBinaryDecode(openVpnData.data(), openVpnData.size(), openVpnDecoded));
+    CHECK(openVpnDecoded.exePath == openVpn.exePath);
+    CHECK(openVpnDecoded.executable == openVpn.executable);
+    CHECK(openVpnDecoded.config == openVpn.config);
+    CHECK(openVpnDecoded.arguments.empty());
+    CHECK(openVpnDecoded.dnsManager == kNetworkManager);
+    CHECK(openVpnDecoded.isCustomConfig);
+
+    const CMD_BATCH batch = makeBatch();
+    const std::string batchData = helperBinaryEncode(batch);
+    CMD_BATCH batchDecoded;
+    CHECK(helperBinaryDecode(batchData.data(), batchData.size(), batchDecoded));
+    CHECK(batchDecoded.isStopOnError);
+    CHECK(batchDecoded.items.size() == 3);
+    if (batchDecoded.items.size() == 3) {
+        CMD_CHANGE_MTU mtu;
+        CHECK(helperBinaryDecode(batchDecoded.items[0].data.data(), batchDecoded.items[0].data.size(), mtu));
+        CHECK(mtu.mtu == -1 && mtu.adapterName == "wg0");
+        CMD_UPDATE_FIREWALL_IPSET ipset;
+        CHECK(batchDecoded.items[1].cmdId == HELPER_CMD_UPDATE_FIREWALL_IPSET);
+        CHECK(helperBinaryDecode(batchDecoded.items[1].data.data(), batchDecoded.items[1].data.size(), ipset));
+        CHECK(ipset.addIps == std::vector<std::string>({ "10.0.0.1", "", "192.168.255.255" }));
+        CHECK(ipset.deleteIps.empty());
+        CHECK(batchDecoded.items[2].data.empty());
+    }
+
+    CMD_ANSWER answer;
+    answer.cmdId = 0xFFFFFFFFul;
+    answer.executed = 2;
+    answer.customInfoValue[0] = 0xFFFFFFFFFFFFFFFFull;
+    answer.customInfoValue[1] = 1;
+    answer.body = "output";
+    answer.exitCode = -2147483647 - 1;
+    const std::string answerData = helperBinaryEncode(std::vector<CMD_ANSWER>({ answer, CMD_ANSWER() }));
+    std::vector<CMD_ANSWER> answersDecoded;
+    CHECK(helperBinaryDecode(answerData.data(), answerData.size(), answersDecoded));
+    CHECK(answersDecoded.size() == 2);
+    if (answersDecoded.size() == 2) {
+        CHECK(answersDecoded[0].cmdId == answer.cmdId);
+        CHECK(answersDecoded[0].executed == 2);
+        CHECK(answersDecoded[0].customInfoValue[0] == answer.customInfoValue[0]);
+        CHECK(answersDecoded[0].customInfoValue[1] == 1);
+        CHECK(answersDecoded[0].body == "output");
+        CHECK(answersDecoded[0].exitCode == answer.exitCode);
+        CHECK(answersDecoded[1].exitCode == -1);
+    }
+}
+
+void testTruncated()
+{
+    // every prefix of a valid payload is rejected, without reading past its end
+    const std::string data = helperBinaryEncode(makeBatch());
+    for (size_t len = 0; len < data.size(); ++len) {
+        const std::vector<char> prefix(data.begin(), data.begin() + len);
+        CMD_BATCH cmd;
+        if (helperBinaryDecode(prefix.data(), prefix.size(), cmd)) {
+            fprintf(stderr, "the prefix of %zu of %zu bytes is decoded\n", len, data.size());
+            failures++;
+        }
+    }
+
+    const std::string openVpnData = helperBinaryEncode(makeStartOpenVpn());
+    for (size_t len = 0; len < openVpnData.size(); ++len) {
+        CMD_START_OPENVPN cmd;
+        CHECK(!helperBinaryDecode(openVpnData.data(), len, cmd) || len == openVpnData.size());
+    }
+}
+
+void testOversized()
+{
+    // the extra bytes after the struct, e.g. a payload encoded for another command
+    std::string data = helperBinaryEncode(makeStartOpenVpn());
+    data.push_back(0);
+    CMD_START_OPENVPN openVpn;
+    CHECK(!helperBinaryDecode(data.data(), data.size(), openVpn));
+
+    CMD_CHANGE_MTU mtu;
+    mtu.mtu = 1400;
+    mtu.adapterName = "tun0";
+    const std::string mtuData = helperBinaryEncode(mtu);
+    CMD_GET_CMD_STATUS status;
+    CHECK(!helperBinaryDecode(mtuData.data(), mtuData.size(), status));
+    CMD_CLEAR_CMDS clear;
+    CHECK(!helperBinaryDecode(mtuData.data(), mtuData.size(), clear));
+    CHECK(helperBinaryDecode(mtuData.data(), 0, clear));
+
+    // a size prefix larger than the rest of the payload is rejected before anything is allocated
+    std::string hugeString;
+    HelperBinaryOArchive oa(hugeString);
+    oa << (uint64_t)HELPER_V2_MAX_LENGTH << std::string("abc");
+    CMD_INSTALLER_REMOVE_OLD_INSTALL removeOldInstall;
+    CHECK(!helperBinaryDecode(hugeString.data(), hugeString.size(), removeOldInstall));
+    CHECK(removeOldInstall.path.empty());
+
+    std::string hugeVector;
+    HelperBinaryOArchive oaVector(hugeVector);
+    oaVector << true << (uint64_t)0xFFFFFFFFFFFFFFFFull;
+    CMD_BATCH batch;
+    CHECK(!helperBinaryDecode(hugeVector.data(), hugeVector.size(), batch));
+    CHECK(batch.items.empty());
+
+    // a varint longer than 64 bits
+    const std::string longVarint(11, (char)0x80);
+    CMD_GET_CMD_STATUS longStatus;
+    CHECK(!helperBinaryDecode(longVarint.data(), longVarint.size(), longStatus));
+}
+
+} // namespace
+
+int main()
+{
+    testRoundTrip();
+    testTruncated();
+    testOversized();
+
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,203 @@
+#include <net/if.h>
+#include <sched.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "routes_manager/netlink_routes.h"
+#include "routes_manager/routes.h"
+#include "utils.h"
+
+// Adds and removes kRoutesCount routes in a new network namespace:
+// with "ip route add/delete" per route (as the helper did before) and with NetlinkRoutes batches.
+// Needs root (CAP_NET_ADMIN and CAP_SYS_ADMIN for unshare), returns kSkipCode without it.
+
+namespace
+{
+
+constexpr int kRoutesCount = 5000;
+constexpr int kSkipCode = 77;
+
+int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+std::string routeIp(int i)
+{
+    return "10." + std::to_string(100 + i / 65536) + "." + std::to_string((i / 256) % 256) + "." + std::to_string(i % 256);
+}
+
+size_t countRoutes(NetlinkRoutes &netlink, int ifindex)
+{
+    std::vector<NetlinkRoutes::Route> routes;
+    netlink.dumpRoutes(RT_TABLE_MAIN, routes);
+    return std::count_if(routes.begin(), routes.end(), [ifindex](const NetlinkRoutes::Route &r) { return r.ifindex == ifindex && r.dstLen == 32; });
+}
+
+double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void benchIpCommand(NetlinkRoutes &netlink, int ifindex)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kRoutesCount; ++i) {
+        Utils::executeCommand("ip route add " + routeIp(i) + "/32 dev lo");
+    }
+    const double addMs = elapsedMs(start);
+    CHECK(countRoutes(netlink, ifindex) == kRoutesCount);
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kRoutesCount; ++i) {
+        Utils::executeCommand("ip route delete " + routeIp(i) + "/32 dev lo");
+    }
+    const double deleteMs = elapsedMs(start);
+    CHECK(countRoutes(netlink, ifindex) == 0);
+
+    printf("ip route:      add %d routes %.1f ms, delete %.1f ms\n", kRoutesCount, addMs, deleteMs);
+}
+
+void benchNetlink(NetlinkRoutes &netlink, int ifindex)
+{
+    std::vector<NetlinkRoutes::Route> routes(kRoutesCount);
+    for (int i = 0; i < kRoutesCount; ++i) {
+        CHECK(NetlinkRoutes::parsePrefix(routeIp(i), "32", routes[i].dst, routes[i].dstLen));
+        routes[i].ifindex = ifindex;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    CHECK(netlink.apply(routes, {}));
+    const double addMs = elapsedMs(start);
+    CHECK(countRoutes(netlink, ifindex) == kRoutesCount);
+
+    // the existing routes are not errors
+    CHECK(netlink.apply(routes, {}));
+
+    start = std::chrono::steady_clock::now();
+    CHECK(netlink.apply({}, routes));
+    const double deleteMs = elapsedMs(start);
+    CHECK(countRoutes(netlink, ifindex) == 0);
+
+    // neither are the missing ones
+    CHECK(netlink.apply({}, routes));
+
+    printf("rtnetlink:     add %d routes %.1f ms, delete %.1f ms\n", kRoutesCount, addMs, deleteMs);
+}
+
+// the routes which stay the same between the commits are not touched
+void testRoutesDiff(NetlinkRoutes &netlink, int ifindex)
+{
+    Routes routes;
+    for (int i = 0; i < kRoutesCount; ++i) {
+        routes.addWithInterface(routeIp(i), "lo", "32");
+    }
+    auto start = std::chrono::steady_clock::now();
+    CHECK(routes.commit());
+    const double firstMs = elapsedMs(start);
+    CHECK(countRoutes(netlink, ifindex) == kRoutesCount);
+
+    for (int i = 1; i < kRoutesCount; ++i) {
+        routes.addWithInterface(routeIp(i), "lo", "32");
+    }
+    routes.addWithInterface(routeIp(kRoutesCount), "lo", "32");
+    start = std::chrono::steady_clock::now();
+    CHECK(routes.commit());
+    const double diffMs = elapsedMs(start);
+
+    std::vector<NetlinkRoutes::Route> installed;
+    netlink.dumpRoutes(RT_TABLE_MAIN, installed);
+    uint32_t first, last;
+    uint8_t len;
+    NetlinkRoutes::parsePrefix(routeIp(0), "32", first, len);
+    NetlinkRoutes::parsePrefix(routeIp(kRoutesCount), "32", last, len);
+    CHECK(std::none_of(installed.begin(), installed.end(), [first](const NetlinkRoutes::Route &r) { return r.dst == first; }));
+    CHECK(std::any_of(installed.begin(), installed.end(), [last](const NetlinkRoutes::Route &r) { return r.dst == last; }));
+
+    // a route removed behind the back of Routes (e.g. with its interface) is added again by the next commit
+    NetlinkRoutes::Route removed;
+    removed.dst = last;
+    removed.dstLen = 32;
+    removed.ifindex = ifindex;
+    CHECK(netlink.apply(std::vector<NetlinkRoutes::Route>(), { removed }));
+    CHECK(countRoutes(netlink, ifindex) == kRoutesCount - 1);
+    for (int i = 1; i <= kRoutesCount; ++i) {
+        routes.addWithInterface(routeIp(i), "lo", "32");
+    }
+    CHECK(routes.commit());
+    CHECK(countRoutes(netlink, ifindex) == kRoutesCount);
+
+    routes.clear();
+    CHECK(countRoutes(netlink, ifindex) == 0);
+
+    printf("Routes commit: %d routes %.1f ms, then 1 added and 1 deleted %.1f ms\n", kRoutesCount, firstMs, diffMs);
+}
+
+// the rules of WireGuardAdapter
+void testRules(NetlinkRoutes &netlink, int ifindex)
+{
+    const uint32_t fwmark = 51820;
+    NetlinkRoutes::Route route;
+    route.ifindex = ifindex;
+    route.table = fwmark;
+    NetlinkRoutes::Rule fwmarkRule;
+    fwmarkRule.table = fwmark;
+    fwmarkRule.hasFwmark = true;
+    fwmarkRule.fwmark = fwmark;
+    fwmarkRule.isInvert = true;
+    NetlinkRoutes::Rule suppressRule;
+    suppressRule.suppressPrefixLength = 0;
+    CHECK(netlink.apply({ route }, {}, { fwmarkRule, suppressRule }));
+
+    std::vector<NetlinkRoutes::Route> tableRoutes;
+    CHECK(netlink.dumpRoutes(fwmark, tableRoutes));
+    CHECK(tableRoutes.size() == 1 && tableRoutes[0] == route);
+    std::vector<NetlinkRoutes::Rule> rules;
+    CHECK(netlink.dumpRules(rules));
+    CHECK(std::count_if(rules.begin(), rules.end(), [&](const NetlinkRoutes::Rule &r) { return r.isSame(fwmarkRule); }) == 1);
+    CHECK(std::count_if(rules.begin(), rules.end(), [&](const NetlinkRoutes::Rule &r) { return r.isSame(suppressRule); }) == 1);
+
+    CHECK(netlink.apply({}, { route }, {}, { fwmarkRule, suppressRule }));
+    CHECK(netlink.dumpRules(rules));
+    CHECK(std::none_of(rules.begin(), rules.end(), [&](const NetlinkRoutes::Rule &r) { return r.isSame(fwmarkRule) || r.isSame(suppressRule); }));
+}
+
+} // namespace
+
+int main()
+{
+    if (geteuid() != 0 || unshare(CLONE_NEWNET) != 0) {
+        printf("SKIP: needs root to create a network namespace\n");
+        return kSkipCode;
+    }
+    if (Utils::executeCommand("ip link set lo up") != 0) {
+        printf("SKIP: ip is not available\n");
+        return kSkipCode;
+    }
+
+    NetlinkRoutes netlink;
+    CHECK(netlink.isValid());
+    const int ifindex = if_nametoindex("lo");
+
+    benchIpCommand(netlink, ifindex);
+    benchNetlink(netlink, ifindex);
+    testRoutesDiff(netlink, ifindex);
+    testRules(netlink, ifindex);
+
+    if (failures != 0) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("PASS\n");
+    return 0;
+}
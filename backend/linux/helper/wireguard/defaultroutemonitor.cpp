@@ -1,9 +1,9 @@
 #include "defaultroutemonitor.h"
 #include "../logger.h"
-#include "../utils.h"
 #include <boost/algorithm/string.hpp>
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
+#include <arpa/inet.h>
 #include <sys/socket.h>
 #include <linux/netlink.h>
 #include <linux/rtnetlink.h>
@@ -81,6 +81,8 @@ void DefaultRouteMonitor::stop()
 
 bool DefaultRouteMonitor::checkDefaultRoutes()
 {
+    // called from the monitor thread and from start()
+    std::lock_guard<std::mutex> guard(mutex_);
     auto newGateway = getDefaultGateway();
     if (newGateway == lastGateway_)
         return true;
@@ -90,28 +92,18 @@ bool DefaultRouteMonitor::checkDefaultRoutes()
     return setEndpointDirectRoute();
 }
 
-bool DefaultRouteMonitor::executeCommandWithLogging(const std::string &command) const
+std::string DefaultRouteMonitor::getDefaultGateway()
 {
-    std::string output;
-    const auto status = Utils::executeCommand(command, {}, &output);
-    if (!output.empty())
-        Logger::instance().out("%s", output.c_str());
-    return status == 0;
-}
-
-std::string DefaultRouteMonitor::getDefaultGateway() const
-{
-    std::string output;
-    const auto status = Utils::executeCommand(
-        "ip route | grep 'default' | awk '{print $3}'", {}, &output);
-    if (status == 0) {
-        std::vector<std::string> gateways;
-        boost::trim(output);
-        boost::split(gateways, output, boost::is_any_of("\n"), boost::token_compress_on);
-        if (!gateways.empty() && !gateways[0].empty())
-            return gateways[0];
+    std::vector<NetlinkRoutes::Route> routes;
+    if (netlink_.dumpRoutes(RT_TABLE_MAIN, routes)) {
+        for (const auto &route : routes) {
+            if (route.dstLen == 0 && route.gateway != 0) {
+                char str[INET_ADDRSTRLEN];
+                return inet_ntop(AF_INET, &route.gateway, str, sizeof(str));
+            }
+        }
     }
-    Logger::instance().out("Failed to get default gateway (%s)", output.c_str());
+    Logger::instance().out("Failed to get default gateway");
     return "";
 }
 
@@ -119,15 +111,22 @@ bool DefaultRouteMonitor::setEndpointDirectRoute()
 {
     if (endpoint_.empty() || lastGateway_.empty())
         return false;
-    if (!executeCommandWithLogging(
-        "ip route add " + endpoint_ + "/32 via " + lastGateway_))
+    NetlinkRoutes::Route route;
+    if (!NetlinkRoutes::parsePrefix(endpoint_, "32", route.dst, route.dstLen) ||
+        !NetlinkRoutes::parseAddress(lastGateway_, route.gateway))
         return false;
-    return true;
+    Logger::instance().out("add route: %s", route.toString().c_str());
+    return netlink_.apply({ route }, {});
 }
 
 void DefaultRouteMonitor::unsetEndpointDirectRoute()
 {
-    if (endpoint_.empty())
+    if (endpoint_.empty() || lastGateway_.empty())
+        return;
+    NetlinkRoutes::Route route;
+    if (!NetlinkRoutes::parsePrefix(endpoint_, "32", route.dst, route.dstLen) ||
+        !NetlinkRoutes::parseAddress(lastGateway_, route.gateway))
         return;
-    executeCommandWithLogging("ip route del " + endpoint_);
+    Logger::instance().out("delete route: %s", route.toString().c_str());
+    netlink_.apply({}, { route });
 }
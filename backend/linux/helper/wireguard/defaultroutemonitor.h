@@ -2,8 +2,10 @@
 #define DefaultRouteMonitor_h
 
 #include <atomic>
+#include <mutex>
 #include <string>
 #include <thread>
+#include "../routes_manager/netlink_routes.h"
 
 class DefaultRouteMonitor final
 {
@@ -17,8 +19,7 @@ public:
     bool isActive() const { return !doStopThread_; }
 
 private:
-    bool executeCommandWithLogging(const std::string &command) const;
-    std::string getDefaultGateway() const;
+    std::string getDefaultGateway();
     bool setEndpointDirectRoute();
     void unsetEndpointDirectRoute();
 
@@ -27,6 +28,8 @@ private:
     std::atomic<bool> doStopThread_;
     std::string endpoint_;
     std::string lastGateway_;
+    NetlinkRoutes netlink_;
+    std::mutex mutex_;
 };
 
 #endif  // DefaultRouteMonitor_h
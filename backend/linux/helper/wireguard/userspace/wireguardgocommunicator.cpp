@@ -162,6 +162,9 @@ bool WireGuardGoCommunicator::start(
     }
 
     daemonCmdId_ = ExecuteCmd::instance().execute(fullCmd);
+    if (daemonCmdId_ == 0) {
+        return false;
+    }
     deviceName_ = deviceName;
     executable_ = executable;
     return true;
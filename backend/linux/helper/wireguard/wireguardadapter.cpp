@@ -7,6 +7,8 @@
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/split.hpp>
+#include <algorithm>
+#include <net/if.h>
 #include <sstream>
 
 namespace
@@ -77,44 +79,60 @@ bool WireGuardAdapter::enableRouting(const std::string &ipAddress, const std::ve
     allowedIps_ = allowedIps;
     fwmark_ = fwmark;
 
-    std::vector<std::string> cmdlist;
-    for (const auto &ip : allowedIps) {
-        if (boost::algorithm::ends_with(ip, "/0")) {
-            has_default_route_ = true;
-            cmdlist.push_back("ip -4 route add " + ip + " dev " + getName() + " table " + std::to_string(fwmark));
-            cmdlist.push_back("ip -4 rule add not fwmark " + std::to_string(fwmark) + " table " + std::to_string(fwmark));
-            cmdlist.push_back("ip -4 rule add table main suppress_prefixlength 0");
-
-            if (!RunBlockingCommands(cmdlist))
-            {
-                return false;
-            }
-            cmdlist.clear();
+    const int ifindex = if_nametoindex(getName().c_str());
+    if (!netlink_.isValid() || ifindex == 0) {
+        Logger::instance().out("WireGuardAdapter::enableRouting(), no rtnetlink socket or interface %s", getName().c_str());
+        return false;
+    }
 
-            if (!addFirewallRules(ipAddress, fwmark))
-            {
-                return false;
-            }
-        } else {
+    std::vector<NetlinkRoutes::Route> existingRoutes;
+    netlink_.dumpRoutes(RT_TABLE_MAIN, existingRoutes);
 
-            std::vector<std::string> args;
-            args.push_back("-4");
-            args.push_back("route");
-            args.push_back("show");
-            args.push_back("dev");
-            args.push_back(getName());
-            args.push_back("match");
-            args.push_back(ip);
+    // all the routes and rules go to the kernel in one batch
+    std::vector<NetlinkRoutes::Route> addRoutes;
+    std::vector<NetlinkRoutes::Rule> addRules;
+    for (const auto &ip : allowedIps) {
+        NetlinkRoutes::Route route;
+        if (!NetlinkRoutes::parsePrefix(ip, route.dst, route.dstLen)) {
+            Logger::instance().out("WireGuardAdapter::enableRouting(), invalid allowed ip %s", ip.c_str());
+            return false;
+        }
+        route.ifindex = ifindex;
 
-            std::string output;
-            Utils::executeCommand("ip", args, &output, false);
-            if (output.empty())
-            {
-                cmdlist.push_back("ip -4 route add " + ip + " dev " + getName());
+        if (route.dstLen == 0) {
+            has_default_route_ = true;
+            // ip -4 route add 0.0.0.0/0 dev <name> table <fwmark>
+            route.table = fwmark;
+            addRoutes.push_back(route);
+            // ip -4 rule add not fwmark <fwmark> table <fwmark>
+            NetlinkRoutes::Rule fwmarkRule;
+            fwmarkRule.table = fwmark;
+            fwmarkRule.hasFwmark = true;
+            fwmarkRule.fwmark = fwmark;
+            fwmarkRule.isInvert = true;
+            addRules.push_back(fwmarkRule);
+            // ip -4 rule add table main suppress_prefixlength 0
+            NetlinkRoutes::Rule suppressRule;
+            suppressRule.suppressPrefixLength = 0;
+            addRules.push_back(suppressRule);
+        } else {
+            // skip the prefixes which are already routed via the adapter (ip -4 route show dev <name> match <ip>)
+            const bool isRouted = std::any_of(existingRoutes.begin(), existingRoutes.end(), [&](const NetlinkRoutes::Route &r) {
+                return r.ifindex == ifindex && r.contains(route.dst, route.dstLen);
+            });
+            if (!isRouted) {
+                addRoutes.push_back(route);
             }
         }
     }
-    return RunBlockingCommands(cmdlist);
+
+    if (!netlink_.apply(addRoutes, std::vector<NetlinkRoutes::Route>(), addRules)) {
+        return false;
+    }
+    if (has_default_route_ && !addFirewallRules(ipAddress, fwmark)) {
+        return false;
+    }
+    return true;
 }
 
 bool WireGuardAdapter::disableRouting()
@@ -124,40 +142,20 @@ bool WireGuardAdapter::disableRouting()
         return true;
     }
 
-    while (true)
-    {
-        std::vector<std::string> args;
-        args.push_back("-4");
-        args.push_back("rule");
-        args.push_back("show");
-
-        std::string output;
-        Utils::executeCommand("ip", args, &output, false);
-
-        std::string match_str = "lookup " + std::to_string(fwmark_);
-        std::string match_str2 = "from all lookup main suppress_prefixlength 0";
-        bool bContinue = false;
-
-        if (output.find(match_str) != std::string::npos)
-        {
-            std::vector<std::string> cmdlist;
-            cmdlist.push_back("ip -4 rule delete table "+ std::to_string(fwmark_));
-            RunBlockingCommands(cmdlist);
-            bContinue = true;
-        }
-        if (output.find(match_str2) != std::string::npos)
-        {
-            std::vector<std::string> cmdlist;
-            cmdlist.push_back("ip -4 rule delete table main suppress_prefixlength 0");
-            RunBlockingCommands(cmdlist);
-            bContinue = true;
-        }
-
-        if (!bContinue)
-        {
-            break;
+    // deletes all the rules of the fwmark table and the suppress_prefixlength rules of the main table,
+    // including the duplicates left by the previous runs
+    std::vector<NetlinkRoutes::Rule> rules;
+    std::vector<NetlinkRoutes::Rule> deleteRules;
+    if (netlink_.dumpRules(rules)) {
+        for (const auto &rule : rules) {
+            if ((fwmark_ != 0 && rule.table == fwmark_) || (rule.table == RT_TABLE_MAIN && rule.suppressPrefixLength == 0)) {
+                deleteRules.push_back(rule);
+            }
         }
     }
+    if (!deleteRules.empty()) {
+        netlink_.apply(std::vector<NetlinkRoutes::Route>(), std::vector<NetlinkRoutes::Route>(), std::vector<NetlinkRoutes::Rule>(), deleteRules);
+    }
 
     removeFirewallRules();
 
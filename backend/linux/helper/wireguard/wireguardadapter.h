@@ -4,6 +4,7 @@
 #include <map>
 #include <string>
 #include <vector>
+#include "../routes_manager/netlink_routes.h"
 
 class WireGuardAdapter final
 {
@@ -32,6 +33,7 @@ private:
 
     std::vector<std::string> allowedIps_;
     uint32_t fwmark_;
+    NetlinkRoutes netlink_;
 
     bool addFirewallRules(const std::string &ipAddress, uint32_t fwmark);
     bool removeFirewallRules();
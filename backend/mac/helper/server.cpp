@@ -5,6 +5,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <stdlib.h>
+#include <array>
 #include <codecvt>
 #include <string>
 #include <mach-o/dyld.h>
@@ -19,7 +20,7 @@
 #include "utils/executable_signature/executable_signature.h"
 #include "execute_cmd.h"
 #include "keychain_utils.h"
-#include "../../posix_common/helper_commands_serialize.h"
+#include "../../posix_common/helper_commands_binary.h"
 #include "ipc/helper_security.h"
 #include "macutils.h"
 #include "firewallonboot.h"
@@ -28,6 +29,48 @@
 
 #define SOCK_PATH "/var/run/windscribe_helper_socket2"
 
+namespace {
+
+// boost throws on a malformed v1 text archive, the unused rest of a v1 payload is ignored as before
+bool isDecoded(const boost::archive::text_iarchive &)
+{
+    return true;
+}
+
+// the v2 payload must be exactly the encoded parameters of the command
+bool isDecoded(const HelperBinaryIArchive &ia)
+{
+    return ia.isOk() && ia.isAtEnd();
+}
+
+// Decodes the parameters before anything is executed. A truncated or malformed v2 payload, or one with extra bytes
+// (e.g. a batch item encoded for another command), is rejected with executed = 0.
+template<class Archive, class T>
+bool decodeCommand(int cmdId, Archive &ia, T &cmd, CMD_ANSWER &outCmdAnswer)
+{
+    ia >> cmd;
+    if (!isDecoded(ia)) {
+        LOG("Malformed parameters of the command %d", cmdId);
+        outCmdAnswer.executed = 0;
+        return false;
+    }
+    return true;
+}
+
+// the command without parameters
+template<class Archive>
+bool decodeCommand(int cmdId, Archive &ia, CMD_ANSWER &outCmdAnswer)
+{
+    if (!isDecoded(ia)) {
+        LOG("Unexpected parameters of the command %d", cmdId);
+        outCmdAnswer.executed = 0;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
 Server::Server()
 {
     acceptor_ = NULL;
@@ -49,7 +92,7 @@ Server::~Server()
     unlink(SOCK_PATH);
 }
 
-bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf, CMD_ANSWER &outCmdAnswer)
+bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf, CMD_ANSWER &outCmdAnswer, std::optional<uint32_t> &outRequestId)
 {
     // not enough data for read command
     if (buf->size() < sizeof(int)*3) {
@@ -57,16 +100,39 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
     }
 
     const char *bufPtr = boost::asio::buffer_cast<const char*>(buf->data());
+    uint32_t magic;
+    memcpy(&magic, bufPtr, sizeof(magic));
+    const bool isV2 = (magic == HELPER_V2_MAGIC);
+
     size_t headerSize = 0;
     int cmdId;
-    memcpy(&cmdId, bufPtr + headerSize, sizeof(cmdId));
-    headerSize += sizeof(cmdId);
-    pid_t pid;
-    memcpy(&pid, bufPtr + headerSize, sizeof(pid));
-    headerSize += sizeof(pid);
-    int length;
-    memcpy(&length, bufPtr + headerSize, sizeof(length));
-    headerSize += sizeof(length);
+    size_t length;
+    if (isV2) {
+        if (buf->size() < sizeof(HELPER_V2_REQUEST_HEADER)) {
+            return false;
+        }
+        HELPER_V2_REQUEST_HEADER header;
+        memcpy(&header, bufPtr, sizeof(header));
+        if (header.length > HELPER_V2_MAX_LENGTH) {
+            LOG("Invalid length of the command: %u", header.length);
+            sock->close();
+            return false;
+        }
+        headerSize = sizeof(header);
+        cmdId = header.cmdId;
+        length = header.length;
+        outRequestId = header.requestId;
+    } else {
+        memcpy(&cmdId, bufPtr + headerSize, sizeof(cmdId));
+        headerSize += sizeof(cmdId);
+        pid_t pid;
+        memcpy(&pid, bufPtr + headerSize, sizeof(pid));
+        headerSize += sizeof(pid);
+        int v1Length;
+        memcpy(&v1Length, bufPtr + headerSize, sizeof(v1Length));
+        headerSize += sizeof(v1Length);
+        length = v1Length;
+    }
 
     // not enough data for read command
     if (buf->size() < (headerSize + length)) {
@@ -85,13 +151,52 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
         return false;
     }
 
-    std::string str(bufPtr + headerSize, length);
-    std::istringstream stream(str);
-    boost::archive::text_iarchive ia(stream, boost::archive::no_header);
+    if (isV2) {
+        // decoded in place, without copying the payload
+        HelperBinaryIArchive ia(bufPtr + headerSize, length);
+        handleCommand(cmdId, ia, outCmdAnswer);
+    } else {
+        std::istringstream stream(std::string(bufPtr + headerSize, length));
+        boost::archive::text_iarchive ia(stream, boost::archive::no_header);
+        handleCommand(cmdId, ia, outCmdAnswer);
+    }
 
+    buf->consume(headerSize + length);
+
+    return true;
+}
+
+void Server::handleBatch(const CMD_BATCH &cmd, CMD_ANSWER &outCmdAnswer)
+{
+    std::vector<CMD_ANSWER> answers;
+    outCmdAnswer.executed = 1;
+    for (const auto &item : cmd.items) {
+        CMD_ANSWER answer;
+        if (item.cmdId == HELPER_CMD_BATCH) {
+            LOG("Nested batch commands are not supported");
+        } else {
+            HelperBinaryIArchive ia(item.data.data(), item.data.size());
+            handleCommand(item.cmdId, ia, answer);
+        }
+        answers.push_back(answer);
+        if (answer.executed == 0) {
+            outCmdAnswer.executed = 0;
+            if (cmd.isStopOnError) {
+                break;
+            }
+        }
+    }
+    outCmdAnswer.body = helperBinaryEncode(answers);
+}
+
+template<class Archive>
+void Server::handleCommand(int cmdId, Archive &ia, CMD_ANSWER &outCmdAnswer)
+{
     if (cmdId == HELPER_CMD_START_OPENVPN) {
         CMD_START_OPENVPN cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
 
         if (!OVPN::writeOVPNFile(MacUtils::resourcePath() + "dns.sh", cmd.config, cmd.isCustomConfig)) {
            LOG("Could not write OpenVPN config");
@@ -115,7 +220,9 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
         }
     } else if (cmdId == HELPER_CMD_GET_CMD_STATUS) {
         CMD_GET_CMD_STATUS cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
 
         bool bFinished;
         std::string log;
@@ -129,13 +236,17 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
         }
     } else if (cmdId == HELPER_CMD_CLEAR_CMDS) {
         CMD_CLEAR_CMDS cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
 
         ExecuteCmd::instance().clearCmds();
         outCmdAnswer.executed = 2;
     } else if (cmdId == HELPER_CMD_SET_KEYCHAIN_ITEM) {
         CMD_SET_KEYCHAIN_ITEM cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
 
         bool bSuccess = KeyChainUtils::setUsernameAndPassword("Windscribe IKEv2", "Windscribe IKEv2", "Windscribe IKEv2 password", cmd.username.c_str(), cmd.password.c_str());
 
@@ -146,19 +257,25 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
         }
     } else if (cmdId == HELPER_CMD_SPLIT_TUNNELING_SETTINGS) {
         CMD_SPLIT_TUNNELING_SETTINGS cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
 
         splitTunneling_.setSplitTunnelingParams(cmd.isActive, cmd.isExclude, cmd.files, cmd.ips, cmd.hosts);
         outCmdAnswer.executed = 1;
     } else if (cmdId == HELPER_CMD_SEND_CONNECT_STATUS) {
         CMD_SEND_CONNECT_STATUS cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
 
         splitTunneling_.setConnectParams(cmd);
         outCmdAnswer.executed = 1;
     } else if (cmdId == HELPER_CMD_START_WIREGUARD) {
         CMD_START_WIREGUARD cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
 
         if (wireGuardController_.start(cmd.exePath, cmd.executable, cmd.deviceName)) {
             outCmdAnswer.executed = 1;
@@ -166,12 +283,17 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
             outCmdAnswer.executed = 0;
         }
     } else if (cmdId == HELPER_CMD_STOP_WIREGUARD) {
+        if (!decodeCommand(cmdId, ia, outCmdAnswer)) {
+            return;
+        }
         if (wireGuardController_.stop()) {
             outCmdAnswer.executed = 1;
         }
     } else if (cmdId == HELPER_CMD_START_CTRLD) {
         CMD_START_CTRLD cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
 
         std::string fullCmd = Utils::getFullCommand(cmd.exePath, cmd.executable, cmd.parameters);
         if (fullCmd.empty()) {
@@ -190,7 +312,9 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
         }
     } else if (cmdId == HELPER_CMD_CONFIGURE_WIREGUARD) {
         CMD_CONFIGURE_WIREGUARD cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
 
         outCmdAnswer.executed = 0;
         if (wireGuardController_.isInitialized()) {
@@ -224,6 +348,9 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
             } while (0);
         }
     } else if (cmdId == HELPER_CMD_GET_WIREGUARD_STATUS) {
+        if (!decodeCommand(cmdId, ia, outCmdAnswer)) {
+            return;
+        }
         unsigned int errorCode = 0;
         unsigned long long bytesReceived = 0, bytesTransmitted = 0;
 
@@ -241,7 +368,9 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
         }
     } else if (cmdId == HELPER_CMD_INSTALLER_SET_PATH) {
         CMD_INSTALLER_FILES_SET_PATH cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
 
         if (files_) {
             delete files_;
@@ -249,6 +378,9 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
         files_ = new Files(cmd.archivePath, cmd.installPath, cmd.userId, cmd.groupId);
         outCmdAnswer.executed = 1;
     } else if (cmdId == HELPER_CMD_INSTALLER_EXECUTE_COPY_FILE) {
+        if (!decodeCommand(cmdId, ia, outCmdAnswer)) {
+            return;
+        }
         if (files_) {
             outCmdAnswer.executed = files_->executeStep();
             if (outCmdAnswer.executed == -1) {
@@ -261,7 +393,9 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
         }
     } else if (cmdId == HELPER_CMD_APPLY_CUSTOM_DNS) {
         CMD_APPLY_CUSTOM_DNS cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
 
         if (MacUtils::setDnsOfDynamicStoreEntry(cmd.ipAddress, cmd.networkService)) {
             outCmdAnswer.executed = 1;
@@ -270,14 +404,18 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
         }
     } else if (cmdId == HELPER_CMD_CHANGE_MTU) {
         CMD_CHANGE_MTU cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
         LOG("Change MTU: %d", cmd.mtu);
 
         outCmdAnswer.executed = 1;
         Utils::executeCommand("ifconfig", {cmd.adapterName.c_str(), "mtu", std::to_string(cmd.mtu)});
     } else if (cmdId == HELPER_CMD_DELETE_ROUTE) {
         CMD_DELETE_ROUTE cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
         LOG("Delete route: %s/%d gw %s", cmd.range.c_str(), cmd.mask, cmd.gateway.c_str());
 
         outCmdAnswer.executed = 1;
@@ -286,13 +424,17 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
         Utils::executeCommand("route", {"-n", "delete", str.str().c_str(), cmd.gateway.c_str()});
     } else if (cmdId == HELPER_CMD_SET_IPV6_ENABLED) {
         CMD_SET_IPV6_ENABLED cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
         LOG("Set IPv6: %s", cmd.enabled ? "enabled" : "disabled");
 
         outCmdAnswer.executed = ipv6Manager_.setEnabled(cmd.enabled);
     } else if (cmdId == HELPER_CMD_SET_DNS_SCRIPT_ENABLED) {
         CMD_SET_DNS_SCRIPT_ENABLED cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
         LOG("Set DNS script: %s", cmd.enabled ? "enabled" : "disabled");
 
         outCmdAnswer.executed = 1;
@@ -305,7 +447,9 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
         }
     } else if (cmdId == HELPER_CMD_TASK_KILL) {
         CMD_TASK_KILL cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
 
         if (cmd.target == kTargetWindscribe) {
             LOG("Killing Windscribe processes");
@@ -341,13 +485,20 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
         }
     } else if (cmdId == HELPER_CMD_CLEAR_FIREWALL_RULES) {
         CMD_CLEAR_FIREWALL_RULES cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
         LOG("Clear firewall rules");
         Utils::executeCommand("pfctl", {"-v", "-F", "all", "-f", "/etc/pf.conf"});
         if (!cmd.isKeekPfEnabled)
             Utils::executeCommand("pfctl", {"-d"});
         outCmdAnswer.executed = 1;
     } else if (cmdId == HELPER_CMD_CHECK_FIREWALL_STATE) {
+        // the tag is used on Linux only
+        CMD_CHECK_FIREWALL_STATE cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
         std::string output;
 
         Utils::executeCommand("pfctl", {"-si"}, &output);
@@ -356,7 +507,9 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
     } else if (cmdId == HELPER_CMD_SET_FIREWALL_RULES) {
         LOG("Set firewall rules");
         CMD_SET_FIREWALL_RULES cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
 
         int fd = open("/etc/windscribe/pf.conf", O_CREAT | O_WRONLY | O_TRUNC);
         if (fd < 0) {
@@ -378,7 +531,9 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
         }
     } else if (cmdId == HELPER_CMD_GET_FIREWALL_RULES) {
         CMD_GET_FIREWALL_RULES cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
 
         if (cmd.table.empty() && cmd.group.empty()) {
             Utils::executeCommand("pfctl", {"-s", "rules"}, &outCmdAnswer.body, false);
@@ -389,6 +544,9 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
         }
         outCmdAnswer.executed = 1;
     } else if (cmdId == HELPER_CMD_DELETE_OLD_HELPER) {
+        if (!decodeCommand(cmdId, ia, outCmdAnswer)) {
+            return;
+        }
         LOG("Delete old helper");
         Utils::executeCommand("rm", {"-f", "/Library/PrivilegedHelperTools/com.windscribe.helper.macos"});
         Utils::executeCommand("rm", {"-f", "/Library/Logs/com.windscribe.helper.macos/helper_log.txt"});
@@ -401,7 +559,9 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
         outCmdAnswer.executed = 1;
     } else if (cmdId == HELPER_CMD_INSTALLER_REMOVE_OLD_INSTALL) {
         CMD_INSTALLER_REMOVE_OLD_INSTALL cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
 
         // sanity check that path at least contains our binary.  We can't assume this path is in /Applications
         // because versions < 2.6 allowed custom dir installs.  This check at least disallows user to try to
@@ -419,19 +579,25 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
         }
     } else if (cmdId == HELPER_CMD_SET_FIREWALL_ON_BOOT) {
         CMD_SET_FIREWALL_ON_BOOT cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
         LOG("Set firewall on boot: %s", cmd.enabled ? "true" : "false");
 
         outCmdAnswer.executed = firewallOnBoot_.setEnabled(cmd.enabled);
     } else if (cmdId == HELPER_CMD_SET_MAC_SPOOFING_ON_BOOT) {
         CMD_SET_MAC_SPOOFING_ON_BOOT cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
         LOG("Set mac spoofing on boot%s: %s", cmd.robustMethod ? " (robust method)" : "", cmd.enabled ? "true" : "false");
 
         outCmdAnswer.executed = macSpoofingOnBoot_.setEnabled(cmd.enabled, cmd.interface, cmd.macAddress, cmd.robustMethod);
     } else if (cmdId == HELPER_CMD_SET_MAC_ADDRESS) {
         CMD_SET_MAC_ADDRESS cmd;
-        ia >> cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
         LOG("Set mac address on %s: %s%s", cmd.interface.c_str(), cmd.macAddress.c_str(), cmd.robustMethod ? " (robust method)" : "");
 
         if (cmd.robustMethod) {
@@ -441,16 +607,18 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
         if (cmd.robustMethod) {
             Utils::executeCommand("ifconfig", {cmd.interface.c_str(), "up"});
         }
+    } else if (cmdId == HELPER_CMD_BATCH) {
+        CMD_BATCH cmd;
+        if (!decodeCommand(cmdId, ia, cmd, outCmdAnswer)) {
+            return;
+        }
+        handleBatch(cmd, outCmdAnswer);
     } else {
         // these commands are not used in MacOS:
         //
         // HELPER_CMD_SET_DNS_LEAK_PROTECT_ENABLED
         // HELPER_CMD_CHECK_FOR_WIREGUARD_KERNEL_MODULE
     }
-
-    buf->consume(headerSize + length);
-
-    return true;
 }
 
 void Server::receiveCmdHandle(socket_ptr sock, boost::shared_ptr<boost::asio::streambuf> buf, const boost::system::error_code& ec, std::size_t bytes_transferred)
@@ -459,13 +627,14 @@ void Server::receiveCmdHandle(socket_ptr sock, boost::shared_ptr<boost::asio::st
         // read and handle commands
         while (true) {
             CMD_ANSWER cmdAnswer;
-            if (!readAndHandleCommand(sock, buf.get(), cmdAnswer)) {
+            std::optional<uint32_t> requestId;
+            if (!readAndHandleCommand(sock, buf.get(), cmdAnswer, requestId)) {
                 // goto receive next commands
                 boost::asio::async_read(*sock, *buf, boost::asio::transfer_at_least(1),
                                         boost::bind(&Server::receiveCmdHandle, this, sock, buf, _1, _2));
                 break;
             } else {
-                if (!sendAnswerCmd(sock, cmdAnswer)) {
+                if (!sendAnswerCmd(sock, cmdAnswer, requestId)) {
                     LOG("client app disconnected");
                     HelperSecurity::instance().reset();
                     return;
@@ -503,15 +672,26 @@ void Server::runService()
     service_.run();
 }
 
-bool Server::sendAnswerCmd(socket_ptr sock, const CMD_ANSWER &cmdAnswer)
+bool Server::sendAnswerCmd(socket_ptr sock, const CMD_ANSWER &cmdAnswer, const std::optional<uint32_t> &requestId)
 {
+    boost::system::error_code er;
+    if (requestId) {
+        HELPER_V2_ANSWER_HEADER header;
+        const std::string str = helperBinaryEncode(cmdAnswer);
+        header.magic = HELPER_V2_MAGIC;
+        header.requestId = *requestId;
+        header.length = (uint32_t)str.length();
+        const std::array<boost::asio::const_buffer, 2> buffers = { boost::asio::buffer(&header, sizeof(header)), boost::asio::buffer(str) };
+        boost::asio::write(*sock, buffers, er);
+        return !er.value();
+    }
+
     std::stringstream stream;
     boost::archive::text_oarchive oa(stream, boost::archive::no_header);
     oa << cmdAnswer;
     std::string str = stream.str();
     int length = (int)str.length();
     // send answer to client
-    boost::system::error_code er;
     boost::asio::write(*sock, boost::asio::buffer(&length, sizeof(length)), boost::asio::transfer_exactly(sizeof(length)), er);
     if (er.value()) {
         return false;
@@ -8,6 +8,7 @@
 #include <boost/asio.hpp>
 #include <boost/thread.hpp>
 #include <list>
+#include <optional>
 
 #include "../../posix_common/helper_commands.h"
 #include "firewallonboot.h"
@@ -39,14 +40,18 @@ private:
 
     Files *files_;
    
-    bool readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf, CMD_ANSWER &outCmdAnswer);
+    // requestId is set for the v2 requests, the answer is sent in the same protocol
+    bool readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf, CMD_ANSWER &outCmdAnswer, std::optional<uint32_t> &outRequestId);
+    template<class Archive>
+    void handleCommand(int cmdId, Archive &ia, CMD_ANSWER &outCmdAnswer);
+    void handleBatch(const CMD_BATCH &cmd, CMD_ANSWER &outCmdAnswer);
     
     void receiveCmdHandle(socket_ptr sock, boost::shared_ptr<boost::asio::streambuf> buf, const boost::system::error_code& ec, std::size_t bytes_transferred);
     void acceptHandler(const boost::system::error_code & ec, socket_ptr sock);
     void startAccept();
     void runService();
     
-    bool sendAnswerCmd(socket_ptr sock, const CMD_ANSWER &cmdAnswer);
+    bool sendAnswerCmd(socket_ptr sock, const CMD_ANSWER &cmdAnswer, const std::optional<uint32_t> &requestId);
 };
 
 #endif /* defined(____Server__) */
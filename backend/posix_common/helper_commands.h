@@ -38,6 +38,12 @@
 #define HELPER_CMD_SET_MAC_ADDRESS                   30
 #define HELPER_CMD_TASK_KILL                         31
 #define HELPER_CMD_START_CTRLD                       32
+#define HELPER_CMD_UPDATE_FIREWALL_IPSET             33 // Linux only
+#define HELPER_CMD_BATCH                             34 // the items are encoded with HelperBinaryOArchive, see helper_commands_binary.h
+#define HELPER_CMD_SUBSCRIBE_CMD_OUTPUT              35 // Linux only, v2 only
+
+// the ipset with the whitelisted IPv4 addresses referenced by the Linux firewall rules
+#define FIREWALL_IPSET_NAME "windscribe_ips"
 
 // enums
 
@@ -231,6 +237,13 @@ struct CMD_GET_FIREWALL_RULES {
     std::string group;
 };
 
+// adds and deletes the members of the FIREWALL_IPSET_NAME set, it is created if not exists
+struct CMD_UPDATE_FIREWALL_IPSET {
+    bool isReplace;     // flush the set before adding
+    std::vector<std::string> addIps;
+    std::vector<std::string> deleteIps;
+};
+
 struct CMD_INSTALLER_REMOVE_OLD_INSTALL {
     std::string path;
 };
@@ -256,4 +269,26 @@ struct CMD_TASK_KILL {
     CmdKillTarget target;
 };
 
+// one command of the batch, data is the command struct encoded with HelperBinaryOArchive
+struct CMD_BATCH_ITEM {
+    int cmdId;
+    std::string data;
+};
+
+// executes the commands in order in one round trip, the answer body is the encoded std::vector<CMD_ANSWER> of the
+// executed commands, the answer is executed if all of them are
+struct CMD_BATCH {
+    bool isStopOnError;
+    std::vector<CMD_BATCH_ITEM> items;
+};
+
+// The output of the commands (OpenVPN, ctrld) started on the connection after HELPER_CMD_SUBSCRIBE_CMD_OUTPUT is pushed
+// with HELPER_V2_PUSH_REQUEST_ID as it arrives, instead of being accumulated for HELPER_CMD_GET_CMD_STATUS.
+// The answer of such a start command has customInfoValue[0] == 1. The last chunk of a command has isFinished set.
+struct CMD_OUTPUT_CHUNK {
+    unsigned long cmdId;
+    std::string data;
+    bool isFinished;
+};
+
 #endif
@@ -0,0 +1,238 @@
+#ifndef HelperCommandsBinary_h
+#define HelperCommandsBinary_h
+
+#include <stdint.h>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "helper_commands.h"
+#include "helper_commands_serialize.h"
+
+// The v2 protocol of the helper socket.
+// A request is HELPER_V2_REQUEST_HEADER followed by the command struct encoded with HelperBinaryOArchive, the answer is
+// HELPER_V2_ANSWER_HEADER followed by the encoded CMD_ANSWER. The answers carry the request ids, so the client may send
+// the next requests before the answers come and must not rely on the order of the answers.
+// The v1 requests (cmdId, pid, length and the boost text archive) are still accepted on the same socket,
+// they are told apart by the first field.
+
+#define HELPER_V2_MAGIC             0x32485357          // "WSH2", it is never a v1 command id
+#define HELPER_V2_MAX_LENGTH        (64 * 1024 * 1024)
+#define HELPER_V2_PUSH_REQUEST_ID   0                   // a frame sent by the helper on its own, the body is CMD_OUTPUT_CHUNK
+
+struct HELPER_V2_REQUEST_HEADER {
+    uint32_t magic;
+    uint32_t requestId;
+    int32_t cmdId;
+    uint32_t length;
+};
+
+struct HELPER_V2_ANSWER_HEADER {
+    uint32_t magic;
+    uint32_t requestId;
+    uint32_t length;
+};
+
+// Compact binary archive for the serialize() functions of helper_commands_serialize.h.
+// The integers and enums are varints (zigzag-encoded if signed), the strings and vectors are prefixed with the varint size.
+class HelperBinaryOArchive
+{
+public:
+    explicit HelperBinaryOArchive(std::string &out) : out_(out) {}
+
+    template<class T>
+    HelperBinaryOArchive &operator<<(const T &v)
+    {
+        save(v);
+        return *this;
+    }
+    template<class T>
+    HelperBinaryOArchive &operator&(const T &v)
+    {
+        save(v);
+        return *this;
+    }
+
+private:
+    std::string &out_;
+
+    void saveVarint(uint64_t v)
+    {
+        while (v >= 0x80) {
+            out_.push_back((char)(v | 0x80));
+            v >>= 7;
+        }
+        out_.push_back((char)v);
+    }
+
+    void saveSigned(int64_t v)
+    {
+        saveVarint(((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+    }
+
+    void save(bool v)
+    {
+        out_.push_back(v ? 1 : 0);
+    }
+
+    void save(const std::string &v)
+    {
+        saveVarint(v.size());
+        out_.append(v);
+    }
+
+    void save(const std::wstring &v)
+    {
+        saveVarint(v.size());
+        for (wchar_t c : v) {
+            saveVarint((uint32_t)c);
+        }
+    }
+
+    template<class T>
+    void save(const std::vector<T> &v)
+    {
+        saveVarint(v.size());
+        for (const auto &item : v) {
+            save(item);
+        }
+    }
+
+    template<class T>
+    void save(const T &v)
+    {
+        if constexpr (std::is_enum<T>::value || (std::is_integral<T>::value && std::is_signed<T>::value)) {
+            saveSigned((int64_t)v);
+        } else if constexpr (std::is_integral<T>::value) {
+            saveVarint(v);
+        } else {
+            boost::serialization::serialize(*this, const_cast<T &>(v), 0);
+        }
+    }
+};
+
+// Reads the data written by HelperBinaryOArchive without copying it. A truncated or malformed input gives zero/empty
+// fields and isOk() == false, it never reads past the end of the data.
+class HelperBinaryIArchive
+{
+public:
+    HelperBinaryIArchive(const char *data, size_t size) : p_(data), end_(data + size) {}
+
+    bool isOk() const { return isOk_; }
+    bool isAtEnd() const { return p_ == end_; }
+
+    template<class T>
+    HelperBinaryIArchive &operator>>(T &v)
+    {
+        load(v);
+        return *this;
+    }
+    template<class T>
+    HelperBinaryIArchive &operator&(T &v)
+    {
+        load(v);
+        return *this;
+    }
+
+private:
+    const char *p_;
+    const char *end_;
+    bool isOk_ = true;
+
+    uint64_t loadVarint()
+    {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64 && p_ != end_; shift += 7) {
+            const uint8_t b = (uint8_t)*p_++;
+            v |= (uint64_t)(b & 0x7f) << shift;
+            if (!(b & 0x80)) {
+                return v;
+            }
+        }
+        isOk_ = false;
+        return 0;
+    }
+
+    int64_t loadSigned()
+    {
+        const uint64_t v = loadVarint();
+        return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+    }
+
+    // the size of a string or vector, each element takes at least one byte
+    size_t loadSize()
+    {
+        const uint64_t size = loadVarint();
+        if (size > (uint64_t)(end_ - p_)) {
+            isOk_ = false;
+            return 0;
+        }
+        return (size_t)size;
+    }
+
+    void load(bool &v)
+    {
+        v = loadVarint() != 0;
+    }
+
+    void load(std::string &v)
+    {
+        const size_t size = loadSize();
+        v.assign(p_, size);
+        p_ += size;
+    }
+
+    void load(std::wstring &v)
+    {
+        const size_t size = loadSize();
+        v.clear();
+        v.reserve(size);
+        for (size_t i = 0; i < size && isOk_; ++i) {
+            v.push_back((wchar_t)loadVarint());
+        }
+    }
+
+    template<class T>
+    void load(std::vector<T> &v)
+    {
+        const size_t size = loadSize();
+        v.clear();
+        v.reserve(size);
+        for (size_t i = 0; i < size && isOk_; ++i) {
+            v.emplace_back();
+            load(v.back());
+        }
+    }
+
+    template<class T>
+    void load(T &v)
+    {
+        if constexpr (std::is_enum<T>::value || (std::is_integral<T>::value && std::is_signed<T>::value)) {
+            v = (T)loadSigned();
+        } else if constexpr (std::is_integral<T>::value) {
+            v = (T)loadVarint();
+        } else {
+            boost::serialization::serialize(*this, v, 0);
+        }
+    }
+};
+
+template<class T>
+std::string helperBinaryEncode(const T &cmd)
+{
+    std::string data;
+    HelperBinaryOArchive oa(data);
+    oa << cmd;
+    return data;
+}
+
+// false if the data is truncated, malformed or has extra bytes after the struct
+template<class T>
+bool helperBinaryDecode(const char *data, size_t size, T &cmd)
+{
+    HelperBinaryIArchive ia(data, size);
+    ia >> cmd;
+    return ia.isOk() && ia.isAtEnd();
+}
+
+#endif
@@ -221,6 +221,15 @@ void serialize(Archive &ar, CMD_GET_FIREWALL_RULES &a, const unsigned int versio
     ar & a.group;
 }
 
+template<class Archive>
+void serialize(Archive &ar, CMD_UPDATE_FIREWALL_IPSET &a, const unsigned int version)
+{
+    UNUSED(version);
+    ar & a.isReplace;
+    ar & a.addIps;
+    ar & a.deleteIps;
+}
+
 template<class Archive>
 void serialize(Archive &ar, CMD_INSTALLER_REMOVE_OLD_INSTALL &a, const unsigned int version)
 {
@@ -261,6 +270,31 @@ void serialize(Archive &ar, CMD_TASK_KILL &a, const unsigned int version)
     ar & a.target;
 }
 
+template<class Archive>
+void serialize(Archive &ar, CMD_BATCH_ITEM &a, const unsigned int version)
+{
+    UNUSED(version);
+    ar & a.cmdId;
+    ar & a.data;
+}
+
+template<class Archive>
+void serialize(Archive &ar, CMD_BATCH &a, const unsigned int version)
+{
+    UNUSED(version);
+    ar & a.isStopOnError;
+    ar & a.items;
+}
+
+template<class Archive>
+void serialize(Archive &ar, CMD_OUTPUT_CHUNK &a, const unsigned int version)
+{
+    UNUSED(version);
+    ar & a.cmdId;
+    ar & a.data;
+    ar & a.isFinished;
+}
+
 }
 }
 
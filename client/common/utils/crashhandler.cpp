@@ -343,6 +343,11 @@ void CrashHandler::handleException(ExceptionInfo info)
                              info.exceptionPointers))
         CRASH_LOG("Wrote minidump: %ls", filename.c_str());
 
+#if !defined(WINDSCRIBE_SERVICE)
+    // the log writer thread may not have written the last messages yet
+    Logger::instance().flushOnCrash();
+#endif
+
     TerminateProcess(GetCurrentProcess(), 1);
 }
 
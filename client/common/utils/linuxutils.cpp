@@ -118,6 +118,14 @@ bool isGuiAlreadyRunning()
     return response.trimmed() != "";
 }
 
+bool pingWithMtu(const QString &url, int mtu)
+{
+    // -M do sets the DF bit, the system ping does not need CAP_NET_RAW from the engine
+    const QString cmd = QString("ping -c 1 -W 1 -M do -s %1 %2 2> /dev/null").arg(mtu).arg(url);
+    QString result = Utils::execCmd(cmd).trimmed();
+    return result.contains("icmp_seq=");
+}
+
 QString getLocalIP()
 {
     // Yegor and Clayton found this command to work on many distros, including old ones.
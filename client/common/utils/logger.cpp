@@ -2,10 +2,34 @@
 #include <QStandardPaths>
 #include <QDir>
 #include <QDateTime>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 
+#ifdef Q_OS_WIN
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#include <share.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#endif
+
+wsl::MpscRing<QByteArray> Logger::queue_(Logger::kQueueCapacity);
 QFile *Logger::file_ = NULL;
-QMutex Logger::mutex_;
-QString Logger::strLog_;
+std::mutex Logger::mutex_;
+std::condition_variable Logger::writerCondition_;
+std::thread Logger::writerThread_;
+std::atomic<bool> Logger::isWriterRunning_(false);
+std::atomic<bool> Logger::isWriterWaiting_(false);
+bool Logger::isStopWriter_ = false;
+QByteArray Logger::recentLog_;
+int Logger::recentLogPos_ = 0;
+bool Logger::isRecentLogWrapped_ = false;
 QString Logger::logPath_;
 QString Logger::prevLogPath_;
 bool Logger::consoleOutput_;
@@ -66,10 +90,24 @@ void Logger::install(const QString &name, bool consoleOutput, bool recoveryMode)
         openModeFlag = QIODevice::WriteOnly;
     }
 
-    QMutexLocker lock(&mutex_);
+    std::lock_guard<std::mutex> lock(mutex_);
     file_ = new QFile(logFilePath);
+#ifdef Q_OS_WIN
+    // a QFile opened by name has no CRT descriptor on Windows, the descriptor is needed to sync the file in flush()
+    int fd = -1;
+    const int flags = _O_WRONLY | _O_CREAT | _O_BINARY | _O_NOINHERIT | (recoveryMode ? _O_APPEND : _O_TRUNC);
+    if (_wsopen_s(&fd, reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(logFilePath).utf16()), flags,
+                  _SH_DENYNO, _S_IREAD | _S_IWRITE) == 0)
+    {
+        file_->open(fd, openModeFlag, QFileDevice::AutoCloseHandle);
+    }
+#else
     file_->open(openModeFlag);
+#endif
     consoleOutput_ = consoleOutput;
+    isStopWriter_ = false;
+    writerThread_ = std::thread(&Logger::writerThread);
+    isWriterRunning_ = true;
     prevMessageHandler_ = qInstallMessageHandler(myMessageHandler);
 }
 
@@ -79,11 +117,24 @@ Logger::Logger()
 
 Logger::~Logger()
 {
-    QMutexLocker lock(&mutex_);
+    // the messages of the other threads still running at exit are written directly
+    if (isWriterRunning_.exchange(false))
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            isStopWriter_ = true;
+        }
+        writerCondition_.notify_one();
+        writerThread_.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    writePending();
     if (file_)
     {
         file_->close();
         delete file_;
+        file_ = NULL;
     }
 }
 
@@ -98,30 +149,186 @@ void Logger::copyToPrevLog()
 
 void Logger::myMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &s)
 {
+    // the timestamp up to the seconds changes once a second, cache it per thread
+    static thread_local qint64 cachedSecs = -1;
+    static thread_local QString cachedDateTime;
+    const qint64 msecs = QDateTime::currentMSecsSinceEpoch();
+    if (msecs / 1000 != cachedSecs)
     {
-        QMutexLocker lock(&mutex_);
+        cachedSecs = msecs / 1000;
+        cachedDateTime = QDateTime::fromMSecsSinceEpoch(cachedSecs * 1000, Qt::UTC).toString("ddMMyy hh:mm:ss:");
+    }
+    const int ms = msecs % 1000;
+    QString strDateTime = cachedDateTime;
+    strDateTime += QChar('0' + ms / 100);
+    strDateTime += QChar('0' + ms / 10 % 10);
+    strDateTime += QChar('0' + ms % 10);
+
+    QString str = qFormatLogMessage(type, context, s);
+    str.replace("{gmt_time}", strDateTime);
+    QByteArray record = str.toLocal8Bit();
 
+    if (isWriterRunning_.load(std::memory_order_acquire))
+    {
+        // the ring is full only if the writer is far behind, wait for it instead of dropping the message
+        while (!queue_.tryPush(record))
+        {
+            wakeWriter();
+            std::this_thread::yield();
+        }
+        // pairs with the fence in writerThread(), either the writer sees the message or we see it waiting
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (isWriterWaiting_.load(std::memory_order_relaxed))
+            wakeWriter();
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        writePending();
         if (file_)
         {
-            QString str = qFormatLogMessage(type, context, s);
-            QString strDateTime = QDateTime::currentDateTimeUtc().toString("ddMMyy hh:mm:ss:zzz");
-            str.replace("{gmt_time}", strDateTime);
-
-            file_->write(str.toLocal8Bit());
-            file_->write("\r\n");
+            record += "\r\n";
+            file_->write(record);
             file_->flush();
-            strLog_ += str + "\n";
+            record.chop(2);
+            appendToRecentLog(record);
         }
     }
+
+    if (type == QtFatalMsg)
+        Logger::instance().flushOnCrash();
+
     if (consoleOutput_)
     {
         prevMessageHandler_(type, context, s);
     }
 }
 
+void Logger::flush()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    writePending();
+    syncFile();
+}
+
+void Logger::flushOnCrash()
+{
+    std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kCrashFlushTimeoutMs);
+    while (!lock.try_lock() && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    // without the mutex only the messages already written by the writer are synced
+    if (lock.owns_lock())
+        writePending();
+    syncFile();
+}
+
+void Logger::syncFile()
+{
+    if (!file_ || file_->handle() < 0)
+        return;
+#ifdef Q_OS_WIN
+    FlushFileBuffers(reinterpret_cast<HANDLE>(_get_osfhandle(file_->handle())));
+#else
+    fsync(file_->handle());
+#endif
+}
+
+void Logger::writerThread()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        writePending();
+        if (isStopWriter_)
+            break;
+
+        isWriterWaiting_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (queue_.isEmpty())
+        {
+            // the timeout is only a safety net, the producers wake the writer up
+            writerCondition_.wait_for(lock, std::chrono::seconds(1));
+        }
+        isWriterWaiting_.store(false, std::memory_order_relaxed);
+    }
+}
+
+void Logger::wakeWriter()
+{
+    if (isWriterWaiting_.exchange(false))
+    {
+        // taking the mutex makes sure the writer is either before its emptiness check or already waiting
+        std::lock_guard<std::mutex> lock(mutex_);
+        writerCondition_.notify_one();
+    }
+}
+
+void Logger::writePending()
+{
+    QByteArray batch;
+    QByteArray record;
+    while (queue_.tryPop(record))
+    {
+        appendToRecentLog(record);
+        batch += record;
+        batch += "\r\n";
+    }
+    if (!batch.isEmpty() && file_)
+    {
+        file_->write(batch);
+        file_->flush();
+    }
+}
+
+void Logger::appendToRecentLog(const QByteArray &record)
+{
+    if (!isRecentLogWrapped_)
+    {
+        if (recentLog_.size() + record.size() + 1 <= kMaxRecentLogSize)
+        {
+            recentLog_ += record;
+            recentLog_ += '\n';
+            return;
+        }
+        // from now on the buffer is a ring of kMaxRecentLogSize bytes, the tail is overwritten first
+        recentLogPos_ = recentLog_.size();
+        recentLog_.resize(kMaxRecentLogSize);
+        isRecentLogWrapped_ = true;
+    }
+
+    auto write = [](const char *data, int size)
+    {
+        while (size > 0)
+        {
+            const int len = std::min(size, kMaxRecentLogSize - recentLogPos_);
+            memcpy(recentLog_.data() + recentLogPos_, data, len);
+            data += len;
+            size -= len;
+            recentLogPos_ = (recentLogPos_ + len) % kMaxRecentLogSize;
+        }
+    };
+    const int size = std::min((int)record.size(), kMaxRecentLogSize - 1);
+    write(record.constData() + record.size() - size, size);
+    write("\n", 1);
+}
+
+QString Logger::recentLogStr()
+{
+    if (!isRecentLogWrapped_)
+        return QString::fromLocal8Bit(recentLog_);
+
+    // the oldest line is likely cut, skip it
+    QByteArray log = recentLog_.mid(recentLogPos_) + recentLog_.left(recentLogPos_);
+    const int firstLineEnd = log.indexOf('\n');
+    return QString::fromLocal8Bit(log.constData() + firstLineEnd + 1, log.size() - firstLineEnd - 1);
+}
+
 QString Logger::getLogStr()
 {
-    QMutexLocker lock(&mutex_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    writePending();
     QString ret;
     QFile prevFileLog(prevLogPath_);
     if (prevFileLog.open(QIODevice::ReadOnly))
@@ -130,12 +337,13 @@ QString Logger::getLogStr()
         ret += "----------------------------------------------------------------\n";
         prevFileLog.close();
     }
-    ret += strLog_;
+    ret += recentLogStr();
     return ret;
 }
 
 QString Logger::getCurrentLogStr()
 {
-    QMutexLocker lock(&mutex_);
-    return strLog_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    writePending();
+    return recentLogStr();
 }
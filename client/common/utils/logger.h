@@ -2,11 +2,15 @@
 #define LOGGER_H
 
 #include <QFile>
-#include <QMutex>
 #include <QLoggingCategory>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 #include "clean_sensitive_info.h"
 #include "multiline_message_logger.h"
+#include "mpscring.h"
 
 // log categories
 Q_DECLARE_LOGGING_CATEGORY(LOG_BASIC)
@@ -59,6 +63,10 @@ public:
     void setConsoleOutput(bool on);
     QString getLogStr();
     QString getCurrentLogStr();
+    // writes the pending messages and syncs the log file to the disk
+    void flush();
+    // the same for a fatal message or a crash, the mutex may be held by the crashed thread, so it is not waited for long
+    void flushOnCrash();
 
 private:
     Logger();
@@ -67,16 +75,40 @@ private:
     static void myMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &s);
 
 private:
+    static constexpr size_t kQueueCapacity = 8192;
+    static constexpr int kMaxRecentLogSize = 10 * 1024 * 1024;
+    static constexpr int kCrashFlushTimeoutMs = 100;
+
     static QtMessageHandler prevMessageHandler_;
 
+    // The messages are formatted in the logging threads and passed to the writer thread through a bounded lock-free
+    // ring. The writer writes them to the file in batches and keeps the last kMaxRecentLogSize bytes in recentLog_.
+    // mutex_ guards the consumer side: file_, recentLog_ and the popping from the ring.
+    static wsl::MpscRing<QByteArray> queue_;
     static QFile *file_;
-    static QMutex mutex_;
-    static QString strLog_;
+    static std::mutex mutex_;
+    static std::condition_variable writerCondition_;
+    static std::thread writerThread_;
+    static std::atomic<bool> isWriterRunning_;
+    static std::atomic<bool> isWriterWaiting_;
+    static bool isStopWriter_;
+    static QByteArray recentLog_;
+    static int recentLogPos_;
+    static bool isRecentLogWrapped_;
+
     static QString logPath_;
     static QString prevLogPath_;
     static bool consoleOutput_;
 
     static void copyToPrevLog();
+    static void writerThread();
+    static void wakeWriter();
+    // pops all the pending messages and writes them, mutex_ must be locked
+    static void writePending();
+    static void appendToRecentLog(const QByteArray &record);
+    // syncs the data written to the log file to the disk, does not touch the QFile buffer
+    static void syncFile();
+    static QString recentLogStr();
 };
 
 
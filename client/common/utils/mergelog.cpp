@@ -1,53 +1,102 @@
 #include "mergelog.h"
 
 #include <QCoreApplication>
+#include <QDate>
 #include <QFile>
 #include <QFileInfo>
 #include <QStandardPaths>
-#include <QTextStream>
 
+#include <algorithm>
+#include <cstring>
 #include <future>
+#include <queue>
+#include <vector>
 
 namespace
 {
-bool isYearInDatePresent(const std::string &dateline)
+// only the last 10 MB of a file are merged
+constexpr qint64 kMaxFileSize = 10000000;
+
+bool isYearInDatePresent(const char *dateline)
 {
-    const int scan = qMin(6, (int)dateline.size());
-    for (int i = 0; i < scan; ++i)
+    for (int i = 0; i < 6; ++i)
         if (dateline[i] == ' ')
             return false;
     return true;
 }
 
-// parse date from string "ddMMyy hh:mm:ss:zzz"
-QDateTime parseDateTimeFormat1(const std::string &datestr)
+bool parseDigits(const char *str, int count, int &outValue)
 {
-    int dd,MM,yy;
-    int hh, mm, ss, zzz;
-    if (sscanf(datestr.c_str(),"%02d%02d%02d %02d:%02d:%02d:%03d", &dd, &MM, &yy, &hh, &mm, &ss, &zzz) == 7)
+    outValue = 0;
+    for (int i = 0; i < count; ++i)
     {
-        return QDateTime(QDate(yy + 1900, MM, dd), QTime(hh, mm, ss, zzz));
+        if (str[i] < '0' || str[i] > '9')
+            return false;
+        outValue = outValue * 10 + (str[i] - '0');
     }
+    return true;
+}
 
-    return QDateTime();
+// days since 1970-01-01 of a date in the proleptic Gregorian calendar
+qint64 daysFromCivil(int y, int m, int d)
+{
+    y -= m <= 2;
+    const int era = (y >= 0 ? y : y - 399) / 400;
+    const int yoe = y - era * 400;
+    const int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return (qint64)era * 146097 + doe - 719468;
 }
 
-// parse date from string "ddMM hh:mm:ss:zzz"
-QDateTime parseDateTimeFormat2(const std::string &datestr)
+// Parses "ddMMyy hh:mm:ss:zzz" or "ddMM hh:mm:ss:zzz" (the year is the current one) at the fixed positions,
+// returns the milliseconds since the epoch or -1 if the date is invalid. datestr has at least 19 characters.
+qint64 parseDateTime(const char *datestr, int currentYear)
 {
-    int dd,MM;
-    int hh, mm, ss, zzz;
-    if (sscanf(datestr.c_str(),"%02d%02d %02d:%02d:%02d:%03d", &dd, &MM, &hh, &mm, &ss, &zzz) == 6)
+    int dd, MM, yy, hh, mm, ss, zzz;
+    int year = currentYear;
+    const char *time;
+    if (isYearInDatePresent(datestr))
+    {
+        if (!parseDigits(datestr, 2, dd) || !parseDigits(datestr + 2, 2, MM) || !parseDigits(datestr + 4, 2, yy) || datestr[6] != ' ')
+            return -1;
+        year = 2000 + yy;
+        time = datestr + 7;
+    }
+    else
     {
-        return QDateTime(QDate(1900, MM, dd), QTime(hh, mm, ss, zzz));
+        if (!parseDigits(datestr, 2, dd) || !parseDigits(datestr + 2, 2, MM) || datestr[4] != ' ')
+            return -1;
+        time = datestr + 5;
     }
+    if (!parseDigits(time, 2, hh) || time[2] != ':' || !parseDigits(time + 3, 2, mm) || time[5] != ':' ||
+        !parseDigits(time + 6, 2, ss) || time[8] != ':' || !parseDigits(time + 9, 3, zzz))
+        return -1;
+    if (MM < 1 || MM > 12 || dd < 1 || dd > QDate(year, MM, 1).daysInMonth() || hh > 23 || mm > 59 || ss > 59)
+        return -1;
 
-    return QDateTime();
+    return (((daysFromCivil(year, MM, dd) * 24 + hh) * 60 + mm) * 60 + ss) * 1000 + zzz;
 }
 
-
 }  // namespace
 
+struct MergeLog::LogFile
+{
+    struct Line
+    {
+        // 44 bits for the timestamp, 2 bits for the source and 18 bits for the serial number of the line within
+        // the same millisecond, so the lines of one millisecond keep their order in the file
+        quint64 key;
+        const char *data;
+        int length;
+    };
+
+    QFile file;
+    LineSource source = LineSource::GUI;
+    std::vector<Line> lines;
+
+    static qint64 timestamp(const Line &line) { return line.key >> 20; }
+};
+
 QString MergeLog::mergeLogs(bool doMergePerLine)
 {
     const QString guiLogFilename = guiLogLocation();
@@ -68,65 +117,63 @@ QString MergeLog::mergePrevLogs(bool doMergePerLine)
                  wgPrevServiceLogFilename, doMergePerLine);
 }
 
-int MergeLog::mergeTask(QMutex *mutex, QMultiMap<quint64, QPair<LineSource, QString>> *lines, const QString *filename, LineSource source, bool useMinMax, QDateTime min, QDateTime max)
+void MergeLog::indexLogFile(LogFile *logFile, const QString &filename, LineSource source)
 {
-    int datasize = 0;
-    const int kCurrentYearOffset = QDateTime::currentDateTime().date().year() - 1900;
-    QDateTime prevDateTime;
-
-    QFile file(*filename);
-    if (!file.open(QIODevice::ReadOnly)) {
-        return 0;
-    }
-
-    int timestamp = 0;
-    QTextStream textStream(&file);
-    // If file is larger than 10MiB, just take the last 10MiB
-    int64_t filelen = file.size();
-    if (filelen > 10000000) {
-        file.seek(filelen - 10000000);
+    logFile->source = source;
+    logFile->file.setFileName(filename);
+    if (!logFile->file.open(QIODevice::ReadOnly))
+        return;
+
+    // the mapping starts one byte early to see whether the first line is cut
+    const qint64 fileSize = logFile->file.size();
+    const qint64 offset = fileSize > kMaxFileSize ? fileSize - kMaxFileSize - 1 : 0;
+    if (fileSize == 0)
+        return;
+    const char *data = (const char *)logFile->file.map(offset, fileSize - offset);
+    if (!data)
+        return;
+    const char *end = data + (fileSize - offset);
+    const char *p = data;
+    if (offset > 0)
+    {
+        const char *lineEnd = (const char *)memchr(p, '\n', end - p);
+        p = lineEnd ? lineEnd + 1 : end;
     }
 
-    while (!textStream.atEnd())
+    const int currentYear = QDate::currentDate().year();
+    qint64 prevMs = -2;
+    int serial = 0;
+    bool isSorted = true;
+    logFile->lines.reserve((end - p) / 100);
+    while (p < end)
     {
-        QString line = textStream.readLine();
-
-        if (line[0] != '[' || line.length() < 20)
-            continue;
-
-        const auto datestr = line.sliced(1, 19).toStdString();
-
-        const auto datetime = isYearInDatePresent(datestr)
-            ? parseDateTimeFormat1(datestr)
-                .addYears(100)
-            : parseDateTimeFormat2(datestr)
-                .addYears(kCurrentYearOffset);
-
-        if (useMinMax && (datetime < min || datetime > max))
-            continue;
-
-        if (prevDateTime != datetime) {
-            prevDateTime = datetime;
-            timestamp = 0;
-        }
-
-        // In QMultiMap, elements with the same key will be placed in a reverse order.
-        // https://doc.qt.io/qt-5/qmap-iterator.html#details
-        // To deal with the issue, we create a compound key: 44 bits for a timestamp, 2 bits
-        // for the source, and 18 additional lower bits for a "timestamp" (line serial
-        // number). We assume the maximum number of lines with unique timestamp never
-        // exceeds 262143, which is quite reasonable (it looks infeasible to output 250k+
-        // lines to a log file within 1 ms).
-        const auto key = (static_cast<quint64>(datetime.toMSecsSinceEpoch()) << 20)
-                       | (static_cast<quint64>(source) << 18) | qMin(timestamp++, 0x3ffff);
-
+        const char *lineEnd = (const char *)memchr(p, '\n', end - p);
+        if (!lineEnd)
+            lineEnd = end;
+        int length = lineEnd - p;
+        if (length > 0 && p[length - 1] == '\r')
+            length--;
+
+        if (length >= 20 && p[0] == '[')
         {
-            QMutexLocker locker(mutex);
-            lines->insert(key, qMakePair(source, line));
+            const qint64 ms = parseDateTime(p + 1, currentYear);
+            if (ms != prevMs)
+            {
+                prevMs = ms;
+                serial = 0;
+            }
+            const quint64 key = ((quint64)qMax(ms, (qint64)0) << 20) | ((quint64)source << 18) | qMin(serial++, 0x3ffff);
+            if (!logFile->lines.empty() && key < logFile->lines.back().key)
+                isSorted = false;
+            logFile->lines.push_back({ key, p, length });
         }
-        datasize += line.length() + 3;
+        p = lineEnd + 1;
     }
-    return datasize;
+
+    // the lines are written in the order of their timestamps, except for the clock changes and the messages of
+    // several threads within a millisecond
+    if (!isSorted)
+        std::stable_sort(logFile->lines.begin(), logFile->lines.end(), [](const LogFile::Line &a, const LogFile::Line &b) { return a.key < b.key; });
 }
 
 const QString MergeLog::guiLogLocation()
@@ -192,104 +239,112 @@ QString MergeLog::merge(const QString &guiLogFilename, const QString &serviceLog
                         const QString &servicePrevLogFilename, const QString &wireguardServiceLogFilename,
                         bool doMergePerLine)
 {
-    QMutex mutex;
-    QMultiMap<quint64, QPair<LineSource, QString>> lines;
-    int estimatedLogSize = 0;
-
-    auto futureGuiLog = std::async(MergeLog::mergeTask, &mutex, &lines, &guiLogFilename, LineSource::GUI, false, QDateTime(), QDateTime());
-    estimatedLogSize += futureGuiLog.get();
-
-    QDateTime minDate, maxDate;
-    bool isUseMinMaxDate = false;
-    if (lines.count() > 1)
+    LogFile files[4];
+    auto futureGuiLog = std::async(MergeLog::indexLogFile, &files[0], guiLogFilename, LineSource::GUI);
+    auto futureService = std::async(MergeLog::indexLogFile, &files[1], serviceLogFilename, LineSource::SERVICE);
+    auto futureServicePrev = std::async(MergeLog::indexLogFile, &files[2], servicePrevLogFilename, LineSource::SERVICE);
+    auto futureWGService = std::async(MergeLog::indexLogFile, &files[3], wireguardServiceLogFilename, LineSource::WIREGUARD_SERVICE);
+    futureGuiLog.get();
+    futureService.get();
+    futureServicePrev.get();
+    futureWGService.get();
+
+    // the other logs are limited to the time span of the GUI log
+    const std::vector<LogFile::Line> &guiLines = files[0].lines;
+    if (guiLines.size() > 1)
     {
-        minDate = QDateTime::fromMSecsSinceEpoch(lines.firstKey() >> 20); // Strip source and timestamp.
-        maxDate = QDateTime::fromMSecsSinceEpoch(lines.lastKey() >> 20);
-        isUseMinMaxDate = true;
+        const qint64 minMs = LogFile::timestamp(guiLines.front());
+        const qint64 maxMs = LogFile::timestamp(guiLines.back());
+        for (int i = 1; i < 4; ++i)
+        {
+            auto &lines = files[i].lines;
+            lines.erase(std::remove_if(lines.begin(), lines.end(), [minMs, maxMs](const LogFile::Line &line) {
+                return LogFile::timestamp(line) < minMs || LogFile::timestamp(line) > maxMs;
+            }), lines.end());
+        }
     }
 
-    auto futureService = std::async(MergeLog::mergeTask, &mutex, &lines, &serviceLogFilename, LineSource::SERVICE, isUseMinMaxDate, minDate, maxDate);
-    auto futureServicePrev = std::async(MergeLog::mergeTask, &mutex, &lines, &servicePrevLogFilename, LineSource::SERVICE, isUseMinMaxDate, minDate, maxDate);
-    estimatedLogSize += futureService.get() + futureServicePrev.get();
-
-    auto futureWGService = std::async(MergeLog::mergeTask, &mutex, &lines, &wireguardServiceLogFilename, LineSource::WIREGUARD_SERVICE, isUseMinMaxDate, minDate, maxDate);
-    estimatedLogSize += futureWGService.get();
-
-    if (!doMergePerLine)
-        estimatedLogSize += 400;  // Account for log separation lines.
-
-    QString result;
-    result.reserve(estimatedLogSize);
-    auto logAppendFun = [&result](const QPair<LineSource, QString> &data) {
-        switch (data.first) {
-        case LineSource::GUI:
-            result.append("G ");
-            break;
-        case LineSource::SERVICE:
-            result.append("S ");
-            break;
-        case LineSource::WIREGUARD_SERVICE:
-            result.append("W ");
-            break;
-        default:
-            break;
-        }
-        result.append(data.second);
-        result.append("\n");
-    };
+    int count = 0;
+    qint64 estimatedLogSize = 0;
+    for (const auto &file : files)
+    {
+        count += file.lines.size();
+        for (const auto &line : file.lines)
+            estimatedLogSize += line.length + 3;
+    }
 
     // cut out the part of the log if the count of lines  exceeds MAX_COUNT_OF_LINES (keep 10% begin and 90% end of log)
     int cutCount = 0;
     int cutBeginInd = 0;
-    int cutEndInd = lines.count();
-    if (lines.count() > MAX_COUNT_OF_LINES)
+    int cutEndInd = count;
+    if (count > MAX_COUNT_OF_LINES)
     {
-        cutCount = lines.count() - MAX_COUNT_OF_LINES;
+        cutCount = count - MAX_COUNT_OF_LINES;
         cutBeginInd = MAX_COUNT_OF_LINES / 10;
-        cutEndInd = lines.count() - MAX_COUNT_OF_LINES * 0.9;
+        cutEndInd = count - MAX_COUNT_OF_LINES * 0.9;
+        estimatedLogSize = estimatedLogSize / count * MAX_COUNT_OF_LINES;
     }
 
-    if (doMergePerLine) {
-        int ind = 0;
-        for (auto it = lines.constBegin(); it != lines.constEnd(); ++it)
+    // with doMergePerLine each source is output separately, but the cut is by the index in the merged log
+    const int kSourcesCount = static_cast<int>(LineSource::NUM_LINE_SOURCES);
+    const char kPrefixes[] = { 'G', 'S', 'W' };
+    QByteArray outputs[kSourcesCount];
+    bool hasLines[kSourcesCount] = {};
+    outputs[0].reserve(doMergePerLine ? estimatedLogSize : estimatedLogSize / 2);
+
+    // k-way merge of the sorted files, the heap has the index of the current line of each file
+    struct Cursor
+    {
+        quint64 key;
+        int file;
+        bool operator>(const Cursor &other) const { return key != other.key ? key > other.key : file > other.file; }
+    };
+    size_t positions[4] = {};
+    std::priority_queue<Cursor, std::vector<Cursor>, std::greater<Cursor>> heap;
+    for (int i = 0; i < 4; ++i)
+        if (!files[i].lines.empty())
+            heap.push({ files[i].lines[0].key, i });
+
+    int ind = 0;
+    while (!heap.empty())
+    {
+        const int fileInd = heap.top().file;
+        heap.pop();
+        const LogFile &file = files[fileInd];
+        const LogFile::Line &line = file.lines[positions[fileInd]];
+        if (++positions[fileInd] < file.lines.size())
+            heap.push({ file.lines[positions[fileInd]].key, fileInd });
+
+        const int source = static_cast<int>(file.source);
+        QByteArray &output = outputs[doMergePerLine ? 0 : source];
+        hasLines[source] = true;
+        // cut out middle
+        if (cutCount == 0 || ind < cutBeginInd || ind > cutEndInd)
         {
-            // cut out middle
-            if (cutCount == 0 || ind < cutBeginInd || ind > cutEndInd)
-            {
-                logAppendFun(it.value());
-            }
-            ind++;
+            output.append(kPrefixes[source]);
+            output.append(' ');
+            output.append(line.data, line.length);
+            output.append('\n');
         }
-    } else {
-        const char *separators[] = { nullptr, "Engine", "Service" };
-        for (int i = 0; i < static_cast<int>(LineSource::NUM_LINE_SOURCES); ++i) {
-            const auto current_source = static_cast<LineSource>(i);
-            bool is_first_line = true;
-            int ind = 0;
-            for (auto it = lines.constBegin(); it != lines.constEnd(); ++it) {
-                if (it.value().first != current_source)
-                {
-                    ind++;
-                    continue;
-                }
-                if (is_first_line) {
-                    is_first_line = false;
-                    if (separators[i]) {
-                        result.append("---");
-                        result.append(separators[i]);
-                        result.append(QString().fill('-',189));
-                        result.append("\n");
-                    }
-                }
-                // cut out middle
-                if (cutCount == 0 || ind < cutBeginInd || ind > cutEndInd)
-                {
-                    logAppendFun(it.value());
-                }
-                ind++;
-            }
+        ind++;
+    }
+
+    if (doMergePerLine)
+        return QString::fromUtf8(outputs[0]);
+
+    QByteArray result;
+    result.reserve(estimatedLogSize + 400);  // Account for log separation lines.
+    const char *separators[] = { nullptr, "Engine", "Service" };
+    for (int i = 0; i < kSourcesCount; ++i)
+    {
+        if (hasLines[i] && separators[i])
+        {
+            result.append("---");
+            result.append(separators[i]);
+            result.append(QByteArray(189, '-'));
+            result.append("\n");
         }
+        result.append(outputs[i]);
     }
-    return result;
+    return QString::fromUtf8(result);
 }
-
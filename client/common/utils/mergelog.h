@@ -1,7 +1,5 @@
 #pragma once
 
-#include <QDateTime>
-#include <QMutex>
 #include <QString>
 
 // merge logs files log_gui.txt, windscribeservice.log, and WireguardServiceLog.txt (Windows only) to one,
@@ -12,13 +10,16 @@ public:
     static QString mergeLogs(bool doMergePerLine);
     static QString mergePrevLogs(bool doMergePerLine);
 
-private:
-    static constexpr int MAX_COUNT_OF_LINES = 100000;
+    // the files are memory-mapped and indexed in parallel, then k-way merged by the timestamps of the lines
     static QString merge(const QString &guiLogFilename, const QString &serviceLogFilename, const QString &servicePrevLogFilename,
                          const QString &wireguardServiceLogFilename, bool doMergePerLine);
 
+private:
+    static constexpr int MAX_COUNT_OF_LINES = 100000;
+
     enum class LineSource { GUI, SERVICE, WIREGUARD_SERVICE, NUM_LINE_SOURCES };
-    static int mergeTask(QMutex *mutex, QMultiMap<quint64, QPair<LineSource, QString>> *lines, const QString *filename, LineSource source, bool useMinMax, QDateTime min, QDateTime max);
+    struct LogFile;
+    static void indexLogFile(LogFile *logFile, const QString &filename, LineSource source);
 
     static const QString guiLogLocation();
     static const QString serviceLogLocation();
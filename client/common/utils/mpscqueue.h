@@ -0,0 +1,85 @@
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <atomic>
+#include <utility>
+
+namespace wsl {
+
+// Unbounded lock-free multiple-producer single-consumer queue.
+// Any thread can push(), only one thread at a time may call popAll(). Producers never block each other or the consumer:
+// push() is a single CAS loop on the head of an intrusive stack, popAll() detaches the whole stack with one exchange and
+// hands the items over in the order they were pushed.
+template <typename T>
+class MpscQueue
+{
+public:
+    MpscQueue() : head_(nullptr) {}
+
+    ~MpscQueue()
+    {
+        Node *node = head_.exchange(nullptr, std::memory_order_acquire);
+        while (node) {
+            Node *next = node->next;
+            delete node;
+            node = next;
+        }
+    }
+
+    // returns true if the queue was empty before this push, i.e. the consumer may need to be woken up
+    bool push(T value)
+    {
+        Node *node = new Node{std::move(value), nullptr};
+        Node *oldHead = head_.load(std::memory_order_relaxed);
+        do {
+            node->next = oldHead;
+        } while (!head_.compare_exchange_weak(oldHead, node, std::memory_order_release, std::memory_order_relaxed));
+        return oldHead == nullptr;
+    }
+
+    bool isEmpty() const
+    {
+        return head_.load(std::memory_order_acquire) == nullptr;
+    }
+
+    // calls f(T &&) for every item in FIFO order, returns the number of items
+    template <typename F>
+    int popAll(F f)
+    {
+        Node *node = head_.exchange(nullptr, std::memory_order_acquire);
+
+        // the detached stack is in LIFO order, reverse it
+        Node *reversed = nullptr;
+        while (node) {
+            Node *next = node->next;
+            node->next = reversed;
+            reversed = node;
+            node = next;
+        }
+
+        int count = 0;
+        while (reversed) {
+            Node *next = reversed->next;
+            f(std::move(reversed->value));
+            delete reversed;
+            reversed = next;
+            count++;
+        }
+        return count;
+    }
+
+private:
+    struct Node {
+        T value;
+        Node *next;
+    };
+
+    std::atomic<Node *> head_;
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+};
+
+} // end namespace wsl
+
+#endif // MPSCQUEUE_H
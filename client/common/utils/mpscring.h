@@ -0,0 +1,93 @@
+#ifndef MPSCRING_H
+#define MPSCRING_H
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+namespace wsl {
+
+// Bounded lock-free multiple-producer single-consumer ring.
+// Unlike MpscQueue it never allocates after construction: the cells are preallocated and reused, a producer claims a
+// cell with one CAS on the enqueue position and publishes it with a release store of the cell sequence.
+// Any thread can tryPush(), only one thread at a time may call tryPop()/isEmpty().
+template <typename T>
+class MpscRing
+{
+public:
+    // capacity is rounded up to a power of two
+    explicit MpscRing(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        mask_ = size - 1;
+        cells_.reset(new Cell[size]);
+        for (size_t i = 0; i < size; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        enqueuePos_.store(0, std::memory_order_relaxed);
+        dequeuePos_ = 0;
+    }
+
+    // returns false if the ring is full, the value is moved from only on success
+    bool tryPush(T &value)
+    {
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &cells_[pos & mask_];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+            if (diff == 0) {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T &outValue)
+    {
+        Cell *cell = &cells_[dequeuePos_ & mask_];
+        if (cell->sequence.load(std::memory_order_acquire) != dequeuePos_ + 1) {
+            return false;
+        }
+        outValue = std::move(cell->value);
+        cell->value = T();
+        cell->sequence.store(dequeuePos_ + mask_ + 1, std::memory_order_release);
+        dequeuePos_++;
+        return true;
+    }
+
+    bool isEmpty() const
+    {
+        return cells_[dequeuePos_ & mask_].sequence.load(std::memory_order_acquire) != dequeuePos_ + 1;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> enqueuePos_;
+    alignas(64) size_t dequeuePos_;
+
+    MpscRing(const MpscRing &) = delete;
+    MpscRing &operator=(const MpscRing &) = delete;
+};
+
+} // end namespace wsl
+
+#endif // MPSCRING_H
@@ -0,0 +1,87 @@
+#ifndef SLABPOOL_H
+#define SLABPOOL_H
+
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace wsl {
+
+// Object pool for the event-loop threads which create and destroy many small objects of one type (e.g. connections).
+// The memory is taken from the heap in slabs of ObjectsPerSlab objects and is not given back while the pool lives. Destroyed
+// objects go to a free list and their slots are reused first, so create() and destroy() are a pointer pop and push, without
+// a malloc per object and without the allocator headers.
+// Not thread-safe, the objects must be destroyed by the owner before the pool.
+template <typename T, int ObjectsPerSlab = 256>
+class SlabPool
+{
+public:
+    SlabPool() : freeList_(nullptr), count_(0) {}
+
+    ~SlabPool()
+    {
+        for (Slab *slab : slabs_) {
+            delete slab;
+        }
+    }
+
+    template <typename... Args>
+    T *create(Args &&... args)
+    {
+        if (!freeList_) {
+            addSlab();
+        }
+        Slot *slot = freeList_;
+        freeList_ = slot->next;
+        T *object = new (slot->storage) T(std::forward<Args>(args)...);
+        count_++;
+        return object;
+    }
+
+    void destroy(T *object)
+    {
+        object->~T();
+        // the storage is at the start of the slot
+        Slot *slot = reinterpret_cast<Slot *>(object);
+        slot->next = freeList_;
+        freeList_ = slot;
+        count_--;
+    }
+
+    // the number of live objects
+    int count() const { return count_; }
+    // the memory taken from the heap
+    size_t capacityBytes() const { return slabs_.size() * sizeof(Slab); }
+
+private:
+    union Slot {
+        Slot *next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    struct Slab {
+        Slot slots[ObjectsPerSlab];
+    };
+
+    std::vector<Slab *> slabs_;
+    Slot *freeList_;
+    int count_;
+
+    void addSlab()
+    {
+        Slab *slab = new Slab;
+        slabs_.push_back(slab);
+        // in the order of the addresses, the objects created one after another are next to each other
+        for (int i = ObjectsPerSlab - 1; i >= 0; --i) {
+            slab->slots[i].next = freeList_;
+            freeList_ = &slab->slots[i];
+        }
+    }
+
+    SlabPool(const SlabPool &) = delete;
+    SlabPool &operator=(const SlabPool &) = delete;
+};
+
+} // end namespace wsl
+
+#endif // SLABPOOL_H
@@ -0,0 +1,237 @@
+#include "socketpoller.h"
+
+#include <string.h>
+
+#if defined(Q_OS_LINUX)
+    #include <sys/epoll.h>
+    #include <sys/eventfd.h>
+    #include <unistd.h>
+    #ifndef EPOLLEXCLUSIVE
+        #define EPOLLEXCLUSIVE (1u << 28)
+    #endif
+#elif defined(Q_OS_MAC)
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <unistd.h>
+#endif
+
+namespace wsl {
+
+#if defined(Q_OS_LINUX)
+
+SocketPoller::SocketPoller()
+{
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    eventFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = eventFd_;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, eventFd_, &ev);
+}
+
+SocketPoller::~SocketPoller()
+{
+    close(eventFd_);
+    close(epollFd_);
+}
+
+void SocketPoller::update(Socket socket, bool readable, bool writable)
+{
+    const quint32 events = (readable ? EPOLLIN : 0) | (writable ? EPOLLOUT : 0);
+    auto it = registered_.find(socket);
+    if (events == 0) {
+        if (it != registered_.end()) {
+            epoll_ctl(epollFd_, EPOLL_CTL_DEL, socket, nullptr);
+            registered_.erase(it);
+        }
+        return;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = socket;
+    if (it == registered_.end()) {
+        epoll_ctl(epollFd_, EPOLL_CTL_ADD, socket, &ev);
+        registered_[socket] = events;
+    } else if (it.value() != events && !(it.value() & EPOLLEXCLUSIVE)) {
+        // an exclusive socket can not be modified, only removed
+        epoll_ctl(epollFd_, EPOLL_CTL_MOD, socket, &ev);
+        it.value() = events;
+    }
+}
+
+void SocketPoller::updateExclusive(Socket socket)
+{
+    if (registered_.contains(socket))
+        return;
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+    ev.data.fd = socket;
+    if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, socket, &ev) == 0) {
+        registered_[socket] = ev.events;
+        return;
+    }
+    // the kernels before 4.5 do not know the flag
+    update(socket, true, false);
+}
+
+void SocketPoller::wait(qint64 timeoutMs, std::vector<Event> &outEvents)
+{
+    struct epoll_event events[256];
+    int n = epoll_wait(epollFd_, events, 256, timeoutMs);
+    for (int i = 0; i < n; ++i) {
+        if (events[i].data.fd == eventFd_) {
+            uint64_t value;
+            ssize_t res = read(eventFd_, &value, sizeof(value));
+            Q_UNUSED(res);
+            continue;
+        }
+        const bool isError = events[i].events & (EPOLLERR | EPOLLHUP);
+        outEvents.push_back(Event { events[i].data.fd, (events[i].events & EPOLLIN) || isError,
+                                    (events[i].events & EPOLLOUT) || isError });
+    }
+}
+
+void SocketPoller::wakeup()
+{
+    uint64_t one = 1;
+    ssize_t res = write(eventFd_, &one, sizeof(one));
+    Q_UNUSED(res);
+}
+
+#else
+
+namespace {
+#ifdef Q_OS_WIN
+// the wait time is limited only if the wakeup socket could not be created
+constexpr qint64 kMaxWaitWithoutWakeupMs = 10;
+
+SOCKET createWakeupSocket()
+{
+    SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s == INVALID_SOCKET)
+        return INVALID_SOCKET;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int len = sizeof(addr);
+    u_long nonBlocking = 1;
+    // the datagrams sent with send() come back to the socket itself
+    if (bind(s, (struct sockaddr *)&addr, sizeof(addr)) != 0 || getsockname(s, (struct sockaddr *)&addr, &len) != 0 ||
+        connect(s, (struct sockaddr *)&addr, sizeof(addr)) != 0 || ioctlsocket(s, FIONBIO, &nonBlocking) != 0) {
+        closesocket(s);
+        return INVALID_SOCKET;
+    }
+    return s;
+}
+#endif
+}
+
+SocketPoller::SocketPoller()
+{
+#ifdef Q_OS_WIN
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+    wakeupSocket_ = createWakeupSocket();
+#else
+    if (pipe(wakeupPipe_) == 0) {
+        fcntl(wakeupPipe_[0], F_SETFL, O_NONBLOCK);
+        fcntl(wakeupPipe_[1], F_SETFL, O_NONBLOCK);
+    }
+#endif
+}
+
+SocketPoller::~SocketPoller()
+{
+#ifdef Q_OS_WIN
+    if (wakeupSocket_ != INVALID_SOCKET)
+        closesocket(wakeupSocket_);
+    WSACleanup();
+#else
+    close(wakeupPipe_[0]);
+    close(wakeupPipe_[1]);
+#endif
+}
+
+void SocketPoller::update(Socket socket, bool readable, bool writable)
+{
+    const short events = (readable ? POLLIN : 0) | (writable ? POLLOUT : 0);
+    if (events == 0)
+        registered_.remove(socket);
+    else
+        registered_[socket] = events;
+}
+
+void SocketPoller::updateExclusive(Socket socket)
+{
+    update(socket, true, false);
+}
+
+void SocketPoller::wait(qint64 timeoutMs, std::vector<Event> &outEvents)
+{
+    pollFds_.clear();
+#ifdef Q_OS_WIN
+    if (wakeupSocket_ != INVALID_SOCKET)
+        pollFds_.push_back(PollFd { wakeupSocket_, POLLIN, 0 });
+    else if (timeoutMs < 0 || timeoutMs > kMaxWaitWithoutWakeupMs)
+        timeoutMs = kMaxWaitWithoutWakeupMs;
+#else
+    pollFds_.push_back(PollFd { wakeupPipe_[0], POLLIN, 0 });
+#endif
+    for (auto it = registered_.constBegin(); it != registered_.constEnd(); ++it)
+        pollFds_.push_back(PollFd { it.key(), it.value(), 0 });
+
+#ifdef Q_OS_WIN
+    if (pollFds_.empty()) {
+        Sleep((DWORD)timeoutMs);
+        return;
+    }
+    int n = WSAPoll(pollFds_.data(), (ULONG)pollFds_.size(), (INT)timeoutMs);
+#else
+    int n = poll(pollFds_.data(), pollFds_.size(), (int)timeoutMs);
+#endif
+    if (n <= 0)
+        return;
+
+    for (const PollFd &pfd : pollFds_) {
+        if (pfd.revents == 0)
+            continue;
+#ifdef Q_OS_WIN
+        if (pfd.fd == wakeupSocket_) {
+            char buf[64];
+            while (recv(wakeupSocket_, buf, sizeof(buf), 0) > 0) {}
+            continue;
+        }
+#else
+        if (pfd.fd == wakeupPipe_[0]) {
+            char buf[64];
+            while (read(wakeupPipe_[0], buf, sizeof(buf)) > 0) {}
+            continue;
+        }
+#endif
+        const bool isError = pfd.revents & (POLLERR | POLLHUP);
+        outEvents.push_back(Event { (Socket)pfd.fd, (pfd.revents & POLLIN) || isError, (pfd.revents & POLLOUT) || isError });
+    }
+}
+
+void SocketPoller::wakeup()
+{
+#ifdef Q_OS_WIN
+    if (wakeupSocket_ != INVALID_SOCKET) {
+        char c = 0;
+        ::send(wakeupSocket_, &c, 1, 0);
+    }
+#else
+    char c = 0;
+    ssize_t res = write(wakeupPipe_[1], &c, 1);
+    Q_UNUSED(res);
+#endif
+}
+
+#endif
+
+} // end namespace wsl
@@ -0,0 +1,71 @@
+#ifndef SOCKETPOLLER_H
+#define SOCKETPOLLER_H
+
+#include <QHash>
+#include <QtGlobal>
+#include <vector>
+
+#if defined(Q_OS_WIN)
+    #include <WinSock2.h>
+#elif defined(Q_OS_MAC)
+    #include <poll.h>
+#endif
+
+namespace wsl {
+
+// Readiness poller for the event-loop threads which manage many sockets themselves (not through QSocketNotifier).
+// epoll on Linux, poll() on Mac and WSAPoll on Windows. Sockets are level-triggered.
+// wakeup() writes to an eventfd on Linux, a pipe on Mac and a loopback UDP socket connected to itself on Windows.
+// Only the owner thread may call update() and wait(), wakeup() can be called from any thread.
+class SocketPoller
+{
+public:
+#ifdef Q_OS_WIN
+    typedef SOCKET Socket;
+#else
+    typedef int Socket;
+#endif
+
+    struct Event
+    {
+        Socket socket;
+        bool readable;
+        bool writable;      // errors and hang-ups are reported as both readable and writable
+    };
+
+    SocketPoller();
+    ~SocketPoller();
+
+    // watch the socket for the given events, stops watching it if both are false
+    void update(Socket socket, bool readable, bool writable);
+    // watch a listening socket shared by several pollers for reading, a connection wakes only one of them
+    // (EPOLLEXCLUSIVE on Linux, elsewhere the same as update(socket, true, false)); update(socket, false, false) stops it
+    void updateExclusive(Socket socket);
+    // waits for the events, timeoutMs < 0 means infinite, returns early after wakeup()
+    void wait(qint64 timeoutMs, std::vector<Event> &outEvents);
+    void wakeup();
+
+private:
+#if defined(Q_OS_LINUX)
+    int epollFd_;
+    int eventFd_;
+    QHash<Socket, quint32> registered_;
+#else
+    #if defined(Q_OS_WIN)
+        typedef WSAPOLLFD PollFd;
+        SOCKET wakeupSocket_;
+    #else
+        typedef struct pollfd PollFd;
+        int wakeupPipe_[2];
+    #endif
+    QHash<Socket, short> registered_;
+    std::vector<PollFd> pollFds_;
+#endif
+
+    SocketPoller(const SocketPoller &) = delete;
+    SocketPoller &operator=(const SocketPoller &) = delete;
+};
+
+} // end namespace wsl
+
+#endif // SOCKETPOLLER_H
@@ -0,0 +1,115 @@
+#include <QtTest>
+
+#include <algorithm>
+#include <mutex>
+#include <thread>
+
+#include "utils/logger.h"
+
+// Logs kLinesCount lines from kThreadsCount threads through the message handler as it was before (one mutex, a write
+// and a flush per line, an unbounded in-memory copy) and through Logger. Reports the lines per second and the
+// p99/p99.9/max latency of a qCDebug call.
+class BenchLogger : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void benchmark_mutex_handler();
+    void benchmark_async_logger();
+
+private:
+    static constexpr int kLinesCount = 1000000;
+    static constexpr int kThreadsCount = 8;
+
+    static QFile *oldFile_;
+    static QMutex oldMutex_;
+    static QString oldStrLog_;
+
+    static void oldMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &s);
+    static void logFromThreads(const char *name);
+};
+
+QFile *BenchLogger::oldFile_ = nullptr;
+QMutex BenchLogger::oldMutex_;
+QString BenchLogger::oldStrLog_;
+
+void BenchLogger::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    qSetMessagePattern("[{gmt_time} %{time process}] [%{category}]\t %{message}");
+}
+
+void BenchLogger::oldMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &s)
+{
+    QMutexLocker lock(&oldMutex_);
+    QString str = qFormatLogMessage(type, context, s);
+    QString strDateTime = QDateTime::currentDateTimeUtc().toString("ddMMyy hh:mm:ss:zzz");
+    str.replace("{gmt_time}", strDateTime);
+
+    oldFile_->write(str.toLocal8Bit());
+    oldFile_->write("\r\n");
+    oldFile_->flush();
+    oldStrLog_ += str + "\n";
+}
+
+void BenchLogger::logFromThreads(const char *name)
+{
+    QVector<QVector<qint64>> latencies(kThreadsCount);
+    QElapsedTimer timer;
+    timer.start();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreadsCount; ++t) {
+        threads.emplace_back([t, &latencies, &timer]() {
+            QVector<qint64> &threadLatencies = latencies[t];
+            threadLatencies.reserve(kLinesCount / kThreadsCount);
+            for (int i = 0; i < kLinesCount / kThreadsCount; ++i) {
+                const qint64 startNs = timer.nsecsElapsed();
+                qCDebug(LOG_BASIC) << "thread" << t << "line" << i << "some typical payload of a log message";
+                threadLatencies << timer.nsecsElapsed() - startNs;
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    const qint64 elapsedNs = timer.nsecsElapsed();
+
+    QVector<qint64> all;
+    all.reserve(kLinesCount);
+    for (const auto &threadLatencies : latencies)
+        all += threadLatencies;
+    std::sort(all.begin(), all.end());
+    // not qDebug, the messages go to the handler under test
+    printf("%s lines/s: %lld p99, us: %lld p99.9, us: %lld max, us: %lld\n", name, qRound64(all.size() * 1e9 / elapsedNs),
+           all[all.size() * 99 / 100] / 1000, all[all.size() * 999 / 1000] / 1000, all.last() / 1000);
+}
+
+void BenchLogger::benchmark_mutex_handler()
+{
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    oldFile_ = &file;
+    QtMessageHandler prevHandler = qInstallMessageHandler(oldMessageHandler);
+    logFromThreads("mutex handler");
+    qInstallMessageHandler(prevHandler);
+    oldFile_ = nullptr;
+
+    QCOMPARE(oldStrLog_.count('\n'), kLinesCount);
+    oldStrLog_.clear();
+}
+
+void BenchLogger::benchmark_async_logger()
+{
+    Logger::instance().install("bench", false, false);
+    logFromThreads("async logger");
+
+    Logger::instance().flush();
+    const QString log = Logger::instance().getCurrentLogStr();
+    QVERIFY(log.endsWith("some typical payload of a log message\n"));
+    // the recent log is bounded, so its first line is the first complete one after the wrap
+    QVERIFY(log.size() <= 10 * 1024 * 1024);
+    QVERIFY(log.startsWith("["));
+}
+
+QTEST_MAIN(BenchLogger)
+#include "logger.bench.moc"
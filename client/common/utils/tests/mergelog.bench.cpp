@@ -0,0 +1,189 @@
+#include <QtTest>
+
+#include <future>
+
+#include "utils/mergelog.h"
+
+// Generates a GUI log, a service log and a WireGuard log of a few hundred MB in total and merges them with the
+// previous implementation (a QMultiMap of all the lines behind a mutex, sscanf for the dates) and with MergeLog.
+// Both read only the last 10 MB of every file. Reports the time of both and checks that the results are the same.
+class BenchMergeLog : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void benchmark_multimap_merge();
+    void benchmark_streaming_merge();
+    void cleanupTestCase();
+
+private:
+    static constexpr qint64 kGuiLogSize = 200 * 1024 * 1024;
+    static constexpr qint64 kServiceLogSize = 100 * 1024 * 1024;
+    static constexpr qint64 kWireguardLogSize = 50 * 1024 * 1024;
+
+    enum class LineSource { GUI, SERVICE, WIREGUARD_SERVICE, NUM_LINE_SOURCES };
+
+    QTemporaryDir dir_;
+    QString guiLog_;
+    QString serviceLog_;
+    QString wireguardLog_;
+    QString multimapResult_;
+    QString streamingResult_;
+
+    static void generateLog(const QString &filename, qint64 size, const char *text);
+    static int multimapMergeTask(QMutex *mutex, QMultiMap<quint64, QPair<LineSource, QString>> *lines, const QString *filename,
+                                 LineSource source, bool useMinMax, QDateTime min, QDateTime max);
+    static QString multimapMerge(const QString &guiLogFilename, const QString &serviceLogFilename, const QString &wireguardServiceLogFilename);
+};
+
+void BenchMergeLog::initTestCase()
+{
+    QVERIFY(dir_.isValid());
+    guiLog_ = dir_.filePath("log_gui.txt");
+    serviceLog_ = dir_.filePath("helper_log.txt");
+    wireguardLog_ = dir_.filePath("wireguard_log.txt");
+
+    // the logs cover the same two hours, so their lines interleave; no '[' in the text, so a line cut by
+    // the 10 MB window is skipped by both implementations
+    generateLog(guiLog_, kGuiLogSize, "basic\t Some typical message of the GUI log with a few more words in it");
+    generateLog(serviceLog_, kServiceLogSize, "service\t execute: ip route add 10.255.255.0/24 dev tun0");
+    generateLog(wireguardLog_, kWireguardLogSize, "wireguard\t Received handshake response");
+}
+
+void BenchMergeLog::cleanupTestCase()
+{
+    QCOMPARE(streamingResult_.size(), multimapResult_.size());
+    QVERIFY(streamingResult_ == multimapResult_);
+}
+
+void BenchMergeLog::generateLog(const QString &filename, qint64 size, const char *text)
+{
+    QFile file(filename);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    const QDateTime start(QDate(2026, 1, 15), QTime(10, 0), Qt::UTC);
+    const qint64 durationMs = 2 * 60 * 60 * 1000;
+    const qint64 linesCount = size / (qstrlen(text) + 30);
+    QByteArray chunk;
+    for (qint64 i = 0; i < linesCount; ++i) {
+        const QDateTime dt = start.addMSecs(i * durationMs / linesCount);
+        chunk += "[" + dt.toString("ddMMyy hh:mm:ss:zzz").toLatin1() + "] " + text + " " + QByteArray::number(i) + "\r\n";
+        if (chunk.size() > 1024 * 1024) {
+            QCOMPARE(file.write(chunk), chunk.size());
+            chunk.clear();
+        }
+    }
+    file.write(chunk);
+}
+
+// MergeLog::mergeTask as it was
+int BenchMergeLog::multimapMergeTask(QMutex *mutex, QMultiMap<quint64, QPair<LineSource, QString>> *lines, const QString *filename,
+                                     LineSource source, bool useMinMax, QDateTime min, QDateTime max)
+{
+    int datasize = 0;
+    QDateTime prevDateTime;
+    QFile file(*filename);
+    if (!file.open(QIODevice::ReadOnly))
+        return 0;
+
+    int timestamp = 0;
+    QTextStream textStream(&file);
+    int64_t filelen = file.size();
+    if (filelen > 10000000)
+        file.seek(filelen - 10000000);
+
+    while (!textStream.atEnd()) {
+        QString line = textStream.readLine();
+        if (line.length() < 20 || line[0] != '[')
+            continue;
+
+        const auto datestr = line.sliced(1, 19).toStdString();
+        int dd, MM, yy, hh, mm, ss, zzz;
+        QDateTime datetime;
+        if (sscanf(datestr.c_str(), "%02d%02d%02d %02d:%02d:%02d:%03d", &dd, &MM, &yy, &hh, &mm, &ss, &zzz) == 7)
+            datetime = QDateTime(QDate(yy + 1900, MM, dd), QTime(hh, mm, ss, zzz)).addYears(100);
+
+        if (useMinMax && (datetime < min || datetime > max))
+            continue;
+
+        if (prevDateTime != datetime) {
+            prevDateTime = datetime;
+            timestamp = 0;
+        }
+        const auto key = (static_cast<quint64>(datetime.toMSecsSinceEpoch()) << 20)
+                       | (static_cast<quint64>(source) << 18) | qMin(timestamp++, 0x3ffff);
+        {
+            QMutexLocker locker(mutex);
+            lines->insert(key, qMakePair(source, line));
+        }
+        datasize += line.length() + 3;
+    }
+    return datasize;
+}
+
+// MergeLog::merge as it was, with doMergePerLine
+QString BenchMergeLog::multimapMerge(const QString &guiLogFilename, const QString &serviceLogFilename, const QString &wireguardServiceLogFilename)
+{
+    QMutex mutex;
+    QMultiMap<quint64, QPair<LineSource, QString>> lines;
+    int estimatedLogSize = 0;
+
+    auto futureGuiLog = std::async(multimapMergeTask, &mutex, &lines, &guiLogFilename, LineSource::GUI, false, QDateTime(), QDateTime());
+    estimatedLogSize += futureGuiLog.get();
+
+    QDateTime minDate, maxDate;
+    bool isUseMinMaxDate = false;
+    if (lines.count() > 1) {
+        minDate = QDateTime::fromMSecsSinceEpoch(lines.firstKey() >> 20);
+        maxDate = QDateTime::fromMSecsSinceEpoch(lines.lastKey() >> 20);
+        isUseMinMaxDate = true;
+    }
+
+    auto futureService = std::async(multimapMergeTask, &mutex, &lines, &serviceLogFilename, LineSource::SERVICE, isUseMinMaxDate, minDate, maxDate);
+    estimatedLogSize += futureService.get();
+    auto futureWGService = std::async(multimapMergeTask, &mutex, &lines, &wireguardServiceLogFilename, LineSource::WIREGUARD_SERVICE, isUseMinMaxDate, minDate, maxDate);
+    estimatedLogSize += futureWGService.get();
+
+    QString result;
+    result.reserve(estimatedLogSize);
+    const int maxCountOfLines = 100000;
+    int cutCount = 0;
+    int cutBeginInd = 0;
+    int cutEndInd = lines.count();
+    if (lines.count() > maxCountOfLines) {
+        cutCount = lines.count() - maxCountOfLines;
+        cutBeginInd = maxCountOfLines / 10;
+        cutEndInd = lines.count() - maxCountOfLines * 0.9;
+    }
+
+    const char *prefixes[] = { "G ", "S ", "W " };
+    int ind = 0;
+    for (auto it = lines.constBegin(); it != lines.constEnd(); ++it) {
+        if (cutCount == 0 || ind < cutBeginInd || ind > cutEndInd) {
+            result.append(prefixes[static_cast<int>(it.value().first)]);
+            result.append(it.value().second);
+            result.append("\n");
+        }
+        ind++;
+    }
+    return result;
+}
+
+void BenchMergeLog::benchmark_multimap_merge()
+{
+    QElapsedTimer timer;
+    timer.start();
+    multimapResult_ = multimapMerge(guiLog_, serviceLog_, wireguardLog_);
+    qDebug() << "QMultiMap merge, ms:" << timer.elapsed() << "result lines:" << multimapResult_.count('\n');
+}
+
+void BenchMergeLog::benchmark_streaming_merge()
+{
+    QElapsedTimer timer;
+    timer.start();
+    streamingResult_ = MergeLog::merge(guiLog_, serviceLog_, dir_.filePath("no_prev_log.txt"), wireguardLog_, true);
+    qDebug() << "streaming merge, ms:" << timer.elapsed() << "result lines:" << streamingResult_.count('\n');
+}
+
+QTEST_MAIN(BenchMergeLog)
+#include "mergelog.bench.moc"
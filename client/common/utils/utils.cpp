@@ -290,11 +290,7 @@ bool Utils::pingWithMtu(const QString &url, int mtu)
 #elif defined Q_OS_MAC
     return NetworkUtils_mac::pingWithMtu(url, mtu);
 #elif defined Q_OS_LINUX
-    //todo linux
-    WS_ASSERT(false);
-    Q_UNUSED(url);
-    Q_UNUSED(mtu);
-    return true;
+    return LinuxUtils::pingWithMtu(url, mtu);
 #endif
 }
 
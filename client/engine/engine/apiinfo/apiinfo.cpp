@@ -2,6 +2,7 @@
 
 #include <QSettings>
 
+#include "engine/utils/cachefile.h"
 #include "utils/ws_assert.h"
 #include "utils/logger.h"
 #include "types/global_consts.h"
@@ -12,10 +13,51 @@
 
 namespace apiinfo {
 
+namespace {
+
+// the sections of the cache file, the locations are the largest one and change the most often
+constexpr quint32 kSectionSessionStatus = CacheFile::makeId("SESS");
+constexpr quint32 kSectionLocations = CacheFile::makeId("LOCS");
+constexpr quint32 kSectionServerCredentials = CacheFile::makeId("CRED");     // and the ovpn config
+constexpr quint32 kSectionPortMap = CacheFile::makeId("PMAP");
+constexpr quint32 kSectionStaticIps = CacheFile::makeId("SIPS");
+
+const QVector<quint32> kSections = { kSectionSessionStatus, kSectionLocations, kSectionServerCredentials,
+                                     kSectionPortMap, kSectionStaticIps };
+
+} // namespace
+
 ApiInfo::ApiInfo() : simpleCrypt_(SIMPLE_CRYPT_KEY)
 {
 }
 
+template<typename... Args>
+QByteArray ApiInfo::encodeSection(const Args &...args)
+{
+    QByteArray arr;
+    {
+        QDataStream ds(&arr, QIODevice::WriteOnly);
+        ds << versionForSerialization_;
+        (ds << ... << args);
+    }
+    SimpleCrypt simpleCrypt(SIMPLE_CRYPT_KEY);
+    return simpleCrypt.encryptToByteArray(arr);
+}
+
+template<typename... Args>
+bool ApiInfo::decodeSection(const QByteArray &data, Args &...args)
+{
+    SimpleCrypt simpleCrypt(SIMPLE_CRYPT_KEY);
+    QByteArray arr = simpleCrypt.decryptToByteArray(data);
+    QDataStream ds(&arr, QIODevice::ReadOnly);
+    quint32 version = 0;
+    ds >> version;
+    if (version > versionForSerialization_)
+        return false;
+    (ds >> ... >> args);
+    return ds.status() == QDataStream::Ok;
+}
+
 types::SessionStatus ApiInfo::getSessionStatus() const
 {
     WS_ASSERT(isSessionStatusInit_);
@@ -26,6 +68,7 @@ void ApiInfo::setSessionStatus(const types::SessionStatus &value)
 {
     isSessionStatusInit_ = true;
     sessionStatus_ = value;
+    changedSections_ << kSectionSessionStatus;
     QSettings settings;
     settings.setValue("userId", sessionStatus_.getUserId());    // need for uninstaller program for open post uninstall webpage
 }
@@ -34,11 +77,22 @@ void ApiInfo::setLocations(const QVector<apiinfo::Location> &value)
 {
     isLocationsInit_ = true;
     locations_ = value;
+    locationsData_.clear();
     mergeWindflixLocations();
+    changedSections_ << kSectionLocations;
 }
 
 QVector<apiinfo::Location> ApiInfo::getLocations() const
 {
+    if (!locationsData_.isEmpty())
+    {
+        if (!decodeSection(locationsData_, locations_))
+        {
+            qCDebug(LOG_BASIC) << "ApiInfo::getLocations(), failed to decode the locations from the cache file";
+            locations_.clear();
+        }
+        locationsData_.clear();
+    }
     return locations_;
 }
 
@@ -56,6 +110,7 @@ void ApiInfo::setForceDisconnectNodes(const QStringList &value)
 void ApiInfo::setServerCredentials(const ServerCredentials &serverCredentials)
 {
     serverCredentials_ = serverCredentials;
+    changedSections_ << kSectionServerCredentials;
 }
 
 ServerCredentials ApiInfo::getServerCredentials() const
@@ -66,11 +121,13 @@ ServerCredentials ApiInfo::getServerCredentials() const
 void ApiInfo::setServerCredentialsOpenVpn(const QString &username, const QString &password)
 {
     serverCredentials_.setForOpenVpn(username, password);
+    changedSections_ << kSectionServerCredentials;
 }
 
 void ApiInfo::setServerCredentialsIkev2(const QString &username, const QString &password)
 {
     serverCredentials_.setForIkev2(username, password);
+    changedSections_ << kSectionServerCredentials;
 }
 
 bool ApiInfo::isServerCredentialsOpenVpnInit() const
@@ -93,6 +150,7 @@ void ApiInfo::setOvpnConfig(const QString &value)
 {
     isOvpnConfigInit_ = true;
     ovpnConfig_ = value;
+    changedSections_ << kSectionServerCredentials;
 }
 
 // return empty string if auth hash not exist in the settings
@@ -127,12 +185,14 @@ void ApiInfo::setPortMap(const types::PortMap &portMap)
     isPortMapInit_ = true;
     portMap_ = portMap;
     checkPortMapForUnavailableProtocolAndFix();
+    changedSections_ << kSectionPortMap;
 }
 
 void ApiInfo::setStaticIps(const StaticIps &value)
 {
     isStaticIpsInit_ = true;
     staticIps_ = value;
+    changedSections_ << kSectionStaticIps;
 }
 
 StaticIps ApiInfo::getStaticIps() const
@@ -142,15 +202,28 @@ StaticIps ApiInfo::getStaticIps() const
 
 void ApiInfo::saveToSettings()
 {
-    QByteArray arr;
+    QHash<quint32, QByteArray> sections;
+    for (quint32 id : std::as_const(changedSections_))
     {
-        QDataStream ds(&arr, QIODevice::WriteOnly);
-        ds << magic_;
-        ds << versionForSerialization_;
-        ds << sessionStatus_ << locations_ << serverCredentials_ << ovpnConfig_ << portMap_ << staticIps_;
+        if (id == kSectionSessionStatus)
+            sections[id] = encodeSection(sessionStatus_);
+        else if (id == kSectionLocations)
+            sections[id] = encodeSection(locations_);
+        else if (id == kSectionServerCredentials)
+            sections[id] = encodeSection(serverCredentials_, ovpnConfig_);
+        else if (id == kSectionPortMap)
+            sections[id] = encodeSection(portMap_);
+        else if (id == kSectionStaticIps)
+            sections[id] = encodeSection(staticIps_);
+    }
+
+    if (!sections.isEmpty() && CacheFile::instance().writeSections(sections))
+    {
+        // the "apiInfo" value of the previous versions is not removed for now, so a downgraded client still finds it;
+        // it is removed together with loadFromLegacySettings() in a later release
+        changedSections_.clear();
     }
     QSettings settings;
-    settings.setValue("apiInfo", simpleCrypt_.encryptToString(arr));
     if (!sessionStatus_.getRevisionHash().isEmpty())
     {
         settings.setValue("revisionHash", sessionStatus_.getRevisionHash());
@@ -168,6 +241,12 @@ void ApiInfo::removeFromSettings()
         settings.remove("apiInfo");
         settings.remove("authHash");
     }
+    {
+        QHash<quint32, QByteArray> sections;
+        for (quint32 id : kSections)
+            sections[id] = QByteArray();
+        CacheFile::instance().writeSections(sections);
+    }
     // remove from first version too
     {
         QSettings settings1("Windscribe", "Windscribe");
@@ -183,6 +262,39 @@ bool ApiInfo::isEverythingInit() const
 }
 
 bool ApiInfo::loadFromSettings()
+{
+    const QHash<quint32, QByteArray> sections = CacheFile::instance().readSections(kSections);
+    if (sections.isEmpty())
+        return loadFromLegacySettings();
+    if (sections.size() != kSections.size())
+        return false;
+
+    // the locations are decoded when they are needed, e.g. not when only checking whether the data can be loaded
+    if (!decodeSection(sections[kSectionSessionStatus], sessionStatus_) ||
+        !decodeSection(sections[kSectionServerCredentials], serverCredentials_, ovpnConfig_) ||
+        !decodeSection(sections[kSectionPortMap], portMap_) ||
+        !decodeSection(sections[kSectionStaticIps], staticIps_))
+    {
+        return false;
+    }
+    locations_.clear();
+    locationsData_ = sections[kSectionLocations];
+
+    QSettings settings;
+    forceDisconnectNodes_.clear();
+    sessionStatus_.setRevisionHash(settings.value("revisionHash", "").toString());
+    isSessionStatusInit_ = true;
+    isLocationsInit_ = true;
+    isForceDisconnectInit_ = true;
+    isOvpnConfigInit_ = true;
+    isPortMapInit_ = true;
+    isStaticIpsInit_ = true;
+    checkPortMapForUnavailableProtocolAndFix();
+    changedSections_.clear();
+    return true;
+}
+
+bool ApiInfo::loadFromLegacySettings()
 {
     QSettings settings;
     QString s = settings.value("apiInfo", "").toString();
@@ -214,6 +326,9 @@ bool ApiInfo::loadFromSettings()
             isPortMapInit_ = true;
             isStaticIpsInit_ = true;
             checkPortMapForUnavailableProtocolAndFix();
+            // written to the cache file on the next save
+            for (quint32 id : kSections)
+                changedSections_ << id;
             return true;
         }
     }
@@ -5,6 +5,7 @@
 #include <QVector>
 #include <QSet>
 #include <QMap>
+#include <QDataStream>
 #include "types/portmap.h"
 #include "servercredentials.h"
 #include "utils/simplecrypt.h"
@@ -51,6 +52,7 @@ public:
     void setStaticIps(const StaticIps &value);
     StaticIps getStaticIps() const;
 
+    // the data is kept in sections of the cache file, only the changed ones are written
     bool loadFromSettings();
     void saveToSettings();
     static void removeFromSettings();
@@ -63,12 +65,21 @@ public:
 
 private:
     void mergeWindflixLocations();
+    // the data saved by the previous versions, in one value of the settings
+    bool loadFromLegacySettings();
+
+    template<typename... Args>
+    static QByteArray encodeSection(const Args &...args);
+    template<typename... Args>
+    static bool decodeSection(const QByteArray &data, Args &...args);
 
     // remove all not supported protocols on this OS from portMap_
     void checkPortMapForUnavailableProtocolAndFix();
 
     types::SessionStatus sessionStatus_;
-    QVector<Location> locations_;
+    mutable QVector<Location> locations_;
+    // the locations loaded from the cache file are decoded on the first getLocations()
+    mutable QByteArray locationsData_;
     QStringList forceDisconnectNodes_;
     ServerCredentials serverCredentials_;
     QString ovpnConfig_;
@@ -82,6 +93,9 @@ private:
     bool isPortMapInit_ = false;
     bool isStaticIpsInit_ = false;
 
+    // the sections of the cache file to write on the next saveToSettings()
+    QSet<quint32> changedSections_;
+
     SimpleCrypt simpleCrypt_;
 
     // for serialization
@@ -0,0 +1,173 @@
+#include <QtTest>
+
+#include "engine/apiinfo/apiinfo.h"
+#include "engine/utils/cachefile.h"
+#include "types/global_consts.h"
+
+// A realistic server list (kLocationsCount locations, kNodesCount nodes) saved and loaded as before (one encrypted
+// QDataStream blob in QSettings) and with the sections of the cache file. Reports the time to save everything, the
+// startup (load and the first getLocations()) and the time to save after only the session status changed.
+class BenchApiInfo : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void benchmark_settings_blob();
+    void benchmark_cache_file();
+
+private:
+    static constexpr int kLocationsCount = 150;
+    static constexpr int kGroupsPerLocation = 2;
+    static constexpr int kNodesPerGroup = 5;
+    static constexpr int kIterations = 20;
+
+    types::SessionStatus sessionStatus_;
+    QVector<apiinfo::Location> locations_;
+    apiinfo::ServerCredentials serverCredentials_;
+    QString ovpnConfig_;
+
+    static QJsonObject locationJson(int ind);
+};
+
+QJsonObject BenchApiInfo::locationJson(int ind)
+{
+    QJsonArray groups;
+    for (int g = 0; g < kGroupsPerLocation; ++g) {
+        QJsonArray nodes;
+        for (int n = 0; n < kNodesPerGroup; ++n) {
+            const QString ip = QString("10.%1.%2.%3").arg(ind).arg(g).arg(n + 1);
+            nodes << QJsonObject{ { "ip", ip }, { "ip2", ip + "2" }, { "ip3", ip + "3" },
+                                  { "hostname", QString("node-%1-%2-%3.example.com").arg(ind).arg(g).arg(n) }, { "weight", 1 } };
+        }
+        groups << QJsonObject{ { "id", ind * 10 + g }, { "city", QString("City %1").arg(g) }, { "nick", QString("Nick %1").arg(g) },
+                               { "pro", g % 2 }, { "ping_ip", QString("10.%1.%2.250").arg(ind).arg(g) },
+                               { "ping_host", QString("https://ping-%1-%2.example.com").arg(ind).arg(g) },
+                               { "wg_pubkey", QString(43, 'w') + "=" }, { "ovpn_x509", QString("x509-%1-%2").arg(ind).arg(g) },
+                               { "link_speed", "10000" }, { "health", 20 }, { "nodes", nodes } };
+    }
+    return QJsonObject{ { "id", ind }, { "name", QString("Location %1").arg(ind) }, { "country_code", "CA" },
+                        { "premium_only", 0 }, { "p2p", 1 }, { "dns_hostname", QString("loc%1.example.com").arg(ind) },
+                        { "groups", groups } };
+}
+
+void BenchApiInfo::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    QCoreApplication::setOrganizationName("WindscribeBench");
+    QCoreApplication::setApplicationName("apiinfo.bench");
+
+    QStringList forceDisconnectNodes;
+    for (int i = 0; i < kLocationsCount; ++i) {
+        apiinfo::Location location;
+        QVERIFY(location.initFromJson(locationJson(i), forceDisconnectNodes));
+        locations_ << location;
+    }
+
+    QJsonObject session{ { "status", 1 }, { "is_premium", 1 }, { "billing_plan_id", 1 }, { "traffic_used", 0 },
+                         { "traffic_max", -1 }, { "user_id", "1" }, { "username", "user" }, { "email", "user@example.com" },
+                         { "email_status", 1 }, { "loc_hash", "hash" } };
+    QString errorMessage;
+    QVERIFY(sessionStatus_.initFromJson(session, errorMessage));
+    serverCredentials_.setForOpenVpn("username", "password");
+    serverCredentials_.setForIkev2("username", "password");
+    ovpnConfig_ = QString("client\n") + QString(8000, 'o');
+}
+
+void BenchApiInfo::cleanupTestCase()
+{
+    QSettings().clear();
+    apiinfo::ApiInfo::removeFromSettings();
+}
+
+void BenchApiInfo::benchmark_settings_blob()
+{
+    const quint32 magic = 0x7605A2AE;
+    const quint32 version = 1;
+    QElapsedTimer timer;
+    qint64 saveNs = 0, loadNs = 0;
+    for (int i = 0; i < kIterations; ++i) {
+        timer.start();
+        {
+            QByteArray arr;
+            {
+                QDataStream ds(&arr, QIODevice::WriteOnly);
+                ds << magic << version << sessionStatus_ << locations_ << serverCredentials_ << ovpnConfig_
+                   << types::PortMap() << apiinfo::StaticIps();
+            }
+            QSettings settings;
+            SimpleCrypt simpleCrypt(SIMPLE_CRYPT_KEY);
+            settings.setValue("apiInfoBench", simpleCrypt.encryptToString(arr));
+        }
+        saveNs += timer.nsecsElapsed();
+
+        timer.start();
+        {
+            QSettings settings;
+            SimpleCrypt simpleCrypt(SIMPLE_CRYPT_KEY);
+            QByteArray arr = simpleCrypt.decryptToByteArray(settings.value("apiInfoBench").toString());
+            QDataStream ds(&arr, QIODevice::ReadOnly);
+            quint32 m, v;
+            types::SessionStatus ss;
+            QVector<apiinfo::Location> locations;
+            apiinfo::ServerCredentials sc;
+            QString ovpnConfig;
+            types::PortMap portMap;
+            apiinfo::StaticIps staticIps;
+            ds >> m >> v >> ss >> locations >> sc >> ovpnConfig >> portMap >> staticIps;
+            QCOMPARE(locations.size(), kLocationsCount);
+        }
+        loadNs += timer.nsecsElapsed();
+    }
+    qDebug() << "settings blob, save all, us:" << saveNs / kIterations / 1000;
+    qDebug() << "settings blob, startup, us:" << loadNs / kIterations / 1000;
+    // the whole blob is written again whatever changed
+    qDebug() << "settings blob, save after the session changed, us:" << saveNs / kIterations / 1000;
+}
+
+void BenchApiInfo::benchmark_cache_file()
+{
+    QElapsedTimer timer;
+    qint64 saveNs = 0, loadNs = 0, getLocationsNs = 0, saveSessionNs = 0;
+    for (int i = 0; i < kIterations; ++i) {
+        timer.start();
+        {
+            apiinfo::ApiInfo apiInfo;
+            apiInfo.setSessionStatus(sessionStatus_);
+            apiInfo.setLocations(locations_);
+            apiInfo.setServerCredentials(serverCredentials_);
+            apiInfo.setOvpnConfig(ovpnConfig_);
+            apiInfo.setPortMap(types::PortMap());
+            apiInfo.setStaticIps(apiinfo::StaticIps());
+            apiInfo.saveToSettings();
+        }
+        saveNs += timer.nsecsElapsed();
+
+        timer.start();
+        apiinfo::ApiInfo apiInfo;
+        QVERIFY(apiInfo.loadFromSettings());
+        loadNs += timer.nsecsElapsed();
+
+        timer.start();
+        QCOMPARE(apiInfo.getLocations().size(), kLocationsCount);
+        getLocationsNs += timer.nsecsElapsed();
+
+        timer.start();
+        apiInfo.setSessionStatus(sessionStatus_);
+        apiInfo.saveToSettings();
+        saveSessionNs += timer.nsecsElapsed();
+    }
+    qDebug() << "cache file, save all, us:" << saveNs / kIterations / 1000;
+    qDebug() << "cache file, startup, us:" << (loadNs + getLocationsNs) / kIterations / 1000
+             << "(load:" << loadNs / kIterations / 1000 << "first getLocations():" << getLocationsNs / kIterations / 1000 << ")";
+    qDebug() << "cache file, save after the session changed, us:" << saveSessionNs / kIterations / 1000;
+
+    // the locations were kept as they were
+    apiinfo::ApiInfo apiInfo;
+    QVERIFY(apiInfo.loadFromSettings());
+    QCOMPARE(apiInfo.getLocations(), locations_);
+}
+
+QTEST_MAIN(BenchApiInfo)
+#include "apiinfo.bench.moc"
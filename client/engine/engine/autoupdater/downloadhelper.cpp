@@ -161,52 +161,21 @@ void DownloadHelper::onReplyDownloadProgress(qint64 bytesReceived, qint64 bytesT
     emit progressChanged(progressPercent_);
 }
 
-void DownloadHelper::onReplyReadyRead()
-{
-    NetworkReply *reply = static_cast<NetworkReply*>(sender());
-    if (!replies_.contains(reply))
-    {
-        qCDebug(LOG_DOWNLOADER) << "Failed to find reply that emitted ready read in monitored replies list";
-        return;
-    }
-    QByteArray arr = reply->readAll();
-
-    if (!arr.isEmpty())
-    {
-        auto &file = replies_[reply].file;
-        if (file->isOpen())
-        {
-            file->write(arr);
-        }
-        else
-        {
-            qCDebug(LOG_DOWNLOADER) << "Download error occurred (file not opened)";
-        }
-    }
-}
-
 void DownloadHelper::getInner(const QString url, const QString targetFilenamePath)
 {
     // remove a previously used file if it exists
     QFile::remove(targetFilenamePath);
     qCDebug(LOG_DOWNLOADER) << "Starting download from url: " << url;
 
-    FileAndProgress fileAndProgess;
-    fileAndProgess.file = QSharedPointer<QFile>::create(targetFilenamePath); // unnecessary copy?
-    if (!fileAndProgess.file->open(QIODevice::WriteOnly))
-    {
-        qCDebug(LOG_DOWNLOADER) << "Failed to open file for download" << url;
-        return;
-    }
-
     NetworkRequest request(QUrl(url), 60000 * 5, true);     // timeout 5 mins
     request.setRemoveFromWhitelistIpsAfterFinish();
+    // the body is written to the file directly in the network thread, a failure to open the file fails the reply
+    request.setOutputFilePath(targetFilenamePath);
 
     NetworkReply *reply = networkAccessManager_->get(request);
-    replies_.insert(reply, fileAndProgess);
+    replies_.insert(reply, FileAndProgress());
     connect(reply, &NetworkReply::finished, this, &DownloadHelper::onReplyFinished);
     connect(reply, &NetworkReply::progress, this, &DownloadHelper::onReplyDownloadProgress);
-    connect(reply, &NetworkReply::readyRead, this, &DownloadHelper::onReplyReadyRead);
 }
 
 void DownloadHelper::removeAutoUpdateInstallerFiles()
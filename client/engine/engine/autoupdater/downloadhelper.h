@@ -3,8 +3,6 @@
 
 #include <QString>
 #include <QObject>
-#include <QFile>
-#include <QSharedPointer>
 #include <QMap>
 
 class NetworkAccessManager;
@@ -39,13 +37,11 @@ signals:
 private slots:
     void onReplyFinished();
     void onReplyDownloadProgress(qint64 bytesReceived, qint64 bytesTotal);
-    void onReplyReadyRead();
 
 private:
     NetworkAccessManager *networkAccessManager_;
 
     struct FileAndProgress {
-        QSharedPointer<QFile> file;
         qint64 bytesReceived = 0;
         qint64 bytesTotal = 0;
         bool done = false;
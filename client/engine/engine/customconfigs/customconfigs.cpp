@@ -1,13 +1,12 @@
 #include "customconfigs.h"
 #include <QDir>
+#include <QStandardPaths>
 #include "utils/logger.h"
-#include "parseovpnconfigline.h"
-#include "ovpncustomconfig.h"
-#include "wireguardcustomconfig.h"
 
 namespace customconfigs {
 
-CustomConfigs::CustomConfigs(QObject *parent) : QObject(parent), dirWatcher_(NULL)
+CustomConfigs::CustomConfigs(QObject *parent) : QObject(parent), dirWatcher_(NULL),
+    index_(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/custom_configs.cache")
 {
 }
 
@@ -55,32 +54,13 @@ void CustomConfigs::parseDir()
     if (!dirWatcher_)
         return;
 
-    QStringList fileList = dirWatcher_->curFiles();
-    for (const QString &filename : fileList)
+    // only the new and changed files are parsed
+    QStringList filepaths;
+    for (const QString &filename : dirWatcher_->curFiles())
     {
-        QString filepath = dirWatcher_->curDir() + "/" + filename;
-        QSharedPointer<const ICustomConfig> config = makeCustomConfigFromFile(filepath);
-        if (!config.isNull())
-        {
-            configs_ << config;
-        }
-    }
-}
-
-QSharedPointer<const ICustomConfig> CustomConfigs::makeCustomConfigFromFile(const QString &filepath)
-{
-    QFileInfo fi(filepath);
-    QString fileSuffix = fi.suffix();
-    if (fileSuffix.compare("ovpn", Qt::CaseInsensitive) == 0)
-    {
-        return QSharedPointer<const ICustomConfig>(OvpnCustomConfig::makeFromFile(filepath));
+        filepaths << dirWatcher_->curDir() + "/" + filename;
     }
-    else if (fileSuffix.compare("conf", Qt::CaseInsensitive) == 0)
-    {
-        return QSharedPointer<const ICustomConfig>(WireguardCustomConfig::makeFromFile(filepath));
-    }
-
-    return NULL;
+    configs_ = index_.update(filepaths);
 }
 
 } //namespace customconfigs
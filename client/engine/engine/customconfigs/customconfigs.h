@@ -6,6 +6,7 @@
 #include <QVector>
 #include "icustomconfig.h"
 #include "customconfigsdirwatcher.h"
+#include "customconfigsindex.h"
 
 namespace customconfigs {
 
@@ -28,9 +29,8 @@ private slots:
 private:
     void parseDir();
 
-    QSharedPointer<const ICustomConfig> makeCustomConfigFromFile(const QString &filepath);
-
     CustomConfigsDirWatcher *dirWatcher_;
+    CustomConfigsIndex index_;
     QVector<QSharedPointer<const ICustomConfig>> configs_;
 };
 
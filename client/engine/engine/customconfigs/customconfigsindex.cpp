@@ -0,0 +1,202 @@
+#include "customconfigsindex.h"
+
+#include <atomic>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include "ovpncustomconfig.h"
+#include "types/global_consts.h"
+#include "utils/logger.h"
+#include "utils/simplecrypt.h"
+#include "wireguardcustomconfig.h"
+
+namespace customconfigs {
+
+CustomConfigsIndex::CustomConfigsIndex(const QString &cacheFilePath) : cacheFilePath_(cacheFilePath), lastParsedCount_(0)
+{
+    load();
+}
+
+QVector<QSharedPointer<const ICustomConfig>> CustomConfigsIndex::update(const QStringList &filepaths)
+{
+    QVector<Entry> newEntries(filepaths.size());
+    QVector<int> changed;
+    for (int i = 0; i < filepaths.size(); ++i)
+    {
+        QFileInfo fi(filepaths[i]);
+        Entry &entry = newEntries[i];
+        entry.size = fi.size();
+        entry.modified = fi.lastModified().toMSecsSinceEpoch();
+
+        auto it = entries_.constFind(filepaths[i]);
+        if (it != entries_.constEnd() && it->size == entry.size && it->modified == entry.modified && !it->hash.isEmpty())
+        {
+            entry = *it;
+        }
+        else
+        {
+            changed << i;
+        }
+    }
+
+    // entries_ is only read until all the tasks are done
+    std::atomic<int> parsedCount(0);
+    for (int i : changed)
+    {
+        threadPool_.start([this, i, &filepaths, &newEntries, &parsedCount]()
+        {
+            const QString &filepath = filepaths[i];
+            Entry &entry = newEntries[i];
+            QFile file(filepath);
+            QByteArray data;
+            if (file.open(QIODevice::ReadOnly))
+            {
+                data = file.readAll();
+                entry.hash = QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+            }
+
+            // touched, but not changed
+            auto it = entries_.constFind(filepath);
+            if (!entry.hash.isEmpty() && it != entries_.constEnd() && it->hash == entry.hash)
+            {
+                entry.config = it->config;
+                return;
+            }
+            entry.config = parse(filepath, data);
+            parsedCount++;
+        });
+    }
+    threadPool_.waitForDone();
+    lastParsedCount_ = parsedCount;
+
+    const bool isModified = !changed.isEmpty() || entries_.size() != filepaths.size();
+    entries_.clear();
+    QVector<QSharedPointer<const ICustomConfig>> configs;
+    for (int i = 0; i < filepaths.size(); ++i)
+    {
+        entries_[filepaths[i]] = newEntries[i];
+        if (!newEntries[i].config.isNull())
+        {
+            configs << newEntries[i].config;
+        }
+    }
+
+    if (isModified)
+    {
+        qDebug(LOG_CUSTOM_OVPN) << "Custom configs parsed:" << lastParsedCount_ << "of" << filepaths.size();
+        save();
+    }
+    return configs;
+}
+
+void CustomConfigsIndex::load()
+{
+    QFile file(cacheFilePath_);
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    SimpleCrypt simpleCrypt(SIMPLE_CRYPT_KEY);
+    QByteArray arr = simpleCrypt.decryptToByteArray(file.readAll());
+    QDataStream ds(&arr, QIODevice::ReadOnly);
+
+    quint32 magic, version, count;
+    ds >> magic;
+    if (magic != magic_)
+        return;
+    ds >> version;
+    if (version > versionForSerialization_)
+        return;
+
+    ds >> count;
+    QHash<QString, Entry> entries;
+    for (quint32 i = 0; i < count && ds.status() == QDataStream::Ok; ++i)
+    {
+        QString filepath;
+        Entry entry;
+        qint32 type;
+        ds >> filepath >> entry.size >> entry.modified >> entry.hash >> type;
+        if (type == CUSTOM_CONFIG_OPENVPN)
+        {
+            QSharedPointer<OvpnCustomConfig> config(new OvpnCustomConfig());
+            ds >> *config;
+            entry.config = config;
+        }
+        else if (type == CUSTOM_CONFIG_WIREGUARD)
+        {
+            QSharedPointer<WireguardCustomConfig> config(new WireguardCustomConfig());
+            ds >> *config;
+            entry.config = config;
+        }
+        else
+        {
+            ds.setStatus(QDataStream::ReadCorruptData);
+        }
+        entries[filepath] = entry;
+    }
+
+    if (ds.status() == QDataStream::Ok)
+    {
+        entries_ = entries;
+    }
+}
+
+void CustomConfigsIndex::save() const
+{
+    QByteArray arr;
+    {
+        QDataStream ds(&arr, QIODevice::WriteOnly);
+        ds << magic_;
+        ds << versionForSerialization_;
+
+        // the files which could not be read are not saved, they are checked again anyway
+        quint32 count = 0;
+        for (auto it = entries_.constBegin(); it != entries_.constEnd(); ++it)
+        {
+            if (!it->hash.isEmpty() && !it->config.isNull())
+                count++;
+        }
+        ds << count;
+        for (auto it = entries_.constBegin(); it != entries_.constEnd(); ++it)
+        {
+            if (it->hash.isEmpty() || it->config.isNull())
+                continue;
+            ds << it.key() << it->size << it->modified << it->hash << (qint32)it->config->type();
+            if (it->config->type() == CUSTOM_CONFIG_OPENVPN)
+                ds << *static_cast<const OvpnCustomConfig *>(it->config.get());
+            else
+                ds << *static_cast<const WireguardCustomConfig *>(it->config.get());
+        }
+    }
+
+    SimpleCrypt simpleCrypt(SIMPLE_CRYPT_KEY);
+    QSaveFile file(cacheFilePath_);
+    if (file.open(QIODevice::WriteOnly))
+    {
+        file.write(simpleCrypt.encryptToByteArray(arr));
+        file.commit();
+    }
+}
+
+QSharedPointer<const ICustomConfig> CustomConfigsIndex::parse(const QString &filepath, const QByteArray &data)
+{
+    QFileInfo fi(filepath);
+    QString fileSuffix = fi.suffix();
+    if (fileSuffix.compare("ovpn", Qt::CaseInsensitive) == 0)
+    {
+        if (data.isNull())
+            return QSharedPointer<const ICustomConfig>(OvpnCustomConfig::makeFromFile(filepath));
+        return QSharedPointer<const ICustomConfig>(OvpnCustomConfig::makeFromData(filepath, data));
+    }
+    else if (fileSuffix.compare("conf", Qt::CaseInsensitive) == 0)
+    {
+        // QSettings reads the file itself, it is small
+        return QSharedPointer<const ICustomConfig>(WireguardCustomConfig::makeFromFile(filepath));
+    }
+
+    return NULL;
+}
+
+} //namespace customconfigs
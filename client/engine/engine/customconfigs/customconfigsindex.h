@@ -0,0 +1,51 @@
+#ifndef CUSTOMCONFIGSINDEX_H
+#define CUSTOMCONFIGSINDEX_H
+
+#include <QHash>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QVector>
+#include "icustomconfig.h"
+
+namespace customconfigs {
+
+// Parsed custom configs keyed by the file path. A file is parsed again only if its size or modification time changed
+// and then its contents (SHA-1) changed too, the new and changed files are parsed on a thread pool.
+// The index is kept in a cache file, so the configs are not parsed again after a restart either.
+class CustomConfigsIndex
+{
+public:
+    explicit CustomConfigsIndex(const QString &cacheFilePath);
+
+    // brings the index up to date with the files (full paths), returns their configs in the same order
+    QVector<QSharedPointer<const ICustomConfig>> update(const QStringList &filepaths);
+
+    // the number of the files parsed by the last update()
+    int lastParsedCount() const { return lastParsedCount_; }
+
+private:
+    static constexpr quint32 magic_ = 0x3C5A19E7;
+    static constexpr quint32 versionForSerialization_ = 1;  // should increment the version if the data format is changed
+
+    struct Entry
+    {
+        qint64 size = -1;
+        qint64 modified = 0;        // msecs since epoch
+        QByteArray hash;            // empty if the file could not be read
+        QSharedPointer<const ICustomConfig> config;
+    };
+
+    QString cacheFilePath_;
+    QHash<QString, Entry> entries_;
+    QThreadPool threadPool_;
+    int lastParsedCount_;
+
+    void load();
+    void save() const;
+    // data is null if the file could not be read, the config has the error then
+    static QSharedPointer<const ICustomConfig> parse(const QString &filepath, const QByteArray &data);
+};
+
+} //namespace customconfigs
+
+#endif // CUSTOMCONFIGSINDEX_H
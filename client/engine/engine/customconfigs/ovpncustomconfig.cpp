@@ -2,6 +2,7 @@
 #include "utils/logger.h"
 #include "parseovpnconfigline.h"
 
+#include <QBuffer>
 #include <QFileInfo>
 
 namespace customconfigs {
@@ -77,7 +78,23 @@ ICustomConfig *OvpnCustomConfig::makeFromFile(const QString &filepath)
     config->filepath_ = filepath;
     config->globalPort_ = 0;
     config->isCorrect_ = true;      // by default correct config
-    config->process();              // here the config can change to incorrect
+    QFile file(filepath);
+    config->process(&file);         // here the config can change to incorrect
+    return config;
+}
+
+ICustomConfig *OvpnCustomConfig::makeFromData(const QString &filepath, const QByteArray &data)
+{
+    OvpnCustomConfig *config = new OvpnCustomConfig();
+    QFileInfo fi(filepath);
+    config->name_ = fi.completeBaseName();
+    config->filename_ = fi.fileName();
+    config->filepath_ = filepath;
+    config->globalPort_ = 0;
+    config->isCorrect_ = true;      // by default correct config
+    QBuffer buffer;
+    buffer.setData(data);
+    config->process(&buffer);       // here the config can change to incorrect
     return config;
 }
 
@@ -104,15 +121,14 @@ QString OvpnCustomConfig::getOvpnData() const
 // retrieves all hostnames/IPs "remote ..." commands
 // also ovpn-config with removed "remote" commands saves in ovpnData_
 // removed "remote" commands are saved in remotes_ (to restore the config with changed hostnames/IPs before connect)
-void OvpnCustomConfig::process()
+void OvpnCustomConfig::process(QIODevice *device)
 {
 #ifdef Q_OS_LINUX
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-but-set-variable"
 #endif
 
-    QFile file(filepath_);
-    if (file.open(QIODevice::ReadOnly))
+    if (device->open(QIODevice::ReadOnly))
     {
         qDebug(LOG_CUSTOM_OVPN) << "Opened:" << Utils::cleanSensitiveInfo(filepath_);
 
@@ -122,7 +138,7 @@ void OvpnCustomConfig::process()
         bool isTapDevice = false;
         bool bHasValidCipher = false;
         QString currentProtocol{ "udp" };
-        QTextStream in(&file);
+        QTextStream in(device);
         while (!in.atEnd())
         {
             QString line = in.readLine();
@@ -264,6 +280,39 @@ void OvpnCustomConfig::process()
 #endif
 }
 
+QDataStream& operator <<(QDataStream &stream, const OvpnCustomConfig &c)
+{
+    stream << c.versionForSerialization_;
+    stream << c.isCorrect_ << c.errMessage_ << c.name_ << c.nick_ << c.filename_ << c.filepath_ << c.ovpnData_
+           << c.globalPort_ << c.globalProtocol_ << c.isAllowFirewallAfterConnection_;
+    stream << (quint32)c.remotes_.size();
+    for (const RemoteCommandLine &r : c.remotes_)
+        stream << r.hostname << r.originalRemoteCommand << r.port << r.protocol;
+    return stream;
+}
+
+QDataStream& operator >>(QDataStream &stream, OvpnCustomConfig &c)
+{
+    quint32 version;
+    stream >> version;
+    if (version > c.versionForSerialization_)
+    {
+        stream.setStatus(QDataStream::ReadCorruptData);
+        return stream;
+    }
+    stream >> c.isCorrect_ >> c.errMessage_ >> c.name_ >> c.nick_ >> c.filename_ >> c.filepath_ >> c.ovpnData_
+           >> c.globalPort_ >> c.globalProtocol_ >> c.isAllowFirewallAfterConnection_;
+    quint32 remotesCount;
+    stream >> remotesCount;
+    c.remotes_.clear();
+    for (quint32 i = 0; i < remotesCount && stream.status() == QDataStream::Ok; ++i)
+    {
+        RemoteCommandLine r;
+        stream >> r.hostname >> r.originalRemoteCommand >> r.port >> r.protocol;
+        c.remotes_ << r;
+    }
+    return stream;
+}
 
 } //namespace customconfigs
 
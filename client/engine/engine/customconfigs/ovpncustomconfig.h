@@ -1,6 +1,8 @@
 #ifndef OVPNCUSTOMCONFIG_H
 #define OVPNCUSTOMCONFIG_H
 
+#include <QDataStream>
+#include <QIODevice>
 #include <QVector>
 #include "icustomconfig.h"
 
@@ -29,13 +31,20 @@ public:
     QString getErrorForIncorrect() const override;
 
     static ICustomConfig *makeFromFile(const QString &filepath);
+    // the same with the contents of the file already read
+    static ICustomConfig *makeFromData(const QString &filepath, const QByteArray &data);
 
     QVector<RemoteCommandLine> remotes() const;
     uint globalPort() const;
     QString globalProtocol() const;
     QString getOvpnData() const;
 
+    friend QDataStream& operator <<(QDataStream &stream, const OvpnCustomConfig &c);
+    friend QDataStream& operator >>(QDataStream &stream, OvpnCustomConfig &c);
+
 private:
+    static constexpr quint32 versionForSerialization_ = 1;
+
     bool isCorrect_ = false;
     QString errMessage_;
 
@@ -52,7 +61,7 @@ private:
     bool isAllowFirewallAfterConnection_ = true;
 
 
-    void process();
+    void process(QIODevice *device);
 
 };
 
@@ -7,22 +7,23 @@ ParseOvpnConfigLine::OpenVpnLine ParseOvpnConfigLine::processLine(const QString
 
     if (line.contains("remote", Qt::CaseInsensitive))
     {
-        QStringList strs = splitLine(line);
+        QStringView strs[kMaxTokens];
+        const int count = splitLine(line, strs);
 
-        if (strs.count() > 0 && strs[0].compare("remote", Qt::CaseInsensitive) == 0)
+        if (count > 0 && strs[0].compare(QLatin1String("remote"), Qt::CaseInsensitive) == 0)
         {
-            if (strs.count() >= 2)
+            if (count >= 2)
             {
                 openVpnLine.type = OVPN_CMD_REMOTE_IP;
-                openVpnLine.host = strs[1];
+                openVpnLine.host = strs[1].toString();
 
-                if (strs.count() >= 3)
+                if (count >= 3)
                 {
                     openVpnLine.port = strs[2].toUInt();
 
-                    if (strs.count() >= 4)
+                    if (count >= 4)
                     {
-                        openVpnLine.protocol = strs[3].trimmed();
+                        openVpnLine.protocol = strs[3].trimmed().toString();
                     }
                 }
             }
@@ -30,24 +31,26 @@ ParseOvpnConfigLine::OpenVpnLine ParseOvpnConfigLine::processLine(const QString
     }
     else if (line.contains("proto", Qt::CaseInsensitive))
     {
-        QStringList strs = splitLine(line);
+        QStringView strs[kMaxTokens];
+        const int count = splitLine(line, strs);
 
-        if (strs.count() > 0 && strs[0].compare("proto", Qt::CaseInsensitive) == 0)
+        if (count > 0 && strs[0].compare(QLatin1String("proto"), Qt::CaseInsensitive) == 0)
         {
-            if (strs.count() >= 2)
+            if (count >= 2)
             {
                 openVpnLine.type = OVPN_CMD_PROTO;
-                openVpnLine.protocol = strs[1].trimmed();
+                openVpnLine.protocol = strs[1].trimmed().toString();
             }
         }
     }
     else if (line.contains("port", Qt::CaseInsensitive))
     {
-        QStringList strs = splitLine(line);
+        QStringView strs[kMaxTokens];
+        const int count = splitLine(line, strs);
 
-        if (strs.count() > 0 && strs[0].compare("port", Qt::CaseInsensitive) == 0)
+        if (count > 0 && strs[0].compare(QLatin1String("port"), Qt::CaseInsensitive) == 0)
         {
-            if (strs.count() >= 2)
+            if (count >= 2)
             {
                 openVpnLine.type = OVPN_CMD_PORT;
                 openVpnLine.port = strs[1].toUInt();
@@ -56,11 +59,12 @@ ParseOvpnConfigLine::OpenVpnLine ParseOvpnConfigLine::processLine(const QString
     }
     else if (line.contains("verb", Qt::CaseInsensitive))
     {
-        QStringList strs = splitLine(line);
+        QStringView strs[kMaxTokens];
+        const int count = splitLine(line, strs);
 
-        if (strs.count() > 0 && strs[0].compare("verb", Qt::CaseInsensitive) == 0)
+        if (count > 0 && strs[0].compare(QLatin1String("verb"), Qt::CaseInsensitive) == 0)
         {
-            if (strs.count() >= 2)
+            if (count >= 2)
             {
                 openVpnLine.type = OVPN_CMD_VERB;
                 openVpnLine.verb = strs[1].toUInt();
@@ -69,37 +73,40 @@ ParseOvpnConfigLine::OpenVpnLine ParseOvpnConfigLine::processLine(const QString
     }
     else if (line.contains("dev", Qt::CaseInsensitive))
     {
-        QStringList strs = splitLine(line);
+        QStringView strs[kMaxTokens];
+        const int count = splitLine(line, strs);
 
-        if (strs.count() > 0 && strs[0].compare("dev", Qt::CaseInsensitive) == 0)
+        if (count > 0 && strs[0].compare(QLatin1String("dev"), Qt::CaseInsensitive) == 0)
         {
-            if (strs.count() >= 2)
+            if (count >= 2)
             {
                 openVpnLine.type = OVPN_CMD_DEVICE;
-                openVpnLine.protocol = strs[1];
+                openVpnLine.protocol = strs[1].toString();
             }
         }
     }
     else if (line.contains("cipher", Qt::CaseInsensitive))
     {
-        QStringList strs = splitLine(line);
+        QStringView strs[kMaxTokens];
+        const int count = splitLine(line, strs);
 
-        if (strs.count() > 0 && strs[0].compare("cipher", Qt::CaseInsensitive) == 0)
+        if (count > 0 && strs[0].compare(QLatin1String("cipher"), Qt::CaseInsensitive) == 0)
         {
-            if (strs.count() >= 2)
+            if (count >= 2)
             {
                 openVpnLine.type = OVPN_CMD_CIPHER;
-                openVpnLine.protocol = strs[1];
+                openVpnLine.protocol = strs[1].toString();
             }
         }
     }
     else if (line.contains("script-security", Qt::CaseInsensitive))
     {
-        QStringList strs = splitLine(line);
+        QStringView strs[kMaxTokens];
+        const int count = splitLine(line, strs);
 
-        if (strs.count() > 0 && strs[0].compare("script-security", Qt::CaseInsensitive) == 0)
+        if (count > 0 && strs[0].compare(QLatin1String("script-security"), Qt::CaseInsensitive) == 0)
         {
-            if (strs.count() >= 2)
+            if (count >= 2)
             {
                 openVpnLine.type = OVPN_CMD_SCRIPT_SECURITY;
                 openVpnLine.verb = strs[1].toUInt();
@@ -113,75 +120,48 @@ ParseOvpnConfigLine::OpenVpnLine ParseOvpnConfigLine::processLine(const QString
     }
     else if (line.contains("pull-filter", Qt::CaseInsensitive))
     {
-        QStringList strs = splitLine(line);
-        if (strs.count() > 2 &&
-            strs[0].compare("pull-filter", Qt::CaseInsensitive) == 0 &&
-            strs[1].compare("ignore", Qt::CaseInsensitive) == 0 &&
-            strs[2].compare("redirect-gateway", Qt::CaseInsensitive) == 0)
+        QStringView strs[kMaxTokens];
+        const int count = splitLine(line, strs);
+        if (count > 2 &&
+            strs[0].compare(QLatin1String("pull-filter"), Qt::CaseInsensitive) == 0 &&
+            strs[1].compare(QLatin1String("ignore"), Qt::CaseInsensitive) == 0 &&
+            strs[2].compare(QLatin1String("redirect-gateway"), Qt::CaseInsensitive) == 0)
             openVpnLine.type = OVPN_CMD_IGNORE_REDIRECT_GATEWAY;
     }
 
     return openVpnLine;
 }
 
-QStringList ParseOvpnConfigLine::splitLine(const QString &line)
+int ParseOvpnConfigLine::splitLine(QStringView line, QStringView *outTokens)
 {
-    QStringList res;
+    // a token is either a run of non-space characters or a quoted string up to the next quote (with the quotes),
+    // so the tokens are slices of the line and nothing is copied
+    int count = 0;
     int i = 0;
-    QString curString;
-    bool isInsideString = false;
-    bool isInsideQuetes = false;
-
-    while (i < line.count())
+    const int size = line.size();
+    while (i < size && count < kMaxTokens)
     {
-        if (isInsideString)
+        if (line[i].isSpace())
         {
-            if (isInsideQuetes)
-            {
-                curString += line[i];
-                if (line[i] == '\'' || line[i] == '\"')
-                {
-                    isInsideQuetes = false;
-                    isInsideString = false;
-                    res << curString;
-                    curString.clear();
-                }
-            }
-            else
-            {
-                if (line[i].isSpace())
-                {
-                    isInsideString = false;
-                    res << curString;
-                    curString.clear();
-                }
-                else
-                {
-                    curString += line[i];
-                }
-            }
+            i++;
+            continue;
+        }
+
+        const int start = i;
+        if (line[i] == '\'' || line[i] == '\"')
+        {
+            i++;
+            while (i < size && line[i] != '\'' && line[i] != '\"')
+                i++;
+            if (i < size)
+                i++;
         }
         else
         {
-            if (line[i] == '\'' || line[i] == '\"')
-            {
-                isInsideQuetes = true;
-                isInsideString = true;
-                curString += line[i];
-            }
-            else if (!line[i].isSpace())
-            {
-                isInsideQuetes = false;
-                isInsideString = true;
-                curString += line[i];
-            }
+            while (i < size && !line[i].isSpace())
+                i++;
         }
-        i++;
-    }
-
-    if (!curString.isEmpty())
-    {
-        res << curString;
+        outTokens[count++] = line.mid(start, i - start);
     }
-    return res;
+    return count;
 }
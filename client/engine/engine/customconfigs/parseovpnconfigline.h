@@ -35,7 +35,10 @@ public:
     static OpenVpnLine processLine(const QString &line);
 
 private:
-    static QStringList splitLine(const QString &line);
+    static constexpr int kMaxTokens = 4;    // "remote host port proto", the rest of the line is not needed
+
+    // fills up to kMaxTokens tokens of the line, returns their count
+    static int splitLine(QStringView line, QStringView *outTokens);
 };
 
 #endif // PARSEOVPNCONFIGLINE_H
@@ -0,0 +1,139 @@
+#include <QtTest>
+
+#include "engine/customconfigs/customconfigsindex.h"
+#include "engine/customconfigs/ovpncustomconfig.h"
+#include "engine/customconfigs/wireguardcustomconfig.h"
+
+// Generates a directory of kConfigsCount configs (ovpn with inline certificates and a few WireGuard ones) and reports
+// the time of parsing all of them one by one as before, and of CustomConfigsIndex: the first time, after one file was
+// changed, after one file was touched without changes and after a restart (from the cache file).
+class BenchCustomConfigs : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void benchmark_parse_all();
+    void benchmark_index();
+
+private:
+    static constexpr int kConfigsCount = 1000;
+    static constexpr int kWireguardEvery = 10;      // every 10th config is a WireGuard one
+
+    QTemporaryDir dir_;
+    QStringList filepaths_;
+
+    static QByteArray ovpnConfig(int ind);
+    static QByteArray wireguardConfig(int ind);
+};
+
+QByteArray BenchCustomConfigs::ovpnConfig(int ind)
+{
+    QByteArray data = "client\ndev tun\nproto udp\n";
+    for (int i = 0; i < 3; ++i)
+        data += QString("remote server%1-%2.example.com %3 udp\n").arg(ind).arg(i).arg(1194 + i).toLatin1();
+    data += "resolv-retry infinite\nnobind\npersist-key\npersist-tun\ncipher AES-256-GCM\nauth SHA512\nverb 3\n";
+    data += "<ca>\n-----BEGIN CERTIFICATE-----\n";
+    for (int i = 0; i < 80; ++i)
+        data += QByteArray(64, 'A' + (ind + i) % 26) + "\n";
+    data += "-----END CERTIFICATE-----\n</ca>\n<tls-auth>\n";
+    for (int i = 0; i < 16; ++i)
+        data += QByteArray(32, 'a' + (ind + i) % 26) + "\n";
+    data += "</tls-auth>\nkey-direction 1\n";
+    return data;
+}
+
+QByteArray BenchCustomConfigs::wireguardConfig(int ind)
+{
+    return QString("[Interface]\nPrivateKey = %1=\nAddress = 100.64.%2.%3/32\nDNS = 10.255.255.1\n\n"
+                   "[Peer]\nPublicKey = %4=\nAllowedIPs = 0.0.0.0/0\nEndpoint = wg%5.example.com:51820\n")
+        .arg(QString(43, 'k')).arg(ind / 250).arg(ind % 250 + 1).arg(QString(43, 'p')).arg(ind).toLatin1();
+}
+
+void BenchCustomConfigs::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    // the parser logs every remote command
+    QLoggingCategory::setFilterRules("custom_ovpn.debug=false");
+
+    QVERIFY(dir_.isValid());
+    for (int i = 0; i < kConfigsCount; ++i) {
+        const bool isWireguard = (i % kWireguardEvery == 0);
+        const QString filepath = dir_.path() + QString("/config%1.%2").arg(i, 4, 10, QChar('0')).arg(isWireguard ? "conf" : "ovpn");
+        QFile file(filepath);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(isWireguard ? wireguardConfig(i) : ovpnConfig(i));
+        filepaths_ << filepath;
+    }
+}
+
+void BenchCustomConfigs::benchmark_parse_all()
+{
+    QElapsedTimer timer;
+    timer.start();
+    int correctCount = 0;
+    for (const QString &filepath : std::as_const(filepaths_)) {
+        QScopedPointer<customconfigs::ICustomConfig> config(filepath.endsWith(".ovpn")
+            ? customconfigs::OvpnCustomConfig::makeFromFile(filepath)
+            : customconfigs::WireguardCustomConfig::makeFromFile(filepath));
+        if (config->isCorrect())
+            correctCount++;
+    }
+    qDebug() << "parse all one by one, ms:" << timer.elapsed();
+    QCOMPARE(correctCount, kConfigsCount);
+}
+
+void BenchCustomConfigs::benchmark_index()
+{
+    const QString cacheFilePath = dir_.path() + "/custom_configs.cache";
+    QElapsedTimer timer;
+
+    {
+        customconfigs::CustomConfigsIndex index(cacheFilePath);
+        timer.start();
+        QVector<QSharedPointer<const customconfigs::ICustomConfig>> configs = index.update(filepaths_);
+        qDebug() << "index, first update, ms:" << timer.elapsed() << "parsed:" << index.lastParsedCount();
+        QCOMPARE(configs.size(), kConfigsCount);
+        QCOMPARE(index.lastParsedCount(), kConfigsCount);
+        for (const auto &config : configs)
+            QVERIFY(config->isCorrect());
+
+        // one config changed
+        {
+            QFile file(filepaths_[1]);
+            QVERIFY(file.open(QIODevice::Append));
+            file.write("remote added.example.com 443 tcp\n");
+        }
+        timer.start();
+        configs = index.update(filepaths_);
+        qDebug() << "index, one file changed, ms:" << timer.elapsed() << "parsed:" << index.lastParsedCount();
+        QCOMPARE(index.lastParsedCount(), 1);
+        QCOMPARE(configs[1]->hostnames().size(), 4);
+
+        // one config touched, the contents are the same
+        {
+            QFile file(filepaths_[2]);
+            QVERIFY(file.open(QIODevice::ReadWrite));
+            QVERIFY(file.setFileTime(QDateTime::currentDateTime().addSecs(60), QFileDevice::FileModificationTime));
+        }
+        timer.start();
+        configs = index.update(filepaths_);
+        qDebug() << "index, one file touched, ms:" << timer.elapsed() << "parsed:" << index.lastParsedCount();
+        QCOMPARE(index.lastParsedCount(), 0);
+        QCOMPARE(configs.size(), kConfigsCount);
+    }
+
+    // a restart
+    timer.start();
+    customconfigs::CustomConfigsIndex index(cacheFilePath);
+    QVector<QSharedPointer<const customconfigs::ICustomConfig>> configs = index.update(filepaths_);
+    qDebug() << "index, restart with the cache file, ms:" << timer.elapsed() << "parsed:" << index.lastParsedCount();
+    QCOMPARE(index.lastParsedCount(), 0);
+    QCOMPARE(configs.size(), kConfigsCount);
+    QCOMPARE(configs[1]->hostnames().size(), 4);
+    QCOMPARE(configs[0]->nick(), QString("wg0.example.com"));
+    QCOMPARE(configs[3]->nick(), QString("server3-0.example.com"));
+}
+
+QTEST_MAIN(BenchCustomConfigs)
+#include "customconfigs.bench.moc"
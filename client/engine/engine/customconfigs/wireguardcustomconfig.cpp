@@ -140,5 +140,28 @@ void WireguardCustomConfig::validate()
         errMessage_ = QObject::tr("Missing \"Endpoint\" in the \"Peer\" section");
 }
 
+QDataStream& operator <<(QDataStream &stream, const WireguardCustomConfig &c)
+{
+    stream << c.versionForSerialization_;
+    stream << c.errMessage_ << c.name_ << c.nick_ << c.filename_ << c.privateKey_ << c.ipAddress_ << c.dnsAddress_
+           << c.publicKey_ << c.presharedKey_ << c.allowedIps_ << c.endpointHostname_ << c.endpointPort_
+           << c.endpointPortNumber_ << c.isAllowFirewallAfterConnection_;
+    return stream;
+}
+
+QDataStream& operator >>(QDataStream &stream, WireguardCustomConfig &c)
+{
+    quint32 version;
+    stream >> version;
+    if (version > c.versionForSerialization_) {
+        stream.setStatus(QDataStream::ReadCorruptData);
+        return stream;
+    }
+    stream >> c.errMessage_ >> c.name_ >> c.nick_ >> c.filename_ >> c.privateKey_ >> c.ipAddress_ >> c.dnsAddress_
+           >> c.publicKey_ >> c.presharedKey_ >> c.allowedIps_ >> c.endpointHostname_ >> c.endpointPort_
+           >> c.endpointPortNumber_ >> c.isAllowFirewallAfterConnection_;
+    return stream;
+}
+
 } //namespace customconfigs
 
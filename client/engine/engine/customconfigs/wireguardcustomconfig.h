@@ -3,6 +3,7 @@
 
 #include "icustomconfig.h"
 #include "engine/wireguardconfig/wireguardconfig.h"
+#include <QDataStream>
 #include <QSharedPointer>
 
 namespace customconfigs {
@@ -26,7 +27,12 @@ public:
 
     static ICustomConfig *makeFromFile(const QString &filepath);
 
+    friend QDataStream& operator <<(QDataStream &stream, const WireguardCustomConfig &c);
+    friend QDataStream& operator >>(QDataStream &stream, WireguardCustomConfig &c);
+
 private:
+    static constexpr quint32 versionForSerialization_ = 1;
+
     void loadFromFile(const QString &filepath);
     void validate();
 
@@ -0,0 +1,454 @@
+#include "aresloop.h"
+#include "dnsutils.h"
+#include "utils/crashhandler.h"
+#include "utils/logger.h"
+#include "utils/ws_assert.h"
+
+#include <string.h>
+#include <vector>
+
+#if defined(Q_OS_MAC) || defined(Q_OS_LINUX)
+    #include <netinet/in.h>
+    #include <arpa/inet.h>
+#endif
+
+namespace {
+
+bool isDefinitiveAnswer(int status)
+{
+    // the other errors (timeouts, refused connections, server failures) are retried while the lookup timeout allows
+    return status == ARES_SUCCESS || status == ARES_ENOTFOUND || status == ARES_ENODATA || status == ARES_EBADNAME ||
+           status == ARES_EDESTRUCTION || status == ARES_ECANCELLED;
+}
+
+} // namespace
+
+AresLoop::AresLoop(QObject *parent) : QThread(parent),
+    bFinish_(false),
+    poller_(new wsl::SocketPoller())
+{
+    start();
+}
+
+AresLoop::~AresLoop()
+{
+    finish();
+    delete poller_;
+}
+
+void AresLoop::lookup(const QString &hostname, const QStringList &dnsServers, int timeoutMs, const QObject *object, ResultCallback callback)
+{
+    QMutexLocker locker(&finishMutex_);
+    if (bFinish_) {
+        locker.unlock();
+        callback(Result());
+        return;
+    }
+
+    Lookup *lookup = new Lookup();
+    lookup->hostname = hostname;
+    lookup->dnsServers = dnsServers;
+    lookup->timeoutMs = timeoutMs;
+    lookup->object = object;
+    lookup->callback = callback;
+    lookup->elapsedTimer.start();
+    if (commands_.push(Command { Command::LOOKUP, lookup, object }))
+        poller_->wakeup();
+}
+
+void AresLoop::cancel(const QObject *object)
+{
+    if (commands_.push(Command { Command::CANCEL, nullptr, object }))
+        poller_->wakeup();
+}
+
+void AresLoop::finish()
+{
+    if (!isRunning())
+        return;
+    {
+        QMutexLocker locker(&finishMutex_);
+        bFinish_ = true;
+    }
+    poller_->wakeup();
+    wait();
+}
+
+void AresLoop::run()
+{
+    BIND_CRASH_HANDLER_FOR_THREAD();
+    clock_.start();
+
+    std::vector<wsl::SocketPoller::Event> events;
+    while (!bFinish_) {
+        processCommands();
+        startDueRetries();
+        startQueuedLookups();
+
+        events.clear();
+        poller_->wait(nextWaitMs(), events);
+
+        for (const wsl::SocketPoller::Event &event : events) {
+            Channel *channel = sockets_.value(event.socket, nullptr);
+            if (channel)
+                ares_process_fd(channel->channel, event.readable ? event.socket : ARES_SOCKET_BAD, event.writable ? event.socket : ARES_SOCKET_BAD);
+        }
+
+        // let c-ares handle its own query timeouts
+        for (int i = 0; i < channels_.count(); ++i) {
+            if (channels_[i]->runningQueries > 0)
+                ares_process_fd(channels_[i]->channel, ARES_SOCKET_BAD, ARES_SOCKET_BAD);
+        }
+
+        processTimeouts();
+        removeIdleChannels(false);
+    }
+
+    // the lookups which were not taken into work
+    commands_.popAll([](Command &&command) {
+        if (command.type == Command::LOOKUP) {
+            command.lookup->callback(command.lookup->result);
+            delete command.lookup;
+        }
+    });
+
+    while (!retries_.empty()) {
+        Lookup *lookup = retries_.begin()->second;
+        unscheduleRetry(lookup);
+        if (!lookup->isDone)
+            deliverResult(lookup);
+        delete lookup;
+    }
+
+    while (!queuedLookups_.empty()) {
+        Lookup *lookup = queuedLookups_.front();
+        queuedLookups_.pop_front();
+        if (!lookup->isDone)
+            deliverResult(lookup);
+        delete lookup;
+    }
+
+    // destroying the channels completes all the running queries with ARES_EDESTRUCTION
+    removeIdleChannels(true);
+    WS_ASSERT(deadlines_.empty());
+}
+
+void AresLoop::processCommands()
+{
+    commands_.popAll([this](Command &&command) {
+        if (command.type == Command::LOOKUP) {
+            startLookup(command.lookup);
+        } else if (command.type == Command::CANCEL) {
+            auto it = lookupsByObject_.find(command.object);
+            if (it != lookupsByObject_.end()) {
+                Lookup *lookup = it.value();
+                lookupsByObject_.erase(it);
+                lookup->isDone = true;
+                deadlines_.erase(lookup->deadlineIt);
+                lookup->deadlineIt = deadlines_.end();
+                unscheduleRetry(lookup);
+                // otherwise it will be deleted in startQueuedLookups() or addrInfoCallback
+                if (!lookup->isQueued && !lookup->isQueryRunning)
+                    delete lookup;
+            }
+        }
+    });
+}
+
+void AresLoop::startLookup(Lookup *lookup)
+{
+    lookup->deadline = clock_.elapsed() + qMax(0, lookup->timeoutMs - int(lookup->elapsedTimer.elapsed()));
+    lookup->deadlineIt = deadlines_.insert(std::make_pair(lookup->deadline, lookup));
+    if (lookup->object)
+        lookupsByObject_[lookup->object] = lookup;
+    lookup->isQueued = true;
+    queuedLookups_.push_back(lookup);
+}
+
+void AresLoop::startQueuedLookups()
+{
+    for (int i = 0; i < kMaxQueriesPerIteration && !queuedLookups_.empty(); ++i) {
+        Lookup *lookup = queuedLookups_.front();
+        queuedLookups_.pop_front();
+        lookup->isQueued = false;
+
+        // canceled or timed out while waiting in the queue
+        if (lookup->isDone) {
+            delete lookup;
+            continue;
+        }
+
+        lookup->channel = getChannel(lookup->dnsServers);
+        if (!lookup->channel) {
+            lookup->result.errorCode = ARES_ENOMEM;
+            deliverResult(lookup);
+            delete lookup;
+            continue;
+        }
+        startQuery(lookup);
+    }
+}
+
+void AresLoop::startQuery(Lookup *lookup)
+{
+    Channel *channel = lookup->channel;
+    lookup->isQueryRunning = true;
+    channel->runningQueries++;
+    channel->lastUsedTime = clock_.elapsed();
+
+    struct ares_addrinfo_hints hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    // the callback can be called synchronously and delete the lookup, so don't touch it after this call
+    ares_getaddrinfo(channel->channel, lookup->hostname.toStdString().c_str(), NULL, &hints, addrInfoCallback, lookup);
+}
+
+void AresLoop::scheduleRetry(Lookup *lookup, int status)
+{
+    lookup->retryDelayMs = lookup->retryDelayMs == 0 ? kRetryInitialDelayMs : qMin(lookup->retryDelayMs * 2, kRetryMaxDelayMs);
+    const qint64 retryTime = clock_.elapsed() + lookup->retryDelayMs;
+    if (bFinish_ || retryTime >= lookup->deadline) {
+        lookup->result.errorCode = status;
+        deliverResult(lookup);
+        delete lookup;
+        return;
+    }
+    lookup->retryIt = retries_.insert(std::make_pair(retryTime, lookup));
+    lookup->isRetryScheduled = true;
+}
+
+void AresLoop::startDueRetries()
+{
+    const qint64 now = clock_.elapsed();
+    while (!retries_.empty() && retries_.begin()->first <= now) {
+        Lookup *lookup = retries_.begin()->second;
+        unscheduleRetry(lookup);
+        // the channel may have been destroyed as idle meanwhile
+        lookup->channel = getChannel(lookup->dnsServers);
+        if (!lookup->channel) {
+            lookup->result.errorCode = ARES_ENOMEM;
+            deliverResult(lookup);
+            delete lookup;
+            continue;
+        }
+        startQuery(lookup);
+    }
+}
+
+void AresLoop::unscheduleRetry(Lookup *lookup)
+{
+    if (lookup->isRetryScheduled) {
+        retries_.erase(lookup->retryIt);
+        lookup->isRetryScheduled = false;
+    }
+}
+
+void AresLoop::deliverResult(Lookup *lookup)
+{
+    WS_ASSERT(!lookup->isDone);
+    lookup->isDone = true;
+    if (lookup->deadlineIt != deadlines_.end()) {
+        deadlines_.erase(lookup->deadlineIt);
+        lookup->deadlineIt = deadlines_.end();
+    }
+    if (lookup->object) {
+        auto it = lookupsByObject_.find(lookup->object);
+        if (it != lookupsByObject_.end() && it.value() == lookup)
+            lookupsByObject_.erase(it);
+    }
+    lookup->result.elapsedMs = lookup->elapsedTimer.elapsed();
+    lookup->callback(lookup->result);
+}
+
+void AresLoop::processTimeouts()
+{
+    const qint64 now = clock_.elapsed();
+    while (!deadlines_.empty() && deadlines_.begin()->first <= now) {
+        Lookup *lookup = deadlines_.begin()->second;
+        lookup->result.ips.clear();
+        lookup->result.ttl = -1;
+        lookup->result.errorCode = ARES_ETIMEOUT;
+        deliverResult(lookup);
+        unscheduleRetry(lookup);
+        // otherwise it will be deleted in startQueuedLookups() or in addrInfoCallback, when c-ares gives up the query
+        if (!lookup->isQueued && !lookup->isQueryRunning)
+            delete lookup;
+    }
+}
+
+void AresLoop::removeIdleChannels(bool removeAll)
+{
+    const qint64 now = clock_.elapsed();
+    for (int i = channels_.count() - 1; i >= 0; --i) {
+        Channel *channel = channels_[i];
+        bool isRemove = removeAll;
+        if (!isRemove && channel->runningQueries == 0) {
+            isRemove = channel->isRetired || (now - channel->lastUsedTime) > kChannelIdleTimeoutMs ||
+                       (channel->isOsDefault && (now - channel->createdTime) > kOsDefaultChannelMaxAgeMs);
+        }
+        if (isRemove)
+            destroyChannel(channel);
+    }
+}
+
+void AresLoop::destroyChannel(Channel *channel)
+{
+    // calls addrInfoCallback for the running queries and sockStateCallback for the sockets
+    ares_destroy(channel->channel);
+    channels_.removeOne(channel);
+    delete channel;
+}
+
+AresLoop::Channel *AresLoop::getChannel(const QStringList &dnsServers)
+{
+    const QStringList dnsIps = getDnsIps(dnsServers);
+    const QString key = dnsIps.join(",");
+    const qint64 now = clock_.elapsed();
+
+    for (Channel *channel : qAsConst(channels_)) {
+        if (channel->isRetired || channel->key != key)
+            continue;
+        if (channel->isOsDefault && (now - channel->createdTime) > kOsDefaultChannelMaxAgeMs) {
+            channel->isRetired = true;
+            break;
+        }
+        return channel;
+    }
+
+    Channel *channel = new Channel();
+    channel->loop = this;
+    channel->key = key;
+    channel->isOsDefault = dnsIps.isEmpty();
+    channel->createdTime = now;
+    channel->lastUsedTime = now;
+
+    struct ares_options options;
+    memset(&options, 0, sizeof(options));
+    options.tries = 1;
+    options.timeout = kQueryTimeoutMs;
+    options.sock_state_cb = sockStateCallback;
+    options.sock_state_cb_data = channel;
+    int optmask = ARES_OPT_TRIES | ARES_OPT_TIMEOUTMS | ARES_OPT_SOCK_STATE_CB;
+
+    int status = ares_init_options(&channel->channel, &options, optmask);
+    if (status == ARES_SUCCESS && !dnsIps.isEmpty()) {
+        // accepts "ip" and "ip:port" entries
+        status = ares_set_servers_ports_csv(channel->channel, key.toStdString().c_str());
+        if (status != ARES_SUCCESS)
+            ares_destroy(channel->channel);
+    }
+    if (status != ARES_SUCCESS) {
+        qCDebug(LOG_BASIC) << "ares channel initialization failed:" << QString::fromStdString(ares_strerror(status));
+        delete channel;
+        return nullptr;
+    }
+
+    channels_ << channel;
+    return channel;
+}
+
+qint64 AresLoop::nextWaitMs()
+{
+    if (!queuedLookups_.empty())
+        return 0;
+
+    qint64 waitMs = -1;
+    if (!deadlines_.empty())
+        waitMs = qMax<qint64>(0, deadlines_.begin()->first - clock_.elapsed());
+    if (!retries_.empty()) {
+        const qint64 ms = qMax<qint64>(0, retries_.begin()->first - clock_.elapsed());
+        if (waitMs < 0 || ms < waitMs)
+            waitMs = ms;
+    }
+
+    for (Channel *channel : qAsConst(channels_)) {
+        if (channel->runningQueries == 0)
+            continue;
+        struct timeval tv;
+        if (ares_timeout(channel->channel, nullptr, &tv)) {
+            const qint64 ms = qint64(tv.tv_sec) * 1000 + (tv.tv_usec + 999) / 1000;
+            if (waitMs < 0 || ms < waitMs)
+                waitMs = ms;
+        }
+    }
+
+    // wake up from time to time to remove idle channels
+    if (!channels_.isEmpty() && (waitMs < 0 || waitMs > 1000))
+        waitMs = 1000;
+    return waitMs;
+}
+
+QStringList AresLoop::getDnsIps(const QStringList &ips)
+{
+    if (ips.isEmpty()) {
+#if defined(Q_OS_MAC)
+        QStringList osDefaultList;  // Empty by default.
+        // On Mac, don't rely on automatic OS default DNS fetch in CARES, because it reads them from
+        // the "/etc/resolv.conf", which is sometimes not available immediately after reboot.
+        // Feed the CARES with valid OS default DNS values taken from scutil.
+        const auto listDns = DnsUtils::getOSDefaultDnsServers();
+        for (auto it = listDns.cbegin(); it != listDns.cend(); ++it)
+            osDefaultList.push_back(QString::fromStdWString(*it));
+        return osDefaultList;
+#endif
+    }
+    return ips;
+}
+
+void AresLoop::sockStateCallback(void *data, ares_socket_t socket, int readable, int writable)
+{
+    Channel *channel = static_cast<Channel *>(data);
+    AresLoop *this_ = channel->loop;
+    if (readable || writable)
+        this_->sockets_[socket] = channel;
+    else
+        this_->sockets_.remove(socket);
+    this_->poller_->update(socket, readable, writable);
+}
+
+void AresLoop::addrInfoCallback(void *arg, int status, int timeouts, struct ares_addrinfo *result)
+{
+    Q_UNUSED(timeouts);
+    Lookup *lookup = static_cast<Lookup *>(arg);
+    AresLoop *this_ = lookup->channel->loop;
+    lookup->isQueryRunning = false;
+    lookup->channel->runningQueries--;
+
+    QStringList ips;
+    int ttl = -1;
+    if (status == ARES_SUCCESS) {
+        for (struct ares_addrinfo_node *node = result->nodes; node; node = node->ai_next) {
+            if (node->ai_family != AF_INET)
+                continue;
+            char addr_buf[46] = "??";
+            ares_inet_ntop(AF_INET, &((struct sockaddr_in *)node->ai_addr)->sin_addr, addr_buf, sizeof(addr_buf));
+            const QString address = QString::fromStdString(addr_buf);
+            if (!ips.contains(address))
+                ips << address;
+            if (ttl < 0 || node->ai_ttl < ttl)
+                ttl = node->ai_ttl;
+        }
+    }
+    if (result)
+        ares_freeaddrinfo(result);
+
+    // timed out or canceled before
+    if (lookup->isDone) {
+        delete lookup;
+        return;
+    }
+
+    // the next try is started from the loop, never from here: c-ares can call back synchronously from ares_getaddrinfo()
+    if (!isDefinitiveAnswer(status)) {
+        lookup->result.ips.clear();
+        lookup->result.ttl = -1;
+        this_->scheduleRetry(lookup, status);
+        return;
+    }
+
+    lookup->result.ips = ips;
+    lookup->result.ttl = ttl;
+    lookup->result.errorCode = status;
+    this_->deliverResult(lookup);
+    delete lookup;
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QThread>
+#include <QVector>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+
+#include "ares.h"
+#include "utils/mpscqueue.h"
+#include "utils/socketpoller.h"
+
+// A single thread which owns long-lived c-ares channels (one per set of DNS servers) and multiplexes all lookups on them.
+// The sockets of all channels are watched with epoll on Linux and poll() on other platforms.
+// Used by DnsResolver only.
+class AresLoop : public QThread
+{
+    Q_OBJECT
+public:
+    struct Result {
+        QStringList ips;
+        int ttl = -1;
+        int errorCode = ARES_ECANCELLED;
+        qint64 elapsedMs = 0;
+    };
+    typedef std::function<void(const Result &result)> ResultCallback;
+
+    explicit AresLoop(QObject *parent = nullptr);
+    virtual ~AresLoop();
+
+    // Can be called from any thread. The callback is called from the loop thread.
+    // The object is used as a key for cancel(), can be nullptr.
+    void lookup(const QString &hostname, const QStringList &dnsServers, int timeoutMs, const QObject *object, ResultCallback callback);
+    // the callback of the lookup will not be called
+    void cancel(const QObject *object);
+    void finish();
+
+protected:
+    void run() override;
+
+private:
+    // per one DNS query try
+    static constexpr int kQueryTimeoutMs = 2000;
+    // channels which are not used for this time are destroyed
+    static constexpr qint64 kChannelIdleTimeoutMs = 60000;
+    // a channel with the OS default DNS servers reads them on creation, so recreate it from time to time
+    // to pick up the changes of the network configuration
+    static constexpr qint64 kOsDefaultChannelMaxAgeMs = 10000;
+    // the answers are read between the batches, otherwise a burst of lookups can overflow the receive buffer of the socket
+    static constexpr int kMaxQueriesPerIteration = 64;
+    // the failed queries (timeouts, refused connections, server failures) are retried with these delays, doubled every try
+    static constexpr int kRetryInitialDelayMs = 50;
+    static constexpr int kRetryMaxDelayMs = 1000;
+
+    struct Channel;
+
+    struct Lookup {
+        QString hostname;
+        QStringList dnsServers;
+        int timeoutMs;
+        const QObject *object;
+        ResultCallback callback;
+
+        QElapsedTimer elapsedTimer;
+        qint64 deadline = 0;
+        std::multimap<qint64, Lookup *>::iterator deadlineIt;
+        std::multimap<qint64, Lookup *>::iterator retryIt;
+        Channel *channel = nullptr;
+        int retryDelayMs = 0;
+        bool isQueued = false;          // waits in queuedLookups_ for its query to be started
+        bool isRetryScheduled = false;  // waits in retries_ for the next try of its query
+        bool isQueryRunning = false;    // the c-ares callback has not been called yet
+        bool isDone = false;            // the result has been delivered (or the lookup was canceled)
+        Result result;
+    };
+
+    struct Channel {
+        AresLoop *loop;
+        QString key;
+        ares_channel channel = nullptr;
+        qint64 createdTime = 0;
+        qint64 lastUsedTime = 0;
+        int runningQueries = 0;
+        bool isOsDefault = false;
+        bool isRetired = false;     // replaced with a new channel, destroyed when its queries are done
+    };
+
+    struct Command {
+        enum TYPE { LOOKUP, CANCEL };
+        TYPE type;
+        Lookup *lookup;             // for LOOKUP
+        const QObject *object;      // for CANCEL
+    };
+
+    wsl::MpscQueue<Command> commands_;
+    std::atomic<bool> bFinish_;
+    // lookup() checks bFinish_ and pushes under it, so a lookup is either failed right away
+    // or pushed before the final drain of commands_ in run()
+    QMutex finishMutex_;
+
+    // accessed only from the loop thread
+    QElapsedTimer clock_;
+    QVector<Channel *> channels_;
+    QHash<ares_socket_t, Channel *> sockets_;
+    std::multimap<qint64, Lookup *> deadlines_;
+    std::multimap<qint64, Lookup *> retries_;
+    std::deque<Lookup *> queuedLookups_;
+    QHash<const QObject *, Lookup *> lookupsByObject_;
+
+    wsl::SocketPoller *poller_;
+
+    void processCommands();
+    void startLookup(Lookup *lookup);
+    void startQueuedLookups();
+    void startQuery(Lookup *lookup);
+    void scheduleRetry(Lookup *lookup, int status);
+    void startDueRetries();
+    void unscheduleRetry(Lookup *lookup);
+    void deliverResult(Lookup *lookup);
+    void processTimeouts();
+    void removeIdleChannels(bool removeAll);
+    void destroyChannel(Channel *channel);
+    Channel *getChannel(const QStringList &dnsServers);
+    qint64 nextWaitMs();
+
+    static QStringList getDnsIps(const QStringList &ips);
+    static void sockStateCallback(void *data, ares_socket_t socket, int readable, int writable);
+    static void addrInfoCallback(void *arg, int status, int timeouts, struct ares_addrinfo *result);
+};
@@ -4,12 +4,14 @@
 #include "ares.h"
 
 DnsRequest::DnsRequest(QObject *parent, const QString &hostname, const QStringList &dnsServers, int timeoutMs /*= 5000*/)
-    : QObject(parent), hostname_(hostname), dnsServers_(dnsServers), timeoutMs_(timeoutMs), aresErrorCode_(ARES_SUCCESS)
+    : QObject(parent), hostname_(hostname), ttl_(-1), dnsServers_(dnsServers), timeoutMs_(timeoutMs), aresErrorCode_(ARES_SUCCESS)
 {
 }
 
 DnsRequest::~DnsRequest()
 {
+    if (privateDnsRequestObject_)
+        DnsResolver::instance().cancel(privateDnsRequestObject_.get());
 }
 
 QStringList DnsRequest::ips() const
@@ -17,6 +19,11 @@ QStringList DnsRequest::ips() const
     return ips_;
 }
 
+int DnsRequest::ttl() const
+{
+    return ttl_;
+}
+
 QString DnsRequest::hostname() const
 {
     return hostname_;
@@ -47,21 +54,22 @@ void DnsRequest::lookup()
 
 void DnsRequest::lookupBlocked()
 {
-    ips_ = DnsResolver::instance().lookupBlocked(hostname_, dnsServers_, timeoutMs_, &aresErrorCode_);
+    ips_ = DnsResolver::instance().lookupBlocked(hostname_, dnsServers_, timeoutMs_, &aresErrorCode_, &ttl_);
 }
 
-void DnsRequest::onResolved(const QStringList &ips, int aresErrorCode, qint64 elapsedMs)
+void DnsRequest::onResolved(const QStringList &ips, int ttl, int aresErrorCode, qint64 elapsedMs)
 {
     elapsedMs_ = elapsedMs;
     aresErrorCode_ = aresErrorCode;
     ips_ = ips;
+    ttl_ = ttl;
     if (isError()) {
         qCDebug(LOG_NETWORK) << "Could not resolve" << hostname_ << "(servers:" << dnsServers_ << "):" << aresErrorCode;
     }
     emit finished();
 }
 
-void DnsRequestPrivate::onResolved(const QStringList &ips, int aresErrorCode, qint64 elapsedMs)
+void DnsRequestPrivate::onResolved(const QStringList &ips, int ttl, int aresErrorCode, qint64 elapsedMs)
 {
-    emit resolved(ips, aresErrorCode, elapsedMs);
+    emit resolved(ips, ttl, aresErrorCode, elapsedMs);
 }
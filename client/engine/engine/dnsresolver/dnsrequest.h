@@ -16,6 +16,8 @@ public:
     void lookupBlocked();
 
     QStringList ips() const;
+    // minimal TTL of the received records in seconds, -1 if unknown (for example, the hostname is an IP address)
+    int ttl() const;
     QString hostname() const;
     bool isError() const;
     QString errorString() const;
@@ -25,11 +27,12 @@ signals:
     void finished();
 
 private slots:
-    void onResolved(const QStringList &ips, int aresErrorCode, qint64 elapsedMs);
+    void onResolved(const QStringList &ips, int ttl, int aresErrorCode, qint64 elapsedMs);
 
 private:
     QString hostname_;
     QStringList ips_;
+    int ttl_;
     QStringList dnsServers_;
     int timeoutMs_;
     int aresErrorCode_;
@@ -45,8 +48,8 @@ class DnsRequestPrivate : public QObject
     Q_OBJECT
 
 signals:
-    void resolved(const QStringList &ips, int aresErrorCode, qint64 elapsedMs);
+    void resolved(const QStringList &ips, int ttl, int aresErrorCode, qint64 elapsedMs);
 
 private slots:
-    void onResolved(const QStringList &ips, int aresErrorCode, qint64 elapsedMs);
+    void onResolved(const QStringList &ips, int ttl, int aresErrorCode, qint64 elapsedMs);
 };
@@ -1,7 +1,8 @@
 #pragma once
 
-#include <QThreadPool>
+#include <QSharedPointer>
 #include "areslibraryinit.h"
+#include "aresloop.h"
 
 // Singleton for dns requests. Do not use it directly. Use DnsLookup instead
 class DnsResolver : public QObject
@@ -16,7 +17,11 @@ public:
     }
 
     void lookup(const QString &hostname, QSharedPointer<QObject> object, const QStringList &dnsServers, int timeoutMs);
-    QStringList lookupBlocked(const QString &hostname, const QStringList &dnsServers, int timeoutMs, int *outErrorCode);
+    // for the threads without an event loop, the callback is called from the resolver thread
+    void lookup(const QString &hostname, const QStringList &dnsServers, int timeoutMs, AresLoop::ResultCallback callback);
+    QStringList lookupBlocked(const QString &hostname, const QStringList &dnsServers, int timeoutMs, int *outErrorCode, int *outTtl = nullptr);
+    // the object passed to lookup() will not get the result
+    void cancel(QObject *object);
 
 private:
     explicit DnsResolver(QObject *parent = nullptr);
@@ -24,6 +29,6 @@ private:
 
 private:
     AresLibraryInit aresLibraryInit_;
-    QThreadPool *threadPool_;
+    AresLoop *aresLoop_;
 };
 
@@ -0,0 +1,136 @@
+#include <QtTest>
+#include <QUdpSocket>
+
+#include "engine/dnsresolver/dnsrequest.h"
+
+// Local stub DNS server: answers every A query with 10.0.0.1 and a TTL of 300 seconds.
+// Runs in its own thread, so it keeps answering while the test thread is busy issuing lookups.
+class LocalDnsStub : public QThread
+{
+public:
+    quint16 port() const { return port_; }
+
+    void waitReady()
+    {
+        while (port_ == 0)
+            QThread::msleep(1);
+    }
+
+protected:
+    void run() override
+    {
+        QUdpSocket socket;
+        socket.bind(QHostAddress::LocalHost, 0);
+        socket.setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption, 4 * 1024 * 1024);
+        connect(&socket, &QUdpSocket::readyRead, [&socket]() {
+            while (socket.hasPendingDatagrams()) {
+                QHostAddress sender;
+                quint16 senderPort;
+                QByteArray query(socket.pendingDatagramSize(), Qt::Uninitialized);
+                socket.readDatagram(query.data(), query.size(), &sender, &senderPort);
+                const QByteArray answer = makeAnswer(query);
+                if (!answer.isEmpty())
+                    socket.writeDatagram(answer, sender, senderPort);
+            }
+        });
+        port_ = socket.localPort();
+        exec();
+    }
+
+private:
+    std::atomic<quint16> port_ { 0 };
+
+    static QByteArray makeAnswer(const QByteArray &query)
+    {
+        // header (12 bytes) + QNAME + QTYPE + QCLASS
+        const int nameEnd = query.indexOf('\0', 12);
+        if (query.size() < 12 || nameEnd < 0 || query.size() < nameEnd + 5)
+            return QByteArray();
+
+        QByteArray answer;
+        answer += query.left(2);                                    // ID
+        answer += QByteArray::fromHex("81800001000100000000");      // flags, QDCOUNT=1, ANCOUNT=1
+        answer += query.mid(12, nameEnd + 5 - 12);                  // question
+        answer += QByteArray::fromHex("c00c" "0001" "0001" "0000012c" "0004" "0a000001"); // A 10.0.0.1, TTL 300
+        return answer;
+    }
+};
+
+// Resolves many names concurrently and reports the throughput and the number of threads of the process
+class BenchDnsResolver : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void benchmark_concurrent_lookups();
+
+private:
+    LocalDnsStub server_;
+
+    static int threadsCount();
+};
+
+void BenchDnsResolver::initTestCase()
+{
+    server_.start();
+    server_.waitReady();
+}
+
+void BenchDnsResolver::cleanupTestCase()
+{
+    server_.quit();
+    server_.wait();
+}
+
+void BenchDnsResolver::benchmark_concurrent_lookups()
+{
+    const int kLookupsCount = 1000;
+    const QStringList dnsServers = QStringList() << "127.0.0.1:" + QString::number(server_.port());
+
+    int finished = 0;
+    int failed = 0;
+    int maxThreads = threadsCount();
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < kLookupsCount; ++i) {
+        DnsRequest *request = new DnsRequest(this, QString("host%1.example.com").arg(i), dnsServers, 10000);
+        connect(request, &DnsRequest::finished, this, [&, request]() {
+            if (request->isError() || request->ips() != QStringList() << "10.0.0.1" || request->ttl() != 300)
+                failed++;
+            finished++;
+            maxThreads = qMax(maxThreads, threadsCount());
+            request->deleteLater();
+        });
+        request->lookup();
+    }
+    maxThreads = qMax(maxThreads, threadsCount());
+
+    QTRY_COMPARE_WITH_TIMEOUT(finished, kLookupsCount, 60000);
+    const qint64 totalNs = timer.nsecsElapsed();
+    QCOMPARE(failed, 0);
+
+    qDebug() << "lookups:" << kLookupsCount << "all finished, ms:" << totalNs / 1e6
+             << "throughput, lookups/s:" << kLookupsCount / (totalNs / 1e9);
+    qDebug() << "max threads in the process:" << maxThreads;
+}
+
+int BenchDnsResolver::threadsCount()
+{
+#ifdef Q_OS_LINUX
+    QFile file("/proc/self/status");
+    if (file.open(QIODevice::ReadOnly)) {
+        const QList<QByteArray> lines = file.readAll().split('\n');
+        for (const QByteArray &line : lines) {
+            if (line.startsWith("Threads:"))
+                return line.mid(8).trimmed().toInt();
+        }
+    }
+#endif
+    return -1;
+}
+
+QTEST_MAIN(BenchDnsResolver)
+#include "dnsresolver.bench.moc"
@@ -1686,7 +1686,11 @@ void Engine::detectAppropriatePacketSizeImpl()
         qCDebug(LOG_PACKET_SIZE) << "Detecting appropriate packet size";
         runningPacketDetection_ = true;
         Q_EMIT packetSizeDetectionStateChanged(true, false);
-        packetSizeController_->detectAppropriatePacketSize(serverAPI_->getHostname());
+        types::NetworkInterface networkInterface;
+        networkDetectionManager_->getCurrentNetworkInterface(networkInterface);
+        const QString networkKey = networkInterface.networkOrSsid.isEmpty() ? networkInterface.interfaceName : networkInterface.networkOrSsid;
+        packetSizeController_->detectAppropriatePacketSize(serverAPI_->getHostname(), networkKey,
+                                                           connectStateController_->currentState() == CONNECT_STATE_CONNECTED);
     }
     else
     {
@@ -53,15 +53,21 @@ public:
     {
     }
 
-    virtual void getData(bool bIgnoreSslErrors) = 0;
+    // the same failover can be asked by several executers at once, so every request is tagged with an id taken from
+    // newRequestId() and finished() is emitted with the id of the request it answers
+    virtual void getData(quint64 requestId, bool bIgnoreSslErrors) = 0;
     virtual QString name() const = 0;
     QString uniqueId() const { return uniqueId_; }
+    quint64 newRequestId() { return ++lastRequestId_; }
 signals:
-    void finished(const QVector<failover::FailoverData> &data);     // if data is empty then it is implied that failed
+    void finished(quint64 requestId, const QVector<failover::FailoverData> &data);     // if data is empty then it is implied that failed
 
 protected:
      NetworkAccessManager *networkAccessManager_;
      QString uniqueId_;
+
+private:
+     quint64 lastRequestId_ = 0;
 };
 
 
@@ -110,6 +110,17 @@ bool FailoverContainer::gotoNext()
     }
 }
 
+bool FailoverContainer::gotoIndex(int ind)
+{
+    if (ind < 0 || ind >= failovers_.size())
+        return false;
+    if (ind != curFailoverInd_) {
+        curFailoverInd_ = ind;
+        currentFailover_ = failoverById(failovers_[curFailoverInd_]);
+    }
+    return !currentFailover_.isNull();
+}
+
 QSharedPointer<BaseFailover> FailoverContainer::failoverById(const QString &failoverUniqueId)
 {
     if (failoverUniqueId == FAILOVER_DEFAULT_HARDCODED) {
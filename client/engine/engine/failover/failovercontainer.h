@@ -21,6 +21,7 @@ public:
     void reset() override;
     QSharedPointer<BaseFailover> currentFailover(int *outInd = nullptr) override;
     bool gotoNext() override;
+    bool gotoIndex(int ind) override;
     QSharedPointer<BaseFailover> failoverById(const QString &failoverUniqueId) override;
     int count() const override;
 
@@ -14,7 +14,7 @@
 
 namespace failover {
 
-void AccessIpsFailover::getData(bool bIgnoreSslErrors)
+void AccessIpsFailover::getData(quint64 requestId, bool bIgnoreSslErrors)
 {
     QUrl url("https://" + ip_ + "/ApiAccessIps");
     QUrlQuery query;
@@ -25,7 +25,9 @@ void AccessIpsFailover::getData(bool bIgnoreSslErrors)
     NetworkRequest networkRequest(url.toString(), kTimeout, true, DnsServersConfiguration::instance().getCurrentDnsServers(), bIgnoreSslErrors);
     NetworkReply *reply = networkAccessManager_->get(networkRequest);
 
-    connect(reply, &NetworkReply::finished, this, &AccessIpsFailover::onNetworkRequestFinished);
+    connect(reply, &NetworkReply::finished, this, [this, reply, requestId]() {
+        onNetworkRequestFinished(reply, requestId);
+    });
 }
 
 QString AccessIpsFailover::name() const
@@ -34,13 +36,12 @@ QString AccessIpsFailover::name() const
     return "acc: " + ip_.left(3);
 }
 
-void AccessIpsFailover::onNetworkRequestFinished()
+void AccessIpsFailover::onNetworkRequestFinished(NetworkReply *reply, quint64 requestId)
 {
-    NetworkReply *reply = static_cast<NetworkReply *>(sender());
     QSharedPointer<NetworkReply> obj = QSharedPointer<NetworkReply>(reply, &QObject::deleteLater);
 
     if (!reply->isSuccess()) {
-        emit finished(QVector<FailoverData>());
+        emit finished(requestId, QVector<FailoverData>());
     }
     else {
         QStringList hosts = handleRequest(reply->readAll());
@@ -49,7 +50,7 @@ void AccessIpsFailover::onNetworkRequestFinished()
             data << FailoverData(s);
 
         data = Utils::randomizeList<QVector<FailoverData> >(data);
-        emit finished(data);
+        emit finished(requestId, data);
     }
 }
 
@@ -2,6 +2,8 @@
 
 #include "../basefailover.h"
 
+class NetworkReply;
+
 namespace failover {
 
 class AccessIpsFailover : public BaseFailover
@@ -12,15 +14,13 @@ public:
         BaseFailover(parent, uniqueId, networkAccessManager),
         ip_(ip)
     {}
-    void getData(bool bIgnoreSslErrors) override;
+    void getData(quint64 requestId, bool bIgnoreSslErrors) override;
     QString name() const override;
 
-private slots:
-    void onNetworkRequestFinished();
-
 private:
     static constexpr int kTimeout = 5000;          // timeout 5 sec by default
     QString ip_;
+    void onNetworkRequestFinished(NetworkReply *reply, quint64 requestId);
     QStringList handleRequest(const QByteArray &arr);
 };
 
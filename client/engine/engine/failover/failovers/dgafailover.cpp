@@ -24,12 +24,12 @@ DgaFailover::DgaFailover(QObject *parent, const QString &uniqueId) : BaseFailove
     }*/
 }
 
-void DgaFailover::getData(bool)
+void DgaFailover::getData(quint64 requestId, bool)
 {
     if (!domain_.isEmpty())
-        emit finished(QVector<FailoverData>() << FailoverData(domain_));
+        emit finished(requestId, QVector<FailoverData>() << FailoverData(domain_));
     else
-        emit finished(QVector<FailoverData>());
+        emit finished(requestId, QVector<FailoverData>());
 }
 
 } // namespace failover
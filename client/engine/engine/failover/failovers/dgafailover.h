@@ -10,7 +10,7 @@ class DgaFailover : public BaseFailover
     Q_OBJECT
 public:
     explicit DgaFailover(QObject *parent, const QString &uniqueId);
-    void getData(bool /*bIgnoreSslErrors*/) override;
+    void getData(quint64 requestId, bool /*bIgnoreSslErrors*/) override;
 
     QString name() const override
     {
@@ -11,7 +11,7 @@
 
 namespace failover {
 
-void DynamicDomainFailover::getData(bool bIgnoreSslErrors)
+void DynamicDomainFailover::getData(quint64 requestId, bool bIgnoreSslErrors)
 {
     QUrl url(urlString_);
     QUrlQuery query;
@@ -24,13 +24,13 @@ void DynamicDomainFailover::getData(bool bIgnoreSslErrors)
     NetworkReply *reply = networkAccessManager_->get(networkRequest);
     connect(reply, &NetworkReply::finished, [=]() {
         if (!reply->isSuccess()) {
-            emit finished(QVector<FailoverData>());
+            emit finished(requestId, QVector<FailoverData>());
         } else {
             QString hostname = parseHostnameFromJson(reply->readAll());
             if (!hostname.isEmpty())
-                emit finished(QVector<FailoverData>() << FailoverData(hostname));
+                emit finished(requestId, QVector<FailoverData>() << FailoverData(hostname));
             else
-                emit finished(QVector<FailoverData>());
+                emit finished(requestId, QVector<FailoverData>());
         }
         reply->deleteLater();
     });
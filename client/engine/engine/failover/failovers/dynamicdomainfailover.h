@@ -14,7 +14,7 @@ public:
         domainName_(domainName)
     {}
 
-    void getData(bool bIgnoreSslErrors) override;
+    void getData(quint64 requestId, bool bIgnoreSslErrors) override;
     QString name() const override;
 
 private:
@@ -11,7 +11,7 @@
 
 namespace failover {
 
-void EchFailover::getData(bool bIgnoreSslErrors)
+void EchFailover::getData(quint64 requestId, bool bIgnoreSslErrors)
 {
     QUrl url(urlString_);
     QUrlQuery query;
@@ -27,11 +27,11 @@ void EchFailover::getData(bool bIgnoreSslErrors)
     NetworkReply *reply = networkAccessManager_->get(networkRequest);
     connect(reply, &NetworkReply::finished, [=]() {
         if (!reply->isSuccess()) {
-            emit finished(QVector<FailoverData>());
+            emit finished(requestId, QVector<FailoverData>());
         } else {
             QVector<FailoverData> data = parseDataFromJson(reply->readAll());
             data = Utils::randomizeList<QVector<FailoverData> >(data);
-            emit finished(data);
+            emit finished(requestId, data);
         }
         reply->deleteLater();
     });
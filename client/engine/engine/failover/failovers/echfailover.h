@@ -16,7 +16,7 @@ public:
         isFallback_(isFallback)
     {}
 
-    void getData(bool bIgnoreSslErrors) override;
+    void getData(quint64 requestId, bool bIgnoreSslErrors) override;
     QString name() const override;
 
 private:
@@ -10,9 +10,9 @@ class HardcodedDomainFailover : public BaseFailover
 public:
     explicit HardcodedDomainFailover(QObject *parent, const QString &uniqueId, const QString &domain) : BaseFailover(parent, uniqueId), domain_(domain) {}
 
-    void getData(bool /*bIgnoreSslErrors*/) override
+    void getData(quint64 requestId, bool /*bIgnoreSslErrors*/) override
     {
-        emit finished(QVector<FailoverData>() << FailoverData(domain_));
+        emit finished(requestId, QVector<FailoverData>() << FailoverData(domain_));
     }
 
     QString name() const override
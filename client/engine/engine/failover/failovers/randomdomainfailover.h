@@ -14,9 +14,9 @@ public:
     {
         domain_ = HardcodedSettings::instance().generateDomain();
     }
-    void getData(bool /*bIgnoreSslErrors*/) override
+    void getData(quint64 requestId, bool /*bIgnoreSslErrors*/) override
     {
-        emit finished(QVector<FailoverData>() << FailoverData(domain_));
+        emit finished(requestId, QVector<FailoverData>() << FailoverData(domain_));
     }
 
     QString name() const override
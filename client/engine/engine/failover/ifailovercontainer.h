@@ -21,6 +21,8 @@ public:
     virtual QSharedPointer<BaseFailover> currentFailover(int *outInd = nullptr) = 0;
     // switch to the next failover or return false if it was the last one
     virtual bool gotoNext() = 0;
+    // switch to the failover at the position or return false if there is no such one
+    virtual bool gotoIndex(int ind) = 0;
     // return failover by unique identifier or null if not found
     virtual QSharedPointer<BaseFailover> failoverById(const QString &failoverUniqueId) = 0;
     virtual int count() const = 0;
@@ -93,14 +93,14 @@ void TestFailover::basicTest()
     while (true) {
         QSharedPointer<failover::BaseFailover> failover = failoverContainer->currentFailover();
         uniqueIds << failover->uniqueId();
-        QSignalSpy spy(failover.get(), SIGNAL(finished(QVector<failover::FailoverData>)));
-        failover->getData(false);
+        QSignalSpy spy(failover.get(), SIGNAL(finished(quint64,QVector<failover::FailoverData>)));
+        failover->getData(failover->newRequestId(), false);
         while (spy.count() != 1) {
             spy.wait(1000);
         }
 
         QList<QVariant> arguments = spy.takeFirst();
-        qDebug() << failover->name() << arguments.at(0).value<QVector<failover::FailoverData>>();
+        qDebug() << failover->name() << arguments.at(1).value<QVector<failover::FailoverData>>();
         failoversCount++;
         if (!failoverContainer->gotoNext())
             break;
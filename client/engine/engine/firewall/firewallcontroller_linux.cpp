@@ -6,7 +6,8 @@
 #include "engine/helper/ihelper.h"
 
 FirewallController_linux::FirewallController_linux(QObject *parent, IHelper *helper) :
-    FirewallController(parent), forceUpdateInterfaceToSkip_(false), comment_("Windscribe client rule")
+    FirewallController(parent), forceUpdateInterfaceToSkip_(false), comment_("Windscribe client rule"),
+    isIpSetAvailable_(true), isIpSetActual_(false)
 {
     helper_ = dynamic_cast<Helper_linux *>(helper);
 }
@@ -47,6 +48,8 @@ bool FirewallController_linux::firewallOff()
         if (!ret) {
             qCDebug(LOG_FIREWALL_CONTROLLER) << "Clear firewall rules unsuccessful:" << ret;
         }
+        // the helper destroys the ipset with the rules
+        resetIpSetState();
         return true;
     }
     return true;
@@ -95,6 +98,16 @@ bool FirewallController_linux::firewallOnImpl(const QSet<QString> &ips, bool bAl
 
     forceUpdateInterfaceToSkip_ = false;
     bool bExists = firewallActualState();
+    if (!bExists) {
+        // the rules and the set were removed outside of the app (or by a reboot without the helper), apply everything
+        resetIpSetState();
+    }
+
+    // the set must exist before the rules referencing it are restored
+    const bool bUseIpSet = updateIpSet(ips);
+
+    // the changed rule sets are sent to the helper in one batch
+    QVector<QPair<CmdIpVersion, QString>> changedRules;
 
     // rules for IPv4
     {
@@ -140,9 +153,15 @@ bool FirewallController_linux::firewallOnImpl(const QSet<QString> &ips, bool bAl
             rules << "-A windscribe_output -o " + interfaceToSkip_ + " -j ACCEPT -m comment --comment \"" + comment_ + "\"\n";
         }
 
-        for (const auto &i : ips) {
-            rules << "-A windscribe_input -s " + i + "/32 -j ACCEPT -m comment --comment \"" + comment_ + "\"\n";
-            rules << "-A windscribe_output -d " + i + "/32 -j ACCEPT -m comment --comment \"" + comment_ + "\"\n";
+        if (bUseIpSet) {
+            rules << "-A windscribe_input -m set --match-set " FIREWALL_IPSET_NAME " src -j ACCEPT -m comment --comment \"" + comment_ + "\"\n";
+            rules << "-A windscribe_output -m set --match-set " FIREWALL_IPSET_NAME " dst -j ACCEPT -m comment --comment \"" + comment_ + "\"\n";
+        }
+        else {
+            for (const auto &i : ips) {
+                rules << "-A windscribe_input -s " + i + "/32 -j ACCEPT -m comment --comment \"" + comment_ + "\"\n";
+                rules << "-A windscribe_output -d " + i + "/32 -j ACCEPT -m comment --comment \"" + comment_ + "\"\n";
+            }
         }
 
         // Loopback addresses to the local host
@@ -174,9 +193,9 @@ bool FirewallController_linux::firewallOnImpl(const QSet<QString> &ips, bool bAl
         rules << "-A windscribe_output -j DROP -m comment --comment \"" + comment_ + "\"\n";
         rules << "COMMIT\n";
 
-        bool ret = helper_->setFirewallRules(kIpv4, "", "", rules.join("\n"));
-        if (!ret) {
-            qCDebug(LOG_FIREWALL_CONTROLLER) << "Could not set v4 firewall rules:" << ret;
+        const QString rulesText = rules.join("\n");
+        if (rulesText != latestRulesV4_) {
+            changedRules << qMakePair(kIpv4, rulesText);
         }
     }
 
@@ -201,15 +220,75 @@ bool FirewallController_linux::firewallOnImpl(const QSet<QString> &ips, bool bAl
         rules << "-A windscribe_output -j DROP -m comment --comment \"" + comment_ + "\"\n";
         rules << "COMMIT\n";
 
-        bool ret = helper_->setFirewallRules(kIpv6, "", "", rules.join("\n"));
-        if (!ret) {
-            qCDebug(LOG_FIREWALL_CONTROLLER) << "Could not set v6 firewall rules:" << ret;
+        const QString rulesText = rules.join("\n");
+        if (rulesText != latestRulesV6_) {
+            changedRules << qMakePair(kIpv6, rulesText);
+        }
+    }
+
+    if (!changedRules.isEmpty()) {
+        const QVector<bool> results = helper_->setFirewallRules(changedRules);
+        for (int i = 0; i < changedRules.size(); ++i) {
+            const bool isIpv4 = changedRules[i].first == kIpv4;
+            if (!results[i]) {
+                qCDebug(LOG_FIREWALL_CONTROLLER) << "Could not set" << (isIpv4 ? "v4" : "v6") << "firewall rules";
+            }
+            (isIpv4 ? latestRulesV4_ : latestRulesV6_) = results[i] ? changedRules[i].second : QString();
+        }
+    }
+
+    return true;
+}
+
+bool FirewallController_linux::updateIpSet(const QSet<QString> &ips)
+{
+    if (!isIpSetAvailable_) {
+        return false;
+    }
+
+    QStringList addIps;
+    QStringList deleteIps;
+    if (isIpSetActual_) {
+        for (const QString &ip : ips) {
+            if (!ipSetIps_.contains(ip)) {
+                addIps << ip;
+            }
+        }
+        for (const QString &ip : qAsConst(ipSetIps_)) {
+            if (!ips.contains(ip)) {
+                deleteIps << ip;
+            }
         }
+        if (addIps.isEmpty() && deleteIps.isEmpty()) {
+            return true;
+        }
+    }
+    else {
+        addIps = ips.values();
+    }
+
+    if (!helper_->updateFirewallIpSet(addIps, deleteIps, !isIpSetActual_)) {
+        // the rules must not reference the set, whitelist the ips with the rules for each ip from now on
+        qCDebug(LOG_FIREWALL_CONTROLLER) << "ipset is not available, the firewall uses the rules for each ip";
+        isIpSetAvailable_ = false;
+        resetIpSetState();
+        return false;
     }
 
+    qCDebug(LOG_FIREWALL_CONTROLLER) << "firewall ipset updated, added:" << addIps.count() << "deleted:" << deleteIps.count();
+    ipSetIps_ = ips;
+    isIpSetActual_ = true;
     return true;
 }
 
+void FirewallController_linux::resetIpSetState()
+{
+    isIpSetActual_ = false;
+    ipSetIps_.clear();
+    latestRulesV4_.clear();
+    latestRulesV6_.clear();
+}
+
 // Extract rules from iptables with comment.If modifyForDelete == true, then replace commands for delete.
 QStringList FirewallController_linux::getWindscribeRules(const QString &comment, bool modifyForDelete, bool isIPv6)
 {
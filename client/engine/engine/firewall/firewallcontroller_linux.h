@@ -30,7 +30,18 @@ private:
     QString pathToTempTable_;
     QString comment_;
 
+    // The whitelisted IPv4 addresses are kept in an ipset (a kernel hash set) referenced by two rules, so the rules
+    // don't depend on the ips and a change of the ips is applied by adding/deleting the set members.
+    // If ipset is not available, each ip gets its own pair of rules.
+    bool isIpSetAvailable_;
+    bool isIpSetActual_;        // ipSetIps_ are the current members of the set
+    QSet<QString> ipSetIps_;
+    QString latestRulesV4_;     // the latest applied rules, they are not restored again if not changed
+    QString latestRulesV6_;
+
     bool firewallOnImpl(const QSet<QString> &ips, bool bAllowLanTraffic, bool bIsCustomConfig, const apiinfo::StaticIpPortsVector &ports);
+    bool updateIpSet(const QSet<QString> &ips);
+    void resetIpSetState();
     QStringList getWindscribeRules(const QString &comment, bool modifyForDelete, bool isIPv6);
     void removeWindscribeRules(const QString &comment, bool isIPv6);
     QStringList getLocalAddresses(const QString iface) const;
@@ -0,0 +1,229 @@
+#include <QtTest>
+
+#include <QProcess>
+#include <QStandardPaths>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <functional>
+#include <thread>
+
+// Compares the two ways FirewallController_linux whitelists the ips: a pair of iptables rules for each ip and an ipset
+// referenced by two rules. Both are applied in a separate network namespace, so the host firewall is not touched.
+// Reports the time of the full apply of kIpsCount ips, the time of an update of kChangedIpsCount ips, and the time
+// of sending a packet to the last whitelisted ip (the worst case for the linear chain). Requires root, iptables and ipset.
+class BenchFirewall : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void benchmark_ipRules();
+    void benchmark_ipSet();
+
+private:
+    static constexpr int kIpsCount = 10000;
+    static constexpr int kChangedIpsCount = 100;
+    static constexpr int kPacketsCount = 20000;
+    static constexpr const char *kNetns = "ws_firewall_bench";
+    static constexpr const char *kSetName = "windscribe_ips";
+
+    static QString whitelistedIp(int ind);
+    static QString rules(const QStringList &whitelistRules);
+    static bool run(const QString &program, const QStringList &args, const QByteArray &input = QByteArray());
+    static bool runInNetns(const QString &program, const QStringList &args, const QByteArray &input = QByteArray());
+    static qint64 timeMs(const std::function<bool()> &f);
+    static qint64 sendPacketsNs(const QString &ip);
+    static void resetNetns();
+};
+
+QString BenchFirewall::whitelistedIp(int ind)
+{
+    return QString("100.64.%1.%2").arg(ind / 250).arg(ind % 250 + 1);
+}
+
+QString BenchFirewall::rules(const QStringList &whitelistRules)
+{
+    QStringList rules;
+    rules << "*filter";
+    rules << ":windscribe_input - [0:0]";
+    rules << ":windscribe_output - [0:0]";
+    rules << "-A INPUT -j windscribe_input";
+    rules << "-A OUTPUT -j windscribe_output";
+    rules << "-A windscribe_input -i lo -j ACCEPT";
+    rules << "-A windscribe_output -o lo -j ACCEPT";
+    rules << whitelistRules;
+    rules << "-A windscribe_input -j DROP";
+    rules << "-A windscribe_output -j DROP";
+    rules << "COMMIT";
+    return rules.join("\n") + "\n";
+}
+
+bool BenchFirewall::run(const QString &program, const QStringList &args, const QByteArray &input)
+{
+    QProcess process;
+    process.start(program, args);
+    if (!process.waitForStarted())
+        return false;
+    process.write(input);
+    process.closeWriteChannel();
+    process.waitForFinished(-1);
+    if (process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0) {
+        qDebug() << program << args << "failed:" << process.readAllStandardError();
+        return false;
+    }
+    return true;
+}
+
+bool BenchFirewall::runInNetns(const QString &program, const QStringList &args, const QByteArray &input)
+{
+    return run("ip", QStringList() << "netns" << "exec" << kNetns << program << args, input);
+}
+
+qint64 BenchFirewall::timeMs(const std::function<bool()> &f)
+{
+    QElapsedTimer timer;
+    timer.start();
+    if (!f())
+        return -1;
+    return timer.elapsed();
+}
+
+// the time per packet, -1 on error
+qint64 BenchFirewall::sendPacketsNs(const QString &ip)
+{
+    qint64 result = -1;
+    // setns() switches the namespace of the calling thread only
+    std::thread thread([&]() {
+        const int netnsFd = open((QString("/var/run/netns/") + kNetns).toStdString().c_str(), O_RDONLY);
+        if (netnsFd < 0 || setns(netnsFd, CLONE_NEWNET) != 0) {
+            if (netnsFd >= 0)
+                close(netnsFd);
+            return;
+        }
+        close(netnsFd);
+
+        const int sock = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sock < 0)
+            return;
+        struct sockaddr_in to;
+        memset(&to, 0, sizeof(to));
+        to.sin_family = AF_INET;
+        to.sin_port = htons(9);
+        inet_pton(AF_INET, ip.toStdString().c_str(), &to.sin_addr);
+
+        // the packets pass the OUTPUT chain in sendto() and are dropped by the dummy interface
+        const char payload[64] = { 0 };
+        int sent = 0;
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < kPacketsCount; ++i) {
+            if (sendto(sock, payload, sizeof(payload), 0, (struct sockaddr *)&to, sizeof(to)) == sizeof(payload))
+                sent++;
+        }
+        const qint64 elapsedNs = timer.nsecsElapsed();
+        close(sock);
+        if (sent == kPacketsCount)
+            result = elapsedNs / kPacketsCount;
+    });
+    thread.join();
+    return result;
+}
+
+void BenchFirewall::resetNetns()
+{
+    run("ip", QStringList() << "netns" << "del" << kNetns);
+    QVERIFY(run("ip", QStringList() << "netns" << "add" << kNetns));
+    QVERIFY(runInNetns("ip", QStringList() << "link" << "set" << "lo" << "up"));
+    QVERIFY(runInNetns("ip", QStringList() << "link" << "add" << "ws_dummy" << "type" << "dummy"));
+    QVERIFY(runInNetns("ip", QStringList() << "link" << "set" << "ws_dummy" << "up"));
+    QVERIFY(runInNetns("ip", QStringList() << "addr" << "add" << "198.18.0.1/24" << "dev" << "ws_dummy"));
+    QVERIFY(runInNetns("ip", QStringList() << "route" << "add" << "100.64.0.0/10" << "dev" << "ws_dummy"));
+}
+
+void BenchFirewall::initTestCase()
+{
+    if (geteuid() != 0)
+        QSKIP("the benchmark must be run as root");
+    for (const char *program : { "ip", "iptables-restore", "ipset" }) {
+        if (QStandardPaths::findExecutable(program).isEmpty())
+            QSKIP(qPrintable(QString("%1 is not found").arg(program)));
+    }
+}
+
+void BenchFirewall::cleanupTestCase()
+{
+    run("ip", QStringList() << "netns" << "del" << kNetns);
+}
+
+void BenchFirewall::benchmark_ipRules()
+{
+    resetNetns();
+    if (QTest::currentTestFailed())
+        return;
+
+    auto ipRules = [](int firstIp) {
+        QStringList whitelistRules;
+        for (int i = firstIp; i < firstIp + kIpsCount; ++i) {
+            whitelistRules << "-A windscribe_input -s " + whitelistedIp(i) + "/32 -j ACCEPT";
+            whitelistRules << "-A windscribe_output -d " + whitelistedIp(i) + "/32 -j ACCEPT";
+        }
+        return rules(whitelistRules).toUtf8();
+    };
+
+    const qint64 applyMs = timeMs([&]() { return runInNetns("iptables-restore", QStringList() << "-n", ipRules(0)); });
+    QVERIFY(applyMs >= 0);
+    // every change restores the whole ruleset (the chains are flushed by the restore)
+    const QByteArray changedRules = ipRules(kChangedIpsCount).replace("-A INPUT -j windscribe_input\n", "").replace("-A OUTPUT -j windscribe_output\n", "");
+    const qint64 updateMs = timeMs([&]() { return runInNetns("iptables-restore", QStringList() << "-n", changedRules); });
+    QVERIFY(updateMs >= 0);
+    const qint64 packetNs = sendPacketsNs(whitelistedIp(kChangedIpsCount + kIpsCount - 1));
+    QVERIFY(packetNs >= 0);
+
+    qDebug() << "rules for each ip, ips:" << kIpsCount << "apply, ms:" << applyMs << "update of" << kChangedIpsCount << "ips, ms:" << updateMs
+             << "send to the last ip, ns per packet:" << packetNs;
+}
+
+void BenchFirewall::benchmark_ipSet()
+{
+    resetNetns();
+    if (QTest::currentTestFailed())
+        return;
+
+    QByteArray setScript = QString("create %1 hash:ip family inet hashsize 1024 maxelem 1048576\n").arg(kSetName).toUtf8();
+    for (int i = 0; i < kIpsCount; ++i)
+        setScript += QString("add %1 %2\n").arg(kSetName, whitelistedIp(i)).toUtf8();
+    QStringList whitelistRules;
+    whitelistRules << QString("-A windscribe_input -m set --match-set %1 src -j ACCEPT").arg(kSetName);
+    whitelistRules << QString("-A windscribe_output -m set --match-set %1 dst -j ACCEPT").arg(kSetName);
+
+    const qint64 applyMs = timeMs([&]() {
+        return runInNetns("ipset", QStringList() << "-exist" << "restore", setScript) &&
+               runInNetns("iptables-restore", QStringList() << "-n", rules(whitelistRules).toUtf8());
+    });
+    QVERIFY(applyMs >= 0);
+
+    // the rules are not changed, only the set members
+    QByteArray updateScript;
+    for (int i = 0; i < kChangedIpsCount; ++i) {
+        updateScript += QString("del %1 %2\n").arg(kSetName, whitelistedIp(i)).toUtf8();
+        updateScript += QString("add %1 %2\n").arg(kSetName, whitelistedIp(kIpsCount + i)).toUtf8();
+    }
+    const qint64 updateMs = timeMs([&]() { return runInNetns("ipset", QStringList() << "-exist" << "restore", updateScript); });
+    QVERIFY(updateMs >= 0);
+    const qint64 packetNs = sendPacketsNs(whitelistedIp(kChangedIpsCount + kIpsCount - 1));
+    QVERIFY(packetNs >= 0);
+
+    qDebug() << "ipset, ips:" << kIpsCount << "apply, ms:" << applyMs << "update of" << kChangedIpsCount << "ips, ms:" << updateMs
+             << "send to the last ip, ns per packet:" << packetNs;
+}
+
+QTEST_MAIN(BenchFirewall)
+#include "firewall.bench.moc"
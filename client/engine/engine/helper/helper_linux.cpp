@@ -2,7 +2,6 @@
 
 #include <stdlib.h>
 
-#include "../../../../backend/posix_common/helper_commands_serialize.h"
 #include "utils/logger.h"
 
 Helper_linux::Helper_linux(QObject *parent) : Helper_posix(parent)
@@ -64,11 +63,7 @@ bool Helper_linux::setDnsLeakProtectEnabled(bool bEnabled)
     CMD_SET_DNS_LEAK_PROTECT_ENABLED cmd;
     cmd.enabled = bEnabled;
 
-    std::stringstream stream;
-    boost::archive::text_oarchive oa(stream, boost::archive::no_header);
-    oa << cmd;
-
-    return runCommand(HELPER_CMD_SET_DNS_LEAK_PROTECT_ENABLED, stream.str(), answer);
+    return runCommand(HELPER_CMD_SET_DNS_LEAK_PROTECT_ENABLED, cmd, answer);
 }
 
 bool Helper_linux::checkForWireGuardKernelModule()
@@ -76,5 +71,22 @@ bool Helper_linux::checkForWireGuardKernelModule()
     QMutexLocker locker(&mutex_);
 
     CMD_ANSWER answer;
-    return runCommand(HELPER_CMD_CHECK_FOR_WIREGUARD_KERNEL_MODULE, {}, answer) && answer.executed == 1;
+    return runCommand(HELPER_CMD_CHECK_FOR_WIREGUARD_KERNEL_MODULE, answer) && answer.executed == 1;
+}
+
+bool Helper_linux::updateFirewallIpSet(const QStringList &addIps, const QStringList &deleteIps, bool isReplace)
+{
+    QMutexLocker locker(&mutex_);
+
+    CMD_ANSWER answer;
+    CMD_UPDATE_FIREWALL_IPSET cmd;
+    cmd.isReplace = isReplace;
+    for (const QString &ip : addIps) {
+        cmd.addIps.push_back(ip.toStdString());
+    }
+    for (const QString &ip : deleteIps) {
+        cmd.deleteIps.push_back(ip.toStdString());
+    }
+
+    return runCommand(HELPER_CMD_UPDATE_FIREWALL_IPSET, cmd, answer) && answer.executed == 1;
 }
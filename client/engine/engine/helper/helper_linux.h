@@ -19,6 +19,8 @@ public:
     std::optional<bool> installUpdate(const QString& package) const;
     bool setDnsLeakProtectEnabled(bool bEnabled);
     bool checkForWireGuardKernelModule();
+    // incremental update of the FIREWALL_IPSET_NAME set, returns false if ipset is not available
+    bool updateFirewallIpSet(const QStringList &addIps, const QStringList &deleteIps, bool isReplace);
 };
 
 #endif // HELPER_LINUX_H
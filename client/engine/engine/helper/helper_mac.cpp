@@ -5,7 +5,6 @@
 #include "utils/macutils.h"
 #include <QCoreApplication>
 #include "installhelper_mac.h"
-#include "../../../../backend/posix_common/helper_commands_serialize.h"
 
 Helper_mac::Helper_mac(QObject *parent) : Helper_posix(parent)
 {
@@ -59,11 +58,7 @@ bool Helper_mac::setMacAddress(const QString &interface, const QString &macAddre
     cmd.macAddress = macAddress.toStdString();
     cmd.robustMethod = robustMethod;
 
-    std::stringstream stream;
-    boost::archive::text_oarchive oa(stream, boost::archive::no_header);
-    oa << cmd;
-
-    return runCommand(HELPER_CMD_SET_MAC_ADDRESS, stream.str(), answer);
+    return runCommand(HELPER_CMD_SET_MAC_ADDRESS, cmd, answer);
 
 }
 
@@ -78,11 +73,7 @@ bool Helper_mac::enableMacSpoofingOnBoot(bool bEnabled, const QString &interface
     cmd.macAddress = macAddress.toStdString();
     cmd.robustMethod = robustMethod;
 
-    std::stringstream stream;
-    boost::archive::text_oarchive oa(stream, boost::archive::no_header);
-    oa << cmd;
-
-    return runCommand(HELPER_CMD_SET_MAC_SPOOFING_ON_BOOT, stream.str(), answer);
+    return runCommand(HELPER_CMD_SET_MAC_SPOOFING_ON_BOOT, cmd, answer);
 }
 
 bool Helper_mac::setKeychainUsernamePassword(const QString &username, const QString &password)
@@ -136,17 +127,8 @@ bool Helper_mac::setDnsOfDynamicStoreEntry(const QString &ipAddress, const QStri
     if (curState_ != STATE_CONNECTED)
         return false;
 
-    std::stringstream stream;
-    boost::archive::text_oarchive oa(stream, boost::archive::no_header);
-    oa << cmd;
-
-    if (!sendCmdToHelper(HELPER_CMD_APPLY_CUSTOM_DNS, stream.str()))
-    {
-        return false;
-    }
-
     CMD_ANSWER answerCmd;
-    if (!readAnswer(answerCmd))
+    if (!runCommand(HELPER_CMD_APPLY_CUSTOM_DNS, cmd, answerCmd))
     {
         return false;
     }
@@ -161,26 +143,15 @@ bool Helper_mac::setKeychainUsernamePasswordImpl(const QString &username, const
     cmd.username = username.toStdString();
     cmd.password = password.toStdString();
 
-    std::stringstream stream;
-    boost::archive::text_oarchive oa(stream, boost::archive::no_header);
-    oa << cmd;
-
-    if (!sendCmdToHelper(HELPER_CMD_SET_KEYCHAIN_ITEM, stream.str()))
+    CMD_ANSWER answerCmd;
+    if (!runCommand(HELPER_CMD_SET_KEYCHAIN_ITEM, cmd, answerCmd))
     {
         return RET_DISCONNECTED;
     }
     else
     {
-        CMD_ANSWER answerCmd;
-        if (!readAnswer(answerCmd))
-        {
-            return RET_DISCONNECTED;
-        }
-        else
-        {
-            *bExecuted = (answerCmd.executed == 1);
-            return RET_SUCCESS;
-        }
+        *bExecuted = (answerCmd.executed == 1);
+        return RET_SUCCESS;
     }
 }
 
@@ -192,9 +163,5 @@ bool Helper_mac::setIpv6Enabled(bool bEnabled)
     CMD_SET_IPV6_ENABLED cmd;
     cmd.enabled = bEnabled;
 
-    std::stringstream stream;
-    boost::archive::text_oarchive oa(stream, boost::archive::no_header);
-    oa << cmd;
-
-    return runCommand(HELPER_CMD_SET_IPV6_ENABLED, stream.str(), answer);
+    return runCommand(HELPER_CMD_SET_IPV6_ENABLED, cmd, answer);
 }
@@ -17,7 +17,6 @@
 #include "utils/ws_assert.h"
 #include "utils/macutils.h"
 #include "utils/executable_signature/executable_signature.h"
-#include "../../../../backend/posix_common/helper_commands_serialize.h"
 
 #ifdef Q_OS_LINUX
     #include "utils/dnsscripts_linux.h"
@@ -42,6 +41,7 @@ Helper_posix::~Helper_posix()
     io_service_.stop();
     setNeedFinish();
     wait();
+    failPendingAnswers();
     g_this_ = NULL;
 }
 
@@ -57,6 +57,20 @@ void Helper_posix::setNeedFinish()
 
 void Helper_posix::getUnblockingCmdStatus(unsigned long cmdId, QString &outLog, bool &outFinished)
 {
+    // the output pushed by the helper, no round trip is needed
+    {
+        QMutexLocker locker(&mutexCmdOutputs_);
+        auto it = cmdOutputs_.find(cmdId);
+        if (it != cmdOutputs_.end()) {
+            outFinished = it->isFinished;
+            outLog = it->log;
+            if (it->isFinished) {
+                cmdOutputs_.erase(it);
+            }
+            return;
+        }
+    }
+
     QMutexLocker locker(&mutex_);
 
     outFinished = false;
@@ -68,12 +82,8 @@ void Helper_posix::getUnblockingCmdStatus(unsigned long cmdId, QString &outLog,
     CMD_GET_CMD_STATUS cmd;
     cmd.cmdId = cmdId;
 
-    std::stringstream stream;
-    boost::archive::text_oarchive oa(stream, boost::archive::no_header);
-    oa << cmd;
-
     CMD_ANSWER answer;
-    if (!runCommand(HELPER_CMD_GET_CMD_STATUS, stream.str(), answer) || answer.executed == 0) {
+    if (!runCommand(HELPER_CMD_GET_CMD_STATUS, cmd, answer) || answer.executed == 0) {
         doDisconnectAndReconnect();
         return;
     }
@@ -86,6 +96,12 @@ void Helper_posix::clearUnblockingCmd(unsigned long cmdId)
 {
     Q_UNUSED(cmdId);
 
+    // the helper clears all the commands as well
+    {
+        QMutexLocker locker(&mutexCmdOutputs_);
+        cmdOutputs_.clear();
+    }
+
     QMutexLocker locker(&mutex_);
 
     if (curState_ != STATE_CONNECTED) {
@@ -94,12 +110,8 @@ void Helper_posix::clearUnblockingCmd(unsigned long cmdId)
 
     CMD_CLEAR_CMDS cmd;
 
-    std::stringstream stream;
-    boost::archive::text_oarchive oa(stream, boost::archive::no_header);
-    oa << cmd;
-
     CMD_ANSWER answer;
-    if (!runCommand(HELPER_CMD_CLEAR_CMDS, stream.str(), answer)) {
+    if (!runCommand(HELPER_CMD_CLEAR_CMDS, cmd, answer)) {
         doDisconnectAndReconnect();
     }
 }
@@ -137,12 +149,8 @@ bool Helper_posix::setSplitTunnelingSettings(bool isActive, bool isExclude,
         cmdSplitTunnelingSettings.hosts.push_back(hosts[i].toStdString());
     }
 
-    std::stringstream stream;
-    boost::archive::text_oarchive oa(stream, boost::archive::no_header);
-    oa << cmdSplitTunnelingSettings;
-
     CMD_ANSWER answer;
-    if (!runCommand(HELPER_CMD_SPLIT_TUNNELING_SETTINGS, stream.str(), answer)) {
+    if (!runCommand(HELPER_CMD_SPLIT_TUNNELING_SETTINGS, cmdSplitTunnelingSettings, answer)) {
         doDisconnectAndReconnect();
         return false;
     }
@@ -198,12 +206,8 @@ bool Helper_posix::sendConnectStatus(bool isConnected, bool isTerminateSocket, b
         cmd.remoteIp = vpnAdapter.remoteIp().toStdString();
     }
 
-    std::stringstream stream;
-    boost::archive::text_oarchive oa(stream, boost::archive::no_header);
-    oa << cmd;
-
     CMD_ANSWER answer;
-    if (!runCommand(HELPER_CMD_SEND_CONNECT_STATUS, stream.str(), answer)) {
+    if (!runCommand(HELPER_CMD_SEND_CONNECT_STATUS, cmd, answer)) {
         doDisconnectAndReconnect();
         return false;
     }
@@ -220,11 +224,7 @@ bool Helper_posix::changeMtu(const QString &adapter, int mtu)
     cmd.mtu = mtu;
     cmd.adapterName = adapter.toStdString();
 
-    std::stringstream stream;
-    boost::archive::text_oarchive oa(stream, boost::archive::no_header);
-    oa << cmd;
-
-    return runCommand(HELPER_CMD_CHANGE_MTU, stream.str(), answer);
+    return runCommand(HELPER_CMD_CHANGE_MTU, cmd, answer);
 }
 
 bool Helper_posix::deleteRoute(const QString &range, int mask, const QString &gateway)
@@ -237,11 +237,7 @@ bool Helper_posix::deleteRoute(const QString &range, int mask, const QString &ga
     cmd.mask = mask;
     cmd.gateway = gateway.toStdString();
 
-    std::stringstream stream;
-    boost::archive::text_oarchive oa(stream, boost::archive::no_header);
-    oa << cmd;
-
-    return runCommand(HELPER_CMD_DELETE_ROUTE, stream.str(), answer);
+    return runCommand(HELPER_CMD_DELETE_ROUTE, cmd, answer);
 }
 
 IHelper::ExecuteError Helper_posix::startWireGuard(const QString &exeName, const QString &deviceName)
@@ -267,12 +263,8 @@ IHelper::ExecuteError Helper_posix::startWireGuard(const QString &exeName, const
     cmd.executable = exeName.toStdString();
     cmd.deviceName = deviceName.toStdString();
 
-    std::stringstream stream;
-    boost::archive::text_oarchive oa(stream, boost::archive::no_header);
-    oa << cmd;
-
     CMD_ANSWER answer;
-    if (!runCommand(HELPER_CMD_START_WIREGUARD, stream.str(), answer) || answer.executed == 0) {
+    if (!runCommand(HELPER_CMD_START_WIREGUARD, cmd, answer) || answer.executed == 0) {
         doDisconnectAndReconnect();
         return IHelper::EXECUTE_ERROR;
     }
@@ -290,7 +282,7 @@ bool Helper_posix::stopWireGuard()
         QMutexLocker locker(&mutex_);
 
         CMD_ANSWER answer;
-        if (!runCommand(HELPER_CMD_STOP_WIREGUARD, "", answer)) {
+        if (!runCommand(HELPER_CMD_STOP_WIREGUARD, answer)) {
             doDisconnectAndReconnect();
             return false;
         }
@@ -334,12 +326,8 @@ bool Helper_posix::configureWireGuard(const WireGuardConfig &config)
         = QByteArray::fromBase64(config.peerPresharedKey().toLatin1()).toHex().data();
     cmd.allowedIps = config.peerAllowedIps().toLatin1().data();
 
-    std::stringstream stream;
-    boost::archive::text_oarchive oa(stream, boost::archive::no_header);
-    oa << cmd;
-
     CMD_ANSWER answer;
-    if (!runCommand(HELPER_CMD_CONFIGURE_WIREGUARD, stream.str(), answer) || answer.executed == 0) {
+    if (!runCommand(HELPER_CMD_CONFIGURE_WIREGUARD, cmd, answer) || answer.executed == 0) {
         qCDebug(LOG_WIREGUARD) << "WireGuard configuration failed";
         doDisconnectAndReconnect();
         return false;
@@ -361,7 +349,7 @@ bool Helper_posix::getWireGuardStatus(types::WireGuardStatus *status)
     }
 
     CMD_ANSWER answer;
-    if (!runCommand(HELPER_CMD_GET_WIREGUARD_STATUS, "", answer)) {
+    if (!runCommand(HELPER_CMD_GET_WIREGUARD_STATUS, answer)) {
         doDisconnectAndReconnect();
         return false;
     }
@@ -424,12 +412,8 @@ IHelper::ExecuteError Helper_posix::startCtrld(const QString &exeName, const QSt
     cmd.executable = exeName.toStdString();
     cmd.parameters = parameters.toStdString();
 
-    std::stringstream stream;
-    boost::archive::text_oarchive oa(stream, boost::archive::no_header);
-    oa << cmd;
-
     CMD_ANSWER answer;
-    if (!runCommand(HELPER_CMD_START_CTRLD, stream.str(), answer) || answer.executed == 0) {
+    if (!runCommand(HELPER_CMD_START_CTRLD, cmd, answer) || answer.executed == 0) {
         doDisconnectAndReconnect();
         return IHelper::EXECUTE_ERROR;
     }
@@ -479,18 +463,19 @@ IHelper::ExecuteError Helper_posix::executeOpenVPN(const QString &config, const
     }
 #endif
 
-    std::stringstream stream;
-    boost::archive::text_oarchive oa(stream, boost::archive::no_header);
-    oa << cmd;
-
     qDebug() << QString::fromStdString(Utils::cleanSensitiveInfo(cmd.exePath + "/" + cmd.executable + " " + cmd.arguments));
 
     CMD_ANSWER answer;
-    if (!runCommand(HELPER_CMD_START_OPENVPN, stream.str(), answer) || answer.executed == 0) {
+    if (!runCommand(HELPER_CMD_START_OPENVPN, cmd, answer) || answer.executed == 0) {
         doDisconnectAndReconnect();
         return IHelper::EXECUTE_ERROR;
     }
 
+    if (answer.customInfoValue[0] == 1) {
+        // the output is pushed by the helper, it may have come already
+        QMutexLocker locker(&mutexCmdOutputs_);
+        cmdOutputs_[answer.cmdId];
+    }
     outCmdId = answer.cmdId;
     return IHelper::EXECUTE_SUCCESS;
 }
@@ -503,11 +488,7 @@ bool Helper_posix::executeTaskKill(CmdKillTarget target)
     CMD_ANSWER answer;
     cmd.target = target;
 
-    std::stringstream stream;
-    boost::archive::text_oarchive oa(stream, boost::archive::no_header);
-    oa << cmd;
-
-    return runCommand(HELPER_CMD_TASK_KILL, stream.str(), answer);
+    return runCommand(HELPER_CMD_TASK_KILL, cmd, answer);
 }
 
 bool Helper_posix::setDnsScriptEnabled(bool bEnabled)
@@ -518,11 +499,7 @@ bool Helper_posix::setDnsScriptEnabled(bool bEnabled)
     CMD_ANSWER answer;
     cmd.enabled = bEnabled;
 
-    std::stringstream stream;
-    boost::archive::text_oarchive oa(stream, boost::archive::no_header);
-    oa << cmd;
-
-    return runCommand(HELPER_CMD_SET_DNS_SCRIPT_ENABLED, stream.str(), answer);
+    return runCommand(HELPER_CMD_SET_DNS_SCRIPT_ENABLED, cmd, answer);
 }
 
 bool Helper_posix::checkFirewallState(const QString &tag)
@@ -533,11 +510,7 @@ bool Helper_posix::checkFirewallState(const QString &tag)
     CMD_ANSWER answer;
     cmd.tag = tag.toStdString();
 
-    std::stringstream stream;
-    boost::archive::text_oarchive oa(stream, boost::archive::no_header);
-    oa << cmd;
-
-    if (!runCommand(HELPER_CMD_CHECK_FIREWALL_STATE, stream.str(), answer)) {
+    if (!runCommand(HELPER_CMD_CHECK_FIREWALL_STATE, cmd, answer)) {
         return false;
     }
     return answer.exitCode != 0;
@@ -551,11 +524,7 @@ bool Helper_posix::clearFirewallRules(bool isKeepPfEnabled)
     CMD_ANSWER answer;
     cmd.isKeekPfEnabled = isKeepPfEnabled;
 
-    std::stringstream stream;
-    boost::archive::text_oarchive oa(stream, boost::archive::no_header);
-    oa << cmd;
-
-    return runCommand(HELPER_CMD_CLEAR_FIREWALL_RULES, stream.str(), answer);
+    return runCommand(HELPER_CMD_CLEAR_FIREWALL_RULES, cmd, answer);
 }
 
 bool Helper_posix::setFirewallRules(CmdIpVersion version, const QString &table, const QString &group, const QString &rules)
@@ -569,11 +538,7 @@ bool Helper_posix::setFirewallRules(CmdIpVersion version, const QString &table,
     cmd.group = group.toStdString();
     cmd.rules = rules.toStdString();
 
-    std::stringstream stream;
-    boost::archive::text_oarchive oa(stream, boost::archive::no_header);
-    oa << cmd;
-
-    return runCommand(HELPER_CMD_SET_FIREWALL_RULES, stream.str(), answer);
+    return runCommand(HELPER_CMD_SET_FIREWALL_RULES, cmd, answer);
 }
 
 bool Helper_posix::getFirewallRules(CmdIpVersion version, const QString &table, const QString &group, QString &rules)
@@ -586,11 +551,7 @@ bool Helper_posix::getFirewallRules(CmdIpVersion version, const QString &table,
     cmd.table = table.toStdString();
     cmd.group = group.toStdString();
 
-    std::stringstream stream;
-    boost::archive::text_oarchive oa(stream, boost::archive::no_header);
-    oa << cmd;
-
-    if (!runCommand(HELPER_CMD_GET_FIREWALL_RULES, stream.str(), answer)) {
+    if (!runCommand(HELPER_CMD_GET_FIREWALL_RULES, cmd, answer)) {
         return false;
     }
     rules = QString::fromStdString(answer.body);
@@ -605,11 +566,45 @@ bool Helper_posix::setFirewallOnBoot(bool bEnabled)
     CMD_ANSWER answer;
     cmd.enabled = bEnabled;
 
-    std::stringstream stream;
-    boost::archive::text_oarchive oa(stream, boost::archive::no_header);
-    oa << cmd;
+    return runCommand(HELPER_CMD_SET_FIREWALL_ON_BOOT, cmd, answer);
+}
+
+QVector<bool> Helper_posix::setFirewallRules(const QVector<QPair<CmdIpVersion, QString>> &rules)
+{
+    QMutexLocker locker(&mutex_);
+
+    CMD_BATCH batch;
+    batch.isStopOnError = false;
+    for (const auto &it : rules) {
+        CMD_SET_FIREWALL_RULES cmd;
+        cmd.ipVersion = it.first;
+        cmd.rules = it.second.toStdString();
+        addToBatch(batch, HELPER_CMD_SET_FIREWALL_RULES, cmd);
+    }
+
+    QVector<bool> result(rules.size(), false);
+    std::vector<CMD_ANSWER> answers;
+    if (runBatch(batch, answers)) {
+        for (int i = 0; i < result.size() && i < (int)answers.size(); ++i) {
+            result[i] = answers[i].executed != 0;
+        }
+    }
+    return result;
+}
 
-    return runCommand(HELPER_CMD_SET_FIREWALL_ON_BOOT, stream.str(), answer);
+void Helper_posix::setSocketPath(const QString &path)
+{
+    ep_ = boost::asio::local::stream_protocol::endpoint(path.toStdString());
+}
+
+bool Helper_posix::runBatch(const CMD_BATCH &batch, std::vector<CMD_ANSWER> &outAnswers)
+{
+    outAnswers.clear();
+    CMD_ANSWER answer;
+    if (!runCommand(HELPER_CMD_BATCH, batch, answer)) {
+        return false;
+    }
+    return helperBinaryDecode(answer.body.data(), answer.body.size(), outAnswers);
 }
 
 void Helper_posix::run()
@@ -627,7 +622,7 @@ void Helper_posix::connectHandler(const boost::system::error_code &ec)
 {
     if (!ec) {
         // we connected
-        g_this_->curState_ = STATE_CONNECTED;
+        g_this_->onConnected();
         //emit signal only once on first run
         if (!g_this_->bHelperConnectedEmitted_) {
             g_this_->bHelperConnectedEmitted_ = true;
@@ -669,68 +664,200 @@ void Helper_posix::doDisconnectAndReconnect()
     }
 }
 
-bool Helper_posix::runCommand(int cmdId, const std::string &data, CMD_ANSWER &answer)
+std::future<std::optional<CMD_ANSWER>> Helper_posix::sendCommand(int cmdId, const std::string &data)
 {
-    bool ret = sendCmdToHelper(cmdId, data);
-    if (!ret) {
-        return ret;
+    std::promise<std::optional<CMD_ANSWER>> promise;
+    std::future<std::optional<CMD_ANSWER>> future = promise.get_future();
+
+    HELPER_V2_REQUEST_HEADER header;
+    header.magic = HELPER_V2_MAGIC;
+    header.cmdId = cmdId;
+    header.length = (quint32)data.size();
+    quint32 connectionId;
+    {
+        QMutexLocker locker(&mutexPendingAnswers_);
+        if (curState_ != STATE_CONNECTED) {
+            locker.unlock();
+            promise.set_value(std::nullopt);
+            return future;
+        }
+        header.requestId = ++lastRequestId_;
+        connectionId = connectionId_;
+        pendingAnswers_.emplace(header.requestId, std::move(promise));
     }
 
-    return readAnswer(answer);
+    std::string frame;
+    frame.reserve(sizeof(header) + data.size());
+    frame.append((const char *)&header, sizeof(header));
+    frame.append(data);
+    // the socket is used in the thread of io_service_ only
+    boost::asio::post(io_service_, [this, connectionId, frame = std::move(frame)]() mutable {
+        writeFrame(connectionId, std::move(frame));
+    });
+    return future;
 }
 
-bool Helper_posix::readAnswer(CMD_ANSWER &outAnswer)
+bool Helper_posix::waitAnswer(std::future<std::optional<CMD_ANSWER>> future, CMD_ANSWER &answer)
 {
-    boost::system::error_code ec;
-    int length;
-    boost::asio::read(*socket_, boost::asio::buffer(&length, sizeof(length)),
-                      boost::asio::transfer_exactly(sizeof(length)), ec);
-    if (ec) {
+    const std::optional<CMD_ANSWER> result = future.get();
+    if (!result) {
         return false;
-    } else {
-        std::vector<char> buff(length);
-        boost::asio::read(*socket_, boost::asio::buffer(&buff[0], length),
-                          boost::asio::transfer_exactly(length), ec);
+    }
+    answer = *result;
+    return true;
+}
+
+void Helper_posix::writeFrame(quint32 connectionId, std::string frame)
+{
+    if (connectionId != connectionId_ || curState_ != STATE_CONNECTED) {
+        // the request is already failed by the disconnect
+        return;
+    }
+    writeQueue_.push_back(std::move(frame));
+    if (writingFrames_.empty()) {
+        writeQueuedFrames();
+    }
+}
+
+void Helper_posix::writeQueuedFrames()
+{
+    // the frames queued while the previous write was in progress are sent with one call
+    writingFrames_.swap(writeQueue_);
+    std::vector<boost::asio::const_buffer> buffers;
+    buffers.reserve(writingFrames_.size());
+    for (const auto &frame : writingFrames_) {
+        buffers.push_back(boost::asio::buffer(frame));
+    }
+
+    const quint32 connectionId = connectionId_;
+    boost::asio::async_write(*socket_, buffers, [this, connectionId](const boost::system::error_code &ec, std::size_t) {
+        writingFrames_.clear();
         if (ec) {
-            return false;
+            onSocketError(connectionId);
         }
+        if (!writeQueue_.empty() && curState_ == STATE_CONNECTED) {
+            writeQueuedFrames();
+        }
+    });
+}
+
+void Helper_posix::readAnswerHeader()
+{
+    const quint32 connectionId = connectionId_;
+    boost::asio::async_read(*socket_, boost::asio::buffer(&answerHeader_, sizeof(answerHeader_)),
+                            [this, connectionId](const boost::system::error_code &ec, std::size_t) {
+        if (ec || answerHeader_.magic != HELPER_V2_MAGIC || answerHeader_.length > HELPER_V2_MAX_LENGTH) {
+            onSocketError(connectionId);
+            return;
+        }
+        answerBody_.resize(answerHeader_.length);
+        readAnswerBody();
+    });
+}
+
+void Helper_posix::readAnswerBody()
+{
+    const quint32 connectionId = connectionId_;
+    boost::asio::async_read(*socket_, boost::asio::buffer(answerBody_), [this, connectionId](const boost::system::error_code &ec, std::size_t) {
+        if (ec) {
+            onSocketError(connectionId);
+            return;
+        }
+
+        if (answerHeader_.requestId == HELPER_V2_PUSH_REQUEST_ID) {
+            CMD_OUTPUT_CHUNK chunk;
+            if (helperBinaryDecode(answerBody_.data(), answerBody_.size(), chunk)) {
+                onCmdOutput(chunk);
+            }
+            readAnswerHeader();
+            return;
+        }
+
+        std::optional<CMD_ANSWER> answer = CMD_ANSWER();
+        if (!helperBinaryDecode(answerBody_.data(), answerBody_.size(), *answer)) {
+            answer.reset();
+        }
+
+        // the answers may come in any order
+        std::promise<std::optional<CMD_ANSWER>> promise;
+        bool isFound = false;
+        {
+            QMutexLocker locker(&mutexPendingAnswers_);
+            auto it = pendingAnswers_.find(answerHeader_.requestId);
+            if (it != pendingAnswers_.end()) {
+                promise = std::move(it->second);
+                pendingAnswers_.erase(it);
+                isFound = true;
+            }
+        }
+        if (isFound) {
+            promise.set_value(std::move(answer));
+        }
+        readAnswerHeader();
+    });
+}
 
-        std::string str(buff.begin(), buff.end());
-        std::istringstream stream(str);
-        boost::archive::text_iarchive ia(stream, boost::archive::no_header);
-        ia >> outAnswer;
+void Helper_posix::onConnected()
+{
+    {
+        QMutexLocker locker(&mutexPendingAnswers_);
+        connectionId_++;
+        curState_ = STATE_CONNECTED;
     }
+    // the frames of the previous connection, their requests are already failed
+    writeQueue_.clear();
+    readAnswerHeader();
 
-    return true;
+#ifdef Q_OS_LINUX
+    // the Linux helper pushes the output of OpenVPN and ctrld started on this connection, the answer is not needed
+    sendCommand(HELPER_CMD_SUBSCRIBE_CMD_OUTPUT, std::string());
+#endif
 }
 
-bool Helper_posix::sendCmdToHelper(int cmdId, const std::string &data)
+void Helper_posix::onSocketError(quint32 connectionId)
 {
-    int length = data.size();
+    // both the read and the write fail on a disconnect, the handlers of the previous connection are ignored
+    if (connectionId != connectionId_ || curState_ != STATE_CONNECTED) {
+        return;
+    }
+
+    qCDebug(LOG_BASIC) << "Disconnected from helper socket, try reconnect";
+    failPendingAnswers();
+    writeQueue_.clear();
     boost::system::error_code ec;
+    QMutexLocker locker(&mutexSocket_);
+    socket_->close(ec);
+    reconnectElapsedTimer_.start();
+    socket_->async_connect(ep_, connectHandler);
+}
 
-    // first 4 bytes - cmdId
-    boost::asio::write(*socket_, boost::asio::buffer(&cmdId, sizeof(cmdId)), boost::asio::transfer_exactly(sizeof(cmdId)), ec);
-    if (ec) {
-        return false;
-    }
-    // second 4 bytes - pid
-    const auto pid = getpid();
-    boost::asio::write(*socket_, boost::asio::buffer(&pid, sizeof(pid)), boost::asio::transfer_exactly(sizeof(pid)), ec);
-    if (ec) {
-        return false;
+void Helper_posix::failPendingAnswers()
+{
+    std::map<quint32, std::promise<std::optional<CMD_ANSWER>>> answers;
+    {
+        QMutexLocker locker(&mutexPendingAnswers_);
+        if (curState_ == STATE_CONNECTED) {
+            curState_ = STATE_INIT;
+        }
+        answers.swap(pendingAnswers_);
     }
-    // third 4 bytes - size of buffer
-    boost::asio::write(*socket_, boost::asio::buffer(&length, sizeof(length)), boost::asio::transfer_exactly(sizeof(length)), ec);
-    if (ec) {
-        return false;
-    }
-    // body of message
-    boost::asio::write(*socket_, boost::asio::buffer(data.data(), length), boost::asio::transfer_exactly(length), ec);
-    if (ec) {
-        doDisconnectAndReconnect();
-        return false;
+    for (auto &it : answers) {
+        it.second.set_value(std::nullopt);
     }
 
-    return true;
+    // the rest of the output is lost with the connection, the status of these commands is requested from the helper
+    QMutexLocker locker(&mutexCmdOutputs_);
+    cmdOutputs_.clear();
+}
+
+void Helper_posix::onCmdOutput(const CMD_OUTPUT_CHUNK &chunk)
+{
+    QMutexLocker locker(&mutexCmdOutputs_);
+    CmdOutput &output = cmdOutputs_[chunk.cmdId];
+    output.log += QString::fromStdString(chunk.data);
+    // a daemon writing to stdout (e.g. ctrld without a log file) is not polled, only its recent output is kept
+    if (output.log.size() > MAX_CMD_OUTPUT_LENGTH) {
+        output.log.remove(0, output.log.size() - MAX_CMD_OUTPUT_LENGTH);
+    }
+    output.isFinished = output.isFinished || chunk.isFinished;
 }
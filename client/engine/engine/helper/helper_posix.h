@@ -2,12 +2,18 @@
 #define HELPER_POSIX_H
 
 #include <QElapsedTimer>
+#include <QHash>
 #include <QThread>
 #include <QWaitCondition>
 #include <QMutex>
+#include <QPair>
+#include <QVector>
+#include <future>
+#include <map>
+#include <optional>
 #include "ihelper.h"
 #include "utils/boost_includes.h"
-#include "../../../../backend/posix_common/helper_commands.h"
+#include "../../../../backend/posix_common/helper_commands_binary.h"
 
 // common base helper for Linux/Mac
 class Helper_posix : public IHelper
@@ -54,6 +60,26 @@ public:
     bool setFirewallRules(CmdIpVersion version, const QString &table, const QString &group, const QString &rules);
     bool getFirewallRules(CmdIpVersion version, const QString &table, const QString &group, QString &rules);
     bool setFirewallOnBoot(bool bEnabled);
+    // applies the rules of several IP versions in one round trip, returns false for the versions which failed
+    QVector<bool> setFirewallRules(const QVector<QPair<CmdIpVersion, QString>> &rules);
+
+    // the tests connect to a stub server instead of the helper, must be called before the thread is started
+    void setSocketPath(const QString &path);
+
+    // Sends the command without waiting for the answer, can be called from any thread. The commands are pipelined on
+    // the helper socket (protocol v2), the future is ready when the answer comes, it is empty if the helper is disconnected.
+    template<class T>
+    std::future<std::optional<CMD_ANSWER>> runCommandAsync(int cmdId, const T &cmd)
+    {
+        return sendCommand(cmdId, helperBinaryEncode(cmd));
+    }
+    // executes the commands in one round trip, outAnswers gets the answers of the executed commands
+    bool runBatch(const CMD_BATCH &batch, std::vector<CMD_ANSWER> &outAnswers);
+    template<class T>
+    static void addToBatch(CMD_BATCH &batch, int cmdId, const T &cmd)
+    {
+        batch.items.push_back({ cmdId, helperBinaryEncode(cmd) });
+    }
 
 protected:
     void run() override;
@@ -78,6 +104,7 @@ protected:
     } WAITING_DATA;
 
     enum { MAX_WAIT_HELPER = 5000 };
+    enum { MAX_CMD_OUTPUT_LENGTH = 1024 * 1024 };
 
     QString interfaceToSkip_;
     bool bIPV6State_;
@@ -114,12 +141,52 @@ protected:
     static void connectHandler(const boost::system::error_code &ec);
     void doDisconnectAndReconnect();
 
-    bool readAnswer(CMD_ANSWER &outAnswer);
-    bool sendCmdToHelper(int cmdId, const std::string &data);
-    bool runCommand(int cmdId, const std::string &data, CMD_ANSWER &answer);
+    template<class T>
+    bool runCommand(int cmdId, const T &cmd, CMD_ANSWER &answer)
+    {
+        return waitAnswer(sendCommand(cmdId, helperBinaryEncode(cmd)), answer);
+    }
+    // the command without parameters
+    bool runCommand(int cmdId, CMD_ANSWER &answer)
+    {
+        return waitAnswer(sendCommand(cmdId, std::string()), answer);
+    }
 
 private:
     bool firstConnectToHelperErrorReported_;
+
+    // the requests waiting for the answers, by request id; guarded by mutexPendingAnswers_ together with
+    // the changes of curState_ and connectionId_, so a request is either failed by the disconnect or sent
+    QMutex mutexPendingAnswers_;
+    std::map<quint32, std::promise<std::optional<CMD_ANSWER>>> pendingAnswers_;
+    quint32 lastRequestId_ = 0;
+    quint32 connectionId_ = 0;
+
+    // the output of the commands pushed by the helper (CMD_OUTPUT_CHUNK), by command id
+    struct CmdOutput
+    {
+        QString log;
+        bool isFinished = false;
+    };
+    QMutex mutexCmdOutputs_;
+    QHash<unsigned long, CmdOutput> cmdOutputs_;
+
+    // accessed in the thread of io_service_ only
+    std::vector<std::string> writeQueue_;
+    std::vector<std::string> writingFrames_;
+    HELPER_V2_ANSWER_HEADER answerHeader_;
+    std::string answerBody_;
+
+    std::future<std::optional<CMD_ANSWER>> sendCommand(int cmdId, const std::string &data);
+    static bool waitAnswer(std::future<std::optional<CMD_ANSWER>> future, CMD_ANSWER &answer);
+    void writeFrame(quint32 connectionId, std::string frame);
+    void writeQueuedFrames();
+    void readAnswerHeader();
+    void readAnswerBody();
+    void onConnected();
+    void onSocketError(quint32 connectionId);
+    void failPendingAnswers();
+    void onCmdOutput(const CMD_OUTPUT_CHUNK &chunk);
 };
 
 #endif // HELPER_POSIX_H
@@ -0,0 +1,270 @@
+#include <QtTest>
+#include <QTemporaryDir>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <sstream>
+#include <thread>
+
+#include "engine/helper/helper_linux.h"
+
+// Sends kCommandsCount firewall commands (with a typical set of rules) to a stub helper on a temporary unix socket:
+// with the v1 protocol (text archive, one command per round trip, as the client did before),
+// with the v2 protocol one command at a time, and with the v2 protocol pipelined by Helper_posix::runCommandAsync.
+// Reports the commands per second and the p99 latency of a command.
+class BenchHelperIpc : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void benchmark_v1_sync();
+    void benchmark_v2_sync();
+    void benchmark_v2_pipelined();
+
+private:
+    static constexpr int kCommandsCount = 20000;
+    static constexpr int kPipelineDepth = 64;
+
+    QTemporaryDir dir_;
+    QString socketPath_;
+    int listenFd_ = -1;
+    std::thread acceptThread_;
+    std::atomic<bool> isFinish_{false};
+    CMD_SET_FIREWALL_RULES cmd_;
+    Helper_linux *helper_ = nullptr;
+
+    void acceptConnections();
+    static void serveConnection(int fd);
+    static bool readExactly(int fd, void *data, size_t size);
+    static bool writeExactly(int fd, const void *data, size_t size);
+    static void report(const char *name, qint64 elapsedNs, QVector<qint64> &latenciesNs);
+};
+
+void BenchHelperIpc::initTestCase()
+{
+    QVERIFY(dir_.isValid());
+    socketPath_ = dir_.filePath("helper.sock");
+
+    listenFd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    QVERIFY(listenFd_ >= 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketPath_.toUtf8().constData(), sizeof(addr.sun_path) - 1);
+    QVERIFY(bind(listenFd_, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    QVERIFY(listen(listenFd_, 16) == 0);
+    acceptThread_ = std::thread(&BenchHelperIpc::acceptConnections, this);
+
+    QStringList rules;
+    rules << "*filter";
+    for (int i = 0; i < 40; ++i)
+        rules << QString("-A windscribe_output -d 10.0.%1.1/32 -j ACCEPT -m comment --comment \"Windscribe client rule\"").arg(i);
+    rules << "COMMIT";
+    cmd_.ipVersion = kIpv4;
+    cmd_.rules = rules.join("\n").toStdString();
+
+    helper_ = new Helper_linux();
+    helper_->setSocketPath(socketPath_);
+    helper_->startInstallHelper();
+    QTRY_COMPARE_WITH_TIMEOUT(helper_->currentState(), IHelper::STATE_CONNECTED, 5000);
+}
+
+void BenchHelperIpc::cleanupTestCase()
+{
+    delete helper_;
+    isFinish_ = true;
+    shutdown(listenFd_, SHUT_RDWR);
+    acceptThread_.join();
+    close(listenFd_);
+}
+
+void BenchHelperIpc::acceptConnections()
+{
+    while (!isFinish_) {
+        const int fd = accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0)
+            break;
+        std::thread(&BenchHelperIpc::serveConnection, fd).detach();
+    }
+}
+
+// answers both protocols on the same connection, as the helper does
+void BenchHelperIpc::serveConnection(int fd)
+{
+    while (true) {
+        uint32_t magic;
+        if (!readExactly(fd, &magic, sizeof(magic)))
+            break;
+
+        CMD_SET_FIREWALL_RULES cmd;
+        CMD_ANSWER answer;
+        std::string data;
+        if (magic == HELPER_V2_MAGIC) {
+            HELPER_V2_REQUEST_HEADER header;
+            header.magic = magic;
+            if (!readExactly(fd, (char *)&header + sizeof(magic), sizeof(header) - sizeof(magic)))
+                break;
+            data.resize(header.length);
+            if (!readExactly(fd, data.data(), data.size()))
+                break;
+            answer.executed = helperBinaryDecode(data.data(), data.size(), cmd) ? 1 : 0;
+            answer.exitCode = (int)cmd.rules.size();
+
+            const std::string body = helperBinaryEncode(answer);
+            HELPER_V2_ANSWER_HEADER answerHeader = { HELPER_V2_MAGIC, header.requestId, (uint32_t)body.size() };
+            data.assign((const char *)&answerHeader, sizeof(answerHeader));
+            data += body;
+        } else {
+            int header[2];  // pid and length, the command id was read as the magic
+            if (!readExactly(fd, header, sizeof(header)))
+                break;
+            data.resize(header[1]);
+            if (!readExactly(fd, data.data(), data.size()))
+                break;
+            std::istringstream stream(data);
+            boost::archive::text_iarchive ia(stream, boost::archive::no_header);
+            ia >> cmd;
+            answer.executed = 1;
+            answer.exitCode = (int)cmd.rules.size();
+
+            std::stringstream answerStream;
+            boost::archive::text_oarchive oa(answerStream, boost::archive::no_header);
+            oa << answer;
+            const std::string body = answerStream.str();
+            const int length = (int)body.size();
+            data.assign((const char *)&length, sizeof(length));
+            data += body;
+        }
+        if (!writeExactly(fd, data.data(), data.size()))
+            break;
+    }
+    close(fd);
+}
+
+bool BenchHelperIpc::readExactly(int fd, void *data, size_t size)
+{
+    char *p = (char *)data;
+    while (size > 0) {
+        const ssize_t len = read(fd, p, size);
+        if (len <= 0)
+            return false;
+        p += len;
+        size -= len;
+    }
+    return true;
+}
+
+bool BenchHelperIpc::writeExactly(int fd, const void *data, size_t size)
+{
+    const char *p = (const char *)data;
+    while (size > 0) {
+        const ssize_t len = write(fd, p, size);
+        if (len <= 0)
+            return false;
+        p += len;
+        size -= len;
+    }
+    return true;
+}
+
+void BenchHelperIpc::report(const char *name, qint64 elapsedNs, QVector<qint64> &latenciesNs)
+{
+    std::sort(latenciesNs.begin(), latenciesNs.end());
+    const qint64 p99 = latenciesNs[latenciesNs.size() * 99 / 100];
+    qDebug() << name << "commands/s:" << qRound64(latenciesNs.size() * 1e9 / elapsedNs) << "p99 latency, us:" << p99 / 1000;
+}
+
+// the client side of v1 as it was in Helper_posix: serialize, send, wait for the answer, deserialize
+void BenchHelperIpc::benchmark_v1_sync()
+{
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    QVERIFY(fd >= 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketPath_.toUtf8().constData(), sizeof(addr.sun_path) - 1);
+    QVERIFY(::connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+
+    QVector<qint64> latencies;
+    latencies.reserve(kCommandsCount);
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < kCommandsCount; ++i) {
+        const qint64 startNs = timer.nsecsElapsed();
+
+        std::stringstream stream;
+        boost::archive::text_oarchive oa(stream, boost::archive::no_header);
+        oa << cmd_;
+        const std::string data = stream.str();
+        const int header[3] = { HELPER_CMD_SET_FIREWALL_RULES, (int)getpid(), (int)data.size() };
+        QVERIFY(writeExactly(fd, header, sizeof(header)));
+        QVERIFY(writeExactly(fd, data.data(), data.size()));
+
+        int length;
+        QVERIFY(readExactly(fd, &length, sizeof(length)));
+        std::vector<char> buf(length);
+        QVERIFY(readExactly(fd, buf.data(), length));
+        std::istringstream answerStream(std::string(buf.data(), length));
+        boost::archive::text_iarchive ia(answerStream, boost::archive::no_header);
+        CMD_ANSWER answer;
+        ia >> answer;
+        QCOMPARE(answer.exitCode, (int)cmd_.rules.size());
+
+        latencies << timer.nsecsElapsed() - startNs;
+    }
+    report("v1 sync", timer.nsecsElapsed(), latencies);
+    close(fd);
+}
+
+void BenchHelperIpc::benchmark_v2_sync()
+{
+    QVector<qint64> latencies;
+    latencies.reserve(kCommandsCount);
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < kCommandsCount; ++i) {
+        const qint64 startNs = timer.nsecsElapsed();
+        const std::optional<CMD_ANSWER> answer = helper_->runCommandAsync(HELPER_CMD_SET_FIREWALL_RULES, cmd_).get();
+        QVERIFY(answer.has_value());
+        QCOMPARE(answer->exitCode, (int)cmd_.rules.size());
+        latencies << timer.nsecsElapsed() - startNs;
+    }
+    report("v2 sync", timer.nsecsElapsed(), latencies);
+}
+
+// keeps kPipelineDepth commands in flight
+void BenchHelperIpc::benchmark_v2_pipelined()
+{
+    struct Pending
+    {
+        std::future<std::optional<CMD_ANSWER>> future;
+        qint64 startNs;
+    };
+    std::deque<Pending> pending;
+    QVector<qint64> latencies;
+    latencies.reserve(kCommandsCount);
+    QElapsedTimer timer;
+    timer.start();
+    for (int sent = 0; sent < kCommandsCount || !pending.empty(); ) {
+        while (sent < kCommandsCount && pending.size() < kPipelineDepth) {
+            pending.push_back({ helper_->runCommandAsync(HELPER_CMD_SET_FIREWALL_RULES, cmd_), timer.nsecsElapsed() });
+            sent++;
+        }
+        const std::optional<CMD_ANSWER> answer = pending.front().future.get();
+        QVERIFY(answer.has_value());
+        QCOMPARE(answer->exitCode, (int)cmd_.rules.size());
+        latencies << timer.nsecsElapsed() - pending.front().startNs;
+        pending.pop_front();
+    }
+    report("v2 pipelined", timer.nsecsElapsed(), latencies);
+}
+
+QTEST_MAIN(BenchHelperIpc)
+#include "helperipc.bench.moc"
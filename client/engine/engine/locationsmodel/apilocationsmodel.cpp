@@ -3,6 +3,8 @@
 #include <QFile>
 #include <QTextStream>
 
+#include <algorithm>
+
 #include "mutablelocationinfo.h"
 #include "nodeselectionalgorithm.h"
 #include "utils/logger.h"
@@ -13,7 +15,7 @@ ApiLocationsModel::ApiLocationsModel(QObject *parent, IConnectStateController *s
     pingIpsController_(this, stateController, networkDetectionManager, pingHost, "ping_log.txt")
 {
     connect(&pingIpsController_, &PingIpsController::pingInfoChanged, this, &ApiLocationsModel::onPingInfoChanged);
-    connect(&pingIpsController_, &PingIpsController::needIncrementPingIteration, this, &ApiLocationsModel::onNeedIncrementPingIteration);
+    connect(stateController, &IConnectStateController::stateChanged, this, &ApiLocationsModel::onConnectStateChanged);
     pingStorage_.incIteration();
 
     if (bestLocation_.isValid())
@@ -39,9 +41,12 @@ void ApiLocationsModel::setLocations(const QVector<apiinfo::Location> &locations
 
     // ping stuff
     QVector<PingIpInfo> ips;
+    pingIdToLocationId_.clear();
+    locationIdToPingId_.clear();
     for (const apiinfo::Location &l : locations) {
         for (int i = 0; i < l.groupsCount(); ++i) {
             apiinfo::Group group = l.getGroup(i);
+            addPingIdMapping(group.getId(), LocationID::createApiLocationId(l.getId(), group.getCity(), group.getNick()));
             // Ping with Curl by hostname was introduced later, so the ping hostname may be empty when updating the program from an older version.
             if (!group.getPingHost().isEmpty()) {
                 ips << PingIpInfo(QString::number(group.getId()), group.getPingIp(), group.getPingHost(), group.getCity(), group.getNick(), PingHost::PING_CURL);
@@ -52,12 +57,14 @@ void ApiLocationsModel::setLocations(const QVector<apiinfo::Location> &locations
     // handle static ips location
     for (int i = 0; i < staticIps_.getIpsCount(); ++i) {
         const apiinfo::StaticIpDescr &sid = staticIps_.getIp(i);
+        addPingIdMapping(sid.id, LocationID::createStaticIpsLocationId(sid.cityName, sid.staticIp));
         if (!sid.getPingHost().isEmpty()) {
             ips << PingIpInfo(QString::number(sid.id), sid.getPingIp(), sid.getPingHost(), sid.name, "staticIP", PingHost::PING_CURL);
         }
     }
 
     pingIpsController_.updateIps(ips);
+    updatePreferredPingIds();
     sendLocationsUpdated();
 }
 
@@ -65,6 +72,8 @@ void ApiLocationsModel::clear()
 {
     locations_.clear();
     staticIps_ = apiinfo::StaticIps();
+    pingIdToLocationId_.clear();
+    locationIdToPingId_.clear();
     pingIpsController_.updateIps(QVector<PingIpInfo>());
     QSharedPointer<QVector<types::Location> > empty(new QVector<types::Location>());
     Q_EMIT locationsUpdated(LocationID(), QString(),  empty);
@@ -158,41 +167,38 @@ void ApiLocationsModel::onPingInfoChanged(const QString &id, int timems)
         detectBestLocation(true);
     }
 
-    bool signalEmitted = false;
+    auto it = pingIdToLocationId_.constFind(locationId);
+    if (it != pingIdToLocationId_.constEnd()) {
+        Q_EMIT locationPingTimeChanged(it.value(), timems);
+    }
+}
 
-    for (const apiinfo::Location &l : locations_) {
-        for (int i = 0; i < l.groupsCount(); ++i) {
-            const apiinfo::Group group = l.getGroup(i);
-            if (group.getId() == locationId) {
-                Q_EMIT locationPingTimeChanged(LocationID::createApiLocationId(l.getId(), group.getCity(), group.getNick()), timems);
-                signalEmitted = true;
-                break;
-            }
-        }
+void ApiLocationsModel::onConnectStateChanged(CONNECT_STATE state, DISCONNECT_REASON reason, CONNECT_ERROR err, const LocationID &location)
+{
+    Q_UNUSED(reason);
+    Q_UNUSED(err);
+    if (state != CONNECT_STATE_CONNECTED) {
+        return;
     }
 
-    if (!signalEmitted) {
-        if (staticIps_.getIpsCount() > 0) {
-            for (int i = 0; i < staticIps_.getIpsCount(); ++i) {
-                const apiinfo::StaticIpDescr &sid = staticIps_.getIp(i);
-                if (sid.id == locationId) {
-                    Q_EMIT locationPingTimeChanged(LocationID::createStaticIpsLocationId(sid.cityName, sid.staticIp), timems);
-                    break;
-                }
-            }
-        }
+    const int pingId = pingIdForLocation(location);
+    if (pingId == -1) {
+        return;
     }
-}
 
-void ApiLocationsModel::onNeedIncrementPingIteration()
-{
-    pingStorage_.incIteration();
+    recentlyUsedLocations_.removeOne(pingId);
+    recentlyUsedLocations_.prepend(pingId);
+    if (recentlyUsedLocations_.size() > RECENTLY_USED_LOCATIONS_COUNT) {
+        recentlyUsedLocations_.resize(RECENTLY_USED_LOCATIONS_COUNT);
+    }
+    updatePreferredPingIds();
 }
 
 void ApiLocationsModel::detectBestLocation(bool isAllNodesInDisconnectedState)
 {
     int minLatency = INT_MAX;
     LocationID locationIdWithMinLatency;
+    QVector<QPair<int, int> > measuredLatencies;     // latency, ping id
 
     // Commented debug entry out as this method is potentially called every minute and we don't
     // need to flood the log with this info.
@@ -215,6 +221,11 @@ void ApiLocationsModel::detectBestLocation(bool isAllNodesInDisconnectedState)
             LocationID lid = LocationID::createApiLocationId(l.getId(), group.getCity(), group.getNick());
             int latency = pingStorage_.getPing(group.getId()).toInt();
 
+            if (latency != PingTime::NO_PING_INFO && latency != PingTime::PING_FAILED)
+            {
+                measuredLatencies << qMakePair(latency, group.getId());
+            }
+
             // we assume a maximum ping time for three bars when no ping info
             if (latency == PingTime::NO_PING_INFO)
             {
@@ -239,6 +250,20 @@ void ApiLocationsModel::detectBestLocation(bool isAllNodesInDisconnectedState)
         ind++;
     }
 
+    // the best location may change to one of the candidates, keep their latencies fresh
+    const int candidatesCount = qMin<int>(BEST_LOCATION_CANDIDATES_COUNT, measuredLatencies.size());
+    std::partial_sort(measuredLatencies.begin(), measuredLatencies.begin() + candidatesCount, measuredLatencies.end());
+    QVector<int> bestLocationCandidates;
+    for (int i = 0; i < candidatesCount; ++i)
+    {
+        bestLocationCandidates << measuredLatencies[i].second;
+    }
+    if (bestLocationCandidates != bestLocationCandidates_)
+    {
+        bestLocationCandidates_ = bestLocationCandidates;
+        updatePreferredPingIds();
+    }
+
     LocationID prevBestLocationId;
     if (bestLocation_.isValid())
     {
@@ -424,6 +449,44 @@ void ApiLocationsModel::whitelistIps()
     Q_EMIT whitelistIpsChanged(ips);
 }
 
+int ApiLocationsModel::pingIdForLocation(const LocationID &locationId) const
+{
+    if (!locationId.isValid())
+    {
+        return -1;
+    }
+
+    const LocationID id = locationId.isBestLocation() ? locationId.bestLocationToApiLocation() : locationId;
+    return locationIdToPingId_.value(id, -1);
+}
+
+void ApiLocationsModel::addPingIdMapping(int pingId, const LocationID &locationId)
+{
+    // the groups of the API locations take precedence over the static IPs with the same id
+    if (!pingIdToLocationId_.contains(pingId))
+    {
+        pingIdToLocationId_.insert(pingId, locationId);
+    }
+    if (!locationIdToPingId_.contains(locationId))
+    {
+        locationIdToPingId_.insert(locationId, pingId);
+    }
+}
+
+void ApiLocationsModel::updatePreferredPingIds()
+{
+    QSet<QString> ids;
+    for (int id : qAsConst(bestLocationCandidates_))
+    {
+        ids << QString::number(id);
+    }
+    for (int id : qAsConst(recentlyUsedLocations_))
+    {
+        ids << QString::number(id);
+    }
+    pingIpsController_.setPreferredIds(ids);
+}
+
 bool ApiLocationsModel::isChanged(const QVector<apiinfo::Location> &locations, const apiinfo::StaticIps &staticIps)
 {
     return locations_ != locations || staticIps_ != staticIps;
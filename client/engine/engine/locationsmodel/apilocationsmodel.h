@@ -46,9 +46,13 @@ signals:
 
 private slots:
     void onPingInfoChanged(const QString &id, int timems);
-    void onNeedIncrementPingIteration();
+    void onConnectStateChanged(CONNECT_STATE state, DISCONNECT_REASON reason, CONNECT_ERROR err, const LocationID &location);
 
 private:
+    // the nodes of these locations are pinged more often
+    static constexpr int BEST_LOCATION_CANDIDATES_COUNT = 5;
+    static constexpr int RECENTLY_USED_LOCATIONS_COUNT = 5;
+
     ApiPingStorage pingStorage_;
     QVector<apiinfo::Location> locations_;
     apiinfo::StaticIps staticIps_;
@@ -56,12 +60,19 @@ private:
     BestLocation bestLocation_;
 
     PingIpsController pingIpsController_;
+    QVector<int> bestLocationCandidates_;   // ping ids with the lowest latencies
+    QVector<int> recentlyUsedLocations_;    // ping ids of the latest connected locations, the latest first
+    QHash<int, LocationID> pingIdToLocationId_;     // built with the ping ips, for the API locations and the static IPs
+    QHash<LocationID, int> locationIdToPingId_;
 
 private:
     void detectBestLocation(bool isAllNodesInDisconnectedState);
     BestAndAllLocations generateLocationsUpdated();
     void sendLocationsUpdated();
     void whitelistIps();
+    int pingIdForLocation(const LocationID &locationId) const;
+    void addPingIdMapping(int pingId, const LocationID &locationId);
+    void updatePreferredPingIds();
 
     bool isChanged(const QVector<apiinfo::Location> &locations, const apiinfo::StaticIps &staticIps);
 };
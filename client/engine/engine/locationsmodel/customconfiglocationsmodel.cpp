@@ -17,7 +17,6 @@ CustomConfigLocationsModel::CustomConfigLocationsModel(QObject *parent, IConnect
     pingIpsController_(this, stateController, networkDetectionManager, pingHost, "ping_log_custom_configs.txt")
 {
     connect(&pingIpsController_, &PingIpsController::pingInfoChanged, this, &CustomConfigLocationsModel::onPingInfoChanged);
-    connect(&pingIpsController_, &PingIpsController::needIncrementPingIteration, this, &CustomConfigLocationsModel::onNeedIncrementPingIteration);
     pingStorage_.incIteration();
 }
 
@@ -112,11 +111,6 @@ void CustomConfigLocationsModel::onPingInfoChanged(const QString &ip, int timems
     }
 }
 
-void CustomConfigLocationsModel::onNeedIncrementPingIteration()
-{
-    pingStorage_.incIteration();
-}
-
 void CustomConfigLocationsModel::onDnsRequestFinished()
 {
     DnsRequest *dnsRequest = qobject_cast<DnsRequest *>(sender());
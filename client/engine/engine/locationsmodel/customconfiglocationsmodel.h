@@ -38,7 +38,6 @@ signals:
 
 private slots:
     void onPingInfoChanged(const QString &ip, int timems);
-    void onNeedIncrementPingIteration();
     void onDnsRequestFinished();
 
 private:
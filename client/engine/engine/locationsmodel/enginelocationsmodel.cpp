@@ -2,6 +2,8 @@
 
 #include <QThread>
 
+const int typeIdPingTimesHash = qRegisterMetaType<QHash<LocationID, PingTime> >("QHash<LocationID,PingTime>");
+
 namespace locationsmodel {
 
 LocationsModel::LocationsModel(QObject *parent, IConnectStateController *stateController, INetworkDetectionManager *networkDetectionManager, NetworkAccessManager *networkAccessManager) : QObject(parent)
@@ -13,12 +15,16 @@ LocationsModel::LocationsModel(QObject *parent, IConnectStateController *stateCo
 
     connect(apiLocationsModel_, &ApiLocationsModel::locationsUpdated, this, &LocationsModel::locationsUpdated);
     connect(apiLocationsModel_, &ApiLocationsModel::bestLocationUpdated, this, &LocationsModel::bestLocationUpdated);
-    connect(apiLocationsModel_, &ApiLocationsModel::locationPingTimeChanged, this, &LocationsModel::locationPingTimeChanged);
+    connect(apiLocationsModel_, &ApiLocationsModel::locationPingTimeChanged, this, &LocationsModel::onLocationPingTimeChanged);
     connect(apiLocationsModel_, &ApiLocationsModel::whitelistIpsChanged, this, &LocationsModel::whitelistLocationsIpsChanged);
 
     connect(customConfigLocationsModel_, &CustomConfigLocationsModel::locationsUpdated, this, &LocationsModel::customConfigsLocationsUpdated);
-    connect(customConfigLocationsModel_, &CustomConfigLocationsModel::locationPingTimeChanged, this, &LocationsModel::locationPingTimeChanged);
+    connect(customConfigLocationsModel_, &CustomConfigLocationsModel::locationPingTimeChanged, this, &LocationsModel::onLocationPingTimeChanged);
     connect(customConfigLocationsModel_, &CustomConfigLocationsModel::whitelistIpsChanged, this, &LocationsModel::whitelistCustomConfigsIpsChanged);
+
+    pingTimesFlushTimer_.setSingleShot(true);
+    pingTimesFlushTimer_.setInterval(kPingTimesFlushPeriodMs);
+    connect(&pingTimesFlushTimer_, &QTimer::timeout, this, &LocationsModel::onPingTimesFlushTimer);
 }
 
 LocationsModel::~LocationsModel()
@@ -40,6 +46,8 @@ void LocationsModel::setCustomConfigLocations(const QVector<QSharedPointer<const
 
 void LocationsModel::clear()
 {
+    pingTimesFlushTimer_.stop();
+    pendingPingTimes_.clear();
     apiLocationsModel_->clear();
     customConfigLocationsModel_->clear();
 }
@@ -69,4 +77,24 @@ QSharedPointer<BaseLocationInfo> LocationsModel::getMutableLocationInfoById(cons
     }
 }
 
+void LocationsModel::onLocationPingTimeChanged(const LocationID &id, PingTime timeMs)
+{
+    // only the latest ping time of a location matters
+    pendingPingTimes_[id] = timeMs;
+    if (!pingTimesFlushTimer_.isActive())
+    {
+        pingTimesFlushTimer_.start();
+    }
+}
+
+void LocationsModel::onPingTimesFlushTimer()
+{
+    if (!pendingPingTimes_.isEmpty())
+    {
+        QHash<LocationID, PingTime> pingTimes;
+        pingTimes.swap(pendingPingTimes_);
+        Q_EMIT locationPingTimesChanged(pingTimes);
+    }
+}
+
 } //namespace locationsmodel
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <QHash>
 #include <QObject>
+#include <QTimer>
 
 #include "apilocationsmodel.h"
 #include "customconfiglocationsmodel.h"
@@ -33,15 +35,25 @@ signals:
     void locationsUpdated(const LocationID &bestLocation, const QString &staticIpDeviceName, QSharedPointer<QVector<types::Location> > locations);
     void customConfigsLocationsUpdated(QSharedPointer<types::Location > location);
     void bestLocationUpdated(const LocationID &bestLocation);
-    void locationPingTimeChanged(const LocationID &id, PingTime timeMs);
+    // the ping times since the previous signal, sent at most once per kPingTimesFlushPeriodMs
+    void locationPingTimesChanged(const QHash<LocationID, PingTime> &pingTimes);
 
     void whitelistLocationsIpsChanged(const QStringList &ips);
     void whitelistCustomConfigsIpsChanged(const QStringList &ips);
 
+private slots:
+    void onLocationPingTimeChanged(const LocationID &id, PingTime timeMs);
+    void onPingTimesFlushTimer();
+
 private:
+    // a ping sweep produces thousands of results, they are passed to the GUI thread once per display frame
+    static constexpr int kPingTimesFlushPeriodMs = 16;
+
     ApiLocationsModel *apiLocationsModel_;
     CustomConfigLocationsModel *customConfigLocationsModel_;
     PingHost *pingHost_;
+    QHash<LocationID, PingTime> pendingPingTimes_;
+    QTimer pingTimesFlushTimer_;
 };
 
 } //namespace locationsmodel
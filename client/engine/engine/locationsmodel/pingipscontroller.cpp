@@ -1,6 +1,9 @@
 #include "pingipscontroller.h"
 
-#include "../connectstatecontroller/iconnectstatecontroller.h"
+#include <QDateTime>
+
+#include <cmath>
+
 #include "utils/logger.h"
 #include "types/pingtime.h"
 #include "utils/utils.h"
@@ -14,24 +17,11 @@ PingIpsController::PingIpsController(QObject *parent, IConnectStateController *s
     pingLog_(log_filename), pingHost_(pingHost)
 {
     connect(pingHost_, &PingHost::pingFinished, this, &PingIpsController::onPingFinished);
+    connect(connectStateController_, &IConnectStateController::stateChanged, this, &PingIpsController::onConnectStateChanged);
+    connect(networkDetectionManager_, &INetworkDetectionManager::onlineStateChanged, this, &PingIpsController::onOnlineStateChanged);
+    connect(networkDetectionManager_, &INetworkDetectionManager::networkChanged, this, &PingIpsController::onNetworkChanged);
+    pingTimer_.setSingleShot(true);
     connect(&pingTimer_, &QTimer::timeout, this, &PingIpsController::onPingTimer);
-
-    int pingHour = Utils::generateIntegerRandom(0, 23);
-    int pingMinute = Utils::generateIntegerRandom(0, 59);
-    int pingSecond = Utils::generateIntegerRandom(0, 59);
-
-    dtNextPingTime_ = QDateTime::currentDateTime();
-
-    if (dtNextPingTime_.time().hour() < pingHour) {
-        dtNextPingTime_.setTime(QTime(pingHour, pingMinute, pingSecond));
-    }
-    else {
-        dtNextPingTime_.setTime(QTime(pingHour, pingMinute, pingSecond));
-        dtNextPingTime_ = dtNextPingTime_.addDays(1);
-    }
-    //dtNextPingTime_ = dtNextPingTime_.addSecs(20);      // for testing
-
-    pingLog_.addLog("PingIpsController::PingIpsController","set next ping time: " + dtNextPingTime_.toString("ddMMyyyy HH:mm:ss"));
 }
 
 void PingIpsController::updateIps(const QVector<PingIpInfo> &ips)
@@ -42,17 +32,20 @@ void PingIpsController::updateIps(const QVector<PingIpInfo> &ips)
         it.value().existThisIp = false;
     }
 
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
     for (const PingIpInfo &ip_info : ips) {
         auto it = ips_.find(ip_info.id_);
         if (it == ips_.end()) {
-            ips_[ip_info.id_] = PingNodeInfo(ip_info);
+            // ping the new node now
+            PingNodeInfo &pni = ips_[ip_info.id_] = PingNodeInfo(ip_info);
+            schedule(pni, now);
         }
         else {
             it.value().existThisIp = true;
         }
     }
 
-    // remove unused ips
+    // remove unused ips, their items in the heap become outdated
     auto it = ips_.begin();
     while (it != ips_.end()) {
         if (!it.value().existThisIp) {
@@ -66,51 +59,68 @@ void PingIpsController::updateIps(const QVector<PingIpInfo> &ips)
 
     failedPingLogController_.clear();
 
-    onPingTimer();
-    pingTimer_.start(PING_TIMER_INTERVAL);
+    rescheduleTimer();
 }
 
-void PingIpsController::onPingTimer()
+void PingIpsController::setPreferredIds(const QSet<QString> &ids)
 {
-    // We don't attempt to issue a ping request when state is CONNECT_STATE_CONNECTING, as the firewall will block it.
-    if (!networkDetectionManager_->isOnline() || connectStateController_->currentState() != CONNECT_STATE_DISCONNECTED) {
-        return;
+    bool isScheduleChanged = false;
+    for (auto it = ips_.begin(); it != ips_.end(); ++it) {
+        PingNodeInfo &pni = it.value();
+        const bool isPreferred = ids.contains(it.key());
+        if (pni.isPreferred_ == isPreferred) {
+            continue;
+        }
+        pni.isPreferred_ = isPreferred;
+
+        // a node which became preferred is re-pinged within the high priority interval from its latest ping,
+        // a node which is not preferred anymore keeps its due time
+        if (isPreferred && !pni.nowPinging_ && pni.isExistPingAttempt_ && pni.failedSeries_ == 0) {
+            const qint64 dueTime = pni.lastPingTime_ + HIGH_PRIORITY_INTERVAL;
+            if (dueTime < pni.dueTime_) {
+                schedule(pni, dueTime);
+                isScheduleChanged = true;
+            }
+        }
     }
 
-    bool bNeedPingByTime = QDateTime::currentDateTime() > dtNextPingTime_;
-    if (bNeedPingByTime) {
-        dtNextPingTime_ = dtNextPingTime_.addDays(1);
-        //dtNextPingTime_ = dtNextPingTime_.addSecs(20);      // for testing
-        qCDebug(LOG_BASIC) << "Ping all nodes by time";
-        pingLog_.addLog("PingIpsController::onPingTimer", "it's ping time, set next ping time to:" + dtNextPingTime_.toString("ddMMyyyy HH:mm:ss"));
-        Q_EMIT needIncrementPingIteration();
+    if (isScheduleChanged) {
+        rescheduleTimer();
     }
+}
 
-    for (auto it = ips_.begin(); it != ips_.end(); ++it) {
-        PingNodeInfo &pni = it.value();
+void PingIpsController::onPingTimer()
+{
+    // We don't attempt to issue a ping request when state is CONNECT_STATE_CONNECTING, as the firewall will block it.
+    // The timer is restarted when the state changes to disconnected and online.
+    if (!isPingAllowed()) {
+        pingTimer_.stop();
+        return;
+    }
 
-        if (pni.nowPinging_) {
-            continue;
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    int pingsCount = 0;
+    while (pingsCount < MAX_PINGS_PER_TICK) {
+        dropOutdatedItems();
+        if (schedule_.empty() || schedule_.top().dueTime > now) {
+            break;
         }
 
-        if (bNeedPingByTime) {
-            pingLog_.addLog("PingNodesController::onPingTimer", tr("start ping by time for: %1 (%2 - %3)").arg(pni.ipInfo_.ip_, pni.ipInfo_.city_, pni.ipInfo_.nick_));
-            pni.nowPinging_ = true;
-            pingHost_->addHostForPing(pni.ipInfo_.id_, pni.ipInfo_.ip_, pni.ipInfo_.pingType_, pni.ipInfo_.hostname_);
-        }
-        else if (!pni.isExistPingAttempt_) {
+        const QString id = schedule_.top().id;
+        schedule_.pop();
+
+        PingNodeInfo &pni = ips_[id];
+        if (!pni.isExistPingAttempt_) {
             pingLog_.addLog("PingNodesController::onPingTimer", tr("ping new node: %1 (%2 - %3)").arg(pni.ipInfo_.ip_, pni.ipInfo_.city_, pni.ipInfo_.nick_));
-            pni.nowPinging_ = true;
-            pingHost_->addHostForPing(pni.ipInfo_.id_, pni.ipInfo_.ip_, pni.ipInfo_.pingType_, pni.ipInfo_.hostname_);
-        }
-        else if (pni.latestPingFailed_) {
-            if (pni.nextTimeForFailedPing_ == 0 || QDateTime::currentMSecsSinceEpoch() >= pni.nextTimeForFailedPing_) {
-                //pingLog_.addLog("PingNodesController::onPingTimer", "start ping because latest ping failed: " + it.key());
-                pni.nowPinging_ = true;
-                pingHost_->addHostForPing(pni.ipInfo_.id_, pni.ipInfo_.ip_, pni.ipInfo_.pingType_, pni.ipInfo_.hostname_);
-            }
         }
+        pni.nowPinging_ = true;
+        pingHost_->addHostForPing(pni.ipInfo_.id_, pni.ipInfo_.ip_, pni.ipInfo_.pingType_, pni.ipInfo_.hostname_);
+        pingsCount++;
     }
+
+    // the rest of the due nodes wait for the next tick, so the uplink is not saturated by a burst of pings
+    nextTickTime_ = (pingsCount == MAX_PINGS_PER_TICK) ? now + PING_TICK_INTERVAL : 0;
+    rescheduleTimer();
 }
 
 void PingIpsController::onPingFinished(bool success, int timems, const QString &id, bool isFromDisconnectedState)
@@ -126,29 +136,49 @@ void PingIpsController::onPingFinished(bool success, int timems, const QString &
     PingNodeInfo &pni = itNode.value();
     pni.nowPinging_ = false;
 
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
     if (success) {
         // If the ping was executed in the connected state, we'll mark it as never happening and reissue it when
         // we're back in the disconnected state.
         pni.isExistPingAttempt_ = isFromDisconnectedState;
-        pni.latestPingFailed_ = false;
         pni.failedPingsInRow_ = 0;
 
         if (isFromDisconnectedState) {
-            Q_EMIT pingInfoChanged(id, timems);
-            pingLog_.addLog("PingIpsController::onPingFinished", tr("ping successful: %1 (%2 - %3) %4ms").arg(pni.ipInfo_.ip_, pni.ipInfo_.city_, pni.ipInfo_.nick_).arg(timems));
+            pni.failedSeries_ = 0;
+            if (pni.latencyEwma_ < 0 || pni.isStale_) {
+                pni.latencyEwma_ = timems;
+                pni.jitterEwma_ = 0;
+                pni.isStale_ = false;
+            }
+            else {
+                pni.jitterEwma_ += JITTER_EWMA_ALPHA * (std::abs(timems - pni.latencyEwma_) - pni.jitterEwma_);
+                pni.latencyEwma_ += LATENCY_EWMA_ALPHA * (timems - pni.latencyEwma_);
+            }
+            pni.lastPingTime_ = now;
+            scheduleNextPing(pni, now);
+
+            Q_EMIT pingInfoChanged(id, qRound(pni.latencyEwma_));
+            pingLog_.addLog("PingIpsController::onPingFinished", tr("ping successful: %1 (%2 - %3) %4ms, average %5ms, jitter %6ms")
+                            .arg(pni.ipInfo_.ip_, pni.ipInfo_.city_, pni.ipInfo_.nick_).arg(timems).arg(qRound(pni.latencyEwma_)).arg(qRound(pni.jitterEwma_)));
         }
         else {
+            schedule(pni, now);
             pingLog_.addLog("PingIpsController::onPingFinished", tr("discarding ping while connected: %1 (%2 - %3)").arg(pni.ipInfo_.ip_, pni.ipInfo_.city_, pni.ipInfo_.nick_));
         }
     }
     else {
         pni.isExistPingAttempt_ = true;
-        pni.latestPingFailed_ = true;
         pni.failedPingsInRow_++;
 
         if (pni.failedPingsInRow_ >= MAX_FAILED_PING_IN_ROW) {
             pni.failedPingsInRow_ = 0;
-            pni.nextTimeForFailedPing_ = QDateTime::currentMSecsSinceEpoch() + 1000 * 60;
+            pni.latencyEwma_ = -1;
+            pni.lastPingTime_ = now;
+            // retry in 1, 2, 4... minutes, but not more rarely than the low priority nodes are pinged
+            const qint64 retryInterval = FAILED_PING_RETRY_INTERVAL << qMin(pni.failedSeries_, 16);
+            schedule(pni, now + qMin(retryInterval, LOW_PRIORITY_INTERVAL));
+            pni.failedSeries_++;
 
             if (isFromDisconnectedState) {
                 Q_EMIT pingInfoChanged(id, PingTime::PING_FAILED);
@@ -159,9 +189,142 @@ void PingIpsController::onPingFinished(bool success, int timems, const QString &
             }
         }
         else {
-            pni.nextTimeForFailedPing_ = 0;
+            schedule(pni, now + PING_TICK_INTERVAL);
+        }
+    }
+
+    rescheduleTimer();
+}
+
+void PingIpsController::onConnectStateChanged(CONNECT_STATE state, DISCONNECT_REASON reason, CONNECT_ERROR err, const LocationID &location)
+{
+    Q_UNUSED(reason);
+    Q_UNUSED(err);
+    Q_UNUSED(location);
+    if (state == CONNECT_STATE_DISCONNECTED) {
+        rescheduleTimer();
+    }
+}
+
+void PingIpsController::onOnlineStateChanged(bool isOnline)
+{
+    if (isOnline) {
+        rescheduleTimer();
+    }
+}
+
+void PingIpsController::onNetworkChanged(const types::NetworkInterface &networkInterface)
+{
+    Q_UNUSED(networkInterface);
+    // the latencies measured from another network are not reliable anymore. The preferred nodes are re-pinged soon
+    // (spread to avoid a burst), the rest keep their latencies until their next ping at the usual time,
+    // so a network change does not cost a sweep of all the nodes
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    bool isScheduleChanged = false;
+    for (auto it = ips_.begin(); it != ips_.end(); ++it) {
+        PingNodeInfo &pni = it.value();
+        pni.isStale_ = pni.latencyEwma_ >= 0;
+        if (!pni.isPreferred_) {
+            continue;
+        }
+        pni.failedPingsInRow_ = 0;
+        pni.failedSeries_ = 0;
+        // a node which is being pinged now is scheduled by its result
+        if (!pni.nowPinging_) {
+            const qint64 dueTime = now + Utils::generateIntegerRandom(0, NETWORK_CHANGE_SPREAD);
+            if (dueTime < pni.dueTime_) {
+                schedule(pni, dueTime);
+                isScheduleChanged = true;
+            }
+        }
+    }
+    if (isScheduleChanged) {
+        rescheduleTimer();
+    }
+}
+
+qint64 PingIpsController::dueTime(const QString &id) const
+{
+    auto it = ips_.constFind(id);
+    if (it == ips_.constEnd() || it->nowPinging_) {
+        return -1;
+    }
+    return it->dueTime_;
+}
+
+bool PingIpsController::isPingAllowed() const
+{
+    return networkDetectionManager_->isOnline() && connectStateController_->currentState() == CONNECT_STATE_DISCONNECTED;
+}
+
+void PingIpsController::schedule(PingNodeInfo &pni, qint64 dueTime)
+{
+    pni.dueTime_ = dueTime;
+    pni.generation_ = ++nextGeneration_;
+    schedule_.push(ScheduleItem{dueTime, pni.ipInfo_.id_, pni.generation_});
+
+    // each node has one actual item, rebuild the heap if there are too many outdated ones
+    if (schedule_.size() > 2 * (size_t)ips_.size() + 64) {
+        std::vector<ScheduleItem> items;
+        items.reserve(ips_.size());
+        while (!schedule_.empty()) {
+            auto it = ips_.constFind(schedule_.top().id);
+            if (it != ips_.constEnd() && !it->nowPinging_ && it->generation_ == schedule_.top().generation) {
+                items.push_back(schedule_.top());
+            }
+            schedule_.pop();
         }
+        schedule_ = decltype(schedule_)(std::greater<ScheduleItem>(), std::move(items));
+    }
+}
+
+void PingIpsController::scheduleNextPing(PingNodeInfo &pni, qint64 now)
+{
+    // spread the nodes with the same interval by +-10%, so they are not pinged in a burst
+    const qint64 interval = pingInterval(pni.isPreferred_, pni.latencyEwma_, pni.jitterEwma_);
+    const int spreadPercent = Utils::generateIntegerRandom(-10, 10);
+    schedule(pni, now + interval + interval * spreadPercent / 100);
+}
+
+qint64 PingIpsController::pingInterval(bool isPreferred, double latencyEwma, double jitterEwma)
+{
+    qint64 interval = NORMAL_PRIORITY_INTERVAL;
+    if (isPreferred) {
+        interval = HIGH_PRIORITY_INTERVAL;
+    }
+    else if (latencyEwma >= FAR_NODE_LATENCY) {
+        interval = LOW_PRIORITY_INTERVAL;
+    }
+
+    // the latency of a node with a large jitter is not reliable yet, measure it more often
+    if (latencyEwma > 0 && jitterEwma > latencyEwma / 4) {
+        interval /= 2;
     }
+    return interval;
+}
+
+void PingIpsController::dropOutdatedItems()
+{
+    while (!schedule_.empty()) {
+        const ScheduleItem &item = schedule_.top();
+        auto it = ips_.constFind(item.id);
+        if (it != ips_.constEnd() && !it->nowPinging_ && it->generation_ == item.generation) {
+            break;
+        }
+        schedule_.pop();
+    }
+}
+
+void PingIpsController::rescheduleTimer()
+{
+    dropOutdatedItems();
+    if (schedule_.empty() || !isPingAllowed()) {
+        pingTimer_.stop();
+        return;
+    }
+
+    const qint64 timeout = qMax(schedule_.top().dueTime, nextTickTime_) - QDateTime::currentMSecsSinceEpoch();
+    pingTimer_.start(qBound<qint64>(0, timeout, MAX_TIMER_INTERVAL));
 }
 
 } //namespace locationsmodel
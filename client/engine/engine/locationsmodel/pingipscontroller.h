@@ -1,9 +1,14 @@
 #pragma once
 
-#include <QDateTime>
 #include <QHash>
 #include <QObject>
+#include <QSet>
+#include <QTimer>
 
+#include <queue>
+#include <vector>
+
+#include "engine/connectstatecontroller/iconnectstatecontroller.h"
 #include "engine/networkdetectionmanager/inetworkdetectionmanager.h"
 #include "engine/ping/pinghost.h"
 #include "failedpinglogcontroller.h"
@@ -27,7 +32,11 @@ struct PingIpInfo
 
 
 // logic of ping all nodes (taken into account connected/disconnected state, latest ping time, repeat failed pings)
-// starts ping on updateIps(...) and repeat ping every 24 hours
+// New nodes are pinged on updateIps(...), then every node is re-pinged at its own time: preferred nodes (best location
+// candidates, recently used locations) often, far away nodes rarely. The due times are kept in a min-heap, so the timer
+// handles only the nodes which are due. The reported ping time is the EWMA of the measured latencies.
+// After a network change only the preferred nodes are re-pinged soon, the rest keep their due times and restart
+// their EWMA from the first latency measured on the new network.
 class PingIpsController : public QObject
 {
     Q_OBJECT
@@ -35,18 +44,38 @@ public:
     explicit PingIpsController(QObject *parent, IConnectStateController *stateController, INetworkDetectionManager *networkDetectionManager, PingHost *pingHost, const QString &log_filename);
 
     void updateIps(const QVector<PingIpInfo> &ips);
+    // the nodes with these ids are re-pinged with the high priority interval, the rest with the normal or low one
+    void setPreferredIds(const QSet<QString> &ids);
+
+    // the time of the next ping of the node (ms since epoch), -1 if the node is unknown or is being pinged
+    qint64 dueTime(const QString &id) const;
+    // the interval between the pings of a node, before the random spread
+    static qint64 pingInterval(bool isPreferred, double latencyEwma, double jitterEwma);
+
+    static constexpr qint64 HIGH_PRIORITY_INTERVAL = 10 * 60 * 1000;
+    static constexpr qint64 NORMAL_PRIORITY_INTERVAL = 6 * 60 * 60 * 1000;
+    static constexpr qint64 LOW_PRIORITY_INTERVAL = 24 * 60 * 60 * 1000;
+    static constexpr int FAR_NODE_LATENCY = 200;            // nodes with a larger latency have the low priority
+    static constexpr int NETWORK_CHANGE_SPREAD = 10 * 1000; // the preferred nodes are re-pinged within this time after a network change
 
 signals:
     void pingInfoChanged(const QString &id, int timems);
-    void needIncrementPingIteration();
 
 private slots:
     void onPingTimer();
     void onPingFinished(bool success, int timems, const QString &id, bool isFromDisconnectedState);
+    void onConnectStateChanged(CONNECT_STATE state, DISCONNECT_REASON reason, CONNECT_ERROR err, const LocationID &location);
+    void onOnlineStateChanged(bool isOnline);
+    void onNetworkChanged(const types::NetworkInterface &networkInterface);
 
 private:
-    static constexpr int PING_TIMER_INTERVAL = 1000;
     static constexpr int MAX_FAILED_PING_IN_ROW = 3;
+    static constexpr int MAX_PINGS_PER_TICK = 32;           // the rest of the due nodes are pinged on the next tick
+    static constexpr int PING_TICK_INTERVAL = 1000;
+    static constexpr int MAX_TIMER_INTERVAL = 60 * 1000;    // the wall clock may jump after a sleep
+    static constexpr qint64 FAILED_PING_RETRY_INTERVAL = 60 * 1000;     // doubled after each failed series
+    static constexpr double LATENCY_EWMA_ALPHA = 0.25;
+    static constexpr double JITTER_EWMA_ALPHA = 0.25;
 
     PingHost* const pingHost_;
     IConnectStateController* const connectStateController_;
@@ -59,20 +88,42 @@ private:
     {
         PingIpInfo ipInfo_;
         bool isExistPingAttempt_ = false;
-        bool latestPingFailed_ = false;
         bool nowPinging_ = false;
+        bool isPreferred_ = false;
         int failedPingsInRow_ = 0;
-        qint64 nextTimeForFailedPing_ = 0;
+        int failedSeries_ = 0;
+        double latencyEwma_ = -1;   // < 0 if there is no successful ping yet
+        double jitterEwma_ = 0;
+        bool isStale_ = false;      // the EWMA was measured on the previous network
+        qint64 lastPingTime_ = 0;
+        qint64 dueTime_ = 0;
+        quint32 generation_ = 0;    // the heap items of the previous generations are outdated
         bool existThisIp = false;
 
         PingNodeInfo() {}
         PingNodeInfo(const PingIpInfo &ipInfo) : ipInfo_(ipInfo), existThisIp(true) {}
     };
 
+    struct ScheduleItem
+    {
+        qint64 dueTime;
+        QString id;
+        quint32 generation;
+        bool operator>(const ScheduleItem &other) const { return dueTime > other.dueTime; }
+    };
+
     QHash<QString, PingNodeInfo> ips_;
+    std::priority_queue<ScheduleItem, std::vector<ScheduleItem>, std::greater<ScheduleItem> > schedule_;
+    quint32 nextGeneration_ = 0;
+    qint64 nextTickTime_ = 0;
 
     QTimer pingTimer_;
-    QDateTime dtNextPingTime_;
+
+    bool isPingAllowed() const;
+    void schedule(PingNodeInfo &pni, qint64 dueTime);
+    void scheduleNextPing(PingNodeInfo &pni, qint64 now);
+    void dropOutdatedItems();
+    void rescheduleTimer();
 };
 
 } //namespace locationsmodel
@@ -4,6 +4,7 @@
 #include <QIODevice>
 #include <QSettings>
 
+#include "engine/utils/cachefile.h"
 #include "utils/simplecrypt.h"
 #include "types/global_consts.h"
 
@@ -25,7 +26,8 @@ private:
     quint32 iteration_;
 };
 
-PingStorage::PingStorage(const QString &settingsKey) : settingsKey_(settingsKey)
+PingStorage::PingStorage(const QString &settingsKey, quint32 cacheSectionId)
+    : settingsKey_(settingsKey), cacheSectionId_(cacheSectionId)
 {
 }
 
@@ -33,11 +35,6 @@ PingStorage::~PingStorage()
 {
 }
 
-const QString& PingStorage::settingsKey() const
-{
-    return settingsKey_;
-}
-
 quint32 PingStorage::getCurrentIteration() const
 {
     return curIteration_;
@@ -53,8 +50,30 @@ void PingStorage::setCurrentIteration(quint32 iteration)
     curIteration_ = iteration;
 }
 
+QByteArray PingStorage::loadData() const
+{
+    SimpleCrypt simpleCrypt(SIMPLE_CRYPT_KEY);
+    const QByteArray data = CacheFile::instance().readSection(cacheSectionId_);
+    if (!data.isEmpty()) {
+        return simpleCrypt.decryptToByteArray(data);
+    }
 
-ApiPingStorage::ApiPingStorage() : PingStorage("pingStorage")
+    QSettings settings;
+    if (!settings.contains(settingsKey_)) {
+        return QByteArray();
+    }
+    return simpleCrypt.decryptToByteArray(settings.value(settingsKey_).toString());
+}
+
+void PingStorage::saveData(const QByteArray &data)
+{
+    // the value of the previous versions in QSettings is kept for a downgrade, like the "apiInfo" one
+    SimpleCrypt simpleCrypt(SIMPLE_CRYPT_KEY);
+    CacheFile::instance().writeSection(cacheSectionId_, simpleCrypt.encryptToByteArray(data));
+}
+
+
+ApiPingStorage::ApiPingStorage() : PingStorage("pingStorage", CacheFile::makeId("PING"))
 {
     loadFromSettings();
 }
@@ -105,24 +124,18 @@ void ApiPingStorage::saveToSettings()
         }
     }
 
-    QSettings settings;
-    SimpleCrypt simpleCrypt(SIMPLE_CRYPT_KEY);
-    settings.setValue(settingsKey(), simpleCrypt.encryptToString(arr));
+    saveData(arr);
 }
 
 void ApiPingStorage::loadFromSettings()
 {
     pingDataDB_.clear();
 
-    QSettings settings;
-    if (!settings.contains(settingsKey())) {
+    QByteArray arr = loadData();
+    if (arr.isEmpty()) {
         return;
     }
 
-    SimpleCrypt simpleCrypt(SIMPLE_CRYPT_KEY);
-    QString str = settings.value(settingsKey()).toString();
-    QByteArray arr = simpleCrypt.decryptToByteArray(str);
-
     QDataStream ds(&arr, QIODevice::ReadOnly);
     quint32 magic;
     ds >> magic;
@@ -159,7 +172,7 @@ void ApiPingStorage::loadFromSettings()
 }
 
 
-CustomConfigPingStorage::CustomConfigPingStorage() : PingStorage("pingStorageCustomConfigs")
+CustomConfigPingStorage::CustomConfigPingStorage() : PingStorage("pingStorageCustomConfigs", CacheFile::makeId("PNGC"))
 {
     loadFromSettings();
 }
@@ -198,24 +211,18 @@ void CustomConfigPingStorage::saveToSettings()
         }
     }
 
-    QSettings settings;
-    SimpleCrypt simpleCrypt(SIMPLE_CRYPT_KEY);
-    settings.setValue(settingsKey(), simpleCrypt.encryptToString(arr));
+    saveData(arr);
 }
 
 void CustomConfigPingStorage::loadFromSettings()
 {
     pingDataDB_.clear();
 
-    QSettings settings;
-    if (!settings.contains(settingsKey())) {
+    QByteArray arr = loadData();
+    if (arr.isEmpty()) {
         return;
     }
 
-    SimpleCrypt simpleCrypt(SIMPLE_CRYPT_KEY);
-    QString str = settings.value(settingsKey()).toString();
-    QByteArray arr = simpleCrypt.decryptToByteArray(str);
-
     QDataStream ds(&arr, QIODevice::ReadOnly);
     quint32 magic;
     ds >> magic;
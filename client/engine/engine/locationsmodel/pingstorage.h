@@ -11,18 +11,24 @@ class PingData;
 class PingStorage
 {
 public:
-    explicit PingStorage(const QString& settingsKey);
+    // the pings are kept in the cacheSectionId section of the cache file, the settingsKey value of the settings is
+    // where the previous versions saved them
+    explicit PingStorage(const QString& settingsKey, quint32 cacheSectionId);
     virtual ~PingStorage();
 
     quint32 getCurrentIteration() const;
     void incIteration();
 
 protected:
-    const QString& settingsKey() const;
     void setCurrentIteration(quint32 iteration);
 
+    // the serialized pings, empty if there are none
+    QByteArray loadData() const;
+    void saveData(const QByteArray &data);
+
 private:
     const QString settingsKey_;
+    const quint32 cacheSectionId_;
     quint32 curIteration_ = 0;
 };
 
@@ -0,0 +1,167 @@
+#include <QtTest>
+#include <QDateTime>
+
+#include "engine/locationsmodel/pingipscontroller.h"
+
+using locationsmodel::PingIpsController;
+using locationsmodel::PingIpInfo;
+
+class ConnectStateController_moc : public IConnectStateController
+{
+    Q_OBJECT
+public:
+    explicit ConnectStateController_moc(QObject *parent) : IConnectStateController(parent) {}
+
+    CONNECT_STATE currentState() override { return CONNECT_STATE_DISCONNECTED; }
+    CONNECT_STATE prevState() override { return CONNECT_STATE_DISCONNECTED; }
+    DISCONNECT_REASON disconnectReason() override { return DISCONNECTED_ITSELF; }
+    CONNECT_ERROR connectionError() override { return NO_CONNECT_ERROR; }
+    const LocationID& locationId() override { return lid_; }
+
+private:
+    LocationID lid_;
+};
+
+// Offline network, so the controller never starts the pings itself and the results are emitted by the test
+class NetworkDetectionManager_moc : public INetworkDetectionManager
+{
+    Q_OBJECT
+public:
+    explicit NetworkDetectionManager_moc(QObject *parent) : INetworkDetectionManager(parent) {}
+
+    void getCurrentNetworkInterface(types::NetworkInterface &networkInterface) override { networkInterface = types::NetworkInterface(); }
+    bool isOnline() override { return false; }
+};
+
+class TestPingIpsController : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void testPingInterval_data();
+    void testPingInterval();
+    void testSchedule();
+    void testNetworkChanged();
+
+private:
+    ConnectStateController_moc *connectStateController_ = nullptr;
+    NetworkDetectionManager_moc *networkDetectionManager_ = nullptr;
+    PingHost *pingHost_ = nullptr;
+    PingIpsController *controller_ = nullptr;
+
+    void pingFinished(const QString &id, int timems);
+};
+
+void TestPingIpsController::init()
+{
+    connectStateController_ = new ConnectStateController_moc(this);
+    networkDetectionManager_ = new NetworkDetectionManager_moc(this);
+    pingHost_ = new PingHost(this, connectStateController_, nullptr);
+    controller_ = new PingIpsController(this, connectStateController_, networkDetectionManager_, pingHost_, "ping_log_test.txt");
+}
+
+void TestPingIpsController::cleanup()
+{
+    delete controller_;
+    delete pingHost_;
+    delete networkDetectionManager_;
+    delete connectStateController_;
+}
+
+void TestPingIpsController::pingFinished(const QString &id, int timems)
+{
+    emit pingHost_->pingFinished(true, timems, id, true);
+}
+
+void TestPingIpsController::testPingInterval_data()
+{
+    QTest::addColumn<bool>("isPreferred");
+    QTest::addColumn<double>("latency");
+    QTest::addColumn<double>("jitter");
+    QTest::addColumn<qint64>("interval");
+
+    QTest::newRow("not pinged yet") << false << -1.0 << 0.0 << PingIpsController::NORMAL_PRIORITY_INTERVAL;
+    QTest::newRow("near") << false << 50.0 << 5.0 << PingIpsController::NORMAL_PRIORITY_INTERVAL;
+    QTest::newRow("far") << false << 200.0 << 10.0 << PingIpsController::LOW_PRIORITY_INTERVAL;
+    QTest::newRow("preferred") << true << 50.0 << 5.0 << PingIpsController::HIGH_PRIORITY_INTERVAL;
+    QTest::newRow("preferred far") << true << 300.0 << 10.0 << PingIpsController::HIGH_PRIORITY_INTERVAL;
+    QTest::newRow("near jittery") << false << 40.0 << 20.0 << PingIpsController::NORMAL_PRIORITY_INTERVAL / 2;
+    QTest::newRow("far jittery") << false << 400.0 << 150.0 << PingIpsController::LOW_PRIORITY_INTERVAL / 2;
+    QTest::newRow("preferred jittery") << true << 40.0 << 20.0 << PingIpsController::HIGH_PRIORITY_INTERVAL / 2;
+    QTest::newRow("jitter at the limit") << false << 40.0 << 10.0 << PingIpsController::NORMAL_PRIORITY_INTERVAL;
+}
+
+void TestPingIpsController::testPingInterval()
+{
+    QFETCH(bool, isPreferred);
+    QFETCH(double, latency);
+    QFETCH(double, jitter);
+    QFETCH(qint64, interval);
+
+    QCOMPARE(PingIpsController::pingInterval(isPreferred, latency, jitter), interval);
+}
+
+void TestPingIpsController::testSchedule()
+{
+    const qint64 before = QDateTime::currentMSecsSinceEpoch();
+    controller_->updateIps({ PingIpInfo("near", "10.0.0.1", "", "", "", PingHost::PING_TCP),
+                             PingIpInfo("far", "10.0.0.2", "", "", "", PingHost::PING_TCP),
+                             PingIpInfo("preferred", "10.0.0.3", "", "", "", PingHost::PING_TCP) });
+    controller_->setPreferredIds({ "preferred" });
+
+    // the new nodes are due right away
+    QVERIFY(controller_->dueTime("near") <= QDateTime::currentMSecsSinceEpoch());
+    QCOMPARE(controller_->dueTime("unknown"), -1);
+
+    pingFinished("near", 50);
+    pingFinished("far", 300);
+    pingFinished("preferred", 50);
+    const qint64 after = QDateTime::currentMSecsSinceEpoch();
+
+    // each interval is spread by +-10%
+    auto verifyDue = [&](const QString &id, qint64 interval) {
+        const qint64 due = controller_->dueTime(id);
+        QVERIFY2(due >= before + interval - interval / 10 && due <= after + interval + interval / 10, qPrintable(id));
+    };
+    verifyDue("near", PingIpsController::NORMAL_PRIORITY_INTERVAL);
+    verifyDue("far", PingIpsController::LOW_PRIORITY_INTERVAL);
+    verifyDue("preferred", PingIpsController::HIGH_PRIORITY_INTERVAL);
+}
+
+void TestPingIpsController::testNetworkChanged()
+{
+    controller_->updateIps({ PingIpInfo("near", "10.0.0.1", "", "", "", PingHost::PING_TCP),
+                             PingIpInfo("far", "10.0.0.2", "", "", "", PingHost::PING_TCP),
+                             PingIpInfo("preferred", "10.0.0.3", "", "", "", PingHost::PING_TCP) });
+    controller_->setPreferredIds({ "preferred" });
+    pingFinished("near", 50);
+    pingFinished("far", 300);
+    pingFinished("preferred", 50);
+    const qint64 nearDue = controller_->dueTime("near");
+    const qint64 farDue = controller_->dueTime("far");
+    QVERIFY(farDue > QDateTime::currentMSecsSinceEpoch() + PingIpsController::LOW_PRIORITY_INTERVAL / 2);
+
+    const qint64 before = QDateTime::currentMSecsSinceEpoch();
+    emit networkDetectionManager_->networkChanged(types::NetworkInterface());
+    const qint64 after = QDateTime::currentMSecsSinceEpoch();
+
+    // only the preferred node is re-pinged soon, the rest keep their due times
+    const qint64 preferredDue = controller_->dueTime("preferred");
+    QVERIFY(preferredDue >= before && preferredDue <= after + PingIpsController::NETWORK_CHANGE_SPREAD);
+    QCOMPARE(controller_->dueTime("near"), nearDue);
+    QCOMPARE(controller_->dueTime("far"), farDue);
+
+    // the latency measured before the change is stale, so a far node measured as near on the new network
+    // gets the normal interval and not an average with the old latency
+    QSignalSpy spy(controller_, &PingIpsController::pingInfoChanged);
+    pingFinished("far", 40);
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(1).toInt(), 40);
+    QVERIFY(controller_->dueTime("far") < QDateTime::currentMSecsSinceEpoch() + PingIpsController::NORMAL_PRIORITY_INTERVAL * 2);
+}
+
+QTEST_MAIN(TestPingIpsController)
+#include "pingipscontroller.test.moc"
@@ -2,7 +2,7 @@
 #include <QFile>
 #include "utils/logger.h"
 
-CertManager::CertManager()
+CertManager::CertManager() : x509Store_(nullptr)
 {
     // load certificates from bundle
     {
@@ -33,6 +33,8 @@ CertManager::CertManager()
             qCDebug(LOG_BASIC) << "can't load SSL certificates from resources";
         }
     }
+
+    buildX509Store();
 }
 
 CertManager::~CertManager()
@@ -50,6 +52,11 @@ X509 *CertManager::getCert(int ind)
     return certs_[ind].cert;
 }
 
+X509_STORE *CertManager::x509Store()
+{
+    return x509Store_;
+}
+
 void CertManager::parseCertsBundle(QByteArray &arr)
 {
     QString s = arr;
@@ -91,8 +98,27 @@ CertManager::CertDescr CertManager::loadCert(const QString &data)
     return cd;
 }
 
+void CertManager::buildX509Store()
+{
+    if (x509Store_)
+        X509_STORE_free(x509Store_);
+
+    x509Store_ = X509_STORE_new();
+    for (int i = 0; i < certs_.count(); ++i)
+    {
+        if (certs_[i].cert)
+            X509_STORE_add_cert(x509Store_, certs_[i].cert);
+    }
+}
+
 void CertManager::cleanCerts()
 {
+    if (x509Store_)
+    {
+        X509_STORE_free(x509Store_);
+        x509Store_ = nullptr;
+    }
+
     for (int i = 0; i < certs_.count(); ++i)
     {
         X509_free(certs_[i].cert);
@@ -15,6 +15,10 @@ public:
     int count();
     X509 *getCert(int ind);
 
+    // Trust store with all the certificates, built once and shared between all TLS contexts.
+    // Use SSL_CTX_set1_cert_store() to attach it, so that the SSL_CTX takes its own reference.
+    X509_STORE *x509Store();
+
 private:
     struct CertDescr
     {
@@ -24,9 +28,11 @@ private:
 
     void parseCertsBundle(QByteArray &arr);
     CertDescr loadCert(const QString &data);
+    void buildX509Store();
     void cleanCerts();
 
     QVector<CertDescr> certs_;
+    X509_STORE *x509Store_;
 };
 
 #endif // CERTMANAGER_H
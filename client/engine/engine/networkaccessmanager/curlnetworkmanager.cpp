@@ -78,9 +78,7 @@ void CurlNetworkManager::onRequestProgress(quint64 requestId, qint64 bytesReceiv
 void CurlNetworkManager::onRequestNewData(quint64 requestId, const QByteArray &newData)
 {
     auto it = activeRequests_.find(requestId);
-    if (it != activeRequests_.end()) {
-        it.value()->appendNewData(newData);
-        emit it.value()->readyRead();
-    }
+    if (it != activeRequests_.end())
+        it.value()->appendNewData(newData);     // emits readyRead
 }
 
@@ -11,8 +11,15 @@
 
 CurlNetworkManagerImpl *g_this = nullptr;
 
+namespace {
+// initial capacity of the pending data buffer, enough to hold several curl chunks (CURL_MAX_WRITE_SIZE is 16K)
+const int kPendingDataReserveSize = 64 * 1024;
+}
+
 CurlNetworkManagerImpl::CurlNetworkManagerImpl(QObject *parent) : QThread(parent),
-    bNeedFinish_(false)
+    isProcessCommandsPending_(true),
+    threadContext_(nullptr),
+    multiTimer_(nullptr)
   #if defined(Q_OS_MAC)
     , certPath_(QCoreApplication::applicationDirPath() + "/../resources/cert.pem")
   #elif defined (Q_OS_LINUX)
@@ -28,6 +35,25 @@ CurlNetworkManagerImpl::CurlNetworkManagerImpl(QObject *parent) : QThread(parent
 #endif
 
     multiHandle_ = curl_multi_init();
+    // allow several requests to the same host to be multiplexed over one HTTP/2 connection
+    curl_multi_setopt(multiHandle_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(multiHandle_, CURLMOPT_MAXCONNECTS, 16L);
+    curl_multi_setopt(multiHandle_, CURLMOPT_SOCKETFUNCTION, socketCallback);
+    curl_multi_setopt(multiHandle_, CURLMOPT_SOCKETDATA, this);
+    curl_multi_setopt(multiHandle_, CURLMOPT_TIMERFUNCTION, timerCallback);
+    curl_multi_setopt(multiHandle_, CURLMOPT_TIMERDATA, this);
+
+    shareHandle_ = curl_share_init();
+    curl_share_setopt(shareHandle_, CURLSHOPT_LOCKFUNC, shareLockCallback);
+    curl_share_setopt(shareHandle_, CURLSHOPT_UNLOCKFUNC, shareUnlockCallback);
+    curl_share_setopt(shareHandle_, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(shareHandle_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(shareHandle_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    curl_share_setopt(shareHandle_, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+
+    const curl_version_info_data *versionInfo = curl_version_info(CURLVERSION_NOW);
+    isHttp2Supported_ = versionInfo && (versionInfo->features & CURL_VERSION_HTTP2);
+
     nextId_ = 0;
     g_this = this;
     start(LowPriority);
@@ -35,30 +61,42 @@ CurlNetworkManagerImpl::CurlNetworkManagerImpl(QObject *parent) : QThread(parent
 
 CurlNetworkManagerImpl::~CurlNetworkManagerImpl()
 {
-    {
-        QMutexLocker locker(&mutex_);
-        bNeedFinish_ = true;
-        waitCondition_.wakeAll();
-    }
-    curl_multi_wakeup(multiHandle_);
+    quit();
     wait();
-    curl_multi_cleanup(multiHandle_);
 }
 
 size_t CurlNetworkManagerImpl::writeDataCallback(void *ptr, size_t size, size_t count, void *ri)
 {
     RequestInfo *requestInfo = static_cast<RequestInfo *>(ri);
-    QByteArray arr;
-    arr.append((char*)ptr, size*count);
-    emit g_this->requestNewData(requestInfo->id, arr);
-    return size*count;
+    const qint64 bytes = size*count;
+
+    if (requestInfo->outputFile) {
+        // returning less than passed aborts the transfer with CURLE_WRITE_ERROR
+        return requestInfo->outputFile->write((const char *)ptr, bytes) == bytes ? bytes : 0;
+    }
+
+    if (requestInfo->pendingData.isEmpty())
+        requestInfo->pendingData.reserve(qMax<qint64>(kPendingDataReserveSize, bytes));
+    requestInfo->pendingData.append((const char *)ptr, bytes);
+    if (!requestInfo->isPendingNotify) {
+        requestInfo->isPendingNotify = true;
+        g_this->requestsWithPendingNotify_ << requestInfo->id;
+    }
+    return bytes;
 }
 
 int CurlNetworkManagerImpl::progressCallback(void *ri,   curl_off_t dltotal,   curl_off_t dlnow,   curl_off_t ultotal,   curl_off_t ulnow)
 {
     RequestInfo *requestInfo = static_cast<RequestInfo *>(ri);
-    if (dltotal > 0)
-        emit g_this->requestProgress(requestInfo->id, dlnow, dltotal);
+    if (dltotal > 0 && (dlnow != requestInfo->progressNow || dltotal != requestInfo->progressTotal)) {
+        requestInfo->progressNow = dlnow;
+        requestInfo->progressTotal = dltotal;
+        requestInfo->isProgressChanged = true;
+        if (!requestInfo->isPendingNotify) {
+            requestInfo->isPendingNotify = true;
+            g_this->requestsWithPendingNotify_ << requestInfo->id;
+        }
+    }
     return 0;
 }
 
@@ -67,11 +105,27 @@ bool CurlNetworkManagerImpl::setupBasicOptions(RequestInfo *requestInfo, const N
     if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_WRITEFUNCTION, writeDataCallback) != CURLE_OK) return false;
     if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_WRITEDATA, requestInfo) != CURLE_OK) return false;
     if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_ACCEPT_ENCODING, "") != CURLE_OK) return false;
+    // the larger the buffer, the fewer write callbacks for big responses
+    if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_BUFFERSIZE, 256L * 1024) != CURLE_OK) return false;
     if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_URL, request.url().toString().toStdString().c_str()) != CURLE_OK) return false;
 
-    if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_FRESH_CONNECT, 1) != CURLE_OK) return false;
     if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_CONNECTTIMEOUT_MS , request.timeout()) != CURLE_OK) return false;
 
+    // A pooled connection is matched by host name, not by IP. So requests to an explicitly specified IP and ECH requests
+    // always use their own connection, so as not to get a connection established by some other request.
+    if (request.isUseFreshConnection() || !request.overrideIp().isEmpty() || !request.echConfig().isEmpty()) {
+        if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_FRESH_CONNECT, 1) != CURLE_OK) return false;
+        if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_FORBID_REUSE, 1) != CURLE_OK) return false;
+    } else {
+        if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_SHARE, shareHandle_) != CURLE_OK) return false;
+        if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_TCP_KEEPALIVE, 1L) != CURLE_OK) return false;
+        if (isHttp2Supported_) {
+            if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS) != CURLE_OK) return false;
+            // prefer to wait for an existing connection to confirm multiplexing rather than opening a new one
+            if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_PIPEWAIT, 1L) != CURLE_OK) return false;
+        }
+    }
+
     if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_XFERINFOFUNCTION, progressCallback) != CURLE_OK) return false;
     if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_XFERINFODATA, requestInfo) != CURLE_OK) return false;
     if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_NOPROGRESS, 0) != CURLE_OK) return false;
@@ -93,6 +147,8 @@ bool CurlNetworkManagerImpl::setupBasicOptions(RequestInfo *requestInfo, const N
             return false;
     }
 
+    requestInfo->outputFilePath = request.outputFilePath();
+
     curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_PRIVATE, new quint64(requestInfo->id));    // our user data, must be deleted in the RequestInfo destructor
     return true;
 }
@@ -101,18 +157,31 @@ CURLcode CurlNetworkManagerImpl::sslctx_function(CURL *curl, void *sslctx, void
 {
     Q_UNUSED(curl);
 
-    X509_STORE *store = X509_STORE_new();
-    SSL_CTX_set_cert_store((SSL_CTX *)sslctx, store);
-
+    // the store is built once in the CertManager, here we only add a reference to it
     CertManager *certManager = static_cast<CertManager *>(parm);
-    for (int i = 0; i < certManager->count(); ++i)
-    {
-        X509_STORE_add_cert(store, certManager->getCert(i));
-    }
+    X509_STORE *store = certManager->x509Store();
+    if (store == nullptr)
+        return CURLE_SSL_CACERT_BADFILE;
+    SSL_CTX_set1_cert_store((SSL_CTX *)sslctx, store);
 
     return CURLE_OK;
 }
 
+void CurlNetworkManagerImpl::shareLockCallback(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr)
+{
+    Q_UNUSED(handle);
+    Q_UNUSED(access);
+    CurlNetworkManagerImpl *this_ = static_cast<CurlNetworkManagerImpl *>(userptr);
+    this_->shareLocks_[data].lock();
+}
+
+void CurlNetworkManagerImpl::shareUnlockCallback(CURL *handle, curl_lock_data data, void *userptr)
+{
+    Q_UNUSED(handle);
+    CurlNetworkManagerImpl *this_ = static_cast<CurlNetworkManagerImpl *>(userptr);
+    this_->shareLocks_[data].unlock();
+}
+
 quint64 CurlNetworkManagerImpl::get(const NetworkRequest &request, const QStringList &ips, const types::ProxySettings &proxySettings /*= types::ProxySettings()*/)
 {
     RequestInfo *requestInfo = new RequestInfo();
@@ -122,11 +191,7 @@ quint64 CurlNetworkManagerImpl::get(const NetworkRequest &request, const QString
 
     if (requestInfo->curlEasyHandle)  {
         if (setupBasicOptions(requestInfo, request, ips, proxySettings)) {
-            QMutexLocker locker(&mutex_);
-            activeRequests_[id] = requestInfo;
-            waitCondition_.wakeAll();
-            curl_multi_wakeup(multiHandle_);
-            return id;
+            return submitRequest(requestInfo);
         }
     }
 
@@ -149,11 +214,7 @@ quint64 CurlNetworkManagerImpl::post(const NetworkRequest &request, const QByteA
             // set additional post request options
             if ((curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_POSTFIELDSIZE, data.size()) == CURLE_OK) &&
                (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_COPYPOSTFIELDS, data.data()) == CURLE_OK)) {
-                QMutexLocker locker(&mutex_);
-                activeRequests_[id] = requestInfo;
-                waitCondition_.wakeAll();
-                curl_multi_wakeup(multiHandle_);
-                return id;
+                return submitRequest(requestInfo);
             }
         }
     }
@@ -177,11 +238,7 @@ quint64 CurlNetworkManagerImpl::put(const NetworkRequest &request, const QByteAr
             if ((curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_POSTFIELDSIZE, data.size()) == CURLE_OK) &&
                (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_COPYPOSTFIELDS, data.data()) == CURLE_OK) &&
                (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_CUSTOMREQUEST, "PUT") == CURLE_OK)) {
-                QMutexLocker locker(&mutex_);
-                activeRequests_[id] = requestInfo;
-                waitCondition_.wakeAll();
-                curl_multi_wakeup(multiHandle_);
-                return id;
+                return submitRequest(requestInfo);
             }
         }
     }
@@ -203,11 +260,7 @@ quint64 CurlNetworkManagerImpl::deleteResource(const NetworkRequest &request, co
         if (setupBasicOptions(requestInfo, request, ips, proxySettings)) {
             // set additional delete request options
             if (curl_easy_setopt(requestInfo->curlEasyHandle, CURLOPT_CUSTOMREQUEST, "DELETE") == CURLE_OK) {
-                QMutexLocker locker(&mutex_);
-                activeRequests_[id] = requestInfo;
-                waitCondition_.wakeAll();
-                curl_multi_wakeup(multiHandle_);
-                return id;
+                return submitRequest(requestInfo);
             }
         }
     }
@@ -220,11 +273,7 @@ quint64 CurlNetworkManagerImpl::deleteResource(const NetworkRequest &request, co
 
 void CurlNetworkManagerImpl::abort(quint64 replyId)
 {
-    QMutexLocker locker(&mutex_);
-    auto it = activeRequests_.find(replyId);
-    if (it != activeRequests_.end()) {
-        it.value()->isNeedRemoveFromMultiHandle = true;
-    }
+    pushCommand(Command { Command::ABORT_REQUEST, replyId, nullptr });
 }
 
 void CurlNetworkManagerImpl::run()
@@ -235,82 +284,235 @@ void CurlNetworkManagerImpl::run()
     logFile_ = fopen(logFilePath_.toStdString().c_str(), "w+");
 #endif
 
-    while (!bNeedFinish_) {
+    QObject threadContext;
+    multiTimer_ = new QTimer(&threadContext);
+    multiTimer_->setSingleShot(true);
+    connect(multiTimer_, &QTimer::timeout, &threadContext, [this]() { onMultiTimeout(); });
 
-        {
-            QMutexLocker locker(&mutex_);
-            while (activeRequests_.isEmpty() && !bNeedFinish_)
-                waitCondition_.wait(&mutex_);
-        }
+    // from now on the producers can schedule processCommands() in this thread,
+    // process the commands which could have been pushed before the thread started
+    threadContext_ = &threadContext;
+    isProcessCommandsPending_ = false;
+    processCommands();
 
-        if (bNeedFinish_)
-            break;
+    exec();
 
-        {
-            QMutexLocker locker(&mutex_);
-            // add curl handles for requests which have not been added
-            for (auto it = activeRequests_.begin(); it != activeRequests_.end(); ++it) {
-                if (!it.value()->isAddedToMultiHandle) {
-                    curl_multi_add_handle(multiHandle_, it.value()->curlEasyHandle);
-                    it.value()->isAddedToMultiHandle = true;
-                }
-            }
+    threadContext_ = nullptr;
+
+    for (auto it = activeRequests_.begin(); it != activeRequests_.end(); ++it) {
+        if (it.value()->isAddedToMultiHandle)
+            curl_multi_remove_handle(multiHandle_, it.value()->curlEasyHandle);
+        delete it.value();
+    }
+    activeRequests_.clear();
+
+    // the requests which were not taken into work
+    commands_.popAll([](Command &&command) {
+        if (command.type == Command::ADD_REQUEST)
+            delete command.requestInfo;
+    });
+
+    // cleanup here, since closing the cached connections calls socketCallback, which deals with the socket notifiers of this thread
+    curl_multi_cleanup(multiHandle_);
+    curl_share_cleanup(shareHandle_);
+    multiTimer_ = nullptr;
+
+#ifdef MAKE_CURL_LOG_FILE
+    fclose(logFile_);
+#endif
+}
+
+quint64 CurlNetworkManagerImpl::submitRequest(RequestInfo *requestInfo)
+{
+    quint64 id = requestInfo->id;
+    pushCommand(Command { Command::ADD_REQUEST, id, requestInfo });
+    return id;
+}
 
-            // check for need to be deleted requests (for cases when the function abort() was called)
-            for (auto it = activeRequests_.begin(); it != activeRequests_.end(); /*++it*/) {  // should not increment it in the for loop
-                if (it.value()->isNeedRemoveFromMultiHandle) {
-                    RequestInfo *ri = it.value();
-                    if (it.value()->isAddedToMultiHandle)
-                        curl_multi_remove_handle(multiHandle_, ri->curlEasyHandle);
-                    it = activeRequests_.erase(it);
+void CurlNetworkManagerImpl::pushCommand(const Command &command)
+{
+    commands_.push(command);
+    // schedule processing only once for a series of commands
+    if (!isProcessCommandsPending_.exchange(true)) {
+        QObject *context = threadContext_;
+        if (context)
+            QMetaObject::invokeMethod(context, [this]() { processCommands(); }, Qt::QueuedConnection);
+    }
+}
+
+void CurlNetworkManagerImpl::processCommands()
+{
+    // reset the flag before taking the commands, so that a command pushed after popAll schedules a new call
+    isProcessCommandsPending_ = false;
+
+    commands_.popAll([this](Command &&command) {
+        if (command.type == Command::ADD_REQUEST) {
+            RequestInfo *ri = command.requestInfo;
+            if (!ri->outputFilePath.isEmpty()) {
+                ri->outputFile.reset(new QFile(ri->outputFilePath));
+                if (!ri->outputFile->open(QIODevice::WriteOnly)) {
+                    qCDebug(LOG_NETWORK) << "Can't open the output file for the request:" << ri->outputFilePath;
+                    emit requestFinished(ri->id, CURLE_WRITE_ERROR, 0);
                     delete ri;
-                } else {
-                    ++it;
+                    return;
                 }
             }
+            activeRequests_[ri->id] = ri;
+            // the multi handle calls timerCallback, the transfer will be started from onMultiTimeout()
+            if (curl_multi_add_handle(multiHandle_, ri->curlEasyHandle) == CURLM_OK) {
+                ri->isAddedToMultiHandle = true;
+            } else {
+                activeRequests_.remove(ri->id);
+                emit requestFinished(ri->id, CURLE_FAILED_INIT, 0);
+                delete ri;
+            }
+        } else if (command.type == Command::ABORT_REQUEST) {
+            auto it = activeRequests_.find(command.id);
+            if (it != activeRequests_.end()) {
+                RequestInfo *ri = it.value();
+                activeRequests_.erase(it);
+                removeRequest(ri);
+            }
+        }
+    });
+}
 
-            int still_running;
-            curl_multi_perform(multiHandle_, &still_running);
-            // check finished requests
-            struct CURLMsg *curlMsg = nullptr;
-            do {
-              int msgq = 0;
-              curlMsg = curl_multi_info_read(multiHandle_, &msgq);
-              if (curlMsg && (curlMsg->msg == CURLMSG_DONE)) {
-                  CURL *curlEasyHandle = curlMsg->easy_handle;
-                  quint64 *pointerId;
-                  curl_easy_getinfo(curlEasyHandle, CURLINFO_PRIVATE, &pointerId);
-                  WS_ASSERT(pointerId != nullptr);
-
-                  curl_off_t totalTime;
-                  curl_easy_getinfo(curlEasyHandle, CURLINFO_TOTAL_TIME_T, &totalTime);
-
-                  quint64 id = *pointerId;
-                  auto it = activeRequests_.find(id);
-                  WS_ASSERT(it != activeRequests_.end());
-                  WS_ASSERT(it.value()->curlEasyHandle == curlEasyHandle);
-                  emit requestFinished(id, curlMsg->data.result, totalTime / 1000); // convert total time to ms
-
-                  //remove request from activeRequests
-                  curl_multi_remove_handle(multiHandle_, curlEasyHandle);
-                  delete it.value();
-                  activeRequests_.remove(id);
-              }
-            } while(curlMsg);
+int CurlNetworkManagerImpl::socketCallback(CURL *easy, curl_socket_t socket, int what, void *userp, void *socketp)
+{
+    Q_UNUSED(easy);
+    CurlNetworkManagerImpl *this_ = static_cast<CurlNetworkManagerImpl *>(userp);
+    SocketInfo *socketInfo = static_cast<SocketInfo *>(socketp);
+
+    if (what == CURL_POLL_REMOVE) {
+        if (socketInfo) {
+            // the notifiers can be in the middle of emitting the activated signal, so delete them later
+            for (QSocketNotifier *notifier : { socketInfo->readNotifier, socketInfo->writeNotifier }) {
+                if (notifier) {
+                    notifier->setEnabled(false);
+                    notifier->deleteLater();
+                }
+            }
+            delete socketInfo;
         }
+        return 0;
+    }
 
-        // wait for activity or timeout
-        int numfds;
-        curl_multi_poll(multiHandle_, NULL, 0, 1000, &numfds);
+    if (!socketInfo) {
+        socketInfo = new SocketInfo();
+        curl_multi_assign(this_->multiHandle_, socket, socketInfo);
     }
 
-    for (auto it = activeRequests_.begin(); it != activeRequests_.end(); ++it)
-        delete it.value();
-    activeRequests_.clear();
+    const bool isWantRead = (what == CURL_POLL_IN || what == CURL_POLL_INOUT);
+    const bool isWantWrite = (what == CURL_POLL_OUT || what == CURL_POLL_INOUT);
 
-#ifdef MAKE_CURL_LOG_FILE
-    fclose(logFile_);
-#endif
+    if (isWantRead && !socketInfo->readNotifier) {
+        socketInfo->readNotifier = new QSocketNotifier(socket, QSocketNotifier::Read);
+        connect(socketInfo->readNotifier, &QSocketNotifier::activated, socketInfo->readNotifier, [this_, socket]() {
+            this_->onSocketActivated(socket, CURL_CSELECT_IN);
+        });
+    }
+    if (isWantWrite && !socketInfo->writeNotifier) {
+        socketInfo->writeNotifier = new QSocketNotifier(socket, QSocketNotifier::Write);
+        connect(socketInfo->writeNotifier, &QSocketNotifier::activated, socketInfo->writeNotifier, [this_, socket]() {
+            this_->onSocketActivated(socket, CURL_CSELECT_OUT);
+        });
+    }
+    if (socketInfo->readNotifier)
+        socketInfo->readNotifier->setEnabled(isWantRead);
+    if (socketInfo->writeNotifier)
+        socketInfo->writeNotifier->setEnabled(isWantWrite);
+
+    return 0;
+}
+
+int CurlNetworkManagerImpl::timerCallback(CURLM *multi, long timeoutMs, void *userp)
+{
+    Q_UNUSED(multi);
+    CurlNetworkManagerImpl *this_ = static_cast<CurlNetworkManagerImpl *>(userp);
+    if (!this_->multiTimer_)
+        return 0;
+    if (timeoutMs < 0)
+        this_->multiTimer_->stop();
+    else
+        this_->multiTimer_->start(timeoutMs);
+    return 0;
+}
+
+void CurlNetworkManagerImpl::onSocketActivated(curl_socket_t socket, int evBitmask)
+{
+    int runningHandles;
+    curl_multi_socket_action(multiHandle_, socket, evBitmask, &runningHandles);
+    checkFinishedRequests();
+}
+
+void CurlNetworkManagerImpl::onMultiTimeout()
+{
+    int runningHandles;
+    curl_multi_socket_action(multiHandle_, CURL_SOCKET_TIMEOUT, 0, &runningHandles);
+    checkFinishedRequests();
+}
+
+void CurlNetworkManagerImpl::checkFinishedRequests()
+{
+    // the data must be delivered before the finished signal
+    flushPendingData();
+
+    struct CURLMsg *curlMsg = nullptr;
+    do {
+        int msgq = 0;
+        curlMsg = curl_multi_info_read(multiHandle_, &msgq);
+        if (curlMsg && (curlMsg->msg == CURLMSG_DONE)) {
+            CURL *curlEasyHandle = curlMsg->easy_handle;
+            quint64 *pointerId;
+            curl_easy_getinfo(curlEasyHandle, CURLINFO_PRIVATE, &pointerId);
+            WS_ASSERT(pointerId != nullptr);
+
+            curl_off_t totalTime;
+            curl_easy_getinfo(curlEasyHandle, CURLINFO_TOTAL_TIME_T, &totalTime);
+
+            quint64 id = *pointerId;
+            auto it = activeRequests_.find(id);
+            WS_ASSERT(it != activeRequests_.end());
+            WS_ASSERT(it.value()->curlEasyHandle == curlEasyHandle);
+            // the file must be complete when the finished signal is received
+            if (it.value()->outputFile)
+                it.value()->outputFile->close();
+            emit requestFinished(id, curlMsg->data.result, totalTime / 1000); // convert total time to ms
+
+            //remove request from activeRequests
+            RequestInfo *ri = it.value();
+            activeRequests_.erase(it);
+            removeRequest(ri);
+        }
+    } while(curlMsg);
+}
+
+void CurlNetworkManagerImpl::flushPendingData()
+{
+    for (quint64 id : qAsConst(requestsWithPendingNotify_)) {
+        auto it = activeRequests_.find(id);
+        if (it == activeRequests_.end())
+            continue;
+        RequestInfo *ri = it.value();
+        ri->isPendingNotify = false;
+        if (!ri->pendingData.isEmpty()) {
+            emit requestNewData(id, ri->pendingData);
+            // the emitted array keeps the buffer, here just detach from it
+            ri->pendingData = QByteArray();
+        }
+        if (ri->isProgressChanged) {
+            ri->isProgressChanged = false;
+            emit requestProgress(id, ri->progressNow, ri->progressTotal);
+        }
+    }
+    requestsWithPendingNotify_.clear();
+}
+
+void CurlNetworkManagerImpl::removeRequest(RequestInfo *requestInfo)
+{
+    if (requestInfo->isAddedToMultiHandle)
+        curl_multi_remove_handle(multiHandle_, requestInfo->curlEasyHandle);
+    delete requestInfo;
 }
 
 bool CurlNetworkManagerImpl::setupResolveHosts(RequestInfo *requestInfo, const NetworkRequest &request, const QStringList &ips)
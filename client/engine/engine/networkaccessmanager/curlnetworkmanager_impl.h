@@ -1,8 +1,11 @@
 #pragma once
 
+#include <QFile>
 #include <QMutex>
+#include <QScopedPointer>
+#include <QSocketNotifier>
 #include <QThread>
-#include <QWaitCondition>
+#include <QTimer>
 
 #include <curl/curl.h>
 
@@ -10,12 +13,15 @@
 #include "curlinitcontroller.h"
 #include "networkrequest.h"
 #include "types/proxysettings.h"
+#include "utils/mpscqueue.h"
 
 
 // comment, if no need log file from curl
 //#define MAKE_CURL_LOG_FILE      1
 
 // Implementing queries with curl library. Don't use it directly, use NetworkAccessManager instead.
+// get/post/put/deleteResource/abort only push a command to a lock-free queue, all curl work is done in the own thread,
+// which runs a Qt event loop driven by curl_multi_socket_action (socket notifiers and a timer set by curl callbacks).
 class CurlNetworkManagerImpl : public QThread
 {
     Q_OBJECT
@@ -43,9 +49,6 @@ signals:
 private:
     CurlInitController curlInit_;
     CertManager certManager_;
-    std::atomic<bool> bNeedFinish_;
-    QMutex mutex_;
-    QWaitCondition waitCondition_;
     std::atomic<quint64> nextId_;
 
 #if defined(Q_OS_MAC) || defined (Q_OS_LINUX)
@@ -62,7 +65,18 @@ private:
         CURL *curlEasyHandle = nullptr;
         QVector<struct curl_slist *> curlLists;
         bool isAddedToMultiHandle = false;
-        bool isNeedRemoveFromMultiHandle = false;
+
+        // Data received since the last flush. It is handed over to the CurlNetworkManager as a whole (implicitly shared,
+        // without copying) once per event loop iteration, instead of a separate QByteArray and signal for each curl chunk.
+        QByteArray pendingData;
+        bool isPendingNotify = false;
+        curl_off_t progressNow = 0;
+        curl_off_t progressTotal = 0;
+        bool isProgressChanged = false;
+
+        // if set, the response body is written directly to this file instead of being passed to the reply
+        QString outputFilePath;
+        QScopedPointer<QFile> outputFile;
 
         // free all curl handles and data
         ~RequestInfo() {
@@ -78,8 +92,48 @@ private:
         }
     };
 
+    // commands from the producer threads to the curl thread
+    struct Command {
+        enum TYPE { ADD_REQUEST, ABORT_REQUEST };
+        TYPE type;
+        quint64 id;
+        RequestInfo *requestInfo;   // only for ADD_REQUEST
+    };
+    wsl::MpscQueue<Command> commands_;
+    // true if a call of processCommands() has been already scheduled in the curl thread (or the thread is not running yet)
+    std::atomic<bool> isProcessCommandsPending_;
+    // the object living in the curl thread, used as a context for queued calls, nullptr if the thread is not running
+    std::atomic<QObject *> threadContext_;
+
+    // sockets watched for curl, owned and accessed only from the curl thread
+    struct SocketInfo {
+        QSocketNotifier *readNotifier = nullptr;
+        QSocketNotifier *writeNotifier = nullptr;
+    };
+
+    // accessed only from the curl thread
     CURLM *multiHandle_;
     QHash<quint64, RequestInfo *> activeRequests_;
+    QTimer *multiTimer_;
+    // requests that have received data or progress since the last flushPendingData()
+    QVector<quint64> requestsWithPendingNotify_;
+
+    // DNS entries, TLS sessions and connections shared between all requests, so that requests
+    // to the same host reuse an existing connection instead of doing a new TCP/TLS handshake
+    CURLSH *shareHandle_;
+    QMutex shareLocks_[CURL_LOCK_DATA_LAST];
+    bool isHttp2Supported_;
+
+    quint64 submitRequest(RequestInfo *requestInfo);
+    void pushCommand(const Command &command);
+
+    // functions called in the curl thread
+    void processCommands();
+    void onSocketActivated(curl_socket_t socket, int evBitmask);
+    void onMultiTimeout();
+    void checkFinishedRequests();
+    void flushPendingData();
+    void removeRequest(RequestInfo *requestInfo);
 
     bool setupBasicOptions(RequestInfo *requestInfo, const NetworkRequest &request, const QStringList &ips, const types::ProxySettings &proxySettings);
     bool setupResolveHosts(RequestInfo *requestInfo, const NetworkRequest &request, const QStringList &ips);
@@ -87,6 +141,10 @@ private:
     bool setupProxy(RequestInfo *requestInfo, const types::ProxySettings &proxySettings);
 
     static CURLcode sslctx_function(CURL *curl, void *sslctx, void *parm);
+    static void shareLockCallback(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr);
+    static void shareUnlockCallback(CURL *handle, curl_lock_data data, void *userptr);
+    static int socketCallback(CURL *easy, curl_socket_t socket, int what, void *userp, void *socketp);
+    static int timerCallback(CURLM *multi, long timeoutMs, void *userp);
     static size_t writeDataCallback(void *ptr, size_t size, size_t count, void *ri);
     static int progressCallback(void *ri,   curl_off_t dltotal,   curl_off_t dlnow,   curl_off_t ultotal,   curl_off_t ulnow);
 };
@@ -11,7 +11,15 @@ CurlReply::CurlReply(CurlNetworkManager *manager, quint64 id)
 void CurlReply::appendNewData(const QByteArray &newData)
 {
     QMutexLocker locker(&mutex_);
-    data_.append(newData);
+    // the reader usually takes all data with readAll(), so the array of the curl thread is shared without a copy
+    if (data_.isEmpty())
+    {
+        data_ = newData;
+    }
+    else
+    {
+        data_.append(newData);
+    }
     emit readyRead();
 }
 
@@ -1,15 +1,13 @@
 #include "dnscache.h"
-#include <QDateTime>
-#include <QTimer>
 #include "utils/ws_assert.h"
 #include "engine/dnsresolver/dnsrequest.h"
 
-DnsCache::DnsCache(QObject *parent, int cacheTimeoutMs /*= 60000*/, int reviewCacheIntervalMs /*= 1000*/) : QObject(parent),
-    cacheTimeoutMs_(cacheTimeoutMs)
+DnsCache::DnsCache(QObject *parent, int maxTtlMs /*= 60000*/, int negativeTtlMs /*= 5000*/) : QObject(parent),
+    maxTtlMs_(maxTtlMs), negativeTtlMs_(negativeTtlMs)
 {
-    QTimer *timer = new QTimer(this);
-    connect(timer, SIGNAL(timeout()), SLOT(onTimer()));
-    timer->start(reviewCacheIntervalMs);
+    clock_.start();
+    timer_.setSingleShot(true);
+    connect(&timer_, &QTimer::timeout, this, &DnsCache::onTimer);
 }
 
 DnsCache::~DnsCache()
@@ -19,48 +17,141 @@ DnsCache::~DnsCache()
 void DnsCache::resolve(const QString &hostname, quint64 id, bool bypassCache /*= false*/, const QStringList &dnsServers /*= QStringList()*/, int timeoutMs /*= 5000*/)
 {
     if (!bypassCache) {
+        const qint64 now = clock_.elapsed();
         auto it = cache_.find(hostname);
-        if (it != cache_.end()) {
-            emit resolved(true, it.value().ips, id, true, 0);
+        if (it != cache_.end() && it->expireTime > now) {
+            it->isUsedSinceUpdate = true;
+            // the entry is about to expire, answer from the cache and refresh it in the background
+            if (now >= it->refreshTime)
+                startLookup(hostname, it->dnsServers, it->timeoutMs, 0, false);
+            emit resolved(true, it->ips, id, true, 0);
+            return;
+        }
+
+        auto itNegative = negativeCache_.find(lookupKey(hostname, dnsServers));
+        if (itNegative != negativeCache_.end() && itNegative->expireTime > now) {
+            emit resolved(false, QStringList(), id, true, 0);
             return;
         }
     }
 
-    DnsRequest *dnsRequest = new DnsRequest(this, hostname, dnsServers, timeoutMs);
-    dnsRequest->setProperty("requestId", id);
-    connect(dnsRequest, SIGNAL(finished()), SLOT(onDnsRequestFinished()));
-    dnsRequest->lookup();
+    startLookup(hostname, dnsServers, timeoutMs, id, true);
 }
 
 void DnsCache::onDnsRequestFinished()
 {
     DnsRequest *dnsRequest = qobject_cast<DnsRequest *>(sender());
     WS_ASSERT(dnsRequest != nullptr);
+    dnsRequest->deleteLater();
+
+    auto itInFlight = inFlight_.find(dnsRequest->property("lookupKey").toString());
+    WS_ASSERT(itInFlight != inFlight_.end());
+    if (itInFlight == inFlight_.end())
+        return;
+    const InFlightLookup lookup = itInFlight.value();
+    const QString key = itInFlight.key();
+    inFlight_.erase(itInFlight);
 
-    bool bOk;
-    quint64 requestId = dnsRequest->property("requestId").toULongLong(&bOk);
-    WS_ASSERT(bOk);
+    const qint64 now = clock_.elapsed();
+    const bool bSuccess = !dnsRequest->isError();
+    if (bSuccess) {
+        qint64 ttlMs = maxTtlMs_;
+        if (dnsRequest->ttl() > 0)
+            ttlMs = qMin<qint64>(qint64(dnsRequest->ttl()) * 1000, maxTtlMs_);
 
-    bool bSuccess = false;
-    if (!dnsRequest->isError()) {
-        cache_[dnsRequest->hostname()].ips = dnsRequest->ips();
-        cache_[dnsRequest->hostname()].time = QDateTime::currentMSecsSinceEpoch();
-        bSuccess = true;
+        CacheItem &item = cache_[lookup.hostname];
+        item.ips = dnsRequest->ips();
+        item.expireTime = now + ttlMs;
+        item.refreshTime = ttlMs >= kMinRefreshAheadTtlMs ? now + qint64(ttlMs * kRefreshAheadFactor) : item.expireTime;
+        item.generation = ++nextGeneration_;
+        item.isUsedSinceUpdate = false;
+        item.dnsServers = lookup.dnsServers;
+        item.timeoutMs = lookup.timeoutMs;
+        negativeCache_.remove(key);
+
+        addDeadline(item.refreshTime, DEADLINE_REFRESH, lookup.hostname, item.generation);
+        addDeadline(item.expireTime, DEADLINE_EXPIRE, lookup.hostname, item.generation);
+    } else if (!lookup.waitingIds.isEmpty()) {
+        // a failed background refresh leaves the current entry until it expires, a failed foreground lookup is remembered
+        negativeCache_[key].expireTime = now + negativeTtlMs_;
+        addDeadline(now + negativeTtlMs_, DEADLINE_NEGATIVE_EXPIRE, key, 0);
     }
+    rescheduleTimer();
 
-    emit resolved(bSuccess, dnsRequest->ips(), requestId, false, dnsRequest->elapsedMs());
-    dnsRequest->deleteLater();
+    for (quint64 id : lookup.waitingIds)
+        emit resolved(bSuccess, dnsRequest->ips(), id, false, dnsRequest->elapsedMs());
 }
 
 void DnsCache::onTimer()
 {
-    // delete outdated IPs from cache
-    auto it = cache_.begin();
-    qint64 curTime = QDateTime::currentMSecsSinceEpoch();
-    while (it != cache_.end())
-        if ((curTime - it.value().time) > cacheTimeoutMs_)
-            it = cache_.erase(it);
-        else
-            ++it;
+    const qint64 now = clock_.elapsed();
+    while (!deadlines_.empty() && deadlines_.top().time <= now) {
+        const Deadline deadline = deadlines_.top();
+        deadlines_.pop();
+
+        if (deadline.type == DEADLINE_NEGATIVE_EXPIRE) {
+            auto it = negativeCache_.find(deadline.key);
+            if (it != negativeCache_.end() && it->expireTime <= now)
+                negativeCache_.erase(it);
+            continue;
+        }
+
+        auto it = cache_.find(deadline.key);
+        if (it == cache_.end() || it->generation != deadline.generation)
+            continue;   // the entry was updated or removed since this deadline was added
+
+        if (deadline.type == DEADLINE_REFRESH) {
+            // refresh ahead only the entries which are in use, the others just expire
+            if (it->isUsedSinceUpdate)
+                startLookup(deadline.key, it->dnsServers, it->timeoutMs, 0, false);
+        } else {
+            cache_.erase(it);
+        }
+    }
+    rescheduleTimer();
 }
 
+QString DnsCache::lookupKey(const QString &hostname, const QStringList &dnsServers)
+{
+    return hostname + "|" + dnsServers.join(",");
+}
+
+void DnsCache::startLookup(const QString &hostname, const QStringList &dnsServers, int timeoutMs, quint64 waitingId, bool isWaiting)
+{
+    const QString key = lookupKey(hostname, dnsServers);
+
+    // a lookup for this hostname is already running, just wait for its result
+    auto it = inFlight_.find(key);
+    if (it != inFlight_.end()) {
+        if (isWaiting)
+            it->waitingIds << waitingId;
+        return;
+    }
+
+    InFlightLookup lookup;
+    lookup.hostname = hostname;
+    lookup.dnsServers = dnsServers;
+    lookup.timeoutMs = timeoutMs;
+    if (isWaiting)
+        lookup.waitingIds << waitingId;
+    inFlight_[key] = lookup;
+
+    DnsRequest *dnsRequest = new DnsRequest(this, hostname, dnsServers, timeoutMs);
+    dnsRequest->setProperty("lookupKey", key);
+    connect(dnsRequest, &DnsRequest::finished, this, &DnsCache::onDnsRequestFinished);
+    dnsRequest->lookup();
+}
+
+void DnsCache::addDeadline(qint64 time, DEADLINE_TYPE type, const QString &key, quint64 generation)
+{
+    deadlines_.push(Deadline { time, type, key, generation });
+}
+
+void DnsCache::rescheduleTimer()
+{
+    if (deadlines_.empty()) {
+        timer_.stop();
+        return;
+    }
+    timer_.start(qMax<qint64>(0, deadlines_.top().time - clock_.elapsed()));
+}
@@ -1,15 +1,23 @@
 #pragma once
 
-#include <QMap>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QObject>
+#include <QTimer>
+#include <queue>
+#include <vector>
 
+// DNS cache for the NetworkAccessManager.
+// - positive answers live for their real TTL, limited by maxTtlMs (records without TTL, like hosts file entries, get maxTtlMs)
+// - failures (NXDOMAIN, timeouts) are cached for a short time per hostname and DNS servers
+// - concurrent resolve() calls for the same hostname and DNS servers share a single DnsRequest
+// - entries which are used are refreshed in the background before they expire, so hot hostnames never miss
+// - expiration is driven by a min-heap of deadlines and a single-shot timer, no periodic scan of the whole cache
 class DnsCache : public QObject
 {
     Q_OBJECT
 public:
-    class Usages;
-
-    explicit DnsCache(QObject *parent, int cacheTimeoutMs = 60000, int reviewCacheIntervalMs = 1000);
+    explicit DnsCache(QObject *parent, int maxTtlMs = 60000, int negativeTtlMs = 5000);
     virtual ~DnsCache();
 
     void resolve(const QString &hostname, quint64 id, bool bypassCache = false, const QStringList &dnsServers = QStringList(), int timeoutMs = 5000);
@@ -22,22 +30,58 @@ private slots:
     void onTimer();
 
 private:
+    // the share of the TTL after which a used entry is refreshed in the background
+    static constexpr double kRefreshAheadFactor = 0.8;
+    // entries with a shorter TTL are not refreshed ahead, they just expire
+    static constexpr int kMinRefreshAheadTtlMs = 2000;
+
     struct CacheItem
     {
-        qint64 time;
         QStringList ips;
+        qint64 expireTime = 0;
+        qint64 refreshTime = 0;
+        quint64 generation = 0;     // to detect outdated deadlines in the heap
+        bool isUsedSinceUpdate = false;
+        // parameters of the last lookup, used for the background refresh
+        QStringList dnsServers;
+        int timeoutMs = 5000;
+    };
 
-        CacheItem() : time(0) {}
+    struct NegativeCacheItem
+    {
+        qint64 expireTime = 0;
     };
 
-    struct PendingRequest
+    struct InFlightLookup
     {
         QString hostname;
-        quint64 id;
+        QStringList dnsServers;
+        int timeoutMs = 5000;
+        QVector<quint64> waitingIds;   // requests waiting for the result (empty for a background refresh)
     };
 
-    QMap<QString, CacheItem> cache_;
-    int cacheTimeoutMs_;
+    enum DEADLINE_TYPE { DEADLINE_REFRESH, DEADLINE_EXPIRE, DEADLINE_NEGATIVE_EXPIRE };
+    struct Deadline
+    {
+        qint64 time;
+        DEADLINE_TYPE type;
+        QString key;
+        quint64 generation;
+        bool operator>(const Deadline &other) const { return time > other.time; }
+    };
 
-};
+    QHash<QString, CacheItem> cache_;                       // by hostname
+    QHash<QString, NegativeCacheItem> negativeCache_;       // by lookupKey()
+    QHash<QString, InFlightLookup> inFlight_;               // by lookupKey()
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline> > deadlines_;
+    QTimer timer_;
+    QElapsedTimer clock_;
+    quint64 nextGeneration_ = 0;
+    int maxTtlMs_;
+    int negativeTtlMs_;
 
+    static QString lookupKey(const QString &hostname, const QStringList &dnsServers);
+    void startLookup(const QString &hostname, const QStringList &dnsServers, int timeoutMs, quint64 waitingId, bool isWaiting);
+    void addDeadline(qint64 time, DEADLINE_TYPE type, const QString &key, quint64 generation);
+    void rescheduleTimer();
+};
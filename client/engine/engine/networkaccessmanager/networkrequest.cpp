@@ -115,3 +115,23 @@ bool NetworkRequest::isWhiteListIps() const
 {
     return isWhiteListIps_;
 }
+
+void NetworkRequest::setOutputFilePath(const QString &path)
+{
+    outputFilePath_ = path;
+}
+
+QString NetworkRequest::outputFilePath() const
+{
+    return outputFilePath_;
+}
+
+void NetworkRequest::setUseFreshConnection(bool bFreshConnection)
+{
+    bFreshConnection_ = bFreshConnection;
+}
+
+bool NetworkRequest::isUseFreshConnection() const
+{
+    return bFreshConnection_;
+}
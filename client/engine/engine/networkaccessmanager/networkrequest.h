@@ -40,6 +40,14 @@ public:
     void setIsWhiteListIps(bool isWhiteListIps);
     bool isWhiteListIps() const;
 
+    // If set, the response body is written directly to this file in the network thread, readyRead is not emitted
+    void setOutputFilePath(const QString &path);
+    QString outputFilePath() const;
+
+    // Force a new connection for this request instead of reusing a pooled one
+    void setUseFreshConnection(bool bFreshConnection);
+    bool isUseFreshConnection() const;
+
 private:
     QUrl url_;
     int timeout_;
@@ -58,5 +66,10 @@ private:
 
     // default true
     bool isWhiteListIps_;
+
+    QString outputFilePath_;
+
+    // default false, if true then the request does not reuse (and does not leave behind) a pooled connection
+    bool bFreshConnection_ = false;
 };
 
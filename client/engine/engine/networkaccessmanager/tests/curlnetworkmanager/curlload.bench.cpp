@@ -0,0 +1,110 @@
+#include <QtTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#include <algorithm>
+
+#include "engine/networkaccessmanager/curlnetworkmanager.h"
+
+// Local plain HTTP stub: answers every request with a short response, keeps connections alive.
+class LocalHttpStub : public QTcpServer
+{
+    Q_OBJECT
+protected:
+    void incomingConnection(qintptr socketDescriptor) override
+    {
+        QTcpSocket *socket = new QTcpSocket(this);
+        if (!socket->setSocketDescriptor(socketDescriptor)) {
+            delete socket;
+            return;
+        }
+        connect(socket, &QTcpSocket::readyRead, [socket]() {
+            QByteArray request = socket->readAll();
+            int count = request.count("\r\n\r\n");
+            for (int i = 0; i < count; ++i)
+                socket->write("HTTP/1.1 200 OK\r\nContent-Length: 2\r\nConnection: keep-alive\r\n\r\nok");
+        });
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+    }
+};
+
+// Fires many concurrent requests and reports enqueue-to-first-byte latency percentiles
+class BenchCurlLoad : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void benchmark_concurrent_requests_data();
+    void benchmark_concurrent_requests();
+
+private:
+    LocalHttpStub server_;
+};
+
+void BenchCurlLoad::initTestCase()
+{
+    QVERIFY(server_.listen(QHostAddress::LocalHost));
+}
+
+void BenchCurlLoad::benchmark_concurrent_requests_data()
+{
+    QTest::addColumn<int>("requestsCount");
+    QTest::newRow("100") << 100;
+    QTest::newRow("1000") << 1000;
+    QTest::newRow("5000") << 5000;
+}
+
+void BenchCurlLoad::benchmark_concurrent_requests()
+{
+    QFETCH(int, requestsCount);
+
+    CurlNetworkManager manager;
+    NetworkRequest request(QUrl("http://localhost:" + QString::number(server_.serverPort()) + "/"), 30000, false);
+
+    QElapsedTimer timer;
+    QHash<CurlReply *, qint64> enqueueTimes;
+    QVector<qint64> firstByteLatencies;
+    firstByteLatencies.reserve(requestsCount);
+    int finished = 0;
+    int failed = 0;
+
+    timer.start();
+    for (int i = 0; i < requestsCount; ++i) {
+        CurlReply *reply = manager.get(request, QStringList() << "127.0.0.1");
+        enqueueTimes[reply] = timer.nsecsElapsed();
+        connect(reply, &CurlReply::readyRead, this, [&, reply]() {
+            auto it = enqueueTimes.find(reply);
+            if (it != enqueueTimes.end()) {
+                firstByteLatencies << timer.nsecsElapsed() - it.value();
+                enqueueTimes.erase(it);
+            }
+        });
+        connect(reply, &CurlReply::finished, this, [&, reply]() {
+            if (!reply->isSuccess())
+                failed++;
+            finished++;
+            reply->deleteLater();
+        });
+    }
+    const qint64 enqueueNs = timer.nsecsElapsed();
+
+    QTRY_COMPARE_WITH_TIMEOUT(finished, requestsCount, 60000);
+    const qint64 totalNs = timer.nsecsElapsed();
+    QCOMPARE(failed, 0);
+    QCOMPARE(firstByteLatencies.count(), requestsCount);
+
+    std::sort(firstByteLatencies.begin(), firstByteLatencies.end());
+    auto percentileMs = [&firstByteLatencies](double p) {
+        return firstByteLatencies[qMin(firstByteLatencies.count() - 1, int(firstByteLatencies.count() * p))] / 1e6;
+    };
+
+    qDebug() << "requests:" << requestsCount
+             << "enqueue total, ms:" << enqueueNs / 1e6
+             << "all finished, ms:" << totalNs / 1e6;
+    qDebug() << "enqueue-to-first-byte, ms: p50" << percentileMs(0.5) << "p99" << percentileMs(0.99)
+             << "max" << firstByteLatencies.last() / 1e6;
+}
+
+QTEST_MAIN(BenchCurlLoad)
+#include "curlload.bench.moc"
@@ -0,0 +1,194 @@
+#include <QtTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+
+#include <atomic>
+
+#include "engine/networkaccessmanager/curlnetworkmanager.h"
+
+// Counts heap allocations of all threads except the server one (Linux only, via malloc interposition).
+namespace {
+std::atomic<quint64> g_allocations(0);
+thread_local bool t_isServerThread = false;
+}
+
+#ifdef Q_OS_LINUX
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_calloc(size_t n, size_t size);
+
+void *malloc(size_t size)
+{
+    if (!t_isServerThread)
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    if (!t_isServerThread)
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    if (!t_isServerThread)
+        g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(n, size);
+}
+}
+#endif
+
+// Serves a body of the given size in 1MB blocks, written only as the socket drains.
+class LocalDownloadServer : public QTcpServer
+{
+    Q_OBJECT
+public:
+    explicit LocalDownloadServer(qint64 bodySize) : bodySize_(bodySize), block_(1024 * 1024, 'x') {}
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override
+    {
+        QTcpSocket *socket = new QTcpSocket(this);
+        if (!socket->setSocketDescriptor(socketDescriptor)) {
+            delete socket;
+            return;
+        }
+        QSharedPointer<qint64> left(new qint64(0));
+        connect(socket, &QTcpSocket::readyRead, [this, socket, left]() {
+            if (!socket->readAll().contains("\r\n\r\n"))
+                return;
+            socket->write("HTTP/1.1 200 OK\r\nContent-Length: " + QByteArray::number(bodySize_) + "\r\n\r\n");
+            *left = bodySize_;
+            writeNextBlock(socket, left.data());
+        });
+        connect(socket, &QTcpSocket::bytesWritten, [this, socket, left]() {
+            if (socket->bytesToWrite() == 0)
+                writeNextBlock(socket, left.data());
+        });
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+    }
+
+private:
+    const qint64 bodySize_;
+    const QByteArray block_;
+
+    void writeNextBlock(QTcpSocket *socket, qint64 *left)
+    {
+        if (*left <= 0)
+            return;
+        const qint64 size = qMin<qint64>(*left, block_.size());
+        socket->write(block_.constData(), size);
+        *left -= size;
+    }
+};
+
+class BenchDownload : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void benchmark_download_to_memory();
+    void benchmark_download_to_file();
+
+private:
+    static constexpr qint64 kBodySize = 50 * 1024 * 1024;
+    QThread serverThread_;
+    LocalDownloadServer *server_ = nullptr;
+    quint16 port_ = 0;
+
+    NetworkRequest makeRequest() const;
+};
+
+void BenchDownload::initTestCase()
+{
+#ifndef Q_OS_LINUX
+    QSKIP("Allocation counting is only implemented for Linux");
+#endif
+    server_ = new LocalDownloadServer(kBodySize);
+    server_->moveToThread(&serverThread_);
+    connect(&serverThread_, &QThread::finished, server_, &QObject::deleteLater);
+    serverThread_.start();
+    QMetaObject::invokeMethod(server_, [this]() {
+        t_isServerThread = true;
+        server_->listen(QHostAddress::LocalHost);
+        port_ = server_->serverPort();
+    }, Qt::BlockingQueuedConnection);
+    QVERIFY(port_ != 0);
+}
+
+void BenchDownload::cleanupTestCase()
+{
+    serverThread_.quit();
+    serverThread_.wait();
+}
+
+NetworkRequest BenchDownload::makeRequest() const
+{
+    return NetworkRequest(QUrl("http://localhost:" + QString::number(port_) + "/installer"), 60000, false);
+}
+
+void BenchDownload::benchmark_download_to_memory()
+{
+    CurlNetworkManager manager;
+    qint64 received = 0;
+    int readyReadCount = 0;
+
+    const quint64 allocationsBefore = g_allocations;
+    QElapsedTimer timer;
+    timer.start();
+
+    CurlReply *reply = manager.get(makeRequest(), QStringList() << "127.0.0.1");
+    connect(reply, &CurlReply::readyRead, this, [&]() {
+        received += reply->readAll().size();
+        readyReadCount++;
+    });
+    QSignalSpy signalFinished(reply, SIGNAL(finished(qint64)));
+    QVERIFY(signalFinished.wait(60000));
+    QVERIFY(reply->isSuccess());
+    received += reply->readAll().size();
+
+    const qint64 elapsedMs = timer.elapsed();
+    const quint64 allocations = g_allocations - allocationsBefore;
+    delete reply;
+
+    QCOMPARE(received, kBodySize);
+    qDebug() << "to memory: allocations" << allocations << "readyRead signals" << readyReadCount << "time, ms" << elapsedMs;
+}
+
+void BenchDownload::benchmark_download_to_file()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString filePath = dir.filePath("installer");
+
+    CurlNetworkManager manager;
+    int progressCount = 0;
+
+    const quint64 allocationsBefore = g_allocations;
+    QElapsedTimer timer;
+    timer.start();
+
+    NetworkRequest request = makeRequest();
+    request.setOutputFilePath(filePath);
+    CurlReply *reply = manager.get(request, QStringList() << "127.0.0.1");
+    connect(reply, &CurlReply::progress, this, [&]() { progressCount++; });
+    QSignalSpy signalFinished(reply, SIGNAL(finished(qint64)));
+    QVERIFY(signalFinished.wait(60000));
+    QVERIFY(reply->isSuccess());
+
+    const qint64 elapsedMs = timer.elapsed();
+    const quint64 allocations = g_allocations - allocationsBefore;
+    delete reply;
+
+    QCOMPARE(QFileInfo(filePath).size(), kBodySize);
+    qDebug() << "to file: allocations" << allocations << "progress signals" << progressCount << "time, ms" << elapsedMs;
+}
+
+QTEST_MAIN(BenchDownload)
+#include "download.bench.moc"
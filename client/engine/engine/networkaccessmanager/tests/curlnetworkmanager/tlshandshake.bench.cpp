@@ -0,0 +1,132 @@
+#include <QtTest>
+#include <QSslKey>
+#include <QSslSocket>
+#include <QTcpServer>
+
+#include <openssl/ssl.h>
+
+#include "engine/networkaccessmanager/certmanager.h"
+#include "engine/networkaccessmanager/curlnetworkmanager.h"
+
+// Local TLS server which answers every request with a short keep-alive HTTP response.
+class LocalTlsServer : public QTcpServer
+{
+    Q_OBJECT
+public:
+    explicit LocalTlsServer(QObject *parent = nullptr) : QTcpServer(parent)
+    {
+        QFile certFile(":localhost.crt");
+        QVERIFY(certFile.open(QIODevice::ReadOnly));
+        cert_ = QSslCertificate(certFile.readAll());
+        QFile keyFile(":localhost.key");
+        QVERIFY(keyFile.open(QIODevice::ReadOnly));
+        key_ = QSslKey(keyFile.readAll(), QSsl::Rsa);
+    }
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override
+    {
+        QSslSocket *socket = new QSslSocket(this);
+        if (!socket->setSocketDescriptor(socketDescriptor)) {
+            delete socket;
+            return;
+        }
+        socket->setLocalCertificate(cert_);
+        socket->setPrivateKey(key_);
+        connect(socket, &QSslSocket::readyRead, [socket]() {
+            QByteArray request = socket->readAll();
+            if (request.contains("\r\n\r\n"))
+                socket->write("HTTP/1.1 200 OK\r\nContent-Length: 2\r\nConnection: keep-alive\r\n\r\nok");
+        });
+        connect(socket, &QSslSocket::disconnected, socket, &QObject::deleteLater);
+        socket->startServerEncryption();
+    }
+
+private:
+    QSslCertificate cert_;
+    QSslKey key_;
+};
+
+class BenchTlsHandshake : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    // cost of the trust store setup per TLS context, as it was done before and as it is done now
+    void benchmark_store_rebuild_per_context();
+    void benchmark_store_shared_per_context();
+
+    // full request cost against the local server
+    void benchmark_request_fresh_connection();
+    void benchmark_request_pooled_connection();
+
+private:
+    LocalTlsServer server_;
+    CertManager certManager_;
+
+    void doRequest(CurlNetworkManager *manager, bool bFreshConnection);
+};
+
+void BenchTlsHandshake::initTestCase()
+{
+    QVERIFY(server_.listen(QHostAddress::LocalHost));
+    QVERIFY(certManager_.count() > 0);
+    qDebug() << "certificates in the store:" << certManager_.count();
+}
+
+void BenchTlsHandshake::benchmark_store_rebuild_per_context()
+{
+    SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+    QBENCHMARK {
+        X509_STORE *store = X509_STORE_new();
+        SSL_CTX_set_cert_store(ctx, store);
+        for (int i = 0; i < certManager_.count(); ++i)
+            X509_STORE_add_cert(store, certManager_.getCert(i));
+    }
+    SSL_CTX_free(ctx);
+}
+
+void BenchTlsHandshake::benchmark_store_shared_per_context()
+{
+    SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+    QBENCHMARK {
+        SSL_CTX_set1_cert_store(ctx, certManager_.x509Store());
+    }
+    SSL_CTX_free(ctx);
+}
+
+void BenchTlsHandshake::benchmark_request_fresh_connection()
+{
+    CurlNetworkManager manager;
+    QBENCHMARK {
+        doRequest(&manager, true);
+    }
+}
+
+void BenchTlsHandshake::benchmark_request_pooled_connection()
+{
+    CurlNetworkManager manager;
+    // the first request establishes the connection
+    doRequest(&manager, false);
+    QBENCHMARK {
+        doRequest(&manager, false);
+    }
+}
+
+void BenchTlsHandshake::doRequest(CurlNetworkManager *manager, bool bFreshConnection)
+{
+    NetworkRequest request(QUrl("https://localhost:" + QString::number(server_.serverPort()) + "/"), 5000, false);
+    request.setUseFreshConnection(bFreshConnection);
+
+    CurlReply *reply = manager->get(request, QStringList() << "127.0.0.1");
+    QSignalSpy signalFinished(reply, SIGNAL(finished(qint64)));
+    QVERIFY(signalFinished.wait(5000));
+    QVERIFY(reply->isSuccess());
+    QCOMPARE(reply->readAll(), QByteArray("ok"));
+    delete reply;
+}
+
+QTEST_MAIN(BenchTlsHandshake)
+#include "tlshandshake.bench.moc"
@@ -17,6 +17,9 @@ public:
 private slots:
     void basicTest();
     void testCacheTimeout();
+    void testRefreshAhead();
+    void testCoalescing();
+    void testNegativeCache();
 
 private:
     void delay(int ms);
@@ -90,6 +93,7 @@ void TestDnsCache::basicTest()
 
 void TestDnsCache::testCacheTimeout()
 {
+     // an entry which is not used after it was resolved expires after the max TTL
      DnsCache *dnsCache = new DnsCache(this, 3000, 10);
      {
          QSignalSpy spy(dnsCache, SIGNAL(resolved(bool, QStringList, quint64, bool, int)));
@@ -106,6 +110,33 @@ void TestDnsCache::testCacheTimeout()
          QList<QVariant> arguments = spy.takeFirst();
          QVERIFY(arguments.at(3).toBool() == false);
      }
+     delay(3100);
+     {
+         QSignalSpy spy(dnsCache, SIGNAL(resolved(bool, QStringList, quint64, bool, int)));
+
+         dnsCache->resolve("google.com", 0, false);
+
+         if (spy.count() == 0) { spy.wait(10000); }
+         QCOMPARE(spy.count(), 1);
+         QList<QVariant> arguments = spy.takeFirst();
+         QVERIFY(arguments.at(3).toBool() == false);
+     }
+}
+
+void TestDnsCache::testRefreshAhead()
+{
+     // an entry which is used is refreshed in the background before it expires, so it is still answered from the cache
+     DnsCache *dnsCache = new DnsCache(this, 3000, 10);
+     {
+         QSignalSpy spy(dnsCache, SIGNAL(resolved(bool, QStringList, quint64, bool, int)));
+
+         dnsCache->resolve("google.com", 0, false);
+
+         if (spy.count() == 0) { spy.wait(10000); }
+         QCOMPARE(spy.count(), 1);
+         QList<QVariant> arguments = spy.takeFirst();
+         QVERIFY(arguments.at(3).toBool() == false);
+     }
      {
          QSignalSpy spy(dnsCache, SIGNAL(resolved(bool, QStringList, quint64, bool, int)));
 
@@ -125,10 +156,68 @@ void TestDnsCache::testCacheTimeout()
          if (spy.count() == 0) { spy.wait(10000); }
          QCOMPARE(spy.count(), 1);
          QList<QVariant> arguments = spy.takeFirst();
-         QVERIFY(arguments.at(3).toBool() == false);
+         QVERIFY(arguments.at(0).toBool() == true);
+         QVERIFY(arguments.at(3).toBool() == true);
      }
 }
 
+void TestDnsCache::testCoalescing()
+{
+    // concurrent requests for the same hostname share one lookup and all get the same answer
+    DnsCache *dnsCache = new DnsCache(this);
+    QSignalSpy spy(dnsCache, SIGNAL(resolved(bool, QStringList, quint64, bool, int)));
+
+    for (int i = 0; i < 10; ++i)
+        dnsCache->resolve("google.com", i, false);
+
+    while (spy.count() < 10 && spy.wait(10000)) {}
+    QCOMPARE(spy.count(), 10);
+
+    QSet<quint64> ids;
+    const QStringList ips = spy.at(0).at(1).toStringList();
+    for (const QList<QVariant> &arguments : spy) {
+        QVERIFY(arguments.at(0).toBool() == true);
+        QCOMPARE(arguments.at(1).toStringList(), ips);
+        QVERIFY(arguments.at(3).toBool() == false);
+        ids << arguments.at(2).toULongLong();
+    }
+    QCOMPARE(ids.count(), 10);
+}
+
+void TestDnsCache::testNegativeCache()
+{
+    DnsCache *dnsCache = new DnsCache(this, 60000, 2000);
+    {
+        QSignalSpy spy(dnsCache, SIGNAL(resolved(bool, QStringList, quint64, bool, int)));
+        dnsCache->resolve("incorrectdomain", 0, false);
+        if (spy.count() == 0) { spy.wait(10000); }
+        QCOMPARE(spy.count(), 1);
+        QList<QVariant> arguments = spy.takeFirst();
+        QVERIFY(arguments.at(0).toBool() == false);
+        QVERIFY(arguments.at(3).toBool() == false);
+    }
+    {
+        // the failure is answered from the cache
+        QSignalSpy spy(dnsCache, SIGNAL(resolved(bool, QStringList, quint64, bool, int)));
+        dnsCache->resolve("incorrectdomain", 1, false);
+        QCOMPARE(spy.count(), 1);
+        QList<QVariant> arguments = spy.takeFirst();
+        QVERIFY(arguments.at(0).toBool() == false);
+        QVERIFY(arguments.at(3).toBool() == true);
+    }
+    delay(2100);
+    {
+        // and not after the negative TTL
+        QSignalSpy spy(dnsCache, SIGNAL(resolved(bool, QStringList, quint64, bool, int)));
+        dnsCache->resolve("incorrectdomain", 2, false);
+        if (spy.count() == 0) { spy.wait(10000); }
+        QCOMPARE(spy.count(), 1);
+        QList<QVariant> arguments = spy.takeFirst();
+        QVERIFY(arguments.at(0).toBool() == false);
+        QVERIFY(arguments.at(3).toBool() == false);
+    }
+}
+
 
 void TestDnsCache::delay(int ms)
 {
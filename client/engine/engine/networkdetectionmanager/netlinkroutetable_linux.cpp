@@ -0,0 +1,270 @@
+#include "netlinkroutetable_linux.h"
+
+#include <arpa/inet.h>
+#include <linux/if.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/stat.h>
+
+bool DefaultRouteInfo::operator==(const DefaultRouteInfo &other) const
+{
+    return isOnline == other.isOnline && ifname == other.ifname && ifindex == other.ifindex &&
+           macAddress == other.macAddress && gateway == other.gateway && isActive == other.isActive &&
+           isWireless == other.isWireless && linkChanges == other.linkChanges;
+}
+
+bool NetlinkRouteTable_linux::Route::operator==(const Route &other) const
+{
+    return ifindex == other.ifindex && gateway == other.gateway && priority == other.priority && dstLen == other.dstLen;
+}
+
+bool NetlinkRouteTable_linux::RouteKey::operator==(const RouteKey &other) const
+{
+    return isSameExceptInterface(other) && ifindex == other.ifindex;
+}
+
+bool NetlinkRouteTable_linux::RouteKey::isSameExceptInterface(const RouteKey &other) const
+{
+    return table == other.table && priority == other.priority && dstLen == other.dstLen && tos == other.tos;
+}
+
+bool NetlinkRouteTable_linux::processMessages(const void *buf, size_t len)
+{
+    bool isChanged = false;
+    int remaining = (int)len;
+    for (const struct nlmsghdr *nlh = (const struct nlmsghdr *)buf; NLMSG_OK(nlh, remaining); nlh = NLMSG_NEXT(nlh, remaining)) {
+        switch (nlh->nlmsg_type) {
+        case RTM_NEWLINK:
+        case RTM_DELLINK:
+            isChanged |= processLinkMessage(nlh);
+            break;
+        case RTM_NEWROUTE:
+        case RTM_DELROUTE:
+            isChanged |= processRouteMessage(nlh);
+            break;
+        default:
+            break;
+        }
+    }
+    return isChanged;
+}
+
+DefaultRouteInfo NetlinkRouteTable_linux::defaultRoute() const
+{
+    DefaultRouteInfo info;
+    info.isOnline = !routes_.isEmpty();
+
+    const Route *best = nullptr;
+    const Link *bestLink = nullptr;
+    for (auto it = routes_.cbegin(); it != routes_.cend(); ++it) {
+        auto itLink = links_.constFind(it->ifindex);
+        if (itLink == links_.cend() || itLink->name.startsWith("tun") || itLink->name.startsWith("utun")) {
+            continue;
+        }
+        if (!best || it->dstLen < best->dstLen || (it->dstLen == best->dstLen && it->priority < best->priority) ||
+            (it->dstLen == best->dstLen && it->priority == best->priority && it->ifindex < best->ifindex)) {
+            best = &it.value();
+            bestLink = &itLink.value();
+        }
+    }
+
+    if (best) {
+        info.ifname = bestLink->name;
+        info.ifindex = best->ifindex;
+        if (bestLink->address.size() == 6) {
+            const unsigned char *mac = (const unsigned char *)bestLink->address.constData();
+            info.macAddress = QString::asprintf("%.2X:%.2X:%.2X:%.2X:%.2X:%.2X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+        }
+        if (best->gateway != 0) {
+            char str[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &best->gateway, str, sizeof(str));
+            info.gateway = str;
+        }
+        info.isActive = (bestLink->flags & (IFF_UP | IFF_RUNNING)) == (IFF_UP | IFF_RUNNING);
+        info.isWireless = bestLink->isWireless;
+        info.linkChanges = bestLink->changes;
+    }
+    return info;
+}
+
+void NetlinkRouteTable_linux::clear()
+{
+    links_.clear();
+    routes_.clear();
+}
+
+bool NetlinkRouteTable_linux::processLinkMessage(const nlmsghdr *nlh)
+{
+    if (nlh->nlmsg_len < NLMSG_LENGTH(sizeof(struct ifinfomsg))) {
+        return false;
+    }
+    const struct ifinfomsg *ifi = (const struct ifinfomsg *)NLMSG_DATA(nlh);
+
+    if (nlh->nlmsg_type == RTM_DELLINK) {
+        const bool isUsed = isUsedByRoute(ifi->ifi_index);
+        links_.remove(ifi->ifi_index);
+        // the kernel does not notify about the IPv4 routes removed with the interface
+        removeRoutesOfLink(ifi->ifi_index);
+        return isUsed;
+    }
+
+    Link link;
+    int attrLen = IFLA_PAYLOAD(nlh);
+    for (const struct rtattr *rta = IFLA_RTA(ifi); RTA_OK(rta, attrLen); rta = RTA_NEXT(rta, attrLen)) {
+        switch (rta->rta_type) {
+        case IFLA_IFNAME:
+            link.name = QString::fromUtf8((const char *)RTA_DATA(rta));
+            break;
+        case IFLA_ADDRESS:
+            link.address = QByteArray((const char *)RTA_DATA(rta), RTA_PAYLOAD(rta));
+            break;
+        case IFLA_OPERSTATE:
+            link.operState = *(const quint8 *)RTA_DATA(rta);
+            break;
+        default:
+            break;
+        }
+    }
+    link.flags = ifi->ifi_flags;
+
+    bool isChanged = true;
+    auto it = links_.find(ifi->ifi_index);
+    if (it != links_.end()) {
+        const unsigned int kStateFlags = IFF_UP | IFF_RUNNING | IFF_LOWER_UP;
+        isChanged = it->name != link.name || it->address != link.address || it->operState != link.operState ||
+                    (it->flags & kStateFlags) != (link.flags & kStateFlags);
+        if (!isChanged) {
+            return false;   // e.g. the statistics update
+        }
+        link.isWireless = (it->name == link.name) ? it->isWireless : isWirelessLink(link.name);
+        link.changes = it->changes + 1;
+        *it = link;
+    }
+    else {
+        link.isWireless = isWirelessLink(link.name);
+        links_.insert(ifi->ifi_index, link);
+    }
+
+    bool isUsed = isUsedByRoute(ifi->ifi_index);
+    // the IPv4 routes are removed without a notification when the interface goes down
+    if (!(link.flags & IFF_UP)) {
+        removeRoutesOfLink(ifi->ifi_index);
+    }
+    return isUsed;
+}
+
+bool NetlinkRouteTable_linux::processRouteMessage(const nlmsghdr *nlh)
+{
+    if (nlh->nlmsg_len < NLMSG_LENGTH(sizeof(struct rtmsg))) {
+        return false;
+    }
+    const struct rtmsg *rtm = (const struct rtmsg *)NLMSG_DATA(nlh);
+    if (rtm->rtm_family != AF_INET || rtm->rtm_type != RTN_UNICAST) {
+        return false;
+    }
+
+    quint32 table = rtm->rtm_table;
+    quint32 dst = 0;
+    Route route;
+    route.dstLen = rtm->rtm_dst_len;
+
+    int attrLen = RTM_PAYLOAD(nlh);
+    for (const struct rtattr *rta = RTM_RTA(rtm); RTA_OK(rta, attrLen); rta = RTA_NEXT(rta, attrLen)) {
+        switch (rta->rta_type) {
+        case RTA_TABLE:
+            table = *(const quint32 *)RTA_DATA(rta);
+            break;
+        case RTA_DST:
+            dst = *(const quint32 *)RTA_DATA(rta);
+            break;
+        case RTA_OIF:
+            route.ifindex = *(const int *)RTA_DATA(rta);
+            break;
+        case RTA_GATEWAY:
+            route.gateway = *(const quint32 *)RTA_DATA(rta);
+            break;
+        case RTA_PRIORITY:
+            route.priority = *(const quint32 *)RTA_DATA(rta);
+            break;
+        case RTA_MULTIPATH:
+            // the first next hop of a multipath route
+            if (route.ifindex == 0 && RTA_PAYLOAD(rta) >= sizeof(struct rtnexthop)) {
+                const struct rtnexthop *nh = (const struct rtnexthop *)RTA_DATA(rta);
+                route.ifindex = nh->rtnh_ifindex;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    // only the routes which "route -n | grep '^0.0.0.0'" shows
+    if (table != RT_TABLE_MAIN || dst != 0) {
+        return false;
+    }
+
+    RouteKey key;
+    key.table = table;
+    key.ifindex = route.ifindex;
+    key.priority = route.priority;
+    key.dstLen = route.dstLen;
+    key.tos = rtm->rtm_tos;
+    if (nlh->nlmsg_type == RTM_DELROUTE) {
+        return routes_.remove(key) > 0;
+    }
+
+    auto it = routes_.find(key);
+    if (it != routes_.end() && *it == route) {
+        return false;
+    }
+
+    // "ip route replace" notifies about the new route only, the replaced one may have another interface
+    if (nlh->nlmsg_flags & NLM_F_REPLACE) {
+        for (auto itOld = routes_.begin(); itOld != routes_.end(); ) {
+            if (itOld.key().isSameExceptInterface(key) && itOld.key().ifindex != key.ifindex) {
+                itOld = routes_.erase(itOld);
+            }
+            else {
+                ++itOld;
+            }
+        }
+    }
+    routes_.insert(key, route);
+    return true;
+}
+
+bool NetlinkRouteTable_linux::isUsedByRoute(int ifindex) const
+{
+    for (const Route &route : routes_) {
+        if (route.ifindex == ifindex) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool NetlinkRouteTable_linux::removeRoutesOfLink(int ifindex)
+{
+    bool isRemoved = false;
+    for (auto it = routes_.begin(); it != routes_.end(); ) {
+        if (it->ifindex == ifindex) {
+            it = routes_.erase(it);
+            isRemoved = true;
+        }
+        else {
+            ++it;
+        }
+    }
+    return isRemoved;
+}
+
+bool NetlinkRouteTable_linux::isWirelessLink(const QString &name)
+{
+    if (name.isEmpty()) {
+        return false;
+    }
+    // cfg80211 drivers have phy80211, the wireless extensions add the wireless directory
+    struct stat st;
+    const QString path = "/sys/class/net/" + name;
+    return stat((path + "/phy80211").toUtf8().constData(), &st) == 0 || stat((path + "/wireless").toUtf8().constData(), &st) == 0;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QMetaType>
+#include <QString>
+
+struct nlmsghdr;
+
+// The default route and the attributes of its interface
+struct DefaultRouteInfo
+{
+    bool isOnline = false;      // there is a route to 0.0.0.0, the tunnel ones are counted too
+    QString ifname;             // the interface of the default route with the lowest metric, except the tunnels
+    int ifindex = -1;
+    QString macAddress;
+    QString gateway;
+    bool isActive = false;      // IFF_UP and IFF_RUNNING
+    bool isWireless = false;
+    quint32 linkChanges = 0;    // counts the state changes of the interface, e.g. a reconnection to another wifi network
+
+    bool operator==(const DefaultRouteInfo &other) const;
+    bool operator!=(const DefaultRouteInfo &other) const { return !(*this == other); }
+};
+
+Q_DECLARE_METATYPE(DefaultRouteInfo)
+
+// In-memory copy of the IPv4 main routing table (the routes to 0.0.0.0 only) and of the link table.
+// It is filled by the rtnetlink dump and then kept up to date with the RTM_NEWROUTE/RTM_DELROUTE/RTM_NEWLINK/RTM_DELLINK
+// notifications, so the default route is known without reading the whole routing table.
+class NetlinkRouteTable_linux
+{
+public:
+    // processes the netlink messages of one datagram, returns true if defaultRoute() may have changed
+    bool processMessages(const void *buf, size_t len);
+    DefaultRouteInfo defaultRoute() const;
+    void clear();
+
+private:
+    struct Link
+    {
+        QString name;
+        QByteArray address;
+        unsigned int flags = 0;
+        quint8 operState = 0;
+        bool isWireless = false;
+        quint32 changes = 0;
+    };
+
+    struct Route
+    {
+        int ifindex = 0;
+        quint32 gateway = 0;    // network byte order
+        quint32 priority = 0;
+        quint8 dstLen = 0;
+        bool operator==(const Route &other) const;
+    };
+
+    // the kernel identifies an IPv4 route by the table, dst, dst_len, tos and priority, but "ip route append" adds
+    // the routes which differ by the next hop only, so the interface is a part of the key too
+    struct RouteKey
+    {
+        quint32 table = 0;
+        int ifindex = 0;
+        quint32 priority = 0;
+        quint8 dstLen = 0;
+        quint8 tos = 0;
+        bool operator==(const RouteKey &other) const;
+        bool isSameExceptInterface(const RouteKey &other) const;
+        friend size_t qHash(const RouteKey &key, size_t seed = 0)
+        {
+            return qHashMulti(seed, key.table, key.ifindex, key.priority, key.dstLen, key.tos);
+        }
+    };
+
+    QHash<int, Link> links_;
+    QHash<RouteKey, Route> routes_;
+
+    bool processLinkMessage(const nlmsghdr *nlh);
+    bool processRouteMessage(const nlmsghdr *nlh);
+    bool isUsedByRoute(int ifindex) const;
+    bool removeRoutesOfLink(int ifindex);
+
+    static bool isWirelessLink(const QString &name);
+};
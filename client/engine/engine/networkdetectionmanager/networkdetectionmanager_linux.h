@@ -17,7 +17,7 @@ public:
     bool isOnline() override;
 
 private slots:
-    void onRoutesChanged();
+    void onDefaultRouteChanged(const DefaultRouteInfo &info);
 
 private:
     bool isOnline_ = false;
@@ -26,11 +26,11 @@ private:
     QThread *routeMonitorThread_ = nullptr;
     RouteMonitor_linux *routeMonitor_ = nullptr;
 
-    void updateNetworkInfo(bool bWithEmitSignal);
-    QString getDefaultRouteInterface(bool &isOnline);
-    void getInterfacePars(const QString &ifname, types::NetworkInterface &outNetworkInterface);
-    QString getMacAddressByIfName(const QString &ifname);
-    bool isActiveByIfName(const QString &ifname);
-    bool checkWirelessByIfName(const QString &ifname);
+    // the friendly name is requested from NetworkManager only when the default route interface or its state changes
+    DefaultRouteInfo friendlyNameRouteInfo_;
+    QString friendlyName_;
+
+    void updateNetworkInfo(const DefaultRouteInfo &info, bool bWithEmitSignal);
+    void getInterfacePars(const DefaultRouteInfo &info, types::NetworkInterface &outNetworkInterface);
     QString getFriendlyNameByIfName(const QString &ifname);
 };
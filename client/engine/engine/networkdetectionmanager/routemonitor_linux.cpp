@@ -1,11 +1,17 @@
 #include "routemonitor_linux.h"
 
+#include <errno.h>
 #include <linux/netlink.h>
 #include <linux/rtnetlink.h>
+#include <poll.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <atomic>
+#include <vector>
+
 #include "utils/logger.h"
 #include "utils/ws_assert.h"
 
@@ -20,29 +26,31 @@ RouteMonitor_linux::~RouteMonitor_linux()
     }
 }
 
+DefaultRouteInfo RouteMonitor_linux::currentDefaultRoute()
+{
+    NetlinkRouteTable_linux table;
+    const int fd = openNetlinkSocket(0);
+    if (fd < 0) {
+        return DefaultRouteInfo();
+    }
+    dumpTables(fd, table);
+    close(fd);
+    return table.defaultRoute();
+}
+
 void RouteMonitor_linux::init()
 {
-    if ((fd_ = socket(AF_NETLINK, SOCK_DGRAM, NETLINK_ROUTE)) < 0) {
+    const int fd = openNetlinkSocket(RTMGRP_LINK | RTMGRP_IPV4_ROUTE);
+    if (fd < 0) {
         qCDebug(LOG_BASIC) << "RouteMonitor_linux could not open netlink socket";
         WS_ASSERT(false);
         return;
     }
 
-    struct sockaddr_nl addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.nl_family = AF_NETLINK;
-    addr.nl_pid    = getpid();
-    addr.nl_groups = RTMGRP_IPV4_ROUTE;
-
-    if (bind(fd_, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
-        qCDebug(LOG_BASIC) << "RouteMonitor_linux could not bind address";
-        WS_ASSERT(false);
-        return;
+    if (!dumpTables(fd, table_)) {
+        qCDebug(LOG_BASIC) << "RouteMonitor_linux could not dump the routing table";
     }
-
-    notifier_ = new QSocketNotifier(fd_, QSocketNotifier::Read, this);
-    connect(notifier_, &QSocketNotifier::activated, this, &RouteMonitor_linux::netlinkSocketReady);
-    notifier_->setEnabled(true);
+    startWithSocket(fd);
 }
 
 void RouteMonitor_linux::finish()
@@ -50,6 +58,25 @@ void RouteMonitor_linux::finish()
     if (notifier_) {
         notifier_->setEnabled(false);
     }
+    if (debounceTimer_) {
+        debounceTimer_->stop();
+    }
+}
+
+void RouteMonitor_linux::startWithSocket(int fd)
+{
+    fd_ = fd;
+
+    debounceTimer_ = new QTimer(this);
+    debounceTimer_->setSingleShot(true);
+    connect(debounceTimer_, &QTimer::timeout, this, &RouteMonitor_linux::onDebounceTimer);
+
+    notifier_ = new QSocketNotifier(fd_, QSocketNotifier::Read, this);
+    connect(notifier_, &QSocketNotifier::activated, this, &RouteMonitor_linux::netlinkSocketReady);
+    notifier_->setEnabled(true);
+
+    latestInfo_ = table_.defaultRoute();
+    emit defaultRouteChanged(latestInfo_);
 }
 
 void RouteMonitor_linux::netlinkSocketReady(QSocketDescriptor socket, QSocketNotifier::Type activationEvent)
@@ -57,9 +84,118 @@ void RouteMonitor_linux::netlinkSocketReady(QSocketDescriptor socket, QSocketNot
     Q_UNUSED(socket)
     Q_UNUSED(activationEvent)
 
-    char buffer[4096];
-    ssize_t len = recv(fd_, buffer, sizeof(buffer), MSG_DONTWAIT);
-    if (len >= 0) {
-        emit routesChanged();
+    std::vector<char> buffer(BUFFER_SIZE);
+    bool isChanged = false;
+    while (true) {
+        const ssize_t len = recv(fd_, buffer.data(), buffer.size(), MSG_DONTWAIT);
+        if (len < 0) {
+            if (errno == ENOBUFS) {
+                // the socket buffer overflowed during a storm, the lost notifications are replaced by a new dump
+                qCDebug(LOG_BASIC) << "RouteMonitor_linux netlink socket overflow, dumping the routing table again";
+                table_.clear();
+                dumpTables(fd_, table_);
+                isChanged = true;
+                continue;
+            }
+            break;  // EAGAIN, all messages are read
+        }
+        if (len == 0) {
+            break;
+        }
+        isChanged |= table_.processMessages(buffer.data(), len);
+    }
+
+    if (isChanged) {
+        scheduleUpdate();
+    }
+}
+
+void RouteMonitor_linux::onDebounceTimer()
+{
+    const DefaultRouteInfo info = table_.defaultRoute();
+    if (info != latestInfo_) {
+        latestInfo_ = info;
+        emit defaultRouteChanged(latestInfo_);
+    }
+}
+
+void RouteMonitor_linux::scheduleUpdate()
+{
+    // each change restarts the timer, but the first pending change is not delayed more than MAX_DEBOUNCE_DELAY
+    if (!debounceTimer_->isActive()) {
+        firstPendingChange_.start();
+    }
+    debounceTimer_->start(qBound<qint64>(0, MAX_DEBOUNCE_DELAY - firstPendingChange_.elapsed(), DEBOUNCE_INTERVAL));
+}
+
+int RouteMonitor_linux::openNetlinkSocket(unsigned int groups)
+{
+    const int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd < 0) {
+        return -1;
+    }
+
+    // the kernel assigns the port id, so several sockets can be opened by the process
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = groups;
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    // the initial dump of a system with many routes (e.g. a router or a Docker host) does not fit the default buffer
+    int bufSize = 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufSize, sizeof(bufSize));
+    return fd;
+}
+
+bool RouteMonitor_linux::dumpTables(int fd, NetlinkRouteTable_linux &table)
+{
+    static std::atomic<quint32> seq(0);
+    std::vector<char> buffer(BUFFER_SIZE);
+
+    // the links are dumped first, so the routes can be matched with the interface names
+    for (int type : { RTM_GETLINK, RTM_GETROUTE }) {
+        struct {
+            struct nlmsghdr nlh;
+            struct rtgenmsg gen;
+        } request;
+        memset(&request, 0, sizeof(request));
+        request.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtgenmsg));
+        request.nlh.nlmsg_type = type;
+        request.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+        request.nlh.nlmsg_seq = ++seq;
+        request.gen.rtgen_family = (type == RTM_GETROUTE) ? AF_INET : AF_UNSPEC;
+
+        if (send(fd, &request, request.nlh.nlmsg_len, 0) < 0) {
+            return false;
+        }
+
+        bool isDone = false;
+        while (!isDone) {
+            struct pollfd pfd = { fd, POLLIN, 0 };
+            if (poll(&pfd, 1, 1000) <= 0) {
+                return false;
+            }
+            const ssize_t len = recv(fd, buffer.data(), buffer.size(), 0);
+            if (len < 0) {
+                if (errno == EINTR || errno == ENOBUFS) {
+                    continue;
+                }
+                return false;
+            }
+
+            // the notifications may come between the parts of the dump, they are processed as well
+            table.processMessages(buffer.data(), len);
+            int remaining = (int)len;
+            for (const struct nlmsghdr *nlh = (const struct nlmsghdr *)buffer.data(); NLMSG_OK(nlh, remaining); nlh = NLMSG_NEXT(nlh, remaining)) {
+                if (nlh->nlmsg_seq == request.nlh.nlmsg_seq && (nlh->nlmsg_type == NLMSG_DONE || nlh->nlmsg_type == NLMSG_ERROR)) {
+                    isDone = true;
+                }
+            }
+        }
     }
+    return true;
 }
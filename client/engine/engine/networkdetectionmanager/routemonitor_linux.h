@@ -1,8 +1,15 @@
 #pragma once
 
+#include <QElapsedTimer>
 #include <QObject>
 #include <QSocketNotifier>
+#include <QTimer>
 
+#include "netlinkroutetable_linux.h"
+
+// Keeps the routing and link tables in memory, fed by the rtnetlink notifications (after the initial dump).
+// A burst of notifications (a VPN going up, Docker or NetworkManager churning routes) results in one
+// defaultRouteChanged signal, and only if the default route or its interface actually changed.
 class RouteMonitor_linux : public QObject
 {
    Q_OBJECT
@@ -10,17 +17,36 @@ public:
     explicit RouteMonitor_linux(QObject *parent = nullptr);
     ~RouteMonitor_linux();
 
+    // the current default route read with a one-time netlink dump, can be called from any thread
+    static DefaultRouteInfo currentDefaultRoute();
+
 signals:
-    void routesChanged();
+    void defaultRouteChanged(const DefaultRouteInfo &info);
 
 public slots:
     void init();
     void finish();
+    // starts monitoring of the already opened and dumped socket, the tests replay the recorded messages through it
+    void startWithSocket(int fd);
 
 private slots:
     void netlinkSocketReady(QSocketDescriptor socket, QSocketNotifier::Type activationEvent);
+    void onDebounceTimer();
 
 private:
+    static constexpr int DEBOUNCE_INTERVAL = 200;
+    static constexpr int MAX_DEBOUNCE_DELAY = 1000;     // a long storm of events still emits the changes with this period
+    static constexpr int BUFFER_SIZE = 64 * 1024;
+
     int fd_ = -1;
     QSocketNotifier *notifier_ = nullptr;
+    QTimer *debounceTimer_ = nullptr;
+    QElapsedTimer firstPendingChange_;
+    NetlinkRouteTable_linux table_;
+    DefaultRouteInfo latestInfo_;
+
+    void scheduleUpdate();
+
+    static int openNetlinkSocket(unsigned int groups);
+    static bool dumpTables(int fd, NetlinkRouteTable_linux &table);
 };
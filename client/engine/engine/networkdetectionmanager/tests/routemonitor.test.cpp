@@ -0,0 +1,381 @@
+#include <QtTest>
+
+#include <arpa/inet.h>
+#include <linux/if.h>
+#include <linux/if_arp.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+
+#include "engine/networkdetectionmanager/routemonitor_linux.h"
+
+// One rtnetlink message, the attributes are appended after the family header
+class NetlinkMessage
+{
+public:
+    NetlinkMessage(quint16 type, quint16 flags, const void *header, size_t headerLen) : data_(NLMSG_SPACE(headerLen), 0)
+    {
+        struct nlmsghdr *nlh = (struct nlmsghdr *)data_.data();
+        nlh->nlmsg_len = data_.size();
+        nlh->nlmsg_type = type;
+        nlh->nlmsg_flags = flags;
+        memcpy(NLMSG_DATA(nlh), header, headerLen);
+    }
+
+    NetlinkMessage &attr(quint16 type, const void *data, size_t len)
+    {
+        const int offset = data_.size();
+        data_.append(RTA_SPACE(len), 0);
+        struct rtattr *rta = (struct rtattr *)(data_.data() + offset);
+        rta->rta_type = type;
+        rta->rta_len = RTA_LENGTH(len);
+        memcpy(RTA_DATA(rta), data, len);
+        ((struct nlmsghdr *)data_.data())->nlmsg_len = data_.size();
+        return *this;
+    }
+
+    template<typename T>
+    NetlinkMessage &attr(quint16 type, T value) { return attr(type, &value, sizeof(value)); }
+    NetlinkMessage &attr(quint16 type, const char *str) { return attr(type, str, strlen(str) + 1); }
+
+    const QByteArray &data() const { return data_; }
+
+private:
+    QByteArray data_;
+};
+
+// Generates the rtnetlink messages the kernel sends to a RTMGRP_LINK | RTMGRP_IPV4_ROUTE socket for this scenario:
+// phase 0 is the initial dump (lo, an eth0 veth pair with the default route via 192.0.2.1),
+// phase 1 is a storm of changes which don't affect the default route (50 Docker-like veth pairs with routes,
+// a VPN-like tun0 with 0.0.0.0/1 and 128.0.0.0/1 routes, then everything is removed),
+// phase 2 moves the default route to wlan0.
+class NetlinkStorm
+{
+public:
+    struct Record
+    {
+        int phase;
+        QByteArray datagram;
+    };
+
+    NetlinkStorm();
+    const QVector<Record> &records() const { return records_; }
+
+    static QByteArray link(quint16 type, int ifindex, const char *name, unsigned int flags);
+    static QByteArray route(quint16 type, quint16 flags, quint8 table, quint8 routeType, const char *dst, quint8 dstLen,
+                            int oif, const char *gateway, quint32 priority);
+
+private:
+    static constexpr unsigned int kLinkUp = IFF_UP | IFF_BROADCAST | IFF_MULTICAST;
+    static constexpr unsigned int kLinkRunning = kLinkUp | IFF_RUNNING | IFF_LOWER_UP;
+    static constexpr quint16 kCreate = NLM_F_CREATE | NLM_F_EXCL;
+
+    QVector<Record> records_;
+
+    void notify(int phase, const QByteArray &message) { records_ << Record{ phase, message }; }
+    // ip link add <name> type veth peer name <name>p; ip link set <name> up; ip link set <name>p up
+    void addVethPair(int phase, int ifindex, const char *name);
+    void delVethPair(int phase, int ifindex, const char *name);
+};
+
+NetlinkStorm::NetlinkStorm()
+{
+    const quint16 kDump = NLM_F_MULTI;
+    const struct nlmsghdr done = { NLMSG_LENGTH(sizeof(int)), NLMSG_DONE, NLM_F_MULTI, 0, 0 };
+    const QByteArray doneMessage = QByteArray((const char *)&done, sizeof(done)) + QByteArray(sizeof(int), 0);
+
+    QByteArray linkDump = link(RTM_NEWLINK, 1, "lo", IFF_UP | IFF_LOOPBACK | IFF_RUNNING | IFF_LOWER_UP) +
+                          link(RTM_NEWLINK, 2, "eth0", kLinkRunning) + link(RTM_NEWLINK, 3, "eth0p", kLinkRunning);
+    for (int offset = 0; offset < linkDump.size(); offset += ((struct nlmsghdr *)(linkDump.data() + offset))->nlmsg_len) {
+        ((struct nlmsghdr *)(linkDump.data() + offset))->nlmsg_flags = kDump;
+    }
+    notify(0, linkDump);
+    notify(0, doneMessage);
+    notify(0, route(RTM_NEWROUTE, kDump, RT_TABLE_MAIN, RTN_UNICAST, "0.0.0.0", 0, 2, "192.0.2.1", 0) +
+              route(RTM_NEWROUTE, kDump, RT_TABLE_MAIN, RTN_UNICAST, "192.0.2.0", 24, 2, nullptr, 0) +
+              route(RTM_NEWROUTE, kDump, RT_TABLE_LOCAL, RTN_LOCAL, "192.0.2.2", 32, 2, nullptr, 0));
+    notify(0, doneMessage);
+
+    char name[IFNAMSIZ];
+    char address[INET_ADDRSTRLEN];
+    char network[INET_ADDRSTRLEN];
+    char gateway[INET_ADDRSTRLEN];
+    for (int i = 0; i < 50; ++i) {
+        const int ifindex = 4 + i * 2;
+        snprintf(name, sizeof(name), "veth%d", i);
+        addVethPair(1, ifindex, name);
+        // ip addr add 10.<i>.0.1/24 dev veth<i>
+        snprintf(address, sizeof(address), "10.%d.0.1", i);
+        snprintf(network, sizeof(network), "10.%d.0.0", i);
+        notify(1, route(RTM_NEWROUTE, kCreate, RT_TABLE_LOCAL, RTN_LOCAL, address, 32, ifindex, nullptr, 0));
+        notify(1, route(RTM_NEWROUTE, kCreate, RT_TABLE_MAIN, RTN_UNICAST, network, 24, ifindex, nullptr, 0));
+        // ip route add 172.16.<i>.0/24 via 10.<i>.0.2
+        snprintf(network, sizeof(network), "172.16.%d.0", i);
+        snprintf(gateway, sizeof(gateway), "10.%d.0.2", i);
+        notify(1, route(RTM_NEWROUTE, kCreate, RT_TABLE_MAIN, RTN_UNICAST, network, 24, ifindex, gateway, 0));
+    }
+
+    const int tunIndex = 104;
+    addVethPair(1, tunIndex, "tun0");
+    notify(1, route(RTM_NEWROUTE, kCreate, RT_TABLE_MAIN, RTN_UNICAST, "0.0.0.0", 1, tunIndex, nullptr, 0));
+    notify(1, route(RTM_NEWROUTE, kCreate, RT_TABLE_MAIN, RTN_UNICAST, "128.0.0.0", 1, tunIndex, nullptr, 0));
+    notify(1, route(RTM_DELROUTE, 0, RT_TABLE_MAIN, RTN_UNICAST, "0.0.0.0", 1, tunIndex, nullptr, 0));
+    notify(1, route(RTM_DELROUTE, 0, RT_TABLE_MAIN, RTN_UNICAST, "128.0.0.0", 1, tunIndex, nullptr, 0));
+    delVethPair(1, tunIndex, "tun0");
+
+    for (int i = 0; i < 50; ++i) {
+        const int ifindex = 4 + i * 2;
+        snprintf(name, sizeof(name), "veth%d", i);
+        snprintf(address, sizeof(address), "10.%d.0.1", i);
+        notify(1, route(RTM_DELROUTE, 0, RT_TABLE_LOCAL, RTN_LOCAL, address, 32, ifindex, nullptr, 0));
+        delVethPair(1, ifindex, name);
+    }
+
+    const int wlanIndex = 106;
+    addVethPair(2, wlanIndex, "wlan0");
+    notify(2, route(RTM_NEWROUTE, kCreate, RT_TABLE_LOCAL, RTN_LOCAL, "198.19.0.1", 32, wlanIndex, nullptr, 0));
+    notify(2, route(RTM_NEWROUTE, kCreate, RT_TABLE_MAIN, RTN_UNICAST, "198.19.0.0", 24, wlanIndex, nullptr, 0));
+    notify(2, route(RTM_NEWROUTE, kCreate, RT_TABLE_MAIN, RTN_UNICAST, "0.0.0.0", 0, wlanIndex, "198.19.0.2", 50));
+    notify(2, route(RTM_DELROUTE, 0, RT_TABLE_MAIN, RTN_UNICAST, "0.0.0.0", 0, 2, "192.0.2.1", 0));
+}
+
+QByteArray NetlinkStorm::link(quint16 type, int ifindex, const char *name, unsigned int flags)
+{
+    struct ifinfomsg ifi;
+    memset(&ifi, 0, sizeof(ifi));
+    ifi.ifi_family = AF_UNSPEC;
+    ifi.ifi_type = (flags & IFF_LOOPBACK) ? ARPHRD_LOOPBACK : ARPHRD_ETHER;
+    ifi.ifi_index = ifindex;
+    ifi.ifi_flags = flags;
+    ifi.ifi_change = 0xFFFFFFFF;
+
+    const unsigned char mac[6] = { 0x02, 0x42, 0xac, 0x11, (unsigned char)(ifindex >> 8), (unsigned char)ifindex };
+    // the statistics are the largest part of the real messages
+    const QByteArray stats(sizeof(struct rtnl_link_stats64), 0);
+    return NetlinkMessage(type, 0, &ifi, sizeof(ifi))
+        .attr(IFLA_IFNAME, name)
+        .attr(IFLA_ADDRESS, mac, sizeof(mac))
+        .attr<quint32>(IFLA_MTU, 1500)
+        .attr<quint8>(IFLA_OPERSTATE, (flags & IFF_RUNNING) ? IF_OPER_UP : IF_OPER_DOWN)
+        .attr(IFLA_STATS64, stats.constData(), stats.size())
+        .data();
+}
+
+QByteArray NetlinkStorm::route(quint16 type, quint16 flags, quint8 table, quint8 routeType, const char *dst, quint8 dstLen,
+                               int oif, const char *gateway, quint32 priority)
+{
+    struct rtmsg rtm;
+    memset(&rtm, 0, sizeof(rtm));
+    rtm.rtm_family = AF_INET;
+    rtm.rtm_dst_len = dstLen;
+    rtm.rtm_table = table;
+    rtm.rtm_protocol = gateway ? RTPROT_BOOT : RTPROT_KERNEL;
+    rtm.rtm_scope = (routeType == RTN_LOCAL) ? RT_SCOPE_HOST : (gateway ? RT_SCOPE_UNIVERSE : RT_SCOPE_LINK);
+    rtm.rtm_type = routeType;
+
+    NetlinkMessage message(type, flags, &rtm, sizeof(rtm));
+    message.attr<quint32>(RTA_TABLE, table);
+    if (dstLen > 0) {
+        message.attr<quint32>(RTA_DST, inet_addr(dst));
+    }
+    if (priority > 0) {
+        message.attr<quint32>(RTA_PRIORITY, priority);
+    }
+    if (gateway) {
+        message.attr<quint32>(RTA_GATEWAY, inet_addr(gateway));
+    }
+    message.attr<int>(RTA_OIF, oif);
+    return message.data();
+}
+
+void NetlinkStorm::addVethPair(int phase, int ifindex, const char *name)
+{
+    const QByteArray peer = QByteArray(name) + "p";
+    notify(phase, link(RTM_NEWLINK, ifindex, name, IFF_BROADCAST | IFF_MULTICAST));
+    notify(phase, link(RTM_NEWLINK, ifindex + 1, peer.constData(), IFF_BROADCAST | IFF_MULTICAST));
+    notify(phase, link(RTM_NEWLINK, ifindex, name, kLinkUp));
+    notify(phase, link(RTM_NEWLINK, ifindex + 1, peer.constData(), kLinkUp));
+    // the carrier comes up a bit later, with another notification for each side
+    notify(phase, link(RTM_NEWLINK, ifindex, name, kLinkRunning));
+    notify(phase, link(RTM_NEWLINK, ifindex + 1, peer.constData(), kLinkRunning));
+}
+
+void NetlinkStorm::delVethPair(int phase, int ifindex, const char *name)
+{
+    const QByteArray peer = QByteArray(name) + "p";
+    notify(phase, link(RTM_NEWLINK, ifindex, name, IFF_BROADCAST | IFF_MULTICAST));
+    notify(phase, link(RTM_NEWLINK, ifindex + 1, peer.constData(), IFF_BROADCAST | IFF_MULTICAST));
+    notify(phase, link(RTM_DELLINK, ifindex, name, IFF_BROADCAST | IFF_MULTICAST));
+    notify(phase, link(RTM_DELLINK, ifindex + 1, peer.constData(), IFF_BROADCAST | IFF_MULTICAST));
+}
+
+class TestRouteMonitor : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void test_table();
+    void test_routeKey();
+    void test_stormReplay();
+
+private:
+    using Record = NetlinkStorm::Record;
+    QVector<Record> records_;
+
+    // CPU time of the calling thread, the replaying thread is not counted
+    static qint64 threadCpuTimeUs();
+    // sends the datagrams of the phase from a separate thread and processes the events until the monitor has read them all
+    void replayPhase(int fd, int readFd, int phase);
+};
+
+void TestRouteMonitor::initTestCase()
+{
+    records_ = NetlinkStorm().records();
+    QVERIFY(std::count_if(records_.cbegin(), records_.cend(), [](const Record &r) { return r.phase == 1; }) > 500);
+}
+
+qint64 TestRouteMonitor::threadCpuTimeUs()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    return (qint64)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+void TestRouteMonitor::replayPhase(int fd, int readFd, int phase)
+{
+    std::atomic<bool> isSent(false);
+    // the socket queue is short, send() blocks until the monitor reads the previous datagrams
+    std::thread thread([&]() {
+        for (const Record &record : records_) {
+            if (record.phase == phase)
+                send(fd, record.datagram.constData(), record.datagram.size(), 0);
+        }
+        isSent = true;
+    });
+
+    int pending = 0;
+    do {
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+        ioctl(readFd, FIONREAD, &pending);
+    } while (!isSent || pending > 0);
+    thread.join();
+}
+
+void TestRouteMonitor::test_table()
+{
+    NetlinkRouteTable_linux table;
+    for (const Record &record : records_) {
+        if (record.phase == 0)
+            table.processMessages(record.datagram.constData(), record.datagram.size());
+    }
+    const DefaultRouteInfo initial = table.defaultRoute();
+    QVERIFY(initial.isOnline);
+    QCOMPARE(initial.ifname, QString("eth0"));
+    QCOMPARE(initial.gateway, QString("192.0.2.1"));
+    QVERIFY(initial.isActive);
+    QCOMPARE(initial.macAddress.size(), 17);
+
+    // the default route is the same after each message of the storm
+    for (const Record &record : records_) {
+        if (record.phase == 1) {
+            table.processMessages(record.datagram.constData(), record.datagram.size());
+            QCOMPARE(table.defaultRoute(), initial);
+        }
+    }
+
+    for (const Record &record : records_) {
+        if (record.phase == 2)
+            table.processMessages(record.datagram.constData(), record.datagram.size());
+    }
+    const DefaultRouteInfo changed = table.defaultRoute();
+    QCOMPARE(changed.ifname, QString("wlan0"));
+    QCOMPARE(changed.gateway, QString("198.19.0.2"));
+    QVERIFY(changed.ifindex != initial.ifindex);
+}
+
+void TestRouteMonitor::test_routeKey()
+{
+    const unsigned int kRunning = IFF_UP | IFF_RUNNING | IFF_LOWER_UP;
+    const quint16 kAppend = NLM_F_CREATE | NLM_F_APPEND;
+    NetlinkRouteTable_linux table;
+    const QByteArray links = NetlinkStorm::link(RTM_NEWLINK, 2, "eth0", kRunning) + NetlinkStorm::link(RTM_NEWLINK, 3, "eth1", kRunning);
+    table.processMessages(links.constData(), links.size());
+
+    // ip route add default via 192.0.2.1 dev eth0 metric 100; ip route append default via 198.19.0.1 dev eth1 metric 100
+    // the routes differ only by the interface, both are kept
+    const QByteArray viaEth0 = NetlinkStorm::route(RTM_NEWROUTE, kAppend, RT_TABLE_MAIN, RTN_UNICAST, "0.0.0.0", 0, 2, "192.0.2.1", 100);
+    const QByteArray viaEth1 = NetlinkStorm::route(RTM_NEWROUTE, kAppend, RT_TABLE_MAIN, RTN_UNICAST, "0.0.0.0", 0, 3, "198.19.0.1", 100);
+    QVERIFY(table.processMessages(viaEth0.constData(), viaEth0.size()));
+    QVERIFY(table.processMessages(viaEth1.constData(), viaEth1.size()));
+    QCOMPARE(table.defaultRoute().ifname, QString("eth0"));
+
+    const QByteArray delEth0 = NetlinkStorm::route(RTM_DELROUTE, 0, RT_TABLE_MAIN, RTN_UNICAST, "0.0.0.0", 0, 2, "192.0.2.1", 100);
+    QVERIFY(table.processMessages(delEth0.constData(), delEth0.size()));
+    QVERIFY(table.defaultRoute().isOnline);
+    QCOMPARE(table.defaultRoute().ifname, QString("eth1"));
+
+    // a route of another table with the same destination and metric is not the default one
+    const QByteArray otherTable = NetlinkStorm::route(RTM_NEWROUTE, kAppend, 100, RTN_UNICAST, "0.0.0.0", 0, 2, "192.0.2.1", 100);
+    QVERIFY(!table.processMessages(otherTable.constData(), otherTable.size()));
+
+    // ip route replace default via 192.0.2.1 dev eth0 metric 100 replaces the route of eth1
+    const QByteArray replace = NetlinkStorm::route(RTM_NEWROUTE, NLM_F_CREATE | NLM_F_REPLACE, RT_TABLE_MAIN, RTN_UNICAST, "0.0.0.0", 0, 2, "192.0.2.1", 100);
+    QVERIFY(table.processMessages(replace.constData(), replace.size()));
+    QCOMPARE(table.defaultRoute().ifname, QString("eth0"));
+    QVERIFY(table.processMessages(delEth0.constData(), delEth0.size()));
+    QVERIFY(!table.defaultRoute().isOnline);
+}
+
+void TestRouteMonitor::test_stormReplay()
+{
+    int fds[2];
+    QVERIFY(socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, fds) == 0);
+
+    // the monitor owns and closes fds[0]
+    RouteMonitor_linux monitor;
+    QSignalSpy spy(&monitor, &RouteMonitor_linux::defaultRouteChanged);
+    monitor.startWithSocket(fds[0]);
+    QCOMPARE(spy.count(), 1);
+    QVERIFY(!spy.last().at(0).value<DefaultRouteInfo>().isOnline);
+
+    replayPhase(fds[1], fds[0], 0);
+    QTRY_COMPARE_WITH_TIMEOUT(spy.count(), 2, 2000);
+    QCOMPARE(spy.last().at(0).value<DefaultRouteInfo>().ifname, QString("eth0"));
+
+    QElapsedTimer timer;
+    timer.start();
+    const qint64 cpuTimeStart = threadCpuTimeUs();
+    replayPhase(fds[1], fds[0], 1);
+    const qint64 cpuTimeUs = threadCpuTimeUs() - cpuTimeStart;
+    const qint64 elapsedMs = timer.elapsed();
+    qDebug() << "storm of" << std::count_if(records_.cbegin(), records_.cend(), [](const Record &r) { return r.phase == 1; })
+             << "datagrams, elapsed ms:" << elapsedMs << "CPU time of the monitor thread, us:" << cpuTimeUs;
+    QVERIFY(elapsedMs < 2000);
+    QVERIFY(cpuTimeUs < 500000);
+
+    // nothing is emitted for the storm, even after the longest debounce delay
+    QTest::qWait(1500);
+    QCOMPARE(spy.count(), 2);
+
+    // the switch to another interface consists of several messages, they result in one signal
+    replayPhase(fds[1], fds[0], 2);
+    QTRY_COMPARE_WITH_TIMEOUT(spy.count(), 3, 2000);
+    const DefaultRouteInfo info = spy.last().at(0).value<DefaultRouteInfo>();
+    QCOMPARE(info.ifname, QString("wlan0"));
+    QCOMPARE(info.gateway, QString("198.19.0.2"));
+    QTest::qWait(1500);
+    QCOMPARE(spy.count(), 3);
+
+    monitor.finish();
+    close(fds[1]);
+}
+
+QTEST_MAIN(TestRouteMonitor)
+#include "routemonitor.test.moc"
@@ -0,0 +1,317 @@
+#include "pmtuprober_posix.h"
+
+#include <QtGlobal>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#if defined(Q_OS_LINUX)
+#include <linux/errqueue.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+#include "pmtusearch.h"
+#include "engine/ping/icmp_header.h"
+
+namespace {
+
+// the IPv4 and ICMP headers, the sizes are ICMP payload sizes
+constexpr int kHeadersSize = 28;
+
+int elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return (int)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// skips the IP header, raw sockets (and ping sockets on Mac) deliver it too
+const unsigned char *skipIpHeader(const unsigned char *data, ssize_t &len)
+{
+    if (len > 0 && (data[0] & 0xF0) == 0x40) {
+        const int ipHeaderLen = (data[0] & 0x0F) * 4;
+        if (len < ipHeaderLen)
+            return nullptr;
+        len -= ipHeaderLen;
+        return data + ipHeaderLen;
+    }
+    return data;
+}
+
+} // namespace
+
+PmtuProber_posix::PmtuProber_posix(const Settings &settings)
+    : settings_(settings),
+      socket_(-1),
+      isRawSocket_(false),
+      isKernelIdentifier_(false),
+      identifier_(std::random_device()() & 0xFFFF),
+      nextSequence_(0),
+      hintFromRouter_(0)
+{
+    if (!openSocket(SOCK_DGRAM) && !openSocket(SOCK_RAW))
+        return;
+#if defined(Q_OS_LINUX)
+    isKernelIdentifier_ = !isRawSocket_;
+#endif
+}
+
+PmtuProber_posix::~PmtuProber_posix()
+{
+    if (socket_ != -1)
+        close(socket_);
+}
+
+PmtuProber_posix::Result PmtuProber_posix::probe(const std::string &ip, const std::function<bool()> &isStopped)
+{
+    const auto start = std::chrono::steady_clock::now();
+    Result result;
+    struct in_addr addr;
+    if (socket_ == -1 || inet_pton(AF_INET, ip.c_str(), &addr) != 1)
+        return result;
+
+    PmtuSearch search(settings_.minSize, settings_.maxSize, settings_.step, settings_.hintSize);
+    while (!search.isFinished()) {
+        if (isStopped && isStopped())
+            break;
+        const std::vector<int> sizes = search.nextProbes(settings_.parallelProbes);
+        if (sizes.empty())
+            break;
+
+        hintFromRouter_ = 0;
+        const std::vector<bool> passed = runRound(addr.s_addr, sizes, isStopped, result.probesCount);
+        for (size_t i = 0; i < sizes.size(); ++i)
+            search.setResult(sizes[i], passed[i]);
+        if (hintFromRouter_ > 0)
+            search.setHint(hintFromRouter_ - kHeadersSize);
+        result.roundsCount++;
+    }
+
+    if (search.isFinished())
+        result.size = search.result();
+    result.elapsedMs = elapsedMs(start);
+    return result;
+}
+
+bool PmtuProber_posix::openSocket(int type)
+{
+    int fd = socket(AF_INET, type, IPPROTO_ICMP);
+    if (fd < 0)
+        return false;
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+#if defined(Q_OS_LINUX)
+    // DF is set and the cached path MTU is ignored, so the probes larger than it are still sent
+    int pmtuDiscover = IP_PMTUDISC_PROBE;
+    setsockopt(fd, IPPROTO_IP, IP_MTU_DISCOVER, &pmtuDiscover, sizeof(pmtuDiscover));
+    if (!settings_.isPacketizationLayer) {
+        int on = 1;
+        setsockopt(fd, IPPROTO_IP, IP_RECVERR, &on, sizeof(on));
+    }
+#elif defined(Q_OS_MACOS)
+    int on = 1;
+    setsockopt(fd, IPPROTO_IP, IP_DONTFRAG, &on, sizeof(on));
+#endif
+
+    socket_ = fd;
+    isRawSocket_ = (type == SOCK_RAW);
+    return true;
+}
+
+std::vector<bool> PmtuProber_posix::runRound(unsigned int ip, const std::vector<int> &sizes, const std::function<bool()> &isStopped, int &outProbesCount)
+{
+    const int copies = settings_.isPacketizationLayer ? kCopiesPerSizePlpmtud : kCopiesPerSize;
+    std::vector<Probe> probes;
+    std::vector<bool> passed(sizes.size(), false);
+    std::vector<int> failedCopies(sizes.size(), 0);
+    // the smallest size which is known to be too big, the larger ones are too
+    int tooBigInd = (int)sizes.size();
+
+    for (int c = 0; c < copies; ++c) {
+        for (size_t i = 0; i < sizes.size(); ++i) {
+            const unsigned short sequence = nextSequence_++;
+            bool isTooBig = false;
+            const bool isSent = sendProbe(ip, sizes[i], sequence, isTooBig);
+            outProbesCount++;
+            probes.push_back({ (int)i, sequence, !isSent });
+            if (!isSent) {
+                failedCopies[i]++;
+                if (isTooBig)
+                    tooBigInd = std::min(tooBigInd, (int)i);
+            }
+        }
+    }
+
+    auto isDecided = [&]() {
+        for (size_t i = 0; i < sizes.size(); ++i) {
+            // a larger size passed, so this one would too
+            const bool isPassed = std::any_of(passed.begin() + i, passed.end(), [](bool b) { return b; });
+            if (!isPassed && (int)i < tooBigInd && failedCopies[i] < copies)
+                return false;
+        }
+        return true;
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    while (!isDecided()) {
+        const int remainingMs = settings_.timeoutMs - elapsedMs(start);
+        if (remainingMs <= 0 || (isStopped && isStopped()))
+            break;
+
+        struct pollfd pfd;
+        pfd.fd = socket_;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        // wake up now and then to check isStopped
+        if (poll(&pfd, 1, std::min(remainingMs, 100)) <= 0)
+            continue;
+
+        std::vector<unsigned short> passedSequences;
+        std::vector<unsigned short> failedSequences;
+        if (pfd.revents & POLLERR)
+            readErrors(failedSequences);
+        if (pfd.revents & POLLIN)
+            readReplies(passedSequences, failedSequences);
+
+        for (auto &probe : probes) {
+            if (std::find(passedSequences.begin(), passedSequences.end(), probe.sequence) != passedSequences.end()) {
+                passed[probe.sizeInd] = true;
+            } else if (!probe.isFailed && std::find(failedSequences.begin(), failedSequences.end(), probe.sequence) != failedSequences.end()) {
+                // an error from a router, the size is too big for the path
+                probe.isFailed = true;
+                failedCopies[probe.sizeInd]++;
+                tooBigInd = std::min(tooBigInd, probe.sizeInd);
+            }
+        }
+    }
+
+    // a larger size passed, so did the smaller ones (their replies may be still on the way)
+    for (int i = (int)sizes.size() - 2; i >= 0; --i)
+        passed[i] = passed[i] || passed[i + 1];
+    return passed;
+}
+
+bool PmtuProber_posix::sendProbe(unsigned int ip, int size, unsigned short sequence, bool &outIsTooBig)
+{
+    static const std::vector<unsigned char> body(kMaxSize, 0xA5);
+    size = std::min(size, kMaxSize);
+
+    icmp_header header;
+    header.type(icmp_header::echo_request);
+    header.code(0);
+    header.identifier(identifier_);
+    header.sequence_number(sequence);
+    compute_checksum(header, body.begin(), body.begin() + size);
+
+    std::vector<unsigned char> packet(8 + size);
+    memcpy(packet.data(), &header, 8);
+    memcpy(packet.data() + 8, body.data(), size);
+
+    struct sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = ip;
+
+    // with IP_RECVERR the error of an earlier probe is also reported by the next send (which is not sent then),
+    // the error itself is read from the error queue, so try again
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        if (sendto(socket_, packet.data(), packet.size(), 0, (struct sockaddr *)&to, sizeof(to)) >= 0)
+            return true;
+    }
+    // larger than the MTU of the local interface
+    outIsTooBig = (errno == EMSGSIZE);
+    return false;
+}
+
+void PmtuProber_posix::readReplies(std::vector<unsigned short> &outPassed, std::vector<unsigned short> &outFailed)
+{
+    std::vector<unsigned char> buf(kMaxSize + 128);
+    while (true) {
+        struct sockaddr_in from;
+        socklen_t fromLen = sizeof(from);
+        ssize_t len = recvfrom(socket_, buf.data(), buf.size(), 0, (struct sockaddr *)&from, &fromLen);
+        if (len < 0)
+            break;
+
+        const unsigned char *icmp = skipIpHeader(buf.data(), len);
+        if (!icmp || len < 8)
+            continue;
+        icmp_header header;
+        memcpy(&header, icmp, 8);
+
+        if (header.type() == icmp_header::echo_reply) {
+            if (isKernelIdentifier_ || header.identifier() == identifier_)
+                outPassed.push_back(header.sequence_number());
+            continue;
+        }
+
+        // "fragmentation needed" with the header of our echo request, delivered to raw sockets
+        if (header.type() != icmp_header::destination_unreachable || header.code() != 4 || settings_.isPacketizationLayer)
+            continue;
+        ssize_t innerLen = len - 8;
+        const unsigned char *inner = skipIpHeader(icmp + 8, innerLen);
+        if (!inner || innerLen < 8)
+            continue;
+        icmp_header innerHeader;
+        memcpy(&innerHeader, inner, 8);
+        if (innerHeader.type() == icmp_header::echo_request && (isKernelIdentifier_ || innerHeader.identifier() == identifier_)) {
+            outFailed.push_back(innerHeader.sequence_number());
+            const int mtu = (icmp[6] << 8) | icmp[7];
+            if (mtu > 0 && (hintFromRouter_ == 0 || mtu < hintFromRouter_))
+                hintFromRouter_ = mtu;
+        }
+    }
+}
+
+void PmtuProber_posix::readErrors(std::vector<unsigned short> &outFailed)
+{
+#if defined(Q_OS_LINUX)
+    // the errors of ping sockets come through the error queue, the data is the header of our echo request
+    unsigned char buf[64];
+    char control[512];
+    while (true) {
+        struct iovec iov;
+        iov.iov_base = buf;
+        iov.iov_len = sizeof(buf);
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        ssize_t len = recvmsg(socket_, &msg, MSG_ERRQUEUE);
+        if (len < 0)
+            break;
+
+        const struct sock_extended_err *err = nullptr;
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_RECVERR)
+                err = (const struct sock_extended_err *)CMSG_DATA(cmsg);
+        }
+        if (!err || err->ee_errno != EMSGSIZE)
+            continue;
+
+        const unsigned char *icmp = skipIpHeader(buf, len);
+        if (!icmp || len < 8)
+            continue;
+        icmp_header header;
+        memcpy(&header, icmp, 8);
+        if (header.type() != icmp_header::echo_request || (!isKernelIdentifier_ && header.identifier() != identifier_))
+            continue;
+        outFailed.push_back(header.sequence_number());
+        if (err->ee_origin == SO_EE_ORIGIN_ICMP && err->ee_info > 0 && (hintFromRouter_ == 0 || (int)err->ee_info < hintFromRouter_))
+            hintFromRouter_ = err->ee_info;
+    }
+#else
+    Q_UNUSED(outFailed);
+#endif
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Path MTU discovery for Linux and Mac with ICMP echo probes sent with the DF bit (IP_PMTUDISC_PROBE / IP_DONTFRAG).
+// All the probes of a search round are in flight at once on one socket (a ping socket, or a raw one if allowed),
+// so the search takes a few round trips instead of one ping per size.
+// In the default mode the ICMP "fragmentation needed" errors are used: a probe fails as soon as the error arrives
+// and the MTU reported by the router becomes the hint of the next round.
+// In the packetization layer mode (PLPMTUD, RFC 4821), e.g. over the tunnel where the ICMP errors do not come back,
+// only the echo replies count: a size fails if none of its probes is answered within the timeout.
+class PmtuProber_posix
+{
+public:
+    struct Settings
+    {
+        int minSize = 1300;
+        int maxSize = 1470;
+        int step = 10;
+        int parallelProbes = 4;         // sizes per round
+        int timeoutMs = 1000;
+        int hintSize = 0;               // the cached result for the network, 0 if none
+        bool isPacketizationLayer = false;
+    };
+
+    struct Result
+    {
+        int size = -1;                  // -1 if no size passed
+        int probesCount = 0;            // echo requests sent
+        int roundsCount = 0;
+        int elapsedMs = 0;
+    };
+
+    explicit PmtuProber_posix(const Settings &settings);
+    ~PmtuProber_posix();
+    PmtuProber_posix(const PmtuProber_posix &) = delete;
+    PmtuProber_posix &operator=(const PmtuProber_posix &) = delete;
+
+    bool isAvailable() const { return socket_ != -1; }
+
+    // blocks until the search is finished; isStopped is checked between the rounds and while waiting for the replies
+    Result probe(const std::string &ip, const std::function<bool()> &isStopped = nullptr);
+
+private:
+    static constexpr int kCopiesPerSize = 2;            // a lost probe does not fail the size
+    static constexpr int kCopiesPerSizePlpmtud = 3;     // the only signal is the reply, be more tolerant to loss
+    static constexpr int kMaxSize = 9000;
+
+    struct Probe
+    {
+        int sizeInd;
+        unsigned short sequence;
+        bool isFailed;
+    };
+
+    Settings settings_;
+    int socket_;
+    bool isRawSocket_;
+    bool isKernelIdentifier_;
+    unsigned short identifier_;
+    unsigned short nextSequence_;
+    int hintFromRouter_;
+
+    bool openSocket(int type);
+    // returns for each size whether it passed
+    std::vector<bool> runRound(unsigned int ip, const std::vector<int> &sizes, const std::function<bool()> &isStopped, int &outProbesCount);
+    bool sendProbe(unsigned int ip, int size, unsigned short sequence, bool &outIsTooBig);
+    // reads the replies and the errors, returns the sequence numbers of the passed and failed probes
+    void readReplies(std::vector<unsigned short> &outPassed, std::vector<unsigned short> &outFailed);
+    void readErrors(std::vector<unsigned short> &outFailed);
+};
@@ -0,0 +1,108 @@
+#include "pmtusearch.h"
+
+#include <algorithm>
+
+PmtuSearch::PmtuSearch(int minSize, int maxSize, int step, int hintSize) : hintInd_(-1)
+{
+    for (int size = maxSize; size >= minSize; size -= step)
+        sizes_.push_back(size);
+    std::reverse(sizes_.begin(), sizes_.end());
+    states_.resize(sizes_.size(), State::UNKNOWN);
+    if (hintSize > 0)
+        setHint(hintSize);
+}
+
+bool PmtuSearch::isFinished() const
+{
+    int low, high;
+    bounds(low, high);
+    return high == low + 1;
+}
+
+int PmtuSearch::result() const
+{
+    int low, high;
+    bounds(low, high);
+    return low >= 0 ? sizes_[low] : -1;
+}
+
+std::vector<int> PmtuSearch::nextProbes(int maxCount) const
+{
+    int low, high;
+    bounds(low, high);
+
+    std::vector<int> indexes;
+    auto addIndex = [&](int ind) {
+        if (ind > low && ind < high && (int)indexes.size() < maxCount && states_[ind] == State::UNKNOWN &&
+            std::find(indexes.begin(), indexes.end(), ind) == indexes.end())
+            indexes.push_back(ind);
+    };
+
+    // the hint and the size above it prove the hint in one round
+    if (hintInd_ >= 0) {
+        addIndex(hintInd_);
+        addIndex(hintInd_ + 1);
+    }
+    // most paths pass the largest size
+    if (high == (int)sizes_.size())
+        addIndex(high - 1);
+
+    // split the rest of the interval evenly
+    const int freeCount = maxCount - (int)indexes.size();
+    const int unknownCount = high - low - 1;
+    for (int i = 1; i <= freeCount; ++i)
+        addIndex(low + (i * (unknownCount + 1) + freeCount / 2) / (freeCount + 1));
+    // the rounding may have produced duplicates, fill the remaining slots from the middle
+    for (int i = 0; (int)indexes.size() < std::min(maxCount, unknownCount) && i < unknownCount; ++i)
+        addIndex(low + 1 + (unknownCount / 2 + i) % unknownCount);
+
+    std::vector<int> result;
+    for (int ind : indexes)
+        result.push_back(sizes_[ind]);
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+void PmtuSearch::setResult(int size, bool isPassed)
+{
+    const int ind = indexOf(size);
+    if (ind < 0)
+        return;
+    // a passed probe is never overridden by a lost one
+    if (isPassed)
+        states_[ind] = State::PASSED;
+    else if (states_[ind] == State::UNKNOWN)
+        states_[ind] = State::FAILED;
+}
+
+void PmtuSearch::setHint(int size)
+{
+    // the largest grid size not above the hint
+    hintInd_ = -1;
+    for (int i = 0; i < (int)sizes_.size() && sizes_[i] <= size; ++i)
+        hintInd_ = i;
+}
+
+int PmtuSearch::indexOf(int size) const
+{
+    const auto it = std::lower_bound(sizes_.begin(), sizes_.end(), size);
+    return it != sizes_.end() && *it == size ? int(it - sizes_.begin()) : -1;
+}
+
+void PmtuSearch::bounds(int &outLow, int &outHigh) const
+{
+    outLow = -1;
+    for (int i = (int)states_.size() - 1; i >= 0; --i) {
+        if (states_[i] == State::PASSED) {
+            outLow = i;
+            break;
+        }
+    }
+    outHigh = (int)states_.size();
+    for (int i = outLow + 1; i < (int)states_.size(); ++i) {
+        if (states_[i] == State::FAILED) {
+            outHigh = i;
+            break;
+        }
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+
+// Search for the largest packet size which passes the path, over the grid maxSize, maxSize - step, ... >= minSize
+// (the sizes are ICMP payload sizes, as for "ping -s").
+// The search keeps the result of every probed size: the answer is above the largest size which passed and below the
+// smallest larger size which failed. nextProbes() splits this interval evenly, so with k probes per round the search
+// takes log(k+1) of the grid size rounds. A late reply (a size passed above a failed one) wins over the failure,
+// the failure was a lost probe.
+class PmtuSearch
+{
+public:
+    // hintSize is a size which is likely the answer (the cached result for the network), 0 if unknown
+    PmtuSearch(int minSize, int maxSize, int step, int hintSize = 0);
+
+    bool isFinished() const;
+    // the largest size which passed, -1 if none passed (or none was probed yet)
+    int result() const;
+
+    // the sizes to probe in the next round, at most maxCount
+    std::vector<int> nextProbes(int maxCount) const;
+    void setResult(int size, bool isPassed);
+    // a better guess, e.g. from the MTU reported by a router in an ICMP "fragmentation needed" message
+    void setHint(int size);
+
+private:
+    enum class State { UNKNOWN, PASSED, FAILED };
+
+    std::vector<int> sizes_;        // ascending
+    std::vector<State> states_;
+    int hintInd_;
+
+    int indexOf(int size) const;
+    // the largest passed index and the smallest failed index above it
+    void bounds(int &outLow, int &outHigh) const;
+};
@@ -0,0 +1,147 @@
+#include <QtTest>
+
+#include <sched.h>
+#include <unistd.h>
+
+#include "engine/packetsize/pmtuprober_posix.h"
+#include "engine/packetsize/pmtusearch.h"
+
+// PmtuSearch against every path MTU of the range, and PmtuProber_posix in network namespaces:
+// client <-> router <-> server, the link from the router to the server has the MTU of the WS_PMTU_BOTTLENECK
+// environment variable (1400 by default). Reports the probes, the rounds and the time to converge, next to the pings
+// the sequential search (1470, 1460, ... one at a time) would take. The namespaces need root, skipped otherwise.
+class TestPmtuProber : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void testSearch();
+    void testIcmpErrors();
+    void testPacketizationLayer();
+    void testHint();
+
+private:
+    static constexpr int kMinSize = 1300;
+    static constexpr int kMaxSize = 1470;
+    static constexpr int kStep = 10;
+    static constexpr const char *kServerIp = "10.77.2.2";
+
+    bool isNetworkReady_ = false;
+    int bottleneckMtu_ = 1400;
+
+    static bool run(const QString &command);
+    // the size the search must find for the path MTU, -1 if even the smallest one does not pass
+    static int expectedSize(int mtu);
+    void probe(const char *name, const PmtuProber_posix::Settings &settings);
+};
+
+bool TestPmtuProber::run(const QString &command)
+{
+    return QProcess::execute("/bin/sh", QStringList() << "-c" << command) == 0;
+}
+
+int TestPmtuProber::expectedSize(int mtu)
+{
+    for (int size = kMaxSize; size >= kMinSize; size -= kStep) {
+        if (size + 28 <= mtu)
+            return size;
+    }
+    return -1;
+}
+
+void TestPmtuProber::initTestCase()
+{
+    bool isOk = false;
+    const int mtu = qEnvironmentVariableIntValue("WS_PMTU_BOTTLENECK", &isOk);
+    if (isOk)
+        bottleneckMtu_ = mtu;
+
+    // the test process itself is the client, in a namespace of its own
+    if (geteuid() != 0 || unshare(CLONE_NEWNET) != 0)
+        return;
+    run("ip netns del ws_pmtu_router; ip netns del ws_pmtu_server");
+    isNetworkReady_ = run(QString(
+        "set -e;"
+        "ip netns add ws_pmtu_router; ip netns add ws_pmtu_server;"
+        "ip link add c0 type veth peer name r0 netns ws_pmtu_router;"
+        "ip -n ws_pmtu_router link add r1 type veth peer name s0 netns ws_pmtu_server;"
+        "ip addr add 10.77.1.2/24 dev c0; ip link set lo up; ip link set c0 up;"
+        "ip route add default via 10.77.1.1;"
+        "ip -n ws_pmtu_router addr add 10.77.1.1/24 dev r0; ip -n ws_pmtu_router addr add 10.77.2.1/24 dev r1;"
+        "ip -n ws_pmtu_router link set r1 mtu %1; ip -n ws_pmtu_router link set r0 up; ip -n ws_pmtu_router link set r1 up;"
+        "ip netns exec ws_pmtu_router sysctl -qw net.ipv4.ip_forward=1;"
+        "ip -n ws_pmtu_server addr add %2/24 dev s0; ip -n ws_pmtu_server link set s0 mtu %1;"
+        "ip -n ws_pmtu_server link set lo up; ip -n ws_pmtu_server link set s0 up;"
+        "ip -n ws_pmtu_server route add default via 10.77.2.1").arg(bottleneckMtu_).arg(kServerIp));
+}
+
+void TestPmtuProber::cleanupTestCase()
+{
+    if (isNetworkReady_)
+        run("ip netns del ws_pmtu_router; ip netns del ws_pmtu_server");
+}
+
+void TestPmtuProber::testSearch()
+{
+    int maxRounds = 0;
+    for (int mtu = 1280; mtu <= 1500; ++mtu) {
+        for (int hint : { 0, expectedSize(mtu), 1350 }) {
+            PmtuSearch search(kMinSize, kMaxSize, kStep, hint);
+            int rounds = 0;
+            while (!search.isFinished()) {
+                const std::vector<int> sizes = search.nextProbes(4);
+                if (sizes.empty())
+                    break;
+                for (int size : sizes)
+                    search.setResult(size, size + 28 <= mtu);
+                rounds++;
+            }
+            QVERIFY(search.isFinished());
+            QCOMPARE(search.result(), expectedSize(mtu));
+            if (hint > 0 && hint == expectedSize(mtu))
+                QCOMPARE(rounds, 1);
+            maxRounds = qMax(maxRounds, rounds);
+        }
+    }
+    // 18 sizes, 4 probes per round
+    QVERIFY(maxRounds <= 3);
+}
+
+void TestPmtuProber::probe(const char *name, const PmtuProber_posix::Settings &settings)
+{
+    if (!isNetworkReady_)
+        QSKIP("needs root to create the network namespaces");
+
+    PmtuProber_posix prober(settings);
+    QVERIFY(prober.isAvailable());
+    const PmtuProber_posix::Result result = prober.probe(kServerIp);
+    QCOMPARE(result.size, expectedSize(bottleneckMtu_));
+
+    const int sequentialPings = (kMaxSize - (result.size > 0 ? result.size : kMinSize - kStep)) / kStep + 1;
+    printf("%s, MTU %d: size %d, probes %d, rounds %d, time %d ms (sequential search: %d pings)\n", name,
+           bottleneckMtu_, result.size, result.probesCount, result.roundsCount, result.elapsedMs, sequentialPings);
+}
+
+void TestPmtuProber::testIcmpErrors()
+{
+    probe("ICMP errors", PmtuProber_posix::Settings());
+}
+
+void TestPmtuProber::testPacketizationLayer()
+{
+    PmtuProber_posix::Settings settings;
+    settings.isPacketizationLayer = true;
+    probe("PLPMTUD", settings);
+}
+
+void TestPmtuProber::testHint()
+{
+    PmtuProber_posix::Settings settings;
+    settings.hintSize = expectedSize(bottleneckMtu_);
+    probe("cached hint", settings);
+}
+
+QTEST_MAIN(TestPmtuProber)
+#include "pmtuprober.test.moc"
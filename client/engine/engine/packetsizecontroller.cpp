@@ -1,9 +1,16 @@
 #include "packetsizecontroller.h"
 
+#include <QHostInfo>
+
+#include "packetsize/pmtusearch.h"
 #include "utils/ipvalidation.h"
 #include "utils/logger.h"
 #include "utils/utils.h"
 
+#ifdef Q_OS_UNIX
+    #include "packetsize/pmtuprober_posix.h"
+#endif
+
 PacketSizeController::PacketSizeController(QObject *parent)
     : QObject(parent),
       earlyStop_(false)
@@ -30,10 +37,10 @@ void PacketSizeController::setPacketSize(const types::PacketSize &packetSize)
     setPacketSizeImpl(packetSize);
 }
 
-void PacketSizeController::detectAppropriatePacketSize(const QString &hostname)
+void PacketSizeController::detectAppropriatePacketSize(const QString &hostname, const QString &networkKey, bool isOverTunnel)
 {
     QMutexLocker locker(&mutex_);
-    QMetaObject::invokeMethod(this, "detectAppropriatePacketSizeImpl", Q_ARG(QString, hostname));
+    QMetaObject::invokeMethod(this, "detectAppropriatePacketSizeImpl", Q_ARG(QString, hostname), Q_ARG(QString, networkKey), Q_ARG(bool, isOverTunnel));
 }
 
 void PacketSizeController::earlyStop()
@@ -51,15 +58,18 @@ void PacketSizeController::setPacketSizeImpl(const types::PacketSize &packetSize
     }
 }
 
-void PacketSizeController::detectAppropriatePacketSizeImpl(const QString &hostname)
+void PacketSizeController::detectAppropriatePacketSizeImpl(const QString &hostname, const QString &networkKey, bool isOverTunnel)
 {
     {
         QMutexLocker locker(&mutex_);
         earlyStop_ = false;
     }
 
-    const int mtu = getIdealPacketSize(hostname);
+    const QPair<QString, bool> cacheKey(networkKey, isOverTunnel);
+    const int mtu = getIdealPacketSize(hostname, cachedSizes_.value(cacheKey, 0), isOverTunnel);
     const bool is_error = mtu < 0;
+    if (mtu > 0)
+        cachedSizes_[cacheKey] = mtu;
 
     QMutexLocker locker(&mutex_);
     if (mtu > 0)
@@ -74,9 +84,14 @@ void PacketSizeController::detectAppropriatePacketSizeImpl(const QString &hostna
     emit finishedPacketSizeDetection(is_error);
 }
 
-int PacketSizeController::getIdealPacketSize(const QString &hostname)
+bool PacketSizeController::isEarlyStop()
+{
+    QMutexLocker locker(&mutex_);
+    return earlyStop_;
+}
+
+int PacketSizeController::getIdealPacketSize(const QString &hostname, int hintSize, bool isOverTunnel)
 {
-    int mtu = 1470;
     QString modifiedHostname = hostname;
 
     // if this is IP, use without change
@@ -91,28 +106,70 @@ int PacketSizeController::getIdealPacketSize(const QString &hostname)
 
     }
 
-    qCDebug(LOG_PACKET_SIZE) << "Detecting packet size via:" << modifiedHostname;
+    qCDebug(LOG_PACKET_SIZE) << "Detecting packet size via:" << modifiedHostname << "hint:" << hintSize << "over tunnel:" << isOverTunnel;
 
-    bool success = false;
-    while (mtu >= 1300)
+    // the probes of all the sizes go to the same address
+    QString ip = modifiedHostname;
+    if (!IpValidation::isIp(modifiedHostname))
     {
-        QMutexLocker locker(&mutex_);
-        if (earlyStop_)
+        const QHostInfo hostInfo = QHostInfo::fromName(modifiedHostname);
+        for (const QHostAddress &address : hostInfo.addresses())
+        {
+            if (address.protocol() == QAbstractSocket::IPv4Protocol)
+            {
+                ip = address.toString();
+                break;
+            }
+        }
+        if (ip == modifiedHostname)
         {
-            qCDebug(LOG_PACKET_SIZE) << "Exiting packet size detection loop early";
-            break;
+            qCDebug(LOG_PACKET_SIZE) << "Couldn't resolve" << modifiedHostname << "-- check internet connection";
+            return -1;
         }
+    }
 
-        bool pingSuccess = Utils::pingWithMtu(modifiedHostname, mtu);
-        if (pingSuccess)
+    int mtu = -1;
+#ifdef Q_OS_UNIX
+    PmtuProber_posix::Settings settings;
+    settings.minSize = kMinSize;
+    settings.maxSize = kMaxSize;
+    settings.step = kStep;
+    settings.hintSize = hintSize;
+    settings.isPacketizationLayer = isOverTunnel;
+    PmtuProber_posix prober(settings);
+    if (prober.isAvailable())
+    {
+        const PmtuProber_posix::Result result = prober.probe(ip.toStdString(), [this]() { return isEarlyStop(); });
+        qCDebug(LOG_PACKET_SIZE) << "Probes:" << result.probesCount << "rounds:" << result.roundsCount << "time, ms:" << result.elapsedMs;
+        mtu = result.size;
+    }
+    else
+#endif
+    {
+        // one ping at a time, but still a bisection instead of trying every size from the largest one
+        Q_UNUSED(isOverTunnel);
+        PmtuSearch search(kMinSize, kMaxSize, kStep, hintSize);
+        int probesCount = 0;
+        while (!search.isFinished() && !isEarlyStop())
         {
-            success = true;
-            break;
+            const std::vector<int> sizes = search.nextProbes(1);
+            if (sizes.empty())
+                break;
+            search.setResult(sizes.front(), Utils::pingWithMtu(ip, sizes.front()));
+            probesCount++;
         }
-        mtu -= 10;
+        qCDebug(LOG_PACKET_SIZE) << "Probes:" << probesCount;
+        if (search.isFinished())
+            mtu = search.result();
+    }
+
+    if (isEarlyStop())
+    {
+        qCDebug(LOG_PACKET_SIZE) << "Exiting packet size detection loop early";
+        return -1;
     }
 
-    if (!success)
+    if (mtu < 0)
     {
         qCDebug(LOG_PACKET_SIZE) << "Couldn't find appropriate MTU -- check internet connection";
         return -1;
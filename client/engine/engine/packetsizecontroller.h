@@ -1,5 +1,7 @@
 #pragma once
 
+#include <QHash>
+#include <QPair>
 #include <QObject>
 #include <QMutex>
 #include "types/packetsize.h"
@@ -15,7 +17,9 @@ public:
     explicit PacketSizeController(QObject *parent = nullptr);
 
     void setPacketSize(const types::PacketSize &packetSize);
-    void detectAppropriatePacketSize(const QString &hostname);
+    // networkKey identifies the network (SSID or the network name) for the cache of the results;
+    // isOverTunnel selects the packetization layer mode, the ICMP errors do not come back through the tunnel
+    void detectAppropriatePacketSize(const QString &hostname, const QString &networkKey, bool isOverTunnel);
     void earlyStop();
 
 signals:
@@ -27,17 +31,25 @@ public slots:
     void finish();
 
 private slots:
-    void detectAppropriatePacketSizeImpl(const QString &hostname);
+    void detectAppropriatePacketSizeImpl(const QString &hostname, const QString &networkKey, bool isOverTunnel);
 
 private:
+    // the sizes are ICMP payload sizes
+    static constexpr int kMinSize = 1300;
+    static constexpr int kMaxSize = 1470;
+    static constexpr int kStep = 10;
+
     QMutex mutex_;
     bool earlyStop_;
     types::PacketSize packetSize_;
+    // the last detected size per network and mode (over the tunnel or not), the search starts from it
+    QHash<QPair<QString, bool>, int> cachedSizes_;
 
 #ifdef Q_OS_WIN
     QScopedPointer<Debug::CrashHandlerForThread> crashHandler_;
 #endif
 
     void setPacketSizeImpl(const types::PacketSize &packetSize);
-    int getIdealPacketSize(const QString &hostname);
+    int getIdealPacketSize(const QString &hostname, int hintSize, bool isOverTunnel);
+    bool isEarlyStop();
 };
@@ -11,6 +11,9 @@ const int typeIdPingType = qRegisterMetaType<PingHost::PING_TYPE>("PingHost::PIN
 
 PingHost::PingHost(QObject *parent, IConnectStateController *stateController, NetworkAccessManager *networkAccessManager) : QObject(parent),
     pingHostCurl_(this, stateController, networkAccessManager), pingHostTcp_(this, stateController), pingHostIcmp_(this, stateController)
+#ifndef Q_OS_WIN
+    , pingHostIcmpSocket_(this, stateController)
+#endif
 {
     connect(&pingHostCurl_, &PingHost_Curl::pingFinished, this, &PingHost::pingFinished);
     connect(&pingHostTcp_, &PingHost_TCP::pingFinished, this, &PingHost::pingFinished);
@@ -18,6 +21,7 @@ PingHost::PingHost(QObject *parent, IConnectStateController *stateController, Ne
     connect(&pingHostIcmp_, &PingHost_ICMP_win::pingFinished, this, &PingHost::pingFinished);
 #else
     connect(&pingHostIcmp_, &PingHost_ICMP_mac::pingFinished, this, &PingHost::pingFinished);
+    connect(&pingHostIcmpSocket_, &PingHost_ICMP_socket::pingFinished, this, &PingHost::pingFinished);
 #endif
 }
 
@@ -74,7 +78,10 @@ void PingHost::addHostForPingImpl(const QString &id, const QString &ip, PING_TYP
         pingHostTcp_.addHostForPing(id, ip);
     }
     else if (pingType == PING_ICMP) {
-        pingHostIcmp_.addHostForPing(id, ip);
+        if (pingHostIcmpSocket_.isAvailable())
+            pingHostIcmpSocket_.addHostForPing(id, ip);
+        else
+            pingHostIcmp_.addHostForPing(id, ip);
     }
     else {
         WS_ASSERT(false);
@@ -87,6 +94,9 @@ void PingHost::clearPingsImpl()
     pingHostCurl_.clearPings();
     pingHostTcp_.clearPings();
     pingHostIcmp_.clearPings();
+#ifndef Q_OS_WIN
+    pingHostIcmpSocket_.clearPings();
+#endif
 }
 
 void PingHost::setProxySettingsImpl(const types::ProxySettings &proxySettings)
@@ -94,6 +104,9 @@ void PingHost::setProxySettingsImpl(const types::ProxySettings &proxySettings)
     pingHostCurl_.setProxySettings(proxySettings);
     pingHostTcp_.setProxySettings(proxySettings);
     pingHostIcmp_.setProxySettings(proxySettings);
+#ifndef Q_OS_WIN
+    pingHostIcmpSocket_.setProxySettings(proxySettings);
+#endif
 }
 
 void PingHost::disableProxyImpl()
@@ -101,6 +114,9 @@ void PingHost::disableProxyImpl()
     pingHostCurl_.disableProxy();
     pingHostTcp_.disableProxy();
     pingHostIcmp_.disableProxy();
+#ifndef Q_OS_WIN
+    pingHostIcmpSocket_.disableProxy();
+#endif
 }
 
 void PingHost::enableProxyImpl()
@@ -108,4 +124,7 @@ void PingHost::enableProxyImpl()
     pingHostCurl_.enableProxy();
     pingHostTcp_.enableProxy();
     pingHostIcmp_.enableProxy();
+#ifndef Q_OS_WIN
+    pingHostIcmpSocket_.enableProxy();
+#endif
 }
@@ -9,6 +9,7 @@
     #include "utils/crashhandler.h"
 #else
     #include "pinghost_icmp_mac.h"
+    #include "pinghost_icmp_socket.h"
 #endif
 
 class NetworkAccessManager;
@@ -50,5 +51,7 @@ private:
     QScopedPointer<Debug::CrashHandlerForThread> crashHandler_;
 #else
     PingHost_ICMP_mac pingHostIcmp_;
+    // used instead of pingHostIcmp_ if the ICMP socket can be opened
+    PingHost_ICMP_socket pingHostIcmpSocket_;
 #endif
 };
@@ -24,6 +24,8 @@ void PingHost_Curl::addHostForPing(const QString &id, const QString &ip, const Q
     networkRequest.setOverrideIp(ip);
     // We add all ips to the firewall exceptions at once in the EngineLocationsModel, so there is no need to do it NetworkAccessManager
     networkRequest.setIsWhiteListIps(false);
+    // the measured time must include the connection setup, so never reuse a pooled connection
+    networkRequest.setUseFreshConnection(true);
     NetworkReply *reply = networkAccessManager_->get(networkRequest);
     connect(reply, &NetworkReply::finished, this, &PingHost_Curl::onNetworkRequestFinished);
     reply->setProperty("id", id);
@@ -0,0 +1,331 @@
+#include "pinghost_icmp_socket.h"
+
+#include <QRandomGenerator>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "icmp_header.h"
+#include "utils/ipvalidation.h"
+#include "utils/logger.h"
+#include "utils/ws_assert.h"
+
+namespace {
+
+qint64 realtimeNowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return qint64(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// the receive timestamp of the datagram set by the kernel, 0 if there is none
+qint64 kernelTimestampNs(struct msghdr *msg)
+{
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET)
+            continue;
+#ifdef SCM_TIMESTAMPNS
+        if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec ts;
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            return qint64(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+        }
+#endif
+        if (cmsg->cmsg_type == SCM_TIMESTAMP) {
+            struct timeval tv;
+            memcpy(&tv, CMSG_DATA(cmsg), sizeof(tv));
+            return qint64(tv.tv_sec) * 1000000000LL + qint64(tv.tv_usec) * 1000;
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+PingHost_ICMP_socket::PingHost_ICMP_socket(QObject *parent, IConnectStateController *stateController)
+    : QObject(parent),
+      connectStateController_(stateController),
+      socket_(-1),
+      isRawSocket_(false),
+      isKernelIdentifier_(false),
+      identifier_(QRandomGenerator::global()->generate() & 0xFFFF),
+      nextSequence_(0),
+      readNotifier_(nullptr),
+      writeNotifier_(nullptr)
+{
+    clock_.start();
+    timer_.setSingleShot(true);
+    connect(&timer_, &QTimer::timeout, this, &PingHost_ICMP_socket::onTimer);
+
+    if (!openSocket(SOCK_DGRAM) && !openSocket(SOCK_RAW)) {
+        qCDebug(LOG_PING) << "ICMP socket is not available, the ping utility will be used";
+        return;
+    }
+#if defined(Q_OS_LINUX)
+    isKernelIdentifier_ = !isRawSocket_;
+#endif
+
+    readNotifier_ = new QSocketNotifier(socket_, QSocketNotifier::Read, this);
+    connect(readNotifier_, &QSocketNotifier::activated, this, &PingHost_ICMP_socket::onSocketReadActivated);
+    writeNotifier_ = new QSocketNotifier(socket_, QSocketNotifier::Write, this);
+    writeNotifier_->setEnabled(false);
+    connect(writeNotifier_, &QSocketNotifier::activated, this, &PingHost_ICMP_socket::onSocketWriteActivated);
+}
+
+PingHost_ICMP_socket::~PingHost_ICMP_socket()
+{
+    clearPings();
+    delete readNotifier_;
+    delete writeNotifier_;
+    if (socket_ != -1)
+        close(socket_);
+}
+
+bool PingHost_ICMP_socket::isAvailable() const
+{
+    return socket_ != -1;
+}
+
+void PingHost_ICMP_socket::addHostForPing(const QString &id, const QString &ip)
+{
+    WS_ASSERT(isAvailable());
+    WS_ASSERT(IpValidation::isIp(ip));
+    if (hostAlreadyPingingOrInWaitingQueue(id))
+        return;
+
+    struct in_addr addr;
+    if (inet_pton(AF_INET, ip.toStdString().c_str(), &addr) != 1) {
+        emit pingFinished(false, 0, id, connectStateController_ ? connectStateController_->currentState() == CONNECT_STATE_DISCONNECTED : true);
+        return;
+    }
+
+    QueueJob job;
+    job.id = id;
+    job.ip = addr.s_addr;
+    waitingPingsQueue_.enqueue(job);
+    if (!writeNotifier_->isEnabled())
+        sendPings();
+}
+
+void PingHost_ICMP_socket::clearPings()
+{
+    pingingHosts_.clear();
+    sequenceById_.clear();
+    waitingPingsQueue_.clear();
+    deadlines_.clear();
+    timer_.stop();
+    if (writeNotifier_)
+        writeNotifier_->setEnabled(false);
+}
+
+void PingHost_ICMP_socket::setProxySettings(const types::ProxySettings &proxySettings)
+{
+    //todo
+    Q_UNUSED(proxySettings);
+}
+
+void PingHost_ICMP_socket::disableProxy()
+{
+    //todo
+}
+
+void PingHost_ICMP_socket::enableProxy()
+{
+    //todo
+}
+
+void PingHost_ICMP_socket::onSocketReadActivated()
+{
+    // enough for the IP header with options, the ICMP header and our payload
+    unsigned char buf[1024];
+    char control[256];
+
+    while (true) {
+        struct sockaddr_in from;
+        struct iovec iov;
+        iov.iov_base = buf;
+        iov.iov_len = sizeof(buf);
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = &from;
+        msg.msg_namelen = sizeof(from);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        ssize_t len = recvmsg(socket_, &msg, 0);
+        if (len < 0)
+            break;  // EAGAIN, all datagrams are read
+
+        qint64 receiveTimeNs = kernelTimestampNs(&msg);
+        if (receiveTimeNs == 0)
+            receiveTimeNs = realtimeNowNs();
+
+        // raw sockets (and ping sockets on Mac) deliver the IP header too
+        const unsigned char *icmp = buf;
+        if (len > 0 && (buf[0] & 0xF0) == 0x40) {
+            const int ipHeaderLen = (buf[0] & 0x0F) * 4;
+            if (len < ipHeaderLen)
+                continue;
+            icmp += ipHeaderLen;
+            len -= ipHeaderLen;
+        }
+        if (len < 8)
+            continue;
+
+        icmp_header header;
+        memcpy(&header, icmp, 8);
+        if (header.type() != icmp_header::echo_reply)
+            continue;
+        if (!isKernelIdentifier_ && header.identifier() != identifier_)
+            continue;   // a reply to another process
+
+        auto it = pingingHosts_.find(header.sequence_number());
+        if (it == pingingHosts_.end() || it->ip != from.sin_addr.s_addr)
+            continue;   // a late reply to a timed out or cleared ping
+
+        const qint64 rttNs = qMax<qint64>(0, receiveTimeNs - it->sendTimeNs);
+        finishPing(header.sequence_number(), true, rttNs / 1000000);
+    }
+}
+
+void PingHost_ICMP_socket::onSocketWriteActivated()
+{
+    writeNotifier_->setEnabled(false);
+    sendPings();
+}
+
+void PingHost_ICMP_socket::onTimer()
+{
+    const qint64 now = clock_.elapsed();
+    while (!deadlines_.isEmpty() && deadlines_.head().first <= now) {
+        const quint16 sequence = deadlines_.dequeue().second;
+        auto it = pingingHosts_.find(sequence);
+        // the ping with this sequence number may be already finished (and the number reused)
+        if (it != pingingHosts_.end() && it->deadlineMs <= now)
+            finishPing(sequence, false, 0);
+    }
+    rescheduleTimer();
+}
+
+bool PingHost_ICMP_socket::openSocket(int type)
+{
+    int fd = socket(AF_INET, type, IPPROTO_ICMP);
+    if (fd < 0)
+        return false;
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    int on = 1;
+#ifdef SO_TIMESTAMPNS
+    setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+#else
+    setsockopt(fd, SOL_SOCKET, SO_TIMESTAMP, &on, sizeof(on));
+#endif
+    // the replies to the whole server list arrive in a burst
+    int bufSize = 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufSize, sizeof(bufSize));
+
+    socket_ = fd;
+    isRawSocket_ = (type == SOCK_RAW);
+    return true;
+}
+
+bool PingHost_ICMP_socket::hostAlreadyPingingOrInWaitingQueue(const QString &id) const
+{
+    if (sequenceById_.contains(id))
+        return true;
+
+    for (const auto &it : waitingPingsQueue_)
+        if (it.id == id)
+            return true;
+
+    return false;
+}
+
+void PingHost_ICMP_socket::sendPings()
+{
+    // 56 bytes of data as the ping utility sends by default
+    static const unsigned char body[56] = { 0 };
+
+    for (int i = 0; i < MAX_PINGS_PER_BATCH && !waitingPingsQueue_.isEmpty(); ++i) {
+        const QueueJob &job = waitingPingsQueue_.head();
+
+        // skip the sequence numbers of the pings which are still waiting for a reply
+        quint16 sequence = nextSequence_++;
+        while (pingingHosts_.contains(sequence))
+            sequence = nextSequence_++;
+
+        icmp_header header;
+        header.type(icmp_header::echo_request);
+        header.code(0);
+        header.identifier(identifier_);
+        header.sequence_number(sequence);
+        compute_checksum(header, body, body + sizeof(body));
+
+        unsigned char packet[8 + sizeof(body)];
+        memcpy(packet, &header, 8);
+        memcpy(packet + 8, body, sizeof(body));
+
+        struct sockaddr_in to;
+        memset(&to, 0, sizeof(to));
+        to.sin_family = AF_INET;
+        to.sin_addr.s_addr = job.ip;
+
+        const qint64 sendTimeNs = realtimeNowNs();
+        const bool bFromDisconnectedState = connectStateController_ ? connectStateController_->currentState() == CONNECT_STATE_DISCONNECTED : true;
+        if (sendto(socket_, packet, sizeof(packet), 0, (struct sockaddr *)&to, sizeof(to)) < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+                break;  // try the rest when the socket is writable again
+            const QueueJob failedJob = waitingPingsQueue_.dequeue();
+            emit pingFinished(false, 0, failedJob.id, bFromDisconnectedState);
+            continue;
+        }
+
+        PingInfo pingInfo;
+        pingInfo.id = job.id;
+        pingInfo.ip = job.ip;
+        pingInfo.sendTimeNs = sendTimeNs;
+        pingInfo.deadlineMs = clock_.elapsed() + PING_TIMEOUT_MS;
+        pingInfo.isFromDisconnectedState = bFromDisconnectedState;
+        pingingHosts_[sequence] = pingInfo;
+        sequenceById_[job.id] = sequence;
+        deadlines_.enqueue(qMakePair(pingInfo.deadlineMs, sequence));
+        waitingPingsQueue_.dequeue();
+    }
+
+    // the next batch is sent from the event loop, after the pending replies are read
+    if (!waitingPingsQueue_.isEmpty())
+        writeNotifier_->setEnabled(true);
+
+    if (!timer_.isActive())
+        rescheduleTimer();
+}
+
+void PingHost_ICMP_socket::finishPing(quint16 sequence, bool bSuccess, int timeMs)
+{
+    auto it = pingingHosts_.find(sequence);
+    WS_ASSERT(it != pingingHosts_.end());
+    const PingInfo pingInfo = it.value();
+    pingingHosts_.erase(it);
+    sequenceById_.remove(pingInfo.id);
+    emit pingFinished(bSuccess, timeMs, pingInfo.id, pingInfo.isFromDisconnectedState);
+}
+
+void PingHost_ICMP_socket::rescheduleTimer()
+{
+    if (deadlines_.isEmpty()) {
+        timer_.stop();
+        return;
+    }
+    timer_.start(qMax<qint64>(0, deadlines_.head().first - clock_.elapsed()));
+}
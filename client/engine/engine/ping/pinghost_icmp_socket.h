@@ -0,0 +1,86 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QQueue>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#include "engine/connectstatecontroller/iconnectstatecontroller.h"
+#include "types/proxysettings.h"
+
+// In-process ICMP pinger for Linux and Mac.
+// Echo requests to all hosts are sent from one socket: an unprivileged SOCK_DGRAM/IPPROTO_ICMP socket, or a raw socket if
+// the process is allowed to open it. Replies are matched by identifier/sequence number, the RTT is measured with
+// the kernel receive timestamps. If no socket can be opened (on Linux the ping_group_range sysctl does not include the
+// user), isAvailable() returns false and PingHost uses PingHost_ICMP_mac instead.
+// todo proxy support for icmp ping
+class PingHost_ICMP_socket : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PingHost_ICMP_socket(QObject *parent, IConnectStateController *stateController);
+    virtual ~PingHost_ICMP_socket();
+
+    bool isAvailable() const;
+
+    void addHostForPing(const QString &id, const QString &ip);
+    void clearPings();
+
+    void setProxySettings(const types::ProxySettings &proxySettings);
+    void disableProxy();
+    void enableProxy();
+
+signals:
+    void pingFinished(bool bSuccess, int timems, const QString &id, bool isFromDisconnectedState);
+
+private slots:
+    void onSocketReadActivated();
+    void onSocketWriteActivated();
+    void onTimer();
+
+private:
+    static constexpr int PING_TIMEOUT_MS = 2000;
+    // the replies are read between the batches, otherwise a burst of replies can overflow the socket receive buffer
+    static constexpr int MAX_PINGS_PER_BATCH = 64;
+
+    struct QueueJob
+    {
+        QString id;
+        quint32 ip;     // network byte order
+    };
+
+    struct PingInfo
+    {
+        QString id;
+        quint32 ip;
+        qint64 sendTimeNs;      // CLOCK_REALTIME, the same clock as the kernel timestamps
+        qint64 deadlineMs;
+        bool isFromDisconnectedState;
+    };
+
+    IConnectStateController* const connectStateController_;
+
+    int socket_;
+    bool isRawSocket_;
+    bool isKernelIdentifier_;       // Linux ping sockets replace the identifier and deliver the matching replies only
+    quint16 identifier_;
+    quint16 nextSequence_;
+    QSocketNotifier *readNotifier_;
+    QSocketNotifier *writeNotifier_;
+
+    QHash<quint16, PingInfo> pingingHosts_;     // by sequence number
+    QHash<QString, quint16> sequenceById_;
+    QQueue<QueueJob> waitingPingsQueue_;        // not sent yet, the rest of the batch or the socket send buffer was full
+    // the timeout is the same for all pings, so the deadlines are ordered by the send time
+    QQueue<QPair<qint64, quint16> > deadlines_;
+    QTimer timer_;
+    QElapsedTimer clock_;
+
+    bool openSocket(int type);
+    bool hostAlreadyPingingOrInWaitingQueue(const QString &id) const;
+    void sendPings();
+    void finishPing(quint16 sequence, bool bSuccess, int timeMs);
+    void rescheduleTimer();
+};
@@ -1,16 +1,14 @@
 #ifndef PINGHOST_TCP_H
 #define PINGHOST_TCP_H
 
-#include <QVector>
-#include <QAbstractSocket>
-#include <QTcpSocket>
-#include <QTimer>
-#include <QElapsedTimer>
-#include <QQueue>
+#include <QHash>
+#include <QObject>
+#include "tcppingloop.h"
 #include "types/proxysettings.h"
 
 class IConnectStateController;
 
+// TCP pings on port 443, all of them are driven by a TcpPingLoop thread
 class PingHost_TCP : public QObject
 {
     Q_OBJECT
@@ -32,40 +30,25 @@ signals:
     void pingFinished(bool bSuccess, int timems, const QString &ip, bool isFromDisconnectedState);
 
 private slots:
-    void onSocketConnected();
-    void onSocketBytesWritten(qint64 bytes);
-    void onSocketError(QAbstractSocket::SocketError socketError);
-    void onSocketTimeout();
+    void onPingFinished(quint64 pingId, bool bSuccess, int timeMs);
 
 private:
     struct PingInfo
-    {
-        QString ip;
-        QTcpSocket *tcpSocket;
-        QTimer *timer;
-        QElapsedTimer elapsedTimer;
-    };
-
-    struct QueueJob
     {
         QString id;
-        QString ip;
+        bool isFromDisconnectedState;
     };
 
     enum {PING_TIMEOUT = 2000};
-    static constexpr int MAX_PARALLEL_PINGS = 10;
 
     IConnectStateController *connectStateController_;
     types::ProxySettings proxySettings_;
     bool bProxyEnabled_;
 
-    QMap<QString, PingInfo *> pingingHosts_;
-    QQueue<QueueJob> waitingPingsQueue_;
-
-    bool hostAlreadyPingingOrInWaitingQueue(const QString &id);
-    void processNextPings();
-    void processError(QObject *obj);
-    void removeFromQueue(const QString &id);
+    TcpPingLoop *pingLoop_;
+    quint64 nextPingId_;
+    QHash<quint64, PingInfo> pingingHosts_;     // by the ping id of TcpPingLoop
+    QHash<QString, quint64> pingIds_;           // by the host id
 };
 
 #endif // PINGHOST_TCP_H
@@ -0,0 +1,507 @@
+#include "tcppingloop.h"
+
+#include <string.h>
+
+#ifdef Q_OS_WIN
+    #include <WS2tcpip.h>
+#else
+    #include <arpa/inet.h>
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <netdb.h>
+    #include <netinet/in.h>
+    #include <sys/socket.h>
+    #include <unistd.h>
+#endif
+
+#include "engine/dnsresolver/dnsresolver.h"
+#include "utils/crashhandler.h"
+#include "utils/logger.h"
+#include "utils/ws_assert.h"
+
+namespace {
+
+#ifdef Q_OS_WIN
+const wsl::SocketPoller::Socket kInvalidSocket = INVALID_SOCKET;
+#else
+const wsl::SocketPoller::Socket kInvalidSocket = -1;
+#endif
+
+void closeSocket(wsl::SocketPoller::Socket socket)
+{
+#ifdef Q_OS_WIN
+    closesocket(socket);
+#else
+    close(socket);
+#endif
+}
+
+bool isWouldBlockError()
+{
+#ifdef Q_OS_WIN
+    const int err = WSAGetLastError();
+    return err == WSAEWOULDBLOCK || err == WSAEINPROGRESS;
+#else
+    return errno == EINPROGRESS || errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+wsl::SocketPoller::Socket createNonBlockingSocket()
+{
+    wsl::SocketPoller::Socket s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == kInvalidSocket)
+        return kInvalidSocket;
+#ifdef Q_OS_WIN
+    u_long nonBlocking = 1;
+    ioctlsocket(s, FIONBIO, &nonBlocking);
+#else
+    fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK);
+    fcntl(s, F_SETFD, FD_CLOEXEC);
+    #ifdef SO_NOSIGPIPE
+        int on = 1;
+        setsockopt(s, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+    #endif
+#endif
+    return s;
+}
+
+} // namespace
+
+TcpPingLoop::TcpPingLoop(QObject *parent, int maxInFlight) : QThread(parent),
+    bFinish_(false),
+    maxInFlight_(maxInFlight),
+    resolveTarget_(new ResolveTarget())
+{
+    resolveTarget_->loop = this;
+    start();
+}
+
+TcpPingLoop::~TcpPingLoop()
+{
+    finish();
+}
+
+void TcpPingLoop::ping(quint64 pingId, const QString &ip, quint16 port, int timeoutMs, const types::ProxySettings &proxySettings)
+{
+    Ping *ping = new Ping();
+    ping->id = pingId;
+    ping->ip = ip;
+    ping->port = port;
+    ping->timeoutMs = timeoutMs;
+    ping->proxySettings = proxySettings;
+    ping->socket = kInvalidSocket;
+    if (commands_.push(Command { Command::PING, ping }))
+        poller_.wakeup();
+}
+
+void TcpPingLoop::cancelAll()
+{
+    if (commands_.push(Command { Command::CANCEL_ALL, nullptr }))
+        poller_.wakeup();
+}
+
+void TcpPingLoop::setMaxInFlight(int maxInFlight)
+{
+    maxInFlight_ = maxInFlight;
+    poller_.wakeup();
+}
+
+void TcpPingLoop::finish()
+{
+    {
+        std::lock_guard<std::mutex> locker(resolveTarget_->mutex);
+        resolveTarget_->loop = nullptr;
+    }
+    if (!isRunning())
+        return;
+    bFinish_ = true;
+    poller_.wakeup();
+    wait();
+}
+
+void TcpPingLoop::run()
+{
+    BIND_CRASH_HANDLER_FOR_THREAD();
+    clock_.start();
+
+    std::vector<wsl::SocketPoller::Event> events;
+    while (!bFinish_) {
+        processCommands();
+        startWaitingPings();
+
+        events.clear();
+        poller_.wait(nextWaitMs(), events);
+
+        for (const wsl::SocketPoller::Event &event : events) {
+            Ping *ping = sockets_.value(event.socket, nullptr);
+            if (ping)
+                onSocketEvent(ping, event.readable, event.writable);
+        }
+        processTimeouts();
+    }
+
+    commands_.popAll([](Command &&command) {
+        delete command.ping;
+    });
+    for (Ping *ping : waitingPings_)
+        delete ping;
+    waitingPings_.clear();
+    const QList<Ping *> pings = pings_.values();
+    for (Ping *ping : pings)
+        removePing(ping);
+}
+
+void TcpPingLoop::processCommands()
+{
+    commands_.popAll([this](Command &&command) {
+        if (command.type == Command::PING) {
+            waitingPings_.push_back(command.ping);
+        } else if (command.type == Command::CANCEL_ALL) {
+            for (Ping *ping : waitingPings_)
+                delete ping;
+            waitingPings_.clear();
+            const QList<Ping *> pings = pings_.values();
+            for (Ping *ping : pings)
+                removePing(ping);
+            deadlines_ = decltype(deadlines_)();
+            for (ProxyAddress &proxy : proxyAddresses_)
+                proxy.waitingPingIds.clear();
+        } else if (command.type == Command::PROXY_RESOLVED) {
+            onProxyAddressResolved(command.proxyAddress, command.proxyIps, command.proxyTtl);
+        }
+    });
+}
+
+void TcpPingLoop::startWaitingPings()
+{
+    while (!waitingPings_.empty() && pings_.count() < maxInFlight_) {
+        Ping *ping = waitingPings_.front();
+        waitingPings_.pop_front();
+        startPing(ping);
+    }
+}
+
+void TcpPingLoop::startPing(Ping *ping)
+{
+    pings_[ping->id] = ping;
+    deadlines_.push(Deadline { clock_.elapsed() + ping->timeoutMs, ping->id });
+
+    struct in_addr addr;
+    if (!isProxyUsed(ping->proxySettings)) {
+        if (inet_pton(AF_INET, ping->ip.toStdString().c_str(), &addr) != 1) {
+            finishPing(ping, false);
+            return;
+        }
+        connectPing(ping, addr.s_addr, ping->port);
+        return;
+    }
+
+    const QString address = ping->proxySettings.address();
+    if (inet_pton(AF_INET, address.toStdString().c_str(), &addr) != 1) {
+        // the proxy is set by a hostname
+        ProxyAddress &proxy = proxyAddresses_[address];
+        if (proxy.isResolving || clock_.elapsed() >= proxy.expireTime) {
+            ping->state = STATE_RESOLVING_PROXY;
+            proxy.waitingPingIds.push_back(ping->id);
+            if (!proxy.isResolving)
+                resolveProxyAddress(address);
+            return;
+        }
+        if (!proxy.bSuccess) {
+            finishPing(ping, false);
+            return;
+        }
+        addr.s_addr = proxy.ip;
+    }
+    connectPing(ping, addr.s_addr, ping->proxySettings.getPort());
+}
+
+void TcpPingLoop::connectPing(Ping *ping, quint32 ip, quint16 port)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = ip;
+    addr.sin_port = htons(port);
+
+    ping->socket = createNonBlockingSocket();
+    if (ping->socket == kInvalidSocket) {
+        finishPing(ping, false);
+        return;
+    }
+    sockets_[ping->socket] = ping;
+
+    ping->startTimeNs = clock_.nsecsElapsed();
+    if (::connect(ping->socket, (struct sockaddr *)&addr, sizeof(addr)) != 0 && !isWouldBlockError()) {
+        finishPing(ping, false);
+        return;
+    }
+    ping->state = STATE_CONNECTING;
+    updatePoller(ping);
+}
+
+void TcpPingLoop::onSocketEvent(Ping *ping, bool readable, bool writable)
+{
+    if (ping->state == STATE_CONNECTING) {
+        if (writable)
+            onConnected(ping);
+        return;
+    }
+
+    if (writable && !ping->outBuf.isEmpty()) {
+        const quint64 pingId = ping->id;
+        send(ping, QByteArray());
+        if (!pings_.contains(pingId))
+            return;     // failed and deleted
+    }
+    if (readable)
+        onDataReceived(ping);
+}
+
+void TcpPingLoop::onConnected(Ping *ping)
+{
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(ping->socket, SOL_SOCKET, SO_ERROR, (char *)&err, &len) != 0 || err != 0) {
+        finishPing(ping, false);
+        return;
+    }
+
+    if (!isProxyUsed(ping->proxySettings)) {
+        finishPing(ping, true);
+        return;
+    }
+
+    if (ping->proxySettings.option() == PROXY_OPTION_SOCKS) {
+        // version 5, no authentication and, if we have the credentials, username/password
+        QByteArray greeting;
+        greeting.append(char(0x05));
+        if (ping->proxySettings.getUsername().isEmpty()) {
+            greeting.append(char(0x01)).append(char(0x00));
+        } else {
+            greeting.append(char(0x02)).append(char(0x00)).append(char(0x02));
+        }
+        ping->state = STATE_SOCKS_GREETING;
+        send(ping, greeting);
+    } else {
+        startProxyConnect(ping);
+    }
+}
+
+void TcpPingLoop::onDataReceived(Ping *ping)
+{
+    char buf[1024];
+    while (true) {
+        const int len = recv(ping->socket, buf, sizeof(buf), 0);
+        if (len > 0) {
+            ping->inBuf.append(buf, len);
+            continue;
+        }
+        if (len < 0 && isWouldBlockError())
+            break;
+        // closed by the proxy or an error
+        finishPing(ping, false);
+        return;
+    }
+
+    if (ping->state == STATE_SOCKS_GREETING) {
+        if (ping->inBuf.size() < 2)
+            return;
+        const char method = ping->inBuf[1];
+        ping->inBuf.remove(0, 2);
+        if (method == 0x00) {
+            startProxyConnect(ping);
+        } else if (method == 0x02 && !ping->proxySettings.getUsername().isEmpty()) {
+            const QByteArray username = ping->proxySettings.getUsername().toUtf8().left(255);
+            const QByteArray password = ping->proxySettings.getPassword().toUtf8().left(255);
+            QByteArray auth;
+            auth.append(char(0x01));
+            auth.append(char(username.size())).append(username);
+            auth.append(char(password.size())).append(password);
+            ping->state = STATE_SOCKS_AUTH;
+            send(ping, auth);
+        } else {
+            finishPing(ping, false);
+        }
+    } else if (ping->state == STATE_SOCKS_AUTH) {
+        if (ping->inBuf.size() < 2)
+            return;
+        const bool bAuthorized = ping->inBuf[1] == 0x00;
+        ping->inBuf.remove(0, 2);
+        if (bAuthorized)
+            startProxyConnect(ping);
+        else
+            finishPing(ping, false);
+    } else if (ping->state == STATE_PROXY_CONNECT) {
+        if (ping->proxySettings.option() == PROXY_OPTION_SOCKS) {
+            // the reply status is enough, the rest of the reply (the bound address) is not needed
+            if (ping->inBuf.size() >= 2)
+                finishPing(ping, ping->inBuf[1] == 0x00);
+        } else {
+            // the status line is enough: HTTP/1.1 200 Connection established
+            const int ind = ping->inBuf.indexOf("\r\n");
+            if (ind != -1) {
+                const QList<QByteArray> parts = ping->inBuf.left(ind).split(' ');
+                finishPing(ping, parts.size() >= 2 && parts[0].startsWith("HTTP/") && parts[1].startsWith('2'));
+            }
+        }
+    }
+}
+
+void TcpPingLoop::startProxyConnect(Ping *ping)
+{
+    QByteArray request;
+    if (ping->proxySettings.option() == PROXY_OPTION_SOCKS) {
+        struct in_addr addr;
+        if (inet_pton(AF_INET, ping->ip.toStdString().c_str(), &addr) != 1) {
+            finishPing(ping, false);
+            return;
+        }
+        const quint16 port = htons(ping->port);
+        // version 5, CONNECT, reserved, IPv4 address
+        request.append(char(0x05)).append(char(0x01)).append(char(0x00)).append(char(0x01));
+        request.append((const char *)&addr.s_addr, 4);
+        request.append((const char *)&port, 2);
+    } else {
+        const QByteArray hostPort = ping->ip.toUtf8() + ":" + QByteArray::number(ping->port);
+        request = "CONNECT " + hostPort + " HTTP/1.1\r\nHost: " + hostPort + "\r\n";
+        if (!ping->proxySettings.getUsername().isEmpty()) {
+            const QByteArray credentials = ping->proxySettings.getUsername().toUtf8() + ":" + ping->proxySettings.getPassword().toUtf8();
+            request += "Proxy-Authorization: Basic " + credentials.toBase64() + "\r\n";
+        }
+        request += "\r\n";
+    }
+
+    // the proxy answers to CONNECT when it has connected to the host (or failed to)
+    ping->state = STATE_PROXY_CONNECT;
+    ping->startTimeNs = clock_.nsecsElapsed();
+    send(ping, request);
+}
+
+void TcpPingLoop::send(Ping *ping, const QByteArray &data)
+{
+    ping->outBuf.append(data);
+    while (!ping->outBuf.isEmpty()) {
+#if defined(Q_OS_LINUX)
+        const int len = ::send(ping->socket, ping->outBuf.constData(), ping->outBuf.size(), MSG_NOSIGNAL);
+#else
+        const int len = ::send(ping->socket, ping->outBuf.constData(), ping->outBuf.size(), 0);
+#endif
+        if (len > 0) {
+            ping->outBuf.remove(0, len);
+            continue;
+        }
+        if (len < 0 && isWouldBlockError())
+            break;
+        finishPing(ping, false);
+        return;
+    }
+    updatePoller(ping);
+}
+
+void TcpPingLoop::updatePoller(Ping *ping)
+{
+    if (ping->state == STATE_CONNECTING)
+        poller_.update(ping->socket, false, true);
+    else
+        poller_.update(ping->socket, true, !ping->outBuf.isEmpty());
+}
+
+void TcpPingLoop::finishPing(Ping *ping, bool bSuccess)
+{
+    const qint64 timeMs = bSuccess ? (clock_.nsecsElapsed() - ping->startTimeNs) / 1000000 : 0;
+    const quint64 pingId = ping->id;
+    removePing(ping);
+    emit pingFinished(pingId, bSuccess, (int)timeMs);
+}
+
+void TcpPingLoop::removePing(Ping *ping)
+{
+    if (ping->socket != kInvalidSocket) {
+        poller_.update(ping->socket, false, false);
+        sockets_.remove(ping->socket);
+        closeSocket(ping->socket);
+    }
+    pings_.remove(ping->id);
+    delete ping;
+}
+
+void TcpPingLoop::processTimeouts()
+{
+    const qint64 now = clock_.elapsed();
+    while (!deadlines_.empty() && deadlines_.top().time <= now) {
+        const quint64 pingId = deadlines_.top().pingId;
+        deadlines_.pop();
+        // the ping can be already finished
+        Ping *ping = pings_.value(pingId, nullptr);
+        if (ping)
+            finishPing(ping, false);
+    }
+}
+
+qint64 TcpPingLoop::nextWaitMs()
+{
+    if (!waitingPings_.empty() && pings_.count() < maxInFlight_)
+        return 0;
+    if (deadlines_.empty())
+        return -1;
+    return qMax<qint64>(0, deadlines_.top().time - clock_.elapsed());
+}
+
+void TcpPingLoop::resolveProxyAddress(const QString &address)
+{
+    proxyAddresses_[address].isResolving = true;
+    std::shared_ptr<ResolveTarget> target = resolveTarget_;
+    DnsResolver::instance().lookup(address, QStringList(), kProxyResolveTimeoutMs, [target, address](const AresLoop::Result &result) {
+        std::lock_guard<std::mutex> locker(target->mutex);
+        if (!target->loop)
+            return;
+        Command command { Command::PROXY_RESOLVED, nullptr };
+        command.proxyAddress = address;
+        command.proxyIps = result.ips;
+        command.proxyTtl = result.ttl;
+        if (target->loop->commands_.push(std::move(command)))
+            target->loop->poller_.wakeup();
+    });
+}
+
+void TcpPingLoop::onProxyAddressResolved(const QString &address, const QStringList &ips, int ttl)
+{
+    auto it = proxyAddresses_.find(address);
+    if (it == proxyAddresses_.end())
+        return;
+
+    ProxyAddress &proxy = it.value();
+    struct in_addr addr;
+    proxy.isResolving = false;
+    proxy.bSuccess = !ips.isEmpty() && inet_pton(AF_INET, ips.first().toStdString().c_str(), &addr) == 1;
+    if (proxy.bSuccess) {
+        proxy.ip = addr.s_addr;
+        const qint64 ttlMs = ttl < 0 ? kProxyMaxTtlMs : qBound(kProxyMinTtlMs, qint64(ttl) * 1000, kProxyMaxTtlMs);
+        proxy.expireTime = clock_.elapsed() + ttlMs;
+    } else {
+        // the failure is cached too, otherwise every ping would wait for the resolver again
+        qCDebug(LOG_PING) << "Could not resolve the proxy address:" << address;
+        proxy.expireTime = clock_.elapsed() + kProxyFailureTtlMs;
+    }
+
+    const std::vector<quint64> pingIds = std::move(proxy.waitingPingIds);
+    proxy.waitingPingIds.clear();
+    const bool bSuccess = proxy.bSuccess;
+    const quint32 ip = proxy.ip;
+    for (quint64 pingId : pingIds) {
+        // the ping can be already timed out or canceled
+        Ping *ping = pings_.value(pingId, nullptr);
+        if (!ping)
+            continue;
+        if (bSuccess)
+            connectPing(ping, ip, ping->proxySettings.getPort());
+        else
+            finishPing(ping, false);
+    }
+}
+
+bool TcpPingLoop::isProxyUsed(const types::ProxySettings &proxySettings)
+{
+    return proxySettings.option() == PROXY_OPTION_HTTP || proxySettings.option() == PROXY_OPTION_SOCKS;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QThread>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <vector>
+
+#include "types/proxysettings.h"
+#include "utils/mpscqueue.h"
+#include "utils/socketpoller.h"
+
+// TCP connect latency engine for PingHost_TCP.
+// One thread drives all the pings with nonblocking connect() on a SocketPoller (epoll on Linux), timeouts are kept in
+// a single min-heap. Up to maxInFlight pings run at the same time, the rest wait in a queue.
+// The RTT is the time of the TCP handshake with the host. With an HTTP or SOCKS5 proxy it is the time from sending
+// the CONNECT request to the proxy reply, so the handshake and the authentication with the proxy are not counted.
+// A proxy set by a hostname is resolved with DnsResolver without blocking the loop, the pings wait for the answer.
+class TcpPingLoop : public QThread
+{
+    Q_OBJECT
+public:
+    static constexpr int kDefaultMaxInFlight = 256;
+
+    explicit TcpPingLoop(QObject *parent = nullptr, int maxInFlight = kDefaultMaxInFlight);
+    virtual ~TcpPingLoop();
+
+    // Can be called from any thread. pingId must be unique, the result comes with the pingFinished signal.
+    // ip must be an IPv4 address, the proxy is used if its option is PROXY_OPTION_HTTP or PROXY_OPTION_SOCKS.
+    void ping(quint64 pingId, const QString &ip, quint16 port, int timeoutMs, const types::ProxySettings &proxySettings = types::ProxySettings());
+    // drops all the running and waiting pings without results
+    void cancelAll();
+    void setMaxInFlight(int maxInFlight);
+    void finish();
+
+signals:
+    // emitted from the loop thread
+    void pingFinished(quint64 pingId, bool bSuccess, int timeMs);
+
+protected:
+    void run() override;
+
+private:
+    // the resolved proxy addresses are kept for their TTL within these limits, the failures for kProxyFailureTtlMs
+    static constexpr qint64 kProxyMinTtlMs = 30 * 1000;
+    static constexpr qint64 kProxyMaxTtlMs = 10 * 60 * 1000;
+    static constexpr qint64 kProxyFailureTtlMs = 30 * 1000;
+    static constexpr int kProxyResolveTimeoutMs = 5000;
+
+    enum PING_STATE { STATE_RESOLVING_PROXY, STATE_CONNECTING, STATE_SOCKS_GREETING, STATE_SOCKS_AUTH, STATE_PROXY_CONNECT };
+
+    struct Ping
+    {
+        quint64 id;
+        QString ip;
+        quint16 port;
+        int timeoutMs;
+        types::ProxySettings proxySettings;
+
+        wsl::SocketPoller::Socket socket;
+        PING_STATE state = STATE_CONNECTING;
+        qint64 startTimeNs = 0;     // the start of the measured interval
+        QByteArray outBuf;
+        QByteArray inBuf;
+    };
+
+    struct Command
+    {
+        enum TYPE { PING, CANCEL_ALL, PROXY_RESOLVED };
+        TYPE type;
+        Ping *ping;
+        // for PROXY_RESOLVED
+        QString proxyAddress = QString();
+        QStringList proxyIps = QStringList();
+        int proxyTtl = -1;
+    };
+
+    struct ProxyAddress
+    {
+        bool isResolving = false;
+        bool bSuccess = false;
+        quint32 ip = 0;         // IPv4 address in network byte order
+        qint64 expireTime = 0;
+        std::vector<quint64> waitingPingIds;
+    };
+
+    // the resolver callbacks can come after the loop is destroyed, they reach it only through this object
+    struct ResolveTarget
+    {
+        std::mutex mutex;
+        TcpPingLoop *loop;
+    };
+
+    struct Deadline
+    {
+        qint64 time;
+        quint64 pingId;
+        bool operator>(const Deadline &other) const { return time > other.time; }
+    };
+
+    wsl::MpscQueue<Command> commands_;
+    std::atomic<bool> bFinish_;
+    std::atomic<int> maxInFlight_;
+    wsl::SocketPoller poller_;
+    std::shared_ptr<ResolveTarget> resolveTarget_;
+
+    // accessed only from the loop thread
+    QElapsedTimer clock_;
+    std::deque<Ping *> waitingPings_;
+    QHash<quint64, Ping *> pings_;                          // running pings by id
+    QHash<wsl::SocketPoller::Socket, Ping *> sockets_;
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline> > deadlines_;
+    QHash<QString, ProxyAddress> proxyAddresses_;           // the proxies set by a hostname
+
+    void processCommands();
+    void startWaitingPings();
+    void startPing(Ping *ping);
+    void connectPing(Ping *ping, quint32 ip, quint16 port);
+    void onSocketEvent(Ping *ping, bool readable, bool writable);
+    void onConnected(Ping *ping);
+    void onDataReceived(Ping *ping);
+    void startProxyConnect(Ping *ping);
+    void send(Ping *ping, const QByteArray &data);
+    void updatePoller(Ping *ping);
+    void finishPing(Ping *ping, bool bSuccess);
+    void removePing(Ping *ping);
+    void processTimeouts();
+    qint64 nextWaitMs();
+    void resolveProxyAddress(const QString &address);
+    void onProxyAddressResolved(const QString &address, const QStringList &ips, int ttl);
+
+    static bool isProxyUsed(const types::ProxySettings &proxySettings);
+};
@@ -0,0 +1,91 @@
+#include <QtTest>
+
+#include <sys/resource.h>
+
+#include "engine/ping/pinghost_icmp_mac.h"
+#include "engine/ping/pinghost_icmp_socket.h"
+
+// Pings a few hundred loopback addresses with the ping utility (PingHost_ICMP_mac) and with the ICMP socket
+// (PingHost_ICMP_socket), reports the wall time and the CPU time (of the process and its children) for both.
+class BenchIcmpPing : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void benchmark_ping_utility();
+    void benchmark_icmp_socket();
+
+private:
+    static constexpr int kHostsCount = 300;
+
+    static QString hostIp(int ind);
+    static qint64 cpuTimeUs();
+
+    template<typename PingHostType>
+    void pingAll(PingHostType &pingHost);
+};
+
+QString BenchIcmpPing::hostIp(int ind)
+{
+#ifdef Q_OS_LINUX
+    // the whole 127.0.0.0/8 answers on Linux
+    return QString("127.0.%1.%2").arg(ind / 250).arg(ind % 250 + 1);
+#else
+    Q_UNUSED(ind);
+    return "127.0.0.1";
+#endif
+}
+
+qint64 BenchIcmpPing::cpuTimeUs()
+{
+    auto toUs = [](const struct timeval &tv) { return qint64(tv.tv_sec) * 1000000 + tv.tv_usec; };
+    struct rusage self, children;
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &children);
+    return toUs(self.ru_utime) + toUs(self.ru_stime) + toUs(children.ru_utime) + toUs(children.ru_stime);
+}
+
+template<typename PingHostType>
+void BenchIcmpPing::pingAll(PingHostType &pingHost)
+{
+    int finished = 0;
+    int failed = 0;
+    connect(&pingHost, &PingHostType::pingFinished, this, [&](bool bSuccess, int timems, const QString &id, bool isFromDisconnectedState) {
+        Q_UNUSED(timems);
+        Q_UNUSED(id);
+        Q_UNUSED(isFromDisconnectedState);
+        if (!bSuccess)
+            failed++;
+        finished++;
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+    const qint64 cpuStartUs = cpuTimeUs();
+    for (int i = 0; i < kHostsCount; ++i)
+        pingHost.addHostForPing(QString::number(i), hostIp(i));
+
+    QTRY_COMPARE_WITH_TIMEOUT(finished, kHostsCount, 10 * 60 * 1000);
+    const qint64 wallMs = timer.elapsed();
+    const qint64 cpuMs = (cpuTimeUs() - cpuStartUs) / 1000;
+    QCOMPARE(failed, 0);
+
+    qDebug() << "hosts:" << kHostsCount << "wall time, ms:" << wallMs << "cpu time, ms:" << cpuMs;
+}
+
+void BenchIcmpPing::benchmark_ping_utility()
+{
+    PingHost_ICMP_mac pingHost(this, nullptr);
+    pingAll(pingHost);
+}
+
+void BenchIcmpPing::benchmark_icmp_socket()
+{
+    PingHost_ICMP_socket pingHost(this, nullptr);
+    if (!pingHost.isAvailable())
+        QSKIP("ICMP socket is not available (check the net.ipv4.ping_group_range sysctl)");
+    pingAll(pingHost);
+}
+
+QTEST_MAIN(BenchIcmpPing)
+#include "icmpping.bench.moc"
@@ -0,0 +1,332 @@
+#include <QtTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#include "engine/ping/tcppingloop.h"
+
+// Local HTTP CONNECT and SOCKS5 proxy stub. Nothing is connected for real: the reply to CONNECT is delayed by
+// (target port - kDelayBasePort) ms, which emulates the latency of the host behind the proxy.
+// Port kNoReplyPort never gets a reply, kRefusePort gets an error reply.
+class LocalProxyStub : public QTcpServer
+{
+    Q_OBJECT
+public:
+    static constexpr quint16 kDelayBasePort = 10000;
+    static constexpr quint16 kNoReplyPort = 9999;
+    static constexpr quint16 kRefusePort = 9998;
+
+    explicit LocalProxyStub(bool isSocks) : isSocks_(isSocks) {}
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override
+    {
+        QTcpSocket *socket = new QTcpSocket(this);
+        if (!socket->setSocketDescriptor(socketDescriptor)) {
+            delete socket;
+            return;
+        }
+        socket->setProperty("stage", 0);
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+            isSocks_ ? onSocksData(socket) : onHttpData(socket);
+        });
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+    }
+
+private:
+    bool isSocks_;
+
+    void replyDelayed(QTcpSocket *socket, quint16 port, const QByteArray &reply, const QByteArray &errorReply)
+    {
+        if (port == kNoReplyPort)
+            return;
+        if (port == kRefusePort) {
+            socket->write(errorReply);
+            return;
+        }
+        QPointer<QTcpSocket> guard(socket);
+        QTimer::singleShot(qMax(0, port - kDelayBasePort), this, [guard, reply]() {
+            if (guard)
+                guard->write(reply);
+        });
+    }
+
+    void onHttpData(QTcpSocket *socket)
+    {
+        if (!socket->canReadLine() || socket->property("stage").toInt() != 0)
+            return;
+        socket->setProperty("stage", 1);
+        // CONNECT 1.2.3.4:10100 HTTP/1.1
+        const QList<QByteArray> parts = socket->readLine().split(' ');
+        const quint16 port = parts.size() >= 2 ? parts[1].split(':').last().toUShort() : 0;
+        replyDelayed(socket, port, "HTTP/1.1 200 Connection established\r\n\r\n", "HTTP/1.1 502 Bad Gateway\r\n\r\n");
+    }
+
+    void onSocksData(QTcpSocket *socket)
+    {
+        QByteArray data = socket->property("data").toByteArray() + socket->readAll();
+        int stage = socket->property("stage").toInt();
+        while (true) {
+            if (stage == 0 && data.size() >= 2 && data.size() >= 2 + data[1]) {
+                const bool isAuth = data.mid(2, data[1]).contains(char(0x02));
+                data.remove(0, 2 + data[1]);
+                socket->write(isAuth ? QByteArray("\x05\x02", 2) : QByteArray("\x05\x00", 2));
+                stage = isAuth ? 1 : 2;
+            } else if (stage == 1 && data.size() >= 2 && data.size() >= 3 + data[1] && data.size() >= 3 + data[1] + data[2 + data[1]]) {
+                const int userLen = data[1];
+                const QByteArray user = data.mid(2, userLen);
+                const QByteArray password = data.mid(3 + userLen, data[2 + userLen]);
+                data.remove(0, 3 + userLen + password.size());
+                const bool bOk = user == "user" && password == "pass";
+                socket->write(bOk ? QByteArray("\x01\x00", 2) : QByteArray("\x01\x01", 2));
+                stage = bOk ? 2 : 3;
+            } else if (stage == 2 && data.size() >= 10) {
+                const quint16 port = (quint8(data[8]) << 8) | quint8(data[9]);
+                data.remove(0, 10);
+                replyDelayed(socket, port, QByteArray("\x05\x00\x00\x01\x00\x00\x00\x00\x00\x00", 10), QByteArray("\x05\x05\x00\x01\x00\x00\x00\x00\x00\x00", 10));
+                stage = 3;
+            } else {
+                break;
+            }
+        }
+        socket->setProperty("stage", stage);
+        socket->setProperty("data", data);
+    }
+};
+
+class TestTcpPing : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void testDirect();
+    void testProxyDelays_data();
+    void testProxyDelays();
+    void testProxyErrors_data();
+    void testProxyErrors();
+    void testProxyHostname();
+    void testTimeout();
+    void testConcurrency();
+    void testCancel();
+
+private:
+    struct Result
+    {
+        bool bSuccess;
+        int timeMs;
+    };
+
+    QTcpServer listener_;
+    LocalProxyStub httpProxy_ { false };
+    LocalProxyStub socksProxy_ { true };
+
+    types::ProxySettings httpProxy() const;
+    types::ProxySettings socksProxy(const QString &username = QString(), const QString &password = QString()) const;
+    void collectResults(TcpPingLoop &loop, QHash<quint64, Result> &results);
+};
+
+void TestTcpPing::initTestCase()
+{
+    QVERIFY(listener_.listen(QHostAddress::LocalHost));
+    QVERIFY(httpProxy_.listen(QHostAddress::LocalHost));
+    QVERIFY(socksProxy_.listen(QHostAddress::LocalHost));
+}
+
+void TestTcpPing::testDirect()
+{
+    // a port which nobody listens to
+    QTcpServer closed;
+    QVERIFY(closed.listen(QHostAddress::LocalHost));
+    const quint16 closedPort = closed.serverPort();
+    closed.close();
+
+    TcpPingLoop loop;
+    QHash<quint64, Result> results;
+    collectResults(loop, results);
+    loop.ping(1, "127.0.0.1", listener_.serverPort(), 2000);
+    loop.ping(2, "127.0.0.1", closedPort, 2000);
+    loop.ping(3, "not an ip", listener_.serverPort(), 2000);
+
+    QTRY_COMPARE(results.count(), 3);
+    QVERIFY(results[1].bSuccess);
+    QVERIFY(results[1].timeMs < 100);
+    QVERIFY(!results[2].bSuccess);
+    QVERIFY(!results[3].bSuccess);
+}
+
+void TestTcpPing::testProxyDelays_data()
+{
+    QTest::addColumn<bool>("isSocks");
+    QTest::addColumn<bool>("isAuth");
+    QTest::addColumn<int>("delayMs");
+
+    QTest::newRow("http 50") << false << false << 50;
+    QTest::newRow("http 300") << false << false << 300;
+    QTest::newRow("socks 50") << true << false << 50;
+    QTest::newRow("socks 300") << true << false << 300;
+    QTest::newRow("socks auth 150") << true << true << 150;
+}
+
+void TestTcpPing::testProxyDelays()
+{
+    QFETCH(bool, isSocks);
+    QFETCH(bool, isAuth);
+    QFETCH(int, delayMs);
+
+    TcpPingLoop loop;
+    QHash<quint64, Result> results;
+    collectResults(loop, results);
+    const types::ProxySettings proxy = isSocks ? socksProxy(isAuth ? "user" : "", isAuth ? "pass" : "") : httpProxy();
+    loop.ping(1, "1.2.3.4", LocalProxyStub::kDelayBasePort + delayMs, 2000, proxy);
+
+    QTRY_COMPARE(results.count(), 1);
+    QVERIFY(results[1].bSuccess);
+    // the handshake with the local proxy is not counted, only the injected delay
+    QVERIFY2(results[1].timeMs >= delayMs && results[1].timeMs < delayMs + 50, qPrintable(QString::number(results[1].timeMs)));
+}
+
+void TestTcpPing::testProxyErrors_data()
+{
+    QTest::addColumn<types::ProxySettings>("proxy");
+    QTest::addColumn<quint16>("port");
+
+    QTest::newRow("http error reply") << httpProxy() << LocalProxyStub::kRefusePort;
+    QTest::newRow("socks error reply") << socksProxy() << LocalProxyStub::kRefusePort;
+    QTest::newRow("socks wrong password") << socksProxy("user", "wrong") << quint16(LocalProxyStub::kDelayBasePort);
+    QTest::newRow("proxy is down") << types::ProxySettings(PROXY_OPTION_HTTP, "127.0.0.1", 1, "", "") << quint16(LocalProxyStub::kDelayBasePort);
+}
+
+void TestTcpPing::testProxyErrors()
+{
+    QFETCH(types::ProxySettings, proxy);
+    QFETCH(quint16, port);
+
+    TcpPingLoop loop;
+    QHash<quint64, Result> results;
+    collectResults(loop, results);
+    loop.ping(1, "1.2.3.4", port, 2000, proxy);
+
+    QTRY_COMPARE(results.count(), 1);
+    QVERIFY(!results[1].bSuccess);
+}
+
+void TestTcpPing::testProxyHostname()
+{
+    TcpPingLoop loop;
+    QHash<quint64, Result> results;
+    collectResults(loop, results);
+
+    // the pings wait for the address together, the later ones take it from the cache
+    const types::ProxySettings proxy(PROXY_OPTION_HTTP, "localhost", httpProxy_.serverPort(), "", "");
+    loop.ping(1, "1.2.3.4", LocalProxyStub::kDelayBasePort, 5000, proxy);
+    loop.ping(2, "1.2.3.4", LocalProxyStub::kDelayBasePort, 5000, proxy);
+    QTRY_COMPARE(results.count(), 2);
+    QVERIFY(results[1].bSuccess);
+    QVERIFY(results[2].bSuccess);
+    loop.ping(3, "1.2.3.4", LocalProxyStub::kDelayBasePort, 5000, proxy);
+    QTRY_COMPARE(results.count(), 3);
+    QVERIFY(results[3].bSuccess);
+
+    // the failure is cached too, so the next pings fail at once instead of waiting for the resolver again
+    const types::ProxySettings unresolvable(PROXY_OPTION_HTTP, "nonexistent.invalid", 8080, "", "");
+    loop.ping(4, "1.2.3.4", LocalProxyStub::kDelayBasePort, 10000, unresolvable);
+    QTRY_COMPARE_WITH_TIMEOUT(results.count(), 4, 10000);
+    QVERIFY(!results[4].bSuccess);
+
+    QElapsedTimer timer;
+    timer.start();
+    loop.ping(5, "1.2.3.4", LocalProxyStub::kDelayBasePort, 10000, unresolvable);
+    QTRY_COMPARE(results.count(), 5);
+    QVERIFY(!results[5].bSuccess);
+    QVERIFY(timer.elapsed() < 100);
+}
+
+void TestTcpPing::testTimeout()
+{
+    TcpPingLoop loop;
+    QHash<quint64, Result> results;
+    collectResults(loop, results);
+
+    QElapsedTimer timer;
+    timer.start();
+    loop.ping(1, "1.2.3.4", LocalProxyStub::kNoReplyPort, 300, httpProxy());
+    loop.ping(2, "1.2.3.4", LocalProxyStub::kNoReplyPort, 600, socksProxy());
+
+    QTRY_COMPARE(results.count(), 1);
+    QVERIFY(results.contains(1));
+    QVERIFY(timer.elapsed() >= 300 && timer.elapsed() < 550);
+    QTRY_COMPARE(results.count(), 2);
+    QVERIFY(!results[1].bSuccess);
+    QVERIFY(!results[2].bSuccess);
+}
+
+void TestTcpPing::testConcurrency()
+{
+    // all the pings are in flight at the same time, so the sweep takes about one delay, not kPingsCount / 10 of them
+    const int kPingsCount = 300;
+    const int kDelayMs = 200;
+
+    TcpPingLoop loop(nullptr, kPingsCount);
+    QHash<quint64, Result> results;
+    collectResults(loop, results);
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < kPingsCount; ++i)
+        loop.ping(i, "1.2.3.4", LocalProxyStub::kDelayBasePort + kDelayMs, 5000, i % 2 ? httpProxy() : socksProxy());
+
+    QTRY_COMPARE_WITH_TIMEOUT(results.count(), kPingsCount, 10000);
+    qDebug() << "pings:" << kPingsCount << "wall time, ms:" << timer.elapsed();
+    QVERIFY(timer.elapsed() < kDelayMs * 5);
+    for (const Result &result : qAsConst(results)) {
+        QVERIFY(result.bSuccess);
+        QVERIFY(result.timeMs >= kDelayMs);
+    }
+
+    // with the limit the pings go in waves
+    results.clear();
+    loop.setMaxInFlight(10);
+    timer.restart();
+    for (int i = 0; i < 30; ++i)
+        loop.ping(kPingsCount + i, "1.2.3.4", LocalProxyStub::kDelayBasePort + kDelayMs, 5000, httpProxy());
+    QTRY_COMPARE_WITH_TIMEOUT(results.count(), 30, 10000);
+    QVERIFY(timer.elapsed() >= kDelayMs * 3);
+}
+
+void TestTcpPing::testCancel()
+{
+    TcpPingLoop loop;
+    QHash<quint64, Result> results;
+    collectResults(loop, results);
+
+    for (int i = 0; i < 50; ++i)
+        loop.ping(i, "1.2.3.4", LocalProxyStub::kDelayBasePort + 200, 2000, httpProxy());
+    loop.cancelAll();
+    QTest::qWait(500);
+    QCOMPARE(results.count(), 0);
+
+    loop.ping(100, "127.0.0.1", listener_.serverPort(), 2000);
+    QTRY_COMPARE(results.count(), 1);
+    QVERIFY(results[100].bSuccess);
+}
+
+types::ProxySettings TestTcpPing::httpProxy() const
+{
+    return types::ProxySettings(PROXY_OPTION_HTTP, "127.0.0.1", httpProxy_.serverPort(), "", "");
+}
+
+types::ProxySettings TestTcpPing::socksProxy(const QString &username, const QString &password) const
+{
+    return types::ProxySettings(PROXY_OPTION_SOCKS, "127.0.0.1", socksProxy_.serverPort(), password, username);
+}
+
+void TestTcpPing::collectResults(TcpPingLoop &loop, QHash<quint64, Result> &results)
+{
+    connect(&loop, &TcpPingLoop::pingFinished, this, [&results](quint64 pingId, bool bSuccess, int timeMs) {
+        results[pingId] = Result { bSuccess, timeMs };
+    });
+}
+
+QTEST_MAIN(TestTcpPing)
+#include "tcpping.test.moc"
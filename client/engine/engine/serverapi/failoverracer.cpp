@@ -0,0 +1,149 @@
+#include "failoverracer.h"
+
+#include <algorithm>
+
+#include "utils/ws_assert.h"
+#include "utils/logger.h"
+
+namespace server_api {
+
+FailoverRacer::FailoverRacer(QObject *parent, IConnectStateController *connectStateController, NetworkAccessManager *networkAccessManager,
+                             failover::IFailoverContainer *failoverContainer, int maxParallel, int staggerMs) : QObject(parent),
+    connectStateController_(connectStateController), networkAccessManager_(networkAccessManager), failoverContainer_(failoverContainer),
+    maxParallel_(qMax(maxParallel, 1)), staggerMs_(staggerMs), bIgnoreSslErrors_(false)
+{
+    winner_.failoverInd = -1;
+    winner_.executer = nullptr;
+    staggerTimer_.setSingleShot(true);
+    connect(&staggerTimer_, &QTimer::timeout, this, &FailoverRacer::onStaggerTimer);
+}
+
+void FailoverRacer::execute(QPointer<BaseRequest> request, QSharedPointer<failover::BaseFailover> preferredFailover, bool bIgnoreSslErrors)
+{
+    WS_ASSERT(request_ == nullptr);
+    request_ = request;
+    preferredFailover_ = preferredFailover;
+    bIgnoreSslErrors_ = bIgnoreSslErrors;
+    failoverContainer_->currentFailover(&startFailoverInd_);
+
+    if (!startNext())
+        finish(RequestExecuterRetCode::kFailoverFailed);
+}
+
+failover::FailoverData FailoverRacer::failoverData() const
+{
+    WS_ASSERT(winner_.executer != nullptr);
+    return winner_.executer->failoverData();
+}
+
+QSharedPointer<failover::BaseFailover> FailoverRacer::failover() const
+{
+    return winner_.failover;
+}
+
+bool FailoverRacer::isPreferredFailoverWon() const
+{
+    return winner_.failover && winner_.failoverInd == -1;
+}
+
+void FailoverRacer::onStaggerTimer()
+{
+    if (!isFinished_ && runners_.count() < maxParallel_)
+        startNext();
+}
+
+bool FailoverRacer::startNext()
+{
+    QSharedPointer<failover::BaseFailover> failover;
+    int failoverInd = -1;
+    if (!isPreferredStarted_ && preferredFailover_) {
+        isPreferredStarted_ = true;
+        failover = preferredFailover_;
+    } else {
+        while (!failover && !isContainerExhausted_) {
+            if (!isContainerStarted_) {
+                isContainerStarted_ = true;
+                failover = failoverContainer_->currentFailover(&failoverInd);
+            } else if (failoverContainer_->gotoNext()) {
+                failover = failoverContainer_->currentFailover(&failoverInd);
+            } else {
+                isContainerExhausted_ = true;
+            }
+            // the preferred failover is already running
+            if (failover && preferredFailover_ && failover->uniqueId() == preferredFailover_->uniqueId())
+                failover.reset();
+        }
+    }
+    if (!failover)
+        return false;
+
+    qCDebug(LOG_FAILOVER) << "Trying:" << failover->name();
+    RequestExecuterViaFailover *executer = new RequestExecuterViaFailover(this, connectStateController_, networkAccessManager_);
+    // queued, so that the executers are never deleted from their own signals and the failovers finished right away do not recurse
+    connect(executer, &RequestExecuterViaFailover::finished, this, [this, executer](RequestExecuterRetCode retCode) {
+        onExecuterFinished(executer, retCode);
+    }, Qt::QueuedConnection);
+    runners_ << Runner{ failover, failoverInd, executer };
+    emit failoverStarted(failoverInd);
+    executer->execute(request_, failover, bIgnoreSslErrors_);
+
+    if (runners_.count() < maxParallel_)
+        staggerTimer_.start(staggerMs_);
+    return true;
+}
+
+void FailoverRacer::onExecuterFinished(RequestExecuterViaFailover *executer, RequestExecuterRetCode retCode)
+{
+    auto it = std::find_if(runners_.begin(), runners_.end(), [executer](const Runner &r) { return r.executer == executer; });
+    // cancelled already
+    if (isFinished_ || it == runners_.end())
+        return;
+
+    if (retCode == RequestExecuterRetCode::kFailoverFailed) {
+        qCDebug(LOG_FAILOVER) << "Failed:" << it->failover->name();
+        runners_.erase(it);
+        delete executer;
+        // do not wait for the stagger delay, start the next one right away
+        while (runners_.count() < maxParallel_ && startNext()) {
+        }
+        if (runners_.isEmpty())
+            finish(RequestExecuterRetCode::kFailoverFailed);
+        return;
+    }
+
+    if (retCode == RequestExecuterRetCode::kSuccess) {
+        winner_ = *it;
+        runners_.erase(it);
+        if (winner_.failoverInd != -1)
+            failoverContainer_->gotoIndex(winner_.failoverInd);
+        else if (isContainerStarted_)
+            failoverContainer_->gotoIndex(startFailoverInd_);
+    } else {
+        // the request will be repeated, continue from the earliest failover which did not fail
+        int ind = -1;
+        for (const auto &runner : std::as_const(runners_)) {
+            if (runner.failoverInd != -1 && (ind == -1 || runner.failoverInd < ind))
+                ind = runner.failoverInd;
+        }
+        if (ind != -1)
+            failoverContainer_->gotoIndex(ind);
+    }
+    finish(retCode);
+}
+
+void FailoverRacer::cancelRunners()
+{
+    for (const auto &runner : std::as_const(runners_))
+        delete runner.executer;
+    runners_.clear();
+}
+
+void FailoverRacer::finish(RequestExecuterRetCode retCode)
+{
+    isFinished_ = true;
+    staggerTimer_.stop();
+    cancelRunners();
+    emit finished(retCode);
+}
+
+} // namespace server_api
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+
+#include "engine/networkaccessmanager/networkaccessmanager.h"
+#include "engine/connectstatecontroller/iconnectstatecontroller.h"
+#include "engine/failover/ifailovercontainer.h"
+#include "requests/baserequest.h"
+#include "requestexecuterviafailover.h"
+
+namespace server_api {
+
+// Helper class used by ServerAPI.
+// Executes a request through several failovers at once, happy eyeballs style: the failovers are taken from the container
+// starting with its current position and started one after another with a delay of staggerMs, or right away when a running
+// one fails, up to maxParallel at the same time. The first successful one wins and the others are cancelled.
+// The preferred failover (the one which worked last time, may be null) is started first.
+// With maxParallel = 1 the failovers are tried strictly one by one.
+class FailoverRacer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FailoverRacer(QObject *parent, IConnectStateController *connectStateController, NetworkAccessManager *networkAccessManager,
+                           failover::IFailoverContainer *failoverContainer, int maxParallel, int staggerMs);
+
+    void execute(QPointer<BaseRequest> request, QSharedPointer<failover::BaseFailover> preferredFailover, bool bIgnoreSslErrors);
+    QPointer<BaseRequest> request() { return request_; }
+
+    // valid only after kSuccess
+    failover::FailoverData failoverData() const;
+    QSharedPointer<failover::BaseFailover> failover() const;
+    bool isPreferredFailoverWon() const;
+
+signals:
+    // failoverInd is the position in the container
+    void failoverStarted(int failoverInd);
+    void finished(server_api::RequestExecuterRetCode retCode);
+
+private slots:
+    void onStaggerTimer();
+
+private:
+    struct Runner {
+        QSharedPointer<failover::BaseFailover> failover;
+        int failoverInd;        // -1 for the preferred failover
+        RequestExecuterViaFailover *executer;
+    };
+
+    IConnectStateController *connectStateController_;
+    NetworkAccessManager *networkAccessManager_;
+    failover::IFailoverContainer *failoverContainer_;
+    const int maxParallel_;
+    const int staggerMs_;
+
+    QPointer<BaseRequest> request_;
+    QSharedPointer<failover::BaseFailover> preferredFailover_;
+    bool bIgnoreSslErrors_;
+
+    QVector<Runner> runners_;
+    int startFailoverInd_ = 0;
+    bool isPreferredStarted_ = false;
+    bool isContainerStarted_ = false;
+    bool isContainerExhausted_ = false;
+    bool isFinished_ = false;
+    Runner winner_;
+    QTimer staggerTimer_;
+
+    bool startNext();
+    void onExecuterFinished(RequestExecuterViaFailover *executer, RequestExecuterRetCode retCode);
+    void cancelRunners();
+    void finish(RequestExecuterRetCode retCode);
+};
+
+} // namespace server_api
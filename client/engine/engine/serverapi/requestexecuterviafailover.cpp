@@ -17,6 +17,12 @@ RequestExecuterViaFailover::RequestExecuterViaFailover(QObject *parent, IConnect
 {
 }
 
+RequestExecuterViaFailover::~RequestExecuterViaFailover()
+{
+    if (reply_)
+        delete reply_;
+}
+
 void RequestExecuterViaFailover::execute(QPointer<BaseRequest> request, QSharedPointer<failover::BaseFailover> failover, bool bIgnoreSslErrors)
 {
     WS_ASSERT(request_ == nullptr);
@@ -27,7 +33,8 @@ void RequestExecuterViaFailover::execute(QPointer<BaseRequest> request, QSharedP
     connectStateWatcher_.reset(new ConnectStateWatcher(this, connectStateController_));
 
     connect(failover_.get(), &failover::BaseFailover::finished, this, &RequestExecuterViaFailover::onFailoverFinished);
-    failover_->getData(bIgnoreSslErrors_);
+    failoverRequestId_ = failover_->newRequestId();
+    failover_->getData(failoverRequestId_, bIgnoreSslErrors_);
 }
 
 failover::FailoverData RequestExecuterViaFailover::failoverData() const
@@ -36,8 +43,13 @@ failover::FailoverData RequestExecuterViaFailover::failoverData() const
     return failoverData_[curIndFailoverData_];
 }
 
-void RequestExecuterViaFailover::onFailoverFinished(const QVector<failover::FailoverData> &data)
+void RequestExecuterViaFailover::onFailoverFinished(quint64 requestId, const QVector<failover::FailoverData> &data)
 {
+    // the answer to a request of another executer using the same failover, or a repeated one
+    if (requestId != failoverRequestId_)
+        return;
+    failoverRequestId_ = 0;
+
     // if the request has already been deleted before completion
     if (!request_) {
         emit finished(RequestExecuterRetCode::kRequestDeleted);
@@ -63,6 +75,7 @@ void RequestExecuterViaFailover::onNetworkRequestFinished()
 {
     NetworkReply *reply = static_cast<NetworkReply *>(sender());
     QSharedPointer<NetworkReply> obj = QSharedPointer<NetworkReply>(reply, &QObject::deleteLater);
+    reply_ = nullptr;
 
     // if the request has already been deleted before completion
     if (!request_) {
@@ -134,6 +147,7 @@ void RequestExecuterViaFailover::executeBaseRequest(const failover::FailoverData
         default:
             WS_ASSERT(false);
     }
+    reply_ = reply;
     connect(reply, &NetworkReply::finished, this, &RequestExecuterViaFailover::onNetworkRequestFinished);
 }
 
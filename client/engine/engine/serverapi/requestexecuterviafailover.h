@@ -26,6 +26,8 @@ class RequestExecuterViaFailover : public QObject
     Q_OBJECT
 public:
     explicit RequestExecuterViaFailover(QObject *parent, IConnectStateController *connectStateController, NetworkAccessManager *networkAccessManager);
+    // aborts the network request in progress, if any
+    ~RequestExecuterViaFailover();
 
     void execute(QPointer<BaseRequest> request, QSharedPointer<failover::BaseFailover> failover, bool bIgnoreSslErrors);
     QPointer<BaseRequest> request() { return request_; }
@@ -35,7 +37,7 @@ signals:
     void finished(server_api::RequestExecuterRetCode retCode);
 
 private slots:
-    void onFailoverFinished(const QVector<failover::FailoverData> &data);
+    void onFailoverFinished(quint64 requestId, const QVector<failover::FailoverData> &data);
     void onNetworkRequestFinished();
 
 private:
@@ -44,9 +46,11 @@ private:
 
     QPointer<BaseRequest> request_;
     QSharedPointer<failover::BaseFailover> failover_;
+    quint64 failoverRequestId_ = 0;
     bool bIgnoreSslErrors_;
 
     QScopedPointer<ConnectStateWatcher> connectStateWatcher_;
+    QPointer<NetworkReply> reply_;
 
     QVector<failover::FailoverData> failoverData_;
     int curIndFailoverData_;
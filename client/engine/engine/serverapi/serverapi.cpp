@@ -2,6 +2,7 @@
 
 #include <QUrl>
 #include <QUrlQuery>
+#include <QDataStream>
 
 #include "utils/ws_assert.h"
 #include "utils/logger.h"
@@ -51,17 +52,17 @@ ServerAPI::ServerAPI(QObject *parent, IConnectStateController *connectStateContr
     failoverContainer_(failoverContainer)
 {
     connect(connectStateController_, &IConnectStateController::stateChanged, this, &ServerAPI::onConnectStateChanged);
+    connect(networkDetectionManager_, &INetworkDetectionManager::networkChanged, this, &ServerAPI::onNetworkChanged);
 
     failoverContainer_->setParent(this);
 
-    failoverFromSettingsId_ = readFailoverIdFromSettings();
-    if (failoverContainer_->failoverById(failoverFromSettingsId_))
-        failoverState_ = FailoverState::kFromSettingsUnknown;
+    networkKey_ = currentNetworkKey();
+    updateFailoverFromSettings();
 }
 
 ServerAPI::~ServerAPI()
 {
-    requestExecutorViaFailover_.reset();
+    failoverRacer_.reset();
 }
 
 QString ServerAPI::getHostname() const
@@ -287,44 +288,73 @@ void ServerAPI::onConnectStateChanged(CONNECT_STATE state, DISCONNECT_REASON rea
     }
 }
 
-void ServerAPI::onRequestExecuterViaFailoverFinished(RequestExecuterRetCode retCode)
+void ServerAPI::onNetworkChanged(const types::NetworkInterface &networkInterface)
+{
+    const QString networkKey = networkInterface.networkOrSsid.isEmpty() ? networkInterface.interfaceName : networkInterface.networkOrSsid;
+    if (networkKey == networkKey_)
+        return;
+    networkKey_ = networkKey;
+
+    // the failover is not detected yet or did not work on the previous network, start with the one which worked on this network
+    if (failoverState_ == FailoverState::kUnknown || failoverState_ == FailoverState::kFromSettingsUnknown || failoverState_ == FailoverState::kFailed) {
+        if (failoverState_ == FailoverState::kFailed) {
+            failoverContainer_->reset();
+            isFailoverFailedLogAlreadyDone_ = false;
+        }
+        failoverState_ = FailoverState::kUnknown;
+        updateFailoverFromSettings();
+    }
+}
+
+void ServerAPI::onFailoverStarted(int failoverInd)
+{
+    // Do not emit this signal for the first failover and for from the settings failover
+    if (failoverInd > 0)
+        emit tryingBackupEndpoint(failoverInd, failoverContainer_->count() - 1);
+}
+
+void ServerAPI::onFailoverRacerFinished(RequestExecuterRetCode retCode)
 {
     WS_ASSERT(failoverState_ == FailoverState::kUnknown || failoverState_ == FailoverState::kFromSettingsUnknown);
-    QPointer<BaseRequest> request = requestExecutorViaFailover_->request();
+    QPointer<BaseRequest> request = failoverRacer_->request();
+
+    // the network may have changed while the racer was running, then its result belongs to the previous network
+    const bool isNetworkChanged = failoverRacerNetworkKey_ != networkKey_;
 
     if (retCode == RequestExecuterRetCode::kSuccess) {
-        if (failoverState_ == FailoverState::kFromSettingsUnknown) {
-            failoverState_ = FailoverState::kFromSettingsReady;
-        } else {
-            failoverState_ = FailoverState::kReady;
-            writeFailoverIdToSettings(failoverContainer_->currentFailover()->uniqueId());
+        // also for the preferred one, so that the network becomes the most recently used
+        writeFailoverIdToSettings(failoverRacerNetworkKey_, failoverRacer_->failover()->uniqueId());
+        if (!isNetworkChanged) {
+            if (failoverRacer_->isPreferredFailoverWon()) {
+                failoverState_ = FailoverState::kFromSettingsReady;
+            } else {
+                failoverState_ = FailoverState::kReady;
+                failoverFromSettingsId_ = failoverRacer_->failover()->uniqueId();
+            }
+            failoverData_.reset(new failover::FailoverData(failoverRacer_->failoverData()));
         }
-        failoverData_.reset(new failover::FailoverData(requestExecutorViaFailover_->failoverData()));
-        requestExecutorViaFailover_.reset();
+        // otherwise the state stays unknown and the next request races on the new network
+        failoverRacer_.reset();
         emit request->finished();
         executeWaitingInQueueRequests();
     } else if (retCode == RequestExecuterRetCode::kRequestDeleted) {
         WS_ASSERT(request.isNull());
-        requestExecutorViaFailover_.reset();
+        failoverRacer_.reset();
         executeWaitingInQueueRequests();
     } else if (retCode == RequestExecuterRetCode::kFailoverFailed) {
-        requestExecutorViaFailover_.reset();
-        if (failoverState_ == FailoverState::kFromSettingsUnknown) {
-            failoverState_ = FailoverState::kUnknown;
-            executeRequest(request);
+        // the preferred failover and all the failovers of the container failed
+        failoverRacer_.reset();
+        setErrorCodeAndEmitRequestFinished(request, SERVER_RETURN_FAILOVER_FAILED, "Failover API not ready");
+        if (isNetworkChanged) {
+            // the failovers may work on the new network
+            executeWaitingInQueueRequests();
         } else {
-            WS_ASSERT(failoverState_ == FailoverState::kUnknown);
-            if (failoverContainer_->gotoNext()) {
-                executeRequest(request);
-            } else {
-                failoverState_ = FailoverState::kFailed;
-                setErrorCodeAndEmitRequestFinished(request, SERVER_RETURN_FAILOVER_FAILED, "Failover API not ready");
-                finishWaitingInQueueRequests(SERVER_RETURN_FAILOVER_FAILED, "Failover API not ready");
-            }
+            failoverState_ = FailoverState::kFailed;
+            finishWaitingInQueueRequests(SERVER_RETURN_FAILOVER_FAILED, "Failover API not ready");
         }
     } else if (retCode == RequestExecuterRetCode::kConnectStateChanged) {
         // Repeat the execution of the request via failover
-        requestExecutorViaFailover_.reset();
+        failoverRacer_.reset();
         executeRequest(request);
     } else {
         WS_ASSERT(false);
@@ -336,6 +366,12 @@ void ServerAPI::setIgnoreSslErrors(bool bIgnore)
     bIgnoreSslErrors_ = bIgnore;
 }
 
+void ServerAPI::setFailoverRacing(int maxParallel, int staggerMs)
+{
+    maxParallelFailovers_ = maxParallel;
+    failoverStaggerMs_ = staggerMs;
+}
+
 void ServerAPI::resetFailover()
 {
     failoverContainer_->reset();
@@ -370,7 +406,7 @@ void ServerAPI::executeRequest(QPointer<BaseRequest> request)
     }
 
     // if failover already in progress then move the request to queue
-    if (requestExecutorViaFailover_ != nullptr) {
+    if (failoverRacer_ != nullptr) {
         // wgConfigsInit, wgConfigsConnect and pingTest should have a higher priority in the queue to avoid potential connection delays
         if (dynamic_cast<PingTestRequest *>(request.get()) != nullptr ||
             dynamic_cast<WgConfigsInitRequest *>(request.get()) != nullptr ||
@@ -387,7 +423,7 @@ void ServerAPI::executeRequest(QPointer<BaseRequest> request)
         executeRequestImpl(request, failover::FailoverData(hostnameForConnectedState()));
         executeWaitingInQueueRequests();
     } else {
-        WS_ASSERT(requestExecutorViaFailover_ == nullptr);
+        WS_ASSERT(failoverRacer_ == nullptr);
 
         bool bUseFailover = false;
         if (failoverState_ == FailoverState::kFromSettingsUnknown || failoverState_ == FailoverState::kUnknown) {
@@ -402,16 +438,15 @@ void ServerAPI::executeRequest(QPointer<BaseRequest> request)
         }
 
         if (bUseFailover) {
-            int failoverInd = -1;
-            QSharedPointer<failover::BaseFailover> curFailover = (failoverState_ == FailoverState::kFromSettingsUnknown) ? failoverContainer_->failoverById(failoverFromSettingsId_) : failoverContainer_->currentFailover(&failoverInd);
-            WS_ASSERT(curFailover);
-            qCDebug(LOG_FAILOVER) << "Trying:" << curFailover->name();
-            requestExecutorViaFailover_.reset(new RequestExecuterViaFailover(this, connectStateController_, networkAccessManager_));
-            connect(requestExecutorViaFailover_.get(), &RequestExecuterViaFailover::finished, this, &ServerAPI::onRequestExecuterViaFailoverFinished, Qt::QueuedConnection);
-            requestExecutorViaFailover_->execute(request, curFailover, bIgnoreSslErrors_);
-            // Do not emit this signal for the first failover and for from the settings failover
-            if (failoverInd > 0)
-                emit tryingBackupEndpoint(failoverInd, failoverContainer_->count() - 1);
+            // the failover which worked last time on this network goes first, the container ones race along with it
+            QSharedPointer<failover::BaseFailover> preferredFailover;
+            if (failoverState_ == FailoverState::kFromSettingsUnknown)
+                preferredFailover = failoverContainer_->failoverById(failoverFromSettingsId_);
+            failoverRacer_.reset(new FailoverRacer(this, connectStateController_, networkAccessManager_, failoverContainer_, maxParallelFailovers_, failoverStaggerMs_));
+            failoverRacerNetworkKey_ = networkKey_;
+            connect(failoverRacer_.get(), &FailoverRacer::failoverStarted, this, &ServerAPI::onFailoverStarted);
+            connect(failoverRacer_.get(), &FailoverRacer::finished, this, &ServerAPI::onFailoverRacerFinished, Qt::QueuedConnection);
+            failoverRacer_->execute(request, preferredFailover, bIgnoreSslErrors_);
         } else {
             if (failoverState_ == FailoverState::kReady || failoverState_ == FailoverState::kFromSettingsReady) {
                 WS_ASSERT(!failoverData_.isNull());
@@ -504,15 +539,56 @@ QString ServerAPI::hostnameForConnectedState() const
     return HardcodedSettings::instance().primaryServerDomain();
 }
 
-void ServerAPI::writeFailoverIdToSettings(const QString &failoverId)
+QString ServerAPI::currentNetworkKey() const
+{
+    types::NetworkInterface networkInterface;
+    networkDetectionManager_->getCurrentNetworkInterface(networkInterface);
+    return networkInterface.networkOrSsid.isEmpty() ? networkInterface.interfaceName : networkInterface.networkOrSsid;
+}
+
+void ServerAPI::updateFailoverFromSettings()
+{
+    failoverFromSettingsId_ = readFailoverIdFromSettings(networkKey_);
+    if (failoverState_ == FailoverState::kUnknown && failoverContainer_->failoverById(failoverFromSettingsId_))
+        failoverState_ = FailoverState::kFromSettingsUnknown;
+}
+
+void ServerAPI::writeFailoverIdToSettings(const QString &networkKey, const QString &failoverId)
 {
     QSettings settings;
     SimpleCrypt simpleCrypt(SIMPLE_CRYPT_KEY);
+    // the last one which worked, for the networks without their own
     settings.setValue("flvId", simpleCrypt.encryptToString(failoverId));
+
+    if (!networkKey.isEmpty()) {
+        // the most recently used network first, the least recently used ones are dropped above the limit
+        QList<QPair<QString, QString> > ids = readNetworkFailoverIdsFromSettings();
+        for (auto it = ids.begin(); it != ids.end(); ++it) {
+            if (it->first == networkKey) {
+                ids.erase(it);
+                break;
+            }
+        }
+        ids.prepend(qMakePair(networkKey, failoverId));
+        while (ids.count() > kMaxNetworkFailoverIds)
+            ids.removeLast();
+        QByteArray arr;
+        {
+            QDataStream ds(&arr, QIODevice::WriteOnly);
+            ds << ids;
+        }
+        settings.setValue("flvIds", simpleCrypt.encryptToString(arr));
+    }
 }
 
-QString ServerAPI::readFailoverIdFromSettings() const
+QString ServerAPI::readFailoverIdFromSettings(const QString &networkKey) const
 {
+    const QList<QPair<QString, QString> > ids = readNetworkFailoverIdsFromSettings();
+    for (const auto &id : ids) {
+        if (id.first == networkKey)
+            return id.second;
+    }
+
     QSettings settings;
     SimpleCrypt simpleCrypt(SIMPLE_CRYPT_KEY);
     QString str = settings.value("flvId", "").toString();
@@ -522,4 +598,19 @@ QString ServerAPI::readFailoverIdFromSettings() const
         return QString();
 }
 
+QList<QPair<QString, QString> > ServerAPI::readNetworkFailoverIdsFromSettings() const
+{
+    QList<QPair<QString, QString> > ids;
+    QSettings settings;
+    if (settings.contains("flvIds")) {
+        SimpleCrypt simpleCrypt(SIMPLE_CRYPT_KEY);
+        QByteArray arr = simpleCrypt.decryptToByteArray(settings.value("flvIds").toString());
+        QDataStream ds(&arr, QIODevice::ReadOnly);
+        ds >> ids;
+        if (ds.status() != QDataStream::Ok)
+            ids.clear();
+    }
+    return ids;
+}
+
 } // namespace server_api
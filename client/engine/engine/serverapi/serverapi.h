@@ -13,7 +13,7 @@
 #include "types/apiresolutionsettings.h"
 #include "types/protocol.h"
 #include "types/robertfilter.h"
-#include "requestexecuterviafailover.h"
+#include "failoverracer.h"
 
 namespace server_api {
 
@@ -47,6 +47,9 @@ public:
     void setApiResolutionsSettings(const types::ApiResolutionSettings &apiResolutionSettings);
     void setIgnoreSslErrors(bool bIgnore);
     void resetFailover();
+    // up to maxParallel failovers are tried at the same time, the next one is started staggerMs after the previous one
+    // or right away if one fails; maxParallel = 1 tries them one by one
+    void setFailoverRacing(int maxParallel, int staggerMs);
 
     BaseRequest *login(const QString &username, const QString &password, const QString &code2fa);
     BaseRequest *session(const QString &authHash);
@@ -85,7 +88,9 @@ private slots:
     void onNetworkRequestFinished();
     //void onFailoverNextHostnameAnswer(failover::FailoverRetCode retCode, const QString &hostname);
     void onConnectStateChanged(CONNECT_STATE state, DISCONNECT_REASON reason, CONNECT_ERROR err, const LocationID &location);
-    void onRequestExecuterViaFailoverFinished(server_api::RequestExecuterRetCode retCode);
+    void onNetworkChanged(const types::NetworkInterface &networkInterface);
+    void onFailoverStarted(int failoverInd);
+    void onFailoverRacerFinished(server_api::RequestExecuterRetCode retCode);
 
 private:
     NetworkAccessManager *networkAccessManager_;
@@ -100,9 +105,15 @@ private:
     enum class FailoverState { kUnknown, kFromSettingsUnknown, kFromSettingsReady, kReady, kFailed } failoverState_;
     QScopedPointer<failover::FailoverData> failoverData_;   // valid only in kReady/kFromSettingsReady states
 
+    QString networkKey_;               // the current network, the failover which worked is remembered for each one
     QString failoverFromSettingsId_;   // empty if not exists
 
-    QScopedPointer<RequestExecuterViaFailover> requestExecutorViaFailover_;
+    static constexpr int kDefaultMaxParallelFailovers = 3;
+    static constexpr int kDefaultFailoverStaggerMs = 1500;
+    int maxParallelFailovers_ = kDefaultMaxParallelFailovers;
+    int failoverStaggerMs_ = kDefaultFailoverStaggerMs;
+    QScopedPointer<FailoverRacer> failoverRacer_;
+    QString failoverRacerNetworkKey_;  // the network on which the racer was started
 
     failover::IFailoverContainer *failoverContainer_;
     bool isGettingFailoverHostnameInProgress_ = false;
@@ -120,11 +131,16 @@ private:
     bool isDisconnectedState() const;
 
     QString hostnameForConnectedState() const;
+    QString currentNetworkKey() const;
+    void updateFailoverFromSettings();
 
-    // Save and read the hostname from the settings where it is stored encrypted
+    // Save and read the failover id for the network from the settings where it is stored encrypted
+    // The failover ids are kept for kMaxNetworkFailoverIds of the most recently used networks only
     static constexpr quint64 SIMPLE_CRYPT_KEY = 0x2572241DF31F32EE;
-    void writeFailoverIdToSettings(const QString &failoverId);
-    QString readFailoverIdFromSettings() const;
+    static constexpr int kMaxNetworkFailoverIds = 32;
+    void writeFailoverIdToSettings(const QString &networkKey, const QString &failoverId);
+    QString readFailoverIdFromSettings(const QString &networkKey) const;
+    QList<QPair<QString, QString> > readNetworkFailoverIdsFromSettings() const;
 };
 
 } // namespace server_api
@@ -0,0 +1,239 @@
+#include "failoverracer.test.h"
+
+#include <QtTest>
+#include <QSslSocket>
+
+#include "engine/serverapi/failoverracer.h"
+
+QStringList Failover_moc::startedIds;
+
+LocalEndpoint::LocalEndpoint(QObject *parent, const QString &name, int delayMs, bool bFailing) : QTcpServer(parent),
+    name_(name), delayMs_(delayMs), bFailing_(bFailing)
+{
+    QFile certFile(":localhost.crt");
+    if (certFile.open(QIODevice::ReadOnly))
+        cert_ = QSslCertificate(certFile.readAll());
+    QFile keyFile(":localhost.key");
+    if (keyFile.open(QIODevice::ReadOnly))
+        key_ = QSslKey(keyFile.readAll(), QSsl::Rsa);
+    listen(QHostAddress::LocalHost);
+}
+
+void LocalEndpoint::incomingConnection(qintptr socketDescriptor)
+{
+    QSslSocket *socket = new QSslSocket(this);
+    if (!socket->setSocketDescriptor(socketDescriptor)) {
+        delete socket;
+        return;
+    }
+    socket->setLocalCertificate(cert_);
+    socket->setPrivateKey(key_);
+    connect(socket, &QSslSocket::readyRead, [this, socket]() {
+        QByteArray request = socket->readAll();
+        if (!request.contains("\r\n\r\n"))
+            return;
+        requestsCount_++;
+        if (bFailing_) {
+            socket->abort();
+            return;
+        }
+        // the client may give up on this endpoint while the answer is delayed
+        QPointer<QSslSocket> pointerToSocket(socket);
+        QTimer::singleShot(delayMs_, this, [this, pointerToSocket]() {
+            if (pointerToSocket) {
+                const QByteArray body = name_.toUtf8();
+                pointerToSocket->write("HTTP/1.1 200 OK\r\nContent-Length: " + QByteArray::number(body.size()) + "\r\nConnection: close\r\n\r\n" + body);
+            }
+        });
+    });
+    connect(socket, &QSslSocket::disconnected, socket, &QObject::deleteLater);
+    socket->startServerEncryption();
+}
+
+void Failover_moc::getData(quint64 requestId, bool bIgnoreSslErrors)
+{
+    startedIds << uniqueId();
+    QTimer::singleShot(delayMs_, this, [this, requestId]() {
+        if (endpoint_)
+            emit finished(requestId, QVector<failover::FailoverData>() << failover::FailoverData(endpoint_->domain()));
+        else
+            emit finished(requestId, QVector<failover::FailoverData>());
+    });
+}
+
+namespace {
+
+server_api::RequestExecuterRetCode runRacer(server_api::FailoverRacer *racer, LocalRequest *request,
+                                            QSharedPointer<failover::BaseFailover> preferredFailover, qint64 *outElapsedMs = nullptr)
+{
+    QSignalSpy spy(racer, SIGNAL(finished(server_api::RequestExecuterRetCode)));
+    QElapsedTimer timer;
+    timer.start();
+    racer->execute(request, preferredFailover, true);
+    spy.wait(20000);
+    if (outElapsedMs)
+        *outElapsedMs = timer.elapsed();
+    if (spy.count() != 1)
+        return server_api::RequestExecuterRetCode::kFailoverFailed;
+    return spy.takeFirst().at(0).value<server_api::RequestExecuterRetCode>();
+}
+
+} // namespace
+
+FailoverRacer_test::FailoverRacer_test()
+{
+#ifdef Q_OS_WIN
+    // Initialize Winsock
+    WSADATA wsaData;
+    int iResult = WSAStartup(MAKEWORD(2,2), &wsaData);
+#endif
+}
+
+void FailoverRacer_test::init()
+{
+    Failover_moc::startedIds.clear();
+    networkAccessManager_ = new NetworkAccessManager(this);
+    connectStateController_ = new ConnectStateController_moc(this);
+}
+
+void FailoverRacer_test::cleanup()
+{
+    delete networkAccessManager_;
+    delete connectStateController_;
+}
+
+void FailoverRacer_test::testFastestWins()
+{
+    LocalEndpoint slow(this, "slow", 3000, false);
+    LocalEndpoint fast(this, "fast", 0, false);
+    FailoverContainer_moc container(this, { { "f0", 0, &slow }, { "f1", 0, &fast } });
+    server_api::FailoverRacer racer(this, connectStateController_, networkAccessManager_, &container, 3, 200);
+    LocalRequest request(this);
+
+    qint64 elapsedMs;
+    QCOMPARE(runRacer(&racer, &request, nullptr, &elapsedMs), server_api::RequestExecuterRetCode::kSuccess);
+    QCOMPARE(request.answer(), QString("fast"));
+    QCOMPARE(racer.failover()->uniqueId(), QString("f1"));
+    QCOMPARE(racer.failoverData().domain(), fast.domain());
+    QVERIFY(!racer.isPreferredFailoverWon());
+    QVERIFY(elapsedMs < 2000);
+
+    // the container points to the winner
+    int ind = -1;
+    container.currentFailover(&ind);
+    QCOMPARE(ind, 1);
+}
+
+void FailoverRacer_test::testFailedStartsNextRightAway()
+{
+    LocalEndpoint endpoint(this, "endpoint", 0, false);
+    FailoverContainer_moc container(this, { { "f0", 100, nullptr }, { "f1", 0, &endpoint } });
+    server_api::FailoverRacer racer(this, connectStateController_, networkAccessManager_, &container, 3, 10000);
+    LocalRequest request(this);
+
+    qint64 elapsedMs;
+    QCOMPARE(runRacer(&racer, &request, nullptr, &elapsedMs), server_api::RequestExecuterRetCode::kSuccess);
+    QCOMPARE(request.answer(), QString("endpoint"));
+    QCOMPARE(Failover_moc::startedIds, QStringList() << "f0" << "f1");
+    // did not wait for the stagger delay
+    QVERIFY(elapsedMs < 5000);
+}
+
+void FailoverRacer_test::testEndpointFailed()
+{
+    LocalEndpoint failing(this, "failing", 0, true);
+    LocalEndpoint endpoint(this, "endpoint", 0, false);
+    FailoverContainer_moc container(this, { { "f0", 0, &failing }, { "f1", 0, &endpoint } });
+    server_api::FailoverRacer racer(this, connectStateController_, networkAccessManager_, &container, 3, 10000);
+    LocalRequest request(this);
+
+    qint64 elapsedMs;
+    QCOMPARE(runRacer(&racer, &request, nullptr, &elapsedMs), server_api::RequestExecuterRetCode::kSuccess);
+    QCOMPARE(request.answer(), QString("endpoint"));
+    QVERIFY(failing.requestsCount() > 0);
+    QVERIFY(elapsedMs < 5000);
+}
+
+void FailoverRacer_test::testAllFailed()
+{
+    LocalEndpoint failing(this, "failing", 0, true);
+    FailoverContainer_moc container(this, { { "f0", 0, nullptr }, { "f1", 50, &failing }, { "f2", 100, nullptr } });
+    server_api::FailoverRacer racer(this, connectStateController_, networkAccessManager_, &container, 2, 100);
+    LocalRequest request(this);
+
+    QCOMPARE(runRacer(&racer, &request, nullptr), server_api::RequestExecuterRetCode::kFailoverFailed);
+    QCOMPARE(Failover_moc::startedIds, QStringList() << "f0" << "f1" << "f2");
+}
+
+void FailoverRacer_test::testSequential()
+{
+    LocalEndpoint slow(this, "slow", 500, false);
+    LocalEndpoint fast(this, "fast", 0, false);
+    FailoverContainer_moc container(this, { { "f0", 0, &slow }, { "f1", 0, &fast } });
+    server_api::FailoverRacer racer(this, connectStateController_, networkAccessManager_, &container, 1, 0);
+    LocalRequest request(this);
+
+    QCOMPARE(runRacer(&racer, &request, nullptr), server_api::RequestExecuterRetCode::kSuccess);
+    QCOMPARE(request.answer(), QString("slow"));
+    QCOMPARE(Failover_moc::startedIds, QStringList() << "f0");
+}
+
+void FailoverRacer_test::testPreferredFailover()
+{
+    LocalEndpoint slow(this, "slow", 3000, false);
+    LocalEndpoint remembered(this, "remembered", 0, false);
+    FailoverContainer_moc container(this, { { "f0", 0, &slow }, { "f1", 0, &slow }, { "f2", 0, &remembered } });
+    server_api::FailoverRacer racer(this, connectStateController_, networkAccessManager_, &container, 3, 2000);
+    LocalRequest request(this);
+
+    QCOMPARE(runRacer(&racer, &request, container.failoverById("f2")), server_api::RequestExecuterRetCode::kSuccess);
+    QCOMPARE(request.answer(), QString("remembered"));
+    QVERIFY(racer.isPreferredFailoverWon());
+    QCOMPARE(Failover_moc::startedIds, QStringList() << "f2");
+
+    // the container did not move
+    int ind = -1;
+    container.currentFailover(&ind);
+    QCOMPARE(ind, 0);
+}
+
+void FailoverRacer_test::testRequestDeleted()
+{
+    LocalEndpoint slow(this, "slow", 1000, false);
+    FailoverContainer_moc container(this, { { "f0", 0, &slow }, { "f1", 0, &slow } });
+    server_api::FailoverRacer racer(this, connectStateController_, networkAccessManager_, &container, 3, 100);
+    LocalRequest *request = new LocalRequest(this);
+
+    QSignalSpy spy(&racer, SIGNAL(finished(server_api::RequestExecuterRetCode)));
+    racer.execute(request, nullptr, true);
+    delete request;
+    QVERIFY(spy.wait(10000));
+    QCOMPARE(spy.takeFirst().at(0).value<server_api::RequestExecuterRetCode>(), server_api::RequestExecuterRetCode::kRequestDeleted);
+}
+
+void FailoverRacer_test::testSharedFailover()
+{
+    LocalEndpoint endpoint(this, "endpoint", 0, false);
+    FailoverContainer_moc container(this, { { "f0", 300, &endpoint } });
+    server_api::FailoverRacer racer1(this, connectStateController_, networkAccessManager_, &container, 1, 0);
+    server_api::FailoverRacer racer2(this, connectStateController_, networkAccessManager_, &container, 1, 0);
+    LocalRequest request1(this);
+    LocalRequest request2(this);
+
+    // both racers ask the same failover object, each one must take only the answer to its own request
+    QSignalSpy spy1(&racer1, SIGNAL(finished(server_api::RequestExecuterRetCode)));
+    QSignalSpy spy2(&racer2, SIGNAL(finished(server_api::RequestExecuterRetCode)));
+    racer1.execute(&request1, nullptr, true);
+    racer2.execute(&request2, nullptr, true);
+    QVERIFY(spy1.count() == 1 || spy1.wait(10000));
+    QVERIFY(spy2.count() == 1 || spy2.wait(10000));
+    QCOMPARE(spy1.takeFirst().at(0).value<server_api::RequestExecuterRetCode>(), server_api::RequestExecuterRetCode::kSuccess);
+    QCOMPARE(spy2.takeFirst().at(0).value<server_api::RequestExecuterRetCode>(), server_api::RequestExecuterRetCode::kSuccess);
+    QCOMPARE(Failover_moc::startedIds, QStringList() << "f0" << "f0");
+
+    // no request was sent twice
+    QTest::qWait(500);
+    QCOMPARE(endpoint.requestsCount(), 2);
+}
+
+QTEST_MAIN(FailoverRacer_test)
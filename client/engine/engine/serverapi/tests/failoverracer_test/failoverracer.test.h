@@ -0,0 +1,188 @@
+#pragma once
+
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QSslCertificate>
+#include <QSslKey>
+#include <QTcpServer>
+#include "engine/connectstatecontroller/iconnectstatecontroller.h"
+#include "engine/failover/ifailovercontainer.h"
+#include "engine/networkaccessmanager/networkaccessmanager.h"
+#include "engine/serverapi/requests/baserequest.h"
+
+class ConnectStateController_moc : public IConnectStateController
+{
+    Q_OBJECT
+public:
+    explicit ConnectStateController_moc(QObject *parent) : IConnectStateController(parent),
+        state_(CONNECT_STATE_DISCONNECTED),
+        prevState_(CONNECT_STATE_DISCONNECTED)
+    {}
+
+    CONNECT_STATE currentState() override {  return state_;  }
+    CONNECT_STATE prevState() override  {  return prevState_; }
+
+    DISCONNECT_REASON disconnectReason() override
+    {
+        return DISCONNECTED_ITSELF;
+    }
+    CONNECT_ERROR connectionError() override  { return NO_CONNECT_ERROR;  }
+    const LocationID& locationId() override  { return lid_;  }
+    void setState(CONNECT_STATE state)
+    {
+        if (state != state_) {
+            prevState_ = state_;
+            state_ = state;
+            emit stateChanged(state_, DISCONNECTED_ITSELF, NO_CONNECT_ERROR, lid_);
+        }
+    }
+
+private:
+    LocationID lid_;
+    CONNECT_STATE state_;
+    CONNECT_STATE prevState_;
+};
+
+// Stand-in for an API endpoint: a local TLS server which answers with its name after delayMs,
+// or drops the connection if it is failing
+class LocalEndpoint : public QTcpServer
+{
+    Q_OBJECT
+public:
+    explicit LocalEndpoint(QObject *parent, const QString &name, int delayMs, bool bFailing);
+    QString domain() const { return "127.0.0.1:" + QString::number(serverPort()); }
+    int requestsCount() const { return requestsCount_; }
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private:
+    QString name_;
+    int delayMs_;
+    bool bFailing_;
+    int requestsCount_ = 0;
+    QSslCertificate cert_;
+    QSslKey key_;
+};
+
+// Failover which finishes after delayMs with the domain of its endpoint, or with nothing if there is no endpoint
+class Failover_moc : public failover::BaseFailover
+{
+    Q_OBJECT
+public:
+    explicit Failover_moc(QObject *parent, const QString &uniqueId, int delayMs, LocalEndpoint *endpoint) : BaseFailover(parent, uniqueId),
+        delayMs_(delayMs), endpoint_(endpoint) {}
+
+    void getData(quint64 requestId, bool bIgnoreSslErrors) override;
+    QString name() const override { return "failover " + uniqueId(); }
+
+    static QStringList startedIds;
+
+private:
+    int delayMs_;
+    QPointer<LocalEndpoint> endpoint_;
+};
+
+struct FailoverDesc
+{
+    QString uniqueId;
+    int delayMs;
+    LocalEndpoint *endpoint;
+};
+
+class FailoverContainer_moc : public failover::IFailoverContainer
+{
+    Q_OBJECT
+public:
+    explicit FailoverContainer_moc(QObject *parent, const QVector<FailoverDesc> &failovers) : IFailoverContainer(parent),
+        failovers_(failovers)
+    {
+        reset();
+    }
+
+    void reset() override
+    {
+        gotoIndex(0);
+    }
+
+    QSharedPointer<failover::BaseFailover> currentFailover(int *outInd = nullptr) override
+    {
+        if (outInd)
+            *outInd = curFailoverInd_;
+        return currentFailover_;
+    }
+
+    bool gotoNext() override
+    {
+        return gotoIndex(curFailoverInd_ + 1);
+    }
+
+    bool gotoIndex(int ind) override
+    {
+        if (ind < 0 || ind >= failovers_.size())
+            return false;
+        curFailoverInd_ = ind;
+        currentFailover_ = failoverById(failovers_[ind].uniqueId);
+        return true;
+    }
+
+    QSharedPointer<failover::BaseFailover> failoverById(const QString &failoverUniqueId) override
+    {
+        for (const auto &desc : failovers_) {
+            if (desc.uniqueId == failoverUniqueId)
+                return QSharedPointer<failover::BaseFailover>(new Failover_moc(this, desc.uniqueId, desc.delayMs, desc.endpoint));
+        }
+        return nullptr;
+    }
+
+    int count() const override
+    {
+        return failovers_.count();
+    }
+
+private:
+    QVector<FailoverDesc> failovers_;
+    int curFailoverInd_ = 0;
+    QSharedPointer<failover::BaseFailover> currentFailover_;
+};
+
+class LocalRequest : public server_api::BaseRequest
+{
+    Q_OBJECT
+public:
+    explicit LocalRequest(QObject *parent) : BaseRequest(parent, server_api::RequestType::kGet, true, 5000) {}
+
+    QUrl url(const QString &domain) const override { return QUrl("https://" + domain + "/"); }
+    QString name() const override { return "Local"; }
+    void handle(const QByteArray &arr) override { answer_ = arr; }
+    QString answer() const { return answer_; }
+
+private:
+    QString answer_;
+};
+
+class FailoverRacer_test : public QObject
+{
+    Q_OBJECT
+
+public:
+    FailoverRacer_test();
+
+private slots:
+    void init();
+    void cleanup();
+
+    void testFastestWins();
+    void testFailedStartsNextRightAway();
+    void testEndpointFailed();
+    void testAllFailed();
+    void testSequential();
+    void testPreferredFailover();
+    void testRequestDeleted();
+    void testSharedFailover();
+
+private:
+    NetworkAccessManager *networkAccessManager_;
+    ConnectStateController_moc *connectStateController_;
+};
@@ -66,11 +66,11 @@ class Failover_moc : public failover::BaseFailover
 public:
     explicit Failover_moc(QObject *parent, QString domain, bool bSuccess) : BaseFailover(parent, "id"),  domain_(domain), bSuccess_(bSuccess) {}
 
-    void getData(bool bIgnoreSslErrors) {
+    void getData(quint64 requestId, bool bIgnoreSslErrors) {
         if (bSuccess_) {
-            emit finished(QVector<failover::FailoverData>() << failover::FailoverData(domain_));
+            emit finished(requestId, QVector<failover::FailoverData>() << failover::FailoverData(domain_));
         } else {
-            emit finished(QVector<failover::FailoverData>());
+            emit finished(requestId, QVector<failover::FailoverData>());
         }
     }
 
@@ -118,6 +118,15 @@ public:
         }
     }
 
+    bool gotoIndex(int ind) override
+    {
+        if (ind < 0 || ind >= failovers_.size())
+            return false;
+        curFailoverInd_ = ind;
+        currentFailover_ = QSharedPointer<failover::BaseFailover>(new Failover_moc(this, failovers_[curFailoverInd_].first, failovers_[curFailoverInd_].second));
+        return true;
+    }
+
     QSharedPointer<failover::BaseFailover> failoverById(const QString &failoverUniqueId) override
     {
         return nullptr;
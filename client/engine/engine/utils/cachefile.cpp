@@ -0,0 +1,175 @@
+#include "cachefile.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtEndian>
+
+CacheFile &CacheFile::instance()
+{
+    static CacheFile cacheFile(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/cache.bin");
+    return cacheFile;
+}
+
+CacheFile::CacheFile(const QString &path) : path_(path)
+{
+}
+
+QHash<quint32, QByteArray> CacheFile::readSections(const QVector<quint32> &ids) const
+{
+    QMutexLocker locker(&mutex_);
+    QHash<quint32, QByteArray> result;
+
+    QFile file(path_);
+    if (!file.open(QIODevice::ReadOnly))
+        return result;
+    const qint64 fileSize = file.size();
+    const uchar *data = file.map(0, fileSize);
+    if (!data)
+        return result;
+
+    QVector<Section> sections;
+    if (parseTable(data, fileSize, sections))
+    {
+        for (const Section &section : std::as_const(sections))
+        {
+            if (!ids.contains(section.id))
+                continue;
+            const char *sectionData = reinterpret_cast<const char *>(data + section.offset);
+            if (checksum(sectionData, section.size) == section.checksum)
+                result[section.id] = QByteArray(sectionData, section.size);
+        }
+    }
+
+    file.unmap(const_cast<uchar *>(data));
+    return result;
+}
+
+QByteArray CacheFile::readSection(quint32 id) const
+{
+    return readSections(QVector<quint32>() << id).value(id);
+}
+
+bool CacheFile::writeSections(const QHash<quint32, QByteArray> &sections)
+{
+    QMutexLocker locker(&mutex_);
+
+    // the sections of the current file which are kept, copied while it is mapped
+    QVector<quint32> ids;
+    QVector<QByteArray> datas;
+    {
+        QFile file(path_);
+        if (file.open(QIODevice::ReadOnly))
+        {
+            const qint64 fileSize = file.size();
+            const uchar *data = file.map(0, fileSize);
+            QVector<Section> oldSections;
+            if (data && parseTable(data, fileSize, oldSections))
+            {
+                for (const Section &section : std::as_const(oldSections))
+                {
+                    if (sections.contains(section.id))
+                        continue;
+                    // a damaged section is dropped, otherwise it would get a valid checksum in the new file
+                    const char *sectionData = reinterpret_cast<const char *>(data + section.offset);
+                    if (checksum(sectionData, section.size) != section.checksum)
+                        continue;
+                    ids << section.id;
+                    datas << QByteArray(sectionData, section.size);
+                }
+            }
+            if (data)
+                file.unmap(const_cast<uchar *>(data));
+        }
+    }
+    for (auto it = sections.constBegin(); it != sections.constEnd(); ++it)
+    {
+        if (!it.value().isEmpty())
+        {
+            ids << it.key();
+            datas << it.value();
+        }
+    }
+
+    auto align = [](qint64 offset) { return (offset + kAlignment - 1) / kAlignment * kAlignment; };
+    qint64 offset = align(kHeaderSize + kTableEntrySize * ids.size());
+    QByteArray out(offset, '\0');
+    uchar *header = reinterpret_cast<uchar *>(out.data());
+    qToLittleEndian<quint32>(kMagic, header);
+    qToLittleEndian<quint32>(kVersion, header + 4);
+    qToLittleEndian<quint32>(ids.size(), header + 8);
+    qToLittleEndian<quint32>(0, header + 12);
+    for (int i = 0; i < ids.size(); ++i)
+    {
+        uchar *entry = reinterpret_cast<uchar *>(out.data()) + kHeaderSize + kTableEntrySize * i;
+        qToLittleEndian<quint32>(ids[i], entry);
+        qToLittleEndian<quint32>(checksum(datas[i].constData(), datas[i].size()), entry + 4);
+        qToLittleEndian<quint64>(offset, entry + 8);
+        qToLittleEndian<quint64>(datas[i].size(), entry + 16);
+        offset = align(offset + datas[i].size());
+    }
+    for (const QByteArray &data : std::as_const(datas))
+    {
+        out += data;
+        out.append(align(out.size()) - out.size(), '\0');
+    }
+
+    QDir().mkpath(QFileInfo(path_).absolutePath());
+    QSaveFile file(path_);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    if (file.write(out) != out.size())
+    {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
+
+bool CacheFile::writeSection(quint32 id, const QByteArray &data)
+{
+    QHash<quint32, QByteArray> sections;
+    sections[id] = data;
+    return writeSections(sections);
+}
+
+bool CacheFile::parseTable(const uchar *data, qint64 size, QVector<Section> &outSections)
+{
+    if (size < kHeaderSize)
+        return false;
+    if (qFromLittleEndian<quint32>(data) != kMagic || qFromLittleEndian<quint32>(data + 4) > kVersion)
+        return false;
+    const quint32 count = qFromLittleEndian<quint32>(data + 8);
+    if (count > quint64(size - kHeaderSize) / kTableEntrySize)
+        return false;
+
+    outSections.clear();
+    outSections.reserve(count);
+    for (quint32 i = 0; i < count; ++i)
+    {
+        const uchar *entry = data + kHeaderSize + kTableEntrySize * i;
+        Section section;
+        section.id = qFromLittleEndian<quint32>(entry);
+        section.checksum = qFromLittleEndian<quint32>(entry + 4);
+        section.offset = qFromLittleEndian<quint64>(entry + 8);
+        section.size = qFromLittleEndian<quint64>(entry + 16);
+        if (section.offset > quint64(size) || section.size > quint64(size) - section.offset)
+            return false;
+        outSections << section;
+    }
+    return true;
+}
+
+quint32 CacheFile::checksum(const char *data, qint64 size)
+{
+    // FNV-1a, only to detect a damaged file
+    quint32 hash = 2166136261u;
+    for (qint64 i = 0; i < size; ++i)
+    {
+        hash ^= uchar(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
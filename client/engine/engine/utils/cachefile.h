@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+// A versioned binary cache file made of independent sections (the locations, the server credentials, the pings, ...).
+// Layout, little-endian:
+//   header:   magic (4), version (4), sections count (4), reserved (4)
+//   table:    for each section: id (4), checksum (4), offset (8), size (8)
+//   sections: each at an offset aligned to 8
+// Reading maps the file and copies only the requested sections, their owners decode them when they need them.
+// Writing replaces the given sections and copies the other valid ones as they are (without decoding), the damaged ones
+// are dropped, the file is replaced atomically. The contents of a section (e.g. encrypted) are up to its owner.
+class CacheFile
+{
+public:
+    // the ids are four-character codes, e.g. CacheFile::makeId("LOCS")
+    static constexpr quint32 makeId(const char (&code)[5])
+    {
+        return quint32(uchar(code[0])) | quint32(uchar(code[1])) << 8 | quint32(uchar(code[2])) << 16 | quint32(uchar(code[3])) << 24;
+    }
+
+    // the cache file of the app (in the app local data location)
+    static CacheFile &instance();
+
+    explicit CacheFile(const QString &path);
+
+    // the sections which are missing or damaged are not returned
+    QHash<quint32, QByteArray> readSections(const QVector<quint32> &ids) const;
+    QByteArray readSection(quint32 id) const;
+
+    // an empty data removes the section
+    bool writeSections(const QHash<quint32, QByteArray> &sections);
+    bool writeSection(quint32 id, const QByteArray &data);
+
+private:
+    static constexpr quint32 kMagic = 0x46435357;   // "WSCF"
+    static constexpr quint32 kVersion = 1;          // should increment the version if the layout is changed
+    static constexpr int kHeaderSize = 16;
+    static constexpr int kTableEntrySize = 24;
+    static constexpr int kAlignment = 8;
+
+    struct Section
+    {
+        quint32 id;
+        quint32 checksum;
+        quint64 offset;
+        quint64 size;
+    };
+
+    QString path_;
+    mutable QMutex mutex_;
+
+    // the sections of a mapped file, false if the file is not valid
+    static bool parseTable(const uchar *data, qint64 size, QVector<Section> &outSections);
+    static quint32 checksum(const char *data, qint64 size);
+};
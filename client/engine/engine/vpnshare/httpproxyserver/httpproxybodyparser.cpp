@@ -0,0 +1,189 @@
+#include "httpproxybodyparser.h"
+
+namespace HttpProxyServer {
+
+HttpProxyBodyParser::HttpProxyBodyParser() : framing_(NO_BODY), remaining_(0), state_(body_done)
+{
+
+}
+
+void HttpProxyBodyParser::reset(FRAMING framing, qint64 contentLength)
+{
+    framing_ = framing;
+    remaining_ = (framing == CONTENT_LENGTH) ? contentLength : 0;
+    state_ = (framing == CHUNKED) ? chunk_size_start : body_done;
+}
+
+TRI_BOOL HttpProxyBodyParser::parse(const QByteArray &arr, quint32 &outParsed)
+{
+    if (framing_ == NO_BODY)
+    {
+        outParsed = 0;
+        return TRI_TRUE;
+    }
+    else if (framing_ == UNTIL_CLOSE)
+    {
+        outParsed = arr.size();
+        return TRI_INDETERMINATE;
+    }
+    else if (framing_ == CONTENT_LENGTH)
+    {
+        const qint64 size = qMin(remaining_, (qint64)arr.size());
+        remaining_ -= size;
+        outParsed = size;
+        return remaining_ == 0 ? TRI_TRUE : TRI_INDETERMINATE;
+    }
+
+    const char *data = arr.data();
+    int i = 0;
+    while (i < arr.size())
+    {
+        if (state_ == chunk_data)
+        {
+            // the data of the chunk is skipped at once
+            const qint64 size = qMin(remaining_, (qint64)(arr.size() - i));
+            remaining_ -= size;
+            i += size;
+            if (remaining_ == 0)
+            {
+                state_ = chunk_data_cr;
+            }
+            continue;
+        }
+
+        TRI_BOOL res = consume(data[i++]);
+        if (res == TRI_TRUE || res == TRI_FALSE)
+        {
+            outParsed = i;
+            return res;
+        }
+    }
+
+    outParsed = arr.size();
+    return TRI_INDETERMINATE;
+}
+
+TRI_BOOL HttpProxyBodyParser::consume(char input)
+{
+    switch (state_)
+    {
+        case chunk_size_start:
+            if (hexValue(input) < 0)
+            {
+                return TRI_FALSE;
+            }
+            else
+            {
+                remaining_ = hexValue(input);
+                state_ = chunk_size;
+                return TRI_INDETERMINATE;
+            }
+        case chunk_size:
+            if (hexValue(input) >= 0)
+            {
+                remaining_ = remaining_ * 16 + hexValue(input);
+                return remaining_ > kMaxChunkSize ? TRI_FALSE : TRI_INDETERMINATE;
+            }
+            else if (input == '\r')
+            {
+                state_ = chunk_size_newline;
+                return TRI_INDETERMINATE;
+            }
+            else if (input == ';' || input == ' ' || input == '\t')
+            {
+                state_ = chunk_extension;
+                return TRI_INDETERMINATE;
+            }
+            else
+            {
+                return TRI_FALSE;
+            }
+        case chunk_extension:
+            if (input == '\r')
+            {
+                state_ = chunk_size_newline;
+            }
+            return TRI_INDETERMINATE;
+        case chunk_size_newline:
+            if (input == '\n')
+            {
+                // the last chunk has the size 0 and is followed by the trailers
+                state_ = (remaining_ == 0) ? trailer_line_start : chunk_data;
+                return TRI_INDETERMINATE;
+            }
+            else
+            {
+                return TRI_FALSE;
+            }
+        case chunk_data_cr:
+            if (input == '\r')
+            {
+                state_ = chunk_data_newline;
+                return TRI_INDETERMINATE;
+            }
+            else
+            {
+                return TRI_FALSE;
+            }
+        case chunk_data_newline:
+            if (input == '\n')
+            {
+                state_ = chunk_size_start;
+                return TRI_INDETERMINATE;
+            }
+            else
+            {
+                return TRI_FALSE;
+            }
+        case trailer_line_start:
+            state_ = (input == '\r') ? final_newline : trailer_line;
+            return TRI_INDETERMINATE;
+        case trailer_line:
+            if (input == '\r')
+            {
+                state_ = trailer_newline;
+            }
+            return TRI_INDETERMINATE;
+        case trailer_newline:
+            if (input == '\n')
+            {
+                state_ = trailer_line_start;
+                return TRI_INDETERMINATE;
+            }
+            else
+            {
+                return TRI_FALSE;
+            }
+        case final_newline:
+            if (input == '\n')
+            {
+                state_ = body_done;
+                return TRI_TRUE;
+            }
+            else
+            {
+                return TRI_FALSE;
+            }
+        default:
+            return TRI_FALSE;
+    }
+}
+
+int HttpProxyBodyParser::hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    else if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    else if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+} // namespace HttpProxyServer
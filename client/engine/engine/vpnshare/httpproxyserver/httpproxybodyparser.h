@@ -0,0 +1,52 @@
+#ifndef HTTPPROXYBODYPARSER_H
+#define HTTPPROXYBODYPARSER_H
+
+#include <QByteArray>
+#include "httpproxyrequestparser.h"
+
+namespace HttpProxyServer {
+
+// Finds the end of the body of a request or an answer, the body itself is passed on unchanged.
+class HttpProxyBodyParser
+{
+public:
+    enum FRAMING { NO_BODY, CONTENT_LENGTH, CHUNKED, UNTIL_CLOSE };
+
+    HttpProxyBodyParser();
+
+    void reset(FRAMING framing, qint64 contentLength = 0);
+    FRAMING framing() const { return framing_; }
+
+    // TRI_TRUE if the body ends in arr, outParsed is the size of its part of arr
+    TRI_BOOL parse(const QByteArray &arr, quint32 &outParsed);
+
+private:
+    static constexpr qint64 kMaxChunkSize = Q_INT64_C(1) << 40;
+
+    FRAMING framing_;
+    qint64 remaining_;      // of the content or of the current chunk
+
+    TRI_BOOL consume(char input);
+
+    static int hexValue(char c);
+
+    enum state
+    {
+        chunk_size_start,
+        chunk_size,
+        chunk_extension,
+        chunk_size_newline,
+        chunk_data,
+        chunk_data_cr,
+        chunk_data_newline,
+        trailer_line_start,
+        trailer_line,
+        trailer_newline,
+        final_newline,
+        body_done
+    } state_;
+};
+
+} // namespace HttpProxyServer
+
+#endif // HTTPPROXYBODYPARSER_H
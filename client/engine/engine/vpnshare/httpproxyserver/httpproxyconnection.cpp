@@ -1,21 +1,34 @@
 #include "httpproxyconnection.h"
 #include <QThread>
 #include <QHostAddress>
+#include "httpproxyupstreampool.h"
 #include "utils/ws_assert.h"
 #include "utils/logger.h"
 
+#ifdef Q_OS_LINUX
+    #include "../socketutils/splicerelay.h"
+#endif
+
 namespace HttpProxyServer {
 
 
-HttpProxyConnection::HttpProxyConnection(qintptr socketDescriptor, const QString &hostname, QObject *parent) : QObject(parent),
+HttpProxyConnection::HttpProxyConnection(qintptr socketDescriptor, const QString &hostname, SpliceRelay *spliceRelay,
+                                         HttpProxyUpstreamPool *upstreamPool, QObject *parent) : QObject(parent),
     socket_(nullptr), socketExternal_(nullptr), socketDescriptor_(socketDescriptor),
-    hostname_(hostname), state_(READ_CLIENT_REQUEST), writeAllSocket_(nullptr),
-    writeAllSocketExternal_(nullptr), httpError_(), bAlreadyClosedAndEmitFinished_(false)
+    hostname_(hostname), state_(READ_CLIENT_REQUEST), bRequestBodyDone_(false), bClientKeepAlive_(false),
+    bAnswerStarted_(false), writeAllSocket_(nullptr), writeAllSocketExternal_(nullptr), httpError_(),
+    spliceRelay_(spliceRelay), spliceRelayId_(0), upstreamPool_(upstreamPool), bUpstreamReused_(false),
+    bAlreadyClosedAndEmitFinished_(false)
 {
     httpError_.status = HttpProxyReply::ok;
     //qDebug() << QThread::currentThreadId();
 }
 
+void HttpProxyConnection::setReadData(const QByteArray &readData)
+{
+    readData_ = readData;
+}
+
 void HttpProxyConnection::forceClose()
 {
     closeSocketsAndEmitFinished();
@@ -33,7 +46,14 @@ void HttpProxyConnection::start()
     state_ = READ_CLIENT_REQUEST;
     connect(socket_, SIGNAL(disconnected()), SLOT(onSocketDisconnected()));
     connect(socket_, SIGNAL(readyRead()), SLOT(onSocketReadyRead()));
+    connect(socket_, SIGNAL(bytesWritten(qint64)), SLOT(onSocketBytesWritten()));
+    // the pipelined requests wait in the socket, no more of them is read from the network
+    socket_->setReadBufferSize(SocketWriteAll::kMaxPendingBytes);
     writeAllSocket_ = new SocketWriteAll(this, socket_);
+    if (!readData_.isEmpty())
+    {
+        onSocketReadyRead();
+    }
 }
 
 void HttpProxyConnection::onSocketDisconnected()
@@ -44,73 +64,304 @@ void HttpProxyConnection::onSocketDisconnected()
 
 void HttpProxyConnection::onSocketReadyRead()
 {
-    QByteArray arr = socket_->readAll();
+    if (state_ == RELAY_BETWEEN_CLIENT_SERVER)
+    {
+        // with the splice relay the data waits in the socket until the socket is taken over
+        if (!spliceRelay_)
+        {
+            writeAllSocketExternal_->relayFrom(socket_);
+        }
+        return;
+    }
+    else if (state_ == READ_HEADERS_FROM_WEBSERVER || state_ == READ_BODY_FROM_WEBSERVER)
+    {
+        // the body of the request goes on to the server, the next requests wait in the socket for the answer
+        readRequestBody();
+        return;
+    }
+    else if (state_ != READ_CLIENT_REQUEST)
+    {
+        // the connection to the server is not ready yet, or the connection is closing
+        return;
+    }
+
+    QByteArray arr = readData_ + socket_->readAll();
+    readData_.clear();
 
-    if (state_ == READ_CLIENT_REQUEST)
+    quint32 parsed;
+    TRI_BOOL ret;
+    ret = requestParser_.parse(arr, parsed);
+
+    if (ret == TRI_TRUE)
     {
-        quint32 parsed;
-        TRI_BOOL ret;
-        ret = requestParser_.parse(arr, parsed);
+        // the body of the request, and maybe the pipelined requests
+        readData_ = arr.mid(parsed);
+        startRequest();
+    }
+    else if (ret == TRI_INDETERMINATE)
+    {
+    }
+    else
+    {
+        httpError_ = HttpProxyReply::stock_reply(HttpProxyReply::service_unavailable);
+        connect(writeAllSocket_, SIGNAL(allDataWriteFinished()), SLOT(onSocketAllDataWritten()), Qt::UniqueConnection);
+        writeAllSocket_->write(httpError_.toBuffer());
+        writeAllSocket_->setEmitAllDataWritten();
+        state_ = STATE_WRITE_HTTP_ERROR;
+        qCDebug(LOG_HTTP_SERVER) << "Parse client request failed";
+    }
+}
 
+void HttpProxyConnection::onSocketBytesWritten()
+{
+    // the answer was read no further than the client can take
+    if (state_ == READ_HEADERS_FROM_WEBSERVER || state_ == READ_BODY_FROM_WEBSERVER)
+    {
+        readAnswer();
+    }
+}
+
+void HttpProxyConnection::onSocketAllDataWritten()
+{
+    //qCDebug(LOG_HTTP_SERVER) << "onSocketAllDataWritten connection closed.";
+    closeSocketsAndEmitFinished();
+}
+
+void HttpProxyConnection::startRequest()
+{
+    HttpProxyRequest &request = requestParser_.getRequest();
+    if (!request.extractHostAndPort())
+    {
+        //todo send error reply
+        qCDebug(LOG_HTTP_SERVER) << "extractHostAndPort from request failed";
+        closeSocketsAndEmitFinished();
+        return;
+    }
+
+    if (request.isConnectMethod())
+    {
+        // the rest is the start of the tunnel
+        extraContent_ = readData_;
+        readData_.clear();
+        connectExternalSocket();
+        return;
+    }
+
+    bClientKeepAlive_ = request.isKeepAlive();
+    bAnswerStarted_ = false;
+    const long contentLength = request.getContentLength();
+    if (request.isChunked())
+    {
+        requestBodyParser_.reset(HttpProxyBodyParser::CHUNKED);
+    }
+    else if (contentLength > 0)
+    {
+        requestBodyParser_.reset(HttpProxyBodyParser::CONTENT_LENGTH, contentLength);
+    }
+    else
+    {
+        requestBodyParser_.reset(HttpProxyBodyParser::NO_BODY);
+    }
+    bRequestBodyDone_ = (requestBodyParser_.framing() == HttpProxyBodyParser::NO_BODY);
+    webAnswerParser_ = HttpProxyWebAnswerParser();
+    webAnswerParser_.setHeadRequest(request.method == "HEAD");
+
+    upstreamKey_ = QString::fromStdString(request.host) + ":" + QString::number(request.port);
+    QTcpSocket *socket = upstreamPool_ ? upstreamPool_->take(upstreamKey_) : nullptr;
+    if (socket)
+    {
+        bUpstreamReused_ = true;
+        attachExternalSocket(socket);
+        sendRequest();
+    }
+    else
+    {
+        bUpstreamReused_ = false;
+        connectExternalSocket();
+    }
+}
+
+void HttpProxyConnection::connectExternalSocket()
+{
+    attachExternalSocket(new QTcpSocket(this));
+    state_ = CONNECTING_TO_EXTERNAL_SERVER;
+    socketExternal_->connectToHost(QString::fromStdString(requestParser_.getRequest().host), requestParser_.getRequest().port);
+}
+
+void HttpProxyConnection::attachExternalSocket(QTcpSocket *socket)
+{
+    socketExternal_ = socket;
+    socketExternal_->setParent(this);
+    socketExternal_->setReadBufferSize(SocketWriteAll::kMaxPendingBytes);
+
+    connect(socketExternal_, &QTcpSocket::connected, this, &HttpProxyConnection::onExternalSocketConnected);
+    connect(socketExternal_, &QTcpSocket::disconnected, this, &HttpProxyConnection::onExternalSocketDisconnected);
+    connect(socketExternal_, &QTcpSocket::readyRead, this, &HttpProxyConnection::onExternalSocketReadyRead);
+    connect(socketExternal_, &QTcpSocket::bytesWritten, this, &HttpProxyConnection::onExternalSocketBytesWritten);
+    connect(socketExternal_, &QTcpSocket::errorOccurred, this, &HttpProxyConnection::onExternalSocketError);
+
+    writeAllSocketExternal_ = new SocketWriteAll(this, socketExternal_);
+}
+
+void HttpProxyConnection::releaseExternalSocket(bool bReusable)
+{
+    socketExternal_->disconnect(this);
+    delete writeAllSocketExternal_;
+    writeAllSocketExternal_ = nullptr;
+
+    if (bReusable && upstreamPool_)
+    {
+        upstreamPool_->put(upstreamKey_, socketExternal_);
+    }
+    else
+    {
+        socketExternal_->abort();
+        socketExternal_->deleteLater();
+    }
+    socketExternal_ = nullptr;
+}
+
+void HttpProxyConnection::sendRequest()
+{
+    HttpProxyRequest &request = requestParser_.getRequest();
+    std::string s = request.getEstablishHttpConnectionMessage();
+    s += request.processClientHeaders();
+    writeAllSocketExternal_->write(QByteArray(s.c_str(), s.length()));
+
+    state_ = READ_HEADERS_FROM_WEBSERVER;
+    readRequestBody();
+}
+
+void HttpProxyConnection::readRequestBody()
+{
+    while (!bRequestBodyDone_ && socketExternal_->bytesToWrite() < SocketWriteAll::kMaxPendingBytes &&
+           (!readData_.isEmpty() || socket_->bytesAvailable() > 0))
+    {
+        QByteArray arr = readData_.isEmpty() ? socket_->read(SocketWriteAll::kMaxPendingBytes) : readData_;
+        readData_.clear();
+
+        quint32 parsed;
+        TRI_BOOL ret = requestBodyParser_.parse(arr, parsed);
+        if (ret == TRI_FALSE)
+        {
+            qCDebug(LOG_HTTP_SERVER) << "Parse the body of client request failed";
+            closeSocketsAndEmitFinished();
+            return;
+        }
+        writeAllSocketExternal_->write(arr.left(parsed));
         if (ret == TRI_TRUE)
         {
-            if ((arr.size() - parsed) > 0)
-            {
-                extraContent_ = QByteArray(arr.data() + parsed, arr.size() - parsed);
-            }
+            bRequestBodyDone_ = true;
+            readData_ = arr.mid(parsed);
+        }
+    }
+}
 
-            if (requestParser_.getRequest().extractHostAndPort())
-            {
-                socketExternal_ = new QTcpSocket(this);
+void HttpProxyConnection::readAnswer()
+{
+    while (socketExternal_ && socketExternal_->bytesAvailable() > 0 && socket_->bytesToWrite() < SocketWriteAll::kMaxPendingBytes)
+    {
+        bAnswerStarted_ = true;
+        if (!processAnswerData(socketExternal_->read(SocketWriteAll::kMaxPendingBytes - socket_->bytesToWrite())))
+        {
+            return;
+        }
+    }
+}
 
-                connect(socketExternal_, &QTcpSocket::connected, this, &HttpProxyConnection::onExternalSocketConnected);
-                connect(socketExternal_, &QTcpSocket::disconnected, this, &HttpProxyConnection::onExternalSocketDisconnected);
-                connect(socketExternal_, &QTcpSocket::readyRead, this, &HttpProxyConnection::onExternalSocketReadyRead);
-                connect(socketExternal_, &QTcpSocket::errorOccurred, this, &HttpProxyConnection::onExternalSocketError);
+bool HttpProxyConnection::processAnswerData(QByteArray arr)
+{
+    quint32 parsed;
+    TRI_BOOL ret;
 
-                writeAllSocketExternal_ = new SocketWriteAll(this, socketExternal_);
+    while (state_ == READ_HEADERS_FROM_WEBSERVER)
+    {
+        ret = webAnswerParser_.parse(arr, parsed);
+        if (ret == TRI_INDETERMINATE)
+        {
+            return true;
+        }
+        else if (ret == TRI_FALSE)
+        {
+            //todo send error reply
+            qCDebug(LOG_HTTP_SERVER) << "Parse webserver answer and headers failed";
+            closeSocketsAndEmitFinished();
+            return false;
+        }
+        arr.remove(0, parsed);
 
-                state_ = CONNECTING_TO_EXTERNAL_SERVER;
-                socketExternal_->connectToHost(QString::fromStdString(requestParser_.getRequest().host), requestParser_.getRequest().port);
-            }
-            else
-            {
-                //todo send error reply
-                qCDebug(LOG_HTTP_SERVER) << "extractHostAndPort from request failed";
-                closeSocketsAndEmitFinished();
-            }
+        // without the length of the body the end of the connection to the server is the end of the answer
+        const bool bInterimAnswer = webAnswerParser_.isInterimAnswer();
+        if (webAnswerParser_.getBodyFraming() == HttpProxyBodyParser::UNTIL_CLOSE)
+        {
+            bClientKeepAlive_ = false;
         }
-        else if (ret == TRI_INDETERMINATE)
+        std::string s = webAnswerParser_.getAnswer().processServerHeaders(requestParser_.getRequest().http_version_major,
+                                                                          requestParser_.getRequest().http_version_minor,
+                                                                          bClientKeepAlive_);
+        writeAllSocket_->write(QByteArray(s.c_str(), s.length()));
+
+        if (bInterimAnswer)
         {
+            // the final answer follows
+            webAnswerParser_ = HttpProxyWebAnswerParser();
+            webAnswerParser_.setHeadRequest(requestParser_.getRequest().method == "HEAD");
         }
         else
         {
-            httpError_ = HttpProxyReply::stock_reply(HttpProxyReply::service_unavailable);
-            connect(writeAllSocket_, SIGNAL(allDataWriteFinished()), SLOT(onSocketAllDataWritten()));
-            writeAllSocket_->write(httpError_.toBuffer());
-            writeAllSocket_->setEmitAllDataWritten();
-            state_ = STATE_WRITE_HTTP_ERROR;
-            qCDebug(LOG_HTTP_SERVER) << "Parse client request failed";
+            state_ = READ_BODY_FROM_WEBSERVER;
         }
     }
-    else if (state_ == CONNECTING_TO_EXTERNAL_SERVER)
+
+    ret = webAnswerParser_.parseBody(arr, parsed);
+    if (ret == TRI_FALSE)
     {
-        extraContent_.append(arr);
+        qCDebug(LOG_HTTP_SERVER) << "Parse the body of webserver answer failed";
+        closeSocketsAndEmitFinished();
+        return false;
     }
-    else if (state_ == RELAY_BETWEEN_CLIENT_SERVER  || state_ == READ_HEADERS_FROM_WEBSERVER)
+    if (parsed > 0)
     {
-        writeAllSocketExternal_->write(arr);
+        writeAllSocket_->write(arr.left(parsed));
+    }
+    if (ret == TRI_TRUE)
+    {
+        finishAnswer((int)parsed < arr.size());
+        return false;
+    }
+    return true;
+}
+
+void HttpProxyConnection::finishAnswer(bool bExtraData)
+{
+    // the server may take the next request if it sent nothing after the answer and got the whole request
+    const bool bReusable = !bExtraData && bRequestBodyDone_ && webAnswerParser_.isKeepAlive() &&
+                           socketExternal_->state() == QAbstractSocket::ConnectedState && socketExternal_->bytesToWrite() == 0;
+    releaseExternalSocket(bReusable);
+    if (!bRequestBodyDone_)
+    {
+        // answered before the end of the request body, the rest of it can't be told from the next request
+        bClientKeepAlive_ = false;
+    }
+
+    if (bClientKeepAlive_)
+    {
+        state_ = READ_CLIENT_REQUEST;
+        requestParser_ = HttpProxyRequestParser();
+        // the next request may be pipelined already
+        QMetaObject::invokeMethod(this, "onSocketReadyRead", Qt::QueuedConnection);
     }
     else
     {
-        WS_ASSERT(false);
+        closeAfterAllDataWritten();
     }
 }
 
-void HttpProxyConnection::onSocketAllDataWritten()
+void HttpProxyConnection::closeAfterAllDataWritten()
 {
-    //qCDebug(LOG_HTTP_SERVER) << "onSocketAllDataWritten connection closed.";
-    closeSocketsAndEmitFinished();
+    state_ = WRITE_LAST_ANSWER;
+    connect(writeAllSocket_, SIGNAL(allDataWriteFinished()), SLOT(onSocketAllDataWritten()), Qt::UniqueConnection);
+    writeAllSocket_->setEmitAllDataWritten();
 }
 
 void HttpProxyConnection::onExternalSocketConnected()
@@ -126,31 +377,18 @@ void HttpProxyConnection::onExternalSocketConnected()
                 extraContent_.clear();
             }
             state_ = RELAY_BETWEEN_CLIENT_SERVER;
-        }
-        else
-        {
-            std::string s = requestParser_.getRequest().getEstablishHttpConnectionMessage();
-            writeAllSocketExternal_->write(QByteArray(s.c_str(), s.length()));
-
-            s = requestParser_.getRequest().processClientHeaders();
-            writeAllSocketExternal_->write(QByteArray(s.c_str(), s.length()));
 
-            /*long contentLength = requestParser_.getRequest().getContentLength();
-            if (contentLength > 0)
+            if (spliceRelay_)
             {
-                WS_ASSERT(contentLength == extraContent_.size());
-                writeAllSocketExternal_->write(extraContent_);
+                // the tunnel is taken over by the splice relay as soon as the sockets have written everything
+                connect(socket_, &QTcpSocket::bytesWritten, this, &HttpProxyConnection::startSpliceRelay);
+                connect(socketExternal_, &QTcpSocket::bytesWritten, this, &HttpProxyConnection::startSpliceRelay);
             }
-            else
-            {*/
-                if (extraContent_.size() > 0)
-                {
-                    writeAllSocketExternal_->write(extraContent_);
-                    extraContent_.clear();
-                }
-            //}
-
-            state_ = READ_HEADERS_FROM_WEBSERVER;
+        }
+        else
+        {
+            // only the tunnels go through the splice relay
+            sendRequest();
         }
     }
     else
@@ -161,12 +399,42 @@ void HttpProxyConnection::onExternalSocketConnected()
 
 void HttpProxyConnection::onExternalSocketDisconnected()
 {
-    if (state_ != STATE_WRITE_HTTP_ERROR)
+    if (state_ == READ_HEADERS_FROM_WEBSERVER && bUpstreamReused_ && !bAnswerStarted_ &&
+        socketExternal_->bytesAvailable() == 0 && requestBodyParser_.framing() == HttpProxyBodyParser::NO_BODY &&
+        requestParser_.getRequest().isSafeMethod())
+    {
+        // the server closed the idle connection as the request was sent, it is sent again on a new connection;
+        // only for the safe methods, the server may have processed the others before closing
+        releaseExternalSocket(false);
+        bUpstreamReused_ = false;
+        connectExternalSocket();
+        return;
+    }
+    else if (state_ == READ_HEADERS_FROM_WEBSERVER || state_ == READ_BODY_FROM_WEBSERVER)
+    {
+        // the rest of the answer, the client connection ends with it unless the answer is complete
+        while (socketExternal_ && socketExternal_->bytesAvailable() > 0)
+        {
+            if (!processAnswerData(socketExternal_->readAll()))
+            {
+                return;
+            }
+        }
+        closeAfterAllDataWritten();
+        return;
+    }
+
+    if (state_ != STATE_WRITE_HTTP_ERROR && state_ != WRITE_LAST_ANSWER)
     {
         // wait while all data will be write to client socket
         if (writeAllSocket_)
         {
-            connect(writeAllSocket_, SIGNAL(allDataWriteFinished()), SLOT(onSocketAllDataWritten()));
+            if (state_ == RELAY_BETWEEN_CLIENT_SERVER)
+            {
+                // also the data which waited for the splice relay
+                writeAllSocket_->relayFrom(socketExternal_);
+            }
+            connect(writeAllSocket_, SIGNAL(allDataWriteFinished()), SLOT(onSocketAllDataWritten()), Qt::UniqueConnection);
             writeAllSocket_->setEmitAllDataWritten();
         }
         else
@@ -178,61 +446,82 @@ void HttpProxyConnection::onExternalSocketDisconnected()
 
 void HttpProxyConnection::onExternalSocketReadyRead()
 {
-    QByteArray arr = socketExternal_->readAll();
     if (state_ == RELAY_BETWEEN_CLIENT_SERVER)
     {
-        writeAllSocket_->write(arr);
-    }
-    else if (state_ == READ_HEADERS_FROM_WEBSERVER)
-    {
-        quint32 parsed;
-        TRI_BOOL ret;
-        ret = webAnswerParser_.parse(arr, parsed);
-
-        if (ret == TRI_TRUE)
+        if (!spliceRelay_)
         {
-            std::string s = webAnswerParser_.getAnswer().processServerHeaders(requestParser_.getRequest().http_version_major,
-                                                                              requestParser_.getRequest().http_version_minor);
-            writeAllSocket_->write(QByteArray(s.c_str(), s.length()));
-
-            quint32 remainingData = arr.size() - parsed;
-            if (remainingData > 0)
-            {
-                writeAllSocket_->write(QByteArray(arr.data() + parsed, remainingData));
-            }
-            state_ = RELAY_BETWEEN_CLIENT_SERVER;
-        }
-        else if (ret == TRI_FALSE)
-        {
-            //todo send error reply
-            qCDebug(LOG_HTTP_SERVER) << "Parse webserver answer and headers failed";
-            closeSocketsAndEmitFinished();
+            writeAllSocket_->relayFrom(socketExternal_);
         }
     }
+    else if (state_ == READ_HEADERS_FROM_WEBSERVER || state_ == READ_BODY_FROM_WEBSERVER)
+    {
+        readAnswer();
+    }
     else
     {
         WS_ASSERT(false);
     }
 }
 
+void HttpProxyConnection::onExternalSocketBytesWritten()
+{
+    if (state_ == READ_HEADERS_FROM_WEBSERVER || state_ == READ_BODY_FROM_WEBSERVER)
+    {
+        readRequestBody();
+    }
+}
+
 void HttpProxyConnection::onExternalSocketError(QAbstractSocket::SocketError socketError)
 {
     Q_UNUSED(socketError);
     if (state_ == CONNECTING_TO_EXTERNAL_SERVER)
     {
         httpError_ = HttpProxyReply::stock_reply(HttpProxyReply::internal_server_error);
-        connect(writeAllSocket_, SIGNAL(allDataWriteFinished()), SLOT(onSocketAllDataWritten()));
+        connect(writeAllSocket_, SIGNAL(allDataWriteFinished()), SLOT(onSocketAllDataWritten()), Qt::UniqueConnection);
         writeAllSocket_->write(httpError_.toBuffer());
         writeAllSocket_->setEmitAllDataWritten();
         state_ = STATE_WRITE_HTTP_ERROR;
     }
 }
 
+void HttpProxyConnection::startSpliceRelay()
+{
+#ifdef Q_OS_LINUX
+    if (spliceRelay_ && spliceRelayId_ == 0 && !bAlreadyClosedAndEmitFinished_)
+    {
+        // connected beforehand, the relay may finish right away
+        connect(spliceRelay_, &SpliceRelay::relayFinished, this, &HttpProxyConnection::onSpliceRelayFinished, Qt::UniqueConnection);
+        spliceRelayId_ = spliceRelay_->takeOver(socket_, socketExternal_);
+        if (spliceRelayId_ == 0 && socket_->bytesToWrite() == 0 && socketExternal_->bytesToWrite() == 0)
+        {
+            // can't be taken over, relay through the Qt sockets
+            spliceRelay_ = nullptr;
+            writeAllSocketExternal_->relayFrom(socket_);
+            writeAllSocket_->relayFrom(socketExternal_);
+        }
+    }
+#endif
+}
+
+void HttpProxyConnection::onSpliceRelayFinished(quint64 relayId)
+{
+    if (relayId == spliceRelayId_)
+    {
+        closeSocketsAndEmitFinished();
+    }
+}
+
 void HttpProxyConnection::closeSocketsAndEmitFinished()
 {
     if (!bAlreadyClosedAndEmitFinished_)
     {
         bAlreadyClosedAndEmitFinished_ = true;
+#ifdef Q_OS_LINUX
+        if (spliceRelayId_ != 0)
+        {
+            spliceRelay_->remove(spliceRelayId_);
+        }
+#endif
         if (socket_)
         {
             socket_->close();
@@ -6,17 +6,31 @@
 #include "httpproxyrequestparser.h"
 #include "httpproxywebanswerparser.h"
 #include "httpproxyreply.h"
+#include "httpproxybodyparser.h"
 #include "../socketutils/socketwriteall.h"
 
+class SpliceRelay;
+
 namespace HttpProxyServer {
 
+class HttpProxyUpstreamPool;
+
+// A client connection of the HTTP proxy. A CONNECT request makes a tunnel until the end of the connection. The plain
+// HTTP requests are answered one after another while both sides keep the connection alive: the pipelined requests wait
+// in the socket for the answer to the previous one, and the connections to the servers go back to the upstream pool
+// of the thread after an answer with a known length.
 class HttpProxyConnection : public QObject
 {
     Q_OBJECT
 public:
-    explicit HttpProxyConnection(qintptr socketDescriptor, const QString &hostname, QObject *parent = nullptr);
+    // spliceRelay may be null, then the data is relayed through the Qt sockets; upstreamPool may be null, then the
+    // connections to the servers are closed after each answer
+    explicit HttpProxyConnection(qintptr socketDescriptor, const QString &hostname, SpliceRelay *spliceRelay,
+                                 HttpProxyUpstreamPool *upstreamPool, QObject *parent = nullptr);
 
     bool start(qintptr socketDescriptor);
+    // the start of the request, already read from the socket by the ProxyCore
+    void setReadData(const QByteArray &readData);
 
 public slots:
     void start();
@@ -28,14 +42,19 @@ signals:
 private slots:
     void onSocketDisconnected();
     void onSocketReadyRead();
+    void onSocketBytesWritten();
 
     void onSocketAllDataWritten();
 
     void onExternalSocketConnected();
     void onExternalSocketDisconnected();
     void onExternalSocketReadyRead();
+    void onExternalSocketBytesWritten();
     void onExternalSocketError(QAbstractSocket::SocketError socketError);
 
+    void startSpliceRelay();
+    void onSpliceRelayFinished(quint64 relayId);
+
 private:
     QTcpSocket *socket_;
     QTcpSocket *socketExternal_;
@@ -44,18 +63,42 @@ private:
 
     const char *reply_established_ = "HTTP/1.0 200 Connection established\r\nProxy-agent: Windscribe\r\n\r\n";
 
-    enum { READ_CLIENT_REQUEST, CONNECTING_TO_EXTERNAL_SERVER, RELAY_BETWEEN_CLIENT_SERVER, READ_HEADERS_FROM_WEBSERVER, STATE_WRITE_HTTP_ERROR } state_;
+    enum { READ_CLIENT_REQUEST, CONNECTING_TO_EXTERNAL_SERVER, RELAY_BETWEEN_CLIENT_SERVER, READ_HEADERS_FROM_WEBSERVER,
+           READ_BODY_FROM_WEBSERVER, WRITE_LAST_ANSWER, STATE_WRITE_HTTP_ERROR } state_;
     HttpProxyRequestParser requestParser_;
     HttpProxyWebAnswerParser webAnswerParser_;
+    HttpProxyBodyParser requestBodyParser_;
+    bool bRequestBodyDone_;
+    bool bClientKeepAlive_;
+    bool bAnswerStarted_;
 
 
     SocketWriteAll *writeAllSocket_;
     SocketWriteAll *writeAllSocketExternal_;
 
     QByteArray extraContent_;
+    QByteArray readData_;           // read from the client but not parsed yet
     HttpProxyReply httpError_;
 
+    SpliceRelay *spliceRelay_;
+    quint64 spliceRelayId_;
+
+    HttpProxyUpstreamPool *upstreamPool_;
+    QString upstreamKey_;
+    bool bUpstreamReused_;
+
     bool bAlreadyClosedAndEmitFinished_;
+
+    void startRequest();
+    void connectExternalSocket();
+    void attachExternalSocket(QTcpSocket *socket);
+    void releaseExternalSocket(bool bReusable);
+    void sendRequest();
+    void readRequestBody();
+    void readAnswer();
+    bool processAnswerData(QByteArray arr);
+    void finishAnswer(bool bExtraData);
+    void closeAfterAllDataWritten();
     void closeSocketsAndEmitFinished();
 };
 
@@ -4,21 +4,38 @@
 #include <QTimer>
 #include "utils/ws_assert.h"
 
+#ifdef Q_OS_LINUX
+    #include "../socketutils/splicerelay.h"
+#endif
+
 namespace HttpProxyServer {
 
 HttpProxyConnectionManager::HttpProxyConnectionManager(QObject *parent, int threadsCount, ConnectedUsersCounter *usersCounter) : QObject(parent),
-    usersCounter_(usersCounter)
+    bUpstreamPoolEnabled_(true), usersCounter_(usersCounter), spliceRelay_(nullptr)
 {
+#ifdef Q_OS_LINUX
+    spliceRelay_ = new SpliceRelay(this);
+#endif
     WS_ASSERT(threadsCount > 0);
     for (int i = 0; i < threadsCount; i++)
     {
         QThread *thread = new QThread(this);
         threads_[thread] = 0;
+        // the sockets of a pool are used in the thread of its connections only
+        HttpProxyUpstreamPool *upstreamPool = new HttpProxyUpstreamPool();
+        upstreamPool->moveToThread(thread);
+        upstreamPools_[thread] = upstreamPool;
         thread->start(QThread::LowPriority);
     }
 }
 
-void HttpProxyConnectionManager::newConnection(qintptr socketDescriptor)
+HttpProxyConnectionManager::~HttpProxyConnectionManager()
+{
+    // the threads are stopped already
+    qDeleteAll(upstreamPools_);
+}
+
+void HttpProxyConnectionManager::newConnection(qintptr socketDescriptor, const QByteArray &readData)
 {
 #ifdef Q_OS_WIN
     SOCKADDR_IN  addr = {0};
@@ -31,7 +48,9 @@ void HttpProxyConnectionManager::newConnection(qintptr socketDescriptor)
     char *ip = inet_ntoa(addr.sin_addr);
     usersCounter_->newUserConnected(ip);
     QThread *thread = getLessBusyThread();
-    HttpProxyConnection *connection = new HttpProxyConnection(socketDescriptor, ip);
+    HttpProxyConnection *connection = new HttpProxyConnection(socketDescriptor, ip, spliceRelay_,
+                                                              bUpstreamPoolEnabled_ ? upstreamPools_[thread] : nullptr);
+    connection->setReadData(readData);
     connect(connection, SIGNAL(finished(QString)), SLOT(onConnectionFinished(QString)));
     addConnectionToThread(thread, connection);
 
@@ -44,10 +63,21 @@ void HttpProxyConnectionManager::closeAllConnections()
      {
          QMetaObject::invokeMethod(c, "forceClose", Qt::QueuedConnection);
      }
+     for (auto pool : upstreamPools_)
+     {
+         QMetaObject::invokeMethod(pool, "clear", Qt::QueuedConnection);
+     }
 }
 
 void HttpProxyConnectionManager::stop()
 {
+    for (auto it = upstreamPools_.begin(); it != upstreamPools_.end(); ++it)
+    {
+        if (it.key()->isRunning())
+        {
+            QMetaObject::invokeMethod(it.value(), "clear", Qt::BlockingQueuedConnection);
+        }
+    }
     for(auto thread : threads_.keys())
     {
         thread->exit();
@@ -58,6 +88,11 @@ void HttpProxyConnectionManager::stop()
     }
 }
 
+void HttpProxyConnectionManager::setUpstreamPoolEnabled(bool bEnabled)
+{
+    bUpstreamPoolEnabled_ = bEnabled;
+}
+
 void HttpProxyConnectionManager::onConnectionFinished(const QString &hostname)
 {
     HttpProxyConnection *connection = static_cast<HttpProxyConnection *>(sender());
@@ -4,6 +4,7 @@
 #include <QObject>
 #include <QMap>
 #include "httpproxyconnection.h"
+#include "httpproxyupstreampool.h"
 #include "../connecteduserscounter.h"
 
 namespace HttpProxyServer {
@@ -13,11 +14,15 @@ class HttpProxyConnectionManager : public QObject
     Q_OBJECT
 public:
     explicit HttpProxyConnectionManager(QObject *parent, int threadsCount, ConnectedUsersCounter *usersCounter);
+    virtual ~HttpProxyConnectionManager();
 
 public:
-    void newConnection(qintptr socketDescriptor);
+    // readData is the data already read from the socket
+    void newConnection(qintptr socketDescriptor, const QByteArray &readData = QByteArray());
     void closeAllConnections();
     void stop();
+    // on by default, off for the benchmarks
+    void setUpstreamPoolEnabled(bool bEnabled);
 
 private slots:
     void onConnectionFinished(const QString &hostname);
@@ -25,7 +30,10 @@ private slots:
 private:
     QMap<QThread *, quint32> threads_;
     QMap<HttpProxyConnection *, QThread *> connections_;
+    QMap<QThread *, HttpProxyUpstreamPool *> upstreamPools_;
+    bool bUpstreamPoolEnabled_;
     ConnectedUsersCounter *usersCounter_;
+    SpliceRelay *spliceRelay_;      // null if not supported
 
     QThread *getLessBusyThread();
     void addConnectionToThread(QThread *thread, HttpProxyConnection *connection);
@@ -0,0 +1,26 @@
+#include "httpproxyheader.h"
+#include "utils/boost_includes.h"
+
+namespace HttpProxyServer {
+
+bool hasHeaderToken(const QVector<HttpProxyHeader> &headers, const char *name, const char *token)
+{
+    for (auto it = headers.begin(); it != headers.end(); ++it)
+    {
+        if (boost::iequals(it->name, name))
+        {
+            std::vector<std::string> tokens;
+            boost::split(tokens, it->value, boost::is_any_of(","));
+            for (const std::string &t : tokens)
+            {
+                if (boost::iequals(boost::trim_copy(t), token))
+                {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+} // namespace HttpProxyServer
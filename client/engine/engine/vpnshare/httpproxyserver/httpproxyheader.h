@@ -2,6 +2,7 @@
 #define HTTPPROXYHEADER_H
 
 #include <string>
+#include <QVector>
 
 namespace HttpProxyServer {
 
@@ -11,6 +12,9 @@ struct HttpProxyHeader
   std::string value;
 };
 
+// true if one of the headers with this name lists the token, as "Connection: keep-alive, Upgrade"
+bool hasHeaderToken(const QVector<HttpProxyHeader> &headers, const char *name, const char *token);
+
 } // namespace HttpProxyServer
 
 #endif // HTTPPROXYHEADER_H
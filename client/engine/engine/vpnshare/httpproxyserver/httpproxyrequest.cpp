@@ -93,6 +93,11 @@ bool HttpProxyRequest::isConnectMethod() const
     return strcmp (method.c_str(), "CONNECT") == 0;
 }
 
+bool HttpProxyRequest::isSafeMethod() const
+{
+    return method == "GET" || method == "HEAD" || method == "OPTIONS";
+}
+
 std::string HttpProxyRequest::getEstablishHttpConnectionMessage()
 {
     std::string msg;
@@ -113,33 +118,19 @@ std::string HttpProxyRequest::getEstablishHttpConnectionMessage()
         portbuff[0] = '\0';
     }
 
+    // the connection to the server stays open for the next requests, the 1.1 clients get the 1.1 framing back
+    const char *version = (http_version_major > 1 || (http_version_major == 1 && http_version_minor >= 1)) ? " HTTP/1.1\r\n" : " HTTP/1.0\r\n";
+    msg = method + " " + path + version;
     if (inet_pton(AF_INET6, host.c_str(), dst) > 0)
     {
         // host is an IPv6 address literal, so surround it with []
-        msg = method + " " + path + " HTTP/1.0\r\n";
         msg += "Host: [" + host + "]" + portbuff + "\r\n";
-        msg += "Connection: close\r\n";
-
-        /*return write_message (connptr->server_fd,
-                                          "%s %s HTTP/1.0\r\n"
-                                          "Host: [%s]%s\r\n"
-                                          "Connection: close\r\n",
-                                          request->method, request->path,
-                                          request->host, portbuff);*/
     }
     else
     {
-        msg = method + " " + path + " HTTP/1.0\r\n";
         msg += "Host: " + host + portbuff + "\r\n";
-        msg += "Connection: close\r\n";
-
-        /*return write_message (connptr->server_fd,
-                                          "%s %s HTTP/1.0\r\n"
-                                          "Host: %s%s\r\n"
-                                          "Connection: close\r\n",
-                                          request->method, request->path,
-                                          request->host, portbuff);*/
     }
+    msg += "Connection: keep-alive\r\n";
     return msg;
 }
 
@@ -156,6 +147,24 @@ long HttpProxyRequest::getContentLength()
     return -1;
 }
 
+bool HttpProxyRequest::isChunked() const
+{
+    return hasHeaderToken(headers, "transfer-encoding", "chunked");
+}
+
+bool HttpProxyRequest::isKeepAlive() const
+{
+    if (hasHeaderToken(headers, "connection", "close") || hasHeaderToken(headers, "proxy-connection", "close"))
+    {
+        return false;
+    }
+    if (http_version_major > 1 || (http_version_major == 1 && http_version_minor >= 1))
+    {
+        return true;
+    }
+    return hasHeaderToken(headers, "connection", "keep-alive") || hasHeaderToken(headers, "proxy-connection", "keep-alive");
+}
+
 std::string HttpProxyRequest::processClientHeaders()
 {
     std::string ret;
@@ -179,7 +188,7 @@ std::string HttpProxyRequest::processClientHeaders()
             }
             else
             {
-                ret += it->name + " :" + it->value + "\r\n";
+                ret += it->name + ": " + it->value + "\r\n";
             }
         }
     }
@@ -27,8 +27,13 @@ public:
     bool extractHostAndPort();
 
     bool isConnectMethod() const;
+    // GET, HEAD and OPTIONS, the request can be sent again if its answer did not come
+    bool isSafeMethod() const;
     std::string getEstablishHttpConnectionMessage();
     long getContentLength();
+    bool isChunked() const;
+    // the client keeps the connection open for the next request
+    bool isKeepAlive() const;
     std::string processClientHeaders();
 
 private:
@@ -2,6 +2,10 @@
 #include "utils/ws_assert.h"
 #include "utils/logger.h"
 
+#ifdef Q_OS_LINUX
+    #include "../proxycore/proxycore.h"
+#endif
+
 namespace HttpProxyServer {
 
 HttpProxyServer::HttpProxyServer(QObject *parent) : QTcpServer(parent)
@@ -9,6 +13,12 @@ HttpProxyServer::HttpProxyServer(QObject *parent) : QTcpServer(parent)
     usersCounter_ = new ConnectedUsersCounter(this);
     connect(usersCounter_, SIGNAL(usersCountChanged()), SIGNAL(usersCountChanged()));
     connectionManager_ = new HttpProxyConnectionManager(this, 4, usersCounter_);
+#ifdef Q_OS_LINUX
+    proxyCore_ = new ProxyCore(this, ProxyReactor::HTTP, usersCounter_);
+    connect(proxyCore_, &ProxyCore::connectionHandedOff, this, [this](qintptr socketDescriptor, const QByteArray &readData) {
+        connectionManager_->newConnection(socketDescriptor, readData);
+    });
+#endif
 }
 
 HttpProxyServer::~HttpProxyServer()
@@ -20,9 +30,14 @@ bool HttpProxyServer::startServer(quint16 port)
 {
     WS_ASSERT(!isListening());
 
-    if (listen(QHostAddress::AnyIPv4, port))
+#ifdef Q_OS_LINUX
+    const bool bStarted = proxyCore_->start(port);
+#else
+    const bool bStarted = listen(QHostAddress::AnyIPv4, port);
+#endif
+    if (bStarted)
     {
-        qCDebug(LOG_HTTP_SERVER) << "Http proxy server started on port" << serverPort();
+        qCDebug(LOG_HTTP_SERVER) << "Http proxy server started on port" << this->port();
         return true;
     }
     else
@@ -34,6 +49,13 @@ bool HttpProxyServer::startServer(quint16 port)
 
 void HttpProxyServer::stopServer()
 {
+#ifdef Q_OS_LINUX
+    if (proxyCore_->isStarted())
+    {
+        qCDebug(LOG_HTTP_SERVER) << "Http proxy server stopped on port" << proxyCore_->port();
+        proxyCore_->stop();
+    }
+#endif
     if (isListening())
     {
         qCDebug(LOG_HTTP_SERVER) << "Http proxy server stopped on port" << serverPort();
@@ -43,6 +65,15 @@ void HttpProxyServer::stopServer()
     usersCounter_->reset();
 }
 
+quint16 HttpProxyServer::port() const
+{
+#ifdef Q_OS_LINUX
+    return proxyCore_->port();
+#else
+    return serverPort();
+#endif
+}
+
 int HttpProxyServer::getConnectedUsersCount()
 {
     return usersCounter_->getConnectedUsersCount();
@@ -50,6 +81,9 @@ int HttpProxyServer::getConnectedUsersCount()
 
 void HttpProxyServer::closeActiveConnections()
 {
+#ifdef Q_OS_LINUX
+    proxyCore_->closeAllConnections();
+#endif
     connectionManager_->closeAllConnections();
 }
 
@@ -6,6 +6,8 @@
 
 #include <QTcpServer>
 
+class ProxyCore;
+
 namespace HttpProxyServer {
 
 class HttpProxyServer : public QTcpServer
@@ -17,6 +19,7 @@ public:
 
     bool startServer(quint16 port);
     void stopServer();
+    quint16 port() const;
 
     int getConnectedUsersCount();
 
@@ -31,6 +34,9 @@ protected:
 private:
     HttpProxyConnectionManager *connectionManager_;
     ConnectedUsersCounter *usersCounter_;
+#ifdef Q_OS_LINUX
+    ProxyCore *proxyCore_;      // elsewhere the server listens itself
+#endif
 };
 
 
@@ -0,0 +1,110 @@
+#include "httpproxyupstreampool.h"
+
+namespace HttpProxyServer {
+
+HttpProxyUpstreamPool::HttpProxyUpstreamPool(QObject *parent) : QObject(parent)
+{
+    clock_.start();
+    evictTimer_ = new QTimer(this);
+    evictTimer_->setInterval(kIdleTimeoutMs / 3);
+    connect(evictTimer_, &QTimer::timeout, this, &HttpProxyUpstreamPool::onEvictTimer);
+}
+
+HttpProxyUpstreamPool::~HttpProxyUpstreamPool()
+{
+    clear();
+}
+
+QTcpSocket *HttpProxyUpstreamPool::take(const QString &key)
+{
+    for (int i = idle_.count() - 1; i >= 0; --i)
+    {
+        if (idle_[i].key == key)
+        {
+            QTcpSocket *socket = idle_[i].socket;
+            idle_.removeAt(i);
+            socket->disconnect(this);
+            socket->setParent(nullptr);
+            return socket;
+        }
+    }
+    return nullptr;
+}
+
+void HttpProxyUpstreamPool::put(const QString &key, QTcpSocket *socket)
+{
+    socket->setParent(this);
+    // the server must not send anything between the requests
+    if (socket->state() != QAbstractSocket::ConnectedState || socket->bytesAvailable() > 0)
+    {
+        socket->abort();
+        socket->deleteLater();
+        return;
+    }
+    connect(socket, &QTcpSocket::disconnected, this, &HttpProxyUpstreamPool::onIdleSocketClosed);
+    connect(socket, &QTcpSocket::readyRead, this, &HttpProxyUpstreamPool::onIdleSocketClosed);
+    connect(socket, &QTcpSocket::errorOccurred, this, &HttpProxyUpstreamPool::onIdleSocketClosed);
+    idle_ << IdleSocket{ key, socket, clock_.elapsed() };
+
+    int hostCount = 0;
+    for (int i = idle_.count() - 1; i >= 0; --i)
+    {
+        if (idle_[i].key == key && ++hostCount > kMaxIdlePerHost)
+        {
+            drop(i);
+        }
+    }
+    while (idle_.count() > kMaxIdle)
+    {
+        drop(0);
+    }
+    if (!evictTimer_->isActive())
+    {
+        evictTimer_->start();
+    }
+}
+
+void HttpProxyUpstreamPool::clear()
+{
+    while (!idle_.isEmpty())
+    {
+        drop(0);
+    }
+    evictTimer_->stop();
+}
+
+void HttpProxyUpstreamPool::onIdleSocketClosed()
+{
+    for (int i = 0; i < idle_.count(); ++i)
+    {
+        if (idle_[i].socket == sender())
+        {
+            drop(i);
+            break;
+        }
+    }
+}
+
+void HttpProxyUpstreamPool::onEvictTimer()
+{
+    const qint64 now = clock_.elapsed();
+    while (!idle_.isEmpty() && now - idle_.first().idleSinceMs >= kIdleTimeoutMs)
+    {
+        drop(0);
+    }
+    if (idle_.isEmpty())
+    {
+        evictTimer_->stop();
+    }
+}
+
+void HttpProxyUpstreamPool::drop(int ind)
+{
+    QTcpSocket *socket = idle_[ind].socket;
+    idle_.removeAt(ind);
+    socket->disconnect(this);
+    socket->abort();
+    socket->deleteLater();
+}
+
+} // namespace HttpProxyServer
@@ -0,0 +1,55 @@
+#ifndef HTTPPROXYUPSTREAMPOOL_H
+#define HTTPPROXYUPSTREAMPOOL_H
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QTcpSocket>
+#include <QTimer>
+
+namespace HttpProxyServer {
+
+// The idle keep-alive connections to the web servers, by "host:port", for the plain HTTP requests of the connections
+// of one thread: the sockets can only be used in the thread which created them. An idle socket is dropped when the
+// server closes it, when it stays idle for kIdleTimeoutMs, and the oldest ones over the limits.
+class HttpProxyUpstreamPool : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr int kIdleTimeoutMs = 15000;
+    static constexpr int kMaxIdlePerHost = 6;
+    static constexpr int kMaxIdle = 64;
+
+    explicit HttpProxyUpstreamPool(QObject *parent = nullptr);
+    virtual ~HttpProxyUpstreamPool();
+
+    // the most recently used socket to the host, or null; the caller takes ownership
+    QTcpSocket *take(const QString &key);
+    // the socket must be between two requests, with the answer read entirely
+    void put(const QString &key, QTcpSocket *socket);
+    int idleCount() const { return idle_.count(); }
+
+public slots:
+    void clear();
+
+private slots:
+    void onIdleSocketClosed();
+    void onEvictTimer();
+
+private:
+    struct IdleSocket
+    {
+        QString key;
+        QTcpSocket *socket;
+        qint64 idleSinceMs;
+    };
+    QList<IdleSocket> idle_;        // the oldest first
+    QElapsedTimer clock_;
+    QTimer *evictTimer_;
+
+    void drop(int ind);
+};
+
+} // namespace HttpProxyServer
+
+#endif // HTTPPROXYUPSTREAMPOOL_H
@@ -18,7 +18,32 @@ long HttpProxyWebAnswer::getContentLength()
     return -1;
 }
 
-std::string HttpProxyWebAnswer::processServerHeaders(unsigned int major, unsigned int minor)
+int HttpProxyWebAnswer::getStatusCode() const
+{
+    // "HTTP/1.1 200 OK"
+    const size_t pos = answer.find(' ');
+    return (pos != std::string::npos) ? atoi(answer.c_str() + pos + 1) : 0;
+}
+
+bool HttpProxyWebAnswer::isChunked() const
+{
+    return hasHeaderToken(headers, "transfer-encoding", "chunked");
+}
+
+bool HttpProxyWebAnswer::isKeepAlive() const
+{
+    if (hasHeaderToken(headers, "connection", "close"))
+    {
+        return false;
+    }
+    if (answer.compare(0, 9, "HTTP/1.0 ") == 0)
+    {
+        return hasHeaderToken(headers, "connection", "keep-alive");
+    }
+    return true;
+}
+
+std::string HttpProxyWebAnswer::processServerHeaders(unsigned int major, unsigned int minor, bool bKeepAlive)
 {
     std::string ret;
     //todo: check buffer bounds
@@ -44,7 +69,7 @@ std::string HttpProxyWebAnswer::processServerHeaders(unsigned int major, unsigne
             }
             else
             {
-                ret += it->name + " :" + it->value + "\r\n";
+                ret += it->name + ": " + it->value + "\r\n";
             }
         }
     }
@@ -58,6 +83,7 @@ std::string HttpProxyWebAnswer::processServerHeaders(unsigned int major, unsigne
         ret += buf;
     }
 
+    ret += bKeepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
     ret += "\r\n";
 
     return ret;
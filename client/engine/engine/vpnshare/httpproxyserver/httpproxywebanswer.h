@@ -15,7 +15,12 @@ struct HttpProxyWebAnswer
   QVector<HttpProxyHeader> headers;
 
   long getContentLength();
-  std::string processServerHeaders(unsigned int major, unsigned int minor);
+  int getStatusCode() const;
+  bool isChunked() const;
+  // the server keeps the connection open for the next request
+  bool isKeepAlive() const;
+  // bKeepAlive tells the client whether the connection stays open after this answer
+  std::string processServerHeaders(unsigned int major, unsigned int minor, bool bKeepAlive);
 
 private:
   bool shouldSkipHeader(const std::string &headerName);
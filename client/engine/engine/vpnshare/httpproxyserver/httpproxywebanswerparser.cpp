@@ -2,7 +2,7 @@
 
 namespace HttpProxyServer {
 
-HttpProxyWebAnswerParser::HttpProxyWebAnswerParser() : state_(method_start)
+HttpProxyWebAnswerParser::HttpProxyWebAnswerParser() : bHeadRequest_(false), state_(method_start)
 {
 
 }
@@ -15,6 +15,10 @@ TRI_BOOL HttpProxyWebAnswerParser::parse(const QByteArray &arr, quint32 &outPars
         TRI_BOOL res = consume(data[i]);
         if (res == TRI_TRUE || res == TRI_FALSE)
         {
+            if (res == TRI_TRUE)
+            {
+                startBody();
+            }
             outParsed = i + 1;
             return res;
         }
@@ -24,6 +28,49 @@ TRI_BOOL HttpProxyWebAnswerParser::parse(const QByteArray &arr, quint32 &outPars
     return TRI_INDETERMINATE;
 }
 
+TRI_BOOL HttpProxyWebAnswerParser::parseBody(const QByteArray &arr, quint32 &outParsed)
+{
+    return bodyParser_.parse(arr, outParsed);
+}
+
+bool HttpProxyWebAnswerParser::isInterimAnswer()
+{
+    const int status = answer_.getStatusCode();
+    return status >= 100 && status < 200 && status != 101;
+}
+
+bool HttpProxyWebAnswerParser::isKeepAlive() const
+{
+    return bodyParser_.framing() != HttpProxyBodyParser::UNTIL_CLOSE && answer_.isKeepAlive();
+}
+
+void HttpProxyWebAnswerParser::startBody()
+{
+    const int status = answer_.getStatusCode();
+    const long contentLength = answer_.getContentLength();
+    if (bHeadRequest_ || isInterimAnswer() || status == 204 || status == 304)
+    {
+        bodyParser_.reset(HttpProxyBodyParser::NO_BODY);
+    }
+    else if (status == 101)
+    {
+        // switched to another protocol, which ends with the connection
+        bodyParser_.reset(HttpProxyBodyParser::UNTIL_CLOSE);
+    }
+    else if (answer_.isChunked())
+    {
+        bodyParser_.reset(HttpProxyBodyParser::CHUNKED);
+    }
+    else if (contentLength >= 0)
+    {
+        bodyParser_.reset(HttpProxyBodyParser::CONTENT_LENGTH, contentLength);
+    }
+    else
+    {
+        bodyParser_.reset(HttpProxyBodyParser::UNTIL_CLOSE);
+    }
+}
+
 TRI_BOOL HttpProxyWebAnswerParser::consume(char input)
 {
     switch (state_)
@@ -3,6 +3,7 @@
 
 #include "utils/boost_includes.h"
 #include "httpproxywebanswer.h"
+#include "httpproxybodyparser.h"
 #include "httpproxyrequestparser.h"
 
 namespace HttpProxyServer {
@@ -12,12 +13,27 @@ class HttpProxyWebAnswerParser
 public:
     HttpProxyWebAnswerParser();
 
+    // the answer to a HEAD request has no body whatever its headers say
+    void setHeadRequest(bool bHeadRequest) { bHeadRequest_ = bHeadRequest; }
+
+    // parses the status line and the headers
     TRI_BOOL parse(const QByteArray &arr, quint32 &outParsed);
+    // after the headers, TRI_TRUE at the end of the body
+    TRI_BOOL parseBody(const QByteArray &arr, quint32 &outParsed);
 
     HttpProxyWebAnswer &getAnswer() { return answer_; }
+    HttpProxyBodyParser::FRAMING getBodyFraming() const { return bodyParser_.framing(); }
+    // an interim answer (100 Continue) is followed by another answer to the same request
+    bool isInterimAnswer();
+    // the connection to the server can take the next request after this answer
+    bool isKeepAlive() const;
 
 private:
     HttpProxyWebAnswer answer_;
+    HttpProxyBodyParser bodyParser_;
+    bool bHeadRequest_;
+
+    void startBody();
 
     TRI_BOOL consume(char input);
 
@@ -0,0 +1,213 @@
+#include "proxycore.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include <QThread>
+
+#include "../connecteduserscounter.h"
+#include "../socketutils/splicerelay.h"
+#include "engine/networkaccessmanager/dnscache.h"
+#include "utils/logger.h"
+
+ProxyCore::ProxyCore(QObject *parent, ProxyReactor::PROTOCOL protocol, ConnectedUsersCounter *usersCounter) : QObject(parent),
+    protocol_(protocol),
+    usersCounter_(usersCounter),
+    spliceRelay_(nullptr),
+    port_(0),
+    nextDnsRequestId_(1)
+{
+    dnsCache_ = new DnsCache(this);
+    connect(dnsCache_, &DnsCache::resolved, this, &ProxyCore::onDnsCacheResolved);
+}
+
+ProxyCore::~ProxyCore()
+{
+    stop();
+}
+
+bool ProxyCore::start(quint16 port, int reactorsCount)
+{
+    if (isStarted())
+    {
+        return false;
+    }
+    if (reactorsCount <= 0)
+    {
+        reactorsCount = qMax(QThread::idealThreadCount(), 1);
+    }
+
+    const int listenSocket = openListenSocket(port);
+    if (listenSocket < 0)
+    {
+        return false;
+    }
+    // the reactors take the connections from the same accept queue, each one through its own descriptor
+    QVector<int> listenSockets;
+    listenSockets << listenSocket;
+    while (listenSockets.count() < reactorsCount)
+    {
+        const int socket = fcntl(listenSocket, F_DUPFD_CLOEXEC, 0);
+        if (socket < 0)
+        {
+            qCDebug(LOG_BASIC) << "ProxyCore::start(), can't duplicate the listening socket:" << errno;
+            for (int s : qAsConst(listenSockets))
+            {
+                close(s);
+            }
+            return false;
+        }
+        listenSockets << socket;
+    }
+
+    // port 0 takes a free port
+    sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+    getsockname(listenSocket, (sockaddr *)&addr, &addrLen);
+    port_ = ntohs(addr.sin_port);
+
+    spliceRelay_ = new SpliceRelay();
+    for (int socket : qAsConst(listenSockets))
+    {
+        reactors_ << new ProxyReactor(this, protocol_, socket, spliceRelay_);
+    }
+    return true;
+}
+
+void ProxyCore::stop()
+{
+    for (ProxyReactor *reactor : qAsConst(reactors_))
+    {
+        reactor->finish();
+    }
+    // closes the tunnels of all the reactors
+    delete spliceRelay_;
+    spliceRelay_ = nullptr;
+    for (ProxyReactor *reactor : qAsConst(reactors_))
+    {
+        delete reactor;
+    }
+    reactors_.clear();
+    dnsRequests_.clear();
+    port_ = 0;
+}
+
+bool ProxyCore::isStarted() const
+{
+    return !reactors_.isEmpty();
+}
+
+quint16 ProxyCore::port() const
+{
+    return port_;
+}
+
+void ProxyCore::setDnsServers(const QStringList &dnsServers)
+{
+    dnsServers_ = dnsServers;
+}
+
+void ProxyCore::closeAllConnections()
+{
+    for (ProxyReactor *reactor : qAsConst(reactors_))
+    {
+        reactor->closeAllConnections();
+    }
+}
+
+int ProxyCore::handshakesCount() const
+{
+    int count = 0;
+    for (const ProxyReactor *reactor : reactors_)
+    {
+        count += reactor->handshakesCount();
+    }
+    return count;
+}
+
+int ProxyCore::relaysCount() const
+{
+    int count = 0;
+    for (const ProxyReactor *reactor : reactors_)
+    {
+        count += reactor->relaysCount();
+    }
+    return count;
+}
+
+void ProxyCore::resolve(ProxyReactor *reactor, quint64 connectionId, const QString &hostname)
+{
+    QMetaObject::invokeMethod(this, [this, reactor, connectionId, hostname]() {
+        // the reactor may be stopped meanwhile
+        if (reactors_.contains(reactor))
+        {
+            const quint64 id = nextDnsRequestId_++;
+            dnsRequests_[id] = qMakePair(reactor, connectionId);
+            dnsCache_->resolve(hostname, id, false, dnsServers_);
+        }
+    }, Qt::QueuedConnection);
+}
+
+void ProxyCore::userConnected(const QString &peerAddress)
+{
+    ConnectedUsersCounter *usersCounter = usersCounter_;
+    QMetaObject::invokeMethod(usersCounter, [usersCounter, peerAddress]() {
+        usersCounter->newUserConnected(peerAddress);
+    }, Qt::QueuedConnection);
+}
+
+void ProxyCore::userDisconnected(const QString &peerAddress)
+{
+    ConnectedUsersCounter *usersCounter = usersCounter_;
+    QMetaObject::invokeMethod(usersCounter, [usersCounter, peerAddress]() {
+        usersCounter->userDiconnected(peerAddress);
+    }, Qt::QueuedConnection);
+}
+
+void ProxyCore::handOff(int socket, const QByteArray &readData)
+{
+    QMetaObject::invokeMethod(this, [this, socket, readData]() {
+        emit connectionHandedOff(socket, readData);
+    }, Qt::QueuedConnection);
+}
+
+void ProxyCore::onDnsCacheResolved(bool success, const QStringList &ips, quint64 id, bool bFromCache, int timeMs)
+{
+    Q_UNUSED(bFromCache);
+    Q_UNUSED(timeMs);
+    auto it = dnsRequests_.find(id);
+    if (it != dnsRequests_.end())
+    {
+        it.value().first->onHostnameResolved(it.value().second, success, ips);
+        dnsRequests_.erase(it);
+    }
+}
+
+int ProxyCore::openListenSocket(quint16 port)
+{
+    const int socket = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (socket < 0)
+    {
+        return -1;
+    }
+    const int on = 1;
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0 ||
+        bind(socket, (const sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(socket, SOMAXCONN) != 0)
+    {
+        qCDebug(LOG_BASIC) << "ProxyCore::openListenSocket(), can't listen on port" << port << ":" << errno;
+        close(socket);
+        return -1;
+    }
+    return socket;
+}
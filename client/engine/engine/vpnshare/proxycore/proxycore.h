@@ -0,0 +1,69 @@
+#ifndef PROXYCORE_H
+#define PROXYCORE_H
+
+#include <QHash>
+#include <QObject>
+#include <QPair>
+#include <QStringList>
+#include <QVector>
+
+#include "proxyreactor.h"
+
+class ConnectedUsersCounter;
+class DnsCache;
+class SpliceRelay;
+
+// The event loop of a proxy sharing server on Linux, instead of a QTcpServer and a QThread per group of connections.
+// One ProxyReactor per core, each accepts from its own duplicate of the one listening socket, so the port is bound once
+// and no other process can join it. The tunnels of all the reactors go to one SpliceRelay. Lives in the thread of the server,
+// which does the DNS lookups of the reactors through a DnsCache and receives the connections handed off by them.
+class ProxyCore : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ProxyCore(QObject *parent, ProxyReactor::PROTOCOL protocol, ConnectedUsersCounter *usersCounter);
+    virtual ~ProxyCore();
+
+    // reactorsCount 0 means one per core
+    bool start(quint16 port, int reactorsCount = 0);
+    void stop();
+    bool isStarted() const;
+    quint16 port() const;
+
+    void setDnsServers(const QStringList &dnsServers);
+    void closeAllConnections();
+
+    // the sum over the reactors, for the benchmarks
+    int handshakesCount() const;
+    int relaysCount() const;
+
+    // called from the reactor threads
+    void resolve(ProxyReactor *reactor, quint64 connectionId, const QString &hostname);
+    void userConnected(const QString &peerAddress);
+    void userDisconnected(const QString &peerAddress);
+    void handOff(int socket, const QByteArray &readData);
+
+signals:
+    // A connection which the reactors do not relay themselves, for the Qt connections of the server. readData is
+    // the data already read from the socket: the HTTP request, or the SOCKS command after the answered ident request.
+    void connectionHandedOff(qintptr socketDescriptor, const QByteArray &readData);
+
+private slots:
+    void onDnsCacheResolved(bool success, const QStringList &ips, quint64 id, bool bFromCache, int timeMs);
+
+private:
+    const ProxyReactor::PROTOCOL protocol_;
+    ConnectedUsersCounter *usersCounter_;
+    DnsCache *dnsCache_;
+    QStringList dnsServers_;
+    QVector<ProxyReactor *> reactors_;
+    SpliceRelay *spliceRelay_;      // null if not started
+    quint16 port_;
+
+    QHash<quint64, QPair<ProxyReactor *, quint64> > dnsRequests_;  // the reactor and its connection, by the DnsCache id
+    quint64 nextDnsRequestId_;
+
+    static int openListenSocket(quint16 port);
+};
+
+#endif // PROXYCORE_H
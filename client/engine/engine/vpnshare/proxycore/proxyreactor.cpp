@@ -0,0 +1,641 @@
+#include "proxyreactor.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "proxycore.h"
+#include "../httpproxyserver/httpproxyreply.h"
+#include "../httpproxyserver/httpproxyrequestparser.h"
+#include "../socketutils/splicerelay.h"
+#include "../socksproxyserver/socksproxycommandparser.h"
+#include "../socksproxyserver/socksproxyidentreqparser.h"
+#include "utils/crashhandler.h"
+#include "utils/logger.h"
+
+namespace {
+
+const char *kHttpReplyEstablished = "HTTP/1.0 200 Connection established\r\nProxy-agent: Windscribe\r\n\r\n";
+const char *kHttpConnectMethod = "CONNECT ";
+
+bool isWouldBlockError()
+{
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+} // namespace
+
+ProxyReactor::ProxyReactor(ProxyCore *core, PROTOCOL protocol, int listenSocket, SpliceRelay *spliceRelay) : QThread(nullptr),
+    core_(core),
+    protocol_(protocol),
+    listenSocket_(listenSocket),
+    spliceRelay_(spliceRelay),
+    bFinish_(false),
+    handshakesCount_(0),
+    relaysCount_(0),
+    nextConnectionId_(1),
+    bAcceptPaused_(false)
+{
+    // from the relay thread, the relays are accounted in the reactor thread, which skips the relays of the other reactors
+    connect(spliceRelay_, &SpliceRelay::relayFinished, this, [this](quint64 relayId, qint64, qint64) {
+        if (commands_.push(Command { Command::RELAY_FINISHED, relayId, true, QStringList() }))
+        {
+            poller_.wakeup();
+        }
+    }, Qt::DirectConnection);
+    clock_.start();
+    start();
+}
+
+ProxyReactor::~ProxyReactor()
+{
+    finish();
+    close(listenSocket_);
+}
+
+void ProxyReactor::closeAllConnections()
+{
+    if (commands_.push(Command { Command::CLOSE_ALL, 0, false, QStringList() }))
+    {
+        poller_.wakeup();
+    }
+}
+
+void ProxyReactor::onHostnameResolved(quint64 connectionId, bool bSuccess, const QStringList &ips)
+{
+    if (commands_.push(Command { Command::HOSTNAME_RESOLVED, connectionId, bSuccess, ips }))
+    {
+        poller_.wakeup();
+    }
+}
+
+void ProxyReactor::finish()
+{
+    if (!isRunning())
+    {
+        return;
+    }
+    bFinish_ = true;
+    poller_.wakeup();
+    wait();
+}
+
+void ProxyReactor::run()
+{
+    BIND_CRASH_HANDLER_FOR_THREAD();
+
+    poller_.updateExclusive(listenSocket_);
+    qint64 nextTimeoutsCheck = clock_.elapsed() + kPollTimeoutMs;
+
+    std::vector<wsl::SocketPoller::Event> events;
+    while (!bFinish_)
+    {
+        processCommands();
+
+        events.clear();
+        poller_.wait(kPollTimeoutMs, events);
+
+        for (const wsl::SocketPoller::Event &event : events)
+        {
+            if (event.socket == listenSocket_)
+            {
+                acceptConnections();
+                continue;
+            }
+            // may be closed by an earlier event
+            Connection *connection = sockets_.value(event.socket, nullptr);
+            if (connection)
+            {
+                onSocketEvent(connection, event.socket);
+            }
+        }
+
+        if (clock_.elapsed() >= nextTimeoutsCheck)
+        {
+            checkTimeouts();
+            nextTimeoutsCheck = clock_.elapsed() + kPollTimeoutMs;
+        }
+    }
+
+    poller_.update(listenSocket_, false, false);
+    const QList<Connection *> connections = connections_.values();
+    for (Connection *connection : connections)
+    {
+        closeConnection(connection);
+    }
+}
+
+void ProxyReactor::processCommands()
+{
+    commands_.popAll([this](Command &&command) {
+        if (command.type == Command::CLOSE_ALL)
+        {
+            const QList<Connection *> connections = connections_.values();
+            for (Connection *connection : connections)
+            {
+                closeConnection(connection);
+            }
+            for (auto it = relays_.constBegin(); it != relays_.constEnd(); ++it)
+            {
+                spliceRelay_->remove(it.key());
+                core_->userDisconnected(it.value());
+            }
+            relays_.clear();
+            relaysCount_ = 0;
+        }
+        else if (command.type == Command::HOSTNAME_RESOLVED)
+        {
+            Connection *connection = connections_.value(command.id, nullptr);
+            if (connection && connection->state == RESOLVE)
+            {
+                sockaddr_storage addr;
+                socklen_t addrLen;
+                if (command.bSuccess && !command.ips.isEmpty() && makeAddress(command.ips.first(), connection->port, addr, addrLen))
+                {
+                    startConnect(connection, addr, addrLen);
+                }
+                else
+                {
+                    onConnectToHostFailed(connection, EHOSTUNREACH);
+                }
+            }
+        }
+        else if (command.type == Command::RELAY_FINISHED)
+        {
+            auto it = relays_.find(command.id);
+            if (it != relays_.end())
+            {
+                core_->userDisconnected(it.value());
+                relays_.erase(it);
+                relaysCount_--;
+            }
+        }
+    });
+}
+
+void ProxyReactor::acceptConnections()
+{
+    // the listening socket is level-triggered, the rest is accepted on the next iteration
+    for (int i = 0; i < kMaxAcceptsPerEvent; ++i)
+    {
+        sockaddr_in addr;
+        socklen_t addrLen = sizeof(addr);
+        const int socket = accept4(listenSocket_, (sockaddr *)&addr, &addrLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (socket < 0)
+        {
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)
+            {
+                // the pending connections stay in the backlog, try again after the timeout
+                qCDebug(LOG_BASIC) << "ProxyReactor::acceptConnections(), accept failed:" << errno;
+                poller_.update(listenSocket_, false, false);
+                bAcceptPaused_ = true;
+            }
+            return;
+        }
+
+        char ip[INET_ADDRSTRLEN] = {};
+        inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+
+        Connection *connection = connectionsPool_.create();
+        connection->id = nextConnectionId_++;
+        connection->socket = socket;
+        connection->state = (protocol_ == SOCKS5) ? READ_IDENT_REQ : READ_HTTP_REQUEST;
+        connection->deadline = clock_.elapsed() + kHandshakeTimeoutMs;
+        connection->peerAddress = QString::fromLatin1(ip);
+        sockets_[socket] = connection;
+        connections_[connection->id] = connection;
+        handshakesCount_++;
+        poller_.update(socket, true, false);
+    }
+}
+
+void ProxyReactor::onSocketEvent(Connection *connection, int socket)
+{
+    if (socket == connection->socketExternal)
+    {
+        if (connection->state == CONNECT_TO_HOST)
+        {
+            onExternalSocketConnected(connection);
+        }
+    }
+    else if (connection->state == READ_IDENT_REQ || connection->state == READ_COMMAND)
+    {
+        readSocks(connection);
+    }
+    else if (connection->state == READ_HTTP_REQUEST)
+    {
+        readHttp(connection);
+    }
+}
+
+void ProxyReactor::checkTimeouts()
+{
+    const qint64 now = clock_.elapsed();
+    QList<Connection *> expired;
+    for (Connection *connection : qAsConst(connections_))
+    {
+        if (now >= connection->deadline)
+        {
+            expired << connection;
+        }
+    }
+    for (Connection *connection : expired)
+    {
+        closeConnection(connection);
+    }
+
+    if (bAcceptPaused_)
+    {
+        bAcceptPaused_ = false;
+        poller_.updateExclusive(listenSocket_);
+    }
+}
+
+void ProxyReactor::readSocks(Connection *connection)
+{
+    if (!readFromClient(connection))
+    {
+        closeConnection(connection);
+        return;
+    }
+
+    if (connection->state == READ_IDENT_REQ)
+    {
+        SocksProxyServer::SocksProxyIdentReqParser identReqParser;
+        quint32 parsed;
+        if (!identReqParser.parse(connection->readData, parsed))
+        {
+            return;
+        }
+        connection->readData.remove(0, parsed);
+
+        const SocksProxyServer::socks5_ident_req &identReq = identReqParser.identReq();
+        bool bFoundNonAuthMethod = false;
+        for (unsigned char i = 0; i < identReq.NumberOfMethods; ++i)
+        {
+            if (identReq.Methods[i] == 0x00)
+            {
+                bFoundNonAuthMethod = true;
+                break;
+            }
+        }
+
+        const bool bAccepted = bFoundNonAuthMethod && identReq.Version == 0x05;
+        const char answer[2] = { char(identReq.Version), char(bAccepted ? 0x00 : 0xFF) };
+        if (!bAccepted)
+        {
+            writeErrorReplyAndClose(connection, QByteArray(answer, sizeof(answer)));
+            return;
+        }
+        // two bytes into a socket which has not sent anything yet, never blocks
+        if (send(connection->socket, answer, sizeof(answer), MSG_NOSIGNAL) != sizeof(answer))
+        {
+            closeConnection(connection);
+            return;
+        }
+        connection->state = READ_COMMAND;
+        if (connection->readData.isEmpty())
+        {
+            return;
+        }
+    }
+
+    SocksProxyServer::SocksProxyCommandParser commandParser;
+    quint32 parsed;
+    const SocksProxyServer::TRI_BOOL res = commandParser.parse(connection->readData, parsed);
+    if (res == SocksProxyServer::TRI_INDETERMINATE)
+    {
+        return;
+    }
+    if (res == SocksProxyServer::TRI_FALSE)
+    {
+        qCDebug(LOG_SOCKS_SERVER) << "ProxyReactor::readSocks(), incorrect command";
+        closeConnection(connection);
+        return;
+    }
+
+    const SocksProxyServer::socks5_req &cmd = commandParser.cmd();
+    if (cmd.Cmd == 0x03)
+    {
+        // UDP associations need the event loop of Qt
+        handOff(connection, connection->readData);
+        return;
+    }
+    if (cmd.Cmd != 0x01)
+    {
+        writeErrorReplyAndClose(connection, makeSocksReply(0x07, -1));  // command not supported
+        return;
+    }
+
+    // the parser stores the address and the port in the reversed byte order
+    QString host;
+    if (cmd.AddrType == 0x01)
+    {
+        quint32 ipv4;
+        memcpy(&ipv4, &cmd.DestAddr.IPv4, sizeof(ipv4));
+        in_addr addr;
+        addr.s_addr = htonl(ipv4);
+        char ip[INET_ADDRSTRLEN] = {};
+        inet_ntop(AF_INET, &addr, ip, sizeof(ip));
+        host = QString::fromLatin1(ip);
+    }
+    else if (cmd.AddrType == 0x04)
+    {
+        in6_addr addr;
+        const unsigned char *reversed = (const unsigned char *)&cmd.DestAddr.IPv6;
+        std::reverse_copy(reversed, reversed + sizeof(addr), (unsigned char *)&addr);
+        char ip[INET6_ADDRSTRLEN] = {};
+        inet_ntop(AF_INET6, &addr, ip, sizeof(ip));
+        host = QString::fromLatin1(ip);
+    }
+    else
+    {
+        host = QString::fromLatin1(cmd.DestAddr.Domain, cmd.DestAddr.DomainLen);
+    }
+    connection->port = cmd.DestPort;
+    // the data which the client sent right after the command goes to the host
+    connection->readData.remove(0, parsed);
+    connectToHost(connection, host);
+}
+
+void ProxyReactor::readHttp(Connection *connection)
+{
+    if (!readFromClient(connection))
+    {
+        closeConnection(connection);
+        return;
+    }
+
+    // only the tunnels are handled here, plain HTTP requests need the rewriting of the Qt connections
+    const int prefixSize = qMin(connection->readData.size(), (int)strlen(kHttpConnectMethod));
+    if (memcmp(connection->readData.constData(), kHttpConnectMethod, prefixSize) != 0)
+    {
+        handOff(connection, connection->readData);
+        return;
+    }
+
+    HttpProxyServer::HttpProxyRequestParser requestParser;
+    quint32 parsed;
+    const HttpProxyServer::TRI_BOOL res = requestParser.parse(connection->readData, parsed);
+    if (res == HttpProxyServer::TRI_INDETERMINATE)
+    {
+        if (connection->readData.size() > kMaxHttpRequestSize)
+        {
+            writeErrorReplyAndClose(connection, makeHttpErrorReply(HttpProxyServer::HttpProxyReply::service_unavailable));
+        }
+        return;
+    }
+    if (res == HttpProxyServer::TRI_FALSE)
+    {
+        qCDebug(LOG_HTTP_SERVER) << "ProxyReactor::readHttp(), parse client request failed";
+        writeErrorReplyAndClose(connection, makeHttpErrorReply(HttpProxyServer::HttpProxyReply::service_unavailable));
+        return;
+    }
+
+    HttpProxyServer::HttpProxyRequest &request = requestParser.getRequest();
+    if (!request.isConnectMethod() || !request.extractHostAndPort())
+    {
+        qCDebug(LOG_HTTP_SERVER) << "ProxyReactor::readHttp(), extractHostAndPort from request failed";
+        closeConnection(connection);
+        return;
+    }
+    connection->port = request.port;
+    connection->readData.remove(0, parsed);
+    connectToHost(connection, QString::fromStdString(request.host));
+}
+
+bool ProxyReactor::readFromClient(Connection *connection)
+{
+    char buf[4096];
+    const ssize_t n = recv(connection->socket, buf, sizeof(buf), 0);
+    if (n > 0)
+    {
+        connection->readData.append(buf, n);
+        return true;
+    }
+    return n < 0 && isWouldBlockError();
+}
+
+void ProxyReactor::connectToHost(Connection *connection, const QString &host)
+{
+    // the client is not read until the tunnel is ready, its data waits in the socket
+    poller_.update(connection->socket, false, false);
+
+    sockaddr_storage addr;
+    socklen_t addrLen;
+    if (makeAddress(host, connection->port, addr, addrLen))
+    {
+        startConnect(connection, addr, addrLen);
+    }
+    else
+    {
+        connection->state = RESOLVE;
+        core_->resolve(this, connection->id, host);
+    }
+}
+
+void ProxyReactor::startConnect(Connection *connection, const sockaddr_storage &addr, socklen_t addrLen)
+{
+    const int socket = ::socket(addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (socket < 0)
+    {
+        onConnectToHostFailed(connection, errno);
+        return;
+    }
+    connection->socketExternal = socket;
+    sockets_[socket] = connection;
+    connection->state = CONNECT_TO_HOST;
+
+    if (::connect(socket, (const sockaddr *)&addr, addrLen) == 0)
+    {
+        onExternalSocketConnected(connection);
+    }
+    else if (errno == EINPROGRESS)
+    {
+        poller_.update(socket, false, true);
+    }
+    else
+    {
+        onConnectToHostFailed(connection, errno);
+    }
+}
+
+void ProxyReactor::onExternalSocketConnected(Connection *connection)
+{
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (getsockopt(connection->socketExternal, SOL_SOCKET, SO_ERROR, &error, &len) != 0)
+    {
+        error = errno;
+    }
+    if (error != 0)
+    {
+        onConnectToHostFailed(connection, error);
+        return;
+    }
+
+    if (protocol_ == SOCKS5)
+    {
+        startRelay(connection, makeSocksReply(0x00, connection->socketExternal));
+    }
+    else
+    {
+        startRelay(connection, QByteArray(kHttpReplyEstablished));
+    }
+}
+
+void ProxyReactor::onConnectToHostFailed(Connection *connection, int error)
+{
+    if (protocol_ == SOCKS5)
+    {
+        unsigned char reply = 0x01;         // general failure
+        if (error == ECONNREFUSED)
+        {
+            reply = 0x05;                   // connection refused
+        }
+        else if (error == ENETUNREACH)
+        {
+            reply = 0x03;                   // network unreachable
+        }
+        else if (error == EHOSTUNREACH || error == ETIMEDOUT)
+        {
+            reply = 0x04;                   // host unreachable
+        }
+        writeErrorReplyAndClose(connection, makeSocksReply(reply, -1));
+    }
+    else
+    {
+        writeErrorReplyAndClose(connection, makeHttpErrorReply(HttpProxyServer::HttpProxyReply::internal_server_error));
+    }
+}
+
+void ProxyReactor::startRelay(Connection *connection, const QByteArray &reply)
+{
+    const int socket = connection->socket;
+    const int socketExternal = connection->socketExternal;
+    const QString peerAddress = connection->peerAddress;
+    const QByteArray readData = connection->readData;
+    // the sockets go to the relay
+    connection->socket = -1;
+    connection->socketExternal = -1;
+    poller_.update(socket, false, false);
+    poller_.update(socketExternal, false, false);
+    sockets_.remove(socket);
+    sockets_.remove(socketExternal);
+    removeConnection(connection);
+
+    // the reply goes to the client before the data of the host
+    const quint64 relayId = spliceRelay_->add(socket, socketExternal, readData, reply);
+    relays_[relayId] = peerAddress;
+    relaysCount_++;
+    core_->userConnected(peerAddress);
+}
+
+void ProxyReactor::handOff(Connection *connection, const QByteArray &readData)
+{
+    const int socket = connection->socket;
+    connection->socket = -1;
+    poller_.update(socket, false, false);
+    sockets_.remove(socket);
+    removeConnection(connection);
+    core_->handOff(socket, readData);
+}
+
+void ProxyReactor::writeErrorReplyAndClose(Connection *connection, const QByteArray &reply)
+{
+    // the replies are short, the client is not expected to read anything else, so no need to wait for the socket
+    send(connection->socket, reply.constData(), reply.size(), MSG_NOSIGNAL);
+    closeConnection(connection);
+}
+
+void ProxyReactor::closeConnection(Connection *connection)
+{
+    const int socket = connection->socket;
+    const int socketExternal = connection->socketExternal;
+    removeConnection(connection);
+    if (socket >= 0)
+    {
+        close(socket);
+    }
+    if (socketExternal >= 0)
+    {
+        close(socketExternal);
+    }
+}
+
+void ProxyReactor::removeConnection(Connection *connection)
+{
+    for (int socket : { connection->socket, connection->socketExternal })
+    {
+        if (socket >= 0)
+        {
+            poller_.update(socket, false, false);
+            sockets_.remove(socket);
+        }
+    }
+    connections_.remove(connection->id);
+    connectionsPool_.destroy(connection);
+    handshakesCount_--;
+}
+
+bool ProxyReactor::makeAddress(const QString &host, quint16 port, sockaddr_storage &outAddr, socklen_t &outAddrLen)
+{
+    memset(&outAddr, 0, sizeof(outAddr));
+    const QByteArray hostLatin1 = host.toLatin1();
+    sockaddr_in *addr4 = (sockaddr_in *)&outAddr;
+    sockaddr_in6 *addr6 = (sockaddr_in6 *)&outAddr;
+    if (inet_pton(AF_INET, hostLatin1.constData(), &addr4->sin_addr) == 1)
+    {
+        addr4->sin_family = AF_INET;
+        addr4->sin_port = htons(port);
+        outAddrLen = sizeof(sockaddr_in);
+        return true;
+    }
+    if (inet_pton(AF_INET6, hostLatin1.constData(), &addr6->sin6_addr) == 1)
+    {
+        addr6->sin6_family = AF_INET6;
+        addr6->sin6_port = htons(port);
+        outAddrLen = sizeof(sockaddr_in6);
+        return true;
+    }
+    return false;
+}
+
+QByteArray ProxyReactor::makeSocksReply(unsigned char reply, int socket)
+{
+    // VER REP RSV ATYP BND.ADDR BND.PORT, the bound address of the socket to the host if there is one
+    QByteArray arr;
+    arr.append(char(0x05)).append(char(reply)).append(char(0x00));
+    sockaddr_storage addr;
+    socklen_t addrLen = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    if (socket >= 0)
+    {
+        getsockname(socket, (sockaddr *)&addr, &addrLen);
+    }
+    if (addr.ss_family == AF_INET6)
+    {
+        const sockaddr_in6 *addr6 = (const sockaddr_in6 *)&addr;
+        arr.append(char(0x04));
+        arr.append((const char *)&addr6->sin6_addr, sizeof(addr6->sin6_addr));
+        arr.append((const char *)&addr6->sin6_port, sizeof(addr6->sin6_port));
+    }
+    else
+    {
+        const sockaddr_in *addr4 = (const sockaddr_in *)&addr;
+        arr.append(char(0x01));
+        arr.append((const char *)&addr4->sin_addr, sizeof(addr4->sin_addr));
+        arr.append((const char *)&addr4->sin_port, sizeof(addr4->sin_port));
+    }
+    return arr;
+}
+
+QByteArray ProxyReactor::makeHttpErrorReply(int status)
+{
+    return HttpProxyServer::HttpProxyReply::stock_reply((HttpProxyServer::HttpProxyReply::status_type)status).toBuffer();
+}
@@ -0,0 +1,123 @@
+#ifndef PROXYREACTOR_H
+#define PROXYREACTOR_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+
+#include <sys/socket.h>
+#include <atomic>
+
+#include "utils/mpscqueue.h"
+#include "utils/slabpool.h"
+#include "utils/socketpoller.h"
+
+class ProxyCore;
+class SpliceRelay;
+
+// One shard of the ProxyCore, runs an epoll loop in its own thread. Accepts the connections through its own descriptor of the
+// listening socket (the shards take turns on the same accept queue), does the handshake of the protocol and connects to
+// the destination with plain state machines over the nonblocking sockets. The ready tunnels go to the SpliceRelay shared by
+// the shards. The rest of the connections (plain HTTP requests, UDP associations) are handed off to the Qt connections.
+class ProxyReactor : public QThread
+{
+    Q_OBJECT
+public:
+    enum PROTOCOL { SOCKS5, HTTP };
+
+    // takes ownership of the listening socket, the relay must outlive the reactor
+    explicit ProxyReactor(ProxyCore *core, PROTOCOL protocol, int listenSocket, SpliceRelay *spliceRelay);
+    virtual ~ProxyReactor();
+
+    // can be called from any thread
+    void closeAllConnections();
+    void onHostnameResolved(quint64 connectionId, bool bSuccess, const QStringList &ips);
+    void finish();
+
+    // from any thread, for the benchmarks
+    int handshakesCount() const { return handshakesCount_; }
+    int relaysCount() const { return relaysCount_; }
+
+protected:
+    void run() override;
+
+private:
+    static constexpr int kHandshakeTimeoutMs = 30000;
+    static constexpr int kMaxHttpRequestSize = 8192;
+    static constexpr int kPollTimeoutMs = 1000;
+    static constexpr int kMaxAcceptsPerEvent = 64;
+
+    enum STATE { READ_IDENT_REQ, READ_COMMAND, READ_HTTP_REQUEST, RESOLVE, CONNECT_TO_HOST };
+
+    // a connection which has not become a tunnel yet, from the pool of the shard
+    struct Connection
+    {
+        quint64 id = 0;
+        int socket = -1;
+        int socketExternal = -1;
+        STATE state = READ_IDENT_REQ;
+        qint64 deadline = 0;
+        QString peerAddress;
+        quint16 port = 0;
+        // read from the client and not consumed by the handshake yet, the messages of the handshake are short,
+        // they are parsed again from the start when more data comes
+        QByteArray readData;
+    };
+
+    struct Command
+    {
+        enum TYPE { CLOSE_ALL, HOSTNAME_RESOLVED, RELAY_FINISHED };
+        TYPE type;
+        quint64 id;                     // the connection id or the relay id
+        bool bSuccess;
+        QStringList ips;
+    };
+
+    ProxyCore *core_;
+    const PROTOCOL protocol_;
+    const int listenSocket_;
+    SpliceRelay *const spliceRelay_;
+    wsl::SocketPoller poller_;
+    wsl::MpscQueue<Command> commands_;
+    std::atomic<bool> bFinish_;
+    std::atomic<int> handshakesCount_;
+    std::atomic<int> relaysCount_;
+
+    // accessed only from the reactor thread
+    wsl::SlabPool<Connection> connectionsPool_;
+    QHash<int, Connection *> sockets_;          // both sockets of the connections
+    QHash<quint64, Connection *> connections_;  // by the id
+    QHash<quint64, QString> relays_;            // the peer address of the own tunnels, by the relay id
+    quint64 nextConnectionId_;
+    bool bAcceptPaused_;
+    QElapsedTimer clock_;
+
+    void processCommands();
+    void acceptConnections();
+    void onSocketEvent(Connection *connection, int socket);
+    void checkTimeouts();
+
+    void readSocks(Connection *connection);
+    void readHttp(Connection *connection);
+    bool readFromClient(Connection *connection);
+    void connectToHost(Connection *connection, const QString &host);
+    void startConnect(Connection *connection, const sockaddr_storage &addr, socklen_t addrLen);
+    void onExternalSocketConnected(Connection *connection);
+    void onConnectToHostFailed(Connection *connection, int error);
+
+    void startRelay(Connection *connection, const QByteArray &reply);
+    void handOff(Connection *connection, const QByteArray &readData);
+    void writeErrorReplyAndClose(Connection *connection, const QByteArray &reply);
+    void closeConnection(Connection *connection);
+    void removeConnection(Connection *connection);
+
+    // for IP address literals only
+    static bool makeAddress(const QString &host, quint16 port, sockaddr_storage &outAddr, socklen_t &outAddrLen);
+    static QByteArray makeSocksReply(unsigned char reply, int socket);
+    static QByteArray makeHttpErrorReply(int status);
+};
+
+#endif // PROXYREACTOR_H
@@ -1,27 +1,30 @@
 #include "socketwriteall.h"
 
 SocketWriteAll::SocketWriteAll(QObject *parent, QTcpSocket *socket) : QObject(parent),
-    socket_(socket), bEmitAllDataWritten_(false)
+    socket_(socket), source_(nullptr), bEmitAllDataWritten_(false)
 {
     connect(socket_, SIGNAL(bytesWritten(qint64)), SLOT(onBytesWritten(qint64)));
 }
 
 void SocketWriteAll::write(const QByteArray &arr)
 {
-    if (arr_.isEmpty())
-    {
-        arr_ = arr;
-        socket_->write(arr_);
-    }
-    else
+    socket_->write(arr);
+}
+
+void SocketWriteAll::relayFrom(QTcpSocket *source)
+{
+    if (source_ != source)
     {
-        arr_.append(arr);
+        source_ = source;
+        source_->setReadBufferSize(kMaxPendingBytes);
     }
+    readFromSource();
 }
 
 void SocketWriteAll::setEmitAllDataWritten()
 {
-    if (arr_.isEmpty())
+    readFromSource();
+    if (isAllDataWritten())
     {
         emit allDataWriteFinished();
     }
@@ -30,16 +33,27 @@ void SocketWriteAll::setEmitAllDataWritten()
 
 void SocketWriteAll::onBytesWritten(qint64 bytes)
 {
-    arr_.remove(0, bytes);
-    if (!arr_.isEmpty())
+    Q_UNUSED(bytes);
+    readFromSource();
+    if (bEmitAllDataWritten_ && isAllDataWritten())
+    {
+        emit allDataWriteFinished();
+    }
+}
+
+void SocketWriteAll::readFromSource()
+{
+    if (!source_)
     {
-        socket_->write(arr_);
+        return;
     }
-    else
+    while (source_->bytesAvailable() > 0 && socket_->bytesToWrite() < kMaxPendingBytes)
     {
-        if (bEmitAllDataWritten_)
-        {
-            emit allDataWriteFinished();
-        }
+        socket_->write(source_->read(kMaxPendingBytes - socket_->bytesToWrite()));
     }
 }
+
+bool SocketWriteAll::isAllDataWritten() const
+{
+    return socket_->bytesToWrite() == 0 && (!source_ || source_->bytesAvailable() == 0);
+}
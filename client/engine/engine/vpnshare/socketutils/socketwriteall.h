@@ -4,12 +4,19 @@
 #include <QObject>
 #include <QTcpSocket>
 
+// Writes all the data to the socket, the socket buffers it until it is sent.
+// relayFrom() moves the data from another socket with backpressure: no more than kMaxPendingBytes wait to be sent,
+// the rest stays in the source socket, which then stops reading from the network as its read buffer is limited too.
 class SocketWriteAll : public QObject
 {
     Q_OBJECT
 public:
+    static constexpr qint64 kMaxPendingBytes = 1024 * 1024;
+
     explicit SocketWriteAll(QObject *parent, QTcpSocket *socket);
     void write(const QByteArray &arr);
+    // call on every readyRead of the source
+    void relayFrom(QTcpSocket *source);
 
     void setEmitAllDataWritten();
 
@@ -21,8 +28,11 @@ private slots:
 
 private:
     QTcpSocket *socket_;
-    QByteArray arr_;
+    QTcpSocket *source_;
     bool bEmitAllDataWritten_;
+
+    void readFromSource();
+    bool isAllDataWritten() const;
 };
 
 #endif // SOCKETWRITEALL_H
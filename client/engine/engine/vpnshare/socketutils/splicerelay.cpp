@@ -0,0 +1,340 @@
+#include "splicerelay.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "utils/crashhandler.h"
+#include "utils/logger.h"
+
+namespace {
+
+bool isWouldBlockError()
+{
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+// splice() into a socket closed by the peer raises SIGPIPE, it is blocked in the relay thread, drop it
+void dropPendingSigPipe()
+{
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPIPE);
+    struct timespec zero = { 0, 0 };
+    while (sigtimedwait(&set, nullptr, &zero) > 0)
+    {
+    }
+}
+
+} // namespace
+
+SpliceRelay::SpliceRelay(QObject *parent) : QThread(parent),
+    bFinish_(false),
+    nextRelayId_(1)
+{
+    start();
+}
+
+SpliceRelay::~SpliceRelay()
+{
+    finish();
+}
+
+quint64 SpliceRelay::takeOver(QTcpSocket *socket1, QTcpSocket *socket2)
+{
+    if (socket1->state() != QAbstractSocket::ConnectedState || socket2->state() != QAbstractSocket::ConnectedState)
+    {
+        return 0;
+    }
+    if (socket1->bytesToWrite() > 0 || socket2->bytesToWrite() > 0)
+    {
+        return 0;
+    }
+
+    const int fd1 = fcntl(socket1->socketDescriptor(), F_DUPFD_CLOEXEC, 0);
+    const int fd2 = fcntl(socket2->socketDescriptor(), F_DUPFD_CLOEXEC, 0);
+    if (fd1 < 0 || fd2 < 0)
+    {
+        qCDebug(LOG_BASIC) << "SpliceRelay::takeOver(), can't duplicate the socket descriptors:" << errno;
+        if (fd1 >= 0)
+        {
+            close(fd1);
+        }
+        if (fd2 >= 0)
+        {
+            close(fd2);
+        }
+        return 0;
+    }
+
+    const QByteArray readFrom1 = socket1->readAll();
+    const QByteArray readFrom2 = socket2->readAll();
+    socket1->disconnect();
+    socket2->disconnect();
+    // closes only the descriptors of Qt, the connections stay open through the duplicates
+    socket1->abort();
+    socket2->abort();
+
+    return add(fd1, fd2, readFrom1, readFrom2);
+}
+
+quint64 SpliceRelay::add(int socket1, int socket2, const QByteArray &readFrom1, const QByteArray &readFrom2)
+{
+    Relay *relay = new Relay();
+    relay->id = nextRelayId_++;
+    relay->sockets[0] = socket1;
+    relay->sockets[1] = socket2;
+    for (int i = 0; i < 2; ++i)
+    {
+        Direction &dir = relay->dirs[i];
+        dir.from = relay->sockets[i];
+        dir.to = relay->sockets[1 - i];
+        dir.pipe[0] = dir.pipe[1] = -1;
+        dir.pipeSize = 0;
+        dir.inPipe = 0;
+        dir.bPipeFull = false;
+        dir.pending = (i == 0) ? readFrom1 : readFrom2;
+        dir.pendingPos = 0;
+        dir.bEof = false;
+        dir.bShutdown = false;
+        dir.bytes = 0;
+    }
+    const quint64 relayId = relay->id;
+    if (commands_.push(Command { Command::ADD, relay, relayId }))
+    {
+        poller_.wakeup();
+    }
+    return relayId;
+}
+
+void SpliceRelay::remove(quint64 relayId)
+{
+    if (commands_.push(Command { Command::REMOVE, nullptr, relayId }))
+    {
+        poller_.wakeup();
+    }
+}
+
+void SpliceRelay::finish()
+{
+    if (!isRunning())
+    {
+        return;
+    }
+    bFinish_ = true;
+    poller_.wakeup();
+    wait();
+}
+
+void SpliceRelay::run()
+{
+    BIND_CRASH_HANDLER_FOR_THREAD();
+
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &set, nullptr);
+
+    std::vector<wsl::SocketPoller::Event> events;
+    while (!bFinish_)
+    {
+        processCommands();
+
+        events.clear();
+        poller_.wait(-1, events);
+
+        for (const wsl::SocketPoller::Event &event : events)
+        {
+            // may be removed by an earlier event
+            Relay *relay = sockets_.value(event.socket, nullptr);
+            if (relay)
+            {
+                onSocketEvent(relay);
+            }
+        }
+    }
+
+    commands_.popAll([](Command &&command) {
+        if (command.relay)
+        {
+            closeRelaySockets(command.relay);
+            delete command.relay;
+        }
+    });
+    const QList<Relay *> relays = relays_.values();
+    for (Relay *relay : relays)
+    {
+        removeRelay(relay);
+    }
+}
+
+void SpliceRelay::processCommands()
+{
+    commands_.popAll([this](Command &&command) {
+        if (command.type == Command::ADD)
+        {
+            startRelay(command.relay);
+        }
+        else if (command.type == Command::REMOVE)
+        {
+            Relay *relay = relays_.value(command.relayId, nullptr);
+            if (relay)
+            {
+                removeRelay(relay);
+            }
+        }
+    });
+}
+
+void SpliceRelay::startRelay(Relay *relay)
+{
+    for (Direction &dir : relay->dirs)
+    {
+        if (pipe2(dir.pipe, O_NONBLOCK | O_CLOEXEC) != 0)
+        {
+            qCDebug(LOG_BASIC) << "SpliceRelay::startRelay(), pipe2 failed:" << errno;
+            emit relayFinished(relay->id, 0, 0);
+            closeRelaySockets(relay);
+            delete relay;
+            return;
+        }
+        fcntl(dir.pipe[1], F_SETPIPE_SZ, kPipeSize);
+        // smaller than asked if the pipe buffers of the user are over the limit
+        dir.pipeSize = fcntl(dir.pipe[1], F_GETPIPE_SZ);
+    }
+
+    relays_[relay->id] = relay;
+    sockets_[relay->sockets[0]] = relay;
+    sockets_[relay->sockets[1]] = relay;
+    onSocketEvent(relay);
+}
+
+void SpliceRelay::onSocketEvent(Relay *relay)
+{
+    // the readiness of the other socket is checked by the calls themselves, it is cheap
+    const bool bOk = pump(relay->dirs[0]) && pump(relay->dirs[1]);
+    if (!bOk || (relay->dirs[0].bShutdown && relay->dirs[1].bShutdown))
+    {
+        emit relayFinished(relay->id, relay->dirs[0].bytes, relay->dirs[1].bytes);
+        removeRelay(relay);
+    }
+    else
+    {
+        updatePoller(relay);
+    }
+}
+
+bool SpliceRelay::pump(Direction &dir)
+{
+    bool bProgress = true;
+    while (bProgress)
+    {
+        bProgress = false;
+
+        if (dir.pendingPos < dir.pending.size())
+        {
+            const ssize_t n = send(dir.to, dir.pending.constData() + dir.pendingPos, dir.pending.size() - dir.pendingPos, MSG_NOSIGNAL);
+            if (n > 0)
+            {
+                dir.pendingPos += n;
+                dir.bytes += n;
+                bProgress = true;
+                if (dir.pendingPos == dir.pending.size())
+                {
+                    dir.pending.clear();
+                    dir.pendingPos = 0;
+                }
+            }
+            else if (!isWouldBlockError())
+            {
+                return false;
+            }
+        }
+        else if (dir.inPipe > 0)
+        {
+            const ssize_t n = splice(dir.pipe[0], nullptr, dir.to, nullptr, dir.inPipe, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n > 0)
+            {
+                dir.inPipe -= n;
+                dir.bytes += n;
+                dir.bPipeFull = false;
+                bProgress = true;
+            }
+            else if (n == 0 || !isWouldBlockError())
+            {
+                dropPendingSigPipe();
+                return false;
+            }
+        }
+
+        if (!dir.bEof && !dir.bPipeFull)
+        {
+            const ssize_t n = splice(dir.from, nullptr, dir.pipe[1], nullptr, dir.pipeSize, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n > 0)
+            {
+                dir.inPipe += n;
+                bProgress = true;
+            }
+            else if (n == 0)
+            {
+                dir.bEof = true;
+            }
+            else if (isWouldBlockError())
+            {
+                // either nothing to read or no room in the pipe (its capacity is in pages, not in bytes),
+                // in both cases reading makes sense again only after the pipe is drained a bit
+                dir.bPipeFull = (dir.inPipe > 0);
+            }
+            else
+            {
+                return false;
+            }
+        }
+    }
+
+    if (dir.bEof && !dir.bShutdown && dir.inPipe == 0 && dir.pending.isEmpty())
+    {
+        shutdown(dir.to, SHUT_WR);
+        dir.bShutdown = true;
+    }
+    return true;
+}
+
+void SpliceRelay::updatePoller(Relay *relay)
+{
+    for (int i = 0; i < 2; ++i)
+    {
+        const Direction &in = relay->dirs[i];
+        const Direction &out = relay->dirs[1 - i];
+        poller_.update(relay->sockets[i], !in.bEof && !in.bPipeFull, !out.pending.isEmpty() || out.inPipe > 0);
+    }
+}
+
+void SpliceRelay::removeRelay(Relay *relay)
+{
+    for (int i = 0; i < 2; ++i)
+    {
+        poller_.update(relay->sockets[i], false, false);
+        sockets_.remove(relay->sockets[i]);
+    }
+    relays_.remove(relay->id);
+    closeRelaySockets(relay);
+    delete relay;
+}
+
+void SpliceRelay::closeRelaySockets(Relay *relay)
+{
+    for (int i = 0; i < 2; ++i)
+    {
+        close(relay->sockets[i]);
+        for (int fd : relay->dirs[i].pipe)
+        {
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+        }
+    }
+}
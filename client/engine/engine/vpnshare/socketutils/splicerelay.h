@@ -0,0 +1,96 @@
+#ifndef SPLICERELAY_H
+#define SPLICERELAY_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QTcpSocket>
+#include <QThread>
+
+#include <atomic>
+
+#include "utils/mpscqueue.h"
+#include "utils/socketpoller.h"
+
+// Zero-copy relay for the connections of the proxy sharing servers, Linux only.
+// When the handshake of a connection is done, takeOver() moves its two sockets here. One thread relays the data of all
+// the connections with splice() through a pipe for every direction, so the data does not come to user space. The pipe bounds
+// the data in flight: when the receiver is slow the pipe fills up and the sender is no longer read.
+// The end of the data is passed on with shutdown(SHUT_WR), a relay finishes when both directions are finished or on an error.
+class SpliceRelay : public QThread
+{
+    Q_OBJECT
+public:
+    explicit SpliceRelay(QObject *parent = nullptr);
+    virtual ~SpliceRelay();
+
+    // Called from the thread of the sockets. Returns 0 if the sockets can not be taken over right now: they are not connected
+    // or still have data to write (try again after bytesWritten). Otherwise the sockets are disconnected from all the receivers
+    // and closed, the relay continues with duplicates of their descriptors, starting with the data already read by the sockets.
+    quint64 takeOver(QTcpSocket *socket1, QTcpSocket *socket2);
+    // Can be called from any thread. Relays the connected nonblocking sockets and takes ownership of them,
+    // readFrom1 and readFrom2 is the data already read from the sockets.
+    quint64 add(int socket1, int socket2, const QByteArray &readFrom1 = QByteArray(), const QByteArray &readFrom2 = QByteArray());
+    // Can be called from any thread, closes the sockets of the relay.
+    void remove(quint64 relayId);
+    void finish();
+
+signals:
+    // emitted from the relay thread when the relay finished by itself
+    void relayFinished(quint64 relayId, qint64 bytes1to2, qint64 bytes2to1);
+
+protected:
+    void run() override;
+
+private:
+    static constexpr int kPipeSize = 256 * 1024;
+
+    struct Direction
+    {
+        int from;
+        int to;
+        int pipe[2];
+        int pipeSize;
+        int inPipe;
+        bool bPipeFull;         // the last read did not fit into the pipe, wait until it is drained a bit
+        QByteArray pending;     // goes before the data in the pipe
+        int pendingPos;
+        bool bEof;
+        bool bShutdown;
+        qint64 bytes;
+    };
+
+    struct Relay
+    {
+        quint64 id;
+        int sockets[2];
+        Direction dirs[2];      // dirs[i] reads from sockets[i]
+    };
+
+    struct Command
+    {
+        enum TYPE { ADD, REMOVE };
+        TYPE type;
+        Relay *relay;
+        quint64 relayId;
+    };
+
+    wsl::MpscQueue<Command> commands_;
+    std::atomic<bool> bFinish_;
+    std::atomic<quint64> nextRelayId_;
+    wsl::SocketPoller poller_;
+
+    // accessed only from the relay thread
+    QHash<quint64, Relay *> relays_;
+    QHash<int, Relay *> sockets_;
+
+    void processCommands();
+    void startRelay(Relay *relay);
+    void onSocketEvent(Relay *relay);
+    bool pump(Direction &dir);
+    void updatePoller(Relay *relay);
+    void removeRelay(Relay *relay);
+
+    static void closeRelaySockets(Relay *relay);
+};
+
+#endif // SPLICERELAY_H
@@ -4,14 +4,19 @@
 #include "utils/ws_assert.h"
 #include "utils/logger.h"
 
+#ifdef Q_OS_LINUX
+    #include "../socketutils/splicerelay.h"
+#endif
+
 namespace SocksProxyServer {
 
 
 SocksProxyConnection::SocksProxyConnection(qintptr socketDescriptor, const QString &hostname,
-                                           QObject *parent)
+                                           const ConnectionSettings &settings, QObject *parent)
     : QObject(parent), socket_(nullptr), socketExternal_(nullptr),
     socketDescriptor_(socketDescriptor), hostname_(hostname), state_(READ_IDENT_REQ),
-    writeAllSocket_(0), writeAllSocketExternal_(0), bAlreadyClosedAndEmitFinished_(false)
+    writeAllSocket_(0), writeAllSocketExternal_(0), settings_(settings), hostResolver_(nullptr), dnsRequestId_(0),
+    spliceRelay_(settings.spliceRelay), spliceRelayId_(0), bAlreadyClosedAndEmitFinished_(false)
 {
 }
 
@@ -23,11 +28,22 @@ void SocksProxyConnection::start()
     {
         return;
     }
-    state_ = READ_IDENT_REQ;
     readExactly_.reset(new SocksProxyReadExactly(sizeof(socks5_ident_req)));
     connect(socket_, SIGNAL(disconnected()), SLOT(onSocketDisconnected()));
     connect(socket_, SIGNAL(readyRead()), SLOT(onSocketReadyRead()));
     writeAllSocket_ = new SocketWriteAll(this, socket_);
+    hostResolver_ = new SocksProxyHostResolver(this, settings_.dnsCache, settings_.dnsServers);
+    connect(hostResolver_, &SocksProxyHostResolver::resolved, this, &SocksProxyConnection::onHostnameResolved);
+    if (!socketReadArr_.isEmpty())
+    {
+        onSocketReadyRead();
+    }
+}
+
+void SocksProxyConnection::setIdentReqDone(const QByteArray &commandData)
+{
+    state_ = READ_COMMANDS;
+    socketReadArr_ = commandData;
 }
 
 void SocksProxyConnection::forceClose()
@@ -43,6 +59,16 @@ void SocksProxyConnection::onSocketDisconnected()
 
 void SocksProxyConnection::onSocketReadyRead()
 {
+    if (state_ == RELAY_BETWEEN_CLIENT_SERVER)
+    {
+        // with the splice relay the data waits in the socket until the socket is taken over
+        if (!spliceRelay_)
+        {
+            writeAllSocketExternal_->relayFrom(socket_);
+        }
+        return;
+    }
+
     socketReadArr_.append(socket_->readAll());
 
     if (state_ == READ_IDENT_REQ)
@@ -127,23 +153,31 @@ void SocksProxyConnection::onSocketReadyRead()
                 }
                 else if (commandParser_.cmd().AddrType == 0x03)  // domain name
                 {
+                    // through the DnsCache of the server, connectToHost() would do an uncached lookup
                     std::string hostname(commandParser_.cmd().DestAddr.Domain, commandParser_.cmd().DestAddr.DomainLen);
-                    socketExternal_->connectToHost(QString::fromStdString(hostname), commandParser_.cmd().DestPort);
+                    dnsRequestId_ = hostResolver_->resolve(QString::fromStdString(hostname));
                 }
             }
-            else if (commandParser_.cmd().Cmd == 0x02)  // bind
-            {
-                WS_ASSERT(false);
-            }
             else if (commandParser_.cmd().Cmd == 0x03)  // udp associate
             {
-                WS_ASSERT(false);
+                udpAssociation_.reset(new SocksProxyUdpAssociation(this, hostResolver_, settings_.udpFlowIdleTimeoutMs));
+                if (udpAssociation_->start(socket_->localAddress(), socket_->peerAddress(), commandParser_.cmd().DestPort))
+                {
+                    // the association lives while this connection is open
+                    state_ = UDP_ASSOCIATE;
+                    writeAllSocket_->write(makeSocks5Resp(0x00, udpAssociation_->relayAddress(), udpAssociation_->relayPort()));
+                }
+                else
+                {
+                    udpAssociation_.reset();
+                    writeErrorReplyAndClose(0x01);  // general failure
+                }
             }
             else
             {
-                qCDebug(LOG_SOCKS_SERVER) << "SocksProxyConnection::onSocketReadyRead() unknown command:" << commandParser_.cmd().Cmd;
-                closeSocketsAndEmitFinished();
-                WS_ASSERT(false);
+                // bind is not supported either
+                qCDebug(LOG_SOCKS_SERVER) << "SocksProxyConnection::onSocketReadyRead() unsupported command:" << commandParser_.cmd().Cmd;
+                writeErrorReplyAndClose(0x07);  // command not supported
             }
         }
         else if (res == TRI_INDETERMINATE)
@@ -157,9 +191,9 @@ void SocksProxyConnection::onSocketReadyRead()
             WS_ASSERT(false);
         }
     }
-    else if (state_ == RELAY_BETWEEN_CLIENT_SERVER)
+    else if (state_ == UDP_ASSOCIATE || state_ == WRITE_ERROR_REPLY)
     {
-        writeAllSocketExternal_->write(socketReadArr_);
+        // nothing is expected from the client
         socketReadArr_.clear();
     }
     else
@@ -186,7 +220,20 @@ void SocksProxyConnection::onExternalSocketConnected()
         //resp.BindPort = 0x00;
         //memset(&resp.BindAddr.IPv4, 0, sizeof(resp.BindAddr.IPv4));
         writeAllSocket_->write(getByteArrayFromSocks5Resp(resp));
+        // the data which the client sent right after the command
+        if (!socketReadArr_.isEmpty())
+        {
+            writeAllSocketExternal_->write(socketReadArr_);
+            socketReadArr_.clear();
+        }
         state_ = RELAY_BETWEEN_CLIENT_SERVER;
+
+        if (spliceRelay_)
+        {
+            // the sockets are taken over by the splice relay as soon as they have written everything
+            connect(socket_, &QTcpSocket::bytesWritten, this, &SocksProxyConnection::startSpliceRelay);
+            connect(socketExternal_, &QTcpSocket::bytesWritten, this, &SocksProxyConnection::startSpliceRelay);
+        }
     }
     else
     {
@@ -210,10 +257,9 @@ void SocksProxyConnection::onExternalSocketDisconnected()
 
 void SocksProxyConnection::onExternalSocketReadyRead()
 {
-    QByteArray arr = socketExternal_->readAll();
-    if (state_ == RELAY_BETWEEN_CLIENT_SERVER)
+    if (state_ == RELAY_BETWEEN_CLIENT_SERVER && !spliceRelay_)
     {
-        writeAllSocket_->write(arr);
+        writeAllSocket_->relayFrom(socketExternal_);
     }
     /*else if (state_ == READ_HEADERS_FROM_WEBSERVER)
     {
@@ -249,9 +295,20 @@ void SocksProxyConnection::onExternalSocketReadyRead()
 
 void SocksProxyConnection::onExternalSocketError(QAbstractSocket::SocketError socketError)
 {
-    Q_UNUSED(socketError);
     if (state_ == CONNECT_TO_HOST)
     {
+        if (socketError == QAbstractSocket::ConnectionRefusedError)
+        {
+            writeErrorReplyAndClose(0x05);  // connection refused
+        }
+        else if (socketError == QAbstractSocket::NetworkError)
+        {
+            writeErrorReplyAndClose(0x03);  // network unreachable
+        }
+        else
+        {
+            writeErrorReplyAndClose(0x04);  // host unreachable
+        }
     }
     /*Q_UNUSED(socketError);
     if (state_ == CONNECTING_TO_EXTERNAL_SERVER)
@@ -263,11 +320,61 @@ void SocksProxyConnection::onExternalSocketError(QAbstractSocket::SocketError so
     }*/
 }
 
+void SocksProxyConnection::onHostnameResolved(quint64 id, bool bSuccess, const QStringList &ips)
+{
+    if (state_ != CONNECT_TO_HOST || id != dnsRequestId_)
+    {
+        return;
+    }
+    if (bSuccess && !ips.isEmpty())
+    {
+        socketExternal_->connectToHost(QHostAddress(ips.first()), commandParser_.cmd().DestPort);
+    }
+    else
+    {
+        qCDebug(LOG_SOCKS_SERVER) << "SocksProxyConnection::onHostnameResolved() can't resolve the hostname";
+        writeErrorReplyAndClose(0x04);  // host unreachable
+    }
+}
+
+void SocksProxyConnection::startSpliceRelay()
+{
+#ifdef Q_OS_LINUX
+    if (spliceRelay_ && spliceRelayId_ == 0 && !bAlreadyClosedAndEmitFinished_)
+    {
+        // connected beforehand, the relay may finish right away
+        connect(spliceRelay_, &SpliceRelay::relayFinished, this, &SocksProxyConnection::onSpliceRelayFinished, Qt::UniqueConnection);
+        spliceRelayId_ = spliceRelay_->takeOver(socket_, socketExternal_);
+        if (spliceRelayId_ == 0 && socket_->bytesToWrite() == 0 && socketExternal_->bytesToWrite() == 0)
+        {
+            // can't be taken over, relay through the Qt sockets
+            spliceRelay_ = nullptr;
+            writeAllSocketExternal_->relayFrom(socket_);
+            writeAllSocket_->relayFrom(socketExternal_);
+        }
+    }
+#endif
+}
+
+void SocksProxyConnection::onSpliceRelayFinished(quint64 relayId)
+{
+    if (relayId == spliceRelayId_)
+    {
+        closeSocketsAndEmitFinished();
+    }
+}
+
 void SocksProxyConnection::closeSocketsAndEmitFinished()
 {
     if (!bAlreadyClosedAndEmitFinished_)
     {
         bAlreadyClosedAndEmitFinished_ = true;
+#ifdef Q_OS_LINUX
+        if (spliceRelayId_ != 0)
+        {
+            spliceRelay_->remove(spliceRelayId_);
+        }
+#endif
         if (socket_)
         {
             socket_->close();
@@ -276,6 +383,7 @@ void SocksProxyConnection::closeSocketsAndEmitFinished()
         {
             socketExternal_->close();
         }
+        udpAssociation_.reset();
         emit finished(hostname_);
     }
 }
@@ -323,5 +431,34 @@ QByteArray SocksProxyConnection::getByteArrayFromSocks5Resp(const socks5_resp &r
     return arr;
 }
 
+QByteArray SocksProxyConnection::makeSocks5Resp(unsigned char reply, const QHostAddress &bindAddress, quint16 bindPort)
+{
+    socks5_resp resp;
+    memset(&resp, 0, sizeof(resp));
+    resp.Version = 0x05;
+    resp.Reply = reply;
+    if (bindAddress.protocol() == QAbstractSocket::IPv6Protocol)
+    {
+        resp.AddrType = 0x04;
+        const Q_IPV6ADDR ip6 = bindAddress.toIPv6Address();
+        memcpy(&resp.BindAddr.IPv6, &ip6, sizeof(resp.BindAddr.IPv6));
+    }
+    else
+    {
+        resp.AddrType = 0x01;
+        resp.BindAddr.IPv4.s_addr = htonl(bindAddress.toIPv4Address());
+    }
+    resp.BindPort = htons(bindPort);
+    return getByteArrayFromSocks5Resp(resp);
+}
+
+void SocksProxyConnection::writeErrorReplyAndClose(unsigned char reply)
+{
+    state_ = WRITE_ERROR_REPLY;
+    writeAllSocket_->write(makeSocks5Resp(reply, QHostAddress(quint32(0)), 0));
+    connect(writeAllSocket_, SIGNAL(allDataWriteFinished()), SLOT(closeSocketsAndEmitFinished()));
+    writeAllSocket_->setEmitAllDataWritten();
+}
+
 
 } // namespace SocksProxyServer
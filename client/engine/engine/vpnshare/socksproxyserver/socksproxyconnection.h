@@ -2,6 +2,7 @@
 #define SOCKSPROXYCONNECTION_H
 
 #include <QObject>
+#include <QStringList>
 #include <QTcpSocket>
 
 #include "socksstructs.h"
@@ -9,16 +10,32 @@
 #include "socksproxyidentreqparser.h"
 #include "../socketutils/socketwriteall.h"
 #include "socksproxycommandparser.h"
+#include "socksproxyhostresolver.h"
+#include "socksproxyudpassociation.h"
+
+class DnsCache;
+class SpliceRelay;
 
 namespace SocksProxyServer {
 
+// shared by all the connections of the server
+struct ConnectionSettings
+{
+    SpliceRelay *spliceRelay = nullptr;     // may be null, then the data is relayed through the Qt sockets
+    DnsCache *dnsCache = nullptr;           // lives in the thread of the server
+    QStringList dnsServers;                 // empty for the default ones
+    int udpFlowIdleTimeoutMs = SocksProxyUdpAssociation::kDefaultFlowIdleTimeoutMs;
+};
+
 class SocksProxyConnection : public QObject
 {
     Q_OBJECT
 public:
-    explicit SocksProxyConnection(qintptr socketDescriptor, const QString &hostname, QObject *parent = nullptr);
+    explicit SocksProxyConnection(qintptr socketDescriptor, const QString &hostname, const ConnectionSettings &settings, QObject *parent = nullptr);
 
     bool start(qintptr socketDescriptor);
+    // for a connection from the ProxyCore, which already answered the ident request and read the command
+    void setIdentReqDone(const QByteArray &commandData);
 
 public slots:
     void start();
@@ -37,6 +54,11 @@ private slots:
     void onExternalSocketDisconnected();
     void onExternalSocketReadyRead();
     void onExternalSocketError(QAbstractSocket::SocketError socketError);
+
+    void onHostnameResolved(quint64 id, bool bSuccess, const QStringList &ips);
+
+    void startSpliceRelay();
+    void onSpliceRelayFinished(quint64 relayId);
 private slots:
     void closeSocketsAndEmitFinished();
 private:
@@ -45,7 +67,7 @@ private:
     qintptr socketDescriptor_;
     QString hostname_;
 
-    enum { READ_IDENT_REQ, READ_COMMANDS, CONNECT_TO_HOST, RELAY_BETWEEN_CLIENT_SERVER } state_;
+    enum { READ_IDENT_REQ, READ_COMMANDS, CONNECT_TO_HOST, RELAY_BETWEEN_CLIENT_SERVER, UDP_ASSOCIATE, WRITE_ERROR_REPLY } state_;
 
     QByteArray socketReadArr_;
     SocketWriteAll *writeAllSocket_;
@@ -55,9 +77,19 @@ private:
     SocksProxyCommandParser commandParser_;
     QScopedPointer<SocksProxyReadExactly> readExactly_;
 
+    ConnectionSettings settings_;
+    SocksProxyHostResolver *hostResolver_;
+    quint64 dnsRequestId_;
+    QScopedPointer<SocksProxyUdpAssociation> udpAssociation_;
+
+    SpliceRelay *spliceRelay_;
+    quint64 spliceRelayId_;
+
     bool bAlreadyClosedAndEmitFinished_;
 
     QByteArray getByteArrayFromSocks5Resp(const socks5_resp &resp);
+    QByteArray makeSocks5Resp(unsigned char reply, const QHostAddress &bindAddress, quint16 bindPort);
+    void writeErrorReplyAndClose(unsigned char reply);
 
 };
 
@@ -3,12 +3,23 @@
 #include <QThread>
 #include <QTimer>
 #include "utils/ws_assert.h"
+#include "engine/networkaccessmanager/dnscache.h"
+
+#ifdef Q_OS_LINUX
+    #include "../socketutils/splicerelay.h"
+#endif
 
 namespace SocksProxyServer {
 
 SocksProxyConnectionManager::SocksProxyConnectionManager(QObject *parent, int threadsCount, ConnectedUsersCounter *usersCounter) : QObject(parent),
-    usersCounter_(usersCounter)
+    usersCounter_(usersCounter), spliceRelay_(nullptr)
 {
+#ifdef Q_OS_LINUX
+    spliceRelay_ = new SpliceRelay(this);
+#endif
+    dnsCache_ = new DnsCache(this);
+    settings_.spliceRelay = spliceRelay_;
+    settings_.dnsCache = dnsCache_;
     WS_ASSERT(threadsCount > 0);
     for (int i = 0; i < threadsCount; i++)
     {
@@ -18,7 +29,7 @@ SocksProxyConnectionManager::SocksProxyConnectionManager(QObject *parent, int th
     }
 }
 
-void SocksProxyConnectionManager::newConnection(qintptr socketDescriptor)
+void SocksProxyConnectionManager::newConnection(qintptr socketDescriptor, const QByteArray &commandData)
 {
 #ifdef Q_OS_WIN
     SOCKADDR_IN  addr = {0};
@@ -32,12 +43,26 @@ void SocksProxyConnectionManager::newConnection(qintptr socketDescriptor)
     usersCounter_->newUserConnected(ip);
 
     QThread *thread = getLessBusyThread();
-    SocksProxyConnection *connection = new SocksProxyConnection(socketDescriptor, ip);
+    SocksProxyConnection *connection = new SocksProxyConnection(socketDescriptor, ip, settings_);
+    if (!commandData.isEmpty())
+    {
+        connection->setIdentReqDone(commandData);
+    }
     connect(connection, SIGNAL(finished(QString)), SLOT(onConnectionFinished(QString)));
     addConnectionToThread(thread, connection);
     //qCDebug(LOG_SOCKS_SERVER) << "Count of connections:" << connections_.count();
 }
 
+void SocksProxyConnectionManager::setDnsServers(const QStringList &dnsServers)
+{
+    settings_.dnsServers = dnsServers;
+}
+
+void SocksProxyConnectionManager::setUdpFlowIdleTimeout(int timeoutMs)
+{
+    settings_.udpFlowIdleTimeoutMs = timeoutMs;
+}
+
 void SocksProxyConnectionManager::closeAllConnections()
 {
     for(auto c : connections_.keys())
@@ -15,7 +15,11 @@ public:
     explicit SocksProxyConnectionManager(QObject *parent, int threadsCount, ConnectedUsersCounter *usersCounter);
 
 public:
-    void newConnection(qintptr socketDescriptor);
+    // commandData is not empty for a connection from the ProxyCore, see SocksProxyConnection::setIdentReqDone()
+    void newConnection(qintptr socketDescriptor, const QByteArray &commandData = QByteArray());
+    // apply to the new connections
+    void setDnsServers(const QStringList &dnsServers);
+    void setUdpFlowIdleTimeout(int timeoutMs);
     void closeAllConnections();
     void stop();
 
@@ -26,6 +30,9 @@ private:
     QMap<QThread *, quint32> threads_;
     QMap<SocksProxyConnection *, QThread *> connections_;
     ConnectedUsersCounter *usersCounter_;
+    SpliceRelay *spliceRelay_;      // null if not supported
+    DnsCache *dnsCache_;            // shared by the connections, lives in the thread of the manager
+    ConnectionSettings settings_;
 
     QThread *getLessBusyThread();
     void addConnectionToThread(QThread *thread, SocksProxyConnection *connection);
@@ -0,0 +1,43 @@
+#include "socksproxyhostresolver.h"
+
+#include <atomic>
+
+#include "engine/networkaccessmanager/dnscache.h"
+
+namespace SocksProxyServer {
+
+namespace {
+// the DnsCache is shared by all the connections, the ids must be unique among them
+std::atomic<quint64> g_nextRequestId(1);
+}
+
+SocksProxyHostResolver::SocksProxyHostResolver(QObject *parent, DnsCache *dnsCache, const QStringList &dnsServers) : QObject(parent),
+    dnsCache_(dnsCache), dnsServers_(dnsServers)
+{
+    // queued, the DnsCache lives in another thread
+    connect(dnsCache_, &DnsCache::resolved, this, &SocksProxyHostResolver::onDnsCacheResolved);
+}
+
+quint64 SocksProxyHostResolver::resolve(const QString &hostname)
+{
+    const quint64 id = g_nextRequestId++;
+    requestIds_.insert(id);
+    DnsCache *dnsCache = dnsCache_;
+    const QStringList dnsServers = dnsServers_;
+    QMetaObject::invokeMethod(dnsCache_, [dnsCache, hostname, id, dnsServers]() {
+        dnsCache->resolve(hostname, id, false, dnsServers);
+    }, Qt::QueuedConnection);
+    return id;
+}
+
+void SocksProxyHostResolver::onDnsCacheResolved(bool success, const QStringList &ips, quint64 id, bool bFromCache, int timeMs)
+{
+    Q_UNUSED(bFromCache);
+    Q_UNUSED(timeMs);
+    if (requestIds_.remove(id))
+    {
+        emit resolved(id, success, ips);
+    }
+}
+
+} // namespace SocksProxyServer
@@ -0,0 +1,37 @@
+#ifndef SOCKSPROXYHOSTRESOLVER_H
+#define SOCKSPROXYHOSTRESOLVER_H
+
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+
+class DnsCache;
+
+namespace SocksProxyServer {
+
+// Resolves the hostnames for a connection through the DnsCache of the server, which lives in the thread of the server.
+// The DnsCache answers from its cache and coalesces the lookups of the same hostname made by all the connections.
+class SocksProxyHostResolver : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SocksProxyHostResolver(QObject *parent, DnsCache *dnsCache, const QStringList &dnsServers);
+
+    // returns the id of the request, the answer comes with the resolved signal
+    quint64 resolve(const QString &hostname);
+
+signals:
+    void resolved(quint64 id, bool bSuccess, const QStringList &ips);
+
+private slots:
+    void onDnsCacheResolved(bool success, const QStringList &ips, quint64 id, bool bFromCache, int timeMs);
+
+private:
+    DnsCache *dnsCache_;
+    QStringList dnsServers_;
+    QSet<quint64> requestIds_;
+};
+
+} // namespace SocksProxyServer
+
+#endif // SOCKSPROXYHOSTRESOLVER_H
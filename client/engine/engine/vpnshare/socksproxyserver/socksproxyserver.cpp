@@ -2,6 +2,10 @@
 #include "utils/ws_assert.h"
 #include "utils/logger.h"
 
+#ifdef Q_OS_LINUX
+    #include "../proxycore/proxycore.h"
+#endif
+
 namespace SocksProxyServer {
 
 SocksProxyServer::SocksProxyServer(QObject *parent) : QTcpServer(parent)
@@ -9,6 +13,12 @@ SocksProxyServer::SocksProxyServer(QObject *parent) : QTcpServer(parent)
     usersCounter_ = new ConnectedUsersCounter(this);
     connect(usersCounter_, SIGNAL(usersCountChanged()), SIGNAL(usersCountChanged()));
     connectionManager_ = new SocksProxyConnectionManager(this, 4, usersCounter_);
+#ifdef Q_OS_LINUX
+    proxyCore_ = new ProxyCore(this, ProxyReactor::SOCKS5, usersCounter_);
+    connect(proxyCore_, &ProxyCore::connectionHandedOff, this, [this](qintptr socketDescriptor, const QByteArray &readData) {
+        connectionManager_->newConnection(socketDescriptor, readData);
+    });
+#endif
 }
 
 SocksProxyServer::~SocksProxyServer()
@@ -20,9 +30,14 @@ bool SocksProxyServer::startServer(quint16 port)
 {
     WS_ASSERT(!isListening());
 
-    if (listen(QHostAddress::AnyIPv4, port))
+#ifdef Q_OS_LINUX
+    const bool bStarted = proxyCore_->start(port);
+#else
+    const bool bStarted = listen(QHostAddress::AnyIPv4, port);
+#endif
+    if (bStarted)
     {
-        qCDebug(LOG_SOCKS_SERVER) << "Socks proxy server started on port" << serverPort();
+        qCDebug(LOG_SOCKS_SERVER) << "Socks proxy server started on port" << this->port();
         return true;
     }
     else
@@ -34,6 +49,13 @@ bool SocksProxyServer::startServer(quint16 port)
 
 void SocksProxyServer::stopServer()
 {
+#ifdef Q_OS_LINUX
+    if (proxyCore_->isStarted())
+    {
+        qCDebug(LOG_SOCKS_SERVER) << "Socks proxy server stopped on port" << proxyCore_->port();
+        proxyCore_->stop();
+    }
+#endif
     if (isListening())
     {
         qCDebug(LOG_SOCKS_SERVER) << "Socks proxy server stopped on port" << serverPort();
@@ -42,6 +64,15 @@ void SocksProxyServer::stopServer()
     connectionManager_->stop();
 }
 
+quint16 SocksProxyServer::port() const
+{
+#ifdef Q_OS_LINUX
+    return proxyCore_->port();
+#else
+    return serverPort();
+#endif
+}
+
 int SocksProxyServer::getConnectedUsersCount()
 {
     return usersCounter_->getConnectedUsersCount();
@@ -49,9 +80,25 @@ int SocksProxyServer::getConnectedUsersCount()
 
 void SocksProxyServer::closeActiveConnections()
 {
+#ifdef Q_OS_LINUX
+    proxyCore_->closeAllConnections();
+#endif
     connectionManager_->closeAllConnections();
 }
 
+void SocksProxyServer::setDnsServers(const QStringList &dnsServers)
+{
+    connectionManager_->setDnsServers(dnsServers);
+#ifdef Q_OS_LINUX
+    proxyCore_->setDnsServers(dnsServers);
+#endif
+}
+
+void SocksProxyServer::setUdpFlowIdleTimeout(int timeoutMs)
+{
+    connectionManager_->setUdpFlowIdleTimeout(timeoutMs);
+}
+
 void SocksProxyServer::incomingConnection(qintptr socketDescriptor)
 {
     connectionManager_->newConnection(socketDescriptor);
@@ -6,6 +6,8 @@
 
 #include <QTcpServer>
 
+class ProxyCore;
+
 namespace SocksProxyServer {
 
 class SocksProxyServer : public QTcpServer
@@ -17,11 +19,16 @@ public:
 
     bool startServer(quint16 port);
     void stopServer();
+    quint16 port() const;
 
     int getConnectedUsersCount();
 
     void closeActiveConnections();
 
+    // the DNS servers for the hostnames of the clients (the system ones if empty)
+    void setDnsServers(const QStringList &dnsServers);
+    void setUdpFlowIdleTimeout(int timeoutMs);
+
 signals:
     void usersCountChanged();
 
@@ -32,6 +39,9 @@ protected:
 private:
     SocksProxyConnectionManager *connectionManager_;
     ConnectedUsersCounter *usersCounter_;
+#ifdef Q_OS_LINUX
+    ProxyCore *proxyCore_;      // elsewhere the server listens itself
+#endif
 };
 
 
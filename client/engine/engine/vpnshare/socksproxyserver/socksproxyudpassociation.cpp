@@ -0,0 +1,267 @@
+#include "socksproxyudpassociation.h"
+
+#include <QtEndian>
+#include "utils/logger.h"
+
+namespace SocksProxyServer {
+
+SocksProxyUdpAssociation::SocksProxyUdpAssociation(QObject *parent, SocksProxyHostResolver *hostResolver, int flowIdleTimeoutMs) : QObject(parent),
+    hostResolver_(hostResolver), flowIdleTimeoutMs_(flowIdleTimeoutMs), clientPort_(0), waitingForDnsCount_(0)
+{
+    clock_.start();
+    connect(&relaySocket_, &QUdpSocket::readyRead, this, &SocksProxyUdpAssociation::onRelaySocketReadyRead);
+    connect(&outboundSocket_, &QUdpSocket::readyRead, this, &SocksProxyUdpAssociation::onOutboundSocketReadyRead);
+    connect(hostResolver_, &SocksProxyHostResolver::resolved, this, &SocksProxyUdpAssociation::onHostnameResolved);
+    connect(&flowsTimer_, &QTimer::timeout, this, &SocksProxyUdpAssociation::onFlowsTimer);
+}
+
+bool SocksProxyUdpAssociation::start(const QHostAddress &localAddress, const QHostAddress &clientAddress, quint16 clientPort)
+{
+    clientAddress_ = normalized(clientAddress);
+    clientPort_ = clientPort;
+    if (!relaySocket_.bind(normalized(localAddress), 0))
+    {
+        qCDebug(LOG_SOCKS_SERVER) << "SocksProxyUdpAssociation::start(), can't bind the relay socket:" << relaySocket_.errorString();
+        return false;
+    }
+    // both IPv4 and IPv6 destinations
+    if (!outboundSocket_.bind(QHostAddress::Any, 0))
+    {
+        qCDebug(LOG_SOCKS_SERVER) << "SocksProxyUdpAssociation::start(), can't bind the outbound socket:" << outboundSocket_.errorString();
+        return false;
+    }
+    flowsTimer_.start(qMax(flowIdleTimeoutMs_ / 2, 100));
+    return true;
+}
+
+QHostAddress SocksProxyUdpAssociation::relayAddress() const
+{
+    return relaySocket_.localAddress();
+}
+
+quint16 SocksProxyUdpAssociation::relayPort() const
+{
+    return relaySocket_.localPort();
+}
+
+int SocksProxyUdpAssociation::flowsCount() const
+{
+    return flows_.count();
+}
+
+bool SocksProxyUdpAssociation::parseDatagram(const QByteArray &datagram, Destination &outDestination, int &outDataOffset)
+{
+    const uchar *p = (const uchar *)datagram.constData();
+    const int size = datagram.size();
+    // RSV and FRAG
+    if (size < 4 || p[0] != 0 || p[1] != 0 || p[2] != 0)
+    {
+        return false;
+    }
+
+    int pos = 4;
+    if (p[3] == 0x01)  // ip4
+    {
+        if (size < pos + 4)
+        {
+            return false;
+        }
+        outDestination.address = QHostAddress(qFromBigEndian<quint32>(p + pos));
+        pos += 4;
+    }
+    else if (p[3] == 0x04)  // ip6
+    {
+        if (size < pos + 16)
+        {
+            return false;
+        }
+        outDestination.address = QHostAddress(p + pos);
+        pos += 16;
+    }
+    else if (p[3] == 0x03)  // domain name
+    {
+        if (size < pos + 1 || p[pos] == 0 || size < pos + 1 + p[pos])
+        {
+            return false;
+        }
+        outDestination.hostname = QString::fromLatin1((const char *)p + pos + 1, p[pos]);
+        pos += 1 + p[pos];
+        QHostAddress address;
+        if (address.setAddress(outDestination.hostname))
+        {
+            outDestination.address = address;
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    if (size < pos + 2)
+    {
+        return false;
+    }
+    outDestination.port = qFromBigEndian<quint16>(p + pos);
+    outDataOffset = pos + 2;
+    return true;
+}
+
+QByteArray SocksProxyUdpAssociation::makeDatagram(const QHostAddress &address, quint16 port, const QByteArray &data)
+{
+    QByteArray datagram(4, 0);
+    if (address.protocol() == QAbstractSocket::IPv4Protocol)
+    {
+        datagram[3] = 0x01;
+        uchar ip4[4];
+        qToBigEndian<quint32>(address.toIPv4Address(), ip4);
+        datagram.append((const char *)ip4, sizeof(ip4));
+    }
+    else
+    {
+        datagram[3] = 0x04;
+        const Q_IPV6ADDR ip6 = address.toIPv6Address();
+        datagram.append((const char *)&ip6, sizeof(ip6));
+    }
+    uchar portBytes[2];
+    qToBigEndian<quint16>(port, portBytes);
+    datagram.append((const char *)portBytes, sizeof(portBytes));
+    datagram.append(data);
+    return datagram;
+}
+
+void SocksProxyUdpAssociation::onRelaySocketReadyRead()
+{
+    while (relaySocket_.hasPendingDatagrams())
+    {
+        QByteArray datagram(qMax<qint64>(relaySocket_.pendingDatagramSize(), 0), Qt::Uninitialized);
+        QHostAddress sender;
+        quint16 senderPort;
+        const qint64 size = relaySocket_.readDatagram(datagram.data(), datagram.size(), &sender, &senderPort);
+        if (size < 0)
+        {
+            break;
+        }
+        datagram.resize(size);
+
+        // only the client of the association may use the relay
+        if (normalized(sender) != clientAddress_ || (clientPort_ != 0 && senderPort != clientPort_))
+        {
+            continue;
+        }
+        Destination destination;
+        int dataOffset;
+        if (!parseDatagram(datagram, destination, dataOffset))
+        {
+            continue;
+        }
+        clientPort_ = senderPort;
+
+        const QByteArray data = datagram.mid(dataOffset);
+        if (!destination.address.isNull())
+        {
+            sendToDestination(destination.address, destination.port, data);
+        }
+        else if (waitingForDnsCount_ < kMaxDatagramsWaitingForDns)
+        {
+            const quint64 id = hostResolver_->resolve(destination.hostname);
+            waitingForDns_[id] << WaitingDatagram { destination.port, data };
+            waitingForDnsCount_++;
+        }
+    }
+}
+
+void SocksProxyUdpAssociation::onOutboundSocketReadyRead()
+{
+    while (outboundSocket_.hasPendingDatagrams())
+    {
+        QByteArray data(qMax<qint64>(outboundSocket_.pendingDatagramSize(), 0), Qt::Uninitialized);
+        QHostAddress sender;
+        quint16 senderPort;
+        const qint64 size = outboundSocket_.readDatagram(data.data(), data.size(), &sender, &senderPort);
+        if (size < 0)
+        {
+            break;
+        }
+        data.resize(size);
+
+        // only the answers from the destinations of the client
+        const Endpoint endpoint(normalized(sender), senderPort);
+        auto it = flows_.find(endpoint);
+        if (it == flows_.end())
+        {
+            continue;
+        }
+        const qint64 now = clock_.elapsed();
+        if (now - it.value() > flowIdleTimeoutMs_)
+        {
+            flows_.erase(it);
+            continue;
+        }
+        it.value() = now;
+        relaySocket_.writeDatagram(makeDatagram(endpoint.first, endpoint.second, data), clientAddress_, clientPort_);
+    }
+}
+
+void SocksProxyUdpAssociation::onHostnameResolved(quint64 id, bool bSuccess, const QStringList &ips)
+{
+    auto it = waitingForDns_.find(id);
+    if (it == waitingForDns_.end())
+    {
+        return;
+    }
+    const QList<WaitingDatagram> datagrams = it.value();
+    waitingForDns_.erase(it);
+    waitingForDnsCount_ -= datagrams.count();
+
+    if (!bSuccess || ips.isEmpty())
+    {
+        return;
+    }
+    const QHostAddress address(ips.first());
+    for (const WaitingDatagram &datagram : datagrams)
+    {
+        sendToDestination(address, datagram.port, datagram.data);
+    }
+}
+
+void SocksProxyUdpAssociation::onFlowsTimer()
+{
+    const qint64 now = clock_.elapsed();
+    for (auto it = flows_.begin(); it != flows_.end(); )
+    {
+        if (now - it.value() > flowIdleTimeoutMs_)
+        {
+            it = flows_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void SocksProxyUdpAssociation::sendToDestination(const QHostAddress &address, quint16 port, const QByteArray &data)
+{
+    const Endpoint endpoint(normalized(address), port);
+    auto it = flows_.find(endpoint);
+    if (it == flows_.end())
+    {
+        if (flows_.count() >= kMaxFlows)
+        {
+            return;
+        }
+        it = flows_.insert(endpoint, 0);
+    }
+    it.value() = clock_.elapsed();
+    outboundSocket_.writeDatagram(data, endpoint.first, endpoint.second);
+}
+
+QHostAddress SocksProxyUdpAssociation::normalized(const QHostAddress &address)
+{
+    // the dual-stack outbound socket sees IPv4 senders as IPv4-mapped IPv6 addresses
+    bool bIsIPv4 = false;
+    const quint32 ip4 = address.toIPv4Address(&bIsIPv4);
+    return bIsIPv4 ? QHostAddress(ip4) : address;
+}
+
+} // namespace SocksProxyServer
@@ -0,0 +1,82 @@
+#ifndef SOCKSPROXYUDPASSOCIATION_H
+#define SOCKSPROXYUDPASSOCIATION_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostAddress>
+#include <QObject>
+#include <QPair>
+#include <QTimer>
+#include <QUdpSocket>
+
+#include "socksproxyhostresolver.h"
+
+namespace SocksProxyServer {
+
+// UDP relay of a SOCKS5 UDP ASSOCIATE command (RFC 1928, section 7), lives as long as the TCP connection of the command.
+// The client sends the datagrams with the SOCKS header to the relay socket, they go to the destinations from the outbound
+// socket. The answers come back with the header only from the destinations in the flow table, a flow expires after
+// flowIdleTimeoutMs without datagrams in either direction. Hostnames are resolved with the resolver of the connection.
+class SocksProxyUdpAssociation : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr int kDefaultFlowIdleTimeoutMs = 60000;
+    static constexpr int kMaxFlows = 1024;
+    static constexpr int kMaxDatagramsWaitingForDns = 64;
+
+    struct Destination
+    {
+        QHostAddress address;   // null if the destination is a hostname
+        QString hostname;
+        quint16 port = 0;
+    };
+
+    explicit SocksProxyUdpAssociation(QObject *parent, SocksProxyHostResolver *hostResolver, int flowIdleTimeoutMs);
+
+    // Binds the relay socket to localAddress (the address which the client connected to). The datagrams are accepted only from
+    // clientAddress (the address of the TCP connection) and clientPort, or from the port of the first one if clientPort is 0.
+    bool start(const QHostAddress &localAddress, const QHostAddress &clientAddress, quint16 clientPort);
+    QHostAddress relayAddress() const;
+    quint16 relayPort() const;
+    int flowsCount() const;
+
+    // the header of the datagrams between the client and the relay, fragmented datagrams are not supported
+    static bool parseDatagram(const QByteArray &datagram, Destination &outDestination, int &outDataOffset);
+    static QByteArray makeDatagram(const QHostAddress &address, quint16 port, const QByteArray &data);
+
+private slots:
+    void onRelaySocketReadyRead();
+    void onOutboundSocketReadyRead();
+    void onHostnameResolved(quint64 id, bool bSuccess, const QStringList &ips);
+    void onFlowsTimer();
+
+private:
+    typedef QPair<QHostAddress, quint16> Endpoint;
+
+    struct WaitingDatagram
+    {
+        quint16 port;
+        QByteArray data;
+    };
+
+    SocksProxyHostResolver *hostResolver_;
+    const int flowIdleTimeoutMs_;
+    QUdpSocket relaySocket_;
+    QUdpSocket outboundSocket_;
+    QHostAddress clientAddress_;
+    quint16 clientPort_;
+
+    QHash<Endpoint, qint64> flows_;                         // the time of the last datagram
+    QHash<quint64, QList<WaitingDatagram> > waitingForDns_; // by the id of the resolver request
+    int waitingForDnsCount_;
+    QTimer flowsTimer_;
+    QElapsedTimer clock_;
+
+    void sendToDestination(const QHostAddress &address, quint16 port, const QByteArray &data);
+    static QHostAddress normalized(const QHostAddress &address);
+};
+
+} // namespace SocksProxyServer
+
+#endif // SOCKSPROXYUDPASSOCIATION_H
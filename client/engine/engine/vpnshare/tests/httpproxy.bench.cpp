@@ -0,0 +1,652 @@
+#include <QtTest>
+#include <QTcpServer>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "engine/vpnshare/connecteduserscounter.h"
+#include "engine/vpnshare/httpproxyserver/httpproxyconnectionmanager.h"
+
+namespace {
+
+// the resources of a page: the document, the styles, the scripts, the images
+const char *kPageResources[] = { "/length/2048", "/chunked/16384", "/length/512", "/length/32768", "/chunked/1024", "/length/128" };
+
+qint64 nowUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return qint64(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+int listenLocal(quint16 *outPort)
+{
+    int s = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(s, (struct sockaddr *)&addr, len) != 0 || listen(s, 128) != 0 || getsockname(s, (struct sockaddr *)&addr, &len) != 0)
+    {
+        close(s);
+        return -1;
+    }
+    *outPort = ntohs(addr.sin_port);
+    return s;
+}
+
+int connectLocal(quint16 port)
+{
+    int s = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (::connect(s, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(s);
+        return -1;
+    }
+    // nothing waits forever if the proxy misbehaves
+    struct timeval tv = { 10, 0 };
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return s;
+}
+
+bool writeAll(int s, const QByteArray &data)
+{
+    qint64 offset = 0;
+    while (offset < data.size())
+    {
+        const ssize_t n = send(s, data.constData() + offset, data.size() - offset, MSG_NOSIGNAL);
+        if (n <= 0)
+        {
+            return false;
+        }
+        offset += n;
+    }
+    return true;
+}
+
+bool readMore(int s, QByteArray &buf)
+{
+    char data[64 * 1024];
+    const ssize_t n = recv(s, data, sizeof(data), 0);
+    if (n <= 0)
+    {
+        return false;
+    }
+    buf.append(data, n);
+    return true;
+}
+
+bool readExactly(int s, QByteArray &buf, int size)
+{
+    while (buf.size() < size)
+    {
+        if (!readMore(s, buf))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// the headers without the final empty line, or empty on the end of the connection
+QByteArray readHead(int s, QByteArray &buf)
+{
+    int end;
+    while ((end = buf.indexOf("\r\n\r\n")) < 0)
+    {
+        if (!readMore(s, buf))
+        {
+            return QByteArray();
+        }
+    }
+    const QByteArray head = buf.left(end);
+    buf.remove(0, end + 4);
+    return head;
+}
+
+qint64 contentLength(const QByteArray &lowerHead)
+{
+    const int pos = lowerHead.indexOf("\r\ncontent-length:");
+    if (pos < 0)
+    {
+        return -1;
+    }
+    const int start = pos + strlen("\r\ncontent-length:");
+    int end = lowerHead.indexOf("\r\n", start);
+    if (end < 0)
+    {
+        end = lowerHead.size();
+    }
+    return lowerHead.mid(start, end - start).trimmed().toLongLong();
+}
+
+QByteArray makePayload(int size)
+{
+    QByteArray payload(size, Qt::Uninitialized);
+    for (int i = 0; i < size; ++i)
+    {
+        payload[i] = 'a' + i % 26;
+    }
+    return payload;
+}
+
+// The local web server, HTTP/1.1 with keep-alive, a thread per connection. The path tells the answer:
+// /length/N and /chunked/N are N bytes with a Content-Length or in chunks, /close/N ends with the connection,
+// /echo answers with the body of the request.
+class HttpBackend
+{
+public:
+    HttpBackend() : listenSocket_(listenLocal(&port_)), connectionsCount_(0), bStop_(false)
+    {
+        acceptThread_ = std::thread([this]() { acceptConnections(); });
+    }
+    ~HttpBackend()
+    {
+        bStop_ = true;
+        shutdown(listenSocket_, SHUT_RDWR);
+        acceptThread_.join();
+        for (int s : sockets_)
+        {
+            shutdown(s, SHUT_RDWR);
+        }
+        for (std::thread &thread : threads_)
+        {
+            thread.join();
+        }
+        for (int s : sockets_)
+        {
+            close(s);
+        }
+        close(listenSocket_);
+    }
+
+    quint16 port() const { return port_; }
+    int connectionsCount() const { return connectionsCount_; }
+
+private:
+    int listenSocket_;
+    quint16 port_;
+    std::atomic<int> connectionsCount_;
+    std::atomic<bool> bStop_;
+    std::thread acceptThread_;
+    std::vector<std::thread> threads_;
+    std::vector<int> sockets_;
+
+    void acceptConnections()
+    {
+        while (!bStop_)
+        {
+            const int s = accept4(listenSocket_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (s < 0)
+            {
+                if (errno == EINTR || errno == ECONNABORTED)
+                {
+                    continue;
+                }
+                break;
+            }
+            connectionsCount_++;
+            sockets_.push_back(s);
+            threads_.emplace_back([this, s]() { serve(s); });
+        }
+    }
+
+    void serve(int s)
+    {
+        QByteArray buf;
+        while (true)
+        {
+            const QByteArray head = readHead(s, buf);
+            if (head.isEmpty())
+            {
+                break;
+            }
+            const QList<QByteArray> requestLine = head.left(head.indexOf("\r\n")).split(' ');
+            const QByteArray method = requestLine.value(0);
+            const QByteArray path = requestLine.value(1);
+            const QByteArray lowerHead = head.toLower();
+            bool bClose = lowerHead.contains("\r\nconnection: close");
+
+            const qint64 bodySize = qMax(contentLength(lowerHead), (qint64)0);
+            if (!readExactly(s, buf, bodySize))
+            {
+                break;
+            }
+            const QByteArray body = buf.left(bodySize);
+            buf.remove(0, bodySize);
+
+            const QByteArray payload = makePayload(path.mid(path.lastIndexOf('/') + 1).toInt());
+            QByteArray answer;
+            if (path.startsWith("/echo"))
+            {
+                answer = "HTTP/1.1 200 OK\r\nContent-Length: " + QByteArray::number(body.size()) + "\r\n\r\n" + body;
+            }
+            else if (path.startsWith("/chunked/"))
+            {
+                answer = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+                for (int offset = 0; offset < payload.size(); offset += 4096)
+                {
+                    const QByteArray chunk = payload.mid(offset, 4096);
+                    answer += QByteArray::number(chunk.size(), 16) + "\r\n" + chunk + "\r\n";
+                }
+                answer += "0\r\n\r\n";
+            }
+            else if (path.startsWith("/close/"))
+            {
+                answer = "HTTP/1.1 200 OK\r\nConnection: close\r\n\r\n" + payload;
+                bClose = true;
+            }
+            else
+            {
+                answer = "HTTP/1.1 200 OK\r\nContent-Length: " + QByteArray::number(payload.size()) + "\r\n\r\n";
+                if (method != "HEAD")
+                {
+                    answer += payload;
+                }
+            }
+
+            if (!writeAll(s, answer) || bClose)
+            {
+                break;
+            }
+        }
+        // closed by the destructor, the fd stays reserved until then
+        shutdown(s, SHUT_RDWR);
+    }
+};
+
+struct Answer
+{
+    int status = 0;
+    QByteArray body;
+    bool bClose = false;        // the proxy closes the connection after this answer
+};
+
+// A blocking client of the proxy.
+class HttpClient
+{
+public:
+    explicit HttpClient(quint16 proxyPort) : socket_(connectLocal(proxyPort)) {}
+    ~HttpClient()
+    {
+        if (socket_ >= 0)
+        {
+            close(socket_);
+        }
+    }
+
+    static QByteArray request(quint16 backendPort, const QByteArray &method, const QByteArray &path, bool bKeepAlive,
+                              const QByteArray &body = QByteArray())
+    {
+        const QByteArray host = "127.0.0.1:" + QByteArray::number(backendPort);
+        QByteArray request = method + " http://" + host + path + " HTTP/1.1\r\nHost: " + host + "\r\n";
+        if (!bKeepAlive)
+        {
+            request += "Connection: close\r\n";
+        }
+        if (!body.isEmpty())
+        {
+            request += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+        }
+        return request + "\r\n" + body;
+    }
+
+    bool send(const QByteArray &data)
+    {
+        return socket_ >= 0 && writeAll(socket_, data);
+    }
+
+    bool readAnswer(bool bHead, Answer &answer)
+    {
+        const QByteArray head = readHead(socket_, buf_);
+        if (head.isEmpty())
+        {
+            return false;
+        }
+        const QByteArray lowerHead = head.toLower();
+        answer.status = head.mid(9, 3).toInt();
+        answer.bClose = lowerHead.contains("\r\nconnection: close");
+        answer.body.clear();
+
+        const qint64 length = contentLength(lowerHead);
+        if (bHead)
+        {
+            return true;
+        }
+        else if (lowerHead.contains("\r\ntransfer-encoding: chunked"))
+        {
+            while (true)
+            {
+                int end;
+                while ((end = buf_.indexOf("\r\n")) < 0)
+                {
+                    if (!readMore(socket_, buf_))
+                    {
+                        return false;
+                    }
+                }
+                const int size = buf_.left(end).split(';').first().toInt(nullptr, 16);
+                buf_.remove(0, end + 2);
+                if (!readExactly(socket_, buf_, size + 2))
+                {
+                    return false;
+                }
+                answer.body += buf_.left(size);
+                buf_.remove(0, size + 2);
+                if (size == 0)
+                {
+                    return true;
+                }
+            }
+        }
+        else if (length >= 0)
+        {
+            if (!readExactly(socket_, buf_, length))
+            {
+                return false;
+            }
+            answer.body = buf_.left(length);
+            buf_.remove(0, length);
+            return true;
+        }
+        // until the end of the connection
+        while (readMore(socket_, buf_))
+        {
+        }
+        answer.body = buf_;
+        buf_.clear();
+        return true;
+    }
+
+    // true if the proxy has closed the connection, with nothing more to read
+    bool isClosedByProxy()
+    {
+        return buf_.isEmpty() && !readMore(socket_, buf_);
+    }
+
+private:
+    int socket_;
+    QByteArray buf_;
+};
+
+// The proxy server without the ProxyCore, to choose the options of the connection manager.
+class ProxyListener : public QTcpServer
+{
+public:
+    explicit ProxyListener(HttpProxyServer::HttpProxyConnectionManager *manager) : manager_(manager) {}
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override
+    {
+        manager_->newConnection(socketDescriptor);
+    }
+
+private:
+    HttpProxyServer::HttpProxyConnectionManager *manager_;
+};
+
+// runs the blocking clients in their threads while the event loop of the proxy runs
+void runClients(int count, const std::function<void(int)> &client)
+{
+    std::atomic<int> doneCount(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < count; ++i)
+    {
+        threads.emplace_back([&client, &doneCount, i]() {
+            client(i);
+            doneCount++;
+        });
+    }
+    while (doneCount < count)
+    {
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+} // namespace
+
+// The plain HTTP requests through HttpProxyConnection: the framing of the answers and of the pipelined requests on a
+// persistent client connection, the upstream pool, and page-load style sequences of requests against a local web server.
+// Reports the requests/s with a connection per request and no upstream pool, as before the keep-alive support, and with
+// keep-alive and the pool.
+class BenchHttpProxy : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testFraming_data();
+    void testFraming();
+    void testPipelining();
+    void testUpstreamPool_data();
+    void testUpstreamPool();
+    void benchmark_page_load_data();
+    void benchmark_page_load();
+
+private:
+    static constexpr int kThreadsCount = 4;
+    static constexpr int kParallelConnections = 6;
+    static constexpr int kRequestsPerConnection = 500;
+};
+
+void BenchHttpProxy::testFraming_data()
+{
+    QTest::addColumn<QByteArray>("method");
+    QTest::addColumn<QByteArray>("path");
+    QTest::addColumn<QByteArray>("body");
+    QTest::addColumn<QByteArray>("expectedBody");
+    QTest::addColumn<bool>("bServerCloses");
+
+    const QByteArray post = makePayload(50000);
+    QTest::newRow("content-length") << QByteArray("GET") << QByteArray("/length/100000") << QByteArray() << makePayload(100000) << false;
+    QTest::newRow("chunked") << QByteArray("GET") << QByteArray("/chunked/100000") << QByteArray() << makePayload(100000) << false;
+    QTest::newRow("empty") << QByteArray("GET") << QByteArray("/length/0") << QByteArray() << QByteArray() << false;
+    QTest::newRow("head") << QByteArray("HEAD") << QByteArray("/length/1000") << QByteArray() << QByteArray() << false;
+    QTest::newRow("post") << QByteArray("POST") << QByteArray("/echo") << post << post << false;
+    QTest::newRow("until close") << QByteArray("GET") << QByteArray("/close/5000") << QByteArray() << makePayload(5000) << true;
+}
+
+void BenchHttpProxy::testFraming()
+{
+    QFETCH(QByteArray, method);
+    QFETCH(QByteArray, path);
+    QFETCH(QByteArray, body);
+    QFETCH(QByteArray, expectedBody);
+    QFETCH(bool, bServerCloses);
+
+    HttpBackend backend;
+    ConnectedUsersCounter usersCounter(nullptr);
+    HttpProxyServer::HttpProxyConnectionManager manager(nullptr, 1, &usersCounter);
+    ProxyListener listener(&manager);
+    QVERIFY(listener.listen(QHostAddress::LocalHost));
+
+    // the same request twice on the same connection, unless the answer ends with the connection
+    Answer answers[2];
+    bool bOk[2] = { false, false };
+    bool bClosed = false;
+    runClients(1, [&](int) {
+        HttpClient client(listener.serverPort());
+        for (int i = 0; i < 2; ++i)
+        {
+            bOk[i] = client.send(HttpClient::request(backend.port(), method, path, true, body)) &&
+                     client.readAnswer(method == "HEAD", answers[i]);
+            if (!bOk[i] || answers[i].bClose)
+            {
+                break;
+            }
+        }
+        bClosed = client.isClosedByProxy();
+    });
+
+    QVERIFY(bOk[0]);
+    QCOMPARE(answers[0].status, 200);
+    QCOMPARE(answers[0].body.size(), expectedBody.size());
+    QVERIFY(answers[0].body == expectedBody);
+    QCOMPARE(answers[0].bClose, bServerCloses);
+    if (bServerCloses)
+    {
+        QVERIFY(bClosed);
+    }
+    else
+    {
+        QVERIFY(bOk[1]);
+        QVERIFY(answers[1].body == expectedBody);
+        QCOMPARE(backend.connectionsCount(), 1);
+    }
+    manager.stop();
+}
+
+void BenchHttpProxy::testPipelining()
+{
+    HttpBackend backend;
+    ConnectedUsersCounter usersCounter(nullptr);
+    HttpProxyServer::HttpProxyConnectionManager manager(nullptr, 1, &usersCounter);
+    ProxyListener listener(&manager);
+    QVERIFY(listener.listen(QHostAddress::LocalHost));
+
+    // sent at once, answered in order
+    const QList<int> sizes = { 10, 20000, 30 };
+    QVector<Answer> answers(sizes.size());
+    bool bOk = true;
+    runClients(1, [&](int) {
+        HttpClient client(listener.serverPort());
+        bOk = client.send(HttpClient::request(backend.port(), "GET", "/length/10", true) +
+                          HttpClient::request(backend.port(), "GET", "/chunked/20000", true) +
+                          HttpClient::request(backend.port(), "GET", "/length/30", false));
+        for (int i = 0; bOk && i < sizes.size(); ++i)
+        {
+            bOk = client.readAnswer(false, answers[i]);
+        }
+    });
+
+    QVERIFY(bOk);
+    for (int i = 0; i < sizes.size(); ++i)
+    {
+        QVERIFY(answers[i].body == makePayload(sizes[i]));
+    }
+    QVERIFY(!answers[0].bClose);
+    QVERIFY(answers[2].bClose);
+    QCOMPARE(backend.connectionsCount(), 1);
+    manager.stop();
+}
+
+void BenchHttpProxy::testUpstreamPool_data()
+{
+    QTest::addColumn<bool>("bUpstreamPool");
+    QTest::addColumn<int>("expectedConnectionsCount");
+
+    QTest::newRow("pool") << true << 1;
+    QTest::newRow("no pool") << false << 5;
+}
+
+void BenchHttpProxy::testUpstreamPool()
+{
+    QFETCH(bool, bUpstreamPool);
+    QFETCH(int, expectedConnectionsCount);
+
+    HttpBackend backend;
+    ConnectedUsersCounter usersCounter(nullptr);
+    HttpProxyServer::HttpProxyConnectionManager manager(nullptr, 1, &usersCounter);
+    manager.setUpstreamPoolEnabled(bUpstreamPool);
+    ProxyListener listener(&manager);
+    QVERIFY(listener.listen(QHostAddress::LocalHost));
+
+    // a client connection per request, the connection to the server stays in the pool between them
+    int okCount = 0;
+    runClients(1, [&](int) {
+        for (int i = 0; i < 5; ++i)
+        {
+            HttpClient client(listener.serverPort());
+            Answer answer;
+            if (client.send(HttpClient::request(backend.port(), "GET", "/length/100", false)) &&
+                client.readAnswer(false, answer) && answer.body.size() == 100)
+            {
+                okCount++;
+            }
+        }
+    });
+
+    QCOMPARE(okCount, 5);
+    QCOMPARE(backend.connectionsCount(), expectedConnectionsCount);
+    manager.stop();
+}
+
+void BenchHttpProxy::benchmark_page_load_data()
+{
+    QTest::addColumn<bool>("bKeepAlive");
+    QTest::addColumn<bool>("bUpstreamPool");
+
+    QTest::newRow("before: a connection per request") << false << false;
+    QTest::newRow("a connection per request, upstream pool") << false << true;
+    QTest::newRow("after: keep-alive, upstream pool") << true << true;
+}
+
+void BenchHttpProxy::benchmark_page_load()
+{
+    QFETCH(bool, bKeepAlive);
+    QFETCH(bool, bUpstreamPool);
+
+    HttpBackend backend;
+    ConnectedUsersCounter usersCounter(nullptr);
+    HttpProxyServer::HttpProxyConnectionManager manager(nullptr, kThreadsCount, &usersCounter);
+    manager.setUpstreamPoolEnabled(bUpstreamPool);
+    ProxyListener listener(&manager);
+    QVERIFY(listener.listen(QHostAddress::LocalHost));
+
+    // the parallel connections of a browser, each loads the resources of the pages one after another
+    const int resourcesCount = sizeof(kPageResources) / sizeof(kPageResources[0]);
+    std::atomic<int> completed(0);
+    const qint64 startUs = nowUs();
+    runClients(kParallelConnections, [&](int ind) {
+        std::unique_ptr<HttpClient> client;
+        for (int i = 0; i < kRequestsPerConnection; ++i)
+        {
+            if (!client)
+            {
+                client.reset(new HttpClient(listener.serverPort()));
+            }
+            const QByteArray path = kPageResources[(ind + i) % resourcesCount];
+            Answer answer;
+            if (client->send(HttpClient::request(backend.port(), "GET", path, bKeepAlive)) && client->readAnswer(false, answer) &&
+                answer.status == 200 && answer.body.size() == path.mid(path.lastIndexOf('/') + 1).toInt())
+            {
+                completed++;
+            }
+            else
+            {
+                answer.bClose = true;
+            }
+            if (!bKeepAlive || answer.bClose)
+            {
+                client.reset();
+            }
+        }
+    });
+    const qint64 wallUs = nowUs() - startUs;
+
+    printf("%s: %d requests in %.2f s, %.0f requests/s, %d connections to the server\n", QTest::currentDataTag(),
+           completed.load(), wallUs / 1e6, completed * 1e6 / wallUs, backend.connectionsCount());
+    QCOMPARE(completed.load(), kParallelConnections * kRequestsPerConnection);
+    manager.stop();
+}
+
+QTEST_MAIN(BenchHttpProxy)
+#include "httpproxy.bench.moc"
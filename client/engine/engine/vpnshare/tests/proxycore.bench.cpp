@@ -0,0 +1,506 @@
+#include <QtTest>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "engine/vpnshare/connecteduserscounter.h"
+#include "engine/vpnshare/proxycore/proxycore.h"
+
+namespace {
+
+const int kPingSize = 64;
+// the fds per proxied connection: the client, both sockets of the proxy, the pipes of the splice relay, the backend
+const int kFdsPerConnection = 8;
+
+qint64 nowUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return qint64(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+qint64 rssBytes()
+{
+    long pages = 0, residentPages = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f)
+    {
+        if (fscanf(f, "%ld %ld", &pages, &residentPages) != 2)
+        {
+            residentPages = 0;
+        }
+        fclose(f);
+    }
+    return qint64(residentPages) * sysconf(_SC_PAGESIZE);
+}
+
+// the memory of the TCP sockets of the whole system (the buffers in the kernel), "TCP: ... mem N" in pages
+qint64 tcpKernelBytes()
+{
+    qint64 pages = 0;
+    FILE *f = fopen("/proc/net/sockstat", "r");
+    if (f)
+    {
+        char line[256];
+        while (fgets(line, sizeof(line), f))
+        {
+            const char *mem = strstr(line, " mem ");
+            if (strncmp(line, "TCP:", 4) == 0 && mem)
+            {
+                pages = atoll(mem + 5);
+            }
+        }
+        fclose(f);
+    }
+    return pages * sysconf(_SC_PAGESIZE);
+}
+
+int raiseFdLimit()
+{
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    getrlimit(RLIMIT_NOFILE, &limit);
+    return (int)qMin<rlim_t>(limit.rlim_cur, 1 << 30);
+}
+
+sockaddr_in localAddress(quint16 port)
+{
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    return addr;
+}
+
+void watch(int epollFd, int op, int socket, quint32 events, quint64 data)
+{
+    epoll_event event;
+    event.events = events;
+    event.data.u64 = data;
+    epoll_ctl(epollFd, op, socket, &event);
+}
+
+// The local backend: an echo server for any number of connections, in its own thread.
+class EchoBackend
+{
+public:
+    EchoBackend() : port_(0), bFinish_(false)
+    {
+        listenSocket_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        sockaddr_in addr = localAddress(0);
+        socklen_t len = sizeof(addr);
+        bind(listenSocket_, (sockaddr *)&addr, len);
+        listen(listenSocket_, SOMAXCONN);
+        getsockname(listenSocket_, (sockaddr *)&addr, &len);
+        port_ = ntohs(addr.sin_port);
+        epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+        watch(epollFd_, EPOLL_CTL_ADD, listenSocket_, EPOLLIN, listenSocket_);
+        thread_ = std::thread([this]() { run(); });
+    }
+    ~EchoBackend()
+    {
+        bFinish_ = true;
+        thread_.join();
+        close(epollFd_);
+        close(listenSocket_);
+    }
+
+    quint16 port() const { return port_; }
+
+private:
+    int listenSocket_;
+    int epollFd_;
+    quint16 port_;
+    std::atomic<bool> bFinish_;
+    std::thread thread_;
+
+    void run()
+    {
+        std::vector<epoll_event> events(256);
+        char buf[4096];
+        while (!bFinish_)
+        {
+            const int count = epoll_wait(epollFd_, events.data(), events.size(), 100);
+            for (int i = 0; i < count; ++i)
+            {
+                const int s = (int)events[i].data.u64;
+                if (s == listenSocket_)
+                {
+                    int accepted;
+                    while ((accepted = accept4(listenSocket_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+                    {
+                        watch(epollFd_, EPOLL_CTL_ADD, accepted, EPOLLIN, accepted);
+                    }
+                    continue;
+                }
+                const ssize_t n = recv(s, buf, sizeof(buf), 0);
+                if (n > 0)
+                {
+                    // the pings are small, they fit into the socket buffer
+                    send(s, buf, n, MSG_NOSIGNAL);
+                }
+                else if (n == 0 || (errno != EAGAIN && errno != EINTR))
+                {
+                    close(s);
+                }
+            }
+        }
+    }
+};
+
+// Opens the proxied connections and keeps them open: the handshake of the protocol, then a ping echoed by the backend.
+// At most `window` connections are in the handshake at a time, like many clients starting at about the same time.
+class LoadGenerator
+{
+public:
+    struct Result
+    {
+        int established = 0;
+        qint64 wallUs = 0;
+        std::vector<qint64> latenciesUs;    // from connect() to the echo of the ping
+    };
+
+    LoadGenerator(ProxyReactor::PROTOCOL protocol, quint16 proxyPort, quint16 backendPort)
+        : protocol_(protocol), proxyPort_(proxyPort), backendPort_(backendPort)
+    {
+        epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    }
+    ~LoadGenerator()
+    {
+        closeAll();
+        close(epollFd_);
+    }
+
+    Result run(int count, int window, qint64 timeoutUs)
+    {
+        Result result;
+        clients_.resize(count);
+        const qint64 startUs = nowUs();
+        int started = 0, finished = 0, inHandshake = 0;
+        std::vector<epoll_event> events(1024);
+        while (finished < count && nowUs() - startUs < timeoutUs)
+        {
+            while (started < count && inHandshake < window)
+            {
+                if (!startClient(started))
+                {
+                    finished++;
+                }
+                else
+                {
+                    inHandshake++;
+                }
+                started++;
+            }
+            const int n = epoll_wait(epollFd_, events.data(), events.size(), 100);
+            for (int i = 0; i < n; ++i)
+            {
+                Client &client = clients_[events[i].data.u64];
+                const STATE stateBefore = client.state;
+                onEvent(client, events[i].events);
+                if (stateBefore != client.state && (client.state == DONE || client.state == FAILED))
+                {
+                    inHandshake--;
+                    finished++;
+                    if (client.state == DONE)
+                    {
+                        result.established++;
+                        result.latenciesUs.push_back(nowUs() - client.startUs);
+                    }
+                }
+            }
+        }
+        result.wallUs = nowUs() - startUs;
+        return result;
+    }
+
+    void closeAll()
+    {
+        for (Client &client : clients_)
+        {
+            if (client.socket >= 0)
+            {
+                close(client.socket);
+                client.socket = -1;
+            }
+        }
+    }
+
+private:
+    enum STATE { CONNECTING, READ_IDENT_ANSWER, READ_REPLY, READ_ECHO, DONE, FAILED };
+
+    struct Client
+    {
+        int socket = -1;
+        STATE state = CONNECTING;
+        qint64 startUs = 0;
+        int expected = 0;
+        QByteArray received;
+    };
+
+    const ProxyReactor::PROTOCOL protocol_;
+    const quint16 proxyPort_;
+    const quint16 backendPort_;
+    int epollFd_;
+    std::vector<Client> clients_;
+
+    bool startClient(int index)
+    {
+        Client &client = clients_[index];
+        client.startUs = nowUs();
+        client.socket = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        const sockaddr_in addr = localAddress(proxyPort_);
+        if (client.socket < 0 || (connect(client.socket, (const sockaddr *)&addr, sizeof(addr)) != 0 && errno != EINPROGRESS))
+        {
+            client.state = FAILED;
+            return false;
+        }
+        watch(epollFd_, EPOLL_CTL_ADD, client.socket, EPOLLOUT, index);
+        return true;
+    }
+
+    void onEvent(Client &client, quint32 events)
+    {
+        if (client.state == CONNECTING)
+        {
+            if (events & (EPOLLERR | EPOLLHUP))
+            {
+                fail(client);
+                return;
+            }
+            if (protocol_ == ProxyReactor::SOCKS5)
+            {
+                send(client.socket, "\x05\x01\x00", 3, MSG_NOSIGNAL);
+                expect(client, READ_IDENT_ANSWER, 2);
+            }
+            else
+            {
+                const QByteArray request = QByteArray("CONNECT 127.0.0.1:") + QByteArray::number(backendPort_) +
+                                           " HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+                send(client.socket, request.constData(), request.size(), MSG_NOSIGNAL);
+                // HTTP/1.0 200 Connection established ...\r\n\r\n
+                expect(client, READ_REPLY, -1);
+            }
+            return;
+        }
+
+        char buf[512];
+        const ssize_t n = recv(client.socket, buf, sizeof(buf), 0);
+        if (n <= 0)
+        {
+            if (n == 0 || errno != EAGAIN)
+            {
+                fail(client);
+            }
+            return;
+        }
+        client.received.append(buf, n);
+
+        if (client.expected < 0)
+        {
+            const int end = client.received.indexOf("\r\n\r\n");
+            if (end < 0)
+            {
+                return;
+            }
+            if (!client.received.startsWith("HTTP/1.0 200"))
+            {
+                fail(client);
+                return;
+            }
+            client.received.remove(0, end + 4);
+        }
+        else if (client.received.size() < client.expected)
+        {
+            return;
+        }
+        else
+        {
+            client.received.remove(0, client.expected);
+        }
+
+        if (client.state == READ_IDENT_ANSWER)
+        {
+            char cmd[10] = { 0x05, 0x01, 0x00, 0x01 };
+            const sockaddr_in backend = localAddress(backendPort_);
+            memcpy(cmd + 4, &backend.sin_addr, 4);
+            memcpy(cmd + 8, &backend.sin_port, 2);
+            send(client.socket, cmd, sizeof(cmd), MSG_NOSIGNAL);
+            // the reply with an IPv4 bound address
+            expect(client, READ_REPLY, 10);
+        }
+        else if (client.state == READ_REPLY)
+        {
+            const QByteArray ping(kPingSize, 'p');
+            send(client.socket, ping.constData(), ping.size(), MSG_NOSIGNAL);
+            expect(client, READ_ECHO, kPingSize);
+        }
+        else if (client.state == READ_ECHO)
+        {
+            // stays open, not watched anymore
+            epoll_ctl(epollFd_, EPOLL_CTL_DEL, client.socket, nullptr);
+            client.state = DONE;
+        }
+    }
+
+    void expect(Client &client, STATE state, int size)
+    {
+        if (client.state == CONNECTING)
+        {
+            watch(epollFd_, EPOLL_CTL_MOD, client.socket, EPOLLIN, &client - clients_.data());
+        }
+        client.state = state;
+        client.expected = size;
+    }
+
+    void fail(Client &client)
+    {
+        epoll_ctl(epollFd_, EPOLL_CTL_DEL, client.socket, nullptr);
+        close(client.socket);
+        client.socket = -1;
+        client.state = FAILED;
+    }
+};
+
+} // namespace
+
+// Opens 10k concurrent proxied connections (fewer if the fd limit is lower) through a ProxyCore to a local echo backend.
+// Reports the rate of the established tunnels, the memory per connection (the RSS of the process, which also holds the
+// generator and the backend, and the TCP buffers of the kernel) and the latency of the tunnels from connect() to the echo.
+class BenchProxyCore : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void testHandOff_data();
+    void testHandOff();
+    void benchmark_connections_data();
+    void benchmark_connections();
+
+private:
+    static constexpr int kConnectionsCount = 10000;
+    static constexpr int kHandshakeWindow = 512;
+    int connectionsCount_ = 0;
+};
+
+void BenchProxyCore::initTestCase()
+{
+    const int fdLimit = raiseFdLimit();
+    connectionsCount_ = qMin(kConnectionsCount, (fdLimit - 256) / kFdsPerConnection);
+    if (connectionsCount_ < kConnectionsCount)
+    {
+        printf("the fd limit is %d, %d connections instead of %d\n", fdLimit, connectionsCount_, kConnectionsCount);
+    }
+    QVERIFY(connectionsCount_ > 0);
+}
+
+void BenchProxyCore::testHandOff_data()
+{
+    QTest::addColumn<int>("protocol");
+    QTest::addColumn<QByteArray>("firstMessage");
+    QTest::addColumn<QByteArray>("secondMessage");
+    QTest::addColumn<QByteArray>("expectedReadData");
+    QTest::newRow("http request") << (int)ProxyReactor::HTTP << QByteArray("GET http://example.com/ HTTP/1.1\r\n")
+                                  << QByteArray() << QByteArray("GET http://example.com/ HTTP/1.1\r\n");
+    // the ident request is answered by the reactor
+    const QByteArray udpAssociate("\x05\x03\x00\x01\x00\x00\x00\x00\x00\x00", 10);
+    QTest::newRow("socks udp associate") << (int)ProxyReactor::SOCKS5 << QByteArray("\x05\x01\x00", 3)
+                                         << udpAssociate << udpAssociate;
+}
+
+void BenchProxyCore::testHandOff()
+{
+    QFETCH(int, protocol);
+    QFETCH(QByteArray, firstMessage);
+    QFETCH(QByteArray, secondMessage);
+    QFETCH(QByteArray, expectedReadData);
+
+    ConnectedUsersCounter usersCounter(nullptr);
+    ProxyCore core(nullptr, (ProxyReactor::PROTOCOL)protocol, &usersCounter);
+    QVERIFY(core.start(0, 2));
+    qintptr handedOffSocket = -1;
+    QByteArray readData;
+    connect(&core, &ProxyCore::connectionHandedOff, this, [&handedOffSocket, &readData](qintptr socket, const QByteArray &data) {
+        handedOffSocket = socket;
+        readData = data;
+    });
+
+    const int s = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    const sockaddr_in addr = localAddress(core.port());
+    QCOMPARE(::connect(s, (const sockaddr *)&addr, sizeof(addr)), 0);
+    QCOMPARE(send(s, firstMessage.constData(), firstMessage.size(), 0), (ssize_t)firstMessage.size());
+    if (!secondMessage.isEmpty())
+    {
+        char answer[2];
+        QCOMPARE(recv(s, answer, sizeof(answer), MSG_WAITALL), (ssize_t)sizeof(answer));
+        QCOMPARE(QByteArray(answer, 2), QByteArray("\x05\x00", 2));
+        QCOMPARE(send(s, secondMessage.constData(), secondMessage.size(), 0), (ssize_t)secondMessage.size());
+    }
+    QTRY_VERIFY_WITH_TIMEOUT(handedOffSocket >= 0, 5000);
+    QCOMPARE(readData, expectedReadData);
+
+    // the socket is usable by the receiver
+    QCOMPARE(send(handedOffSocket, "x", 1, MSG_NOSIGNAL), (ssize_t)1);
+    char c;
+    QCOMPARE(recv(s, &c, 1, 0), (ssize_t)1);
+    close(handedOffSocket);
+    close(s);
+    QCOMPARE(core.handshakesCount(), 0);
+}
+
+void BenchProxyCore::benchmark_connections_data()
+{
+    QTest::addColumn<int>("protocol");
+    QTest::newRow("socks5") << (int)ProxyReactor::SOCKS5;
+    QTest::newRow("http connect") << (int)ProxyReactor::HTTP;
+}
+
+void BenchProxyCore::benchmark_connections()
+{
+    QFETCH(int, protocol);
+
+    EchoBackend backend;
+    ConnectedUsersCounter usersCounter(nullptr);
+    ProxyCore core(nullptr, (ProxyReactor::PROTOCOL)protocol, &usersCounter);
+    QVERIFY(core.start(0));
+
+    const qint64 rssBefore = rssBytes();
+    const qint64 kernelBefore = tcpKernelBytes();
+    LoadGenerator generator((ProxyReactor::PROTOCOL)protocol, core.port(), backend.port());
+    LoadGenerator::Result result = generator.run(connectionsCount_, kHandshakeWindow, 120 * 1000 * 1000);
+    QTRY_COMPARE_WITH_TIMEOUT(core.relaysCount(), result.established, 10000);
+    const qint64 rssDelta = rssBytes() - rssBefore;
+    const qint64 kernelDelta = tcpKernelBytes() - kernelBefore;
+
+    QCOMPARE(result.established, connectionsCount_);
+    std::sort(result.latenciesUs.begin(), result.latenciesUs.end());
+    auto percentile = [&result](double p) {
+        return result.latenciesUs[qMin<size_t>(result.latenciesUs.size() - 1, result.latenciesUs.size() * p)] / 1000.0;
+    };
+    printf("%s, %d reactors: %d concurrent tunnels in %.2f s, %.0f connections/s\n", QTest::currentDataTag(),
+           QThread::idealThreadCount(), result.established, result.wallUs / 1e6, result.established / (result.wallUs / 1e6));
+    printf("    memory per connection: %.1f KB of RSS, %.1f KB of TCP buffers in the kernel (both ends of both hops)\n",
+           rssDelta / 1024.0 / result.established, kernelDelta / 1024.0 / result.established);
+    printf("    latency connect-to-echo: p50 %.2f ms, p99 %.2f ms, max %.2f ms\n", percentile(0.5), percentile(0.99),
+           result.latenciesUs.back() / 1000.0);
+
+    generator.closeAll();
+    QTRY_COMPARE_WITH_TIMEOUT(core.relaysCount(), 0, 30000);
+}
+
+QTEST_MAIN(BenchProxyCore)
+#include "proxycore.bench.moc"
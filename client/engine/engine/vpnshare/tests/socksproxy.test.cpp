@@ -0,0 +1,441 @@
+#include <QtTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QUdpSocket>
+#include <QtEndian>
+
+#include "engine/vpnshare/socksproxyserver/socksproxyserver.h"
+#include "engine/vpnshare/socksproxyserver/socksproxyudpassociation.h"
+
+using SocksProxyServer::SocksProxyUdpAssociation;
+
+namespace {
+
+const int kTimeoutMs = 5000;
+// the hostnames known to the stub DNS server, all of them are 127.0.0.1
+const char *kKnownHostname = "echo.test";
+const char *kOtherKnownHostname = "other.test";
+const char *kUnknownHostname = "missing.test";
+
+// Answers the A queries for the known hostnames with 127.0.0.1, NXDOMAIN for the rest.
+class StubDnsServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit StubDnsServer(QObject *parent) : QObject(parent), queriesCount_(0)
+    {
+        socket_.bind(QHostAddress::LocalHost, 0);
+        connect(&socket_, &QUdpSocket::readyRead, this, &StubDnsServer::onReadyRead);
+    }
+
+    QString address() const { return QString("127.0.0.1:%1").arg(socket_.localPort()); }
+    int queriesCount() const { return queriesCount_; }
+
+private slots:
+    void onReadyRead()
+    {
+        while (socket_.hasPendingDatagrams())
+        {
+            QHostAddress sender;
+            quint16 senderPort;
+            QByteArray query(socket_.pendingDatagramSize(), Qt::Uninitialized);
+            query.resize(socket_.readDatagram(query.data(), query.size(), &sender, &senderPort));
+            QByteArray answer;
+            if (makeAnswer(query, answer))
+            {
+                queriesCount_++;
+                socket_.writeDatagram(answer, sender, senderPort);
+            }
+        }
+    }
+
+private:
+    QUdpSocket socket_;
+    int queriesCount_;
+
+    static bool makeAnswer(const QByteArray &query, QByteArray &outAnswer)
+    {
+        if (query.size() < 12)
+        {
+            return false;
+        }
+        // the question: labels, QTYPE, QCLASS
+        int pos = 12;
+        QStringList labels;
+        while (pos < query.size() && query[pos] != 0)
+        {
+            const int len = (uchar)query[pos];
+            labels << QString::fromLatin1(query.mid(pos + 1, len));
+            pos += 1 + len;
+        }
+        if (pos + 5 > query.size())
+        {
+            return false;
+        }
+        const quint16 qtype = qFromBigEndian<quint16>(query.constData() + pos + 1);
+        const QByteArray question = query.mid(12, pos + 5 - 12);
+        const QString hostname = labels.join('.').toLower();
+        const bool bKnown = (hostname == kKnownHostname || hostname == kOtherKnownHostname);
+        const bool bAnswer = bKnown && qtype == 1;
+
+        outAnswer = query.left(2);  // id
+        outAnswer.append(char(0x81));
+        outAnswer.append(char(bKnown ? 0x80 : 0x83));
+        const char counts[8] = { 0, 1, 0, char(bAnswer ? 1 : 0), 0, 0, 0, 0 };
+        outAnswer.append(counts, sizeof(counts));
+        outAnswer.append(question);
+        if (bAnswer)
+        {
+            const char record[16] = { char(0xC0), 0x0C, 0, 1, 0, 1, 0, 0, 0, 60, 0, 4, 127, 0, 0, 1 };
+            outAnswer.append(record, sizeof(record));
+        }
+        return true;
+    }
+};
+
+// Echoes the datagrams, the ones starting with "late" after lateDelayMs.
+class UdpEchoServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit UdpEchoServer(QObject *parent, int lateDelayMs) : QObject(parent), lateDelayMs_(lateDelayMs)
+    {
+        socket_.bind(QHostAddress::LocalHost, 0);
+        connect(&socket_, &QUdpSocket::readyRead, this, &UdpEchoServer::onReadyRead);
+    }
+
+    quint16 port() const { return socket_.localPort(); }
+
+private slots:
+    void onReadyRead()
+    {
+        while (socket_.hasPendingDatagrams())
+        {
+            QHostAddress sender;
+            quint16 senderPort;
+            QByteArray data(socket_.pendingDatagramSize(), Qt::Uninitialized);
+            data.resize(socket_.readDatagram(data.data(), data.size(), &sender, &senderPort));
+            if (data.startsWith("late"))
+            {
+                QTimer::singleShot(lateDelayMs_, this, [this, data, sender, senderPort]() {
+                    socket_.writeDatagram(data, sender, senderPort);
+                });
+            }
+            else
+            {
+                socket_.writeDatagram(data, sender, senderPort);
+            }
+        }
+    }
+
+private:
+    QUdpSocket socket_;
+    const int lateDelayMs_;
+};
+
+QByteArray makePort(quint16 port)
+{
+    uchar bytes[2];
+    qToBigEndian<quint16>(port, bytes);
+    return QByteArray((const char *)bytes, sizeof(bytes));
+}
+
+QByteArray makeCommand(char cmd, const QHostAddress &address, quint16 port)
+{
+    QByteArray arr;
+    arr.append(char(0x05)).append(cmd).append(char(0x00)).append(char(0x01));
+    uchar ip4[4];
+    qToBigEndian<quint32>(address.toIPv4Address(), ip4);
+    arr.append((const char *)ip4, sizeof(ip4));
+    arr.append(makePort(port));
+    return arr;
+}
+
+QByteArray makeCommand(char cmd, const QString &hostname, quint16 port)
+{
+    QByteArray arr;
+    arr.append(char(0x05)).append(cmd).append(char(0x00)).append(char(0x03));
+    arr.append(char(hostname.size())).append(hostname.toLatin1());
+    arr.append(makePort(port));
+    return arr;
+}
+
+// the events must be processed while waiting, the DNS cache of the server lives in this thread
+bool readExactly(QTcpSocket &socket, int size, QByteArray &out)
+{
+    if (!QTest::qWaitFor([&socket, size]() { return socket.bytesAvailable() >= size; }, kTimeoutMs))
+    {
+        return false;
+    }
+    out = socket.read(size);
+    return true;
+}
+
+} // namespace
+
+class TestSocksProxy : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testDatagramHeader();
+    void testConnectByHostname();
+    void testConnectErrors();
+    void testUnsupportedCommand();
+    void testUdpAssociate();
+    void testUdpFlowIdleTimeout();
+
+private:
+    SocksProxyServer::SocksProxyServer *server_ = nullptr;
+    StubDnsServer *dnsServer_ = nullptr;
+    QTcpServer *tcpEchoServer_ = nullptr;
+    UdpEchoServer *udpEchoServer_ = nullptr;
+
+    static constexpr int kFlowIdleTimeoutMs = 300;
+
+    // returns the reply code, -1 on a failure
+    int connectToSocks(QTcpSocket &socket, const QByteArray &command, QHostAddress *outBindAddress = nullptr, quint16 *outBindPort = nullptr);
+};
+
+void TestSocksProxy::initTestCase()
+{
+    dnsServer_ = new StubDnsServer(this);
+
+    tcpEchoServer_ = new QTcpServer(this);
+    QVERIFY(tcpEchoServer_->listen(QHostAddress::LocalHost, 0));
+    connect(tcpEchoServer_, &QTcpServer::newConnection, this, [this]() {
+        while (QTcpSocket *socket = tcpEchoServer_->nextPendingConnection())
+        {
+            connect(socket, &QTcpSocket::readyRead, socket, [socket]() { socket->write(socket->readAll()); });
+            connect(socket, &QTcpSocket::disconnected, socket, &QTcpSocket::deleteLater);
+        }
+    });
+
+    udpEchoServer_ = new UdpEchoServer(this, kFlowIdleTimeoutMs * 4);
+
+    server_ = new SocksProxyServer::SocksProxyServer(this);
+    server_->setDnsServers(QStringList() << dnsServer_->address());
+    server_->setUdpFlowIdleTimeout(kFlowIdleTimeoutMs);
+    QVERIFY(server_->startServer(0));
+}
+
+void TestSocksProxy::cleanupTestCase()
+{
+    delete server_;
+    server_ = nullptr;
+}
+
+int TestSocksProxy::connectToSocks(QTcpSocket &socket, const QByteArray &command, QHostAddress *outBindAddress, quint16 *outBindPort)
+{
+    socket.connectToHost(QHostAddress::LocalHost, server_->port());
+    socket.write(QByteArray("\x05\x01\x00", 3));
+    QByteArray arr;
+    if (!readExactly(socket, 2, arr) || arr != QByteArray("\x05\x00", 2))
+    {
+        return -1;
+    }
+
+    socket.write(command);
+    if (!readExactly(socket, 4, arr) || arr[0] != 0x05)
+    {
+        return -1;
+    }
+    const int reply = (uchar)arr[1];
+    const char addrType = arr[3];
+    QByteArray addr;
+    if (addrType == 0x01)
+    {
+        if (!readExactly(socket, 4, addr))
+        {
+            return -1;
+        }
+        if (outBindAddress)
+        {
+            *outBindAddress = QHostAddress(qFromBigEndian<quint32>(addr.constData()));
+        }
+    }
+    else if (addrType == 0x04)
+    {
+        if (!readExactly(socket, 16, addr))
+        {
+            return -1;
+        }
+        if (outBindAddress)
+        {
+            *outBindAddress = QHostAddress((const quint8 *)addr.constData());
+        }
+    }
+    else if (addrType == 0x03)
+    {
+        if (!readExactly(socket, 1, addr) || !readExactly(socket, (uchar)addr[0], addr))
+        {
+            return -1;
+        }
+    }
+    else
+    {
+        return -1;
+    }
+    QByteArray port;
+    if (!readExactly(socket, 2, port))
+    {
+        return -1;
+    }
+    if (outBindPort)
+    {
+        *outBindPort = qFromBigEndian<quint16>(port.constData());
+    }
+    return reply;
+}
+
+void TestSocksProxy::testDatagramHeader()
+{
+    SocksProxyUdpAssociation::Destination destination;
+    int dataOffset = 0;
+
+    const QByteArray ip4 = SocksProxyUdpAssociation::makeDatagram(QHostAddress("10.1.2.3"), 5353, "payload");
+    QCOMPARE(ip4.toHex(), QByteArray("000000010a01020314e9") + QByteArray("payload").toHex());
+    QVERIFY(SocksProxyUdpAssociation::parseDatagram(ip4, destination, dataOffset));
+    QCOMPARE(destination.address, QHostAddress("10.1.2.3"));
+    QCOMPARE(destination.port, quint16(5353));
+    QCOMPARE(ip4.mid(dataOffset), QByteArray("payload"));
+
+    const QByteArray ip6 = SocksProxyUdpAssociation::makeDatagram(QHostAddress("2001:db8::1"), 53, "x");
+    QCOMPARE(ip6.size(), 4 + 16 + 2 + 1);
+    QVERIFY(SocksProxyUdpAssociation::parseDatagram(ip6, destination, dataOffset));
+    QCOMPARE(destination.address, QHostAddress("2001:db8::1"));
+    QCOMPARE(destination.port, quint16(53));
+
+    destination = SocksProxyUdpAssociation::Destination();
+    const QByteArray domain = QByteArray("\x00\x00\x00\x03\x09", 5) + "echo.test" + makePort(7) + "data";
+    QVERIFY(SocksProxyUdpAssociation::parseDatagram(domain, destination, dataOffset));
+    QVERIFY(destination.address.isNull());
+    QCOMPARE(destination.hostname, QString("echo.test"));
+    QCOMPARE(destination.port, quint16(7));
+    QCOMPARE(domain.mid(dataOffset), QByteArray("data"));
+
+    // fragments, truncated headers and unknown address types are dropped
+    QByteArray fragment = ip4;
+    fragment[2] = 1;
+    QVERIFY(!SocksProxyUdpAssociation::parseDatagram(fragment, destination, dataOffset));
+    QVERIFY(!SocksProxyUdpAssociation::parseDatagram(ip4.left(9), destination, dataOffset));
+    QVERIFY(!SocksProxyUdpAssociation::parseDatagram(domain.left(10), destination, dataOffset));
+    QByteArray unknownType = ip4;
+    unknownType[3] = 0x02;
+    QVERIFY(!SocksProxyUdpAssociation::parseDatagram(unknownType, destination, dataOffset));
+}
+
+void TestSocksProxy::testConnectByHostname()
+{
+    const int queriesBefore = dnsServer_->queriesCount();
+    for (int i = 0; i < 2; ++i)
+    {
+        QTcpSocket socket;
+        QCOMPARE(connectToSocks(socket, makeCommand(0x01, QString(kKnownHostname), tcpEchoServer_->serverPort())), 0x00);
+        socket.write("hello through the proxy");
+        QByteArray arr;
+        QVERIFY(readExactly(socket, 23, arr));
+        QCOMPARE(arr, QByteArray("hello through the proxy"));
+    }
+    // the second connection is answered from the DNS cache
+    QVERIFY(dnsServer_->queriesCount() > queriesBefore);
+    const int queriesAfterFirst = dnsServer_->queriesCount();
+    QTcpSocket socket;
+    QCOMPARE(connectToSocks(socket, makeCommand(0x01, QString(kKnownHostname), tcpEchoServer_->serverPort())), 0x00);
+    QCOMPARE(dnsServer_->queriesCount(), queriesAfterFirst);
+}
+
+void TestSocksProxy::testConnectErrors()
+{
+    {
+        QTcpSocket socket;
+        QCOMPARE(connectToSocks(socket, makeCommand(0x01, QString(kUnknownHostname), 80)), 0x04);
+        QVERIFY(QTest::qWaitFor([&socket]() { return socket.state() == QAbstractSocket::UnconnectedState; }, kTimeoutMs));
+    }
+    {
+        // a port nobody listens on
+        QTcpServer closed;
+        QVERIFY(closed.listen(QHostAddress::LocalHost, 0));
+        const quint16 port = closed.serverPort();
+        closed.close();
+
+        QTcpSocket socket;
+        QCOMPARE(connectToSocks(socket, makeCommand(0x01, QHostAddress::LocalHost, port)), 0x05);
+        QVERIFY(QTest::qWaitFor([&socket]() { return socket.state() == QAbstractSocket::UnconnectedState; }, kTimeoutMs));
+    }
+}
+
+void TestSocksProxy::testUnsupportedCommand()
+{
+    QTcpSocket socket;
+    QCOMPARE(connectToSocks(socket, makeCommand(0x02, QHostAddress::LocalHost, 0)), 0x07);
+    QVERIFY(QTest::qWaitFor([&socket]() { return socket.state() == QAbstractSocket::UnconnectedState; }, kTimeoutMs));
+}
+
+void TestSocksProxy::testUdpAssociate()
+{
+    QTcpSocket control;
+    QHostAddress relayAddress;
+    quint16 relayPort = 0;
+    QCOMPARE(connectToSocks(control, makeCommand(0x03, QHostAddress(QHostAddress::AnyIPv4), 0), &relayAddress, &relayPort), 0x00);
+    QCOMPARE(relayAddress, QHostAddress(QHostAddress::LocalHost));
+    QVERIFY(relayPort != 0);
+
+    QUdpSocket client;
+    QVERIFY(client.bind(QHostAddress::LocalHost, 0));
+
+    const QHostAddress echoAddress(QHostAddress::LocalHost);
+    struct
+    {
+        QByteArray datagram;
+        QByteArray data;
+    } cases[] = {
+        { SocksProxyUdpAssociation::makeDatagram(echoAddress, udpEchoServer_->port(), "by address"), "by address" },
+        { QByteArray("\x00\x00\x00\x03", 4) + char(strlen(kOtherKnownHostname)) + kOtherKnownHostname + makePort(udpEchoServer_->port()) + "by hostname", "by hostname" },
+    };
+    for (const auto &c : cases)
+    {
+        client.writeDatagram(c.datagram, relayAddress, relayPort);
+        QVERIFY(QTest::qWaitFor([&client]() { return client.hasPendingDatagrams(); }, kTimeoutMs));
+        QByteArray answer(client.pendingDatagramSize(), Qt::Uninitialized);
+        answer.resize(client.readDatagram(answer.data(), answer.size()));
+
+        SocksProxyUdpAssociation::Destination source;
+        int dataOffset = 0;
+        QVERIFY(SocksProxyUdpAssociation::parseDatagram(answer, source, dataOffset));
+        QCOMPARE(source.address, echoAddress);
+        QCOMPARE(source.port, udpEchoServer_->port());
+        QCOMPARE(answer.mid(dataOffset), c.data);
+    }
+
+    // the relay is closed with the control connection
+    control.close();
+    QTest::qWait(200);
+    client.writeDatagram(cases[0].datagram, relayAddress, relayPort);
+    QVERIFY(!QTest::qWaitFor([&client]() { return client.hasPendingDatagrams(); }, 500));
+}
+
+void TestSocksProxy::testUdpFlowIdleTimeout()
+{
+    QTcpSocket control;
+    QHostAddress relayAddress;
+    quint16 relayPort = 0;
+    QCOMPARE(connectToSocks(control, makeCommand(0x03, QHostAddress(QHostAddress::AnyIPv4), 0), &relayAddress, &relayPort), 0x00);
+
+    QUdpSocket client;
+    QVERIFY(client.bind(QHostAddress::LocalHost, 0));
+
+    // the answer comes after the flow expired, it is dropped
+    client.writeDatagram(SocksProxyUdpAssociation::makeDatagram(QHostAddress::LocalHost, udpEchoServer_->port(), "late"), relayAddress, relayPort);
+    QVERIFY(!QTest::qWaitFor([&client]() { return client.hasPendingDatagrams(); }, kFlowIdleTimeoutMs * 6));
+
+    // a new datagram opens the flow again
+    client.writeDatagram(SocksProxyUdpAssociation::makeDatagram(QHostAddress::LocalHost, udpEchoServer_->port(), "again"), relayAddress, relayPort);
+    QVERIFY(QTest::qWaitFor([&client]() { return client.hasPendingDatagrams(); }, kTimeoutMs));
+}
+
+QTEST_MAIN(TestSocksProxy)
+#include "socksproxy.test.moc"
@@ -0,0 +1,369 @@
+#include <QtTest>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <functional>
+#include <random>
+#include <thread>
+
+#include "engine/vpnshare/socketutils/socketwriteall.h"
+#include "engine/vpnshare/socketutils/splicerelay.h"
+
+namespace {
+
+qint64 toUs(const struct timeval &tv)
+{
+    return qint64(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+qint64 cpuTimeUs(int who)
+{
+    struct rusage usage;
+    getrusage(who, &usage);
+    return toUs(usage.ru_utime) + toUs(usage.ru_stime);
+}
+
+int listenLocal(quint16 *outPort)
+{
+    int s = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(s, (struct sockaddr *)&addr, len) != 0 || listen(s, 16) != 0 || getsockname(s, (struct sockaddr *)&addr, &len) != 0)
+    {
+        close(s);
+        return -1;
+    }
+    *outPort = ntohs(addr.sin_port);
+    return s;
+}
+
+int connectLocal(quint16 port)
+{
+    int s = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (::connect(s, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(s);
+        return -1;
+    }
+    return s;
+}
+
+bool writeAll(int s, const char *data, qint64 size)
+{
+    while (size > 0)
+    {
+        const ssize_t n = send(s, data, size, MSG_NOSIGNAL);
+        if (n <= 0)
+        {
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+// The local backend: a sink which counts the bytes until the end of the data, or an echo server.
+// Accepts one connection, reports the CPU time of its thread.
+class Backend
+{
+public:
+    explicit Backend(bool bEcho) : bEcho_(bEcho), listenSocket_(listenLocal(&port_)), bytes_(0), cpuUs_(0)
+    {
+        thread_ = std::thread([this]() { run(); });
+    }
+    ~Backend()
+    {
+        join();
+        close(listenSocket_);
+    }
+
+    quint16 port() const { return port_; }
+    void join() { if (thread_.joinable()) thread_.join(); }
+    qint64 bytes() const { return bytes_; }
+    qint64 cpuUs() const { return cpuUs_; }
+
+private:
+    bool bEcho_;
+    quint16 port_;
+    int listenSocket_;
+    std::thread thread_;
+    std::atomic<qint64> bytes_;
+    std::atomic<qint64> cpuUs_;
+
+    void run()
+    {
+        const qint64 cpuStartUs = cpuTimeUs(RUSAGE_THREAD);
+        int s = accept4(listenSocket_, nullptr, nullptr, SOCK_CLOEXEC);
+        std::vector<char> buf(1024 * 1024);
+        while (s >= 0)
+        {
+            const ssize_t n = recv(s, buf.data(), buf.size(), 0);
+            if (n <= 0 || (bEcho_ && !writeAll(s, buf.data(), n)))
+            {
+                break;
+            }
+            bytes_ += n;
+        }
+        if (s >= 0)
+        {
+            close(s);
+        }
+        cpuUs_ = cpuTimeUs(RUSAGE_THREAD) - cpuStartUs;
+    }
+};
+
+// The relay of the proxy connections on the other platforms (and on Linux while the sockets are not taken over yet):
+// two Qt sockets and SocketWriteAll::relayFrom(), runs in its own thread as the proxy connections do.
+class QtRelay : public QObject
+{
+    Q_OBJECT
+public:
+    QtRelay(int socket1, int socket2) : socket1_(socket1), socket2_(socket2) {}
+
+public slots:
+    void start()
+    {
+        sockets_[0] = new QTcpSocket(this);
+        sockets_[1] = new QTcpSocket(this);
+        sockets_[0]->setSocketDescriptor(socket1_);
+        sockets_[1]->setSocketDescriptor(socket2_);
+        for (int i = 0; i < 2; ++i)
+        {
+            QTcpSocket *from = sockets_[i];
+            QTcpSocket *to = sockets_[1 - i];
+            SocketWriteAll *writeAll = new SocketWriteAll(this, to);
+            connect(from, &QTcpSocket::readyRead, this, [writeAll, from]() { writeAll->relayFrom(from); });
+            // Qt sockets do not support half-closed connections, pass on the end of the data when the rest is written
+            connect(from, &QTcpSocket::disconnected, this, [this, writeAll, from, to]() {
+                connect(writeAll, &SocketWriteAll::allDataWriteFinished, to, &QTcpSocket::disconnectFromHost);
+                writeAll->relayFrom(from);
+                writeAll->setEmitAllDataWritten();
+                if (++disconnectedCount_ == 2)
+                {
+                    emit finished();
+                }
+            });
+        }
+    }
+
+signals:
+    void finished();
+
+private:
+    int socket1_;
+    int socket2_;
+    QTcpSocket *sockets_[2];
+    int disconnectedCount_ = 0;
+};
+
+} // namespace
+
+// Relays the data of a local client to a local backend through the splice relay and through the Qt sockets, iperf style.
+// Reports the throughput and the CPU time of the relay per GB: the CPU time of the process without the client and the backend.
+class BenchSpliceRelay : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testEcho_data();
+    void testEcho();
+    void benchmark_qt_relay();
+    void benchmark_splice_relay();
+
+private:
+    static constexpr qint64 kBenchBytes = 4LL * 1024 * 1024 * 1024;
+    static constexpr qint64 kEchoBytes = 16 * 1024 * 1024;
+
+    // accepts the client and connects to the backend, startRelay(acceptedSocket, backendSocket) relays until the end
+    bool runThroughRelay(quint16 backendPort, const std::function<void(int)> &client,
+                         const std::function<void(int, int)> &startRelay);
+    void relayThroughQt(int socket1, int socket2);
+    void report(const char *name, qint64 bytes, qint64 wallUs, qint64 relayCpuUs);
+};
+
+bool BenchSpliceRelay::runThroughRelay(quint16 backendPort, const std::function<void(int)> &client,
+                                       const std::function<void(int, int)> &startRelay)
+{
+    quint16 relayPort;
+    int listenSocket = listenLocal(&relayPort);
+    if (listenSocket < 0)
+    {
+        return false;
+    }
+    std::thread clientThread([&client, relayPort]() { client(connectLocal(relayPort)); });
+
+    int accepted = accept4(listenSocket, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+    close(listenSocket);
+    int backend = connectLocal(backendPort);
+    if (accepted < 0 || backend < 0)
+    {
+        clientThread.join();
+        return false;
+    }
+    fcntl(backend, F_SETFL, fcntl(backend, F_GETFL) | O_NONBLOCK);
+
+    startRelay(accepted, backend);
+    clientThread.join();
+    return true;
+}
+
+void BenchSpliceRelay::relayThroughQt(int socket1, int socket2)
+{
+    QThread thread;
+    QtRelay *relay = new QtRelay(socket1, socket2);
+    relay->moveToThread(&thread);
+    connect(&thread, &QThread::finished, relay, &QObject::deleteLater);
+    bool bFinished = false;
+    connect(relay, &QtRelay::finished, this, [&bFinished]() { bFinished = true; });
+    thread.start();
+    QMetaObject::invokeMethod(relay, "start", Qt::QueuedConnection);
+    QTRY_VERIFY_WITH_TIMEOUT(bFinished, 10 * 60 * 1000);
+    thread.quit();
+    thread.wait();
+}
+
+void BenchSpliceRelay::testEcho_data()
+{
+    QTest::addColumn<bool>("bSplice");
+    QTest::newRow("qt") << false;
+    QTest::newRow("splice") << true;
+}
+
+void BenchSpliceRelay::testEcho()
+{
+    QFETCH(bool, bSplice);
+
+    QByteArray data(kEchoBytes, Qt::Uninitialized);
+    std::mt19937 gen(42);
+    for (char &c : data)
+    {
+        c = (char)gen();
+    }
+
+    Backend backend(true);
+    QByteArray echo;
+    const bool bOk = runThroughRelay(backend.port(), [&data, &echo](int s) {
+        // write and read at the same time, the relay does not buffer much
+        std::thread writer([s, &data]() { writeAll(s, data.constData(), data.size()); });
+        std::vector<char> buf(64 * 1024);
+        while (echo.size() < data.size())
+        {
+            const ssize_t n = recv(s, buf.data(), buf.size(), 0);
+            if (n <= 0)
+            {
+                break;
+            }
+            echo.append(buf.data(), n);
+        }
+        writer.join();
+        close(s);
+    }, [this, bSplice](int accepted, int backendSocket) {
+        if (bSplice)
+        {
+            SpliceRelay relay;
+            qint64 bytes[2] = { -1, -1 };
+            connect(&relay, &SpliceRelay::relayFinished, this, [&bytes](quint64, qint64 bytes1to2, qint64 bytes2to1) {
+                bytes[0] = bytes1to2;
+                bytes[1] = bytes2to1;
+            });
+            // as if the proxy connection has read a bit of the data already
+            QByteArray alreadyRead(1000, Qt::Uninitialized);
+            int readSize = 0;
+            while (readSize < alreadyRead.size())
+            {
+                const ssize_t n = recv(accepted, alreadyRead.data() + readSize, alreadyRead.size() - readSize, 0);
+                if (n > 0)
+                {
+                    readSize += n;
+                }
+            }
+            relay.add(accepted, backendSocket, alreadyRead);
+            QTRY_VERIFY_WITH_TIMEOUT(bytes[0] != -1, 60 * 1000);
+            QCOMPARE(bytes[0], kEchoBytes);
+            QCOMPARE(bytes[1], kEchoBytes);
+        }
+        else
+        {
+            relayThroughQt(accepted, backendSocket);
+        }
+    });
+    QVERIFY(bOk);
+    backend.join();
+    QCOMPARE(echo.size(), data.size());
+    QVERIFY(echo == data);
+}
+
+void BenchSpliceRelay::benchmark_qt_relay()
+{
+    Backend sink(false);
+    QElapsedTimer timer;
+    qint64 clientCpuUs = 0;
+    const qint64 cpuStartUs = cpuTimeUs(RUSAGE_SELF);
+    timer.start();
+    QVERIFY(runThroughRelay(sink.port(), [&clientCpuUs](int s) {
+        const qint64 startUs = cpuTimeUs(RUSAGE_THREAD);
+        const QByteArray buf(1024 * 1024, 'a');
+        for (qint64 sent = 0; sent < kBenchBytes && writeAll(s, buf.constData(), buf.size()); sent += buf.size())
+        {
+        }
+        close(s);
+        clientCpuUs = cpuTimeUs(RUSAGE_THREAD) - startUs;
+    }, [this](int accepted, int backendSocket) { relayThroughQt(accepted, backendSocket); }));
+    sink.join();
+    const qint64 wallUs = timer.nsecsElapsed() / 1000;
+    QCOMPARE(sink.bytes(), kBenchBytes);
+    report("qt relay", sink.bytes(), wallUs, cpuTimeUs(RUSAGE_SELF) - cpuStartUs - clientCpuUs - sink.cpuUs());
+}
+
+void BenchSpliceRelay::benchmark_splice_relay()
+{
+    Backend sink(false);
+    SpliceRelay relay;
+    bool bFinished = false;
+    connect(&relay, &SpliceRelay::relayFinished, this, [&bFinished]() { bFinished = true; });
+    QElapsedTimer timer;
+    qint64 clientCpuUs = 0;
+    const qint64 cpuStartUs = cpuTimeUs(RUSAGE_SELF);
+    timer.start();
+    QVERIFY(runThroughRelay(sink.port(), [&clientCpuUs](int s) {
+        const qint64 startUs = cpuTimeUs(RUSAGE_THREAD);
+        const QByteArray buf(1024 * 1024, 'a');
+        for (qint64 sent = 0; sent < kBenchBytes && writeAll(s, buf.constData(), buf.size()); sent += buf.size())
+        {
+        }
+        close(s);
+        clientCpuUs = cpuTimeUs(RUSAGE_THREAD) - startUs;
+    }, [&relay, &bFinished](int accepted, int backendSocket) {
+        relay.add(accepted, backendSocket);
+        QTRY_VERIFY_WITH_TIMEOUT(bFinished, 10 * 60 * 1000);
+    }));
+    sink.join();
+    const qint64 wallUs = timer.nsecsElapsed() / 1000;
+    QCOMPARE(sink.bytes(), kBenchBytes);
+    report("splice relay", sink.bytes(), wallUs, cpuTimeUs(RUSAGE_SELF) - cpuStartUs - clientCpuUs - sink.cpuUs());
+}
+
+void BenchSpliceRelay::report(const char *name, qint64 bytes, qint64 wallUs, qint64 relayCpuUs)
+{
+    const double gb = bytes / (1024.0 * 1024.0 * 1024.0);
+    const double gbps = bytes * 8.0 / (wallUs / 1e6) / 1e9;
+    printf("%s: %.2f GB in %.2f s, %.2f Gbps, relay CPU %.3f s per GB\n", name, gb, wallUs / 1e6, gbps, relayCpuUs / 1e6 / gb);
+}
+
+QTEST_MAIN(BenchSpliceRelay)
+#include "splicerelay.bench.moc"
@@ -106,11 +106,11 @@ QString VpnShareController::getProxySharingAddress()
     QMutexLocker locker(&mutex_);
     if (httpProxyServer_)
     {
-        return Utils::getLocalIP() + ":" + QString::number(httpProxyServer_->serverPort());
+        return Utils::getLocalIP() + ":" + QString::number(httpProxyServer_->port());
     }
     else if (socksProxyServer_)
     {
-        return Utils::getLocalIP() + ":" + QString::number(socksProxyServer_->serverPort());
+        return Utils::getLocalIP() + ":" + QString::number(socksProxyServer_->port());
     }
     WS_ASSERT(false);
     return "Unknown";
@@ -380,7 +380,7 @@ void Backend::onEngineInitFinished(ENGINE_INIT_RET_CODE retCode, bool isCanLogin
         connect(engine_->getLocationsModel(), &locationsmodel::LocationsModel::locationsUpdated, this,  &Backend::onEngineLocationsModelItemsUpdated);
         connect(engine_->getLocationsModel(), &locationsmodel::LocationsModel::bestLocationUpdated, this, &Backend::onEngineLocationsModelBestLocationUpdated);
         connect(engine_->getLocationsModel(), &locationsmodel::LocationsModel::customConfigsLocationsUpdated, this, &Backend::onEngineLocationsModelCustomConfigItemsUpdated);
-        connect(engine_->getLocationsModel(), &locationsmodel::LocationsModel::locationPingTimeChanged, this, &Backend::onEngineLocationsModelPingChangedChanged);
+        connect(engine_->getLocationsModel(), &locationsmodel::LocationsModel::locationPingTimesChanged, this, &Backend::onEngineLocationsModelPingTimesChanged);
 
         preferences_.setEngineSettings(engineSettings);
         // WiFi sharing supported state
@@ -630,9 +630,9 @@ void Backend::onEngineLocationsModelCustomConfigItemsUpdated(QSharedPointer<type
     locationsModelManager_->updateCustomConfigLocation(*item);
 }
 
-void Backend::onEngineLocationsModelPingChangedChanged(const LocationID &id, PingTime timeMs)
+void Backend::onEngineLocationsModelPingTimesChanged(const QHash<LocationID, PingTime> &pingTimes)
 {
-    locationsModelManager_->changeConnectionSpeed(id, timeMs);
+    locationsModelManager_->changeConnectionSpeeds(pingTimes);
 }
 
 void Backend::onEngineMacAddrSpoofingChanged(const types::EngineSettings &engineSettings)
@@ -166,7 +166,7 @@ private slots:
     void onEngineLocationsModelItemsUpdated(const LocationID &bestLocation, const QString &staticIpDeviceName, QSharedPointer< QVector<types::Location> > items);
     void onEngineLocationsModelBestLocationUpdated(const LocationID &bestLocation);
     void onEngineLocationsModelCustomConfigItemsUpdated(QSharedPointer<types::Location> item);
-    void onEngineLocationsModelPingChangedChanged(const LocationID &id, PingTime timeMs);
+    void onEngineLocationsModelPingTimesChanged(const QHash<LocationID, PingTime> &pingTimes);
 
     void onEngineMacAddrSpoofingChanged(const types::EngineSettings &engineSettings);
     void onEngineSendUserWarning(USER_WARNING_TYPE userWarningType);
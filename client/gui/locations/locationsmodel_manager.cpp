@@ -63,9 +63,16 @@ void LocationsModelManager::updateCustomConfigLocation(const types::Location &lo
 }
 
 // since the connection speed change can be called quite often, we limit this processing to once every 0.5 second
-void LocationsModelManager::changeConnectionSpeed(LocationID id, PingTime speed)
+void LocationsModelManager::changeConnectionSpeeds(const QHash<LocationID, PingTime> &speeds)
 {
-    connectionSpeeds_[id] = speed;
+    if (connectionSpeeds_.isEmpty())
+    {
+        connectionSpeeds_ = speeds;
+    }
+    else
+    {
+        connectionSpeeds_.insert(speeds);
+    }
     if (!timer_.isActive())
     {
         timer_.start(UPDATE_CONNECTION_SPEED_PERIOD);
@@ -204,10 +211,7 @@ void LocationsModelManager::saveFavoriteLocations()
 
 void LocationsModelManager::onChangeConnectionSpeedTimer()
 {
-    for (QHash<LocationID, PingTime>::const_iterator it = connectionSpeeds_.constBegin(); it != connectionSpeeds_.constEnd(); ++it)
-    {
-        locationsModel_->changeConnectionSpeed(it.key(), it.value());
-    }
+    locationsModel_->changeConnectionSpeeds(connectionSpeeds_);
     connectionSpeeds_.clear();
     timer_.stop();
 }
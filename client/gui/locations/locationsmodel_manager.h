@@ -19,7 +19,7 @@ public:
     void updateBestLocation(const LocationID &bestLocation);
     void updateCustomConfigLocation(const types::Location &location);
     void updateDeviceName(const QString &staticIpDeviceName);
-    void changeConnectionSpeed(LocationID id, PingTime speed);
+    void changeConnectionSpeeds(const QHash<LocationID, PingTime> &speeds);
     void setLocationOrder(ORDER_LOCATION_TYPE orderLocationType);
     void setFreeSessionStatus(bool isFreeSessionStatus);
 
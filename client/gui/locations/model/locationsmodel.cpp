@@ -1,11 +1,14 @@
 #include "locationsmodel.h"
+
+#include <algorithm>
+
 #include "locationsmodel_utils.h"
 #include "../locationsmodel_roles.h"
 #include "languagecontroller.h"
 
 namespace gui_locations {
 
-LocationsModel::LocationsModel(QObject *parent) : QAbstractItemModel(parent), isFreeSessionStatus_(false)
+LocationsModel::LocationsModel(QObject *parent) : QAbstractItemModel(parent), isIndexMapsValid_(false), isFreeSessionStatus_(false)
 {
     root_ = new int();
     favoriteLocationsStorage_.readFromSettings();
@@ -33,6 +36,7 @@ void LocationsModel::updateLocations(const LocationID &bestLocation, const QVect
             mapLocations_[l.id] = li;
             i++;
         }
+        invalidateIndexMaps();
         endResetModel();
     }
     else
@@ -47,6 +51,7 @@ void LocationsModel::updateLocations(const LocationID &bestLocation, const QVect
             mapLocations_.remove(locations_[removedInd]->location().id);
             delete (locations_[removedInd]);
             locations_.removeAt(removedInd);
+            invalidateIndexMaps();
             endRemoveRows();
         }
 
@@ -62,6 +67,7 @@ void LocationsModel::updateLocations(const LocationID &bestLocation, const QVect
             LocationItem *li = new LocationItem(newLocationsVector[i]);
             mapLocations_[li->location().id] = li;
             locations_.insert(i + bestLocationOffs, li);
+            invalidateIndexMaps();
             endInsertRows();
         }
 
@@ -93,6 +99,7 @@ void LocationsModel::updateLocations(const LocationID &bestLocation, const QVect
                     beginMoveRows(QModelIndex(), ind, ind, QModelIndex(), i);
                     locationsInds.move(ind, i);
                     locations_.move(ind, i);
+                    invalidateIndexMaps();
                     endMoveRows();
                 }
             }
@@ -119,6 +126,7 @@ void LocationsModel::updateBestLocation(const LocationID &bestLocation)
                 mapLocations_.remove(firstLocationId);
                 locations_[0] = liBestLocation;
                 mapLocations_[liBestLocation->location().id] = liBestLocation;
+                invalidateIndexMaps();
 
                 emit dataChanged(index(0, 0), index(0, 0));
             }
@@ -134,6 +142,7 @@ void LocationsModel::updateBestLocation(const LocationID &bestLocation)
             mapLocations_.remove(firstLocationId);
             delete locations_[0];
             locations_.remove(0);
+            invalidateIndexMaps();
             endRemoveRows();
         }
     }
@@ -145,6 +154,7 @@ void LocationsModel::updateBestLocation(const LocationID &bestLocation)
             beginInsertRows(QModelIndex(), 0, 0);
             locations_.insert(0, liBestLocation);
             mapLocations_[liBestLocation->location().id] = liBestLocation;
+            invalidateIndexMaps();
             endInsertRows();
         }
     }
@@ -170,6 +180,7 @@ void LocationsModel::updateCustomConfigLocation(const types::Location &location)
             mapLocations_.remove(lid);
             delete locations_[locations_.size() - 1];
             locations_.remove(locations_.size() - 1);
+            invalidateIndexMaps();
             endRemoveRows();
         }
     }
@@ -183,6 +194,7 @@ void LocationsModel::updateCustomConfigLocation(const types::Location &location)
             LocationItem *li = new LocationItem(location);
             locations_ << li;
             mapLocations_[lid] = li;
+            invalidateIndexMaps();
             endInsertRows();
         }
     }
@@ -190,37 +202,47 @@ void LocationsModel::updateCustomConfigLocation(const types::Location &location)
 
 void LocationsModel::changeConnectionSpeed(LocationID id, PingTime speed)
 {
-    auto it = mapLocations_.find(id.toTopLevelLocation());
-    if (it != mapLocations_.end())
+    QHash<LocationID, PingTime> speeds;
+    speeds[id] = speed;
+    changeConnectionSpeeds(speeds);
+}
+
+void LocationsModel::changeConnectionSpeeds(const QHash<LocationID, PingTime> &speeds)
+{
+    updateIndexMapsIfNeeded();
+
+    QMap<int, QList<int> > changedCities;     // location row -> city rows
+    bool isBestLocationChanged = false;
+
+    for (auto it = speeds.constBegin(); it != speeds.constEnd(); ++it)
     {
-        int ind = locations_.indexOf(it.value());
-        WS_ASSERT(ind != -1);
-        if (ind != -1)
+        const LocationID &id = it.key();
+        auto cityIt = mapCities_.constFind(id);
+        if (cityIt != mapCities_.constEnd())
         {
-            for (int c = 0; c < it.value()->location().cities.size(); ++c)
-            {
-                if (it.value()->location().cities[c].id == id)
-                {
-                    it.value()->setPingTimeForCity(c, speed);
-                    QModelIndex locationModelInd = index(ind, 0);
-                    emit dataChanged(locationModelInd, locationModelInd, QList<int>() << kPingTime);
-                    QModelIndex cityModelInd = index(c, 0, locationModelInd);
-                    emit dataChanged(cityModelInd, cityModelInd, QList<int>() << kPingTime);
-                    break;
-                }
-            }
+            LocationItem *li = cityIt.value().first;
+            li->setPingTimeForCity(cityIt.value().second, it.value());
+            changedCities[mapLocationRows_.value(li)] << cityIt.value().second;
         }
-    }
 
-    if (locations_.size() > 0)
-    {
         // update speed for best location
-        if (!id.isCustomConfigsLocation() && !id.isStaticIpsLocation() && locations_[0]->location().id == id.apiLocationToBestLocation())
+        if (locations_.size() > 0 && !id.isCustomConfigsLocation() && !id.isStaticIpsLocation() && locations_[0]->location().id == id.apiLocationToBestLocation())
         {
-            locations_[0]->setPingTimeForCity(0, speed);
-            emit dataChanged(index(0, 0), index(0, 0), QList<int>() << kPingTime);
+            locations_[0]->setPingTimeForCity(0, it.value());
+            isBestLocationChanged = true;
         }
     }
+
+    // the sorting proxy models re-sort only the rows of the signals
+    emitPingTimeChanged(QModelIndex(), changedCities.keys());
+    for (auto it = changedCities.constBegin(); it != changedCities.constEnd(); ++it)
+    {
+        emitPingTimeChanged(index(it.key(), 0), it.value());
+    }
+    if (isBestLocationChanged)
+    {
+        emit dataChanged(index(0, 0), index(0, 0), QList<int>() << kPingTime);
+    }
 }
 
 void LocationsModel::setFreeSessionStatus(bool isFreeSessionStatus)
@@ -304,7 +326,7 @@ QModelIndex LocationsModel::parent(const QModelIndex &index) const
     }
 
     LocationItem *li = (LocationItem *)index.internalPointer();
-    int ind = locations_.indexOf(li);
+    int ind = rowOfLocation(li);
     WS_ASSERT(ind != -1);
     if (ind != -1)
     {
@@ -395,39 +417,22 @@ QModelIndex LocationsModel::getIndexByLocationId(const LocationID &id) const
         return QModelIndex();
     }
 
-    if (id.isBestLocation())
+    if (id.isBestLocation() || id.isTopLevelLocation())
     {
         auto it = mapLocations_.find(id);
         if (it != mapLocations_.end())
         {
-            int ind = locations_.indexOf(it.value());
-            return index (ind, 0);
+            return index(rowOfLocation(it.value()), 0);
         }
     }
     else
     {
-        auto it = mapLocations_.find(id.toTopLevelLocation());
-        if (it != mapLocations_.end())
+        updateIndexMapsIfNeeded();
+        auto it = mapCities_.constFind(id);
+        if (it != mapCities_.constEnd())
         {
-            int ind = locations_.indexOf(it.value());
-
-            if (id.isTopLevelLocation())
-            {
-                return index (ind, 0);
-            }
-            else
-            {
-                LocationItem *li = it.value();
-                for (int c = 0; c < li->location().cities.size(); ++c)
-                {
-                    if (li->location().cities[c].id == id)
-                    {
-                        QModelIndex locationModelInd = index(ind, 0);
-                        QModelIndex cityModelInd = index(c, 0, locationModelInd);
-                        return cityModelInd;
-                    }
-                }
-            }
+            QModelIndex locationModelInd = index(mapLocationRows_.value(it.value().first), 0);
+            return index(it.value().second, 0, locationModelInd);
         }
     }
 
@@ -649,6 +654,7 @@ void LocationsModel::clearLocations()
     }
     locations_.clear();
     mapLocations_.clear();
+    invalidateIndexMaps();
 }
 
 void LocationsModel::handleChangedLocation(int ind, const types::Location &newLocation)
@@ -664,6 +670,7 @@ void LocationsModel::handleChangedLocation(int ind, const types::Location &newLo
         int removedCityInd = removedCitiesInds[i];
         beginRemoveRows(rootIndex, removedCityInd, removedCityInd);
         li->removeCityAtInd(removedCityInd);
+        invalidateIndexMaps();
         endRemoveRows();
     }
 
@@ -672,6 +679,7 @@ void LocationsModel::handleChangedLocation(int ind, const types::Location &newLo
     {
         beginInsertRows(rootIndex, i, i);
         li->insertCityAtInd(i, citiesVector[i]);
+        invalidateIndexMaps();
         endInsertRows();
     }
 
@@ -706,15 +714,64 @@ void LocationsModel::handleChangedLocation(int ind, const types::Location &newLo
                 beginMoveRows(rootIndex, ind, ind, rootIndex, i);
                 citiesInds.move(ind, i);
                 li->moveCity(ind, i);
+                invalidateIndexMaps();
                 endMoveRows();
             }
         }
     }
 
     li->updateLocation(newLocation);
+    invalidateIndexMaps();
     emit dataChanged(rootIndex, rootIndex);
 }
 
+void LocationsModel::updateIndexMapsIfNeeded() const
+{
+    if (isIndexMapsValid_)
+    {
+        return;
+    }
+
+    mapCities_.clear();
+    mapLocationRows_.clear();
+    for (int i = 0; i < locations_.size(); ++i)
+    {
+        LocationItem *li = locations_[i];
+        mapLocationRows_[li] = i;
+        if (li->location().id.isBestLocation())
+        {
+            continue;
+        }
+        for (int c = 0; c < li->location().cities.size(); ++c)
+        {
+            mapCities_[li->location().cities[c].id] = qMakePair(li, c);
+        }
+    }
+    isIndexMapsValid_ = true;
+}
+
+int LocationsModel::rowOfLocation(const LocationItem *li) const
+{
+    updateIndexMapsIfNeeded();
+    return mapLocationRows_.value(li, -1);
+}
+
+void LocationsModel::emitPingTimeChanged(const QModelIndex &parent, QList<int> rows)
+{
+    std::sort(rows.begin(), rows.end());
+    int first = 0;
+    while (first < rows.size())
+    {
+        int last = first;
+        while (last + 1 < rows.size() && rows[last + 1] == rows[last] + 1)
+        {
+            last++;
+        }
+        emit dataChanged(index(rows[first], 0, parent), index(rows[last], 0, parent), QList<int>() << kPingTime);
+        first = last + 1;
+    }
+}
+
 LocationItem *LocationsModel::findAndCreateBestLocationItem(const LocationID &bestLocation)
 {
     if (!bestLocation.isValid()) {
@@ -47,6 +47,8 @@ public:
     void updateBestLocation(const LocationID &bestLocation);
     void updateCustomConfigLocation(const types::Location &location);
     void changeConnectionSpeed(LocationID id, PingTime speed);
+    // one dataChanged for each run of the adjacent changed rows
+    void changeConnectionSpeeds(const QHash<LocationID, PingTime> &speeds);
     void setFreeSessionStatus(bool isFreeSessionStatus);
 
     int	columnCount(const QModelIndex &parent = QModelIndex()) const override;
@@ -74,6 +76,12 @@ private:
     QVector<LocationItem *> locations_;
     QHash<LocationID, LocationItem *> mapLocations_;   // map LocationID to index in locations_
 
+    // Map the LocationID of a city to its location and its index in the cities, and a location to its row.
+    // Rebuilt on the first lookup after the locations or the cities change, the best location is not included.
+    mutable QHash<LocationID, QPair<LocationItem *, int> > mapCities_;
+    mutable QHash<const LocationItem *, int> mapLocationRows_;
+    mutable bool isIndexMapsValid_;
+
     int *root_;   // Fake root node. The typename does not matter, only the pointer to identify the root node matters.
     bool isFreeSessionStatus_;
     FavoriteLocationsStorage favoriteLocationsStorage_;
@@ -82,6 +90,10 @@ private:
     QVariant dataForLocation(int row, int role) const;
     QVariant dataForCity(LocationItem *l, int row, int role) const;
     void clearLocations();
+    void invalidateIndexMaps() { isIndexMapsValid_ = false; }
+    void updateIndexMapsIfNeeded() const;
+    int rowOfLocation(const LocationItem *li) const;
+    void emitPingTimeChanged(const QModelIndex &parent, QList<int> rows);
     void handleChangedLocation(int ind, const types::Location &newLocation);
     LocationItem *findAndCreateBestLocationItem(const LocationID &bestLocation);
 
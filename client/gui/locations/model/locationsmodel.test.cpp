@@ -200,6 +200,52 @@ void TestLocationsModel::testConnectionSpeed()
     }
 }
 
+void TestLocationsModel::testConnectionSpeeds()
+{
+    QHash<LocationID, PingTime> speeds;
+    speeds[LocationID::createApiLocationId(65, "Dallas", "Ranch")] = 100;
+    speeds[LocationID::createApiLocationId(65, "Dallas", "BBQ")] = 110;
+    speeds[LocationID::createApiLocationId(65, "Denver", "Hops")] = 120;
+    speeds[LocationID::createApiLocationId(1, "Philadelphia", "Cheese")] = 130;
+    speeds[LocationID::createApiLocationId(1, "Miami", "Vice")] = 140;
+    const LocationID unknownId = LocationID::createApiLocationId(1, "Nowhere", "Unknown");
+    speeds[unknownId] = 150;
+
+    QSignalSpy spyChanged(locationsModel_.get(), &QAbstractItemModel::dataChanged);
+    locationsModel_->changeConnectionSpeeds(speeds);
+
+    // the rows of both locations, the cities 1-3 of the first one, the cities 0 and 5 of the second one
+    QCOMPARE(spyChanged.count(), 4);
+    for (const QList<QVariant> &args : qAsConst(spyChanged))
+    {
+        QCOMPARE(args.at(2).value<QList<int> >(), QList<int>() << gui_locations::kPingTime);
+    }
+    {
+        const QList<QVariant> &args = spyChanged.at(0);
+        QCOMPARE(args.at(0).value<QModelIndex>().row(), 0);
+        QCOMPARE(args.at(1).value<QModelIndex>().row(), 1);
+        QVERIFY(!args.at(0).value<QModelIndex>().parent().isValid());
+    }
+    {
+        const QList<QVariant> &args = spyChanged.at(1);
+        QCOMPARE(args.at(0).value<QModelIndex>().row(), 1);
+        QCOMPARE(args.at(1).value<QModelIndex>().row(), 3);
+    }
+
+    for (auto it = speeds.constBegin(); it != speeds.constEnd(); ++it)
+    {
+        QModelIndex ind = locationsModel_->getIndexByLocationId(it.key());
+        if (it.key() == unknownId)
+        {
+            QVERIFY(!ind.isValid());
+        }
+        else
+        {
+            QCOMPARE(ind.data(gui_locations::kPingTime).toInt(), it.value().toInt());
+        }
+    }
+}
+
 void TestLocationsModel::testAddDeleteCountry()
 {
     QFile file(":data/tests/locationsmodel/deleted_locations.json");
@@ -21,6 +21,7 @@ private slots:
     void testBestLocation();
     void testCustomConfig();
     void testConnectionSpeed();
+    void testConnectionSpeeds();
     void testAddDeleteCountry();
     void testAddDeleteCity();
     void testChangedOrder();
@@ -103,8 +103,10 @@ void CitiesProxyModel::onDataChanged(const QModelIndex &topLeft, const QModelInd
     WS_ASSERT(topLeft.parent() == bottomRight.parent());
     if (topLeft.parent().isValid())
     {
+        // the cities of a location are adjacent in items_
         QModelIndex topLeftSelf = mapFromSource(topLeft);
-        QModelIndex bottomRightSelf = mapFromSource(bottomRight);
+        QModelIndex bottomRightSelf = index(topLeftSelf.row() + bottomRight.row() - topLeft.row(), 0);
+        WS_ASSERT(mapToSource(bottomRightSelf) == bottomRight);
         emit dataChanged(topLeftSelf, bottomRightSelf, roles);
     }
 }
@@ -14,7 +14,16 @@ void SortedCitiesProxyModel::setLocationOrder(ORDER_LOCATION_TYPE orderLocationT
     if (orderLocationsType_ != orderLocationType)
     {
         orderLocationsType_ = orderLocationType;
-        invalidate();
+        // the ping times change all the time, only the latency order has to re-sort the rows of their dataChanged
+        const int sortRole = (orderLocationType == ORDER_LOCATION_BY_LATENCY) ? kPingTime : (int)Qt::DisplayRole;
+        if (sortRole != this->sortRole())
+        {
+            setSortRole(sortRole);
+        }
+        else
+        {
+            invalidate();
+        }
     }
 }
 